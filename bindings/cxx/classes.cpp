@@ -648,6 +648,25 @@ void Device::close()
 	check(sr_dev_close(_structure));
 }
 
+void Device::config_set_batch(const vector<ConfigSetting> &settings)
+{
+	vector<struct sr_config_batch_entry> entries(settings.size());
+	GSList *list = nullptr;
+
+	for (size_t i = 0; i < settings.size(); i++) {
+		auto &setting = settings[i];
+		entries[i].cg = setting.channel_group ?
+			setting.channel_group->config_channel_group : nullptr;
+		entries[i].key = setting.key->id();
+		entries[i].data = const_cast<GVariant*>(setting.value.gobj());
+		list = g_slist_append(list, &entries[i]);
+	}
+
+	int ret = sr_config_set_batch(_structure, list);
+	g_slist_free(list);
+	check(ret);
+}
+
 HardwareDevice::HardwareDevice(shared_ptr<Driver> driver,
 		struct sr_dev_inst *structure) :
 	Device(structure),
@@ -371,6 +371,17 @@ private:
 	friend struct std::default_delete<Driver>;
 };
 
+/** A setting to apply with Device::config_set_batch(). */
+struct SR_API ConfigSetting
+{
+	/** Channel group to apply the setting to, or nullptr. */
+	shared_ptr<ChannelGroup> channel_group;
+	/** ConfigKey to set. */
+	const ConfigKey *key;
+	/** Value to set. */
+	Glib::VariantBase value;
+};
+
 /** A generic device, either hardware or virtual */
 class SR_API Device : public Configurable
 {
@@ -393,6 +404,10 @@ public:
 	void open();
 	/** Close device. */
 	void close();
+	/** Apply several settings at once. They are all checked before any
+	 * of them is applied, see sr_config_set_batch().
+	 * @param settings Settings to apply. */
+	void config_set_batch(const vector<ConfigSetting> &settings);
 protected:
 	explicit Device(struct sr_dev_inst *structure);
 	~Device();
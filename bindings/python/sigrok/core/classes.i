@@ -393,6 +393,7 @@ std::map<std::string, Glib::VariantBase> dict_to_map_options(PyObject *dict,
 %ignore sigrok::Driver::scan;
 %ignore sigrok::InputFormat::create_input;
 %ignore sigrok::OutputFormat::create_output;
+%rename(_config_set_batch) sigrok::Device::config_set_batch;
 
 %include "doc_start.i"
 
@@ -528,6 +529,38 @@ std::map<std::string, Glib::VariantBase> dict_to_map_options(PyObject *dict,
     }
 }
 
+%template(ConfigSettingVector) std::vector<sigrok::ConfigSetting>;
+
+/* Support Device.config_set_batch() with Python input types. */
+%extend sigrok::Device
+{
+    void _config_set_batch_add(std::vector<sigrok::ConfigSetting> &settings,
+        std::shared_ptr<sigrok::ChannelGroup> channel_group,
+        const sigrok::ConfigKey *key, PyObject *input)
+    {
+        sigrok::ConfigSetting setting;
+        setting.channel_group = channel_group;
+        setting.key = key;
+        setting.value = python_to_variant_by_key(input, key);
+        settings.push_back(setting);
+    }
+}
+
+%pythoncode
+{
+    def _Device_config_set_batch(self, settings):
+        """Apply a list of (key, value) or (channel_group, key, value)
+        tuples at once."""
+        batch = ConfigSettingVector()
+        for setting in settings:
+            if len(setting) == 2:
+                setting = (None,) + tuple(setting)
+            self._config_set_batch_add(batch, *setting)
+        self._config_set_batch(batch)
+
+    Device.config_set_batch = _Device_config_set_batch
+}
+
 /* Return NumPy array from Analog::data(). */
 %extend sigrok::Analog
 {
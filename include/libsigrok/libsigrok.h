@@ -90,6 +90,12 @@ enum sr_error_code {
 
 #define SR_HZ_TO_NS(n) ((uint64_t)(1000000000ULL) / (n))
 
+/** Maximum number of digits after the decimal point for sr_float_to_string(). */
+#define SR_FLOAT_MAX_DIGITS 15
+
+/** Buffer size sufficient for any string written by sr_float_to_string(). */
+#define SR_FLOAT_STRING_SIZE 64
+
 /** libsigrok loglevels. */
 enum sr_loglevel {
 	SR_LOG_NONE = 0, /**< Output no messages at all. */
@@ -170,6 +176,10 @@ enum sr_packettype {
 	SR_DF_FRAME_END,
 	/** Payload is struct sr_datafeed_analog. */
 	SR_DF_ANALOG,
+	/** Samples were lost. Payload is struct sr_datafeed_gap. */
+	SR_DF_GAP,
+	/** Payload is struct sr_datafeed_analog_planar. */
+	SR_DF_ANALOG_PLANAR,
 
 	/* Update datafeed_dump() (session.c) upon changes! */
 };
@@ -398,6 +408,55 @@ enum sr_trigger_matches {
 	SR_TRIGGER_EDGE,
 	SR_TRIGGER_OVER,
 	SR_TRIGGER_UNDER,
+	/** A UART frame carrying a given byte. */
+	SR_TRIGGER_UART,
+	/** An SPI word with a given value. */
+	SR_TRIGGER_SPI,
+	/** An I2C transfer to a given address. */
+	SR_TRIGGER_I2C,
+	/** A pulse whose width is within given bounds. */
+	SR_TRIGGER_PULSE,
+	/** No edge for a given time. */
+	SR_TRIGGER_TIMEOUT,
+	/** A pulse which crosses one threshold, but not the other. */
+	SR_TRIGGER_RUNT,
+};
+
+/** Flags for struct sr_trigger_protocol. */
+enum sr_trigger_protocol_flags {
+	/** The UART line idles low, and its bits are inverted. */
+	SR_TRIGGER_UART_INVERTED = 1 << 0,
+	/** The SPI clock idles high (CPOL=1). */
+	SR_TRIGGER_SPI_CPOL = 1 << 1,
+	/** SPI data is sampled on the trailing clock edge (CPHA=1). */
+	SR_TRIGGER_SPI_CPHA = 1 << 2,
+	/** SPI words are sent LSB first. */
+	SR_TRIGGER_SPI_LSB_FIRST = 1 << 3,
+	/** The SPI chip select is active high. */
+	SR_TRIGGER_SPI_CS_HIGH = 1 << 4,
+	/** Only match I2C read transfers. */
+	SR_TRIGGER_I2C_READ = 1 << 5,
+	/** Only match I2C write transfers. */
+	SR_TRIGGER_I2C_WRITE = 1 << 6,
+	/** Also match the first I2C data byte after the address. */
+	SR_TRIGGER_I2C_DATA = 1 << 7,
+};
+
+/** UART parity, for struct sr_trigger_protocol. */
+enum sr_trigger_parity {
+	SR_TRIGGER_PARITY_NONE,
+	SR_TRIGGER_PARITY_ODD,
+	SR_TRIGGER_PARITY_EVEN,
+};
+
+/** Flags for struct sr_trigger_condition. */
+enum sr_trigger_condition_flags {
+	/** Match high pulses, or a line which stays high. */
+	SR_TRIGGER_POSITIVE = 1 << 0,
+	/** Match low pulses, or a line which stays low. */
+	SR_TRIGGER_NEGATIVE = 1 << 1,
+	/** The bounds are in nanoseconds, not in samples. */
+	SR_TRIGGER_NANOSECONDS = 1 << 2,
 };
 
 /** The representation of a trigger, consisting of one or more stages
@@ -429,18 +488,91 @@ struct sr_trigger_match {
 	 * SR_TRIGGER_RISING
 	 * SR_TRIGGER_FALLING
 	 * SR_TRIGGER_EDGE
+	 * SR_TRIGGER_UART
+	 * SR_TRIGGER_SPI
+	 * SR_TRIGGER_I2C
+	 * SR_TRIGGER_PULSE
+	 * SR_TRIGGER_TIMEOUT
 	 *
 	 * For analog channels, only these matches may be used:
 	 * SR_TRIGGER_RISING
 	 * SR_TRIGGER_FALLING
 	 * SR_TRIGGER_OVER
 	 * SR_TRIGGER_UNDER
+	 * SR_TRIGGER_RUNT
 	 *
 	 */
 	int match;
 	/** If the trigger match is one of SR_TRIGGER_OVER or SR_TRIGGER_UNDER,
 	 * this contains the value to compare against. */
 	float value;
+	/** For the protocol matches SR_TRIGGER_UART, SR_TRIGGER_SPI and
+	 * SR_TRIGGER_I2C, what to decode and match. NULL otherwise. */
+	struct sr_trigger_protocol *protocol;
+	/** For SR_TRIGGER_PULSE, SR_TRIGGER_TIMEOUT and SR_TRIGGER_RUNT,
+	 * the bounds and thresholds to apply. NULL otherwise. */
+	struct sr_trigger_condition *condition;
+};
+
+/**
+ * Parameters of a protocol trigger match.
+ *
+ * The match's channel is the data line: UART RX or TX, SPI MOSI or MISO,
+ * or I2C SDA. The match fires on the sample where a matching frame ends:
+ * at the middle of the UART stop bit, on the SPI clock edge which samples
+ * the last bit of the word, or on the SCL rising edge which samples the
+ * last bit of the I2C address (or data) byte.
+ */
+struct sr_trigger_protocol {
+	/** The SPI clock (SCK), or the I2C clock (SCL). Unused for UART. */
+	struct sr_channel *clock;
+	/** The SPI chip select. May be NULL, in which case words are
+	 * counted from the start of the acquisition. */
+	struct sr_channel *select;
+	/** The UART baud rate. */
+	uint64_t baudrate;
+	/** UART data bits (5-9), or SPI word size (1-32). 0 means 8. */
+	unsigned int num_bits;
+	/** The UART parity, one of enum sr_trigger_parity. A frame with a
+	 * parity or framing error never matches. */
+	int parity;
+	/** Flags from enum sr_trigger_protocol_flags. */
+	uint32_t flags;
+	/** The UART byte, SPI word or 7-bit I2C address to match. */
+	uint32_t value;
+	/** The bits of value to compare. 0 matches any frame. */
+	uint32_t mask;
+	/** With SR_TRIGGER_I2C_DATA, the first data byte to match. */
+	uint8_t data;
+	/** The bits of data to compare. */
+	uint8_t data_mask;
+};
+
+/**
+ * Parameters of a pulse width, timeout or runt trigger match.
+ *
+ * A pulse is the time a line spends at one level (or, for runts, between
+ * the thresholds), counted in whole samples. Pulse and runt matches fire
+ * on the sample which ends a matching pulse. A timeout match fires on the
+ * sample where the line has kept its level for the given time, counting
+ * from the last edge or from the start of the acquisition.
+ *
+ * With neither SR_TRIGGER_POSITIVE nor SR_TRIGGER_NEGATIVE set, both
+ * polarities match. A positive runt rises above the low threshold, and
+ * falls back below it without reaching the high one; a negative runt is
+ * the same, upside down.
+ */
+struct sr_trigger_condition {
+	/** Flags from enum sr_trigger_condition_flags. */
+	uint32_t flags;
+	/** The shortest pulse to match, or 0 for no lower bound. For
+	 * SR_TRIGGER_TIMEOUT, how long the line must keep its level. */
+	uint64_t min;
+	/** The longest pulse to match, or 0 for no upper bound. */
+	uint64_t max;
+	/** The runt thresholds. */
+	float low;
+	float high;
 };
 
 /**
@@ -521,12 +653,69 @@ struct sr_datafeed_analog {
 	struct sr_analog_spec *spec;
 };
 
+/**
+ * One channel of an SR_DF_ANALOG_PLANAR packet.
+ *
+ * Several planes may share the same encoding, meaning and spec. The
+ * channels list of the meaning is not used, the plane's channel is.
+ */
+struct sr_analog_plane {
+	/** The channel this plane carries samples for. */
+	struct sr_channel *channel;
+	/** First sample of this plane. */
+	void *data;
+	/** Distance in bytes between two consecutive samples, or 0 if the
+	 *  samples are packed (stride == encoding->unitsize). */
+	uint32_t stride;
+	struct sr_analog_encoding *encoding;
+	struct sr_analog_meaning *meaning;
+	struct sr_analog_spec *spec;
+};
+
+/**
+ * Analog datafeed payload for type SR_DF_ANALOG_PLANAR.
+ *
+ * Carries the same number of samples for each of several channels, one
+ * plane per channel. A plane's stride allows it to point into a buffer
+ * with another layout, e.g. into the device's interleaved transfer.
+ */
+struct sr_datafeed_analog_planar {
+	/** Frame the samples belong to, counted from 1 at the first
+	 *  SR_DF_FRAME_BEGIN of the acquisition, or 0 outside of frames. */
+	uint64_t frame;
+	/** Index of the first sample, counted from the beginning of the
+	 *  frame, or from the start of the acquisition outside of frames. */
+	uint64_t sample;
+	/** Number of samples in each plane. */
+	uint32_t num_samples;
+	/** Number of entries in planes. */
+	uint32_t num_planes;
+	struct sr_analog_plane *planes;
+};
+
+/**
+ * Datafeed payload for type SR_DF_GAP.
+ *
+ * Sent by a driver in place of samples it knows were lost, for example
+ * because the host did not keep up with the device. The samples which
+ * follow continue after the gap.
+ */
+struct sr_datafeed_gap {
+	/** Index of the first lost sample, counted from the first sample
+	 *  sent in this acquisition. */
+	uint64_t start;
+	/** Number of samples lost. */
+	uint64_t length;
+};
+
 struct sr_analog_encoding {
 	uint8_t unitsize;
 	gboolean is_signed;
 	gboolean is_float;
 	gboolean is_bigendian;
-	uint8_t digits;
+	/** Decimal (or binary) digits after the point. Negative when the
+	 *  resolution is coarser than one unit, e.g. -3 for 1 kOhm steps. */
+	int8_t digits;
 	gboolean is_digits_decimal;
 	struct sr_rational scale;
 	struct sr_rational offset;
@@ -540,9 +729,69 @@ struct sr_analog_meaning {
 };
 
 struct sr_analog_spec {
-	uint8_t spec_digits;
+	int8_t spec_digits;
+};
+
+/** A channel as announced by a shared-memory ring producer. */
+struct sr_shmring_channel {
+	/** The index of this channel, as in struct sr_channel. */
+	int32_t index;
+	/** Channel type (SR_CHANNEL_LOGIC, ...) */
+	int32_t type;
+	/** Is this channel enabled? */
+	int32_t enabled;
+	/** Name of this channel. */
+	char name[20];
+};
+
+/** Stream properties of a shared-memory ring, see sr_shmring_reader_info(). */
+struct sr_shmring_info {
+	/** Samplerate in Hz, or 0 if unknown. */
+	uint64_t samplerate;
+	/** Size in bytes of one sample in SR_DF_LOGIC records. */
+	unsigned int unitsize;
+	/** Number of entries in channels. */
+	unsigned int num_channels;
+	/** Channel map of the producing device. */
+	const struct sr_shmring_channel *channels;
+};
+
+/** A single record read from a shared-memory ring, see sr_shmring_read(). */
+struct sr_shmring_record {
+	/** Packet type: SR_DF_LOGIC, SR_DF_ANALOG or SR_DF_END. */
+	int type;
+	/** Sequence number, incremented by one for every record written. */
+	uint64_t seq;
+	/**
+	 * Number of records which were overwritten by the producer before
+	 * this reader could get them, immediately preceding this record.
+	 */
+	uint64_t lost;
+	/** SR_DF_LOGIC: size in bytes of one sample. */
+	unsigned int unitsize;
+	/** SR_DF_ANALOG: index of the first channel in this record. */
+	int channel;
+	/** SR_DF_ANALOG: number of (interleaved) channels in this record. */
+	unsigned int num_channels;
+	/** SR_DF_ANALOG: measured quantity (enum sr_mq). */
+	int mq;
+	/** SR_DF_ANALOG: unit of the samples (enum sr_unit). */
+	int unit;
+	/** SR_DF_ANALOG: measured quantity flags (enum sr_mqflag). */
+	uint64_t mqflags;
+	/**
+	 * The payload: raw logic samples, or analog samples as native
+	 * float values. Valid until the next call to sr_shmring_read().
+	 */
+	const void *data;
+	/** Size of the payload in bytes. */
+	uint64_t length;
 };
 
+struct sr_shmring_reader;
+
+struct sr_local_server;
+
 /** Generic option struct used by various subsystems. */
 struct sr_option {
 	/* Short name suitable for commandline usage, [a-z0-9-]. */
@@ -576,10 +825,58 @@ struct sr_resource {
 	int type;
 };
 
+/** Hotplug event type.
+ * @since 0.5.0
+ */
+enum sr_hotplug_event_type {
+	/** A supported device was plugged in. */
+	SR_HOTPLUG_ARRIVED = 1,
+	/** A device reported earlier was unplugged. */
+	SR_HOTPLUG_LEFT,
+};
+
+/** Hotplug event, as passed to the sr_hotplug_callback.
+ * @since 0.5.0
+ */
+struct sr_hotplug_event {
+	/** Event type (SR_HOTPLUG_ARRIVED, ...) */
+	int type;
+	/** The driver which handles the device. */
+	struct sr_dev_driver *driver;
+	/**
+	 * The device instances the driver's scan found on the device. They
+	 * belong to the driver, as do those returned by sr_driver_scan().
+	 * After SR_HOTPLUG_LEFT they can only be closed.
+	 */
+	GSList *devices;
+	/** USB vendor and product ID. */
+	uint16_t vendor_id;
+	uint16_t product_id;
+	/** The USB port path, as in sr_dev_inst_connid_get(). */
+	const char *connection_id;
+};
+
+/** A USB device a driver handles, see sr_dev_driver.usb_ids. */
+struct sr_usb_id {
+	/** USB vendor and product ID. */
+	uint16_t vid;
+	uint16_t pid;
+	/** Prefixes of the manufacturer and product strings, where the IDs
+	 *  aren't enough, or NULL. */
+	const char *manufacturer;
+	const char *product;
+};
+
 /** Output module flags. */
 enum sr_output_flag {
 	/** If set, this output module writes the output itself. */
 	SR_OUTPUT_INTERNAL_IO_HANDLING = 0x01,
+	/**
+	 * If set, this output module handles SR_DF_ANALOG_PLANAR itself.
+	 * Otherwise sr_output_send() hands it one SR_DF_ANALOG packet per
+	 * plane instead.
+	 */
+	SR_OUTPUT_ANALOG_PLANAR = 0x02,
 };
 
 struct sr_input;
@@ -624,6 +921,24 @@ struct sr_channel_group {
 	void *priv;
 };
 
+/** Summary of a session file, as returned by sr_session_file_info(). */
+struct sr_session_file_info {
+	/** Session file format version. */
+	int version;
+	/** Samplerate in Hz, or 0 if the file doesn't have one. */
+	uint64_t samplerate;
+	/** Bytes per logic sample, or 0 if there is no logic data. */
+	int unitsize;
+	/** List of sr_channel structs of all channels in the file, logic
+	 * channels first. Channels with stored data are enabled. The
+	 * channels don't belong to a device, their sdi is NULL. */
+	GSList *channels;
+	/** Number of logic samples. */
+	uint64_t logic_samples;
+	/** Number of samples per analog channel. */
+	uint64_t analog_samples;
+};
+
 /** Used for setting or getting value of a config item. */
 struct sr_config {
 	/** Config key like SR_CONF_CONN, etc. */
@@ -632,6 +947,16 @@ struct sr_config {
 	GVariant *data;
 };
 
+/** One setting of a batch, see sr_config_set_batch(). */
+struct sr_config_batch_entry {
+	/** Channel group the setting applies to, or NULL. */
+	const struct sr_channel_group *cg;
+	/** Config key like SR_CONF_VDIV, etc. */
+	uint32_t key;
+	/** Key-specific data. */
+	GVariant *data;
+};
+
 enum sr_keytype {
 	SR_KEY_CONFIG,
 	SR_KEY_MQ,
@@ -1054,6 +1379,19 @@ enum sr_configkey {
 	/** Self test mode. */
 	SR_CONF_TEST_MODE,
 
+	/**
+	 * Inject gaps (SR_DF_GAP) into the data feed, for testing how
+	 * consumers handle lost samples. The value is the number of
+	 * samples between gaps, or 0 to disable.
+	 */
+	SR_CONF_INJECT_GAPS,
+
+	/**
+	 * Send the analog channels together, in SR_DF_ANALOG_PLANAR
+	 * packets, rather than in one SR_DF_ANALOG packet per channel.
+	 */
+	SR_CONF_ANALOG_PLANAR,
+
 	/* Update sr_key_info_config[] (hwdriver.c) upon changes! */
 };
 
@@ -1120,6 +1458,15 @@ struct sr_dev_driver {
 	GSList *(*dev_list) (const struct sr_dev_driver *driver);
 	/** Clear list of devices the driver knows about. */
 	int (*dev_clear) (const struct sr_dev_driver *driver);
+	/** List the USB devices the driver handles, for hotplug notification.
+	 *  Optional, and only for drivers which scan just the device given
+	 *  by SR_CONF_CONN.
+	 *  @returns GSList of a struct sr_usb_id for each device.
+	 *           Must be freed by caller, with g_slist_free_full() and
+	 *           g_free().
+	 *  @see sr_hotplug_subscribe().
+	 */
+	GSList *(*usb_ids) (const struct sr_dev_driver *driver);
 	/** Query value of a configuration key in driver or given device instance.
 	 *  @see sr_config_get().
 	 */
@@ -1131,6 +1478,11 @@ struct sr_dev_driver {
 	int (*config_set) (uint32_t key, GVariant *data,
 			const struct sr_dev_inst *sdi,
 			const struct sr_channel_group *cg);
+	/** Set several configuration keys at once. Optional, without it
+	 *  the settings are passed to config_set() one by one.
+	 *  @see sr_config_set_batch(). */
+	int (*config_set_batch) (const struct sr_dev_inst *sdi,
+			GSList *entries);
 	/** Channel status change.
 	 *  @see sr_dev_channel_enable(). */
 	int (*config_channel_set) (const struct sr_dev_inst *sdi,
@@ -33,6 +33,16 @@ SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 SR_API int sr_analog_unit_to_string(const struct sr_datafeed_analog *analog,
 		char **result);
 SR_API void sr_rational_set(struct sr_rational *r, int64_t p, uint64_t q);
+SR_API int sr_analog_plane_to_float(const struct sr_analog_plane *plane,
+		uint32_t num_samples, float *outbuf);
+SR_API int sr_analog_planar_to_float(
+		const struct sr_datafeed_analog_planar *planar, float *outbuf);
+SR_API void sr_analog_interleave(const void *const *planes,
+		unsigned int num_planes, unsigned int unitsize,
+		uint32_t num_samples, void *outbuf);
+SR_API void sr_analog_deinterleave(const void *inbuf,
+		unsigned int num_planes, unsigned int unitsize,
+		uint32_t num_samples, void *const *planes);
 
 /*--- backend.c -------------------------------------------------------------*/
 
@@ -92,6 +102,8 @@ SR_API int sr_config_get(const struct sr_dev_driver *driver,
 SR_API int sr_config_set(const struct sr_dev_inst *sdi,
 		const struct sr_channel_group *cg,
 		uint32_t key, GVariant *data);
+SR_API int sr_config_set_batch(const struct sr_dev_inst *sdi,
+		GSList *entries);
 SR_API int sr_config_commit(const struct sr_dev_inst *sdi);
 SR_API int sr_config_list(const struct sr_dev_driver *driver,
 		const struct sr_dev_inst *sdi,
@@ -100,6 +112,16 @@ SR_API int sr_config_list(const struct sr_dev_driver *driver,
 SR_API const struct sr_key_info *sr_key_info_get(int keytype, uint32_t key);
 SR_API const struct sr_key_info *sr_key_info_name_get(int keytype, const char *keyid);
 
+/*--- hotplug.c -------------------------------------------------------------*/
+
+typedef void (*sr_hotplug_callback)(const struct sr_hotplug_event *event,
+		void *cb_data);
+
+SR_API int sr_hotplug_subscribe(struct sr_context *ctx,
+		sr_hotplug_callback cb, void *cb_data);
+SR_API int sr_hotplug_unsubscribe(struct sr_context *ctx);
+SR_API int sr_hotplug_handle_events(struct sr_context *ctx, int timeout_ms);
+
 /*--- session.c -------------------------------------------------------------*/
 
 typedef void (*sr_session_stopped_callback)(void *data);
@@ -111,6 +133,9 @@ SR_API struct sr_trigger *sr_session_trigger_get(struct sr_session *session);
 /* Session setup */
 SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 	struct sr_session **session);
+SR_API int sr_session_file_info(const char *filename,
+	struct sr_session_file_info **info);
+SR_API void sr_session_file_info_free(struct sr_session_file_info *info);
 SR_API int sr_session_new(struct sr_context *ctx, struct sr_session **session);
 SR_API int sr_session_destroy(struct sr_session *session);
 SR_API int sr_session_dev_remove_all(struct sr_session *session);
@@ -134,6 +159,13 @@ SR_API int sr_session_is_running(struct sr_session *session);
 SR_API int sr_session_stopped_callback_set(struct sr_session *session,
 		sr_session_stopped_callback cb, void *cb_data);
 
+/* Flight recorder */
+SR_API int sr_session_recorder_set(struct sr_session *session,
+		uint64_t pre_samples, uint64_t post_samples);
+SR_API int sr_session_recorder_max_bytes_set(struct sr_session *session,
+		uint64_t max_bytes);
+SR_API int sr_session_snapshot(struct sr_session *session);
+
 /*--- input/input.c ---------------------------------------------------------*/
 
 SR_API const struct sr_input_module **sr_input_list(void);
@@ -151,11 +183,22 @@ SR_API struct sr_input *sr_input_new(const struct sr_input_module *imod,
 		GHashTable *options);
 SR_API int sr_input_scan_buffer(GString *buf, const struct sr_input **in);
 SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in);
+SR_API const struct sr_input_module *sr_input_module_get(const struct sr_input *in);
 SR_API struct sr_dev_inst *sr_input_dev_inst_get(const struct sr_input *in);
 SR_API int sr_input_send(const struct sr_input *in, GString *buf);
 SR_API int sr_input_end(const struct sr_input *in);
 SR_API void sr_input_free(const struct sr_input *in);
 
+/*--- local_server.c --------------------------------------------------------*/
+
+SR_API int sr_local_server_new(struct sr_context *ctx, const char *path,
+		struct sr_local_server **server);
+SR_API int sr_local_server_dev_add(struct sr_local_server *server,
+		struct sr_dev_inst *sdi);
+SR_API int sr_local_server_run(struct sr_local_server *server);
+SR_API int sr_local_server_stop(struct sr_local_server *server);
+SR_API int sr_local_server_free(struct sr_local_server *server);
+
 /*--- output/output.c -------------------------------------------------------*/
 
 SR_API const struct sr_output_module **sr_output_list(void);
@@ -174,6 +217,16 @@ SR_API int sr_output_send(const struct sr_output *o,
 		const struct sr_datafeed_packet *packet, GString **out);
 SR_API int sr_output_free(const struct sr_output *o);
 
+/*--- output/shmring.c ------------------------------------------------------*/
+
+SR_API int sr_shmring_reader_open(struct sr_shmring_reader **reader,
+		const char *name);
+SR_API const struct sr_shmring_info *sr_shmring_reader_info(
+		struct sr_shmring_reader *reader);
+SR_API int sr_shmring_read(struct sr_shmring_reader *reader,
+		struct sr_shmring_record *record, int timeout_ms);
+SR_API void sr_shmring_reader_close(struct sr_shmring_reader *reader);
+
 /*--- transform/transform.c -------------------------------------------------*/
 
 SR_API const struct sr_transform_module **sr_transform_list(void);
@@ -194,6 +247,12 @@ SR_API void sr_trigger_free(struct sr_trigger *trig);
 SR_API struct sr_trigger_stage *sr_trigger_stage_add(struct sr_trigger *trig);
 SR_API int sr_trigger_match_add(struct sr_trigger_stage *stage,
 		struct sr_channel *ch, int trigger_match, float value);
+SR_API int sr_trigger_protocol_match_add(struct sr_trigger_stage *stage,
+		struct sr_channel *ch, int trigger_match,
+		const struct sr_trigger_protocol *protocol);
+SR_API int sr_trigger_condition_match_add(struct sr_trigger_stage *stage,
+		struct sr_channel *ch, int trigger_match,
+		const struct sr_trigger_condition *condition);
 
 /*--- serial.c --------------------------------------------------------------*/
 
@@ -216,6 +275,7 @@ SR_API int sr_resource_set_hooks(struct sr_context *ctx,
 
 /*--- strutil.c -------------------------------------------------------------*/
 
+SR_API int sr_float_to_string(char *buf, float value, int digits);
 SR_API char *sr_si_string_u64(uint64_t x, const char *unit);
 SR_API char *sr_samplerate_string(uint64_t samplerate);
 SR_API char *sr_period_string(uint64_t frequency);
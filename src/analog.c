@@ -151,6 +151,24 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
 	return SR_OK;
 }
 
+/**
+ * Check whether plane idx is the first one using its encoding.
+ *
+ * Planes may share an encoding. Code which modifies encodings in place,
+ * like the transform modules, must touch each of them only once.
+ */
+SR_PRIV gboolean sr_analog_plane_owns_encoding(
+		const struct sr_datafeed_analog_planar *planar, uint32_t idx)
+{
+	uint32_t i;
+
+	for (i = 0; i < idx; i++)
+		if (planar->planes[i].encoding == planar->planes[idx].encoding)
+			return FALSE;
+
+	return TRUE;
+}
+
 /**
  * Convert an analog datafeed payload to an array of floats.
  *
@@ -171,8 +189,10 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
 SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 		float *outbuf)
 {
+	const uint8_t *data;
+	double scale;
 	float offset;
-	unsigned int b, i, count;
+	unsigned int i, count;
 	gboolean bigendian;
 
 	if (!analog || !(analog->data) || !(analog->meaning)
@@ -232,6 +252,29 @@ SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 				}
 			}
 			break;
+		case 3:
+			if (is_signed && is_bigendian) {
+				for (unsigned int i = 0; i < count; i++) {
+					outbuf[i] = scale * RB24S(&data8[i * 3]);
+					outbuf[i] += offset;
+				}
+			} else if (is_bigendian) {
+				for (unsigned int i = 0; i < count; i++) {
+					outbuf[i] = scale * RB24(&data8[i * 3]);
+					outbuf[i] += offset;
+				}
+			} else if (is_signed) {
+				for (unsigned int i = 0; i < count; i++) {
+					outbuf[i] = scale * RL24S(&data8[i * 3]);
+					outbuf[i] += offset;
+				}
+			} else {
+				for (unsigned int i = 0; i < count; i++) {
+					outbuf[i] = scale * RL24(&data8[i * 3]);
+					outbuf[i] += offset;
+				}
+			}
+			break;
 		case 4:
 			if (is_signed && is_bigendian) {
 				for (unsigned int i = 0; i < count; i++) {
@@ -270,27 +313,212 @@ SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 			&& analog->encoding->offset.p / (float)analog->encoding->offset.q == 0) {
 		/* The data is already in the right format. */
 		memcpy(outbuf, analog->data, count * sizeof(float));
-	} else {
-		for (i = 0; i < count; i += analog->encoding->unitsize) {
-			for (b = 0; b < analog->encoding->unitsize; b++) {
-				if (analog->encoding->is_bigendian == bigendian)
-					((uint8_t *)outbuf)[i + b] =
-						((uint8_t *)analog->data)[i * analog->encoding->unitsize + b];
-				else
-					((uint8_t *)outbuf)[i + (analog->encoding->unitsize - b)] =
-						((uint8_t *)analog->data)[i * analog->encoding->unitsize + b];
-			}
-			if (analog->encoding->scale.p != 1
-					|| analog->encoding->scale.q != 1)
-				outbuf[i] = (outbuf[i] * analog->encoding->scale.p) / analog->encoding->scale.q;
-			offset = ((float)analog->encoding->offset.p / (float)analog->encoding->offset.q);
-			outbuf[i] += offset;
+		return SR_OK;
+	}
+
+	scale = analog->encoding->scale.p / (double)analog->encoding->scale.q;
+	offset = analog->encoding->offset.p / (float)analog->encoding->offset.q;
+	data = analog->data;
+	switch (analog->encoding->unitsize) {
+	case sizeof(float):
+		for (i = 0; i < count; i++, data += sizeof(float)) {
+			if (analog->encoding->is_bigendian)
+				outbuf[i] = RBFL(data);
+			else
+				outbuf[i] = RLFL(data);
+			outbuf[i] = outbuf[i] * scale + offset;
 		}
+		break;
+	case sizeof(double):
+		for (i = 0; i < count; i++, data += sizeof(double)) {
+			if (analog->encoding->is_bigendian)
+				outbuf[i] = RBDBL(data) * scale + offset;
+			else
+				outbuf[i] = RLDBL(data) * scale + offset;
+		}
+		break;
+	default:
+		sr_err("Unsupported unit size '%d' for analog-to-float conversion.",
+			analog->encoding->unitsize);
+		return SR_ERR;
 	}
 
 	return SR_OK;
 }
 
+/**
+ * Convert one plane of an analog planar payload to an array of floats.
+ *
+ * @param[in] plane The plane to convert. Must not be NULL. plane->data
+ *                  and plane->encoding must not be NULL.
+ * @param[in] num_samples Number of samples in the plane.
+ * @param[out] outbuf Memory where to store the result, num_samples floats.
+ *                    Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Unsupported encoding.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_MALLOC Memory allocation failed.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_analog_plane_to_float(const struct sr_analog_plane *plane,
+		uint32_t num_samples, float *outbuf)
+{
+	struct sr_datafeed_analog analog;
+	struct sr_analog_meaning meaning;
+	GSList channels;
+	const uint8_t *src;
+	uint8_t *packed;
+	unsigned int unitsize, stride;
+	uint32_t i;
+	int ret;
+
+	if (!plane || !plane->data || !plane->encoding || !outbuf)
+		return SR_ERR_ARG;
+
+	unitsize = plane->encoding->unitsize;
+	stride = plane->stride ? plane->stride : unitsize;
+
+	/* sr_analog_to_float() takes the sample count from the channels. */
+	memset(&meaning, 0, sizeof(meaning));
+	channels.data = plane->channel;
+	channels.next = NULL;
+	meaning.channels = &channels;
+	analog.data = plane->data;
+	analog.num_samples = num_samples;
+	analog.encoding = plane->encoding;
+	analog.meaning = &meaning;
+	analog.spec = plane->spec;
+
+	if (stride == unitsize)
+		return sr_analog_to_float(&analog, outbuf);
+
+	if (!(packed = g_try_malloc(num_samples * unitsize)))
+		return SR_ERR_MALLOC;
+	src = plane->data;
+	for (i = 0; i < num_samples; i++)
+		memcpy(packed + i * unitsize, src + i * stride, unitsize);
+	analog.data = packed;
+	ret = sr_analog_to_float(&analog, outbuf);
+	g_free(packed);
+
+	return ret;
+}
+
+/**
+ * Convert an analog planar payload to an array of floats.
+ *
+ * The result is planar as well: all samples of the first plane, followed
+ * by all samples of the second plane, and so on.
+ *
+ * @param[in] planar The payload to convert. Must not be NULL.
+ * @param[out] outbuf Memory where to store the result,
+ *                    num_planes * num_samples floats. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Unsupported encoding.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_MALLOC Memory allocation failed.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_analog_planar_to_float(
+		const struct sr_datafeed_analog_planar *planar, float *outbuf)
+{
+	uint32_t i;
+	int ret;
+
+	if (!planar || (planar->num_planes && !planar->planes) || !outbuf)
+		return SR_ERR_ARG;
+
+	for (i = 0; i < planar->num_planes; i++) {
+		ret = sr_analog_plane_to_float(&planar->planes[i],
+			planar->num_samples, outbuf + i * planar->num_samples);
+		if (ret != SR_OK)
+			return ret;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Interleave packed planes into a single buffer.
+ *
+ * Sample i of plane k ends up at position i * num_planes + k of outbuf,
+ * which is the layout of a multi-channel SR_DF_ANALOG payload.
+ *
+ * @param[in] planes Array of num_planes pointers to num_samples packed
+ *                   samples each. Must not be NULL.
+ * @param[in] num_planes Number of planes.
+ * @param[in] unitsize Size of one sample in bytes.
+ * @param[in] num_samples Number of samples per plane.
+ * @param[out] outbuf Memory for num_planes * num_samples samples.
+ *                    Must not be NULL.
+ *
+ * @since 0.5.0
+ */
+SR_API void sr_analog_interleave(const void *const *planes,
+		unsigned int num_planes, unsigned int unitsize,
+		uint32_t num_samples, void *outbuf)
+{
+	const uint8_t *src;
+	uint8_t *dst;
+	unsigned int k;
+	uint32_t i;
+
+	if (!planes || !outbuf)
+		return;
+
+	for (k = 0; k < num_planes; k++) {
+		src = planes[k];
+		dst = (uint8_t *)outbuf + k * unitsize;
+		for (i = 0; i < num_samples; i++) {
+			memcpy(dst, src, unitsize);
+			src += unitsize;
+			dst += num_planes * unitsize;
+		}
+	}
+}
+
+/**
+ * Split an interleaved buffer into packed planes.
+ *
+ * This is the reverse of sr_analog_interleave().
+ *
+ * @param[in] inbuf num_planes * num_samples interleaved samples.
+ *                  Must not be NULL.
+ * @param[in] num_planes Number of planes.
+ * @param[in] unitsize Size of one sample in bytes.
+ * @param[in] num_samples Number of samples per plane.
+ * @param[out] planes Array of num_planes pointers to memory for
+ *                    num_samples samples each. Must not be NULL.
+ *
+ * @since 0.5.0
+ */
+SR_API void sr_analog_deinterleave(const void *inbuf,
+		unsigned int num_planes, unsigned int unitsize,
+		uint32_t num_samples, void *const *planes)
+{
+	const uint8_t *src;
+	uint8_t *dst;
+	unsigned int k;
+	uint32_t i;
+
+	if (!inbuf || !planes)
+		return;
+
+	for (k = 0; k < num_planes; k++) {
+		src = (const uint8_t *)inbuf + k * unitsize;
+		dst = planes[k];
+		for (i = 0; i < num_samples; i++) {
+			memcpy(dst, src, unitsize);
+			src += num_planes * unitsize;
+			dst += unitsize;
+		}
+	}
+}
+
 /**
  * Convert the unit/MQ/MQ flags in the analog struct to a string.
  *
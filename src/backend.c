@@ -129,6 +129,9 @@ static void print_versions(void)
 	const struct libusb_version *lv;
 #endif
 
+	if (sr_log_loglevel_get() < SR_LOG_DBG)
+		return;
+
 	s = g_string_sized_new(200);
 
 	sr_dbg("libsigrok %s/%s (rt: %s/%s).",
@@ -445,11 +448,30 @@ static int sanity_check_all_transform_modules(void)
 	return ret;
 }
 
+/*
+ * The sanity checks go over every driver and module, to catch mistakes
+ * made while writing them. Only run them when debugging, or when the
+ * environment asks for them, as the test suite does.
+ */
+static gboolean sanity_checks_wanted(void)
+{
+	return sr_log_loglevel_get() >= SR_LOG_DBG
+		|| g_getenv("LIBSIGROK_SANITY_CHECKS");
+}
+
 /**
  * Initialize libsigrok.
  *
  * This function must be called before any other libsigrok function.
  *
+ * The drivers are initialized on first use, or by sr_driver_init(). With
+ * several contexts at a time, the latter is needed to tell which context a
+ * driver belongs to. sr_exit() only cleans up the drivers of its context.
+ *
+ * The internal sanity checks of the drivers and modules only run with
+ * a loglevel of SR_LOG_DBG or higher, or with the LIBSIGROK_SANITY_CHECKS
+ * environment variable set.
+ *
  * @param ctx Pointer to a libsigrok context struct pointer. Must not be NULL.
  *            This will be a pointer to a newly allocated libsigrok context
  *            object upon success, and is undefined upon errors.
@@ -488,24 +510,26 @@ SR_API int sr_init(struct sr_context **ctx)
 	context->driver_list = (struct sr_dev_driver **)array->data;
 	g_array_free(array, FALSE);
 
-	if (sanity_check_all_drivers(context) < 0) {
-		sr_err("Internal driver error(s), aborting.");
-		return ret;
-	}
+	if (sanity_checks_wanted()) {
+		if (sanity_check_all_drivers(context) < 0) {
+			sr_err("Internal driver error(s), aborting.");
+			return ret;
+		}
 
-	if (sanity_check_all_input_modules() < 0) {
-		sr_err("Internal input module error(s), aborting.");
-		return ret;
-	}
+		if (sanity_check_all_input_modules() < 0) {
+			sr_err("Internal input module error(s), aborting.");
+			return ret;
+		}
 
-	if (sanity_check_all_output_modules() < 0) {
-		sr_err("Internal output module error(s), aborting.");
-		return ret;
-	}
+		if (sanity_check_all_output_modules() < 0) {
+			sr_err("Internal output module error(s), aborting.");
+			return ret;
+		}
 
-	if (sanity_check_all_transform_modules() < 0) {
-		sr_err("Internal transform module error(s), aborting.");
-		return ret;
+		if (sanity_check_all_transform_modules() < 0) {
+			sr_err("Internal transform module error(s), aborting.");
+			return ret;
+		}
 	}
 
 #ifdef _WIN32
@@ -525,6 +549,7 @@ SR_API int sr_init(struct sr_context **ctx)
 	}
 #endif
 	sr_resource_set_hooks(context, NULL, NULL, NULL, NULL);
+	sr_hw_context_add(context);
 
 	*ctx = context;
 	context = NULL;
@@ -554,6 +579,11 @@ SR_API int sr_exit(struct sr_context *ctx)
 		return SR_ERR;
 	}
 
+#ifdef HAVE_LIBUSB_1_0
+	if (ctx->hotplug)
+		sr_hotplug_unsubscribe(ctx);
+#endif
+
 	sr_hw_cleanup_all(ctx);
 
 #ifdef _WIN32
@@ -474,7 +474,8 @@ SR_PRIV void sr_usbtmc_dev_inst_free(struct sr_usbtmc_dev_inst *usbtmc)
  */
 SR_API GSList *sr_dev_list(const struct sr_dev_driver *driver)
 {
-	if (driver && driver->dev_list)
+	/* A driver which wasn't initialized yet knows no devices. */
+	if (driver && driver->context && driver->dev_list)
 		return driver->dev_list(driver);
 	else
 		return NULL;
@@ -500,6 +501,10 @@ SR_API int sr_dev_clear(const struct sr_dev_driver *driver)
 		return SR_ERR_ARG;
 	}
 
+	if (!driver->context)
+		/* Driver was never initialized, nothing to do. */
+		return SR_OK;
+
 	if (driver->dev_clear)
 		ret = driver->dev_clear(driver);
 	else
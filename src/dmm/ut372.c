@@ -88,10 +88,11 @@ SR_PRIV gboolean sr_ut372_packet_valid(const uint8_t *buf)
 }
 
 SR_PRIV int sr_ut372_parse(const uint8_t *buf, float *floatval,
-		struct sr_datafeed_analog_old *analog, void *info)
+		struct sr_datafeed_analog *analog, void *info)
 {
 	unsigned int i, j, value, divisor;
 	uint8_t segments, flags1, flags2;
+	int digits;
 
 	(void) info;
 
@@ -99,24 +100,25 @@ SR_PRIV int sr_ut372_parse(const uint8_t *buf, float *floatval,
 	flags2 = decode_pair(buf + 23);
 
 	if (flags2 & FLAGS2_RPM_MASK) {
-		analog->mq = SR_MQ_FREQUENCY;
-		analog->unit = SR_UNIT_REVOLUTIONS_PER_MINUTE;
+		analog->meaning->mq = SR_MQ_FREQUENCY;
+		analog->meaning->unit = SR_UNIT_REVOLUTIONS_PER_MINUTE;
 	} else if (flags2 & FLAGS2_COUNT_MASK) {
-		analog->mq = SR_MQ_COUNT;
-		analog->unit = SR_UNIT_UNITLESS;
+		analog->meaning->mq = SR_MQ_COUNT;
+		analog->meaning->unit = SR_UNIT_UNITLESS;
 	}
 
 	if (flags1 & FLAGS1_HOLD_MASK)
-		analog->mqflags |= SR_MQFLAG_HOLD;
+		analog->meaning->mqflags |= SR_MQFLAG_HOLD;
 	if (flags2 & FLAGS2_MIN_MASK)
-		analog->mqflags |= SR_MQFLAG_MIN;
+		analog->meaning->mqflags |= SR_MQFLAG_MIN;
 	if (flags2 & FLAGS2_MAX_MASK)
-		analog->mqflags |= SR_MQFLAG_MAX;
+		analog->meaning->mqflags |= SR_MQFLAG_MAX;
 	if (flags2 & FLAGS2_AVG_MASK)
-		analog->mqflags |= SR_MQFLAG_AVG;
+		analog->meaning->mqflags |= SR_MQFLAG_AVG;
 
 	value = 0;
 	divisor = 1;
+	digits = 0;
 
 	for (i = 0; i < 5; i++) {
 		segments = decode_pair(buf + 1 + (2 * i));
@@ -126,11 +128,15 @@ SR_PRIV int sr_ut372_parse(const uint8_t *buf, float *floatval,
 				break;
 			}
 		}
-		if (segments & DECIMAL_POINT_MASK)
+		if (segments & DECIMAL_POINT_MASK) {
 			divisor = pow(10, i);
+			digits = i;
+		}
 	}
 
 	*floatval = (float) value / divisor;
+	analog->encoding->digits = digits;
+	analog->spec->spec_digits = digits;
 
 	return SR_OK;
 }
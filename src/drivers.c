@@ -143,6 +143,9 @@ extern SR_PRIV struct sr_dev_driver ols_driver_info;
 #ifdef HAVE_HW_PIPISTRELLO_OLS
 extern SR_PRIV struct sr_dev_driver p_ols_driver_info;
 #endif
+#ifdef HAVE_HW_REMOTE_LOCAL
+extern SR_PRIV struct sr_dev_driver remote_local_driver_info;
+#endif
 #ifdef HAVE_HW_RIGOL_DS
 extern SR_PRIV struct sr_dev_driver rigol_ds_driver_info;
 #endif
@@ -319,6 +322,9 @@ SR_PRIV struct sr_dev_driver **drivers_lists[] = {
 #ifdef HAVE_HW_PIPISTRELLO_OLS
 	(DRVS) {&p_ols_driver_info, NULL},
 #endif
+#ifdef HAVE_HW_REMOTE_LOCAL
+	(DRVS) {&remote_local_driver_info, NULL},
+#endif
 #ifdef HAVE_HW_RIGOL_DS
 	(DRVS) {&rigol_ds_driver_info, NULL},
 #endif
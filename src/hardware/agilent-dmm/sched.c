@@ -264,10 +264,14 @@ static int recv_fetc(const struct sr_dev_inst *sdi, GMatchInfo *match)
 {
 	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog_old analog;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 	float fvalue;
 	const char *s;
 	char *mstr;
+	int digits;
 
 	sr_spew("FETC reply '%s'.", g_match_info_get_string(match));
 	devc = sdi->priv;
@@ -284,6 +288,7 @@ static int recv_fetc(const struct sr_dev_inst *sdi, GMatchInfo *match)
 		 * comes through like this. Since comparing 38-digit floats
 		 * is rather problematic, we'll cut through this here. */
 		fvalue = NAN;
+		digits = 0;
 	} else {
 		mstr = g_match_info_fetch(match, 1);
 		if (sr_atof_ascii(mstr, &fvalue) != SR_OK) {
@@ -291,19 +296,23 @@ static int recv_fetc(const struct sr_dev_inst *sdi, GMatchInfo *match)
 			sr_dbg("Invalid float.");
 			return SR_ERR;
 		}
+		/* The reply always has 8 decimals: "+1.23456789E+03". */
+		digits = 8 - strtol(mstr + 12, NULL, 10);
 		g_free(mstr);
-		if (devc->cur_divider > 0)
+		if (devc->cur_divider > 0) {
 			fvalue /= devc->cur_divider;
+			digits += lrint(log10(devc->cur_divider));
+		}
 	}
 
-	memset(&analog, 0, sizeof(struct sr_datafeed_analog_old));
-	analog.mq = devc->cur_mq;
-	analog.unit = devc->cur_unit;
-	analog.mqflags = devc->cur_mqflags;
-	analog.channels = sdi->channels;
+	sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
+	analog.meaning->mq = devc->cur_mq;
+	analog.meaning->unit = devc->cur_unit;
+	analog.meaning->mqflags = devc->cur_mqflags;
+	analog.meaning->channels = sdi->channels;
 	analog.num_samples = 1;
 	analog.data = &fvalue;
-	packet.type = SR_DF_ANALOG_OLD;
+	packet.type = SR_DF_ANALOG;
 	packet.payload = &analog;
 	sr_session_send(devc->cb_data, &packet);
 
@@ -70,7 +70,7 @@ static uint64_t appa_55ii_flags(const uint8_t *buf)
 	return flags;
 }
 
-static float appa_55ii_temp(const uint8_t *buf, int ch)
+static float appa_55ii_temp(const uint8_t *buf, int ch, int *digits)
 {
 	const uint8_t *ptr;
 	int16_t temp;
@@ -80,22 +80,27 @@ static float appa_55ii_temp(const uint8_t *buf, int ch)
 	temp = RL16(ptr);
 	flags = ptr[2];
 
-	if (flags & 0x60)
+	if (flags & 0x60) {
 		return INFINITY;
-	else if (flags & 1)
+	} else if (flags & 1) {
+		*digits = 1;
 		return (float)temp / 10;
-	else
+	} else {
 		return (float)temp;
+	}
 }
 
 static void appa_55ii_live_data(struct sr_dev_inst *sdi, const uint8_t *buf)
 {
 	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog_old analog;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 	struct sr_channel *ch;
 	float values[APPA_55II_NUM_CHANNELS], *val_ptr;
-	int i;
+	int i, digits;
 
 	devc = sdi->priv;
 
@@ -103,25 +108,29 @@ static void appa_55ii_live_data(struct sr_dev_inst *sdi, const uint8_t *buf)
 		return;
 
 	val_ptr = values;
-	memset(&analog, 0, sizeof(struct sr_datafeed_analog_old));
+	digits = 0;
+	sr_analog_init(&analog, &encoding, &meaning, &spec, 0);
 	analog.num_samples = 1;
-	analog.mq = SR_MQ_TEMPERATURE;
-	analog.unit = SR_UNIT_CELSIUS;
-	analog.mqflags = appa_55ii_flags(buf);
+	analog.meaning->mq = SR_MQ_TEMPERATURE;
+	analog.meaning->unit = SR_UNIT_CELSIUS;
+	analog.meaning->mqflags = appa_55ii_flags(buf);
 	analog.data = values;
 
 	for (i = 0; i < APPA_55II_NUM_CHANNELS; i++) {
 		ch = g_slist_nth_data(sdi->channels, i);
 		if (!ch->enabled)
 			continue;
-		analog.channels = g_slist_append(analog.channels, ch);
-		*val_ptr++ = appa_55ii_temp(buf, i);
+		analog.meaning->channels = g_slist_append(
+				analog.meaning->channels, ch);
+		*val_ptr++ = appa_55ii_temp(buf, i, &digits);
 	}
+	analog.encoding->digits = digits;
+	analog.spec->spec_digits = digits;
 
-	packet.type = SR_DF_ANALOG_OLD;
+	packet.type = SR_DF_ANALOG;
 	packet.payload = &analog;
 	sr_session_send(devc->session_cb_data, &packet);
-	g_slist_free(analog.channels);
+	g_slist_free(analog.meaning->channels);
 
 	devc->num_samples++;
 }
@@ -138,7 +147,10 @@ static void appa_55ii_log_data_parse(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog_old analog;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 	struct sr_channel *ch;
 	float values[APPA_55II_NUM_CHANNELS], *val_ptr;
 	const uint8_t *buf;
@@ -155,10 +167,11 @@ static void appa_55ii_log_data_parse(struct sr_dev_inst *sdi)
 		/* FIXME: Timestamp should be sent in the packet. */
 		sr_dbg("Timestamp: %02d:%02d:%02d", buf[2], buf[3], buf[4]);
 
-		memset(&analog, 0, sizeof(struct sr_datafeed_analog_old));
+		/* Logged temperatures are always in 0.1 degree steps. */
+		sr_analog_init(&analog, &encoding, &meaning, &spec, 1);
 		analog.num_samples = 1;
-		analog.mq = SR_MQ_TEMPERATURE;
-		analog.unit = SR_UNIT_CELSIUS;
+		analog.meaning->mq = SR_MQ_TEMPERATURE;
+		analog.meaning->unit = SR_UNIT_CELSIUS;
 		analog.data = values;
 
 		for (i = 0; i < APPA_55II_NUM_CHANNELS; i++) {
@@ -166,14 +179,15 @@ static void appa_55ii_log_data_parse(struct sr_dev_inst *sdi)
 			ch = g_slist_nth_data(sdi->channels, i);
 			if (!ch->enabled)
 				continue;
-			analog.channels = g_slist_append(analog.channels, ch);
+			analog.meaning->channels = g_slist_append(
+					analog.meaning->channels, ch);
 			*val_ptr++ = temp == 0x7FFF ? INFINITY : (float)temp / 10;
 		}
 
-		packet.type = SR_DF_ANALOG_OLD;
+		packet.type = SR_DF_ANALOG;
 		packet.payload = &analog;
 		sr_session_send(devc->session_cb_data, &packet);
-		g_slist_free(analog.channels);
+		g_slist_free(analog.meaning->channels);
 
 		devc->num_samples++;
 		devc->log_buf_len -= 20;
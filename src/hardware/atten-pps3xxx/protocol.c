@@ -37,37 +37,44 @@ static void handle_packet(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog_old analog;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 	float value, data[MAX_CHANNELS];
 	int offset, i;
 
 	devc = sdi->priv;
 	dump_packet("received", devc->packet);
-	packet.type = SR_DF_ANALOG_OLD;
+	packet.type = SR_DF_ANALOG;
 	packet.payload = &analog;
-	analog.channels = sdi->channels;
+	sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
+	analog.meaning->channels = sdi->channels;
 	analog.num_samples = 1;
 
-	analog.mq = SR_MQ_VOLTAGE;
-	analog.unit = SR_UNIT_VOLT;
-	analog.mqflags = SR_MQFLAG_DC;
+	/* Voltages come in 10 mV steps, currents in 1 mA steps. */
+	analog.meaning->mq = SR_MQ_VOLTAGE;
+	analog.meaning->unit = SR_UNIT_VOLT;
+	analog.meaning->mqflags = SR_MQFLAG_DC;
 	analog.data = data;
 	for (i = 0; i < devc->model->num_channels; i++) {
 		offset = 2 + i * 4;
 		value = ((devc->packet[offset] << 8) + devc->packet[offset + 1]) / 100.0;
-		analog.data[i] = value;
+		data[i] = value;
 		devc->config[i].output_voltage_last = value;
 	}
 	sr_session_send(sdi, &packet);
 
-	analog.mq = SR_MQ_CURRENT;
-	analog.unit = SR_UNIT_AMPERE;
-	analog.mqflags = 0;
+	analog.meaning->mq = SR_MQ_CURRENT;
+	analog.meaning->unit = SR_UNIT_AMPERE;
+	analog.meaning->mqflags = 0;
+	analog.encoding->digits = 3;
+	analog.spec->spec_digits = 3;
 	analog.data = data;
 	for (i = 0; i < devc->model->num_channels; i++) {
 		offset = 4 + i * 4;
 		value = ((devc->packet[offset] << 8) + devc->packet[offset + 1]) / 1000.0;
-		analog.data[i] = value;
+		data[i] = value;
 		devc->config[i].output_current_last = value;
 	}
 	sr_session_send(sdi, &packet);
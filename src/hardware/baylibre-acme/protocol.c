@@ -697,7 +697,10 @@ SR_PRIV int bl_acme_receive_data(int fd, int revents, void *cb_data)
 	uint32_t cur_time, elapsed_time;
 	uint64_t nrexpiration;
 	struct sr_datafeed_packet packet, framep;
-	struct sr_datafeed_analog_old analog;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 	struct sr_dev_inst *sdi;
 	struct sr_channel *ch;
 	struct channel_priv *chp;
@@ -716,9 +719,9 @@ SR_PRIV int bl_acme_receive_data(int fd, int revents, void *cb_data)
 	if (!devc)
 		return TRUE;
 
-	packet.type = SR_DF_ANALOG_OLD;
+	packet.type = SR_DF_ANALOG;
 	packet.payload = &analog;
-	memset(&analog, 0, sizeof(struct sr_datafeed_analog_old));
+	sr_analog_init(&analog, &encoding, &meaning, &spec, 0);
 
 	if (read(devc->timer_fd, &nrexpiration, sizeof(nrexpiration)) < 0) {
 		sr_warn("Failed to read timer information");
@@ -764,10 +767,14 @@ SR_PRIV int bl_acme_receive_data(int fd, int revents, void *cb_data)
 				continue;
 			chonly.next = NULL;
 			chonly.data = ch;
-			analog.channels = &chonly;
+			analog.meaning->channels = &chonly;
 			analog.num_samples = 1;
-			analog.mq = channel_to_mq(chl->data);
-			analog.unit = channel_to_unit(ch);
+			analog.meaning->mq = channel_to_mq(chl->data);
+			analog.meaning->unit = channel_to_unit(ch);
+			/* hwmon reports uW for power, mA, mV and mC otherwise. */
+			analog.encoding->digits =
+				chp->ch_type == ENRG_PWR ? 6 : 3;
+			analog.spec->spec_digits = analog.encoding->digits;
 
 			if (i < 1)
 				chp->val = read_sample(ch);
@@ -46,6 +46,11 @@ static const int32_t soft_trigger_matches[] = {
 	SR_TRIGGER_RISING,
 	SR_TRIGGER_FALLING,
 	SR_TRIGGER_EDGE,
+	SR_TRIGGER_UART,
+	SR_TRIGGER_SPI,
+	SR_TRIGGER_I2C,
+	SR_TRIGGER_PULSE,
+	SR_TRIGGER_TIMEOUT,
 };
 
 SR_PRIV const char *channel_names[] = {
@@ -97,6 +97,22 @@ SR_PRIV int beaglelogic_receive_data(int fd, int revents, void *cb_data)
 		}
 	}
 
+	/*
+	 * The kernel module flags an error when the capture overran the
+	 * buffer before we got to it. It stops capturing then, so the
+	 * rest of the requested samples are lost.
+	 */
+	if ((revents & G_IO_ERR) && devc->trigger_fired) {
+		beaglelogic_getlasterror(devc);
+		sr_warn("Buffer overrun (error %d).", devc->last_error);
+		if (devc->bytes_read < devc->limit_samples * logic.unitsize) {
+			std_session_send_df_gap(devc->cb_data,
+				devc->bytes_read / logic.unitsize,
+				devc->limit_samples - devc->bytes_read / logic.unitsize);
+			devc->bytes_read = devc->limit_samples * logic.unitsize;
+		}
+	}
+
 	/* EOF Received or we have reached the limit */
 	if (devc->bytes_read >= devc->limit_samples * logic.unitsize ||
 			packetsize == 0) {
@@ -20,6 +20,8 @@
 #include <config.h>
 #include "protocol.h"
 
+#define BRYMEN_BC86X_VID 0x0820
+#define BRYMEN_BC86X_PID 0x0001
 #define BRYMEN_BC86X "0820.0001"
 
 static const uint32_t scanopts[] = {
@@ -97,6 +99,14 @@ static GSList *dev_list(const struct sr_dev_driver *di)
 	return ((struct drv_context *)(di->context))->instances;
 }
 
+static GSList *usb_ids(const struct sr_dev_driver *di)
+{
+	(void)di;
+
+	return usb_id_append(NULL, BRYMEN_BC86X_VID, BRYMEN_BC86X_PID,
+			NULL, NULL);
+}
+
 static int dev_open(struct sr_dev_inst *sdi)
 {
 	struct sr_dev_driver *di = sdi->driver;
@@ -298,6 +308,7 @@ SR_PRIV struct sr_dev_driver brymen_bm86x_driver_info = {
 	.scan = scan,
 	.dev_list = dev_list,
 	.dev_clear = NULL,
+	.usb_ids = usb_ids,
 	.config_get = config_get,
 	.config_set = config_set,
 	.config_list = config_list,
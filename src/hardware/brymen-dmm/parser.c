@@ -148,10 +148,11 @@ SR_PRIV gboolean brymen_packet_is_valid(const uint8_t *buf)
 	return TRUE;
 }
 
-static int parse_value(const char *strbuf, int len, float *floatval)
+static int parse_value(const char *strbuf, int len, float *floatval,
+		int *digits)
 {
 	int s, d;
-	char str[32];
+	char str[32], *p;
 
 	if (strstr(strbuf, "OL")) {
 		sr_dbg("Overlimit.");
@@ -168,6 +169,13 @@ static int parse_value(const char *strbuf, int len, float *floatval)
 	if (sr_atof_ascii(str, floatval) != SR_OK)
 		return SR_ERR;
 
+	/* Digits shown after the point, less the exponent, e.g. "1.234E+3". */
+	*digits = 0;
+	if ((p = strchr(str, '.')))
+		*digits = strspn(p + 1, "0123456789");
+	if ((p = strpbrk(str, "Ee")))
+		*digits -= strtol(p + 1, NULL, 10);
+
 	return SR_OK;
 }
 
@@ -192,19 +200,19 @@ static void parse_flags(const uint8_t *buf, struct brymen_flags *info)
 }
 
 SR_PRIV int brymen_parse(const uint8_t *buf, float *floatval,
-		struct sr_datafeed_analog_old *analog, void *info)
+		struct sr_datafeed_analog *analog, void *info)
 {
 	struct brymen_flags flags;
 	struct brymen_header *hdr;
 	uint8_t *bfunc;
-	int asciilen;
+	int asciilen, digits;
 
 	(void)info;
 
 	hdr = (void *)buf;
 	bfunc = (uint8_t *)(buf + sizeof(struct brymen_header));
 
-	analog->mqflags = 0;
+	analog->meaning->mqflags = 0;
 
 	/* Give some debug info about the package. */
 	asciilen = hdr->len - 4;
@@ -214,47 +222,48 @@ SR_PRIV int brymen_parse(const uint8_t *buf, float *floatval,
 	sr_dbg("DMM packet: \"%.*s\"", asciilen, bfunc + 4);
 
 	parse_flags(buf, &flags);
-	if (parse_value((const char *)(bfunc + 4), asciilen, floatval) != SR_OK)
+	if (parse_value((const char *)(bfunc + 4), asciilen, floatval,
+			&digits) != SR_OK)
 		return SR_ERR;
 
 	if (flags.is_volt) {
-		analog->mq = SR_MQ_VOLTAGE;
-		analog->unit = SR_UNIT_VOLT;
+		analog->meaning->mq = SR_MQ_VOLTAGE;
+		analog->meaning->unit = SR_UNIT_VOLT;
 	}
 	if (flags.is_amp) {
-		analog->mq = SR_MQ_CURRENT;
-		analog->unit = SR_UNIT_AMPERE;
+		analog->meaning->mq = SR_MQ_CURRENT;
+		analog->meaning->unit = SR_UNIT_AMPERE;
 	}
 	if (flags.is_ohm) {
 		if (flags.is_beep)
-			analog->mq = SR_MQ_CONTINUITY;
+			analog->meaning->mq = SR_MQ_CONTINUITY;
 		else
-			analog->mq = SR_MQ_RESISTANCE;
-		analog->unit = SR_UNIT_OHM;
+			analog->meaning->mq = SR_MQ_RESISTANCE;
+		analog->meaning->unit = SR_UNIT_OHM;
 	}
 	if (flags.is_hertz) {
-		analog->mq = SR_MQ_FREQUENCY;
-		analog->unit = SR_UNIT_HERTZ;
+		analog->meaning->mq = SR_MQ_FREQUENCY;
+		analog->meaning->unit = SR_UNIT_HERTZ;
 	}
 	if (flags.is_duty_cycle) {
-		analog->mq = SR_MQ_DUTY_CYCLE;
-		analog->unit = SR_UNIT_PERCENTAGE;
+		analog->meaning->mq = SR_MQ_DUTY_CYCLE;
+		analog->meaning->unit = SR_UNIT_PERCENTAGE;
 	}
 	if (flags.is_capacitance) {
-		analog->mq = SR_MQ_CAPACITANCE;
-		analog->unit = SR_UNIT_FARAD;
+		analog->meaning->mq = SR_MQ_CAPACITANCE;
+		analog->meaning->unit = SR_UNIT_FARAD;
 	}
 	if (flags.is_fahrenheit) {
-		analog->mq = SR_MQ_TEMPERATURE;
-		analog->unit = SR_UNIT_FAHRENHEIT;
+		analog->meaning->mq = SR_MQ_TEMPERATURE;
+		analog->meaning->unit = SR_UNIT_FAHRENHEIT;
 	}
 	if (flags.is_celsius) {
-		analog->mq = SR_MQ_TEMPERATURE;
-		analog->unit = SR_UNIT_CELSIUS;
+		analog->meaning->mq = SR_MQ_TEMPERATURE;
+		analog->meaning->unit = SR_UNIT_CELSIUS;
 	}
 	if (flags.is_capacitance) {
-		analog->mq = SR_MQ_CAPACITANCE;
-		analog->unit = SR_UNIT_FARAD;
+		analog->meaning->mq = SR_MQ_CAPACITANCE;
+		analog->meaning->unit = SR_UNIT_FARAD;
 	}
 
 	/*
@@ -265,26 +274,30 @@ SR_PRIV int brymen_parse(const uint8_t *buf, float *floatval,
 	 * identify the value as ohm, not dBmW.
 	 */
 	if (flags.is_decibel && !flags.is_ohm) {
-		analog->mq = SR_MQ_POWER;
-		analog->unit = SR_UNIT_DECIBEL_MW;
+		analog->meaning->mq = SR_MQ_POWER;
+		analog->meaning->unit = SR_UNIT_DECIBEL_MW;
 		/*
 		 * For some reason, dBm measurements are sent by the multimeter
 		 * with a value three orders of magnitude smaller than the
 		 * displayed value.
 		 */
 		*floatval *= 1000;
+		digits -= 3;
 	}
 
 	if (flags.is_diode)
-		analog->mqflags |= SR_MQFLAG_DIODE;
+		analog->meaning->mqflags |= SR_MQFLAG_DIODE;
 	/* We can have both AC+DC in a single measurement. */
 	if (flags.is_ac)
-		analog->mqflags |= SR_MQFLAG_AC;
+		analog->meaning->mqflags |= SR_MQFLAG_AC;
 	if (flags.is_dc)
-		analog->mqflags |= SR_MQFLAG_DC;
+		analog->meaning->mqflags |= SR_MQFLAG_DC;
 
 	if (flags.is_low_batt)
 		sr_info("Low battery!");
 
+	analog->encoding->digits = digits;
+	analog->spec->spec_digits = digits;
+
 	return SR_OK;
 }
@@ -93,14 +93,14 @@ static int add_device(int model, struct libusb_device_descriptor *des,
 	devc->limit_msec = 0;
 	devc->limit_samples = 0;
 	devc->cb_data = NULL;
-	memset(devc->mangled_buf, 0, BS);
+	memset(devc->mangled_buf, 0, sizeof(devc->mangled_buf));
 	devc->final_buf = NULL;
 	devc->trigger_pattern = 0x0000; /* Irrelevant, see trigger_mask. */
 	devc->trigger_mask = 0x0000; /* All channels: "don't care". */
 	devc->trigger_edgemask = 0x0000; /* All channels: "state triggered". */
 	devc->trigger_found = 0;
 	devc->done = 0;
-	devc->block_counter = 0;
+	devc->bytes_received = 0;
 	devc->divcount = 0;
 	devc->usb_vid = des->idVendor;
 	devc->usb_pid = des->idProduct;
@@ -251,6 +251,22 @@ static GSList *dev_list(const struct sr_dev_driver *di)
 	return ((struct drv_context *)(di->context))->instances;
 }
 
+/* The FTDI default IDs aren't enough, the product string tells the model. */
+static GSList *usb_ids(const struct sr_dev_driver *di)
+{
+	GSList *ids;
+	int i;
+
+	(void)di;
+
+	ids = NULL;
+	for (i = 0; cv_profiles[i].iproduct; i++)
+		ids = usb_id_append(ids, FTDI_VID, FTDI_PID, NULL,
+				cv_profiles[i].iproduct);
+
+	return ids;
+}
+
 static int dev_open(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
@@ -293,6 +309,11 @@ static int dev_open(struct sr_dev_inst *sdi)
 	}
 	sr_dbg("FTDI flow control enabled successfully.");
 
+	/* Use large USB transfers for reading the sample data. */
+	if (ftdi_read_data_set_chunksize(devc->ftdic, XFER_SIZE) < 0)
+		sr_warn("Failed to set FTDI read chunksize: %s.",
+			ftdi_get_error_string(devc->ftdic));
+
 	/* Wait 100ms. */
 	g_usleep(100 * 1000);
 
@@ -453,7 +474,7 @@ static int config_list(uint32_t key, GVariant **data, const struct sr_dev_inst *
 
 static int receive_data(int fd, int revents, void *cb_data)
 {
-	int i, ret;
+	int ret;
 	struct sr_dev_inst *sdi;
 	struct dev_context *devc;
 
@@ -475,31 +496,28 @@ static int receive_data(int fd, int revents, void *cb_data)
 		return FALSE;
 	}
 
-	/* Get one block of data. */
-	if ((ret = cv_read_block(devc)) < 0) {
-		sr_err("Failed to read data block: %d.", ret);
+	/* Get the next chunk of data. */
+	if ((ret = cv_read_data(devc)) < 0) {
+		sr_err("Failed to read data: %d.", ret);
 		dev_acquisition_stop(sdi, sdi);
 		return FALSE;
 	}
 
-	/* We need to get exactly NUM_BLOCKS blocks (i.e. 8MB) of data. */
-	if (devc->block_counter != (NUM_BLOCKS - 1)) {
-		devc->block_counter++;
-		return TRUE;
-	}
-
-	sr_dbg("Sampling finished, sending data to session bus now.");
-
 	/*
-	 * All data was received and demangled, send it to the session bus.
+	 * Send all samples which are complete by now to the session bus.
 	 *
 	 * Note: Due to the method how data is spread across the 8MByte of
-	 * SDRAM, we can _not_ send it to the session bus in a streaming
-	 * manner while we receive it. We have to receive and de-mangle the
-	 * full 8MByte first, only then the whole buffer contains valid data.
+	 * SDRAM, the first samples only become valid once the last MByte
+	 * is being received. From there on, data is sent in a streaming
+	 * manner while the next chunk is being received.
 	 */
-	for (i = 0; i < NUM_BLOCKS; i++)
-		cv_send_block_to_session_bus(devc, i);
+	cv_send_data_to_session_bus(devc);
+
+	/* We need to get exactly SDRAM_SIZE bytes (i.e. 8MB) of data. */
+	if (devc->bytes_received != SDRAM_SIZE)
+		return TRUE;
+
+	sr_dbg("Sampling finished.");
 
 	dev_acquisition_stop(sdi, sdi);
 
@@ -573,7 +591,9 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 	/* Time when we should be done (for detecting trigger timeouts). */
 	devc->done = (devc->divcount + 1) * devc->prof->trigger_constant +
 			g_get_monotonic_time() + (10 * G_TIME_SPAN_SECOND);
-	devc->block_counter = 0;
+	devc->bytes_requested = 0;
+	devc->bytes_received = 0;
+	devc->bytes_sent = 0;
 	devc->trigger_found = 0;
 
 	/* Hook up a dummy handler to receive data from the device. */
@@ -585,12 +605,19 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 static int dev_acquisition_stop(struct sr_dev_inst *sdi, void *cb_data)
 {
 	struct sr_datafeed_packet packet;
+	struct dev_context *devc;
 
 	(void)cb_data;
 
+	devc = sdi->priv;
+
 	sr_dbg("Stopping acquisition.");
 	sr_session_source_remove(sdi->session, -1);
 
+	/* Don't leave an asynchronous read pending on the device. */
+	if (devc->ftdic)
+		cv_read_abort(devc);
+
 	/* Send end packet to the session bus. */
 	sr_dbg("Sending SR_DF_END.");
 	packet.type = SR_DF_END;
@@ -608,6 +635,7 @@ SR_PRIV struct sr_dev_driver chronovu_la_driver_info = {
 	.scan = scan,
 	.dev_list = dev_list,
 	.dev_clear = dev_clear,
+	.usb_ids = usb_ids,
 	.config_get = config_get,
 	.config_set = config_set,
 	.config_list = config_list,
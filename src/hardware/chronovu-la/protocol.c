@@ -344,121 +344,292 @@ SR_PRIV int cv_set_samplerate(const struct sr_dev_inst *sdi, uint64_t samplerate
 }
 
 /**
- * Get a block of data from the device.
+ * De-mangle a chunk of raw data from the device into the final buffer.
+ *
+ * The 8MB of SDRAM are split into eight 1MB chunks, and consecutive samples
+ * are spread across all of them. Byte k of chunk m ends up at sample
+ * position (k / 2) * 16 + m * 2 (LA8), or (k / 4) * 32 + m * 4 (LA16).
+ *
+ * For the LA16 the byte swap of the 16-bit samples is folded into this
+ * step, i.e. the final buffer directly holds little-endian samples.
+ *
+ * @param devc The struct containing private per-device-instance data.
+ * @param buf The raw data as received from the device.
+ * @param offset The SDRAM byte offset of buf[0]. Must be a multiple of 4.
+ * @param len The number of bytes in buf. Must be a multiple of 4, and
+ *            buf must not cross a 1MB chunk boundary.
+ */
+static void demangle(struct dev_context *devc, const uint8_t *buf,
+		     uint32_t offset, int len)
+{
+	int i, m;
+	uint8_t *dst;
+
+	m = offset / (1024 * 1024);
+	offset -= m * (1024 * 1024);
+
+	if (devc->prof->model == CHRONOVU_LA8) {
+		dst = devc->final_buf + (m * 2) + (offset / 2) * 16;
+		if (devc->divcount == 0) {
+			for (i = 0; i < len; i += 2, dst += 16) {
+				dst[0] = buf[i];
+				dst[1] = buf[i + 1];
+			}
+		} else {
+			for (i = 0; i < len; i += 2, dst += 16) {
+				dst[0] = buf[i + 1];
+				dst[1] = buf[i];
+			}
+		}
+	} else {
+		dst = devc->final_buf + (m * 4) + (offset / 4) * 32;
+		for (i = 0; i < len; i += 4, dst += 32)
+			memcpy(dst, buf + i, 4);
+	}
+}
+
+/*
+ * Size of the next read: the first read only fetches a single block (it
+ * has to wait for the trigger), later reads are aligned to XFER_SIZE.
+ */
+static int next_xfer_len(struct dev_context *devc)
+{
+	uint32_t remaining;
+
+	if (devc->bytes_requested == 0)
+		return BS;
+
+	remaining = SDRAM_SIZE - devc->bytes_requested;
+
+	return MIN(XFER_SIZE - (devc->bytes_requested % XFER_SIZE), remaining);
+}
+
+#ifdef HAVE_FTDI_READ_DATA_SUBMIT
+/**
+ * Queue an asynchronous read for the next chunk of data (if any).
+ *
+ * @param devc The struct containing private per-device-instance data.
+ *
+ * @return SR_OK upon success, or SR_ERR upon errors.
+ */
+static int submit_next_read(struct dev_context *devc)
+{
+	if (devc->bytes_requested == SDRAM_SIZE)
+		return SR_OK;
+
+	devc->cur_buf ^= 1;
+	devc->xfer_len = next_xfer_len(devc);
+	devc->tc = ftdi_read_data_submit(devc->ftdic,
+			devc->mangled_buf[devc->cur_buf], devc->xfer_len);
+	if (!devc->tc) {
+		sr_err("Failed to submit read: %s.",
+		       ftdi_get_error_string(devc->ftdic));
+		return SR_ERR;
+	}
+	devc->bytes_requested += devc->xfer_len;
+
+	return SR_OK;
+}
+#endif
+
+/**
+ * Wait for the trigger and get the first block of data from the device.
  *
  * @param devc The struct containing private per-device-instance data. Must not
  *             be NULL. devc->ftdic must not be NULL either.
  *
- * @return SR_OK upon success, or SR_ERR upon errors.
+ * @return The number of bytes read, or a negative value upon errors.
  */
-SR_PRIV int cv_read_block(struct dev_context *devc)
+static int read_first_block(struct dev_context *devc)
 {
-	int i, byte_offset, m, mi, p, q, index, bytes_read;
+	int bytes_read;
 	gint64 now;
 
-	/* Note: Caller checked that devc and devc->ftdic != NULL. */
+	devc->cur_buf = 0;
+	devc->xfer_len = next_xfer_len(devc);
 
-	sr_spew("Reading block %d.", devc->block_counter);
+	sr_spew("Reading block 0.");
 
-	bytes_read = cv_read(devc, devc->mangled_buf, BS);
+	bytes_read = cv_read(devc, devc->mangled_buf[0], devc->xfer_len);
 
 	/* If first block read got 0 bytes, retry until success or timeout. */
-	if ((bytes_read == 0) && (devc->block_counter == 0)) {
+	if (bytes_read == 0) {
 		do {
 			sr_spew("Reading block 0 (again).");
 			/* Note: If bytes_read < 0 cv_read() will log errors. */
-			bytes_read = cv_read(devc, devc->mangled_buf, BS);
+			bytes_read = cv_read(devc, devc->mangled_buf[0],
+					     devc->xfer_len);
 			now = g_get_monotonic_time();
 		} while ((devc->done > now) && (bytes_read == 0));
 	}
 
-	/* Check if block read was successful or a timeout occurred. */
-	if (bytes_read != BS) {
-		sr_err("Trigger timed out. Bytes read: %d.", bytes_read);
+	if (bytes_read == devc->xfer_len) {
+		devc->bytes_requested += devc->xfer_len;
+		devc->download_start = g_get_monotonic_time();
+	}
+
+	return bytes_read;
+}
+
+/**
+ * Get the next chunk of data from the device and de-mangle it.
+ *
+ * If asynchronous reads are supported by libftdi, the read for the
+ * following chunk is queued before the current one gets de-mangled, so
+ * that the USB transfer and the processing overlap.
+ *
+ * @param devc The struct containing private per-device-instance data. Must not
+ *             be NULL. devc->ftdic must not be NULL either.
+ *
+ * @return SR_OK upon success, or SR_ERR upon errors.
+ */
+SR_PRIV int cv_read_data(struct dev_context *devc)
+{
+	int bytes_read, len;
+	uint8_t *buf;
+
+	/* Note: Caller checked that devc and devc->ftdic != NULL. */
+
+	if (devc->bytes_received == 0) {
+		bytes_read = read_first_block(devc);
+	} else {
+		sr_spew("Reading %d bytes at offset %u.", devc->xfer_len,
+			devc->bytes_received);
+#ifdef HAVE_FTDI_READ_DATA_SUBMIT
+		bytes_read = ftdi_transfer_data_done(devc->tc);
+		devc->tc = NULL;
+		if (bytes_read < 0)
+			sr_err("Failed to read data (%d): %s.", bytes_read,
+			       ftdi_get_error_string(devc->ftdic));
+#else
+		devc->xfer_len = next_xfer_len(devc);
+		bytes_read = cv_read(devc, devc->mangled_buf[0],
+				     devc->xfer_len);
+		devc->bytes_requested += devc->xfer_len;
+#endif
+	}
+
+	/* Check if the read was successful or a timeout occurred. */
+	if (bytes_read != devc->xfer_len) {
+		if (devc->bytes_received == 0)
+			sr_err("Trigger timed out. Bytes read: %d.", bytes_read);
+		else
+			sr_err("Read failed at offset %u. Bytes read: %d.",
+			       devc->bytes_received, bytes_read);
 		(void) reset_device(devc); /* Ignore errors. */
 		return SR_ERR;
 	}
 
-	/* De-mangle the data. */
-	sr_spew("Demangling block %d.", devc->block_counter);
-	byte_offset = devc->block_counter * BS;
-	m = byte_offset / (1024 * 1024);
-	mi = m * (1024 * 1024);
-	for (i = 0; i < BS; i++) {
-		if (devc->prof->model == CHRONOVU_LA8) {
-			p = i & (1 << 0);
-			index = m * 2 + (((byte_offset + i) - mi) / 2) * 16;
-			index += (devc->divcount == 0) ? p : (1 - p);
-		} else {
-			p = i & (1 << 0);
-			q = i & (1 << 1);
-			index = m * 4 + (((byte_offset + i) - mi) / 4) * 32;
-			index += q + (1 - p);
-		}
-		devc->final_buf[index] = devc->mangled_buf[i];
+	buf = devc->mangled_buf[devc->cur_buf];
+	len = devc->xfer_len;
+
+#ifdef HAVE_FTDI_READ_DATA_SUBMIT
+	/* Keep the device busy while we de-mangle the data we've got. */
+	if (submit_next_read(devc) != SR_OK) {
+		(void) reset_device(devc); /* Ignore errors. */
+		return SR_ERR;
 	}
+#endif
+
+	sr_spew("Demangling %d bytes at offset %u.", len, devc->bytes_received);
+	demangle(devc, buf, devc->bytes_received, len);
+	devc->bytes_received += len;
+
+	if (devc->bytes_received == SDRAM_SIZE)
+		sr_dbg("Downloaded %d bytes in %" PRIi64 "ms.", SDRAM_SIZE,
+		       (g_get_monotonic_time() - devc->download_start) / 1000);
 
 	return SR_OK;
 }
 
-SR_PRIV void cv_send_block_to_session_bus(struct dev_context *devc, int block)
+/**
+ * Wait for a pending asynchronous read (if any) to finish.
+ *
+ * @param devc The struct containing private per-device-instance data.
+ */
+SR_PRIV void cv_read_abort(struct dev_context *devc)
+{
+#ifdef HAVE_FTDI_READ_DATA_SUBMIT
+	if (devc->tc) {
+		(void) ftdi_transfer_data_done(devc->tc); /* Ignore errors. */
+		devc->tc = NULL;
+	}
+#else
+	(void)devc;
+#endif
+}
+
+static void send_logic_packet(struct dev_context *devc,
+			      uint32_t offset, uint32_t len)
 {
-	int i, idx;
-	uint8_t sample, expected_sample, tmp8;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
-	int trigger_point; /* Relative trigger point (in this block). */
 
-	/* Note: Caller ensures devc/devc->ftdic != NULL and block > 0. */
+	sr_spew("Sending SR_DF_LOGIC packet, start = %u, length = %u.",
+		offset, len);
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.length = len;
+	logic.unitsize = devc->prof->num_channels / 8;
+	logic.data = devc->final_buf + offset;
+	sr_session_send(devc->cb_data, &packet);
+}
+
+/**
+ * Send all samples which are complete in the final buffer, but which were
+ * not sent yet, to the session bus.
+ *
+ * Since samples are spread across all eight SDRAM chunks (see demangle()),
+ * the final buffer only contains valid data up to some position once the
+ * last chunk is being received. From then on, each byte received from the
+ * device completes 8 bytes of the final buffer.
+ *
+ * @param devc The struct containing private per-device-instance data.
+ */
+SR_PRIV void cv_send_data_to_session_bus(struct dev_context *devc)
+{
+	uint32_t i, unitsize, complete, start, len, trigger_point;
+	uint16_t sample, expected_sample;
+	struct sr_datafeed_packet packet;
 
 	/* TODO: Implement/test proper trigger support for the LA16. */
 
-	/* Check if we can find the trigger condition in this block. */
-	trigger_point = -1;
-	expected_sample = devc->trigger_pattern & devc->trigger_mask;
-	for (i = 0; i < BS; i++) {
-		/* Don't continue if the trigger was found previously. */
-		if (devc->trigger_found)
-			break;
-
-		/*
-		 * Also, don't continue if triggers are "don't care", i.e. if
-		 * no trigger conditions were specified by the user. In that
-		 * case we don't want to send an SR_DF_TRIGGER packet at all.
-		 */
-		if (devc->trigger_mask == 0x0000)
-			break;
-
-		sample = *(devc->final_buf + (block * BS) + i);
-
-		if ((sample & devc->trigger_mask) == expected_sample) {
-			trigger_point = i;
-			devc->trigger_found = 1;
-			break;
-		}
-	}
+	if (devc->bytes_received <= SDRAM_SIZE - (1024 * 1024))
+		return;
+	complete = (devc->bytes_received - (SDRAM_SIZE - (1024 * 1024))) * 8;
+	if (complete <= devc->bytes_sent)
+		return;
+
+	start = devc->bytes_sent;
+	len = complete - start;
+	devc->bytes_sent = complete;
+	unitsize = devc->prof->num_channels / 8;
 
-	/* Swap low and high bytes of the 16-bit LA16 samples. */
-	if (devc->prof->model == CHRONOVU_LA16) {
-		for (i = 0; i < BS; i += 2) {
-			idx = (block * BS) + i;
-			tmp8 = devc->final_buf[idx];
-			devc->final_buf[idx] = devc->final_buf[idx + 1];
-			devc->final_buf[idx + 1] = tmp8;
+	/*
+	 * Check if we can find the trigger condition in this range. Don't
+	 * bother if the trigger was found previously, or if triggers are
+	 * "don't care", i.e. if no trigger conditions were specified by the
+	 * user. In that case we don't want to send an SR_DF_TRIGGER packet.
+	 */
+	trigger_point = len;
+	if (!devc->trigger_found && devc->trigger_mask != 0x0000) {
+		expected_sample = devc->trigger_pattern & devc->trigger_mask;
+		for (i = 0; i < len; i += unitsize) {
+			if (unitsize == 2)
+				sample = RL16(devc->final_buf + start + i);
+			else
+				sample = devc->final_buf[start + i];
+			if ((sample & devc->trigger_mask) == expected_sample) {
+				trigger_point = i;
+				devc->trigger_found = 1;
+				break;
+			}
 		}
 	}
 
 	/* If no trigger was found, send one SR_DF_LOGIC packet. */
-	if (trigger_point == -1) {
-		/* Send an SR_DF_LOGIC packet to the session bus. */
-		sr_spew("Sending SR_DF_LOGIC packet (%d bytes) for "
-		        "block %d.", BS, block);
-		packet.type = SR_DF_LOGIC;
-		packet.payload = &logic;
-		logic.length = BS;
-		logic.unitsize = devc->prof->num_channels / 8;
-		logic.data = devc->final_buf + (block * BS);
-		sr_session_send(devc->cb_data, &packet);
+	if (trigger_point == len) {
+		send_logic_packet(devc, start, len);
 		return;
 	}
 
@@ -466,42 +637,21 @@ SR_PRIV void cv_send_block_to_session_bus(struct dev_context *devc, int block)
 	 * We found the trigger, so some special handling is needed. We have
 	 * to send an SR_DF_LOGIC packet with the samples before the trigger
 	 * (if any), then the SD_DF_TRIGGER packet itself, then another
-	 * SR_DF_LOGIC packet with the samples after the trigger (if any).
+	 * SR_DF_LOGIC packet with the samples after the trigger.
 	 */
 
 	/* TODO: Send SR_DF_TRIGGER packet before or after the actual sample? */
 
 	/* If at least one sample is located before the trigger... */
-	if (trigger_point > 0) {
-		/* Send pre-trigger SR_DF_LOGIC packet to the session bus. */
-		sr_spew("Sending pre-trigger SR_DF_LOGIC packet, "
-			"start = %d, length = %d.", block * BS, trigger_point);
-		packet.type = SR_DF_LOGIC;
-		packet.payload = &logic;
-		logic.length = trigger_point;
-		logic.unitsize = devc->prof->num_channels / 8;
-		logic.data = devc->final_buf + (block * BS);
-		sr_session_send(devc->cb_data, &packet);
-	}
+	if (trigger_point > 0)
+		send_logic_packet(devc, start, trigger_point);
 
 	/* Send the SR_DF_TRIGGER packet to the session bus. */
-	sr_spew("Sending SR_DF_TRIGGER packet, sample = %d.",
-		(block * BS) + trigger_point);
+	sr_spew("Sending SR_DF_TRIGGER packet, sample = %u.",
+		(start + trigger_point) / unitsize);
 	packet.type = SR_DF_TRIGGER;
 	packet.payload = NULL;
 	sr_session_send(devc->cb_data, &packet);
 
-	/* If at least one sample is located after the trigger... */
-	if (trigger_point < (BS - 1)) {
-		/* Send post-trigger SR_DF_LOGIC packet to the session bus. */
-		sr_spew("Sending post-trigger SR_DF_LOGIC packet, "
-			"start = %d, length = %d.",
-			(block * BS) + trigger_point, BS - trigger_point);
-		packet.type = SR_DF_LOGIC;
-		packet.payload = &logic;
-		logic.length = BS - trigger_point;
-		logic.unitsize = devc->prof->num_channels / 8;
-		logic.data = devc->final_buf + (block * BS) + trigger_point;
-		sr_session_send(devc->cb_data, &packet);
-	}
+	send_logic_packet(devc, start + trigger_point, len - trigger_point);
 }
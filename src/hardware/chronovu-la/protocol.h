@@ -31,12 +31,22 @@
 
 #define LOG_PREFIX "la8/la16"
 
+/* The FT245's default USB IDs, which the LA8 and LA16 keep. */
+#define FTDI_VID			0x0403
+#define FTDI_PID			0x6001
+
 #define SDRAM_SIZE			(8 * 1024 * 1024)
 #define MAX_NUM_SAMPLES			SDRAM_SIZE
 
 #define BS				4096 /* Block size */
 #define NUM_BLOCKS			2048 /* Number of blocks */
 
+/*
+ * Size of one bulk read (in bytes). Must be a multiple of BS and divide
+ * 1MB evenly, so that a single transfer never crosses an SDRAM chunk.
+ */
+#define XFER_SIZE			(64 * 1024)
+
 enum {
 	CHRONOVU_LA8,
 	CHRONOVU_LA16,
@@ -72,10 +82,13 @@ struct dev_context {
 	void *cb_data;
 
 	/**
-	 * A buffer containing some (mangled) samples from the device.
+	 * Two buffers containing some (mangled) samples from the device.
 	 * Format: Pretty mangled-up (due to hardware reasons), see code.
+	 *
+	 * While one of them is being de-mangled, the next transfer from the
+	 * device is already being received into the other one.
 	 */
-	uint8_t mangled_buf[BS];
+	uint8_t mangled_buf[2][XFER_SIZE];
 
 	/**
 	 * An 8MB buffer where we'll store the de-mangled samples.
@@ -113,8 +126,28 @@ struct dev_context {
 	/** Used for keeping track how much time has passed. */
 	gint64 done;
 
-	/** Counter/index for the data block to be read. */
-	int block_counter;
+	/** Index of the mangled_buf[] the current transfer reads into. */
+	int cur_buf;
+
+	/** Number of bytes requested from the device so far. */
+	uint32_t bytes_requested;
+
+	/** Number of bytes received (and de-mangled) so far. */
+	uint32_t bytes_received;
+
+	/** Number of de-mangled bytes already sent to the session bus. */
+	uint32_t bytes_sent;
+
+#ifdef HAVE_FTDI_READ_DATA_SUBMIT
+	/** The currently pending asynchronous read, or NULL. */
+	struct ftdi_transfer_control *tc;
+#endif
+
+	/** Size (in bytes) of the currently pending read. */
+	int xfer_len;
+
+	/** Used for measuring the download time. */
+	gint64 download_start;
 
 	/** The divcount value (determines the sample period). */
 	uint8_t divcount;
@@ -136,7 +169,8 @@ SR_PRIV uint8_t cv_samplerate_to_divcount(const struct sr_dev_inst *sdi,
 SR_PRIV int cv_write(struct dev_context *devc, uint8_t *buf, int size);
 SR_PRIV int cv_convert_trigger(const struct sr_dev_inst *sdi);
 SR_PRIV int cv_set_samplerate(const struct sr_dev_inst *sdi, uint64_t samplerate);
-SR_PRIV int cv_read_block(struct dev_context *devc);
-SR_PRIV void cv_send_block_to_session_bus(struct dev_context *devc, int block);
+SR_PRIV int cv_read_data(struct dev_context *devc);
+SR_PRIV void cv_read_abort(struct dev_context *devc);
+SR_PRIV void cv_send_data_to_session_bus(struct dev_context *devc);
 
 #endif
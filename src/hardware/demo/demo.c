@@ -40,6 +40,8 @@
 
 #define DEFAULT_ANALOG_AMPLITUDE 25
 #define ANALOG_SAMPLES_PER_PERIOD 20
+/* The generated patterns are shown with 0.1 mV resolution. */
+#define DEFAULT_ANALOG_DIGITS 4
 
 /* Logic patterns we can generate. */
 enum {
@@ -98,7 +100,10 @@ struct analog_gen {
 	float amplitude;
 	float pattern_data[ANALOG_BUFSIZE];
 	unsigned int num_samples;
-	struct sr_datafeed_analog_old packet;
+	struct sr_datafeed_analog packet;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 	float avg_val; /* Average value */
 	unsigned num_avgs; /* Number of samples averaged */
 };
@@ -108,6 +113,7 @@ struct dev_context {
 	uint64_t cur_samplerate;
 	uint64_t limit_samples;
 	uint64_t limit_msec;
+	uint64_t capture_ratio;
 	uint64_t sent_samples;
 	int64_t start_us;
 	int64_t spent_us;
@@ -123,6 +129,19 @@ struct dev_context {
 	GHashTable *ch_ag;
 	gboolean avg; /* True if averaging is enabled */
 	uint64_t avg_samples;
+	/* Samples between injected gaps, 0 if disabled. */
+	uint64_t gap_interval;
+	/* Send the analog channels in planar packets, unless averaging. */
+	gboolean planar;
+	/* A plane per analog channel, in channel order. */
+	struct sr_analog_plane *planes;
+	/* Analog soft trigger */
+	struct soft_trigger_analog *sta;
+	gboolean trigger_fired;
+	/* Samples before the trigger, which aren't sent. */
+	uint64_t skipped_samples;
+	/* Pattern data to check, indexed by channel index. */
+	const float **trigger_data;
 };
 
 static const uint32_t drvopts[] = {
@@ -143,6 +162,10 @@ static const uint32_t devopts[] = {
 	SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 	SR_CONF_AVERAGING | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_AVG_SAMPLES | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_INJECT_GAPS | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_ANALOG_PLANAR | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_TRIGGER_MATCH | SR_CONF_LIST,
+	SR_CONF_CAPTURE_RATIO | SR_CONF_GET | SR_CONF_SET,
 };
 
 static const uint32_t devopts_cg_logic[] = {
@@ -158,6 +181,15 @@ static const uint32_t devopts_cg_analog_channel[] = {
 	SR_CONF_AMPLITUDE | SR_CONF_GET | SR_CONF_SET,
 };
 
+static const int32_t soft_trigger_matches[] = {
+	SR_TRIGGER_RISING,
+	SR_TRIGGER_FALLING,
+	SR_TRIGGER_EDGE,
+	SR_TRIGGER_OVER,
+	SR_TRIGGER_UNDER,
+	SR_TRIGGER_RUNT,
+};
+
 static const uint64_t samplerates[] = {
 	SR_HZ(1),
 	SR_GHZ(1),
@@ -318,6 +350,8 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	sdi->channel_groups = g_slist_append(sdi->channel_groups, acg);
 
 	devc->ch_ag = g_hash_table_new(g_direct_hash, g_direct_equal);
+	devc->planes = g_malloc0(MAX(num_analog_channels, 0)
+			* sizeof(struct sr_analog_plane));
 	for (i = 0; i < num_analog_channels; i++) {
 		snprintf(channel_name, 16, "A%d", i);
 		ch = sr_channel_new(sdi, i + num_logic_channels, SR_CHANNEL_ANALOG,
@@ -333,16 +367,23 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 		/* Every channel gets a generator struct. */
 		ag = g_malloc(sizeof(struct analog_gen));
 		ag->amplitude = DEFAULT_ANALOG_AMPLITUDE;
-		ag->packet.channels = cg->channels;
-		ag->packet.mq = 0;
-		ag->packet.mqflags = 0;
-		ag->packet.unit = SR_UNIT_VOLT;
+		sr_analog_init(&ag->packet, &ag->encoding, &ag->meaning,
+				&ag->spec, DEFAULT_ANALOG_DIGITS);
+		ag->packet.meaning->channels = cg->channels;
+		ag->packet.meaning->mq = 0;
+		ag->packet.meaning->mqflags = 0;
+		ag->packet.meaning->unit = SR_UNIT_VOLT;
 		ag->packet.data = ag->pattern_data;
 		ag->pattern = pattern;
 		ag->avg_val = 0.0f;
 		ag->num_avgs = 0;
 		g_hash_table_insert(devc->ch_ag, ch, ag);
 
+		devc->planes[i].channel = ch;
+		devc->planes[i].encoding = &ag->encoding;
+		devc->planes[i].meaning = &ag->meaning;
+		devc->planes[i].spec = &ag->spec;
+
 		if (++pattern == ARRAY_SIZE(analog_pattern_str))
 			pattern = 0;
 	}
@@ -386,6 +427,7 @@ static void clear_helper(void *priv)
 	while (g_hash_table_iter_next(&iter, NULL, &value))
 		g_free(value);
 	g_hash_table_unref(devc->ch_ag);
+	g_free(devc->planes);
 	g_free(devc);
 }
 
@@ -422,6 +464,15 @@ static int config_get(uint32_t key, GVariant **data, const struct sr_dev_inst *s
 	case SR_CONF_AVG_SAMPLES:
 		*data = g_variant_new_uint64(devc->avg_samples);
 		break;
+	case SR_CONF_INJECT_GAPS:
+		*data = g_variant_new_uint64(devc->gap_interval);
+		break;
+	case SR_CONF_ANALOG_PLANAR:
+		*data = g_variant_new_boolean(devc->planar);
+		break;
+	case SR_CONF_CAPTURE_RATIO:
+		*data = g_variant_new_uint64(devc->capture_ratio);
+		break;
 	case SR_CONF_PATTERN_MODE:
 		if (!cg)
 			return SR_ERR_CHANNEL_GROUP;
@@ -491,6 +542,16 @@ static int config_set(uint32_t key, GVariant *data, const struct sr_dev_inst *sd
 		devc->avg_samples = g_variant_get_uint64(data);
 		sr_dbg("Setting averaging rate to %" PRIu64, devc->avg_samples);
 		break;
+	case SR_CONF_INJECT_GAPS:
+		devc->gap_interval = g_variant_get_uint64(data);
+		break;
+	case SR_CONF_ANALOG_PLANAR:
+		devc->planar = g_variant_get_boolean(data);
+		break;
+	case SR_CONF_CAPTURE_RATIO:
+		devc->capture_ratio = g_variant_get_uint64(data);
+		ret = (devc->capture_ratio > 100) ? SR_ERR : SR_OK;
+		break;
 	case SR_CONF_PATTERN_MODE:
 		if (!cg)
 			return SR_ERR_CHANNEL_GROUP;
@@ -587,6 +648,11 @@ static int config_list(uint32_t key, GVariant **data, const struct sr_dev_inst *
 			g_variant_builder_add(&gvb, "{sv}", "samplerate-steps", gvar);
 			*data = g_variant_builder_end(&gvb);
 			break;
+		case SR_CONF_TRIGGER_MATCH:
+			*data = g_variant_new_fixed_array(G_VARIANT_TYPE_INT32,
+					soft_trigger_matches, ARRAY_SIZE(soft_trigger_matches),
+					sizeof(int32_t));
+			break;
 		default:
 			return SR_ERR_NA;
 		}
@@ -687,7 +753,7 @@ static void send_analog_packet(struct analog_gen *ag,
 	unsigned int i;
 
 	devc = sdi->priv;
-	packet.type = SR_DF_ANALOG_OLD;
+	packet.type = SR_DF_ANALOG;
 	packet.payload = &ag->packet;
 
 	if (!devc->avg) {
@@ -734,18 +800,218 @@ do_send:
 	}
 }
 
+/*
+ * Send all analog channels in one planar packet, each plane pointing
+ * into its channel's pattern, up to where the first pattern wraps
+ * around. Returns the number of samples sent.
+ */
+static uint64_t send_analog_planar(struct sr_dev_inst *sdi,
+		uint64_t analog_pos, uint64_t analog_todo)
+{
+	struct dev_context *devc;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog_planar planar;
+	struct sr_analog_plane *plane;
+	struct analog_gen *ag;
+	uint64_t sending_now, ag_pattern_pos;
+	int i;
+
+	devc = sdi->priv;
+	sending_now = analog_todo;
+	for (i = 0; i < devc->num_analog_channels; i++) {
+		plane = &devc->planes[i];
+		ag = g_hash_table_lookup(devc->ch_ag, plane->channel);
+		ag_pattern_pos = analog_pos % ag->num_samples;
+		plane->data = ag->pattern_data + ag_pattern_pos;
+		sending_now = MIN(sending_now, ag->num_samples - ag_pattern_pos);
+	}
+
+	planar.frame = 0;
+	planar.sample = analog_pos;
+	planar.num_samples = sending_now;
+	planar.num_planes = devc->num_analog_channels;
+	planar.planes = devc->planes;
+	packet.type = SR_DF_ANALOG_PLANAR;
+	packet.payload = &planar;
+	sr_session_send(sdi, &packet);
+
+	return sending_now;
+}
+
+/* Send the samples from position pos on, count samples in all. */
+static int send_samples(struct sr_dev_inst *sdi, uint64_t pos, uint64_t count)
+{
+	struct dev_context *devc;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	GHashTableIter iter;
+	void *value;
+	uint64_t logic_done, analog_done, analog_sent, sending_now;
+
+	devc = sdi->priv;
+
+	logic_done  = devc->num_logic_channels  > 0 ? 0 : count;
+	analog_done = devc->num_analog_channels > 0 ? 0 : count;
+
+	while (logic_done < count || analog_done < count) {
+		/* Logic */
+		if (logic_done < count) {
+			sending_now = MIN(count - logic_done,
+					LOGIC_BUFSIZE / devc->logic_unitsize);
+			logic_generator(sdi, sending_now * devc->logic_unitsize);
+			packet.type = SR_DF_LOGIC;
+			packet.payload = &logic;
+			logic.length = sending_now * devc->logic_unitsize;
+			logic.unitsize = devc->logic_unitsize;
+			logic.data = devc->logic_data;
+			sr_session_send(sdi, &packet);
+			logic_done += sending_now;
+		}
+
+		/* Analog, all channels at once */
+		if (analog_done < count && devc->planar && !devc->avg) {
+			analog_done += send_analog_planar(sdi,
+					pos + analog_done, count - analog_done);
+		/* Analog, one channel at a time */
+		} else if (analog_done < count) {
+			analog_sent = 0;
+
+			g_hash_table_iter_init(&iter, devc->ch_ag);
+			while (g_hash_table_iter_next(&iter, NULL, &value)) {
+				send_analog_packet(value, sdi, &analog_sent,
+						pos + analog_done,
+						count - analog_done);
+			}
+			analog_done += analog_sent;
+		}
+	}
+	/* At this point, both logic_done and analog_done should be
+	 * exactly equal to count, or else.
+	 */
+	if (logic_done != count || analog_done != count) {
+		sr_err("BUG: Sample count mismatch.");
+		return SR_ERR_BUG;
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Send the samples from position pos on, count samples in all, with
+ * gaps injected if enabled. Every gap_interval samples, a tenth as many
+ * samples (at least one) are left out and reported as lost instead.
+ */
+static int send_samples_with_gaps(struct sr_dev_inst *sdi, uint64_t pos,
+		uint64_t count)
+{
+	struct dev_context *devc;
+	uint64_t gap_length, period, offset, n;
+	int ret;
+
+	devc = sdi->priv;
+
+	if (!devc->gap_interval)
+		return send_samples(sdi, pos, count);
+
+	gap_length = MAX(devc->gap_interval / 10, 1);
+	period = devc->gap_interval + gap_length;
+	while (count > 0) {
+		offset = pos % period;
+		if (offset < devc->gap_interval) {
+			n = MIN(devc->gap_interval - offset, count);
+			ret = send_samples(sdi, pos, n);
+		} else {
+			n = MIN(period - offset, count);
+			ret = std_session_send_df_gap(sdi, pos, n);
+		}
+		if (ret != SR_OK)
+			return ret;
+		pos += n;
+		count -= n;
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Run the analog soft trigger over the samples from position pos on,
+ * count samples in all. Returns how many of them came before the trigger,
+ * or count if it didn't fire. If it fired, pre_trigger_samples is set to
+ * how many samples before it are to be sent.
+ */
+static uint64_t check_trigger(struct sr_dev_inst *sdi, uint64_t pos,
+		uint64_t count, int *pre_trigger_samples)
+{
+	struct dev_context *devc;
+	struct sr_channel *ch;
+	struct analog_gen *ag;
+	GHashTableIter iter;
+	void *key, *value;
+	uint64_t done, n, ag_pattern_pos;
+	int offset;
+
+	devc = sdi->priv;
+	done = 0;
+	while (done < count) {
+		/* Check up to where the first pattern wraps around. */
+		n = count - done;
+		g_hash_table_iter_init(&iter, devc->ch_ag);
+		while (g_hash_table_iter_next(&iter, &key, &value)) {
+			ch = key;
+			ag = value;
+			ag_pattern_pos = (pos + done) % ag->num_samples;
+			devc->trigger_data[ch->index] = ag->pattern_data + ag_pattern_pos;
+			n = MIN(n, ag->num_samples - ag_pattern_pos);
+		}
+		offset = soft_trigger_analog_check(devc->sta,
+				devc->trigger_data, n, pre_trigger_samples);
+		if (offset >= 0) {
+			devc->trigger_fired = TRUE;
+			return done + offset;
+		}
+		done += n;
+	}
+
+	return count;
+}
+
+/*
+ * The trigger fired on the sample at position pos. Send the samples the
+ * capture ratio asks for before it, then the trigger.
+ */
+static int send_trigger(struct sr_dev_inst *sdi, uint64_t pos,
+		uint64_t pre_trigger_samples)
+{
+	struct dev_context *devc;
+	struct sr_datafeed_packet packet;
+	int ret;
+
+	devc = sdi->priv;
+	ret = send_samples_with_gaps(sdi, pos - pre_trigger_samples,
+			pre_trigger_samples);
+	if (ret != SR_OK)
+		return ret;
+	devc->skipped_samples -= pre_trigger_samples;
+	devc->sent_samples += pre_trigger_samples;
+
+	packet.type = SR_DF_TRIGGER;
+	packet.payload = NULL;
+
+	return sr_session_send(sdi, &packet);
+}
+
 /* Callback handling data */
 static int prepare_data(int fd, int revents, void *cb_data)
 {
 	struct sr_dev_inst *sdi;
 	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
-	struct sr_datafeed_logic logic;
 	struct analog_gen *ag;
 	GHashTableIter iter;
 	void *value;
-	uint64_t samples_todo, logic_done, analog_done, analog_sent, sending_now;
+	uint64_t samples_todo, pos, skipped;
 	int64_t elapsed_us, limit_us, todo_us;
+	int pre_trigger_samples;
 
 	(void)fd;
 	(void)revents;
@@ -784,44 +1050,30 @@ static int prepare_data(int fd, int revents, void *cb_data)
 	 */
 	todo_us = samples_todo * G_USEC_PER_SEC / devc->cur_samplerate;
 
-	logic_done  = devc->num_logic_channels  > 0 ? 0 : samples_todo;
-	analog_done = devc->num_analog_channels > 0 ? 0 : samples_todo;
-
-	while (logic_done < samples_todo || analog_done < samples_todo) {
-		/* Logic */
-		if (logic_done < samples_todo) {
-			sending_now = MIN(samples_todo - logic_done,
-					LOGIC_BUFSIZE / devc->logic_unitsize);
-			logic_generator(sdi, sending_now * devc->logic_unitsize);
-			packet.type = SR_DF_LOGIC;
-			packet.payload = &logic;
-			logic.length = sending_now * devc->logic_unitsize;
-			logic.unitsize = devc->logic_unitsize;
-			logic.data = devc->logic_data;
-			sr_session_send(sdi, &packet);
-			logic_done += sending_now;
-		}
-
-		/* Analog, one channel at a time */
-		if (analog_done < samples_todo) {
-			analog_sent = 0;
-
-			g_hash_table_iter_init(&iter, devc->ch_ag);
-			while (g_hash_table_iter_next(&iter, NULL, &value)) {
-				send_analog_packet(value, sdi, &analog_sent,
-						devc->sent_samples + analog_done,
-						samples_todo - analog_done);
-			}
-			analog_done += analog_sent;
+	/*
+	 * Samples before the trigger take time, but aren't sent, apart
+	 * from those the capture ratio keeps. These count towards the
+	 * sample limit.
+	 */
+	pos = devc->sent_samples + devc->skipped_samples;
+	if (!devc->trigger_fired) {
+		pre_trigger_samples = 0;
+		skipped = check_trigger(sdi, pos, samples_todo,
+				&pre_trigger_samples);
+		devc->skipped_samples += skipped;
+		pos += skipped;
+		samples_todo -= skipped;
+		if (devc->trigger_fired) {
+			if (send_trigger(sdi, pos, pre_trigger_samples) != SR_OK)
+				return G_SOURCE_REMOVE;
+			if (devc->limit_samples > 0)
+				samples_todo = MIN(samples_todo,
+					devc->limit_samples - devc->sent_samples);
 		}
 	}
-	/* At this point, both logic_done and analog_done should be
-	 * exactly equal to samples_todo, or else.
-	 */
-	if (logic_done != samples_todo || analog_done != samples_todo) {
-		sr_err("BUG: Sample count mismatch.");
+
+	if (send_samples_with_gaps(sdi, pos, samples_todo) != SR_OK)
 		return G_SOURCE_REMOVE;
-	}
 	devc->sent_samples += samples_todo;
 	devc->spent_us += todo_us;
 
@@ -833,7 +1085,7 @@ static int prepare_data(int fd, int revents, void *cb_data)
 			g_hash_table_iter_init(&iter, devc->ch_ag);
 			while (g_hash_table_iter_next(&iter, NULL, &value)) {
 				ag = value;
-				packet.type = SR_DF_ANALOG_OLD;
+				packet.type = SR_DF_ANALOG;
 				packet.payload = &ag->packet;
 				ag->packet.data = &ag->avg_val;
 				ag->packet.num_samples = 1;
@@ -847,11 +1099,33 @@ static int prepare_data(int fd, int revents, void *cb_data)
 	return G_SOURCE_CONTINUE;
 }
 
+/* Whether any match of the trigger is on an enabled analog channel. */
+static gboolean trigger_has_analog(const struct sr_trigger *trigger)
+{
+	const struct sr_trigger_stage *stage;
+	const struct sr_trigger_match *match;
+	const GSList *l, *m;
+
+	for (l = trigger->stages; l; l = l->next) {
+		stage = l->data;
+		for (m = stage->matches; m; m = m->next) {
+			match = m->data;
+			if (match->channel->enabled
+					&& match->channel->type == SR_CHANNEL_ANALOG)
+				return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
 static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 {
 	struct dev_context *devc;
+	struct sr_trigger *trigger;
 	GHashTableIter iter;
 	void *value;
+	int pre_trigger_samples;
 
 	(void)cb_data;
 
@@ -860,6 +1134,27 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 
 	devc = sdi->priv;
 	devc->sent_samples = 0;
+	devc->skipped_samples = 0;
+
+	trigger = sr_session_trigger_get(sdi->session);
+	if (trigger && !trigger_has_analog(trigger)) {
+		sr_warn("Only analog channels can trigger, ignoring trigger.");
+		trigger = NULL;
+	}
+	if (trigger) {
+		pre_trigger_samples = 0;
+		if (devc->limit_samples > 0)
+			pre_trigger_samples = devc->capture_ratio
+					* devc->limit_samples / 100;
+		devc->sta = soft_trigger_analog_new(sdi, trigger,
+				pre_trigger_samples);
+		if (!devc->sta)
+			return SR_ERR;
+		devc->trigger_data = g_malloc0(g_slist_length(sdi->channels)
+				* sizeof(float *));
+		devc->trigger_fired = FALSE;
+	} else
+		devc->trigger_fired = TRUE;
 
 	g_hash_table_iter_init(&iter, devc->ch_ag);
 	while (g_hash_table_iter_next(&iter, NULL, &value))
@@ -880,6 +1175,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 
 static int dev_acquisition_stop(struct sr_dev_inst *sdi, void *cb_data)
 {
+	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
 
 	(void)cb_data;
@@ -888,6 +1184,14 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi, void *cb_data)
 
 	sr_session_source_remove(sdi->session, -1);
 
+	devc = sdi->priv;
+	if (devc->sta) {
+		soft_trigger_analog_free(devc->sta);
+		devc->sta = NULL;
+		g_free(devc->trigger_data);
+		devc->trigger_data = NULL;
+	}
+
 	/* Send last packet. */
 	packet.type = SR_DF_END;
 	sr_session_send(sdi, &packet);
@@ -26,17 +26,33 @@
 #include "libsigrok-internal.h"
 #include "fluke-dmm.h"
 
-static struct sr_datafeed_analog_old *handle_qm_18x(const struct sr_dev_inst *sdi,
-		char **tokens)
+/* Decimals of a "1.234E-3" style reading, with its exponent applied. */
+static int parse_digits(const char *s)
+{
+	const char *p;
+	int digits;
+
+	digits = 0;
+	if ((p = strchr(s, '.')))
+		digits = strspn(p + 1, "0123456789");
+	if ((p = strpbrk(s, "Ee")))
+		digits -= strtol(p + 1, NULL, 10);
+
+	return digits;
+}
+
+static gboolean handle_qm_18x(char **tokens, struct sr_datafeed_analog *analog,
+		float *data)
 {
-	struct sr_datafeed_analog_old *analog;
 	float fvalue;
 	char *e, *u;
 	gboolean is_oor;
+	int digits;
 
 	if (strcmp(tokens[0], "QM") || !tokens[1])
-		return NULL;
+		return FALSE;
 
+	digits = 0;
 	if ((e = strstr(tokens[1], "Out of range"))) {
 		is_oor = TRUE;
 		fvalue = -1;
@@ -53,213 +69,199 @@ static struct sr_datafeed_analog_old *handle_qm_18x(const struct sr_dev_inst *sd
 		if (sr_atof_ascii(tokens[1], &fvalue) != SR_OK || fvalue == 0.0) {
 			/* Happens all the time, when switching modes. */
 			sr_dbg("Invalid float.");
-			return NULL;
+			return FALSE;
 		}
+		digits = parse_digits(tokens[1]);
 	}
 	while (*e && *e == ' ')
 		e++;
 
-	analog = g_malloc0(sizeof(struct sr_datafeed_analog_old));
-	analog->data = g_malloc(sizeof(float));
-	analog->channels = sdi->channels;
-	analog->num_samples = 1;
 	if (is_oor)
-		*analog->data = NAN;
+		*data = NAN;
 	else
-		*analog->data = fvalue;
-	analog->mq = -1;
+		*data = fvalue;
 
 	if ((u = strstr(e, "V DC")) || (u = strstr(e, "V AC"))) {
-		analog->mq = SR_MQ_VOLTAGE;
-		analog->unit = SR_UNIT_VOLT;
+		analog->meaning->mq = SR_MQ_VOLTAGE;
+		analog->meaning->unit = SR_UNIT_VOLT;
 		if (!is_oor && e[0] == 'm')
-			*analog->data /= 1000;
+			*data /= 1000;
 		/* This catches "V AC", "V DC" and "V AC+DC". */
 		if (strstr(u, "AC"))
-			analog->mqflags |= SR_MQFLAG_AC | SR_MQFLAG_RMS;
+			analog->meaning->mqflags |= SR_MQFLAG_AC | SR_MQFLAG_RMS;
 		if (strstr(u, "DC"))
-			analog->mqflags |= SR_MQFLAG_DC;
+			analog->meaning->mqflags |= SR_MQFLAG_DC;
 	} else if ((u = strstr(e, "dBV")) || (u = strstr(e, "dBm"))) {
-		analog->mq = SR_MQ_VOLTAGE;
+		analog->meaning->mq = SR_MQ_VOLTAGE;
 		if (u[2] == 'm')
-			analog->unit = SR_UNIT_DECIBEL_MW;
+			analog->meaning->unit = SR_UNIT_DECIBEL_MW;
 		else
-			analog->unit = SR_UNIT_DECIBEL_VOLT;
-		analog->mqflags |= SR_MQFLAG_AC | SR_MQFLAG_RMS;
+			analog->meaning->unit = SR_UNIT_DECIBEL_VOLT;
+		analog->meaning->mqflags |= SR_MQFLAG_AC | SR_MQFLAG_RMS;
 	} else if ((u = strstr(e, "Ohms"))) {
-		analog->mq = SR_MQ_RESISTANCE;
-		analog->unit = SR_UNIT_OHM;
+		analog->meaning->mq = SR_MQ_RESISTANCE;
+		analog->meaning->unit = SR_UNIT_OHM;
 		if (is_oor)
-			*analog->data = INFINITY;
+			*data = INFINITY;
 		else if (e[0] == 'k')
-			*analog->data *= 1000;
+			*data *= 1000;
 		else if (e[0] == 'M')
-			*analog->data *= 1000000;
+			*data *= 1000000;
 	} else if (!strcmp(e, "nS")) {
-		analog->mq = SR_MQ_CONDUCTANCE;
-		analog->unit = SR_UNIT_SIEMENS;
-		*analog->data /= 1e+9;
+		analog->meaning->mq = SR_MQ_CONDUCTANCE;
+		analog->meaning->unit = SR_UNIT_SIEMENS;
+		*data /= 1e+9;
 	} else if ((u = strstr(e, "Farads"))) {
-		analog->mq = SR_MQ_CAPACITANCE;
-		analog->unit = SR_UNIT_FARAD;
+		analog->meaning->mq = SR_MQ_CAPACITANCE;
+		analog->meaning->unit = SR_UNIT_FARAD;
 		if (!is_oor) {
 			if (e[0] == 'm')
-				*analog->data /= 1e+3;
+				*data /= 1e+3;
 			else if (e[0] == 'u')
-				*analog->data /= 1e+6;
+				*data /= 1e+6;
 			else if (e[0] == 'n')
-				*analog->data /= 1e+9;
+				*data /= 1e+9;
 		}
 	} else if ((u = strstr(e, "Deg C")) || (u = strstr(e, "Deg F"))) {
-		analog->mq = SR_MQ_TEMPERATURE;
+		analog->meaning->mq = SR_MQ_TEMPERATURE;
 		if (u[4] == 'C')
-			analog->unit = SR_UNIT_CELSIUS;
+			analog->meaning->unit = SR_UNIT_CELSIUS;
 		else
-			analog->unit = SR_UNIT_FAHRENHEIT;
+			analog->meaning->unit = SR_UNIT_FAHRENHEIT;
 	} else if ((u = strstr(e, "A AC")) || (u = strstr(e, "A DC"))) {
-		analog->mq = SR_MQ_CURRENT;
-		analog->unit = SR_UNIT_AMPERE;
+		analog->meaning->mq = SR_MQ_CURRENT;
+		analog->meaning->unit = SR_UNIT_AMPERE;
 		/* This catches "A AC", "A DC" and "A AC+DC". */
 		if (strstr(u, "AC"))
-			analog->mqflags |= SR_MQFLAG_AC | SR_MQFLAG_RMS;
+			analog->meaning->mqflags |= SR_MQFLAG_AC | SR_MQFLAG_RMS;
 		if (strstr(u, "DC"))
-			analog->mqflags |= SR_MQFLAG_DC;
+			analog->meaning->mqflags |= SR_MQFLAG_DC;
 		if (!is_oor) {
 			if (e[0] == 'm')
-				*analog->data /= 1e+3;
+				*data /= 1e+3;
 			else if (e[0] == 'u')
-				*analog->data /= 1e+6;
+				*data /= 1e+6;
 		}
 	} else if ((u = strstr(e, "Hz"))) {
-		analog->mq = SR_MQ_FREQUENCY;
-		analog->unit = SR_UNIT_HERTZ;
+		analog->meaning->mq = SR_MQ_FREQUENCY;
+		analog->meaning->unit = SR_UNIT_HERTZ;
 		if (e[0] == 'k')
-			*analog->data *= 1e+3;
+			*data *= 1e+3;
 	} else if (!strcmp(e, "%")) {
-		analog->mq = SR_MQ_DUTY_CYCLE;
-		analog->unit = SR_UNIT_PERCENTAGE;
+		analog->meaning->mq = SR_MQ_DUTY_CYCLE;
+		analog->meaning->unit = SR_UNIT_PERCENTAGE;
 	} else if ((u = strstr(e, "ms"))) {
-		analog->mq = SR_MQ_PULSE_WIDTH;
-		analog->unit = SR_UNIT_SECOND;
-		*analog->data /= 1e+3;
+		analog->meaning->mq = SR_MQ_PULSE_WIDTH;
+		analog->meaning->unit = SR_UNIT_SECOND;
+		*data /= 1e+3;
 	}
 
-	if (analog->mq == -1) {
-		/* Not a valid measurement. */
-		g_free(analog->data);
-		g_free(analog);
-		analog = NULL;
-	}
+	/* Account for the SI prefix the value was scaled by. */
+	if (!is_oor && isfinite(*data))
+		digits -= lrint(log10(*data / fvalue));
+	analog->encoding->digits = digits;
+	analog->spec->spec_digits = digits;
 
-	return analog;
+	/* Zero if not a valid measurement. */
+	return analog->meaning->mq != 0;
 }
 
-static struct sr_datafeed_analog_old *handle_qm_28x(const struct sr_dev_inst *sdi,
-		char **tokens)
+static gboolean handle_qm_28x(char **tokens, struct sr_datafeed_analog *analog,
+		float *data)
 {
-	struct sr_datafeed_analog_old *analog;
 	float fvalue;
 
 	if (!tokens[1])
-		return NULL;
+		return FALSE;
 
 	if (sr_atof_ascii(tokens[0], &fvalue) != SR_OK || fvalue == 0.0) {
 		sr_err("Invalid float '%s'.", tokens[0]);
-		return NULL;
+		return FALSE;
 	}
 
-	analog = g_malloc0(sizeof(struct sr_datafeed_analog_old));
-	analog->data = g_malloc(sizeof(float));
-	analog->channels = sdi->channels;
-	analog->num_samples = 1;
-	*analog->data = fvalue;
-	analog->mq = -1;
+	*data = fvalue;
+	analog->encoding->digits = parse_digits(tokens[0]);
+	analog->spec->spec_digits = analog->encoding->digits;
 
 	if (!strcmp(tokens[1], "VAC") || !strcmp(tokens[1], "VDC")) {
-		analog->mq = SR_MQ_VOLTAGE;
-		analog->unit = SR_UNIT_VOLT;
+		analog->meaning->mq = SR_MQ_VOLTAGE;
+		analog->meaning->unit = SR_UNIT_VOLT;
 		if (!strcmp(tokens[2], "NORMAL")) {
 			if (tokens[1][1] == 'A') {
-				analog->mqflags |= SR_MQFLAG_AC;
-				analog->mqflags |= SR_MQFLAG_RMS;
+				analog->meaning->mqflags |= SR_MQFLAG_AC;
+				analog->meaning->mqflags |= SR_MQFLAG_RMS;
 			} else
-				analog->mqflags |= SR_MQFLAG_DC;
+				analog->meaning->mqflags |= SR_MQFLAG_DC;
 		} else if (!strcmp(tokens[2], "OL") || !strcmp(tokens[2], "OL_MINUS")) {
-			*analog->data = NAN;
+			*data = NAN;
 		} else
-			analog->mq = -1;
+			analog->meaning->mq = 0;
 	} else if (!strcmp(tokens[1], "dBV") || !strcmp(tokens[1], "dBm")) {
-		analog->mq = SR_MQ_VOLTAGE;
+		analog->meaning->mq = SR_MQ_VOLTAGE;
 		if (tokens[1][2] == 'm')
-			analog->unit = SR_UNIT_DECIBEL_MW;
+			analog->meaning->unit = SR_UNIT_DECIBEL_MW;
 		else
-			analog->unit = SR_UNIT_DECIBEL_VOLT;
-		analog->mqflags |= SR_MQFLAG_AC | SR_MQFLAG_RMS;
+			analog->meaning->unit = SR_UNIT_DECIBEL_VOLT;
+		analog->meaning->mqflags |= SR_MQFLAG_AC | SR_MQFLAG_RMS;
 	} else if (!strcmp(tokens[1], "CEL") || !strcmp(tokens[1], "FAR")) {
 		if (!strcmp(tokens[2], "NORMAL")) {
-			analog->mq = SR_MQ_TEMPERATURE;
+			analog->meaning->mq = SR_MQ_TEMPERATURE;
 			if (tokens[1][0] == 'C')
-				analog->unit = SR_UNIT_CELSIUS;
+				analog->meaning->unit = SR_UNIT_CELSIUS;
 			else
-				analog->unit = SR_UNIT_FAHRENHEIT;
+				analog->meaning->unit = SR_UNIT_FAHRENHEIT;
 		}
 	} else if (!strcmp(tokens[1], "OHM")) {
 		if (!strcmp(tokens[3], "NONE")) {
-			analog->mq = SR_MQ_RESISTANCE;
-			analog->unit = SR_UNIT_OHM;
+			analog->meaning->mq = SR_MQ_RESISTANCE;
+			analog->meaning->unit = SR_UNIT_OHM;
 			if (!strcmp(tokens[2], "OL") || !strcmp(tokens[2], "OL_MINUS")) {
-				*analog->data = INFINITY;
+				*data = INFINITY;
 			} else if (strcmp(tokens[2], "NORMAL"))
-				analog->mq = -1;
+				analog->meaning->mq = 0;
 		} else if (!strcmp(tokens[3], "OPEN_CIRCUIT")) {
-			analog->mq = SR_MQ_CONTINUITY;
-			analog->unit = SR_UNIT_BOOLEAN;
-			*analog->data = 0.0;
+			analog->meaning->mq = SR_MQ_CONTINUITY;
+			analog->meaning->unit = SR_UNIT_BOOLEAN;
+			*data = 0.0;
 		} else if (!strcmp(tokens[3], "SHORT_CIRCUIT")) {
-			analog->mq = SR_MQ_CONTINUITY;
-			analog->unit = SR_UNIT_BOOLEAN;
-			*analog->data = 1.0;
+			analog->meaning->mq = SR_MQ_CONTINUITY;
+			analog->meaning->unit = SR_UNIT_BOOLEAN;
+			*data = 1.0;
 		}
 	} else if (!strcmp(tokens[1], "F")
 			&& !strcmp(tokens[2], "NORMAL")
 			&& !strcmp(tokens[3], "NONE")) {
-		analog->mq = SR_MQ_CAPACITANCE;
-		analog->unit = SR_UNIT_FARAD;
+		analog->meaning->mq = SR_MQ_CAPACITANCE;
+		analog->meaning->unit = SR_UNIT_FARAD;
 	} else if (!strcmp(tokens[1], "AAC") || !strcmp(tokens[1], "ADC")) {
-		analog->mq = SR_MQ_CURRENT;
-		analog->unit = SR_UNIT_AMPERE;
+		analog->meaning->mq = SR_MQ_CURRENT;
+		analog->meaning->unit = SR_UNIT_AMPERE;
 		if (!strcmp(tokens[2], "NORMAL")) {
 			if (tokens[1][1] == 'A') {
-				analog->mqflags |= SR_MQFLAG_AC;
-				analog->mqflags |= SR_MQFLAG_RMS;
+				analog->meaning->mqflags |= SR_MQFLAG_AC;
+				analog->meaning->mqflags |= SR_MQFLAG_RMS;
 			} else
-				analog->mqflags |= SR_MQFLAG_DC;
+				analog->meaning->mqflags |= SR_MQFLAG_DC;
 		} else if (!strcmp(tokens[2], "OL") || !strcmp(tokens[2], "OL_MINUS")) {
-			*analog->data = NAN;
+			*data = NAN;
 		} else
-			analog->mq = -1;
+			analog->meaning->mq = 0;
 	} if (!strcmp(tokens[1], "Hz") && !strcmp(tokens[2], "NORMAL")) {
-		analog->mq = SR_MQ_FREQUENCY;
-		analog->unit = SR_UNIT_HERTZ;
+		analog->meaning->mq = SR_MQ_FREQUENCY;
+		analog->meaning->unit = SR_UNIT_HERTZ;
 	} else if (!strcmp(tokens[1], "PCT") && !strcmp(tokens[2], "NORMAL")) {
-		analog->mq = SR_MQ_DUTY_CYCLE;
-		analog->unit = SR_UNIT_PERCENTAGE;
+		analog->meaning->mq = SR_MQ_DUTY_CYCLE;
+		analog->meaning->unit = SR_UNIT_PERCENTAGE;
 	} else if (!strcmp(tokens[1], "S") && !strcmp(tokens[2], "NORMAL")) {
-		analog->mq = SR_MQ_PULSE_WIDTH;
-		analog->unit = SR_UNIT_SECOND;
+		analog->meaning->mq = SR_MQ_PULSE_WIDTH;
+		analog->meaning->unit = SR_UNIT_SECOND;
 	} else if (!strcmp(tokens[1], "SIE") && !strcmp(tokens[2], "NORMAL")) {
-		analog->mq = SR_MQ_CONDUCTANCE;
-		analog->unit = SR_UNIT_SIEMENS;
-	}
-
-	if (analog->mq == -1) {
-		/* Not a valid measurement. */
-		g_free(analog->data);
-		g_free(analog);
-		analog = NULL;
+		analog->meaning->mq = SR_MQ_CONDUCTANCE;
+		analog->meaning->unit = SR_UNIT_SIEMENS;
 	}
 
-	return analog;
+	/* Zero if not a valid measurement. */
+	return analog->meaning->mq != 0;
 }
 
 static void handle_qm_19x_meta(const struct sr_dev_inst *sdi, char **tokens)
@@ -362,9 +364,14 @@ static void handle_qm_19x_data(const struct sr_dev_inst *sdi, char **tokens)
 {
 	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog_old analog;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 	float fvalue;
+	int digits;
 
+	digits = 0;
 	if (!strcmp(tokens[0], "9.9E+37")) {
 		/* An invalid measurement shows up on the display as "OL", but
 		 * comes through like this. Since comparing 38-digit floats
@@ -375,6 +382,7 @@ static void handle_qm_19x_data(const struct sr_dev_inst *sdi, char **tokens)
 			sr_err("Invalid float '%s'.", tokens[0]);
 			return;
 		}
+		digits = parse_digits(tokens[0]);
 	}
 
 	devc = sdi->priv;
@@ -389,15 +397,17 @@ static void handle_qm_19x_data(const struct sr_dev_inst *sdi, char **tokens)
 			fvalue = 0.0;
 		else
 			fvalue = 1.0;
+		digits = 0;
 	}
 
-	analog.channels = sdi->channels;
+	sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
+	analog.meaning->channels = sdi->channels;
 	analog.num_samples = 1;
 	analog.data = &fvalue;
-	analog.mq = devc->mq;
-	analog.unit = devc->unit;
-	analog.mqflags = 0;
-	packet.type = SR_DF_ANALOG_OLD;
+	analog.meaning->mq = devc->mq;
+	analog.meaning->unit = devc->unit;
+	analog.meaning->mqflags = 0;
+	packet.type = SR_DF_ANALOG;
 	packet.payload = &analog;
 	sr_session_send(devc->cb_data, &packet);
 	devc->num_samples++;
@@ -409,7 +419,12 @@ static void handle_line(const struct sr_dev_inst *sdi)
 	struct dev_context *devc;
 	struct sr_serial_dev_inst *serial;
 	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog_old *analog;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	float fvalue;
+	gboolean got_value;
 	int num_tokens, n, i;
 	char cmd[16], **tokens;
 
@@ -427,15 +442,16 @@ static void handle_line(const struct sr_dev_inst *sdi)
 		return;
 	}
 
-	analog = NULL;
+	got_value = FALSE;
+	sr_analog_init(&analog, &encoding, &meaning, &spec, 0);
 	tokens = g_strsplit(devc->buf, ",", 0);
 	if (tokens[0]) {
 		if (devc->profile->model == FLUKE_187 || devc->profile->model == FLUKE_189) {
 			devc->expect_response = FALSE;
-			analog = handle_qm_18x(sdi, tokens);
+			got_value = handle_qm_18x(tokens, &analog, &fvalue);
 		} else if (devc->profile->model == FLUKE_287 || devc->profile->model == FLUKE_289) {
 			devc->expect_response = FALSE;
-			analog = handle_qm_28x(sdi, tokens);
+			got_value = handle_qm_28x(tokens, &analog, &fvalue);
 		} else if (devc->profile->model == FLUKE_190) {
 			devc->expect_response = FALSE;
 			for (num_tokens = 0; tokens[num_tokens]; num_tokens++);
@@ -463,14 +479,15 @@ static void handle_line(const struct sr_dev_inst *sdi)
 	g_strfreev(tokens);
 	devc->buflen = 0;
 
-	if (analog) {
+	if (got_value) {
 		/* Got a measurement. */
-		packet.type = SR_DF_ANALOG_OLD;
-		packet.payload = analog;
+		analog.meaning->channels = sdi->channels;
+		analog.num_samples = 1;
+		analog.data = &fvalue;
+		packet.type = SR_DF_ANALOG;
+		packet.payload = &analog;
 		sr_session_send(devc->cb_data, &packet);
 		devc->num_samples++;
-		g_free(analog->data);
-		g_free(analog);
 	}
 
 }
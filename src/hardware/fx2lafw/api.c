@@ -144,6 +144,11 @@ static const int32_t soft_trigger_matches[] = {
 	SR_TRIGGER_RISING,
 	SR_TRIGGER_FALLING,
 	SR_TRIGGER_EDGE,
+	SR_TRIGGER_UART,
+	SR_TRIGGER_SPI,
+	SR_TRIGGER_I2C,
+	SR_TRIGGER_PULSE,
+	SR_TRIGGER_TIMEOUT,
 };
 
 static const uint64_t samplerates[] = {
@@ -369,6 +374,23 @@ static GSList *dev_list(const struct sr_dev_driver *di)
 	return ((struct drv_context *)(di->context))->instances;
 }
 
+static GSList *usb_ids(const struct sr_dev_driver *di)
+{
+	GSList *ids;
+	int i;
+
+	(void)di;
+
+	ids = NULL;
+	for (i = 0; supported_fx2[i].vid; i++)
+		ids = usb_id_append(ids, supported_fx2[i].vid,
+				supported_fx2[i].pid,
+				supported_fx2[i].usb_manufacturer,
+				supported_fx2[i].usb_product);
+
+	return ids;
+}
+
 static int dev_open(struct sr_dev_inst *sdi)
 {
 	struct sr_dev_driver *di = sdi->driver;
@@ -812,6 +834,7 @@ SR_PRIV struct sr_dev_driver fx2lafw_driver_info = {
 	.scan = scan,
 	.dev_list = dev_list,
 	.dev_clear = NULL,
+	.usb_ids = usb_ids,
 	.config_get = config_get,
 	.config_set = config_set,
 	.config_list = config_list,
@@ -381,6 +381,22 @@ static void resubmit_transfer(struct libusb_transfer *transfer)
 
 }
 
+/* Report up to num_samples samples as lost, within the sample limit. */
+static void send_gap(struct dev_context *devc, uint64_t num_samples)
+{
+	if (devc->limit_samples) {
+		if (devc->sent_samples >= devc->limit_samples)
+			return;
+		num_samples = MIN(num_samples,
+				devc->limit_samples - devc->sent_samples);
+	}
+	if (!num_samples)
+		return;
+
+	std_session_send_df_gap(devc->cb_data, devc->sent_samples, num_samples);
+	devc->sent_samples += num_samples;
+}
+
 SR_PRIV void LIBUSB_CALL fx2lafw_receive_transfer(struct libusb_transfer *transfer)
 {
 	struct sr_dev_inst *sdi;
@@ -425,12 +441,26 @@ SR_PRIV void LIBUSB_CALL fx2lafw_receive_transfer(struct libusb_transfer *transf
 	}
 
 	if (transfer->actual_length == 0 || packet_has_error) {
+		/*
+		 * A failed transfer means a whole buffer of samples never
+		 * made it here, which the consumer is told about. Empty
+		 * transfers which merely timed out didn't lose anything.
+		 */
+		if (packet_has_error && devc->trigger_fired)
+			send_gap(devc, transfer->length / unitsize);
 		devc->empty_transfer_count++;
 		if (devc->empty_transfer_count > MAX_EMPTY_TRANSFERS) {
 			/*
-			 * The FX2 gave up. End the acquisition, the frontend
-			 * will work out that the samplecount is short.
+			 * The FX2 gave up. Report the rest of the requested
+			 * samples as lost and end the acquisition.
 			 */
+			sr_warn("Device stopped sending data.");
+			if (devc->trigger_fired)
+				send_gap(devc, devc->limit_samples);
+			fx2lafw_abort_acquisition(devc);
+			free_transfer(transfer);
+		} else if (devc->limit_samples &&
+				devc->sent_samples >= devc->limit_samples) {
 			fx2lafw_abort_acquisition(devc);
 			free_transfer(transfer);
 		} else {
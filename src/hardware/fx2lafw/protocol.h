@@ -110,7 +110,7 @@ struct dev_context {
 	gboolean sample_wide;
 	struct soft_trigger_logic *stl;
 
-	unsigned int sent_samples;
+	uint64_t sent_samples;
 	int submitted_transfers;
 	int empty_transfer_count;
 
@@ -652,21 +652,28 @@ static void clean_ctmv_rs_v(struct dev_context *devc)
 static void send_value(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
-	struct sr_datafeed_analog_old analog;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 	struct sr_datafeed_packet packet;
+	int digits;
 
 	devc = sdi->priv;
 
-	memset(&analog, 0, sizeof(struct sr_datafeed_analog_old));
-	analog.channels = sdi->channels;
+	/* The value is a count of the displayed last digit, times scale. */
+	digits = -lrint(log10(fabs(devc->scale * pow(1000.0, devc->scale1000))));
+
+	sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
+	analog.meaning->channels = sdi->channels;
 	analog.num_samples = 1;
-	analog.mq = devc->mq;
-	analog.unit = devc->unit;
-	analog.mqflags = devc->mqflags;
+	analog.meaning->mq = devc->mq;
+	analog.meaning->unit = devc->unit;
+	analog.meaning->mqflags = devc->mqflags;
 	analog.data = &devc->value;
 
 	memset(&packet, 0, sizeof(struct sr_datafeed_packet));
-	packet.type = SR_DF_ANALOG_OLD;
+	packet.type = SR_DF_ANALOG;
 	packet.payload = &analog;
 	sr_session_send(devc->cb_data, &packet);
 
@@ -19,6 +19,7 @@
 
 #include "protocol.h"
 #include <string.h>
+#include <math.h>
 
 #define ANALOG_CHANNELS 2
 #define VERTICAL_DIVISIONS 10
@@ -66,12 +67,14 @@ SR_PRIV int gwinstek_gds_800_receive_data(int fd, int revents, void *cb_data)
 	struct sr_scpi_dev_inst *scpi;
 	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog_old analog;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 	char command[32];
 	char *response;
-	float volts_per_division;
-	int num_samples, i;
-	float samples[MAX_SAMPLES];
+	float volts_per_division, volts_per_step;
+	int num_samples, digits;
 	uint32_t sample_rate;
 	char *end_ptr;
 
@@ -232,21 +235,32 @@ SR_PRIV int gwinstek_gds_800_receive_data(int fd, int revents, void *cb_data)
 			sr_spew("Received %d number of samples from channel "
 				"%d.", num_samples, devc->cur_acq_channel + 1);
 
-			/* Convert data. */
-			for (i = 0; i < num_samples; i++)
-				samples[i] = ((float) ((int16_t) (RB16(&devc->rcv_buffer[i*2])))) / 256. * VERTICAL_DIVISIONS * volts_per_division;
+			/*
+			 * Pass the big endian 16-bit samples on as they are,
+			 * 256 steps per division.
+			 */
+			volts_per_step = VERTICAL_DIVISIONS * volts_per_division / 256.;
+			digits = MAX(0, (int)ceil(-log10(volts_per_step)));
+			sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
+			encoding.unitsize = sizeof(int16_t);
+			encoding.is_signed = TRUE;
+			encoding.is_float = FALSE;
+			encoding.is_bigendian = TRUE;
+			sr_rational_set(&encoding.scale,
+				llround(VERTICAL_DIVISIONS * volts_per_division * 1e9),
+				256 * 1000000000ULL);
 
 			/* Fill frame. */
-			analog.channels = g_slist_append(NULL, g_slist_nth_data(sdi->channels, devc->cur_acq_channel));
+			analog.meaning->channels = g_slist_append(NULL, g_slist_nth_data(sdi->channels, devc->cur_acq_channel));
 			analog.num_samples = num_samples;
-			analog.data = samples;
-			analog.mq = SR_MQ_VOLTAGE;
-			analog.unit = SR_UNIT_VOLT;
-			analog.mqflags = 0;
-			packet.type = SR_DF_ANALOG_OLD;
+			analog.data = devc->rcv_buffer;
+			analog.meaning->mq = SR_MQ_VOLTAGE;
+			analog.meaning->unit = SR_UNIT_VOLT;
+			analog.meaning->mqflags = 0;
+			packet.type = SR_DF_ANALOG;
 			packet.payload = &analog;
 			sr_session_send(cb_data, &packet);
-			g_slist_free(analog.channels);
+			g_slist_free(analog.meaning->channels);
 
 			/* All channels acquired. */
 			if (devc->cur_acq_channel == ANALOG_CHANNELS - 1) {
@@ -320,8 +320,13 @@ static GVariant *build_tuples(const uint64_t (*array)[][2], unsigned int n)
 	return g_variant_builder_end(&gvb);
 }
 
-static int config_set(uint32_t key, GVariant *data, const struct sr_dev_inst *sdi,
-		      const struct sr_channel_group *cg)
+/*
+ * Send the command for one setting. The caller waits for the scope to
+ * complete it, and updates the sample rate if update_sample_rate is set.
+ */
+static int apply_config(uint32_t key, GVariant *data,
+		const struct sr_dev_inst *sdi, const struct sr_channel_group *cg,
+		gboolean *update_sample_rate)
 {
 	int ret, cg_type;
 	unsigned int i, j;
@@ -332,7 +337,6 @@ static int config_set(uint32_t key, GVariant *data, const struct sr_dev_inst *sd
 	const char *tmp;
 	uint64_t p, q;
 	double tmp_d;
-	gboolean update_sample_rate;
 
 	if (!sdi || !(devc = sdi->priv))
 		return SR_ERR_ARG;
@@ -342,7 +346,6 @@ static int config_set(uint32_t key, GVariant *data, const struct sr_dev_inst *sd
 
 	model = devc->model_config;
 	state = devc->model_state;
-	update_sample_rate = FALSE;
 
 	ret = SR_ERR_NA;
 
@@ -386,8 +389,7 @@ static int config_set(uint32_t key, GVariant *data, const struct sr_dev_inst *sd
 					   (*model->scpi_dialect)[SCPI_CMD_SET_VERTICAL_DIV],
 					   j, float_str);
 
-				if (sr_scpi_send(sdi->conn, command) != SR_OK ||
-				    sr_scpi_get_opc(sdi->conn) != SR_OK)
+				if (sr_scpi_send(sdi->conn, command) != SR_OK)
 					return SR_ERR;
 
 				break;
@@ -411,7 +413,7 @@ static int config_set(uint32_t key, GVariant *data, const struct sr_dev_inst *sd
 				   float_str);
 
 			ret = sr_scpi_send(sdi->conn, command);
-			update_sample_rate = TRUE;
+			*update_sample_rate = TRUE;
 			break;
 		}
 		break;
@@ -468,8 +470,7 @@ static int config_set(uint32_t key, GVariant *data, const struct sr_dev_inst *sd
 					   (*model->scpi_dialect)[SCPI_CMD_SET_COUPLING],
 					   j, tmp);
 
-				if (sr_scpi_send(sdi->conn, command) != SR_OK ||
-				    sr_scpi_get_opc(sdi->conn) != SR_OK)
+				if (sr_scpi_send(sdi->conn, command) != SR_OK)
 					return SR_ERR;
 				break;
 			}
@@ -483,6 +484,164 @@ static int config_set(uint32_t key, GVariant *data, const struct sr_dev_inst *sd
 		break;
 	}
 
+	return ret;
+}
+
+static int config_set(uint32_t key, GVariant *data, const struct sr_dev_inst *sdi,
+		      const struct sr_channel_group *cg)
+{
+	gboolean update_sample_rate;
+	int ret;
+
+	update_sample_rate = FALSE;
+	ret = apply_config(key, data, sdi, cg, &update_sample_rate);
+
+	if (ret == SR_OK)
+		ret = sr_scpi_get_opc(sdi->conn);
+
+	if (ret == SR_OK && update_sample_rate)
+		ret = hmo_update_sample_rate(sdi);
+
+	return ret;
+}
+
+/* The trigger position is converted to seconds using the timebase. */
+static const uint32_t batch_order[] = {
+	SR_CONF_LIMIT_FRAMES,
+	SR_CONF_TIMEBASE,
+	SR_CONF_HORIZ_TRIGGERPOS,
+	SR_CONF_VDIV,
+	SR_CONF_COUPLING,
+	SR_CONF_TRIGGER_SOURCE,
+	SR_CONF_TRIGGER_SLOPE,
+};
+
+/* Check a batch entry against the model's tables, without sending it. */
+static int config_check(struct dev_context *devc,
+		const struct sr_config_batch_entry *entry)
+{
+	const struct scope_config *model;
+	unsigned int i;
+	const char *tmp;
+	uint64_t p, q;
+	double tmp_d;
+	int cg_type;
+
+	model = devc->model_config;
+
+	if ((cg_type = check_channel_group(devc, entry->cg)) == CG_INVALID)
+		return SR_ERR;
+
+	switch (entry->key) {
+	case SR_CONF_TRIGGER_SOURCE:
+		tmp = g_variant_get_string(entry->data, NULL);
+		for (i = 0; (*model->trigger_sources)[i]; i++) {
+			if (!g_strcmp0(tmp, (*model->trigger_sources)[i]))
+				break;
+		}
+		if (!(*model->trigger_sources)[i]) {
+			sr_err("Invalid trigger source: '%s'.", tmp);
+			return SR_ERR_ARG;
+		}
+		break;
+	case SR_CONF_VDIV:
+	case SR_CONF_COUPLING:
+		if (cg_type == CG_NONE) {
+			sr_err("No channel group specified.");
+			return SR_ERR_CHANNEL_GROUP;
+		}
+		if (cg_type != CG_ANALOG) {
+			sr_err("Not an analog channel group.");
+			return SR_ERR_ARG;
+		}
+		if (entry->key == SR_CONF_VDIV) {
+			g_variant_get(entry->data, "(tt)", &p, &q);
+			for (i = 0; i < model->num_vdivs; i++) {
+				if (p == (*model->vdivs)[i][0] &&
+				    q == (*model->vdivs)[i][1])
+					break;
+			}
+			if (i == model->num_vdivs) {
+				sr_err("Invalid vdiv: %" PRIu64 "/%" PRIu64 ".",
+					p, q);
+				return SR_ERR_ARG;
+			}
+		} else {
+			tmp = g_variant_get_string(entry->data, NULL);
+			for (i = 0; (*model->coupling_options)[i]; i++) {
+				if (!strcmp(tmp, (*model->coupling_options)[i]))
+					break;
+			}
+			if (!(*model->coupling_options)[i]) {
+				sr_err("Invalid coupling: '%s'.", tmp);
+				return SR_ERR_ARG;
+			}
+		}
+		break;
+	case SR_CONF_TIMEBASE:
+		g_variant_get(entry->data, "(tt)", &p, &q);
+		for (i = 0; i < model->num_timebases; i++) {
+			if (p == (*model->timebases)[i][0] &&
+			    q == (*model->timebases)[i][1])
+				break;
+		}
+		if (i == model->num_timebases) {
+			sr_err("Invalid timebase: %" PRIu64 "/%" PRIu64 ".",
+				p, q);
+			return SR_ERR_ARG;
+		}
+		break;
+	case SR_CONF_HORIZ_TRIGGERPOS:
+		tmp_d = g_variant_get_double(entry->data);
+		if (tmp_d < 0.0 || tmp_d > 1.0) {
+			sr_err("Invalid horiz. trigger position: %g.", tmp_d);
+			return SR_ERR_ARG;
+		}
+		break;
+	case SR_CONF_TRIGGER_SLOPE:
+		tmp = g_variant_get_string(entry->data, NULL);
+		if (tmp[0] != 'f' && tmp[0] != 'r') {
+			sr_err("Unknown trigger slope: '%s'.", tmp);
+			return SR_ERR_ARG;
+		}
+		break;
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Send all commands of a batch in a row, then wait for the scope and
+ * update the sample rate once, instead of after every setting.
+ */
+static int config_set_batch(const struct sr_dev_inst *sdi, GSList *entries)
+{
+	struct dev_context *devc;
+	const struct sr_config_batch_entry *entry;
+	GSList *sorted, *l;
+	gboolean update_sample_rate;
+	int ret;
+
+	if (!sdi || !(devc = sdi->priv))
+		return SR_ERR_ARG;
+
+	/* Reject the whole batch before anything is sent. */
+	for (l = entries; l; l = l->next) {
+		if ((ret = config_check(devc, l->data)) != SR_OK)
+			return ret;
+	}
+
+	sorted = std_config_batch_sort(entries, batch_order,
+			ARRAY_SIZE(batch_order));
+	update_sample_rate = FALSE;
+	ret = SR_OK;
+	for (l = sorted; l && ret == SR_OK; l = l->next) {
+		entry = l->data;
+		ret = apply_config(entry->key, entry->data, sdi, entry->cg,
+				&update_sample_rate);
+	}
+	g_slist_free(sorted);
+
 	if (ret == SR_OK)
 		ret = sr_scpi_get_opc(sdi->conn);
 
@@ -801,6 +960,7 @@ SR_PRIV struct sr_dev_driver hameg_hmo_driver_info = {
 	.dev_clear = dev_clear,
 	.config_get = config_get,
 	.config_set = config_set,
+	.config_set_batch = config_set_batch,
 	.config_list = config_list,
 	.dev_open = dev_open,
 	.dev_close = dev_close,
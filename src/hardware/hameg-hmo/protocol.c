@@ -727,10 +727,17 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 	struct sr_channel *ch;
 	struct sr_dev_inst *sdi;
 	struct dev_context *devc;
+	const struct scope_config *config;
+	struct scope_state *state;
 	struct sr_datafeed_packet packet;
 	GArray *data;
-	struct sr_datafeed_analog_old analog;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 	struct sr_datafeed_logic logic;
+	const uint64_t *vdiv;
+	int digits;
 
 	(void)fd;
 
@@ -759,16 +766,23 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 		packet.type = SR_DF_FRAME_BEGIN;
 		sr_session_send(sdi, &packet);
 
-		analog.channels = g_slist_append(NULL, ch);
+		/* 8-bit samples across the 8 vertical divisions. */
+		config = devc->model_config;
+		state = devc->model_state;
+		vdiv = (*config->vdivs)[state->analog_channels[ch->index].vdiv];
+		digits = MAX(0, (int)ceil(log10(256.0 / 8 * vdiv[1] / vdiv[0])));
+
+		sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
+		analog.meaning->channels = g_slist_append(NULL, ch);
 		analog.num_samples = data->len;
 		analog.data = (float *) data->data;
-		analog.mq = SR_MQ_VOLTAGE;
-		analog.unit = SR_UNIT_VOLT;
-		analog.mqflags = 0;
-		packet.type = SR_DF_ANALOG_OLD;
+		analog.meaning->mq = SR_MQ_VOLTAGE;
+		analog.meaning->unit = SR_UNIT_VOLT;
+		analog.meaning->mqflags = 0;
+		packet.type = SR_DF_ANALOG;
 		packet.payload = &analog;
 		sr_session_send(cb_data, &packet);
-		g_slist_free(analog.channels);
+		g_slist_free(analog.meaning->channels);
 		g_array_free(data, TRUE);
 		data = NULL;
 		break;
@@ -18,13 +18,12 @@
  */
 
 #include <config.h>
+#include <math.h>
 #include "protocol.h"
 
 /* Max time in ms before we want to check on USB events */
 #define TICK 200
 
-#define RANGE(ch) (((float)vdivs[devc->voltage[ch]][0] / vdivs[devc->voltage[ch]][1]) * VDIV_MULTIPLIER)
-
 static const uint32_t scanopts[] = {
 	SR_CONF_CONN,
 };
@@ -261,6 +260,25 @@ static GSList *dev_list(const struct sr_dev_driver *di)
 	return ((struct drv_context *)(di->context))->instances;
 }
 
+/* Devices are listed before and after their firmware upload. */
+static GSList *usb_ids(const struct sr_dev_driver *di)
+{
+	GSList *ids;
+	int i;
+
+	(void)di;
+
+	ids = NULL;
+	for (i = 0; dev_profiles[i].orig_vid; i++) {
+		ids = usb_id_append(ids, dev_profiles[i].orig_vid,
+				dev_profiles[i].orig_pid, NULL, NULL);
+		ids = usb_id_append(ids, dev_profiles[i].fw_vid,
+				dev_profiles[i].fw_pid, NULL, NULL);
+	}
+
+	return ids;
+}
+
 static int dev_open(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
@@ -534,68 +552,93 @@ static void send_chunk(struct sr_dev_inst *sdi, unsigned char *buf,
 		int num_samples)
 {
 	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog_old analog;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 	struct dev_context *devc = sdi->priv;
-	int num_channels, data_offset, i;
-
-	const float ch1_bit = RANGE(0) / 255;
-	const float ch2_bit = RANGE(1) / 255;
-	const float ch1_center = RANGE(0) / 2;
-	const float ch2_center = RANGE(1) / 2;
-
-	const gboolean ch1_ena = !!devc->ch_enabled[0];
-	const gboolean ch2_ena = !!devc->ch_enabled[1];
-
-	num_channels = (ch1_ena && ch2_ena) ? 2 : 1;
-	packet.type = SR_DF_ANALOG_OLD;
-	packet.payload = &analog;
-
-	analog.channels = devc->enabled_channels;
-	analog.num_samples = num_samples;
-	analog.mq = SR_MQ_VOLTAGE;
-	analog.unit = SR_UNIT_VOLT;
-	analog.mqflags = 0;
+	struct sr_channel *ch;
+	const uint64_t *vdiv;
+	GSList *l, channel;
+	uint8_t *data;
+	int i, digits;
 
-	analog.data = g_try_malloc(analog.num_samples * sizeof(float) * num_channels);
-	if (!analog.data) {
+	data = g_try_malloc(num_samples);
+	if (!data) {
 		sr_err("Analog data buffer malloc failed.");
 		devc->dev_state = STOPPING;
 		return;
 	}
 
-	data_offset = 0;
-	for (i = 0; i < num_samples; i++) {
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+
+	for (l = devc->enabled_channels; l; l = l->next) {
+		ch = l->data;
+		if (!devc->ch_enabled[ch->index])
+			continue;
+
 		/*
-		 * The device always sends data for both channels. If a channel
-		 * is disabled, it contains a copy of the enabled channel's
-		 * data. However, we only send the requested channels to
-		 * the bus.
+		 * The device always sends data for both channels, interleaved.
+		 * We only send the requested channels to the bus, one packet
+		 * each, as the raw bytes.
 		 *
 		 * Voltage values are encoded as a value 0-255, where the
 		 * value is a point in the range represented by the vdiv
 		 * setting. There are 10 vertical divs, so e.g. 500mV/div
 		 * represents 5V peak-to-peak where 0 = -2.5V and 255 = +2.5V.
 		 */
-		if (ch1_ena)
-			analog.data[data_offset++] = (ch1_bit * *(buf + i * 2) - ch1_center);
-		if (ch2_ena)
-			analog.data[data_offset++] = (ch2_bit * *(buf + i * 2 + 1) - ch2_center);
+		for (i = 0; i < num_samples; i++)
+			data[i] = buf[i * 2 + ch->index];
+
+		vdiv = vdivs[devc->voltage[ch->index]];
+		digits = MAX(0, (int)ceil(log10(255.0 * vdiv[1]
+				/ (vdiv[0] * VDIV_MULTIPLIER))));
+		sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
+		encoding.unitsize = sizeof(uint8_t);
+		encoding.is_signed = FALSE;
+		encoding.is_float = FALSE;
+		sr_rational_set(&encoding.scale, vdiv[0] * VDIV_MULTIPLIER,
+				vdiv[1] * 255);
+		sr_rational_set(&encoding.offset,
+				-(int64_t)(vdiv[0] * VDIV_MULTIPLIER), vdiv[1] * 2);
+		channel.data = ch;
+		channel.next = NULL;
+		meaning.channels = &channel;
+		meaning.mq = SR_MQ_VOLTAGE;
+		meaning.unit = SR_UNIT_VOLT;
+		meaning.mqflags = 0;
+		analog.num_samples = num_samples;
+		analog.data = data;
+		sr_session_send(devc->cb_data, &packet);
 	}
 
-	sr_session_send(devc->cb_data, &packet);
-	g_free(analog.data);
+	g_free(data);
+}
+
+static gboolean transfer_failed(const struct libusb_transfer *transfer)
+{
+	return transfer->status != LIBUSB_TRANSFER_COMPLETED &&
+		transfer->status != LIBUSB_TRANSFER_TIMED_OUT;
 }
 
 static void send_data(struct sr_dev_inst *sdi, struct libusb_transfer *buf[], uint64_t samples)
 {
+	struct dev_context *devc = sdi->priv;
 	int i = 0;
 	uint64_t send = 0;
 	uint32_t chunk;
 
 	while (send < samples) {
-		chunk = MIN(samples - send, (uint64_t)(buf[i]->actual_length / NUM_CHANNELS));
+		if (transfer_failed(buf[i])) {
+			/* The samples this transfer was to bring are lost. */
+			chunk = MIN(samples - send, (uint64_t)(buf[i]->length / NUM_CHANNELS));
+			std_session_send_df_gap(devc->cb_data, send, chunk);
+		} else {
+			chunk = MIN(samples - send, (uint64_t)(buf[i]->actual_length / NUM_CHANNELS));
+			send_chunk(sdi, buf[i]->buffer, chunk);
+		}
 		send += chunk;
-		send_chunk(sdi, buf[i]->buffer, chunk);
 
 		/*
 		 * Everything in this transfer was either copied to the buffer
@@ -659,6 +702,13 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 	sr_spew("receive_transfer(): status %s received %d bytes.",
 		libusb_error_name(transfer->status), transfer->actual_length);
 
+	if (transfer_failed(transfer)) {
+		/* Keep going, send_data() reports the loss in its place. */
+		sr_warn("Transfer failed: %s.", libusb_error_name(transfer->status));
+		read_channel(sdi, data_amount(sdi));
+		return;
+	}
+
 	if (transfer->actual_length == 0)
 		/* Nothing to send to the bus. */
 		return;
@@ -804,6 +854,7 @@ SR_PRIV struct sr_dev_driver hantek_6xxx_driver_info = {
 	.scan = scan,
 	.dev_list = dev_list,
 	.dev_clear = dev_clear,
+	.usb_ids = usb_ids,
 	.config_get = config_get,
 	.config_set = config_set,
 	.config_list = config_list,
@@ -28,6 +28,7 @@
 #include <string.h>
 #include <sys/time.h>
 #include <inttypes.h>
+#include <math.h>
 #include <glib.h>
 #include <libusb.h>
 #include <libsigrok/libsigrok.h>
@@ -363,6 +364,25 @@ static GSList *dev_list(const struct sr_dev_driver *di)
 	return ((struct drv_context *)(di->context))->instances;
 }
 
+/* Devices are listed before and after their firmware upload. */
+static GSList *usb_ids(const struct sr_dev_driver *di)
+{
+	GSList *ids;
+	int i;
+
+	(void)di;
+
+	ids = NULL;
+	for (i = 0; dev_profiles[i].orig_vid; i++) {
+		ids = usb_id_append(ids, dev_profiles[i].orig_vid,
+				dev_profiles[i].orig_pid, NULL, NULL);
+		ids = usb_id_append(ids, dev_profiles[i].fw_vid,
+				dev_profiles[i].fw_pid, NULL, NULL);
+	}
+
+	return ids;
+}
+
 static int dev_open(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
@@ -709,30 +729,31 @@ static void send_chunk(struct sr_dev_inst *sdi, unsigned char *buf,
 		int num_samples)
 {
 	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog_old analog;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 	struct dev_context *devc;
-	float ch1, ch2, range;
-	int num_channels, data_offset, i;
+	struct sr_channel *ch;
+	const uint64_t *vdiv;
+	GSList *l, channel;
+	uint8_t *data;
+	int i, digits;
 
 	devc = sdi->priv;
-	num_channels = (devc->ch1_enabled && devc->ch2_enabled) ? 2 : 1;
-	packet.type = SR_DF_ANALOG_OLD;
+	if (!(data = g_try_malloc(num_samples))) {
+		sr_err("Analog data buffer malloc failed.");
+		return;
+	}
+	packet.type = SR_DF_ANALOG;
 	packet.payload = &analog;
-	/* TODO: support for 5xxx series 9-bit samples */
-	analog.channels = devc->enabled_channels;
-	analog.num_samples = num_samples;
-	analog.mq = SR_MQ_VOLTAGE;
-	analog.unit = SR_UNIT_VOLT;
-	analog.mqflags = 0;
-	/* TODO: Check malloc return value. */
-	analog.data = g_try_malloc(analog.num_samples * sizeof(float) * num_channels);
-	data_offset = 0;
-	for (i = 0; i < analog.num_samples; i++) {
+	for (l = devc->enabled_channels; l; l = l->next) {
+		ch = l->data;
 		/*
-		 * The device always sends data for both channels. If a channel
-		 * is disabled, it contains a copy of the enabled channel's
-		 * data. However, we only send the requested channels to
-		 * the bus.
+		 * The device always sends data for both channels, CH2 first.
+		 * If a channel is disabled, it contains a copy of the enabled
+		 * channel's data. However, we only send the requested channels
+		 * to the bus, one packet each, as the raw bytes.
 		 *
 		 * Voltage values are encoded as a value 0-255 (0-512 on the
 		 * DSO-5200*), where the value is a point in the range
@@ -741,22 +762,30 @@ static void send_chunk(struct sr_dev_inst *sdi, unsigned char *buf,
 		 * and 255 = +2V.
 		 */
 		/* TODO: Support for DSO-5xxx series 9-bit samples. */
-		if (devc->ch1_enabled) {
-			range = ((float)vdivs[devc->voltage[0]][0] / vdivs[devc->voltage[0]][1]) * 8;
-			ch1 = range / 255 * *(buf + i * 2 + 1);
-			/* Value is centered around 0V. */
-			ch1 -= range / 2;
-			analog.data[data_offset++] = ch1;
-		}
-		if (devc->ch2_enabled) {
-			range = ((float)vdivs[devc->voltage[1]][0] / vdivs[devc->voltage[1]][1]) * 8;
-			ch2 = range / 255 * *(buf + i * 2);
-			ch2 -= range / 2;
-			analog.data[data_offset++] = ch2;
-		}
+		for (i = 0; i < num_samples; i++)
+			data[i] = buf[i * 2 + 1 - ch->index];
+
+		vdiv = vdivs[devc->voltage[ch->index]];
+		digits = MAX(0, (int)ceil(log10(255.0 * vdiv[1] / (vdiv[0] * 8))));
+		sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
+		encoding.unitsize = sizeof(uint8_t);
+		encoding.is_signed = FALSE;
+		encoding.is_float = FALSE;
+		/* Value is centered around 0V. */
+		sr_rational_set(&encoding.scale, vdiv[0] * 8, vdiv[1] * 255);
+		sr_rational_set(&encoding.offset, -(int64_t)(vdiv[0] * 8),
+				vdiv[1] * 2);
+		channel.data = ch;
+		channel.next = NULL;
+		meaning.channels = &channel;
+		meaning.mq = SR_MQ_VOLTAGE;
+		meaning.unit = SR_UNIT_VOLT;
+		meaning.mqflags = 0;
+		analog.num_samples = num_samples;
+		analog.data = data;
+		sr_session_send(devc->cb_data, &packet);
 	}
-	sr_session_send(devc->cb_data, &packet);
-	g_free(analog.data);
+	g_free(data);
 }
 
 /*
@@ -1024,6 +1053,7 @@ SR_PRIV struct sr_dev_driver hantek_dso_driver_info = {
 	.scan = scan,
 	.dev_list = dev_list,
 	.dev_clear = dev_clear,
+	.usb_ids = usb_ids,
 	.config_get = config_get,
 	.config_set = config_set,
 	.config_list = config_list,
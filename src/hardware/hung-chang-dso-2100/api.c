@@ -260,7 +260,6 @@ static int dev_clear(const struct sr_dev_driver *di)
 
 static int dev_open(struct sr_dev_inst *sdi)
 {
-	struct dev_context *devc = sdi->priv;
 	int i;
 
 	if (sdi->status != SR_ST_INACTIVE)
@@ -278,10 +277,6 @@ static int dev_open(struct sr_dev_inst *sdi)
 	if (hung_chang_dso_2100_move_to(sdi, 1))
 		goto fail3;
 
-	devc->samples = g_try_malloc(1000 * sizeof(*devc->samples));
-	if (!devc->samples)
-		goto fail3;
-
 	sdi->status = SR_ST_ACTIVE;
 
 	return SR_OK;
@@ -297,12 +292,9 @@ fail1:
 
 static int dev_close(struct sr_dev_inst *sdi)
 {
-	struct dev_context *devc = sdi->priv;
-
 	if (sdi->status != SR_ST_ACTIVE)
 		return SR_OK;
 
-	g_free(devc->samples);
 	hung_chang_dso_2100_reset_port(sdi->conn);
 	ieee1284_release(sdi->conn);
 	ieee1284_close(sdi->conn);
@@ -18,6 +18,7 @@
  */
 
 #include <config.h>
+#include <math.h>
 #include <ieee1284.h>
 #include "protocol.h"
 
@@ -330,23 +331,31 @@ static void read_samples(struct parport *port, uint8_t ctrl, uint8_t *buf, size_
 static void push_samples(const struct sr_dev_inst *sdi, uint8_t *buf, size_t num)
 {
 	struct dev_context *devc = sdi->priv;
-	float *data = devc->samples;
-	struct sr_datafeed_analog_old analog = {
-		.channels = devc->enabled_channel,
-		.num_samples = num,
-		.mq = SR_MQ_VOLTAGE,
-		.unit = SR_UNIT_VOLT,
-		.mqflags = 0,
-		.data = data,
-	};
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 	struct sr_datafeed_packet packet = {
-		.type = SR_DF_ANALOG_OLD,
+		.type = SR_DF_ANALOG,
 		.payload = &analog,
 	};
 	float factor = devc->factor;
 
-	while (num--)
-		data[num] = (buf[num] - 0x80) * factor;
+	/* The raw ADC bytes, centered around 0x80. */
+	sr_analog_init(&analog, &encoding, &meaning, &spec,
+		       MAX(0, (int)ceil(-log10(factor))));
+	encoding.unitsize = sizeof(uint8_t);
+	encoding.is_signed = FALSE;
+	encoding.is_float = FALSE;
+	sr_rational_set(&encoding.scale, llround(factor * 1e9), 1000000000);
+	sr_rational_set(&encoding.offset, llround(-0x80 * factor * 1e9),
+			1000000000);
+	meaning.channels = devc->enabled_channel;
+	meaning.mq = SR_MQ_VOLTAGE;
+	meaning.unit = SR_UNIT_VOLT;
+	meaning.mqflags = 0;
+	analog.num_samples = num;
+	analog.data = buf;
 
 	sr_session_send(devc->cb_data, &packet);
 }
@@ -53,7 +53,6 @@ struct dev_context {
 
 	/* Temporary state across callbacks */
 	void *cb_data;
-	float *samples;
 	float factor;
 	gboolean state_known;
 };
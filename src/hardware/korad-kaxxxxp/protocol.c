@@ -328,7 +328,10 @@ SR_PRIV int korad_kaxxxxp_receive_data(int fd, int revents, void *cb_data)
 	struct dev_context *devc;
 	struct sr_serial_dev_inst *serial;
 	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog_old analog;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 	int64_t t, elapsed_us;
 
 	(void)fd;
@@ -346,21 +349,24 @@ SR_PRIV int korad_kaxxxxp_receive_data(int fd, int revents, void *cb_data)
 		korad_kaxxxxp_get_reply(serial, devc);
 
 		/* Send the value forward. */
-		packet.type = SR_DF_ANALOG_OLD;
+		packet.type = SR_DF_ANALOG;
 		packet.payload = &analog;
-		analog.channels = sdi->channels;
+		sr_analog_init(&analog, &encoding, &meaning, &spec, 0);
+		analog.meaning->channels = sdi->channels;
 		analog.num_samples = 1;
 		if (devc->target == KAXXXXP_CURRENT) {
-			analog.mq = SR_MQ_CURRENT;
-			analog.unit = SR_UNIT_AMPERE;
-			analog.mqflags = 0;
+			encoding.digits = spec.spec_digits = 3;
+			analog.meaning->mq = SR_MQ_CURRENT;
+			analog.meaning->unit = SR_UNIT_AMPERE;
+			analog.meaning->mqflags = 0;
 			analog.data = &devc->current;
 			sr_session_send(sdi, &packet);
 		}
 		if (devc->target == KAXXXXP_VOLTAGE) {
-			analog.mq = SR_MQ_VOLTAGE;
-			analog.unit = SR_UNIT_VOLT;
-			analog.mqflags = SR_MQFLAG_DC;
+			encoding.digits = spec.spec_digits = 2;
+			analog.meaning->mq = SR_MQ_VOLTAGE;
+			analog.meaning->unit = SR_UNIT_VOLT;
+			analog.meaning->mqflags = SR_MQFLAG_DC;
 			analog.data = &devc->voltage;
 			sr_session_send(sdi, &packet);
 			devc->num_samples++;
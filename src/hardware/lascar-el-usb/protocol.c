@@ -383,9 +383,12 @@ static void lascar_el_usb_dispatch(struct sr_dev_inst *sdi, unsigned char *buf,
 {
 	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog_old analog;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 	struct sr_channel *ch;
-	float *temp, *rh;
+	float *temp, *rh, *co;
 	uint16_t s;
 	int samples, samples_left, i, j;
 
@@ -397,9 +400,9 @@ static void lascar_el_usb_dispatch(struct sr_dev_inst *sdi, unsigned char *buf,
 		samples = samples_left;
 	switch (devc->profile->logformat) {
 	case LOG_TEMP_RH:
-		packet.type = SR_DF_ANALOG_OLD;
+		packet.type = SR_DF_ANALOG;
 		packet.payload = &analog;
-		analog.mqflags = 0;
+		sr_analog_init(&analog, &encoding, &meaning, &spec, 0);
 		if (!(temp = g_try_malloc(sizeof(float) * samples)))
 			break;
 		if (!(rh = g_try_malloc(sizeof(float) * samples)))
@@ -423,48 +426,50 @@ static void lascar_el_usb_dispatch(struct sr_dev_inst *sdi, unsigned char *buf,
 
 		ch = sdi->channels->data;
 		if (ch->enabled) {
-			analog.channels = g_slist_append(NULL, ch);
-			analog.mq = SR_MQ_TEMPERATURE;
+			analog.meaning->channels = g_slist_append(NULL, ch);
+			analog.meaning->mq = SR_MQ_TEMPERATURE;
 			if (devc->temp_unit == 1)
-				analog.unit = SR_UNIT_FAHRENHEIT;
+				analog.meaning->unit = SR_UNIT_FAHRENHEIT;
 			else
-				analog.unit = SR_UNIT_CELSIUS;
+				analog.meaning->unit = SR_UNIT_CELSIUS;
 			analog.data = temp;
 			sr_session_send(devc->cb_data, &packet);
-			g_slist_free(analog.channels);
+			g_slist_free(analog.meaning->channels);
 		}
 
 		ch = sdi->channels->next->data;
 		if (ch->enabled) {
-			analog.channels = g_slist_append(NULL, ch);
-			analog.mq = SR_MQ_RELATIVE_HUMIDITY;
-			analog.unit = SR_UNIT_PERCENTAGE;
+			analog.meaning->channels = g_slist_append(NULL, ch);
+			analog.meaning->mq = SR_MQ_RELATIVE_HUMIDITY;
+			analog.meaning->unit = SR_UNIT_PERCENTAGE;
 			analog.data = rh;
 			sr_session_send(devc->cb_data, &packet);
-			g_slist_free(analog.channels);
+			g_slist_free(analog.meaning->channels);
 		}
 
 		g_free(temp);
 		g_free(rh);
 		break;
 	case LOG_CO:
-		packet.type = SR_DF_ANALOG_OLD;
+		packet.type = SR_DF_ANALOG;
 		packet.payload = &analog;
-		analog.channels = sdi->channels;
+		sr_analog_init(&analog, &encoding, &meaning, &spec, 6);
+		analog.meaning->channels = sdi->channels;
 		analog.num_samples = samples;
-		analog.mq = SR_MQ_CARBON_MONOXIDE;
-		analog.unit = SR_UNIT_CONCENTRATION;
-		analog.mqflags = 0;
-		if (!(analog.data = g_try_malloc(sizeof(float) * samples)))
+		analog.meaning->mq = SR_MQ_CARBON_MONOXIDE;
+		analog.meaning->unit = SR_UNIT_CONCENTRATION;
+		analog.meaning->mqflags = 0;
+		if (!(co = g_try_malloc(sizeof(float) * samples)))
 			break;
 		for (i = 0; i < samples; i++) {
 			s = (buf[i * 2] << 8) | buf[i * 2 + 1];
-			analog.data[i] = (s * devc->co_high + devc->co_low) / (1000 * 1000);
-			if (analog.data[i] < 0.0)
-				analog.data[i] = 0.0;
+			co[i] = (s * devc->co_high + devc->co_low) / (1000 * 1000);
+			if (co[i] < 0.0)
+				co[i] = 0.0;
 		}
+		analog.data = co;
 		sr_session_send(devc->cb_data, &packet);
-		g_free(analog.data);
+		g_free(co);
 		break;
 	default:
 		/* How did we even get this far? */
@@ -34,6 +34,8 @@
 
 #define UNKNOWN_ADDRESS 0xff
 #define MAX_RENUM_DELAY_MS 3000
+#define MIN_RENUM_DELAY_MS 300
+#define MAX_RENUM_POLL_DELAY_MS 100
 
 static const uint32_t devopts[] = {
 	SR_CONF_LOGIC_ANALYZER,
@@ -196,9 +198,20 @@ static GSList *dev_list(const struct sr_dev_driver *di)
 	return ((struct drv_context *)(di->context))->instances;
 }
 
+static void clear_helper(void *priv)
+{
+	struct dev_context *devc;
+
+	devc = priv;
+
+	g_free(devc->bitstreams[0]);
+	g_free(devc->bitstreams[1]);
+	g_free(devc);
+}
+
 static int dev_clear(const struct sr_dev_driver *di)
 {
-	return std_dev_clear(di, NULL);
+	return std_dev_clear(di, clear_helper);
 }
 
 static int open_device(struct sr_dev_inst *sdi)
@@ -275,7 +288,7 @@ static int dev_open(struct sr_dev_inst *sdi)
 {
 	struct drv_context *drvc;
 	struct dev_context *devc;
-	int64_t timediff_us, timediff_ms;
+	int64_t timediff_us, timediff_ms, delay_ms;
 	int ret;
 
 	drvc = sdi->driver->context;
@@ -296,9 +309,18 @@ static int dev_open(struct sr_dev_inst *sdi)
 	} else {
 		sr_info("Waiting for device to reset.");
 
-		/* Takes >= 300ms for the FX2 to be gone from the USB bus. */
-		g_usleep(300 * 1000);
-		timediff_ms = 0;
+		/*
+		 * Takes >= 300ms for the FX2 to be gone from the USB bus,
+		 * counted from the firmware upload. Only sleep for the
+		 * remainder of that time, then poll with increasing delay.
+		 */
+		timediff_us = g_get_monotonic_time() - devc->fw_updated;
+		timediff_ms = timediff_us / 1000;
+
+		if (timediff_ms < MIN_RENUM_DELAY_MS)
+			g_usleep((MIN_RENUM_DELAY_MS - timediff_ms) * 1000);
+
+		delay_ms = 10;
 
 		while (timediff_ms < MAX_RENUM_DELAY_MS) {
 			ret = open_device(sdi);
@@ -306,7 +328,8 @@ static int dev_open(struct sr_dev_inst *sdi)
 			if (ret == SR_OK)
 				break;
 
-			g_usleep(100 * 1000);
+			g_usleep(delay_ms * 1000);
+			delay_ms = MIN(delay_ms * 2, MAX_RENUM_POLL_DELAY_MS);
 
 			timediff_us = g_get_monotonic_time() - devc->fw_updated;
 			timediff_ms = timediff_us / 1000;
@@ -44,6 +44,14 @@
 #define FPGA_FIRMWARE_SIZE 464196
 #define FPGA_FIRMWARE_CHUNK_SIZE 2048
 
+/* Number of bitstream chunks queued for transfer at any time. */
+#define FPGA_FIRMWARE_NUM_XFERS 16
+#define FPGA_FIRMWARE_XFER_TIMEOUT_MS 1000
+
+/* Bounds for polling the FPGA configuration status after an upload. */
+#define FPGA_VERIFY_TIMEOUT_MS 1000
+#define FPGA_VERIFY_MAX_DELAY_MS 100
+
 #define NUM_TRIGGER_STAGES 2
 #define TRIGGER_CFG_SIZE 45
 
@@ -116,6 +124,7 @@ struct regval {
 
 static void LIBUSB_CALL handle_fetch_samples_done(struct libusb_transfer *xfer);
 static void LIBUSB_CALL recv_bulk_transfer(struct libusb_transfer *xfer);
+static void LIBUSB_CALL recv_bitstream_transfer(struct libusb_transfer *xfer);
 
 static const struct samplerate_info samplerates[] = {
 	{ SR_GHZ(1),  -24, 0x1f },
@@ -416,32 +425,146 @@ out:
 	return resubmit_intr_xfer;
 }
 
-static int upload_fpga_bitstream(const struct sr_dev_inst *sdi,
+/** State of an asynchronous FPGA bitstream upload. */
+struct bitstream_upload {
+	struct libusb_device_handle *devhdl;
+	const uint8_t *data;
+	size_t size;
+	/** Offset of the next chunk to be queued. */
+	size_t offset;
+	/** Number of transfers which are still in flight. */
+	int num_pending;
+	gboolean failed;
+};
+
+static int submit_bitstream_chunk(struct bitstream_upload *upload,
+	struct libusb_transfer *xfer)
+{
+	size_t chunk_size;
+	int r;
+
+	chunk_size = MIN(FPGA_FIRMWARE_CHUNK_SIZE, upload->size - upload->offset);
+
+	libusb_fill_bulk_transfer(xfer, upload->devhdl, EP_BITSTREAM,
+		(unsigned char *)upload->data + upload->offset, chunk_size,
+		recv_bitstream_transfer, upload, FPGA_FIRMWARE_XFER_TIMEOUT_MS);
+
+	if ((r = libusb_submit_transfer(xfer)) < 0) {
+		sr_err("Failed to submit bitstream transfer: %s.",
+			libusb_error_name(r));
+		return SR_ERR;
+	}
+
+	upload->offset += chunk_size;
+
+	return SR_OK;
+}
+
+static void LIBUSB_CALL recv_bitstream_transfer(struct libusb_transfer *xfer)
+{
+	struct bitstream_upload *upload;
+
+	upload = xfer->user_data;
+
+	if (xfer->status != LIBUSB_TRANSFER_COMPLETED ||
+			xfer->actual_length != xfer->length) {
+		sr_err("FPGA firmware upload failed (transfer status %d).",
+			xfer->status);
+		upload->failed = TRUE;
+	} else if (!upload->failed && upload->offset < upload->size) {
+		/* Re-use this transfer for the next chunk. */
+		if (submit_bitstream_chunk(upload, xfer) == SR_OK)
+			return;
+		upload->failed = TRUE;
+	}
+
+	upload->num_pending--;
+	libusb_free_transfer(xfer);
+}
+
+static int read_fpga_status(const struct sr_dev_inst *sdi, uint8_t *status)
+{
+	struct sr_usb_dev_inst *usb;
+	int r;
+
+	usb = sdi->conn;
+
+	*status = 0x00;
+
+	r = libusb_control_transfer(usb->devhdl, CTRL_IN,
+		USB_COMMAND_VERIFY_UPLOAD, 0x07, 5444,
+		status, sizeof(*status), USB_TIMEOUT_MS);
+
+	if (r != sizeof(*status)) {
+		sr_err("CTRL_IN failed: %i.", r);
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Check whether the FPGA is (still) configured with the given bitstream,
+ * so that the upload can be skipped.
+ */
+static gboolean fpga_has_bitstream(const struct sr_dev_inst *sdi,
 	const char *firmware_name)
+{
+	struct dev_context *devc;
+	uint8_t status;
+
+	devc = sdi->priv;
+
+	if (!devc->fpga_bitstream || strcmp(devc->fpga_bitstream, firmware_name))
+		return FALSE;
+
+	if (read_fpga_status(sdi, &status) != SR_OK || status != 0x01) {
+		sr_dbg("FPGA lost its configuration.");
+		devc->fpga_bitstream = NULL;
+		return FALSE;
+	}
+
+	sr_dbg("FPGA already runs %s, skipping upload.", firmware_name);
+
+	return TRUE;
+}
+
+static int upload_fpga_bitstream(const struct sr_dev_inst *sdi,
+	const char *firmware_name, int index)
 {
 	struct drv_context *drvc;
+	struct dev_context *devc;
 	struct sr_usb_dev_inst *usb;
-	struct sr_resource firmware;
-	uint8_t firmware_chunk[FPGA_FIRMWARE_CHUNK_SIZE];
+	struct libusb_transfer *xfer;
+	struct bitstream_upload upload;
+	struct timeval tv;
 	uint8_t upload_succeeded;
-	ssize_t chunk_size;
-	int i, r, ret, actual_length;
+	size_t size;
+	int64_t deadline, delay_us;
+	int i, r;
 
 	drvc = sdi->driver->context;
+	devc = sdi->priv;
 	usb = sdi->conn;
 
-	ret = sr_resource_open(drvc->sr_ctx, &firmware,
-			SR_RESOURCE_FIRMWARE, firmware_name);
+	devc->fpga_bitstream = NULL;
 
-	if (ret != SR_OK)
-		return ret;
+	/* Load the bitstream only once, and keep it around for later use. */
+	if (!devc->bitstreams[index]) {
+		devc->bitstreams[index] = sr_resource_load(drvc->sr_ctx,
+			SR_RESOURCE_FIRMWARE, firmware_name,
+			&size, FPGA_FIRMWARE_SIZE);
 
-	ret = SR_ERR;
+		if (!devc->bitstreams[index])
+			return SR_ERR;
 
-	if (firmware.size != FPGA_FIRMWARE_SIZE) {
-		sr_err("Invalid FPGA firmware file size: %" PRIu64 " bytes.",
-			firmware.size);
-		goto out;
+		if (size != FPGA_FIRMWARE_SIZE) {
+			sr_err("Invalid FPGA firmware file size: %zu bytes.",
+				size);
+			g_free(devc->bitstreams[index]);
+			devc->bitstreams[index] = NULL;
+			return SR_ERR;
+		}
 	}
 
 	/* Initiate upload. */
@@ -451,57 +574,72 @@ static int upload_fpga_bitstream(const struct sr_dev_inst *sdi,
 
 	if (r != 0) {
 		sr_err("Failed to initiate firmware upload: %s.",
-				libusb_error_name(ret));
-		goto out;
+				libusb_error_name(r));
+		return SR_ERR;
 	}
 
-	for (;;) {
-		chunk_size = sr_resource_read(drvc->sr_ctx, &firmware,
-			firmware_chunk, sizeof(firmware_chunk));
-
-		if (chunk_size < 0)
-			goto out;
-
-		if (chunk_size == 0)
+	/*
+	 * Keep several chunks in flight, so that the device never has to
+	 * wait for the host between two chunks.
+	 */
+	upload.devhdl = usb->devhdl;
+	upload.data = devc->bitstreams[index];
+	upload.size = FPGA_FIRMWARE_SIZE;
+	upload.offset = 0;
+	upload.num_pending = 0;
+	upload.failed = FALSE;
+
+	for (i = 0; i < FPGA_FIRMWARE_NUM_XFERS; i++) {
+		if (upload.offset >= upload.size)
 			break;
 
-		actual_length = chunk_size;
+		xfer = libusb_alloc_transfer(0);
 
-		r = libusb_bulk_transfer(usb->devhdl, EP_BITSTREAM,
-			firmware_chunk, chunk_size, &actual_length, USB_TIMEOUT_MS);
-
-		if (r != 0 || (ssize_t)actual_length != chunk_size) {
-			sr_err("FPGA firmware upload failed.");
-			goto out;
+		if (submit_bitstream_chunk(&upload, xfer) != SR_OK) {
+			libusb_free_transfer(xfer);
+			upload.failed = TRUE;
+			break;
 		}
+
+		upload.num_pending++;
 	}
 
-	/* Verify upload. */
-	for (i = 0; i < 4; i++) {
-		g_usleep(250000);
+	while (upload.num_pending > 0) {
+		tv.tv_sec = 0;
+		tv.tv_usec = 100 * 1000;
+		libusb_handle_events_timeout_completed(drvc->sr_ctx->libusb_ctx,
+			&tv, NULL);
+	}
 
-		upload_succeeded = 0x00;
+	if (upload.failed)
+		return SR_ERR;
 
-		r = libusb_control_transfer(usb->devhdl, CTRL_IN,
-			USB_COMMAND_VERIFY_UPLOAD, 0x07, 5444,
-			&upload_succeeded, sizeof(upload_succeeded),
-			USB_TIMEOUT_MS);
+	/*
+	 * Verify upload. Poll the status with an increasing delay
+	 * instead of sleeping for a fixed amount of time.
+	 */
+	deadline = g_get_monotonic_time() + FPGA_VERIFY_TIMEOUT_MS * 1000;
+	delay_us = 5 * 1000;
 
-		if (r != sizeof(upload_succeeded)) {
-			sr_err("CTRL_IN failed: %i.", r);
+	for (;;) {
+		if (read_fpga_status(sdi, &upload_succeeded) != SR_OK)
 			return SR_ERR;
-		}
 
-		if (upload_succeeded == 0x01) {
-			ret = SR_OK;
+		if (upload_succeeded == 0x01)
 			break;
+
+		if (g_get_monotonic_time() >= deadline) {
+			sr_err("FPGA did not accept the bitstream.");
+			return SR_ERR;
 		}
+
+		g_usleep(delay_us);
+		delay_us = MIN(delay_us * 2, FPGA_VERIFY_MAX_DELAY_MS * 1000);
 	}
 
-out:
-	sr_resource_close(drvc->sr_ctx, &firmware);
+	devc->fpga_bitstream = firmware_name;
 
-	return ret;
+	return SR_OK;
 }
 
 static int upload_trigger(const struct sr_dev_inst *sdi,
@@ -806,6 +944,7 @@ SR_PRIV int lls_setup_acquisition(const struct sr_dev_inst *sdi)
 	struct sr_usb_dev_inst *usb;
 	gboolean lower_enabled, upper_enabled, upload_bitstream;
 	uint32_t num_thousand_samples, num_enabled_channel_groups;
+	const char *bitstream;
 	int i, r;
 
 	usb = sdi->conn;
@@ -836,11 +975,15 @@ SR_PRIV int lls_setup_acquisition(const struct sr_dev_inst *sdi)
 	/*
 	 * If the number of enabled channel groups changed since
 	 * the last acquisition, we need to switch FPGA bitstreams.
-	 * This works for the initial bitstream upload because
-	 * devc->num_enabled_channel_groups is initialized to zero.
+	 * The same goes for the initial bitstream upload, or if the
+	 * FPGA lost its configuration in the meantime.
 	 */
-	upload_bitstream =
-		devc->num_enabled_channel_groups != num_enabled_channel_groups;
+	if (num_enabled_channel_groups == 1)
+		bitstream = FPGA_FIRMWARE_8;
+	else
+		bitstream = FPGA_FIRMWARE_16;
+
+	upload_bitstream = !fpga_has_bitstream(sdi, bitstream);
 
 	if (upload_bitstream) {
 		if (lls_stop_acquisition(sdi)) {
@@ -852,10 +995,8 @@ SR_PRIV int lls_setup_acquisition(const struct sr_dev_inst *sdi)
 			if (write_registers_sync(sdi, 0x0, 0x0, &threshold[i], 1))
 				return SR_ERR;
 
-		if (num_enabled_channel_groups == 1)
-			r = upload_fpga_bitstream(sdi, FPGA_FIRMWARE_8);
-		else
-			r = upload_fpga_bitstream(sdi, FPGA_FIRMWARE_16);
+		r = upload_fpga_bitstream(sdi, bitstream,
+			num_enabled_channel_groups - 1);
 
 		if (r != SR_OK) {
 			sr_err("Firmware not accepted by device.");
@@ -55,6 +55,15 @@ struct dev_context {
 
 	int64_t fw_updated; /* Time of last FX2 firmware upload. */
 
+	/**
+	 * The FPGA bitstreams for 8 and 16 channel mode (in that order).
+	 * Each is loaded on first use and kept across device opens.
+	 */
+	uint8_t *bitstreams[2];
+
+	/** Name of the bitstream the FPGA was configured with, or NULL. */
+	const char *fpga_bitstream;
+
 	/** The pre-trigger capture ratio in percent. */
 	uint64_t capture_ratio;
 
@@ -235,12 +235,13 @@ static int dev_close(struct sr_dev_inst *sdi)
 
 	if (modbus) {
 		devc = sdi->priv;
-		if (devc->expecting_registers) {
+		while (devc->pending_requests > 0) {
 			/* Wait for the last data that was requested from the device. */
 			uint16_t registers[devc->expecting_registers];
 			sr_modbus_read_holding_registers(modbus, -1,
 			                                 devc->expecting_registers,
 			                                 registers);
+			devc->pending_requests--;
 		}
 
 		maynuo_m97_set_bit(modbus, PC1, 0);
@@ -458,7 +459,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi,
 {
 	struct dev_context *devc;
 	struct sr_modbus_dev_inst *modbus;
-	int ret;
+	int num_requests, i, ret;
 
 	(void)cb_data;
 
@@ -477,8 +478,18 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi,
 
 	devc->num_samples = 0;
 	devc->starttime = g_get_monotonic_time();
+	devc->reply_time = devc->starttime;
+
+	/* Transports that match replies to requests can take several. */
+	num_requests = MIN(sr_modbus_max_requests(modbus), MAX_PENDING_REQUESTS);
+	if (devc->limit_samples)
+		num_requests = MIN((uint64_t)num_requests, devc->limit_samples);
+	for (i = 0; i < num_requests; i++) {
+		if ((ret = maynuo_m97_capture_start(sdi)) != SR_OK)
+			return ret;
+	}
 
-	return maynuo_m97_capture_start(sdi);
+	return SR_OK;
 }
 
 static int dev_acquisition_stop(struct sr_dev_inst *sdi, void *cb_data)
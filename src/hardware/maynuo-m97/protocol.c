@@ -128,19 +128,23 @@ SR_PRIV const char *maynuo_m97_mode_to_str(enum maynuo_m97_mode mode)
 static void maynuo_m97_session_send_value(const struct sr_dev_inst *sdi, struct sr_channel *ch, float value, enum sr_mq mq, enum sr_unit unit)
 {
 	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog_old analog;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 
-	analog.channels = g_slist_append(NULL, ch);
+	sr_analog_init(&analog, &encoding, &meaning, &spec, 3);
+	analog.meaning->channels = g_slist_append(NULL, ch);
 	analog.num_samples = 1;
 	analog.data = &value;
-	analog.mq = mq;
-	analog.unit = unit;
-	analog.mqflags = SR_MQFLAG_DC;
+	analog.meaning->mq = mq;
+	analog.meaning->unit = unit;
+	analog.meaning->mqflags = SR_MQFLAG_DC;
 
-	packet.type = SR_DF_ANALOG_OLD;
+	packet.type = SR_DF_ANALOG;
 	packet.payload = &analog;
 	sr_session_send(sdi, &packet);
-	g_slist_free(analog.channels);
+	g_slist_free(analog.meaning->channels);
 }
 
 SR_PRIV int maynuo_m97_capture_start(const struct sr_dev_inst *sdi)
@@ -152,8 +156,10 @@ SR_PRIV int maynuo_m97_capture_start(const struct sr_dev_inst *sdi)
 	modbus = sdi->conn;
 	devc = sdi->priv;
 
-	if ((ret = sr_modbus_read_holding_registers(modbus, U, 4, NULL)) == SR_OK)
+	if ((ret = sr_modbus_read_holding_registers(modbus, U, 4, NULL)) == SR_OK) {
 		devc->expecting_registers = 4;
+		devc->pending_requests++;
+	}
 	return ret;
 }
 
@@ -175,38 +181,54 @@ SR_PRIV int maynuo_m97_receive_data(int fd, int revents, void *cb_data)
 	modbus = sdi->conn;
 	devc = sdi->priv;
 
-	devc->expecting_registers = 0;
-	if (sr_modbus_read_holding_registers(modbus, -1, 4, registers) == SR_OK) {
-		packet.type = SR_DF_FRAME_BEGIN;
-		sr_session_send(cb_data, &packet);
-
-		maynuo_m97_session_send_value(sdi, sdi->channels->data,
-		                              RBFL(registers + 0),
-		                              SR_MQ_VOLTAGE, SR_UNIT_VOLT);
-		maynuo_m97_session_send_value(sdi, sdi->channels->next->data,
-		                              RBFL(registers + 2),
-		                              SR_MQ_CURRENT, SR_UNIT_AMPERE);
-
-		packet.type = SR_DF_FRAME_END;
-		sr_session_send(cb_data, &packet);
-		devc->num_samples++;
-	}
-
-	if (devc->limit_samples && (devc->num_samples >= devc->limit_samples)) {
-		sr_info("Requested number of samples reached.");
-		sdi->driver->dev_acquisition_stop(sdi, cb_data);
-		return TRUE;
-	}
+	/*
+	 * Handle the replies that have arrived. Don't hold up the session
+	 * waiting for the next, unless it's overdue; reading it then times
+	 * out, and another request goes out in its place.
+	 */
+	while (devc->pending_requests > 0) {
+		if (sr_modbus_reply_ready(modbus) == FALSE &&
+		    g_get_monotonic_time() - devc->reply_time < REPLY_TIMEOUT_US)
+			break;
+
+		devc->reply_time = g_get_monotonic_time();
+		devc->pending_requests--;
+		if (sr_modbus_read_holding_registers(modbus, -1, 4, registers) == SR_OK) {
+			packet.type = SR_DF_FRAME_BEGIN;
+			sr_session_send(cb_data, &packet);
+
+			maynuo_m97_session_send_value(sdi, sdi->channels->data,
+			                              RBFL(registers + 0),
+			                              SR_MQ_VOLTAGE, SR_UNIT_VOLT);
+			maynuo_m97_session_send_value(sdi, sdi->channels->next->data,
+			                              RBFL(registers + 2),
+			                              SR_MQ_CURRENT, SR_UNIT_AMPERE);
+
+			packet.type = SR_DF_FRAME_END;
+			sr_session_send(cb_data, &packet);
+			devc->num_samples++;
+		}
 
-	if (devc->limit_msec) {
-		t = (g_get_monotonic_time() - devc->starttime) / 1000;
-		if (t > (int64_t)devc->limit_msec) {
-			sr_info("Requested time limit reached.");
+		if (devc->limit_samples && (devc->num_samples >= devc->limit_samples)) {
+			sr_info("Requested number of samples reached.");
 			sdi->driver->dev_acquisition_stop(sdi, cb_data);
 			return TRUE;
 		}
+
+		if (devc->limit_msec) {
+			t = (g_get_monotonic_time() - devc->starttime) / 1000;
+			if (t > (int64_t)devc->limit_msec) {
+				sr_info("Requested time limit reached.");
+				sdi->driver->dev_acquisition_stop(sdi, cb_data);
+				return TRUE;
+			}
+		}
+
+		/* Keep as many requests going as will be answered within the limit. */
+		if (!devc->limit_samples || devc->num_samples +
+				devc->pending_requests < devc->limit_samples)
+			maynuo_m97_capture_start(sdi);
 	}
 
-	maynuo_m97_capture_start(sdi);
 	return TRUE;
 }
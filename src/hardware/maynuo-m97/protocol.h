@@ -26,6 +26,11 @@
 
 #define LOG_PREFIX "maynuo-m97"
 
+/* Measurement requests kept awaiting replies, if the transport allows. */
+#define MAX_PENDING_REQUESTS 4
+/* How long to wait for a reply before giving up on it. */
+#define REPLY_TIMEOUT_US (1000 * 1000)
+
 struct maynuo_m97_model {
 	unsigned int id;
 	const char *name;
@@ -46,7 +51,9 @@ struct dev_context {
 	/* Operational state */
 	uint64_t num_samples;
 	int64_t starttime;
+	int64_t reply_time;
 	int expecting_registers;
+	int pending_requests;
 };
 
 enum maynuo_m97_coil {
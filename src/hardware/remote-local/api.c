@@ -0,0 +1,362 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <unistd.h>
+#include "protocol.h"
+
+SR_PRIV struct sr_dev_driver remote_local_driver_info;
+
+static const uint32_t scanopts[] = {
+	SR_CONF_CONN,
+};
+
+static int init(struct sr_dev_driver *di, struct sr_context *sr_ctx)
+{
+	return std_init(sr_ctx, di, LOG_PREFIX);
+}
+
+static int hello(int sock)
+{
+	struct rl_msg *req;
+
+	req = rl_msg_new(RL_MSG_HELLO);
+	rl_put_u32(req, RL_PROTOCOL_VERSION);
+
+	return rl_request(sock, req, NULL);
+}
+
+/* Create a device from its entry in the server's device list. */
+static struct sr_dev_inst *dev_new(struct sr_dev_driver *di, const char *path,
+		uint32_t index, GVariant *entry)
+{
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	struct sr_channel_group *cg;
+	struct sr_channel *ch;
+	GVariantIter *channels, *groups, *indices;
+	const char *vendor, *model, *version, *serial, *name;
+	gboolean enabled;
+	int32_t ch_index, type;
+
+	g_variant_get(entry, "(&s&s&s&sa(iibs)a(sai))", &vendor, &model,
+			&version, &serial, &channels, &groups);
+
+	sdi = g_malloc0(sizeof(struct sr_dev_inst));
+	sdi->status = SR_ST_INACTIVE;
+	sdi->inst_type = SR_INST_USER;
+	sdi->vendor = *vendor ? g_strdup(vendor) : NULL;
+	sdi->model = g_strdup(model);
+	sdi->version = *version ? g_strdup(version) : NULL;
+	sdi->serial_num = *serial ? g_strdup(serial) : NULL;
+	sdi->connection_id = g_strdup_printf("%s/%u", path, index);
+	sdi->driver = di;
+
+	while (g_variant_iter_next(channels, "(iib&s)", &ch_index, &type,
+			&enabled, &name))
+		sr_channel_new(sdi, ch_index, type, enabled, name);
+	g_variant_iter_free(channels);
+
+	while (g_variant_iter_next(groups, "(&sai)", &name, &indices)) {
+		cg = g_malloc0(sizeof(struct sr_channel_group));
+		cg->name = g_strdup(name);
+		while (g_variant_iter_next(indices, "i", &ch_index)) {
+			if ((ch = rl_channel_by_index(sdi, ch_index)))
+				cg->channels = g_slist_append(cg->channels, ch);
+		}
+		g_variant_iter_free(indices);
+		sdi->channel_groups = g_slist_append(sdi->channel_groups, cg);
+	}
+	g_variant_iter_free(groups);
+
+	devc = g_malloc0(sizeof(struct dev_context));
+	devc->path = g_strdup(path);
+	devc->index = index;
+	devc->ctrl_fd = -1;
+	devc->data_fd = -1;
+	sdi->priv = devc;
+
+	return sdi;
+}
+
+static GSList *scan(struct sr_dev_driver *di, GSList *options)
+{
+	struct drv_context *drvc;
+	struct sr_dev_inst *sdi;
+	struct sr_config *src;
+	GVariant *list, *entry;
+	GSList *devices, *l;
+	const char *path;
+	gsize i;
+	int sock;
+
+	drvc = di->context;
+	devices = NULL;
+
+	path = NULL;
+	for (l = options; l; l = l->next) {
+		src = l->data;
+		if (src->key == SR_CONF_CONN)
+			path = g_variant_get_string(src->data, NULL);
+	}
+	/* There's no default socket to probe. */
+	if (!path)
+		return NULL;
+
+	if ((sock = rl_socket_connect(path)) < 0)
+		return NULL;
+
+	if (hello(sock) != SR_OK) {
+		sr_err("Server at %s doesn't speak our protocol.", path);
+		close(sock);
+		return NULL;
+	}
+	if (rl_request(sock, rl_msg_new(RL_MSG_DEV_LIST), &list) != SR_OK
+			|| !list) {
+		sr_err("Failed to get the device list from %s.", path);
+		close(sock);
+		return NULL;
+	}
+	close(sock);
+
+	for (i = 0; i < g_variant_n_children(list); i++) {
+		entry = g_variant_get_child_value(list, i);
+		sdi = dev_new(di, path, i, entry);
+		g_variant_unref(entry);
+		drvc->instances = g_slist_append(drvc->instances, sdi);
+		devices = g_slist_append(devices, sdi);
+	}
+	g_variant_unref(list);
+
+	return devices;
+}
+
+static GSList *dev_list(const struct sr_dev_driver *di)
+{
+	return ((struct drv_context *)(di->context))->instances;
+}
+
+static void clear_helper(void *priv)
+{
+	struct dev_context *devc;
+
+	devc = priv;
+	g_free(devc->path);
+	g_free(devc);
+}
+
+static int dev_clear(const struct sr_dev_driver *di)
+{
+	return std_dev_clear(di, clear_helper);
+}
+
+static int dev_open(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+
+	if ((devc->ctrl_fd = rl_socket_connect(devc->path)) < 0) {
+		sr_err("Failed to connect to %s.", devc->path);
+		return SR_ERR_IO;
+	}
+	if (hello(devc->ctrl_fd) != SR_OK) {
+		close(devc->ctrl_fd);
+		devc->ctrl_fd = -1;
+		return SR_ERR_IO;
+	}
+
+	sdi->status = SR_ST_ACTIVE;
+
+	return SR_OK;
+}
+
+static int dev_close(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+
+	if (devc->ctrl_fd >= 0) {
+		close(devc->ctrl_fd);
+		devc->ctrl_fd = -1;
+	}
+	sdi->status = SR_ST_INACTIVE;
+
+	return SR_OK;
+}
+
+static int cleanup(const struct sr_dev_driver *di)
+{
+	return dev_clear(di);
+}
+
+/* Forward a configuration request to the server. */
+static int config_request(uint32_t type, uint32_t key, GVariant **data,
+		const struct sr_dev_inst *sdi, const struct sr_channel_group *cg)
+{
+	struct dev_context *devc;
+	struct rl_msg *req;
+
+	devc = sdi->priv;
+	if (devc->ctrl_fd < 0)
+		return SR_ERR_DEV_CLOSED;
+
+	req = rl_msg_new(type);
+	rl_put_u32(req, devc->index);
+	rl_put_u32(req, key);
+	rl_put_str(req, cg ? cg->name : NULL);
+	if (type == RL_MSG_CONFIG_SET) {
+		rl_put_variant(req, *data);
+		return rl_request(devc->ctrl_fd, req, NULL);
+	}
+
+	return rl_request(devc->ctrl_fd, req, data);
+}
+
+static int config_get(uint32_t key, GVariant **data, const struct sr_dev_inst *sdi,
+		const struct sr_channel_group *cg)
+{
+	struct dev_context *devc;
+	int ret;
+
+	if (!sdi)
+		return SR_ERR_ARG;
+
+	devc = sdi->priv;
+
+	switch (key) {
+	case SR_CONF_CONN:
+		*data = g_variant_new_string(devc->path);
+		return SR_OK;
+	default:
+		ret = config_request(RL_MSG_CONFIG_GET, key, data, sdi, cg);
+		if (ret == SR_OK && !*data)
+			ret = SR_ERR;
+		return ret;
+	}
+}
+
+static int config_set(uint32_t key, GVariant *data, const struct sr_dev_inst *sdi,
+		const struct sr_channel_group *cg)
+{
+	if (sdi->status != SR_ST_ACTIVE)
+		return SR_ERR_DEV_CLOSED;
+
+	return config_request(RL_MSG_CONFIG_SET, key, &data, sdi, cg);
+}
+
+static int config_list(uint32_t key, GVariant **data, const struct sr_dev_inst *sdi,
+		const struct sr_channel_group *cg)
+{
+	int ret;
+
+	if (key == SR_CONF_SCAN_OPTIONS) {
+		*data = g_variant_new_fixed_array(G_VARIANT_TYPE_UINT32,
+				scanopts, ARRAY_SIZE(scanopts), sizeof(uint32_t));
+		return SR_OK;
+	}
+	if (!sdi)
+		return SR_ERR_NA;
+
+	ret = config_request(RL_MSG_CONFIG_LIST, key, data, sdi, cg);
+	if (ret == SR_OK && !*data)
+		ret = SR_ERR;
+
+	return ret;
+}
+
+static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
+{
+	struct dev_context *devc;
+	struct sr_channel *ch;
+	struct rl_msg *req;
+	GSList *l;
+	int ret;
+
+	if (sdi->status != SR_ST_ACTIVE)
+		return SR_ERR_DEV_CLOSED;
+
+	devc = sdi->priv;
+	devc->cb_data = cb_data;
+
+	/* The datafeed gets its own connection, so config requests still work. */
+	if ((devc->data_fd = rl_socket_connect(devc->path)) < 0) {
+		sr_err("Failed to connect to %s.", devc->path);
+		return SR_ERR_IO;
+	}
+
+	req = rl_msg_new(RL_MSG_START);
+	rl_put_u32(req, devc->index);
+	rl_put_u32(req, g_slist_length(sdi->channels));
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		rl_put_u8(req, ch->enabled);
+	}
+	if ((ret = rl_request(devc->data_fd, req, NULL)) != SR_OK) {
+		sr_err("Server failed to start acquisition: %s.",
+				sr_strerror(ret));
+		close(devc->data_fd);
+		devc->data_fd = -1;
+		return ret;
+	}
+
+	/* The server sends the header, and everything else. */
+	sr_session_source_add(sdi->session, devc->data_fd, G_IO_IN | G_IO_ERR,
+			-1, rl_receive_data, (void *)sdi);
+
+	return SR_OK;
+}
+
+static int dev_acquisition_stop(struct sr_dev_inst *sdi, void *cb_data)
+{
+	struct dev_context *devc;
+	struct rl_msg *req;
+
+	(void)cb_data;
+
+	devc = sdi->priv;
+	if (devc->data_fd < 0)
+		return SR_OK;
+
+	/* The server ends our feed with an SR_DF_END, which we pass on. */
+	req = rl_msg_new(RL_MSG_STOP);
+	rl_msg_send(devc->data_fd, req);
+	rl_msg_free(req);
+
+	return SR_OK;
+}
+
+SR_PRIV struct sr_dev_driver remote_local_driver_info = {
+	.name = "remote-local",
+	.longname = "Devices served by another process on this machine",
+	.api_version = 1,
+	.init = init,
+	.cleanup = cleanup,
+	.scan = scan,
+	.dev_list = dev_list,
+	.dev_clear = dev_clear,
+	.config_get = config_get,
+	.config_set = config_set,
+	.config_list = config_list,
+	.dev_open = dev_open,
+	.dev_close = dev_close,
+	.dev_acquisition_start = dev_acquisition_start,
+	.dev_acquisition_stop = dev_acquisition_stop,
+	.context = NULL,
+};
@@ -0,0 +1,1030 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* memfd_create() and MSG_CMSG_CLOEXEC are GNU extensions. */
+#define _GNU_SOURCE
+
+#include <config.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "protocol.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#ifndef MSG_CMSG_CLOEXEC
+#define MSG_CMSG_CLOEXEC 0
+#endif
+
+/* How a sample payload is transported. */
+enum {
+	PAYLOAD_INLINE,
+	PAYLOAD_FD,
+};
+
+SR_PRIV struct rl_msg *rl_msg_new(uint32_t type)
+{
+	struct rl_msg *msg;
+
+	msg = g_malloc0(sizeof(struct rl_msg));
+	msg->type = type;
+	msg->body = g_byte_array_new();
+	msg->fd = -1;
+
+	return msg;
+}
+
+SR_PRIV void rl_msg_free(struct rl_msg *msg)
+{
+	if (!msg)
+		return;
+
+	if (msg->fd >= 0)
+		close(msg->fd);
+	g_byte_array_free(msg->body, TRUE);
+	g_free(msg);
+}
+
+SR_PRIV void rl_put_u8(struct rl_msg *msg, uint8_t value)
+{
+	g_byte_array_append(msg->body, &value, sizeof(value));
+}
+
+SR_PRIV void rl_put_u32(struct rl_msg *msg, uint32_t value)
+{
+	g_byte_array_append(msg->body, (const guint8 *)&value, sizeof(value));
+}
+
+SR_PRIV void rl_put_u64(struct rl_msg *msg, uint64_t value)
+{
+	g_byte_array_append(msg->body, (const guint8 *)&value, sizeof(value));
+}
+
+SR_PRIV void rl_put_bytes(struct rl_msg *msg, const void *data, gsize len)
+{
+	g_byte_array_append(msg->body, data, len);
+}
+
+SR_PRIV void rl_put_str(struct rl_msg *msg, const char *str)
+{
+	uint32_t len;
+
+	if (!str) {
+		rl_put_u32(msg, UINT32_MAX);
+		return;
+	}
+	len = strlen(str);
+	rl_put_u32(msg, len);
+	rl_put_bytes(msg, str, len);
+}
+
+SR_PRIV void rl_put_variant(struct rl_msg *msg, GVariant *data)
+{
+	GVariant *normal;
+
+	normal = g_variant_get_normal_form(data);
+	rl_put_str(msg, g_variant_get_type_string(normal));
+	rl_put_u32(msg, g_variant_get_size(normal));
+	rl_put_bytes(msg, g_variant_get_data(normal), g_variant_get_size(normal));
+	g_variant_unref(normal);
+}
+
+SR_PRIV const void *rl_get_bytes(struct rl_msg *msg, gsize len)
+{
+	const void *p;
+
+	if (msg->truncated || len > msg->body->len - msg->pos) {
+		msg->truncated = TRUE;
+		return NULL;
+	}
+	p = msg->body->data + msg->pos;
+	msg->pos += len;
+
+	return p;
+}
+
+SR_PRIV uint8_t rl_get_u8(struct rl_msg *msg)
+{
+	const uint8_t *p;
+
+	p = rl_get_bytes(msg, sizeof(uint8_t));
+
+	return p ? *p : 0;
+}
+
+SR_PRIV uint32_t rl_get_u32(struct rl_msg *msg)
+{
+	const void *p;
+	uint32_t value;
+
+	if (!(p = rl_get_bytes(msg, sizeof(value))))
+		return 0;
+	memcpy(&value, p, sizeof(value));
+
+	return value;
+}
+
+SR_PRIV uint64_t rl_get_u64(struct rl_msg *msg)
+{
+	const void *p;
+	uint64_t value;
+
+	if (!(p = rl_get_bytes(msg, sizeof(value))))
+		return 0;
+	memcpy(&value, p, sizeof(value));
+
+	return value;
+}
+
+SR_PRIV char *rl_get_str(struct rl_msg *msg)
+{
+	const char *p;
+	uint32_t len;
+
+	len = rl_get_u32(msg);
+	if (len == UINT32_MAX || !(p = rl_get_bytes(msg, len)))
+		return NULL;
+
+	return g_strndup(p, len);
+}
+
+SR_PRIV GVariant *rl_get_variant(struct rl_msg *msg)
+{
+	GVariant *data;
+	const void *p;
+	void *copy;
+	char *type;
+	uint32_t len;
+
+	type = rl_get_str(msg);
+	len = rl_get_u32(msg);
+	p = rl_get_bytes(msg, len);
+	if (!type || !p || !g_variant_type_string_is_valid(type)) {
+		msg->truncated = TRUE;
+		g_free(type);
+		return NULL;
+	}
+	/* Not trusted, so GLib copes with data that isn't in normal form. */
+	copy = g_memdup(p, len);
+	data = g_variant_new_from_data(G_VARIANT_TYPE(type), copy, len,
+			FALSE, g_free, copy);
+	g_free(type);
+
+	return data;
+}
+
+static int socket_new(const char *path, struct sockaddr_un *addr)
+{
+	int sock;
+
+	if (strlen(path) >= sizeof(addr->sun_path)) {
+		sr_err("Socket path '%s' is too long.", path);
+		return -1;
+	}
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	strcpy(addr->sun_path, path);
+
+	if ((sock = socket(AF_UNIX, SOCK_SEQPACKET, 0)) < 0) {
+		sr_err("Failed to create socket: %s.", g_strerror(errno));
+		return -1;
+	}
+	fcntl(sock, F_SETFD, FD_CLOEXEC);
+
+	return sock;
+}
+
+SR_PRIV int rl_socket_connect(const char *path)
+{
+	struct sockaddr_un addr;
+	int sock;
+
+	if ((sock = socket_new(path, &addr)) < 0)
+		return -1;
+
+	if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		sr_dbg("Failed to connect to %s: %s.", path, g_strerror(errno));
+		close(sock);
+		return -1;
+	}
+
+	return sock;
+}
+
+SR_PRIV int rl_socket_listen(const char *path)
+{
+	struct sockaddr_un addr;
+	int sock;
+
+	if ((sock = socket_new(path, &addr)) < 0)
+		return -1;
+
+	/* Remove a stale socket left behind by an earlier server. */
+	unlink(path);
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0
+			|| listen(sock, 8) < 0) {
+		sr_err("Failed to listen on %s: %s.", path, g_strerror(errno));
+		close(sock);
+		return -1;
+	}
+
+	return sock;
+}
+
+/**
+ * Send a message, along with its file descriptor if it has one.
+ *
+ * On a blocking socket, this waits until the whole message has been
+ * queued on the socket.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_TIMEOUT The socket is non-blocking, and its buffer is full.
+ * @retval SR_ERR_IO The message could not be sent.
+ */
+SR_PRIV int rl_msg_send(int sock, const struct rl_msg *msg)
+{
+	union {
+		struct cmsghdr hdr;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} control;
+	struct cmsghdr *cmsg;
+	struct msghdr mh;
+	struct iovec iov[2];
+	ssize_t ret;
+
+	if (msg->body->len + sizeof(msg->type) > RL_MAX_MSG_SIZE) {
+		sr_err("Message of %u bytes is too large.", msg->body->len);
+		return SR_ERR_BUG;
+	}
+
+	iov[0].iov_base = (void *)&msg->type;
+	iov[0].iov_len = sizeof(msg->type);
+	iov[1].iov_base = msg->body->data;
+	iov[1].iov_len = msg->body->len;
+
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = iov;
+	mh.msg_iovlen = 2;
+	if (msg->fd >= 0) {
+		memset(&control, 0, sizeof(control));
+		mh.msg_control = control.buf;
+		mh.msg_controllen = sizeof(control.buf);
+		cmsg = CMSG_FIRSTHDR(&mh);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &msg->fd, sizeof(int));
+	}
+
+	do {
+		ret = sendmsg(sock, &mh, MSG_NOSIGNAL);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		return SR_ERR_TIMEOUT;
+	if (ret < 0) {
+		sr_dbg("Failed to send message: %s.", g_strerror(errno));
+		return SR_ERR_IO;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Receive a message.
+ *
+ * @param sock The socket to read from.
+ * @param timeout_ms Max time to wait for a message, 0 to only take one
+ *                   that is already there, or -1 to wait indefinitely.
+ * @param msg Set to the new message, or NULL if none arrived in time.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_IO The connection was closed, or a read error occurred.
+ */
+SR_PRIV int rl_msg_recv(int sock, int timeout_ms, struct rl_msg **msg)
+{
+	union {
+		struct cmsghdr hdr;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} control;
+	struct cmsghdr *cmsg;
+	struct msghdr mh;
+	struct iovec iov[2];
+	struct pollfd pfd;
+	struct rl_msg *m;
+	uint32_t type;
+	uint8_t *buf;
+	ssize_t len;
+	int ret, fd;
+
+	*msg = NULL;
+
+	pfd.fd = sock;
+	pfd.events = POLLIN;
+	do {
+		ret = poll(&pfd, 1, timeout_ms);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0) {
+		sr_err("Failed to poll socket: %s.", g_strerror(errno));
+		return SR_ERR_IO;
+	}
+	if (ret == 0)
+		return SR_OK;
+
+	/* Read the type and the body separately, so the body can be kept. */
+	buf = g_malloc(RL_MAX_MSG_SIZE);
+	iov[0].iov_base = &type;
+	iov[0].iov_len = sizeof(type);
+	iov[1].iov_base = buf;
+	iov[1].iov_len = RL_MAX_MSG_SIZE - sizeof(type);
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = iov;
+	mh.msg_iovlen = 2;
+	mh.msg_control = control.buf;
+	mh.msg_controllen = sizeof(control.buf);
+
+	do {
+		len = recvmsg(sock, &mh, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+	} while (len < 0 && errno == EINTR);
+	if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		g_free(buf);
+		return SR_OK;
+	}
+
+	fd = -1;
+	if (len > 0) {
+		for (cmsg = CMSG_FIRSTHDR(&mh); cmsg;
+				cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+			if (cmsg->cmsg_level == SOL_SOCKET
+					&& cmsg->cmsg_type == SCM_RIGHTS)
+				memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+		}
+	}
+
+	if (len < (ssize_t)sizeof(uint32_t) || (mh.msg_flags & MSG_TRUNC)) {
+		if (len < 0)
+			sr_dbg("Failed to receive message: %s.", g_strerror(errno));
+		else if (len > 0)
+			sr_err("Received a malformed message.");
+		if (fd >= 0)
+			close(fd);
+		g_free(buf);
+		return SR_ERR_IO;
+	}
+
+	m = g_malloc0(sizeof(struct rl_msg));
+	m->type = type;
+	m->body = g_byte_array_new_take(buf, len - sizeof(type));
+	m->fd = fd;
+	*msg = m;
+
+	return SR_OK;
+}
+
+/* Transfer data in a sealed memfd, so every client can map it read-only. */
+static int payload_fd_new(const void *data, gsize len)
+{
+#ifdef HAVE_MEMFD_CREATE
+	const uint8_t *p;
+	ssize_t ret;
+	int fd;
+
+	fd = memfd_create("sigrok-remote-local", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0) {
+		sr_dbg("memfd_create() failed: %s.", g_strerror(errno));
+		return -1;
+	}
+	for (p = data; len > 0; p += ret, len -= ret) {
+		ret = write(fd, p, len);
+		if (ret < 0 && errno == EINTR) {
+			ret = 0;
+		} else if (ret <= 0) {
+			sr_err("Failed to write memfd: %s.", g_strerror(errno));
+			close(fd);
+			return -1;
+		}
+	}
+	fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW
+			| F_SEAL_WRITE | F_SEAL_SEAL);
+
+	return fd;
+#else
+	(void)data;
+	(void)len;
+
+	return -1;
+#endif
+}
+
+static void put_payload(struct rl_msg *msg, const void *data, gsize len)
+{
+	if (len >= RL_FD_THRESHOLD && (msg->fd = payload_fd_new(data, len)) >= 0) {
+		rl_put_u8(msg, PAYLOAD_FD);
+		return;
+	}
+	rl_put_u8(msg, PAYLOAD_INLINE);
+	rl_put_bytes(msg, data, len);
+}
+
+/*
+ * Get a payload of the given size. Payloads passed in a memfd are
+ * mapped, and the mapping must be released with put_payload_done().
+ */
+static const void *get_payload(struct rl_msg *msg, gsize len, void **map)
+{
+	struct stat st;
+	void *p;
+
+	*map = NULL;
+	if (rl_get_u8(msg) == PAYLOAD_INLINE)
+		return rl_get_bytes(msg, len);
+
+	if (msg->fd < 0 || fstat(msg->fd, &st) < 0 || (gsize)st.st_size < len) {
+		sr_err("Invalid payload file descriptor.");
+		msg->truncated = TRUE;
+		return NULL;
+	}
+	if (len == 0)
+		return NULL;
+	p = mmap(NULL, len, PROT_READ, MAP_SHARED, msg->fd, 0);
+	if (p == MAP_FAILED) {
+		sr_err("Failed to map payload: %s.", g_strerror(errno));
+		msg->truncated = TRUE;
+		return NULL;
+	}
+	*map = p;
+
+	return p;
+}
+
+static void put_payload_done(void *map, gsize len)
+{
+	if (map)
+		munmap(map, len);
+}
+
+static void put_channels(struct rl_msg *msg, GSList *channels)
+{
+	struct sr_channel *ch;
+	GSList *l;
+
+	rl_put_u32(msg, g_slist_length(channels));
+	for (l = channels; l; l = l->next) {
+		ch = l->data;
+		rl_put_u32(msg, ch->index);
+	}
+}
+
+static void put_encoding(struct rl_msg *msg, const struct sr_analog_encoding *enc)
+{
+	rl_put_u8(msg, enc->unitsize);
+	rl_put_u8(msg, enc->is_signed);
+	rl_put_u8(msg, enc->is_float);
+	rl_put_u8(msg, enc->is_bigendian);
+	rl_put_u8(msg, enc->digits);
+	rl_put_u8(msg, enc->is_digits_decimal);
+	rl_put_u64(msg, enc->scale.p);
+	rl_put_u64(msg, enc->scale.q);
+	rl_put_u64(msg, enc->offset.p);
+	rl_put_u64(msg, enc->offset.q);
+}
+
+/* The channels of a meaning are sent separately. */
+static void put_meaning(struct rl_msg *msg,
+		const struct sr_analog_meaning *meaning)
+{
+	rl_put_u32(msg, meaning->mq);
+	rl_put_u32(msg, meaning->unit);
+	rl_put_u64(msg, meaning->mqflags);
+}
+
+/*
+ * Pack samples [first, first + num_samples) of a planar packet's planes
+ * back to back, for a payload of num_samples * unitsize bytes.
+ */
+static uint8_t *pack_planes(const struct sr_datafeed_analog_planar *planar,
+		gsize first, gsize num_samples, gsize unitsize)
+{
+	const struct sr_analog_plane *plane;
+	const uint8_t *src;
+	uint8_t *buf, *dst;
+	gsize plane_unitsize, stride, i;
+	uint32_t p;
+
+	buf = g_malloc(num_samples * unitsize);
+	dst = buf;
+	for (p = 0; p < planar->num_planes; p++) {
+		plane = &planar->planes[p];
+		plane_unitsize = plane->encoding->unitsize;
+		stride = plane->stride ? plane->stride : plane_unitsize;
+		src = (const uint8_t *)plane->data + first * stride;
+		for (i = 0; i < num_samples; i++) {
+			memcpy(dst, src, plane_unitsize);
+			dst += plane_unitsize;
+			src += stride;
+		}
+	}
+
+	return buf;
+}
+
+/* Samples per message, if the payload has to be split up. */
+static gsize chunk_units(gsize unitsize)
+{
+#ifdef HAVE_MEMFD_CREATE
+	(void)unitsize;
+
+	return G_MAXSIZE;
+#else
+	return MAX(RL_INLINE_MAX / MAX(unitsize, 1), 1);
+#endif
+}
+
+/**
+ * Encode a datafeed packet.
+ *
+ * This returns a list of messages, since large payloads are split up
+ * into several packets if they can't be passed in a memfd.
+ */
+SR_PRIV GSList *rl_packet_encode(const struct sr_datafeed_packet *packet)
+{
+	const struct sr_datafeed_header *header;
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_analog_planar *planar;
+	const struct sr_analog_plane *plane;
+	const struct sr_analog_encoding *enc;
+	const struct sr_datafeed_gap *gap;
+	const struct sr_config *src;
+	struct rl_msg *msg;
+	GSList *msgs, *l;
+	gsize unitsize, total, done, now;
+	uint8_t *buf;
+	uint32_t i;
+
+	msgs = NULL;
+
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		header = packet->payload;
+		msg = rl_msg_new(RL_MSG_PACKET);
+		rl_put_u32(msg, packet->type);
+		rl_put_u32(msg, header->feed_version);
+		rl_put_u64(msg, header->starttime.tv_sec);
+		rl_put_u64(msg, header->starttime.tv_usec);
+		msgs = g_slist_append(msgs, msg);
+		break;
+	case SR_DF_META:
+		meta = packet->payload;
+		msg = rl_msg_new(RL_MSG_PACKET);
+		rl_put_u32(msg, packet->type);
+		rl_put_u32(msg, g_slist_length(meta->config));
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			rl_put_u32(msg, src->key);
+			rl_put_variant(msg, src->data);
+		}
+		msgs = g_slist_append(msgs, msg);
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		unitsize = MAX(logic->unitsize, 1);
+		total = logic->length / unitsize;
+		for (done = 0; done < total; done += now) {
+			now = MIN(total - done, chunk_units(unitsize));
+			msg = rl_msg_new(RL_MSG_PACKET);
+			rl_put_u32(msg, packet->type);
+			rl_put_u32(msg, logic->unitsize);
+			rl_put_u64(msg, now * unitsize);
+			put_payload(msg, (const uint8_t *)logic->data
+					+ done * unitsize, now * unitsize);
+			msgs = g_slist_append(msgs, msg);
+		}
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		enc = analog->encoding;
+		unitsize = enc->unitsize
+			* MAX(g_slist_length(analog->meaning->channels), 1);
+		total = analog->num_samples;
+		for (done = 0; done < total; done += now) {
+			now = MIN(total - done, chunk_units(unitsize));
+			msg = rl_msg_new(RL_MSG_PACKET);
+			rl_put_u32(msg, packet->type);
+			put_encoding(msg, enc);
+			put_meaning(msg, analog->meaning);
+			put_channels(msg, analog->meaning->channels);
+			rl_put_u8(msg, analog->spec->spec_digits);
+			rl_put_u32(msg, now);
+			put_payload(msg, (const uint8_t *)analog->data
+					+ done * unitsize, now * unitsize);
+			msgs = g_slist_append(msgs, msg);
+		}
+		break;
+	case SR_DF_ANALOG_PLANAR:
+		/* The planes go back to back in one payload, packed. */
+		planar = packet->payload;
+		unitsize = 0;
+		for (i = 0; i < planar->num_planes; i++)
+			unitsize += planar->planes[i].encoding->unitsize;
+		total = planar->num_samples;
+		for (done = 0; done < total; done += now) {
+			now = MIN(total - done, chunk_units(unitsize));
+			msg = rl_msg_new(RL_MSG_PACKET);
+			rl_put_u32(msg, packet->type);
+			rl_put_u64(msg, planar->frame);
+			rl_put_u64(msg, planar->sample + done);
+			rl_put_u32(msg, planar->num_planes);
+			for (i = 0; i < planar->num_planes; i++) {
+				plane = &planar->planes[i];
+				put_encoding(msg, plane->encoding);
+				put_meaning(msg, plane->meaning);
+				rl_put_u32(msg, plane->channel->index);
+				rl_put_u8(msg, plane->spec->spec_digits);
+			}
+			rl_put_u32(msg, now);
+			buf = pack_planes(planar, done, now, unitsize);
+			put_payload(msg, buf, now * unitsize);
+			g_free(buf);
+			msgs = g_slist_append(msgs, msg);
+		}
+		break;
+	case SR_DF_GAP:
+		gap = packet->payload;
+		msg = rl_msg_new(RL_MSG_PACKET);
+		rl_put_u32(msg, packet->type);
+		rl_put_u64(msg, gap->start);
+		rl_put_u64(msg, gap->length);
+		msgs = g_slist_append(msgs, msg);
+		break;
+	case SR_DF_TRIGGER:
+	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
+		msg = rl_msg_new(RL_MSG_PACKET);
+		rl_put_u32(msg, packet->type);
+		msgs = g_slist_append(msgs, msg);
+		break;
+	default:
+		sr_dbg("Not forwarding packet of type %d.", packet->type);
+		break;
+	}
+
+	return msgs;
+}
+
+/**
+ * Send a request and wait for the reply.
+ *
+ * @param sock The control connection.
+ * @param req The request. It is freed.
+ * @param data If not NULL, set to the value in the reply, if any.
+ *
+ * @return The status in the reply, or SR_ERR_IO on connection problems.
+ */
+SR_PRIV int rl_request(int sock, struct rl_msg *req, GVariant **data)
+{
+	struct rl_msg *reply;
+	int ret;
+
+	if (data)
+		*data = NULL;
+
+	ret = rl_msg_send(sock, req);
+	rl_msg_free(req);
+	if (ret != SR_OK)
+		return ret;
+
+	if ((ret = rl_msg_recv(sock, RL_REPLY_TIMEOUT_MS, &reply)) != SR_OK)
+		return ret;
+	if (!reply) {
+		sr_err("Timeout waiting for server reply.");
+		return SR_ERR_TIMEOUT;
+	}
+	if (reply->type != RL_MSG_REPLY) {
+		sr_err("Unexpected message of type %u.", reply->type);
+		rl_msg_free(reply);
+		return SR_ERR_IO;
+	}
+
+	ret = (int32_t)rl_get_u32(reply);
+	if (rl_get_u8(reply) && data)
+		*data = rl_get_variant(reply);
+	if (reply->truncated) {
+		sr_err("Truncated reply from server.");
+		ret = SR_ERR_IO;
+		if (data && *data) {
+			g_variant_unref(*data);
+			*data = NULL;
+		}
+	}
+	rl_msg_free(reply);
+
+	return ret;
+}
+
+SR_PRIV struct sr_channel *rl_channel_by_index(const struct sr_dev_inst *sdi,
+		int index)
+{
+	struct sr_channel *ch;
+	GSList *l;
+
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->index == index)
+			return ch;
+	}
+
+	return NULL;
+}
+
+static void get_encoding(struct rl_msg *msg, struct sr_analog_encoding *enc)
+{
+	enc->unitsize = rl_get_u8(msg);
+	enc->is_signed = rl_get_u8(msg);
+	enc->is_float = rl_get_u8(msg);
+	enc->is_bigendian = rl_get_u8(msg);
+	enc->digits = (int8_t)rl_get_u8(msg);
+	enc->is_digits_decimal = rl_get_u8(msg);
+	enc->scale.p = rl_get_u64(msg);
+	enc->scale.q = rl_get_u64(msg);
+	enc->offset.p = rl_get_u64(msg);
+	enc->offset.q = rl_get_u64(msg);
+}
+
+static void get_meaning(struct rl_msg *msg, struct sr_analog_meaning *meaning)
+{
+	meaning->mq = rl_get_u32(msg);
+	meaning->unit = rl_get_u32(msg);
+	meaning->mqflags = rl_get_u64(msg);
+	meaning->channels = NULL;
+}
+
+/*
+ * Get the plane descriptions of a planar packet. The arrays are freed
+ * by the caller, also on failure.
+ */
+static int get_planes(struct rl_msg *msg, const struct sr_dev_inst *sdi,
+		struct sr_datafeed_analog_planar *planar,
+		struct sr_analog_encoding **encodings,
+		struct sr_analog_meaning **meanings,
+		struct sr_analog_spec **specs, gsize *unitsize)
+{
+	struct sr_analog_plane *plane;
+	uint32_t i;
+
+	planar->frame = rl_get_u64(msg);
+	planar->sample = rl_get_u64(msg);
+	planar->num_planes = rl_get_u32(msg);
+	if (planar->num_planes > g_slist_length(sdi->channels))
+		return SR_ERR_DATA;
+
+	planar->planes = g_malloc0(planar->num_planes * sizeof(*plane));
+	*encodings = g_malloc0(planar->num_planes * sizeof(**encodings));
+	*meanings = g_malloc0(planar->num_planes * sizeof(**meanings));
+	*specs = g_malloc0(planar->num_planes * sizeof(**specs));
+	*unitsize = 0;
+	for (i = 0; i < planar->num_planes && !msg->truncated; i++) {
+		plane = &planar->planes[i];
+		get_encoding(msg, &(*encodings)[i]);
+		get_meaning(msg, &(*meanings)[i]);
+		plane->channel = rl_channel_by_index(sdi, rl_get_u32(msg));
+		(*specs)[i].spec_digits = (int8_t)rl_get_u8(msg);
+		if (!plane->channel || (*encodings)[i].unitsize == 0)
+			return SR_ERR_DATA;
+		plane->encoding = &(*encodings)[i];
+		plane->meaning = &(*meanings)[i];
+		plane->spec = &(*specs)[i];
+		*unitsize += (*encodings)[i].unitsize;
+	}
+	planar->num_samples = rl_get_u32(msg);
+
+	return SR_OK;
+}
+
+/* Point the planes into the payload they were packed into. */
+static void set_planes(struct sr_datafeed_analog_planar *planar,
+		const uint8_t *data)
+{
+	uint32_t i;
+
+	for (i = 0; i < planar->num_planes; i++) {
+		planar->planes[i].data = (void *)data;
+		planar->planes[i].stride = 0;
+		data += (gsize)planar->num_samples
+			* planar->planes[i].encoding->unitsize;
+	}
+}
+
+static GSList *get_channels(struct rl_msg *msg, const struct sr_dev_inst *sdi)
+{
+	struct sr_channel *ch;
+	GSList *channels;
+	uint32_t num, i;
+
+	channels = NULL;
+	num = rl_get_u32(msg);
+	for (i = 0; i < num && !msg->truncated; i++) {
+		if ((ch = rl_channel_by_index(sdi, rl_get_u32(msg))))
+			channels = g_slist_append(channels, ch);
+	}
+
+	return channels;
+}
+
+/* Decode a packet and send it on into our session. */
+static int packet_receive(const struct sr_dev_inst *sdi, struct rl_msg *msg,
+		uint16_t *type)
+{
+	struct dev_context *devc;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_header header;
+	struct sr_datafeed_meta meta;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	struct sr_datafeed_analog_planar planar;
+	struct sr_analog_encoding encoding, *plane_encodings;
+	struct sr_analog_meaning meaning, *plane_meanings;
+	struct sr_analog_spec spec, *plane_specs;
+	struct sr_datafeed_gap gap;
+	struct sr_config *src;
+	GVariant *data;
+	const void *payload;
+	uint32_t num, i, key;
+	gsize len, unitsize;
+	void *map;
+	int ret;
+
+	devc = sdi->priv;
+	memset(&meaning, 0, sizeof(meaning));
+	planar.planes = NULL;
+	plane_encodings = NULL;
+	plane_meanings = NULL;
+	plane_specs = NULL;
+	map = NULL;
+	len = 0;
+	ret = SR_OK;
+
+	packet.type = *type = rl_get_u32(msg);
+	packet.payload = NULL;
+
+	switch (packet.type) {
+	case SR_DF_HEADER:
+		header.feed_version = rl_get_u32(msg);
+		header.starttime.tv_sec = rl_get_u64(msg);
+		header.starttime.tv_usec = rl_get_u64(msg);
+		packet.payload = &header;
+		break;
+	case SR_DF_META:
+		meta.config = NULL;
+		num = rl_get_u32(msg);
+		for (i = 0; i < num; i++) {
+			key = rl_get_u32(msg);
+			if (!(data = rl_get_variant(msg)))
+				break;
+			src = sr_config_new(key, data);
+			meta.config = g_slist_append(meta.config, src);
+		}
+		packet.payload = &meta;
+		break;
+	case SR_DF_LOGIC:
+		logic.unitsize = rl_get_u32(msg);
+		logic.length = len = rl_get_u64(msg);
+		logic.data = (void *)get_payload(msg, len, &map);
+		packet.payload = &logic;
+		break;
+	case SR_DF_ANALOG:
+		get_encoding(msg, &encoding);
+		get_meaning(msg, &meaning);
+		meaning.channels = get_channels(msg, sdi);
+		spec.spec_digits = (int8_t)rl_get_u8(msg);
+		analog.num_samples = rl_get_u32(msg);
+		len = (gsize)analog.num_samples * encoding.unitsize
+			* g_slist_length(meaning.channels);
+		analog.data = (void *)get_payload(msg, len, &map);
+		analog.encoding = &encoding;
+		analog.meaning = &meaning;
+		analog.spec = &spec;
+		packet.payload = &analog;
+		break;
+	case SR_DF_ANALOG_PLANAR:
+		if (get_planes(msg, sdi, &planar, &plane_encodings,
+				&plane_meanings, &plane_specs, &unitsize) != SR_OK) {
+			sr_err("Received a planar packet with invalid planes.");
+			msg->truncated = TRUE;
+			break;
+		}
+		len = (gsize)planar.num_samples * unitsize;
+		payload = get_payload(msg, len, &map);
+		set_planes(&planar, payload);
+		packet.payload = &planar;
+		break;
+	case SR_DF_GAP:
+		gap.start = rl_get_u64(msg);
+		gap.length = rl_get_u64(msg);
+		packet.payload = &gap;
+		break;
+	case SR_DF_TRIGGER:
+	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
+		break;
+	default:
+		sr_dbg("Ignoring packet of unknown type %d.", packet.type);
+		return SR_OK;
+	}
+
+	if (msg->truncated) {
+		sr_err("Received a truncated packet of type %d.", packet.type);
+		ret = SR_ERR_IO;
+	} else {
+		sr_session_send(devc->cb_data, &packet);
+	}
+
+	put_payload_done(map, len);
+	if (packet.type == SR_DF_META)
+		g_slist_free_full(meta.config, (GDestroyNotify)sr_config_free);
+	g_slist_free(meaning.channels);
+	g_free(planar.planes);
+	g_free(plane_encodings);
+	g_free(plane_meanings);
+	g_free(plane_specs);
+
+	return ret;
+}
+
+static void acquisition_end(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+
+	sr_session_source_remove(sdi->session, devc->data_fd);
+	close(devc->data_fd);
+	devc->data_fd = -1;
+}
+
+/** Session source callback for the datafeed connection. */
+SR_PRIV int rl_receive_data(int fd, int revents, void *cb_data)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packet;
+	struct rl_msg *msg;
+	uint16_t type;
+	int i, ret;
+
+	(void)revents;
+
+	sdi = cb_data;
+
+	for (i = 0; i < RL_MAX_MSGS_PER_POLL; i++) {
+		if ((ret = rl_msg_recv(fd, 0, &msg)) != SR_OK)
+			break;
+		if (!msg)
+			return TRUE;
+		if (msg->type != RL_MSG_PACKET) {
+			sr_dbg("Ignoring message of type %u.", msg->type);
+			rl_msg_free(msg);
+			continue;
+		}
+		ret = packet_receive(sdi, msg, &type);
+		rl_msg_free(msg);
+		if (ret != SR_OK)
+			break;
+		if (type == SR_DF_END) {
+			acquisition_end(sdi);
+			return TRUE;
+		}
+	}
+	if (i < RL_MAX_MSGS_PER_POLL) {
+		/* The server went away without ending the feed. */
+		sr_err("Lost connection to the server.");
+		acquisition_end(sdi);
+		packet.type = SR_DF_END;
+		sr_session_send(((struct dev_context *)sdi->priv)->cb_data,
+				&packet);
+	}
+
+	return TRUE;
+}
@@ -0,0 +1,140 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBSIGROK_HARDWARE_REMOTE_LOCAL_PROTOCOL_H
+#define LIBSIGROK_HARDWARE_REMOTE_LOCAL_PROTOCOL_H
+
+#include <stdint.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "remote-local"
+
+/*
+ * The client driver and sr_local_server talk over an AF_UNIX
+ * SOCK_SEQPACKET socket, so every message arrives whole and no extra
+ * framing is needed. A message is a 32-bit type followed by the body;
+ * all fields are in host byte order, since both ends are on the same
+ * machine. Strings are a 32-bit length (0xffffffff for NULL) followed
+ * by the bytes, and GVariants are their type string followed by their
+ * serialized data.
+ *
+ * Sample payloads of RL_FD_THRESHOLD bytes or more are written into a
+ * sealed memfd, which is passed along with the message (SCM_RIGHTS) to
+ * all subscribed clients. The clients map it and hand the mapping to
+ * their session, so the data isn't copied through the socket at all.
+ */
+#define RL_PROTOCOL_VERSION 1
+
+/* Largest message on the wire, including the type. */
+#define RL_MAX_MSG_SIZE (64 * 1024)
+
+/* Largest payload sent inline, leaving room for the packet fields. */
+#define RL_INLINE_MAX (RL_MAX_MSG_SIZE - 1024)
+
+/* Payloads of this size and up go into a memfd, if we have them. */
+#define RL_FD_THRESHOLD 4096
+
+/* Maximum time to wait for the server to reply to a request. */
+#define RL_REPLY_TIMEOUT_MS 5000
+
+/* Maximum number of messages to handle per call of the receive callback. */
+#define RL_MAX_MSGS_PER_POLL 64
+
+enum rl_msg_type {
+	/* Client: u32 version. Server replies with a status. */
+	RL_MSG_HELLO = 1,
+	/* Client: nothing. Server replies with the list of devices. */
+	RL_MSG_DEV_LIST,
+	/* Client: u32 device, u32 key, str channel group. */
+	RL_MSG_CONFIG_GET,
+	/* Client: u32 device, u32 key, str channel group, variant. */
+	RL_MSG_CONFIG_SET,
+	/* Client: u32 device, u32 key, str channel group. */
+	RL_MSG_CONFIG_LIST,
+	/*
+	 * Client: u32 device, u32 number of channels, u8 enabled for each.
+	 * Subscribes this connection to the device's datafeed. The channel
+	 * states are applied only if the acquisition isn't running yet.
+	 * The server replies with a status, then sends datafeed packets.
+	 */
+	RL_MSG_START,
+	/* Client: nothing. The server ends the feed with an SR_DF_END. */
+	RL_MSG_STOP,
+	/* Server: i32 status, u8 has variant, [variant]. */
+	RL_MSG_REPLY,
+	/* Server: u32 packet type, payload (see rl_packet_encode()). */
+	RL_MSG_PACKET,
+};
+
+/** A message being built up, or taken apart. */
+struct rl_msg {
+	uint32_t type;
+	/* Message body, without the type. */
+	GByteArray *body;
+	/* Read position in the body, for decoding. */
+	gsize pos;
+	/* Set if decoding ran past the end of the body. */
+	gboolean truncated;
+	/* File descriptor passed along with the message, or -1. */
+	int fd;
+};
+
+/* A device as seen by the client. */
+struct dev_context {
+	/* Path of the server's socket. */
+	char *path;
+	/* Index of the device on the server. */
+	uint32_t index;
+	/* Control connection, while the device is open. */
+	int ctrl_fd;
+	/* Datafeed connection, while acquiring. */
+	int data_fd;
+	void *cb_data;
+};
+
+SR_PRIV struct rl_msg *rl_msg_new(uint32_t type);
+SR_PRIV void rl_msg_free(struct rl_msg *msg);
+
+SR_PRIV void rl_put_u8(struct rl_msg *msg, uint8_t value);
+SR_PRIV void rl_put_u32(struct rl_msg *msg, uint32_t value);
+SR_PRIV void rl_put_u64(struct rl_msg *msg, uint64_t value);
+SR_PRIV void rl_put_str(struct rl_msg *msg, const char *str);
+SR_PRIV void rl_put_variant(struct rl_msg *msg, GVariant *data);
+SR_PRIV void rl_put_bytes(struct rl_msg *msg, const void *data, gsize len);
+
+SR_PRIV uint8_t rl_get_u8(struct rl_msg *msg);
+SR_PRIV uint32_t rl_get_u32(struct rl_msg *msg);
+SR_PRIV uint64_t rl_get_u64(struct rl_msg *msg);
+SR_PRIV char *rl_get_str(struct rl_msg *msg);
+SR_PRIV GVariant *rl_get_variant(struct rl_msg *msg);
+SR_PRIV const void *rl_get_bytes(struct rl_msg *msg, gsize len);
+
+SR_PRIV int rl_socket_connect(const char *path);
+SR_PRIV int rl_socket_listen(const char *path);
+SR_PRIV int rl_msg_send(int sock, const struct rl_msg *msg);
+SR_PRIV int rl_msg_recv(int sock, int timeout_ms, struct rl_msg **msg);
+
+SR_PRIV GSList *rl_packet_encode(const struct sr_datafeed_packet *packet);
+
+SR_PRIV struct sr_channel *rl_channel_by_index(const struct sr_dev_inst *sdi,
+		int index);
+SR_PRIV int rl_request(int sock, struct rl_msg *req, GVariant **data);
+SR_PRIV int rl_receive_data(int fd, int revents, void *cb_data);
+
+#endif
@@ -189,7 +189,7 @@ static const struct rigol_ds_vendor supported_vendors[] = {
 
 #define VENDOR(x) &supported_vendors[x]
 /* vendor, series, protocol, max timebase, min vdiv, number of horizontal divs,
- * live waveform samples, memory buffer samples */
+ * live waveform samples, memory buffer samples, max samples per block */
 static const struct rigol_ds_series supported_series[] = {
 	[VS5000] = {VENDOR(RIGOL), "VS5000", PROTOCOL_V1, FORMAT_RAW,
 		{50, 1}, {2, 1000}, 14, 2048, 0},
@@ -202,7 +202,7 @@ static const struct rigol_ds_series supported_series[] = {
 	[DSO1000] = {VENDOR(AGILENT), "DSO1000", PROTOCOL_V3, FORMAT_IEEE488_2,
 		{50, 1}, {2, 1000}, 12, 600, 20480},
 	[DS1000Z] = {VENDOR(RIGOL), "DS1000Z", PROTOCOL_V4, FORMAT_IEEE488_2,
-		{50, 1}, {1, 1000}, 12, 1200, 12000000},
+		{50, 1}, {1, 1000}, 12, 1200, 12000000, 250000},
 };
 
 #define SERIES(x) &supported_series[x]
@@ -257,7 +257,6 @@ static void clear_helper(void *priv)
 	unsigned int i;
 
 	devc = priv;
-	g_free(devc->data);
 	g_free(devc->buffer);
 	for (i = 0; i < ARRAY_SIZE(devc->coupling); i++)
 		g_free(devc->coupling[i]);
@@ -397,7 +396,6 @@ static struct sr_dev_inst *probe_device(struct sr_scpi_dev_inst *scpi)
 	}
 
 	devc->buffer = g_malloc(ACQ_BUFFER_SIZE);
-	devc->data = g_malloc(ACQ_BUFFER_SIZE * sizeof(float));
 
 	devc->data_source = DATA_SOURCE_LIVE;
 
@@ -800,6 +798,169 @@ static int config_set(uint32_t key, GVariant *data, const struct sr_dev_inst *sd
 	return ret;
 }
 
+/* The trigger position is converted to seconds using the timebase. */
+static const uint32_t batch_order[] = {
+	SR_CONF_DATA_SOURCE,
+	SR_CONF_LIMIT_FRAMES,
+	SR_CONF_TIMEBASE,
+	SR_CONF_HORIZ_TRIGGERPOS,
+	SR_CONF_VDIV,
+	SR_CONF_COUPLING,
+	SR_CONF_TRIGGER_SOURCE,
+	SR_CONF_TRIGGER_SLOPE,
+};
+
+/* Check a batch entry against the model's tables, without sending it. */
+static int config_check(const struct sr_dev_inst *sdi,
+		const struct sr_config_batch_entry *entry)
+{
+	struct dev_context *devc;
+	uint64_t p, q;
+	double t_dbl;
+	unsigned int i, j;
+	const char *tmp_str;
+
+	devc = sdi->priv;
+
+	if (entry->cg && !g_slist_find(sdi->channel_groups, entry->cg)) {
+		sr_err("Invalid channel group specified.");
+		return SR_ERR;
+	}
+
+	switch (entry->key) {
+	case SR_CONF_TRIGGER_SLOPE:
+		tmp_str = g_variant_get_string(entry->data, NULL);
+		if (tmp_str[0] != 'f' && tmp_str[0] != 'r') {
+			sr_err("Unknown trigger slope: '%s'.", tmp_str);
+			return SR_ERR_ARG;
+		}
+		break;
+	case SR_CONF_HORIZ_TRIGGERPOS:
+		t_dbl = g_variant_get_double(entry->data);
+		if (t_dbl < 0.0 || t_dbl > 1.0) {
+			sr_err("Invalid horiz. trigger position: %g.", t_dbl);
+			return SR_ERR_ARG;
+		}
+		break;
+	case SR_CONF_TIMEBASE:
+		g_variant_get(entry->data, "(tt)", &p, &q);
+		for (i = 0; i < devc->num_timebases; i++) {
+			if (devc->timebases[i][0] == p && devc->timebases[i][1] == q)
+				break;
+		}
+		if (i == devc->num_timebases) {
+			sr_err("Invalid timebase: %" PRIu64 "/%" PRIu64 ".", p, q);
+			return SR_ERR_ARG;
+		}
+		break;
+	case SR_CONF_TRIGGER_SOURCE:
+		tmp_str = g_variant_get_string(entry->data, NULL);
+		for (i = 0; i < ARRAY_SIZE(trigger_sources); i++) {
+			if (!strcmp(trigger_sources[i], tmp_str))
+				break;
+		}
+		if (i == ARRAY_SIZE(trigger_sources)) {
+			sr_err("Invalid trigger source: '%s'.", tmp_str);
+			return SR_ERR_ARG;
+		}
+		break;
+	case SR_CONF_VDIV:
+	case SR_CONF_COUPLING:
+		if (!entry->cg) {
+			sr_err("No channel group specified.");
+			return SR_ERR_CHANNEL_GROUP;
+		}
+		for (i = 0; i < devc->model->analog_channels; i++) {
+			if (entry->cg == devc->analog_groups[i])
+				break;
+		}
+		if (i == devc->model->analog_channels) {
+			sr_err("Not an analog channel group.");
+			return SR_ERR_ARG;
+		}
+		if (entry->key == SR_CONF_VDIV) {
+			g_variant_get(entry->data, "(tt)", &p, &q);
+			for (j = 0; j < ARRAY_SIZE(vdivs); j++) {
+				if (vdivs[j][0] == p && vdivs[j][1] == q)
+					break;
+			}
+			if (j == ARRAY_SIZE(vdivs)) {
+				sr_err("Invalid vdiv: %" PRIu64 "/%" PRIu64 ".",
+					p, q);
+				return SR_ERR_ARG;
+			}
+		} else {
+			tmp_str = g_variant_get_string(entry->data, NULL);
+			for (j = 0; j < ARRAY_SIZE(coupling); j++) {
+				if (!strcmp(tmp_str, coupling[j]))
+					break;
+			}
+			if (j == ARRAY_SIZE(coupling)) {
+				sr_err("Invalid coupling: '%s'.", tmp_str);
+				return SR_ERR_ARG;
+			}
+		}
+		break;
+	case SR_CONF_DATA_SOURCE:
+		tmp_str = g_variant_get_string(entry->data, NULL);
+		if (strcmp(tmp_str, "Live")
+			&& (devc->model->series->protocol < PROTOCOL_V2
+				|| strcmp(tmp_str, "Memory"))
+			&& (devc->model->series->protocol < PROTOCOL_V3
+				|| strcmp(tmp_str, "Segmented"))) {
+			sr_err("Unknown data source: '%s'.", tmp_str);
+			return SR_ERR_ARG;
+		}
+		break;
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Send all commands of a batch in a row and wait for the scope once at
+ * the end. The DS1000 series still gets its delay after every command.
+ */
+static int config_set_batch(const struct sr_dev_inst *sdi, GSList *entries)
+{
+	struct dev_context *devc;
+	const struct sr_config_batch_entry *entry;
+	GSList *sorted, *l;
+	int ret;
+
+	if (!(devc = sdi->priv))
+		return SR_ERR_ARG;
+
+	if (sdi->status != SR_ST_ACTIVE)
+		return SR_ERR_DEV_CLOSED;
+
+	/* Reject the whole batch before anything is sent. */
+	for (l = entries; l; l = l->next) {
+		if ((ret = config_check(sdi, l->data)) != SR_OK)
+			return ret;
+	}
+
+	sorted = std_config_batch_sort(entries, batch_order,
+			ARRAY_SIZE(batch_order));
+	devc->config_batch = TRUE;
+	devc->config_pending = FALSE;
+	ret = SR_OK;
+	for (l = sorted; l && ret == SR_OK; l = l->next) {
+		entry = l->data;
+		ret = config_set(entry->key, entry->data, sdi, entry->cg);
+	}
+	devc->config_batch = FALSE;
+	g_slist_free(sorted);
+
+	if (devc->config_pending) {
+		devc->config_pending = FALSE;
+		if (ret == SR_OK)
+			ret = sr_scpi_get_opc(sdi->conn);
+	}
+
+	return ret;
+}
+
 static int config_list(uint32_t key, GVariant **data, const struct sr_dev_inst *sdi,
 		const struct sr_channel_group *cg)
 {
@@ -1070,6 +1231,20 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi, void *cb_data)
 	scpi = sdi->conn;
 	sr_scpi_source_remove(sdi->session, scpi);
 
+	/*
+	 * Stopped in the middle of a data block: the rest of it would be
+	 * taken as the response to the next query. Where the transport
+	 * can, have the scope drop it.
+	 */
+	if (devc->block_requested || devc->num_header_bytes ||
+			devc->num_block_bytes) {
+		if (sr_scpi_device_clear(scpi) == SR_ERR)
+			sr_warn("Failed to clear the scope's output.");
+		devc->block_requested = FALSE;
+		devc->num_header_bytes = 0;
+		devc->num_block_bytes = 0;
+	}
+
 	return SR_OK;
 }
 
@@ -1084,6 +1259,7 @@ SR_PRIV struct sr_dev_driver rigol_ds_driver_info = {
 	.dev_clear = dev_clear,
 	.config_get = config_get,
 	.config_set = config_set,
+	.config_set_batch = config_set_batch,
 	.config_list = config_list,
 	.dev_open = dev_open,
 	.dev_close = dev_close,
@@ -252,49 +252,104 @@ static int rigol_ds_check_stop(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
-/* Wait for enough data becoming available in scope output buffer */
+/*
+ * Wait before (re-)requesting the next data block.
+ *
+ * The IEEE 488.2 block header tells how much data the scope has copied
+ * to its output buffer, so there is no need to poll :WAV:STAT? with long
+ * sleeps here. When the scope has no data ready yet,
+ * rigol_ds_read_header() sets a deadline instead, and this keeps
+ * returning SR_ERR_TIMEOUT until it has passed. That way the event loop
+ * keeps running meanwhile.
+ */
 static int rigol_ds_block_wait(const struct sr_dev_inst *sdi)
 {
-	char *buf;
 	struct dev_context *devc;
-	time_t start;
-	int len;
 
 	if (!(devc = sdi->priv))
 		return SR_ERR;
 
-	if (devc->model->series->protocol == PROTOCOL_V3) {
+	if (g_get_monotonic_time() < devc->block_deadline)
+		return SR_ERR_TIMEOUT;
 
-		start = time(NULL);
+	rigol_ds_set_wait_event(devc, WAIT_NONE);
 
-		do {
-			if (time(NULL) - start >= 3) {
-				sr_dbg("Timeout waiting for data block");
-				return SR_ERR_TIMEOUT;
-			}
+	return SR_OK;
+}
 
-			/*
-			 * The scope copies data really slowly from sample
-			 * memory to its output buffer, so try not to bother
-			 * it too much with SCPI requests but don't wait too
-			 * long for short sample frame sizes.
-			 */
-			g_usleep(devc->analog_frame_size < (15 * 1000) ? (100 * 1000) : (1000 * 1000));
+/* Pick the number of samples to fetch per data block request. */
+static void rigol_ds_set_block_size(const struct sr_dev_inst *sdi)
+{
+	struct sr_scpi_dev_inst *scpi;
+	struct dev_context *devc;
+	uint64_t size;
 
-			/* "READ,nnnn" (still working) or "IDLE,nnnn" (finished) */
-			if (sr_scpi_get_string(sdi->conn, ":WAV:STAT?", &buf) != SR_OK)
-				return SR_ERR;
+	scpi = sdi->conn;
+	devc = sdi->priv;
 
-			if (parse_int(buf + 5, &len) != SR_OK)
-				return SR_ERR;
-		} while (buf[0] == 'R' && len < (1000 * 1000));
+	size = devc->model->series->max_block_samples;
+	if (size == 0)
+		size = MAX(devc->analog_frame_size, devc->digital_frame_size);
+
+	/*
+	 * Over a serial port a large block takes many seconds, which would
+	 * make stopping the acquisition unresponsive.
+	 */
+	if (!strcmp(scpi->prefix, ""))
+		size = MIN(size, ACQ_BLOCK_SIZE);
+
+	devc->block_size = MAX(size, 1);
+	sr_dbg("Using block size of %" PRIu64 " samples.", devc->block_size);
+}
+
+/*
+ * Request the next data block of the current channel, starting at sample
+ * offset 'start'.
+ */
+static int rigol_ds_block_request(const struct sr_dev_inst *sdi,
+		uint64_t start, uint64_t expected)
+{
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+
+	if (devc->model->series->protocol >= PROTOCOL_V4) {
+		if (sr_scpi_send(sdi->conn, ":WAV:START %" PRIu64,
+				start + 1) != SR_OK)
+			return SR_ERR;
+		if (sr_scpi_send(sdi->conn, ":WAV:STOP %" PRIu64,
+				MIN(start + devc->block_size, expected)) != SR_OK)
+			return SR_ERR;
 	}
 
-	rigol_ds_set_wait_event(devc, WAIT_NONE);
+	if (devc->model->series->protocol >= PROTOCOL_V3)
+		if (sr_scpi_send(sdi->conn, ":WAV:DATA?") != SR_OK)
+			return SR_ERR;
+
+	devc->block_requested = TRUE;
 
 	return SR_OK;
 }
 
+/*
+ * Request the data block following the one at 'start' of 'len' bytes,
+ * if the channel has more to read and the scope takes windows.
+ */
+static int rigol_ds_block_next(const struct sr_dev_inst *sdi,
+		uint64_t start, uint64_t len, uint64_t expected)
+{
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+
+	if (devc->format != FORMAT_IEEE488_2 ||
+			devc->model->series->protocol < PROTOCOL_V4 ||
+			start + len >= expected)
+		return SR_OK;
+
+	return rigol_ds_block_request(sdi, start + len, expected);
+}
+
 /* Send a configuration setting. */
 SR_PRIV int rigol_ds_config_set(const struct sr_dev_inst *sdi, const char *format, ...)
 {
@@ -314,6 +369,10 @@ SR_PRIV int rigol_ds_config_set(const struct sr_dev_inst *sdi, const char *forma
 		sr_spew("delay %dms", 100);
 		g_usleep(100 * 1000);
 		return SR_OK;
+	} else if (devc->config_batch) {
+		/* A single *OPC? follows the last setting of the batch. */
+		devc->config_pending = TRUE;
+		return SR_OK;
 	} else {
 		return sr_scpi_get_opc(sdi->conn);
 	}
@@ -467,11 +526,16 @@ SR_PRIV int rigol_ds_channel_start(const struct sr_dev_inst *sdi)
 			return SR_ERR;
 	}
 
-	rigol_ds_set_wait_event(devc, WAIT_BLOCK);
+	rigol_ds_set_wait_event(devc, WAIT_NONE);
+
+	rigol_ds_set_block_size(sdi);
 
 	devc->num_channel_bytes = 0;
 	devc->num_header_bytes = 0;
 	devc->num_block_bytes = 0;
+	devc->block_requested = FALSE;
+	devc->block_backoff = MIN_BLOCK_BACKOFF_US;
+	devc->block_deadline = 0;
 
 	return SR_OK;
 }
@@ -530,21 +594,49 @@ static int rigol_ds_read_header(struct sr_dev_inst *sdi)
 
 	sr_dbg("Received data block header: '%s' -> block length %d", buf, ret);
 
+	if (ret == 0) {
+		/*
+		 * The scope has not copied any data to its output buffer
+		 * yet. Finish this response and request the block again
+		 * after a while, backing off exponentially.
+		 */
+		sr_scpi_read_data(scpi, buf, 1);
+		sr_scpi_read_complete(scpi);
+		devc->num_header_bytes = 0;
+		devc->block_requested = FALSE;
+		devc->block_deadline = g_get_monotonic_time() + devc->block_backoff;
+		devc->block_backoff = MIN(devc->block_backoff * 2,
+				MAX_BLOCK_BACKOFF_US);
+		rigol_ds_set_wait_event(devc, WAIT_BLOCK);
+		return 0;
+	}
+	devc->block_backoff = MIN_BLOCK_BACKOFF_US;
+
 	return ret;
 }
 
+/* Converts a value to a rational number with nine decimal places. */
+static void rigol_ds_rational_from_double(struct sr_rational *r, double value)
+{
+	sr_rational_set(r, (int64_t)llround(value * 1e9), 1000000000);
+}
+
 SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 {
 	struct sr_dev_inst *sdi;
 	struct sr_scpi_dev_inst *scpi;
 	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog_old analog;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 	struct sr_datafeed_logic logic;
 	double vdiv, offset;
-	int len, i, vref;
+	int len, vref;
 	struct sr_channel *ch;
 	gsize expected_data_bytes;
+	char lf;
 
 	(void)fd;
 
@@ -569,6 +661,7 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 			return TRUE;
 		return TRUE;
 	case WAIT_BLOCK:
+		/* Still backing off, try again on the next call. */
 		if (rigol_ds_block_wait(sdi) != SR_OK)
 			return TRUE;
 		break;
@@ -591,28 +684,23 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 			devc->analog_frame_size : devc->digital_frame_size;
 
 	if (devc->num_block_bytes == 0) {
-		if (devc->model->series->protocol >= PROTOCOL_V4) {
-			if (sr_scpi_send(sdi->conn, ":WAV:START %d",
-					devc->num_channel_bytes + 1) != SR_OK)
+		/*
+		 * The request may already have been sent while the previous
+		 * block was being finished, or before a partial header read.
+		 */
+		if (!devc->block_requested) {
+			if (rigol_ds_block_request(sdi, devc->num_channel_bytes,
+					expected_data_bytes) != SR_OK)
 				return TRUE;
-			if (sr_scpi_send(sdi->conn, ":WAV:STOP %d",
-					MIN(devc->num_channel_bytes + ACQ_BLOCK_SIZE,
-						devc->analog_frame_size)) != SR_OK)
+			if (sr_scpi_read_begin(scpi) != SR_OK)
 				return TRUE;
 		}
 
-		if (devc->model->series->protocol >= PROTOCOL_V3)
-			if (sr_scpi_send(sdi->conn, ":WAV:DATA?") != SR_OK)
-				return TRUE;
-
-		if (sr_scpi_read_begin(scpi) != SR_OK)
-			return TRUE;
-
 		if (devc->format == FORMAT_IEEE488_2) {
 			sr_dbg("New block header expected");
 			len = rigol_ds_read_header(sdi);
 			if (len == 0)
-				/* Still reading the header. */
+				/* Still reading the header, or no data yet. */
 				return TRUE;
 			if (len == -1) {
 				sr_err("Read error, aborting capture.");
@@ -621,6 +709,7 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 				sdi->driver->dev_acquisition_stop(sdi, cb_data);
 				return TRUE;
 			}
+			devc->block_requested = FALSE;
 			/* At slow timebases in live capture the DS2072
 			 * sometimes returns "short" data blocks, with
 			 * apparently no way to get the rest of the data.
@@ -634,6 +723,20 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 				return TRUE;
 			}
 			devc->num_block_bytes = len;
+			/*
+			 * Where the scope can queue its responses, have it
+			 * prepare the next window while this one is read.
+			 */
+			if (sr_scpi_pipelined(scpi) &&
+					rigol_ds_block_next(sdi,
+						devc->num_channel_bytes, len,
+						expected_data_bytes) != SR_OK) {
+				sr_err("Failed to request next data block.");
+				packet.type = SR_DF_FRAME_END;
+				sr_session_send(cb_data, &packet);
+				sdi->driver->dev_acquisition_stop(sdi, cb_data);
+				return TRUE;
+			}
 		} else {
 			devc->num_block_bytes = expected_data_bytes;
 		}
@@ -659,50 +762,16 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 
 	devc->num_block_read += len;
 
-	if (ch->type == SR_CHANNEL_ANALOG) {
-		vref = devc->vert_reference[ch->index];
-		vdiv = devc->vdiv[ch->index] / 25.6;
-		offset = devc->vert_offset[ch->index];
-		if (devc->model->series->protocol >= PROTOCOL_V3)
-			for (i = 0; i < len; i++)
-				devc->data[i] = ((int)devc->buffer[i] - vref) * vdiv - offset;
-		else
-			for (i = 0; i < len; i++)
-				devc->data[i] = (128 - devc->buffer[i]) * vdiv - offset;
-		analog.channels = g_slist_append(NULL, ch);
-		analog.num_samples = len;
-		analog.data = devc->data;
-		analog.mq = SR_MQ_VOLTAGE;
-		analog.unit = SR_UNIT_VOLT;
-		analog.mqflags = 0;
-		packet.type = SR_DF_ANALOG_OLD;
-		packet.payload = &analog;
-		sr_session_send(cb_data, &packet);
-		g_slist_free(analog.channels);
-	} else {
-		logic.length = len;
-		// TODO: For the MSO1000Z series, we need a way to express that
-		// this data is in fact just for a single channel, with the valid
-		// data for that channel in the LSB of each byte.
-		logic.unitsize = devc->model->series->protocol == PROTOCOL_V4 ? 1 : 2;
-		logic.data = devc->buffer;
-		packet.type = SR_DF_LOGIC;
-		packet.payload = &logic;
-		sr_session_send(cb_data, &packet);
-	}
-
 	if (devc->num_block_read == devc->num_block_bytes) {
 		sr_dbg("Block has been completed");
 		if (devc->model->series->protocol >= PROTOCOL_V3) {
 			/* Discard the terminating linefeed */
-			sr_scpi_read_data(scpi, (char *)devc->buffer, 1);
+			sr_scpi_read_data(scpi, &lf, 1);
 		}
 		if (devc->format == FORMAT_IEEE488_2) {
 			/* Prepare for possible next block */
 			devc->num_header_bytes = 0;
 			devc->num_block_bytes = 0;
-			if (devc->data_source != DATA_SOURCE_LIVE)
-				rigol_ds_set_wait_event(devc, WAIT_BLOCK);
 		}
 		if (!sr_scpi_read_complete(scpi)) {
 			sr_err("Read should have been completed");
@@ -712,11 +781,75 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 			return TRUE;
 		}
 		devc->num_block_read = 0;
+
+		/*
+		 * Otherwise, have the scope prepare the next window of
+		 * sample memory at least while this chunk is being
+		 * converted and sent. Either way, its response is next.
+		 */
+		if ((!devc->block_requested && rigol_ds_block_next(sdi,
+				devc->num_channel_bytes, len,
+				expected_data_bytes) != SR_OK) ||
+				(devc->block_requested &&
+				sr_scpi_read_begin(scpi) != SR_OK)) {
+			sr_err("Failed to request next data block.");
+			packet.type = SR_DF_FRAME_END;
+			sr_session_send(cb_data, &packet);
+			sdi->driver->dev_acquisition_stop(sdi, cb_data);
+			return TRUE;
+		}
 	} else {
 		sr_dbg("%" PRIu64 " of %" PRIu64 " block bytes read",
 			devc->num_block_read, devc->num_block_bytes);
 	}
 
+	if (ch->type == SR_CHANNEL_ANALOG) {
+		/*
+		 * The ADC bytes are passed on as-is, along with the scale
+		 * and offset that turn them into voltages. One ADC step is
+		 * vdiv, the reference byte is 0 V on V3 and later, older
+		 * models count down from 128.
+		 */
+		vref = devc->vert_reference[ch->index];
+		vdiv = devc->vdiv[ch->index] / 25.6;
+		offset = devc->vert_offset[ch->index];
+		sr_analog_init(&analog, &encoding, &meaning, &spec,
+			       vdiv > 0 ? MAX(0, (int)ceil(-log10(vdiv))) : 0);
+		encoding.unitsize = sizeof(uint8_t);
+		encoding.is_signed = FALSE;
+		encoding.is_float = FALSE;
+		encoding.is_bigendian = FALSE;
+		if (devc->model->series->protocol >= PROTOCOL_V3) {
+			rigol_ds_rational_from_double(&encoding.scale, vdiv);
+			rigol_ds_rational_from_double(&encoding.offset,
+				-vref * vdiv - offset);
+		} else {
+			rigol_ds_rational_from_double(&encoding.scale, -vdiv);
+			rigol_ds_rational_from_double(&encoding.offset,
+				128 * vdiv - offset);
+		}
+		analog.meaning->channels = g_slist_append(NULL, ch);
+		analog.num_samples = len;
+		analog.data = devc->buffer;
+		analog.meaning->mq = SR_MQ_VOLTAGE;
+		analog.meaning->unit = SR_UNIT_VOLT;
+		analog.meaning->mqflags = 0;
+		packet.type = SR_DF_ANALOG;
+		packet.payload = &analog;
+		sr_session_send(cb_data, &packet);
+		g_slist_free(analog.meaning->channels);
+	} else {
+		logic.length = len;
+		// TODO: For the MSO1000Z series, we need a way to express that
+		// this data is in fact just for a single channel, with the valid
+		// data for that channel in the LSB of each byte.
+		logic.unitsize = devc->model->series->protocol == PROTOCOL_V4 ? 1 : 2;
+		logic.data = devc->buffer;
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		sr_session_send(cb_data, &packet);
+	}
+
 	devc->num_channel_bytes += len;
 
 	if (devc->num_channel_bytes < expected_data_bytes)
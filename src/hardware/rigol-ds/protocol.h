@@ -31,9 +31,16 @@
 /* Size of acquisition buffers */
 #define ACQ_BUFFER_SIZE (32 * 1024)
 
-/* Maximum number of samples to retrieve at once. */
+/*
+ * Maximum number of samples to retrieve at once over slow transports
+ * (serial), so that stopping an acquisition stays responsive.
+ */
 #define ACQ_BLOCK_SIZE (30 * 1000)
 
+/* Bounds for the back-off when the scope returns empty data blocks. */
+#define MIN_BLOCK_BACKOFF_US (1 * 1000)
+#define MAX_BLOCK_BACKOFF_US (100 * 1000)
+
 #define MAX_ANALOG_CHANNELS 4
 #define MAX_DIGITAL_CHANNELS 16
 
@@ -72,6 +79,8 @@ struct rigol_ds_series {
 	int num_horizontal_divs;
 	int live_samples;
 	int buffer_samples;
+	/* Firmware limit of samples per :WAV:DATA? request, 0 if none. */
+	int max_block_samples;
 };
 
 struct rigol_ds_model {
@@ -85,7 +94,7 @@ struct rigol_ds_model {
 enum wait_events {
 	WAIT_NONE,    /* Don't wait */
 	WAIT_TRIGGER, /* Wait for trigger (only live capture) */
-	WAIT_BLOCK,   /* Wait for block data (only when reading sample mem) */
+	WAIT_BLOCK,   /* Back off after an empty data block */
 	WAIT_STOP,    /* Wait for scope stopping (only single shots) */
 };
 
@@ -140,13 +149,24 @@ struct dev_context {
 	uint64_t num_block_bytes;
 	/* Number of data block bytes already read */
 	uint64_t num_block_read;
+	/* Number of samples to request per data block */
+	uint64_t block_size;
+	/* Whether the next data block has already been requested */
+	gboolean block_requested;
+	/* Current delay before re-requesting after an empty data block */
+	unsigned long block_backoff;
+	/* Monotonic time before which the block isn't re-requested */
+	int64_t block_deadline;
 	/* What to wait for in *_receive */
 	enum wait_events wait_event;
 	/* Trigger/block copying/stop waiting status */
 	int wait_status;
 	/* Acq buffers used for reading from the scope and sending data to app */
 	unsigned char *buffer;
-	float *data;
+	/* Settings are being applied as a batch, see config_set_batch(). */
+	gboolean config_batch;
+	/* A setting of the batch has been sent without waiting for it. */
+	gboolean config_pending;
 };
 
 SR_PRIV int rigol_ds_config_set(const struct sr_dev_inst *sdi, const char *format, ...);
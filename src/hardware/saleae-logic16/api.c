@@ -62,6 +62,11 @@ static const int32_t soft_trigger_matches[] = {
 	SR_TRIGGER_RISING,
 	SR_TRIGGER_FALLING,
 	SR_TRIGGER_EDGE,
+	SR_TRIGGER_UART,
+	SR_TRIGGER_SPI,
+	SR_TRIGGER_I2C,
+	SR_TRIGGER_PULSE,
+	SR_TRIGGER_TIMEOUT,
 };
 
 static const char *channel_names[] = {
@@ -240,6 +245,13 @@ static GSList *dev_list(const struct sr_dev_driver *di)
 	return ((struct drv_context *)(di->context))->instances;
 }
 
+static GSList *usb_ids(const struct sr_dev_driver *di)
+{
+	(void)di;
+
+	return usb_id_append(NULL, LOGIC16_VID, LOGIC16_PID, NULL, NULL);
+}
+
 static int logic16_dev_open(struct sr_dev_inst *sdi)
 {
 	struct sr_dev_driver *di;
@@ -825,6 +837,7 @@ SR_PRIV struct sr_dev_driver saleae_logic16_driver_info = {
 	.scan = scan,
 	.dev_list = dev_list,
 	.dev_clear = NULL,
+	.usb_ids = usb_ids,
 	.config_get = config_get,
 	.config_set = config_set,
 	.config_list = config_list,
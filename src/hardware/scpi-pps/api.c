@@ -466,6 +466,110 @@ static int config_set(uint32_t key, GVariant *data, const struct sr_dev_inst *sd
 	return ret;
 }
 
+/* Check a batch value against the programming range of its output. */
+static int check_batch_range(const struct dev_context *devc,
+		const struct sr_config_batch_entry *entry)
+{
+	const struct sr_channel *ch;
+	const struct pps_channel *pch;
+	const struct channel_spec *ch_spec;
+	const float *range;
+	double d;
+
+	if (!entry->cg)
+		return SR_OK;
+
+	ch = entry->cg->channels->data;
+	pch = ch->priv;
+	if (devc->channels)
+		ch_spec = &devc->channels[pch->hw_output_idx];
+	else
+		ch_spec = &devc->device->channels[pch->hw_output_idx];
+
+	switch (entry->key) {
+	case SR_CONF_VOLTAGE_TARGET:
+		range = ch_spec->voltage;
+		break;
+	case SR_CONF_CURRENT_LIMIT:
+		range = ch_spec->current;
+		break;
+	case SR_CONF_OUTPUT_FREQUENCY_TARGET:
+		range = ch_spec->frequency;
+		break;
+	default:
+		return SR_OK;
+	}
+
+	d = g_variant_get_double(entry->data);
+	if (range[1] > range[0] && (d < range[0] || d > range[1])) {
+		sr_err("%s: %g is outside of %g to %g.", entry->cg->name,
+			d, range[0], range[1]);
+		return SR_ERR_ARG;
+	}
+
+	return SR_OK;
+}
+
+/* Sort rank of a batch entry: its output, then when to apply it. */
+static int batch_rank(const struct sr_config_batch_entry *entry)
+{
+	const struct sr_channel *ch;
+	const struct pps_channel *pch;
+	int output, step;
+
+	output = -1;
+	if (entry->cg) {
+		ch = entry->cg->channels->data;
+		pch = ch->priv;
+		output = pch->hw_output_idx;
+	}
+
+	step = 1;
+	if (entry->key == SR_CONF_ENABLED)
+		step = g_variant_get_boolean(entry->data) ? 2 : 0;
+
+	return (output + 1) * 3 + step;
+}
+
+/*
+ * Outputs are configured one after the other, so that each is selected
+ * only once. An output is switched off before, and on after the other
+ * settings, so that it never runs with half of them applied.
+ */
+static gint batch_compare(gconstpointer a, gconstpointer b)
+{
+	return batch_rank(a) - batch_rank(b);
+}
+
+static int config_set_batch(const struct sr_dev_inst *sdi, GSList *entries)
+{
+	struct dev_context *devc;
+	const struct sr_config_batch_entry *entry;
+	GSList *sorted, *l;
+	int ret;
+
+	if (sdi->status != SR_ST_ACTIVE)
+		return SR_ERR_DEV_CLOSED;
+	devc = sdi->priv;
+
+	/* Reject the whole batch before anything is sent. */
+	for (l = entries; l; l = l->next) {
+		if ((ret = check_batch_range(devc, l->data)) != SR_OK)
+			return ret;
+	}
+
+	/* g_slist_sort() is stable, settings keep their order otherwise. */
+	sorted = g_slist_sort(g_slist_copy(entries), batch_compare);
+	ret = SR_OK;
+	for (l = sorted; l && ret == SR_OK; l = l->next) {
+		entry = l->data;
+		ret = config_set(entry->key, entry->data, sdi, entry->cg);
+	}
+	g_slist_free(sorted);
+
+	return ret;
+}
+
 static int config_list(uint32_t key, GVariant **data, const struct sr_dev_inst *sdi,
 		const struct sr_channel_group *cg)
 {
@@ -654,6 +758,7 @@ SR_PRIV struct sr_dev_driver scpi_pps_driver_info = {
 	.dev_clear = dev_clear,
 	.config_get = config_get,
 	.config_set = config_set,
+	.config_set_batch = config_set_batch,
 	.config_list = config_list,
 	.dev_open = dev_open,
 	.dev_close = dev_close,
@@ -60,7 +60,10 @@ static void teleinfo_send_value(struct sr_dev_inst *sdi, const char *channel_nam
 {
 	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog_old analog;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 	struct sr_channel *ch;
 
 	devc = sdi->priv;
@@ -69,17 +72,17 @@ static void teleinfo_send_value(struct sr_dev_inst *sdi, const char *channel_nam
 	if (!ch || !ch->enabled)
 		return;
 
-	memset(&analog, 0, sizeof(struct sr_datafeed_analog_old));
-	analog.channels = g_slist_append(analog.channels, ch);
+	sr_analog_init(&analog, &encoding, &meaning, &spec, 0);
+	analog.meaning->channels = g_slist_append(NULL, ch);
 	analog.num_samples = 1;
-	analog.mq = mq;
-	analog.unit = unit;
+	analog.meaning->mq = mq;
+	analog.meaning->unit = unit;
 	analog.data = &value;
 
-	packet.type = SR_DF_ANALOG_OLD;
+	packet.type = SR_DF_ANALOG;
 	packet.payload = &analog;
 	sr_session_send(devc->session_cb_data, &packet);
-	g_slist_free(analog.channels);
+	g_slist_free(analog.meaning->channels);
 }
 
 static void teleinfo_handle_measurement(struct sr_dev_inst *sdi,
@@ -392,6 +392,7 @@ static int config_set(uint32_t key, GVariant *data, const struct sr_dev_inst *sd
 				if (cg != devc->analog_groups[j - 1])
 					continue;
 				state->analog_states[j - 1].vdiv = i;
+				state->analog_states[j - 1].waveform_valid = FALSE;
 				g_ascii_formatd(float_str, sizeof(float_str),
 						"%E", (float) p / q);
 				if (dlm_analog_chan_vdiv_set(sdi->conn, j, float_str) != SR_OK ||
@@ -662,6 +663,11 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 		return SR_ERR_NA;
 	}
 
+	if (dlm_acquisition_setup(sdi) != SR_OK) {
+		sr_err("Failed to set up waveform retrieval.");
+		return SR_ERR;
+	}
+
 	/* Request data for the first enabled channel. */
 	devc->current_channel = devc->enabled_channels;
 	dlm_channel_data_request(sdi);
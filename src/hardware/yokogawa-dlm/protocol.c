@@ -482,6 +482,8 @@ static int analog_channel_state_get(const struct sr_dev_inst *sdi,
 				&state->analog_states[i].waveform_offset) != SR_OK)
 			return SR_ERR;
 
+		state->analog_states[i].waveform_valid = TRUE;
+
 		if (dlm_analog_chan_coupl_get(scpi, i + 1, &response) != SR_OK) {
 			g_free(response);
 			return SR_ERR;
@@ -884,6 +886,51 @@ SR_PRIV int dlm_device_init(struct sr_dev_inst *sdi, int model_index)
 	return SR_OK;
 }
 
+/**
+ * Prepares the oscilloscope for downloading the waveforms of all enabled
+ * channels. The waveform format settings are the same for all channels,
+ * so they're only sent once per acquisition. The waveform range and offset
+ * of analog channels are only re-queried if a setting has changed since.
+ *
+ * @param sdi The device instance.
+ *
+ * @return SR_ERR on error, SR_OK otherwise.
+ */
+SR_PRIV int dlm_acquisition_setup(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	struct scope_state *state;
+	struct analog_channel_state *ch_state;
+	struct sr_channel *ch;
+	GSList *l;
+
+	devc = sdi->priv;
+	state = devc->model_state;
+
+	if (dlm_waveform_format_set(sdi->conn) != SR_OK)
+		return SR_ERR;
+
+	for (l = devc->enabled_channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type != SR_CHANNEL_ANALOG)
+			continue;
+
+		ch_state = &state->analog_states[ch->index];
+		if (ch_state->waveform_valid)
+			continue;
+
+		if (dlm_analog_chan_wrange_get(sdi->conn, ch->index + 1,
+				&ch_state->waveform_range) != SR_OK)
+			return SR_ERR;
+		if (dlm_analog_chan_woffs_get(sdi->conn, ch->index + 1,
+				&ch_state->waveform_offset) != SR_OK)
+			return SR_ERR;
+		ch_state->waveform_valid = TRUE;
+	}
+
+	return SR_OK;
+}
+
 SR_PRIV int dlm_channel_data_request(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
@@ -946,64 +993,75 @@ static int dlm_block_data_header_process(GArray *data, int *len)
 }
 
 /**
- * Turns raw sample data into voltages and sends them off to the session bus.
+ * Converts a floating point value to a rational number with a fixed
+ * number of decimal places.
+ */
+static void dlm_rational_from_float(struct sr_rational *r, float value)
+{
+	sr_rational_set(r, (int64_t)llround(value * 1e9), 1000000000);
+}
+
+/**
+ * Sends raw analog sample data off to the session bus. The samples are
+ * passed on as-is, along with the scale and offset that turn them into
+ * voltages.
  *
  * @param data The raw sample data.
- * @ch_state Pointer to the state of the channel whose data we're processing.
- * @sdi The device instance.
+ * @param ch The channel whose data we're processing.
+ * @param ch_state Pointer to the state of the channel.
+ * @param sdi The device instance.
  *
  * @return SR_ERR when data is trucated, SR_OK otherwise.
  */
-static int dlm_analog_samples_send(GArray *data,
+static int dlm_analog_samples_send(GArray *data, struct sr_channel *ch,
 		struct analog_channel_state *ch_state,
 		struct sr_dev_inst *sdi)
 {
-	uint32_t i, samples;
-	float voltage, range, offset;
-	GArray *float_data;
+	uint32_t samples;
+	float scale;
+	int digits;
 	struct dev_context *devc;
 	struct scope_state *model_state;
-	struct sr_channel *ch;
-	struct sr_datafeed_analog_old analog;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 	struct sr_datafeed_packet packet;
 
 	devc = sdi->priv;
 	model_state = devc->model_state;
 	samples = model_state->samples_per_frame;
-	ch = devc->current_channel->data;
 
 	if (data->len < samples * sizeof(uint8_t)) {
 		sr_err("Truncated waveform data packet received.");
 		return SR_ERR;
 	}
 
-	range = ch_state->waveform_range;
-	offset = ch_state->waveform_offset;
-
 	/*
-	 * Convert byte sample to voltage according to
+	 * Byte samples are turned into voltages according to
 	 * page 269 of the Communication Interface User's Manual.
 	 */
-	float_data = g_array_new(FALSE, FALSE, sizeof(float));
-	for (i = 0; i < samples; i++) {
-		voltage = (float)g_array_index(data, int8_t, i);
-		voltage = (range * voltage /
-				DLM_DIVISION_FOR_BYTE_FORMAT) + offset;
-		g_array_append_val(float_data, voltage);
-	}
-
-	analog.channels = g_slist_append(NULL, ch);
-	analog.num_samples = float_data->len;
-	analog.data = (float*)float_data->data;
-	analog.mq = SR_MQ_VOLTAGE;
-	analog.unit = SR_UNIT_VOLT;
-	analog.mqflags = 0;
-	packet.type = SR_DF_ANALOG_OLD;
+	scale = ch_state->waveform_range / DLM_DIVISION_FOR_BYTE_FORMAT;
+	digits = scale > 0 ? MAX(0, (int)ceil(-log10(scale))) : 0;
+
+	sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
+	encoding.unitsize = sizeof(int8_t);
+	encoding.is_signed = TRUE;
+	encoding.is_float = FALSE;
+	encoding.is_bigendian = FALSE;
+	dlm_rational_from_float(&encoding.scale, scale);
+	dlm_rational_from_float(&encoding.offset, ch_state->waveform_offset);
+	meaning.channels = g_slist_append(NULL, ch);
+	meaning.mq = SR_MQ_VOLTAGE;
+	meaning.unit = SR_UNIT_VOLT;
+	meaning.mqflags = 0;
+	analog.num_samples = samples;
+	analog.data = data->data;
+	packet.type = SR_DF_ANALOG;
 	packet.payload = &analog;
 	sr_session_send(sdi, &packet);
-	g_slist_free(analog.channels);
+	g_slist_free(meaning.channels);
 
-	g_array_free(float_data, TRUE);
 	g_array_remove_range(data, 0, samples * sizeof(uint8_t));
 
 	return SR_OK;
@@ -1067,6 +1125,7 @@ SR_PRIV int dlm_data_receive(int fd, int revents, void *cb_data)
 	struct sr_channel *ch;
 	struct sr_datafeed_packet packet;
 	int chunk_len, num_bytes;
+	gboolean last_channel;
 	static GArray *data = NULL;
 
 	(void)fd;
@@ -1111,6 +1170,8 @@ SR_PRIV int dlm_data_receive(int fd, int revents, void *cb_data)
 	/* We finished reading and are no longer waiting for data. */
 	devc->data_pending = FALSE;
 
+	ch = devc->current_channel->data;
+
 	/* Signal the beginning of a new frame if this is the first channel. */
 	if (devc->current_channel == devc->enabled_channels) {
 		packet.type = SR_DF_FRAME_BEGIN;
@@ -1129,14 +1190,27 @@ SR_PRIV int dlm_data_receive(int fd, int revents, void *cb_data)
 		/* Don't care about return value here. */
 		dlm_acquisition_stop(sdi->conn);
 		g_array_free(data, TRUE);
+		data = NULL;
 		dlm_channel_data_request(sdi);
 		return TRUE;
 	}
 
-	ch = devc->current_channel->data;
+	/*
+	 * Set the next enabled channel and request its data right away, so
+	 * the device prepares it while we process this channel's data.
+	 */
+	last_channel = !devc->current_channel->next;
+	if (!last_channel) {
+		devc->current_channel = devc->current_channel->next;
+		if (dlm_channel_data_request(sdi) != SR_OK) {
+			sr_err("Failed to request acquisition data.");
+			goto fail;
+		}
+	}
+
 	switch (ch->type) {
 	case SR_CHANNEL_ANALOG:
-		if (dlm_analog_samples_send(data,
+		if (dlm_analog_samples_send(data, ch,
 				&model_state->analog_states[ch->index],
 				sdi) != SR_OK)
 			goto fail;
@@ -1153,11 +1227,8 @@ SR_PRIV int dlm_data_receive(int fd, int revents, void *cb_data)
 	g_array_free(data, TRUE);
 	data = NULL;
 
-	/*
-	 * Signal the end of this frame if this was the last enabled channel
-	 * and set the next enabled channel. Then, request its data.
-	 */
-	if (!devc->current_channel->next) {
+	/* Signal the end of this frame if this was the last enabled channel. */
+	if (last_channel) {
 		packet.type = SR_DF_FRAME_END;
 		sr_session_send(sdi, &packet);
 		devc->current_channel = devc->enabled_channels;
@@ -1167,13 +1238,6 @@ SR_PRIV int dlm_data_receive(int fd, int revents, void *cb_data)
 		 * data so we're going to stop at this point.
 		 */
 		sdi->driver->dev_acquisition_stop(sdi, cb_data);
-		return TRUE;
-	} else
-		devc->current_channel = devc->current_channel->next;
-
-	if (dlm_channel_data_request(sdi) != SR_OK) {
-		sr_err("Failed to request acquisition data.");
-		goto fail;
 	}
 
 	return TRUE;
@@ -77,6 +77,8 @@ struct analog_channel_state {
 
 	int vdiv;
 	float vertical_offset, waveform_range, waveform_offset;
+	/* Whether waveform_range/_offset match the current settings. */
+	gboolean waveform_valid;
 
 	gboolean state;
 };
@@ -122,6 +124,7 @@ SR_PRIV int dlm_data_receive(int fd, int revents, void *cb_data);
 SR_PRIV void dlm_scope_state_destroy(struct scope_state *state);
 SR_PRIV int dlm_scope_state_query(struct sr_dev_inst *sdi);
 SR_PRIV int dlm_sample_rate_query(const struct sr_dev_inst *sdi);
+SR_PRIV int dlm_acquisition_setup(const struct sr_dev_inst *sdi);
 SR_PRIV int dlm_channel_data_request(const struct sr_dev_inst *sdi);
 
 #endif
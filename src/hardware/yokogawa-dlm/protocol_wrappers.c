@@ -326,9 +326,8 @@ int dlm_data_get(struct sr_scpi_dev_inst *scpi, int acquisition_num)
 	return sr_scpi_send(scpi, cmd);
 }
 
-int dlm_analog_data_get(struct sr_scpi_dev_inst *scpi, int channel)
+int dlm_waveform_format_set(struct sr_scpi_dev_inst *scpi)
 {
-	gchar cmd[MAX_COMMAND_SIZE];
 	int result;
 
 	result = sr_scpi_send(scpi, ":WAVEFORM:FORMAT BYTE");
@@ -336,9 +335,16 @@ int dlm_analog_data_get(struct sr_scpi_dev_inst *scpi, int channel)
 	if (result == SR_OK) result = sr_scpi_send(scpi, ":WAVEFORM:START 0");
 	if (result == SR_OK) result = sr_scpi_send(scpi, ":WAVEFORM:END 124999999");
 
-	g_snprintf(cmd, sizeof(cmd), ":WAVEFORM:TRACE %d", channel);
-	if (result == SR_OK) result = sr_scpi_send(scpi, cmd);
+	return result;
+}
+
+int dlm_analog_data_get(struct sr_scpi_dev_inst *scpi, int channel)
+{
+	gchar cmd[MAX_COMMAND_SIZE];
+	int result;
 
+	g_snprintf(cmd, sizeof(cmd), ":WAVEFORM:TRACE %d", channel);
+	result = sr_scpi_send(scpi, cmd);
 	if (result == SR_OK) result = sr_scpi_send(scpi, ":WAVEFORM:SEND? 1");
 
 	return result;
@@ -348,11 +354,7 @@ int dlm_digital_data_get(struct sr_scpi_dev_inst *scpi)
 {
 	int result;
 
-	result = sr_scpi_send(scpi, ":WAVEFORM:FORMAT BYTE");
-	if (result == SR_OK) result = sr_scpi_send(scpi, ":WAVEFORM:RECORD 0");
-	if (result == SR_OK) result = sr_scpi_send(scpi, ":WAVEFORM:START 0");
-	if (result == SR_OK) result = sr_scpi_send(scpi, ":WAVEFORM:END 124999999");
-	if (result == SR_OK) result = sr_scpi_send(scpi, ":WAVEFORM:TRACE LOGIC");
+	result = sr_scpi_send(scpi, ":WAVEFORM:TRACE LOGIC");
 	if (result == SR_OK) result = sr_scpi_send(scpi, ":WAVEFORM:SEND? 1");
 
 	return result;
@@ -0,0 +1,674 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "hotplug"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Notification of USB devices being plugged in and unplugged.
+ */
+
+/**
+ * @defgroup grp_hotplug Hotplug
+ *
+ * Notification of USB devices being plugged in and unplugged.
+ *
+ * Instead of calling sr_driver_scan() for every driver, over and over,
+ * an application can subscribe to hotplug events. Each device that
+ * arrives is looked up in the USB IDs the drivers list, and only the
+ * driver that handles it scans it, and only it. Devices no driver
+ * handles aren't even opened.
+ *
+ * Where libusb supports hotplug notification, libsigrok uses it.
+ * Elsewhere, it compares the list of USB devices twice a second.
+ *
+ * @{
+ */
+
+/** @cond PRIVATE */
+#ifdef HAVE_LIBUSB_1_0
+
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000102)
+#define HAVE_LIBUSB_HOTPLUG 1
+#endif
+
+#define HOTPLUG_POLL_INTERVAL_MS 500
+
+/*
+ * How long a device may take to come back after its firmware upload,
+ * before its instances are reported gone. The drivers wait up to 3s.
+ */
+#define RENUM_TIMEOUT_MS 5000
+
+/* A driver that handles a device, by its USB IDs and maybe strings. */
+struct hotplug_candidate {
+	struct sr_usb_id *id;
+	struct sr_dev_driver *driver;
+};
+
+/* A device on the bus, and what was found on it. */
+struct hotplug_dev {
+	uint8_t bus;
+	uint8_t address;
+	uint16_t vid;
+	uint16_t pid;
+	char connection_id[64];
+	struct sr_dev_driver *driver;
+	GSList *instances;
+	/* While it renumerates, when to give up on it. */
+	int64_t renum_deadline;
+};
+
+/* A notification from libusb, to be handled outside its callback. */
+struct hotplug_change {
+	libusb_device *dev;
+	gboolean arrived;
+};
+
+struct sr_hotplug {
+	sr_hotplug_callback cb;
+	void *cb_data;
+	/* Lists of hotplug_candidate, by (VID << 16 | PID). */
+	GHashTable *candidates;
+	/* The devices on the bus, by (bus << 8 | address). */
+	GHashTable *devices;
+	/* Devices which left for a firmware upload, to come back renumerated. */
+	GSList *renumerating;
+	gboolean native;
+#ifdef HAVE_LIBUSB_HOTPLUG
+	libusb_hotplug_callback_handle handle;
+#endif
+	/* The callback may run in any thread that handles libusb events. */
+	GMutex mutex;
+	GQueue changes;
+	int64_t next_poll;
+};
+
+static gpointer device_key(uint8_t bus, uint8_t address)
+{
+	return GUINT_TO_POINTER(bus << 8 | address);
+}
+
+static gpointer id_key(uint16_t vid, uint16_t pid)
+{
+	return GUINT_TO_POINTER((guint)vid << 16 | pid);
+}
+
+static void hotplug_dev_free(void *data)
+{
+	struct hotplug_dev *hdev;
+
+	hdev = data;
+	g_slist_free(hdev->instances);
+	g_free(hdev);
+}
+
+static void candidate_free(void *data)
+{
+	struct hotplug_candidate *cand;
+
+	cand = data;
+	g_free(cand->id);
+	g_free(cand);
+}
+
+static void candidates_free(void *data)
+{
+	g_slist_free_full(data, candidate_free);
+}
+
+/* Map the USB IDs to the drivers which list them. */
+static GHashTable *candidates_new(const struct sr_context *ctx)
+{
+	struct sr_dev_driver **drivers;
+	struct hotplug_candidate *cand;
+	struct sr_usb_id *id;
+	GHashTable *candidates;
+	gpointer key;
+	GSList *ids, *l, *m;
+	int i;
+
+	candidates = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+			NULL, candidates_free);
+	drivers = sr_driver_list(ctx);
+	for (i = 0; drivers[i]; i++) {
+		if (!drivers[i]->usb_ids)
+			continue;
+		ids = drivers[i]->usb_ids(drivers[i]);
+		for (m = ids; m; m = m->next) {
+			id = m->data;
+			cand = g_malloc(sizeof(struct hotplug_candidate));
+			cand->id = id;
+			cand->driver = drivers[i];
+			key = id_key(id->vid, id->pid);
+			if ((l = g_hash_table_lookup(candidates, key)))
+				l = g_slist_append(l, cand);
+			else
+				g_hash_table_insert(candidates, key,
+						g_slist_append(NULL, cand));
+		}
+		g_slist_free(ids);
+	}
+
+	return candidates;
+}
+
+static gboolean string_matches(libusb_device_handle *hdl, uint8_t index,
+		const char *prefix)
+{
+	char str[64];
+
+	if (!prefix)
+		return TRUE;
+	if (!index || libusb_get_string_descriptor_ascii(hdl, index,
+			(unsigned char *)str, sizeof(str)) < 0)
+		return FALSE;
+
+	return g_str_has_prefix(str, prefix);
+}
+
+/* Pick the driver for a device, reading its strings only if need be. */
+static struct sr_dev_driver *match_driver(GSList *candidates,
+		libusb_device *dev, const struct libusb_device_descriptor *des)
+{
+	const struct hotplug_candidate *cand;
+	struct sr_dev_driver *driver;
+	libusb_device_handle *hdl;
+	GSList *l;
+	int ret;
+
+	hdl = NULL;
+	driver = NULL;
+	for (l = candidates; l && !driver; l = l->next) {
+		cand = l->data;
+		if (!cand->id->manufacturer && !cand->id->product) {
+			driver = cand->driver;
+			continue;
+		}
+		if (!hdl && (ret = libusb_open(dev, &hdl)) < 0) {
+			sr_dbg("Failed to open device: %s.",
+				libusb_error_name(ret));
+			break;
+		}
+		if (string_matches(hdl, des->iManufacturer,
+				cand->id->manufacturer)
+				&& string_matches(hdl, des->iProduct,
+				cand->id->product))
+			driver = cand->driver;
+	}
+	if (hdl)
+		libusb_close(hdl);
+
+	return driver;
+}
+
+static void emit(struct sr_hotplug *hp, int type, struct hotplug_dev *hdev)
+{
+	struct sr_hotplug_event event;
+
+	sr_dbg("%s: %s device %04x:%04x on %s.", hdev->driver->name,
+		type == SR_HOTPLUG_ARRIVED ? "New" : "Lost",
+		hdev->vid, hdev->pid, hdev->connection_id);
+
+	event.type = type;
+	event.driver = hdev->driver;
+	event.devices = hdev->instances;
+	event.vendor_id = hdev->vid;
+	event.product_id = hdev->pid;
+	event.connection_id = hdev->connection_id;
+	hp->cb(&event, hp->cb_data);
+}
+
+/* Have the driver scan the device on bus.address, and nothing else. */
+static GSList *scan_device(struct sr_context *ctx,
+		struct sr_dev_driver *driver, uint8_t bus, uint8_t address)
+{
+	GSList *options, *devices;
+	char *conn;
+
+	if (!driver->context && sr_driver_init(ctx, driver) != SR_OK)
+		return NULL;
+
+	conn = g_strdup_printf("%d.%d", bus, address);
+	options = g_slist_append(NULL,
+			sr_config_new(SR_CONF_CONN, g_variant_new_string(conn)));
+	devices = sr_driver_scan(driver, options);
+	g_slist_free_full(options, (GDestroyNotify)sr_config_free);
+	g_free(conn);
+
+	return devices;
+}
+
+static void device_arrived(struct sr_context *ctx, libusb_device *dev)
+{
+	struct sr_hotplug *hp;
+	struct libusb_device_descriptor des;
+	struct hotplug_dev *hdev, *renum;
+	GSList *candidates, *l;
+	int ret;
+
+	hp = ctx->hotplug;
+
+	if ((ret = libusb_get_device_descriptor(dev, &des)) < 0) {
+		sr_dbg("Failed to get device descriptor: %s.",
+			libusb_error_name(ret));
+		return;
+	}
+
+	hdev = g_malloc0(sizeof(struct hotplug_dev));
+	hdev->bus = libusb_get_bus_number(dev);
+	hdev->address = libusb_get_device_address(dev);
+	hdev->vid = des.idVendor;
+	hdev->pid = des.idProduct;
+	g_hash_table_replace(hp->devices,
+			device_key(hdev->bus, hdev->address), hdev);
+
+	candidates = g_hash_table_lookup(hp->candidates,
+			id_key(des.idVendor, des.idProduct));
+	if (!candidates && !hp->renumerating)
+		return;
+	usb_get_port_path(dev, hdev->connection_id,
+			sizeof(hdev->connection_id));
+
+	/* A device coming back on the same port after its firmware upload. */
+	for (l = hp->renumerating; l; l = l->next) {
+		renum = l->data;
+		if (strcmp(renum->connection_id, hdev->connection_id))
+			continue;
+		sr_dbg("%s: Device on %s renumerated.", renum->driver->name,
+			hdev->connection_id);
+		hdev->driver = renum->driver;
+		hdev->instances = renum->instances;
+		renum->instances = NULL;
+		hp->renumerating = g_slist_delete_link(hp->renumerating, l);
+		hotplug_dev_free(renum);
+		return;
+	}
+
+	if (!candidates || !(hdev->driver = match_driver(candidates, dev, &des)))
+		return;
+
+	hdev->instances = scan_device(ctx, hdev->driver, hdev->bus,
+			hdev->address);
+	if (hdev->instances)
+		emit(hp, SR_HOTPLUG_ARRIVED, hdev);
+}
+
+/*
+ * Whether any of the instances is still on bus.address. Those of a
+ * device that uploaded firmware have moved on, or wait to learn their
+ * new address.
+ */
+static gboolean instances_on(GSList *instances, uint8_t bus, uint8_t address)
+{
+	const struct sr_dev_inst *sdi;
+	const struct sr_usb_dev_inst *usb;
+	GSList *l;
+
+	for (l = instances; l; l = l->next) {
+		sdi = l->data;
+		if (sdi->inst_type != SR_INST_USB || !(usb = sdi->conn))
+			return TRUE;
+		if (usb->bus == bus && usb->address == address)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void device_left(struct sr_context *ctx, uint8_t bus, uint8_t address)
+{
+	struct sr_hotplug *hp;
+	struct hotplug_dev *hdev;
+	gpointer key;
+
+	hp = ctx->hotplug;
+
+	key = device_key(bus, address);
+	if (!(hdev = g_hash_table_lookup(hp->devices, key)))
+		return;
+	g_hash_table_steal(hp->devices, key);
+
+	if (!hdev->instances) {
+		hotplug_dev_free(hdev);
+		return;
+	}
+
+	if (!instances_on(hdev->instances, bus, address)) {
+		hdev->renum_deadline = g_get_monotonic_time()
+				+ RENUM_TIMEOUT_MS * 1000;
+		hp->renumerating = g_slist_append(hp->renumerating, hdev);
+		return;
+	}
+
+	emit(hp, SR_HOTPLUG_LEFT, hdev);
+	hotplug_dev_free(hdev);
+}
+
+/* Report devices which never came back from their firmware upload. */
+static void renumerating_expire(struct sr_hotplug *hp)
+{
+	struct hotplug_dev *hdev;
+	GSList *l, *next;
+	int64_t now;
+
+	now = g_get_monotonic_time();
+	for (l = hp->renumerating; l; l = next) {
+		next = l->next;
+		hdev = l->data;
+		if (hdev->renum_deadline > now)
+			continue;
+		hp->renumerating = g_slist_delete_link(hp->renumerating, l);
+		emit(hp, SR_HOTPLUG_LEFT, hdev);
+		hotplug_dev_free(hdev);
+	}
+}
+
+/*
+ * Without hotplug notification, compare the bus with what was there
+ * before. Only devices that weren't need their descriptors read.
+ */
+static void poll_devices(struct sr_context *ctx)
+{
+	struct sr_hotplug *hp;
+	struct hotplug_dev *hdev;
+	libusb_device **devlist;
+	GHashTable *present;
+	GHashTableIter iter;
+	GSList *gone, *l;
+	gpointer key;
+	ssize_t i, num;
+
+	hp = ctx->hotplug;
+
+	if ((num = libusb_get_device_list(ctx->libusb_ctx, &devlist)) < 0) {
+		sr_err("Failed to list USB devices: %s.",
+			libusb_error_name((int)num));
+		return;
+	}
+
+	present = g_hash_table_new(g_direct_hash, g_direct_equal);
+	for (i = 0; i < num; i++)
+		g_hash_table_add(present,
+			device_key(libusb_get_bus_number(devlist[i]),
+				libusb_get_device_address(devlist[i])));
+
+	gone = NULL;
+	g_hash_table_iter_init(&iter, hp->devices);
+	while (g_hash_table_iter_next(&iter, &key, (gpointer *)&hdev)) {
+		if (!g_hash_table_contains(present, key))
+			gone = g_slist_prepend(gone, hdev);
+	}
+	for (l = gone; l; l = l->next) {
+		hdev = l->data;
+		device_left(ctx, hdev->bus, hdev->address);
+	}
+	g_slist_free(gone);
+
+	for (i = 0; i < num; i++) {
+		key = device_key(libusb_get_bus_number(devlist[i]),
+				libusb_get_device_address(devlist[i]));
+		if (!g_hash_table_contains(hp->devices, key))
+			device_arrived(ctx, devlist[i]);
+	}
+
+	g_hash_table_destroy(present);
+	libusb_free_device_list(devlist, 1);
+}
+
+#ifdef HAVE_LIBUSB_HOTPLUG
+static int LIBUSB_CALL hotplug_cb(libusb_context *usb_ctx,
+		libusb_device *dev, libusb_hotplug_event event, void *user_data)
+{
+	struct sr_hotplug *hp;
+	struct hotplug_change *change;
+
+	(void)usb_ctx;
+
+	hp = user_data;
+
+	change = g_malloc(sizeof(struct hotplug_change));
+	change->dev = libusb_ref_device(dev);
+	change->arrived = (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED);
+	g_mutex_lock(&hp->mutex);
+	g_queue_push_tail(&hp->changes, change);
+	g_mutex_unlock(&hp->mutex);
+
+	return 0;
+}
+#endif
+
+static void handle_changes(struct sr_context *ctx)
+{
+	struct sr_hotplug *hp;
+	struct hotplug_change *change;
+
+	hp = ctx->hotplug;
+
+	for (;;) {
+		g_mutex_lock(&hp->mutex);
+		change = g_queue_pop_head(&hp->changes);
+		g_mutex_unlock(&hp->mutex);
+		if (!change)
+			break;
+		if (change->arrived)
+			device_arrived(ctx, change->dev);
+		else
+			device_left(ctx, libusb_get_bus_number(change->dev),
+				libusb_get_device_address(change->dev));
+		libusb_unref_device(change->dev);
+		g_free(change);
+	}
+}
+
+#endif
+/** @endcond */
+
+/**
+ * Subscribe to USB hotplug events.
+ *
+ * The callback runs from sr_hotplug_handle_events(), once for each
+ * supported device plugged in and each one unplugged again. Devices
+ * already present are reported on the first call.
+ *
+ * @param ctx The libsigrok context. Must not be NULL.
+ * @param cb The function to call with the events. Must not be NULL.
+ * @param cb_data Opaque pointer passed to the callback.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or already subscribed.
+ * @retval SR_ERR_NA libsigrok was built without USB support.
+ * @retval SR_ERR Other error.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_hotplug_subscribe(struct sr_context *ctx,
+		sr_hotplug_callback cb, void *cb_data)
+{
+#ifdef HAVE_LIBUSB_1_0
+	struct sr_hotplug *hp;
+#ifdef HAVE_LIBUSB_HOTPLUG
+	int ret;
+#endif
+
+	if (!ctx || !cb || ctx->hotplug)
+		return SR_ERR_ARG;
+
+	hp = g_malloc0(sizeof(struct sr_hotplug));
+	hp->cb = cb;
+	hp->cb_data = cb_data;
+	hp->candidates = candidates_new(ctx);
+	hp->devices = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+			NULL, hotplug_dev_free);
+	g_mutex_init(&hp->mutex);
+	g_queue_init(&hp->changes);
+	ctx->hotplug = hp;
+
+#ifdef HAVE_LIBUSB_HOTPLUG
+	if (libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+		ret = libusb_hotplug_register_callback(ctx->libusb_ctx,
+				LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED
+				| LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+				LIBUSB_HOTPLUG_ENUMERATE, LIBUSB_HOTPLUG_MATCH_ANY,
+				LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+				hotplug_cb, hp, &hp->handle);
+		if (ret == LIBUSB_SUCCESS)
+			hp->native = TRUE;
+		else
+			sr_warn("Failed to register hotplug callback: %s.",
+				libusb_error_name(ret));
+	}
+#endif
+	sr_dbg("Watching USB devices by %s.",
+		hp->native ? "hotplug notification" : "polling");
+
+	return SR_OK;
+#else
+	(void)ctx;
+	(void)cb;
+	(void)cb_data;
+
+	return SR_ERR_NA;
+#endif
+}
+
+/**
+ * Stop reporting USB hotplug events.
+ *
+ * Device instances reported earlier stay with their drivers.
+ *
+ * @param ctx The libsigrok context. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or not subscribed.
+ * @retval SR_ERR_NA libsigrok was built without USB support.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_hotplug_unsubscribe(struct sr_context *ctx)
+{
+#ifdef HAVE_LIBUSB_1_0
+	struct sr_hotplug *hp;
+	struct hotplug_change *change;
+
+	if (!ctx || !(hp = ctx->hotplug))
+		return SR_ERR_ARG;
+
+#ifdef HAVE_LIBUSB_HOTPLUG
+	if (hp->native)
+		libusb_hotplug_deregister_callback(ctx->libusb_ctx, hp->handle);
+#endif
+	while ((change = g_queue_pop_head(&hp->changes))) {
+		libusb_unref_device(change->dev);
+		g_free(change);
+	}
+	g_mutex_clear(&hp->mutex);
+	g_slist_free_full(hp->renumerating, hotplug_dev_free);
+	g_hash_table_destroy(hp->devices);
+	g_hash_table_destroy(hp->candidates);
+	g_free(hp);
+	ctx->hotplug = NULL;
+
+	return SR_OK;
+#else
+	(void)ctx;
+
+	return SR_ERR_NA;
+#endif
+}
+
+/**
+ * Handle USB hotplug events.
+ *
+ * Waits up to timeout_ms for devices to be plugged in or unplugged, and
+ * runs the callback for each one. Where libusb supports no hotplug
+ * notification, the USB devices are listed twice a second; this waits
+ * for the next time, if it's due within the timeout.
+ *
+ * Call this from the thread that handles the session, or not while
+ * scanning for or opening devices.
+ *
+ * @param ctx The libsigrok context. Must not be NULL.
+ * @param timeout_ms How long to wait, in milliseconds. 0 to only handle
+ *                   what's pending.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or not subscribed.
+ * @retval SR_ERR_NA libsigrok was built without USB support.
+ * @retval SR_ERR Other error.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_hotplug_handle_events(struct sr_context *ctx, int timeout_ms)
+{
+#ifdef HAVE_LIBUSB_1_0
+	struct sr_hotplug *hp;
+	struct timeval tv;
+	int64_t now, wait_us;
+	int ret;
+
+	if (!ctx || !(hp = ctx->hotplug) || timeout_ms < 0)
+		return SR_ERR_ARG;
+
+	if (hp->native) {
+		g_mutex_lock(&hp->mutex);
+		if (!g_queue_is_empty(&hp->changes))
+			timeout_ms = 0;
+		g_mutex_unlock(&hp->mutex);
+		tv.tv_sec = timeout_ms / 1000;
+		tv.tv_usec = (timeout_ms % 1000) * 1000;
+		ret = libusb_handle_events_timeout_completed(ctx->libusb_ctx,
+				&tv, NULL);
+		if (ret != LIBUSB_SUCCESS && ret != LIBUSB_ERROR_INTERRUPTED) {
+			sr_err("Error handling USB events: %s.",
+				libusb_error_name(ret));
+			return SR_ERR;
+		}
+		handle_changes(ctx);
+	} else {
+		now = g_get_monotonic_time();
+		if (hp->next_poll > now) {
+			wait_us = MIN(hp->next_poll - now, (int64_t)timeout_ms * 1000);
+			g_usleep(wait_us);
+			if (hp->next_poll > now + wait_us)
+				return SR_OK;
+		}
+		poll_devices(ctx);
+		hp->next_poll = g_get_monotonic_time()
+				+ HOTPLUG_POLL_INTERVAL_MS * 1000;
+	}
+	renumerating_expire(hp);
+
+	return SR_OK;
+#else
+	(void)ctx;
+	(void)timeout_ms;
+
+	return SR_ERR_NA;
+#endif
+}
+
+/** @} */
@@ -45,6 +45,14 @@
  * @{
  */
 
+/*
+ * The contexts between sr_init() and sr_exit(). The drivers are shared by
+ * all of them, each driver belongs to the context it was last initialized
+ * with, and is in that context's list of drivers.
+ */
+static GSList *contexts;
+static GMutex contexts_mutex;
+
 /* Please use the same order/grouping as in enum sr_configkey (libsigrok.h). */
 static struct sr_key_info sr_key_info_config[] = {
 	/* Device classes */
@@ -205,6 +213,10 @@ static struct sr_key_info sr_key_info_config[] = {
 		"Device mode", NULL},
 	{SR_CONF_TEST_MODE, SR_T_STRING, "test_mode",
 		"Test mode", NULL},
+	{SR_CONF_INJECT_GAPS, SR_T_UINT64, "inject_gaps",
+		"Gap injection interval", NULL},
+	{SR_CONF_ANALOG_PLANAR, SR_T_BOOL, "analog_planar",
+		"Planar analog packets", NULL},
 
 	ALL_ZERO
 };
@@ -373,6 +385,8 @@ SR_API struct sr_dev_driver **sr_driver_list(const struct sr_context *ctx)
  */
 SR_API int sr_driver_init(struct sr_context *ctx, struct sr_dev_driver *driver)
 {
+	struct sr_context *other;
+	GSList *l;
 	int ret;
 
 	if (!ctx) {
@@ -386,12 +400,44 @@ SR_API int sr_driver_init(struct sr_context *ctx, struct sr_dev_driver *driver)
 	}
 
 	sr_spew("Initializing driver '%s'.", driver->name);
-	if ((ret = driver->init(driver, ctx)) < 0)
+	if ((ret = driver->init(driver, ctx)) < 0) {
 		sr_err("Failed to initialize the driver: %d.", ret);
+		return ret;
+	}
+
+	/* The driver now belongs to ctx, other contexts mustn't clean it up. */
+	g_mutex_lock(&contexts_mutex);
+	for (l = contexts; l; l = l->next) {
+		other = l->data;
+		other->drivers = g_slist_remove(other->drivers, driver);
+	}
+	ctx->drivers = g_slist_prepend(ctx->drivers, driver);
+	g_mutex_unlock(&contexts_mutex);
 
 	return ret;
 }
 
+/*
+ * Initialize a driver on first use. This needs the context to do it with,
+ * so it only works while there is a single one.
+ */
+static int sr_driver_init_lazy(struct sr_dev_driver *driver)
+{
+	struct sr_context *ctx;
+
+	g_mutex_lock(&contexts_mutex);
+	ctx = (contexts && !contexts->next) ? contexts->data : NULL;
+	g_mutex_unlock(&contexts_mutex);
+
+	if (!ctx) {
+		sr_err("Several libsigrok contexts, initialize '%s' with "
+			"sr_driver_init().", driver->name);
+		return SR_ERR;
+	}
+
+	return sr_driver_init(ctx, driver);
+}
+
 /**
  * Enumerate scan options supported by this driver.
  *
@@ -483,8 +529,9 @@ static int check_options(struct sr_dev_driver *driver, GSList *options,
  * The order in which the system is scanned for devices is not specified. The
  * caller should not assume or rely on any specific order.
  *
- * Before calling sr_driver_scan(), the user must have previously initialized
- * the driver by calling sr_driver_init().
+ * If the driver wasn't initialized by sr_driver_init() before, this does it,
+ * provided there is a single libsigrok context. With several of them, the
+ * driver has to be initialized with sr_driver_init() first.
  *
  * @param driver The driver that should scan. This must be a pointer to one of
  *               the entries returned by sr_driver_list(). Must not be NULL.
@@ -507,7 +554,7 @@ SR_API GSList *sr_driver_scan(struct sr_dev_driver *driver, GSList *options)
 		return NULL;
 	}
 
-	if (!driver->context) {
+	if (!driver->context && sr_driver_init_lazy(driver) != SR_OK) {
 		sr_err("Driver not initialized, can't scan for devices.");
 		return NULL;
 	}
@@ -526,26 +573,51 @@ SR_API GSList *sr_driver_scan(struct sr_dev_driver *driver, GSList *options)
 }
 
 /**
- * Call driver cleanup function for all drivers.
+ * Register a new libsigrok context, for drivers initialized on first use.
  *
  * @param[in] ctx Pointer to a libsigrok context struct. Must not be NULL.
  *
  * @private
  */
-SR_PRIV void sr_hw_cleanup_all(const struct sr_context *ctx)
+SR_PRIV void sr_hw_context_add(struct sr_context *ctx)
 {
-	int i;
-	struct sr_dev_driver **drivers;
+	g_mutex_lock(&contexts_mutex);
+	contexts = g_slist_prepend(contexts, ctx);
+	g_mutex_unlock(&contexts_mutex);
+}
+
+/**
+ * Call driver cleanup function for all drivers initialized with a context,
+ * and unregister the context.
+ *
+ * Drivers which were never initialized, or which belong to another
+ * context, are left alone.
+ *
+ * @param[in] ctx Pointer to a libsigrok context struct. Must not be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_hw_cleanup_all(struct sr_context *ctx)
+{
+	struct sr_dev_driver *driver;
+	GSList *drivers, *l;
 
 	if (!ctx)
 		return;
 
-	drivers = sr_driver_list(ctx);
-	for (i = 0; drivers[i]; i++) {
-		if (drivers[i]->cleanup)
-			drivers[i]->cleanup(drivers[i]);
-		drivers[i]->context = NULL;
+	g_mutex_lock(&contexts_mutex);
+	contexts = g_slist_remove(contexts, ctx);
+	drivers = ctx->drivers;
+	ctx->drivers = NULL;
+	g_mutex_unlock(&contexts_mutex);
+
+	for (l = drivers; l; l = l->next) {
+		driver = l->data;
+		if (driver->cleanup)
+			driver->cleanup(driver);
+		driver->context = NULL;
 	}
+	g_slist_free(drivers);
 }
 
 /** Allocate struct sr_config.
@@ -756,6 +828,85 @@ SR_API int sr_config_set(const struct sr_dev_inst *sdi,
 	return ret;
 }
 
+/**
+ * Set several configuration keys of a device instance at once.
+ *
+ * All settings are checked before any of them is applied. Drivers which
+ * support it then apply them together, in the order the hardware needs
+ * and with as few transactions as possible. For all other drivers the
+ * settings are applied one by one in list order, as by sr_config_set().
+ *
+ * If applying fails halfway, some of the settings may have taken effect.
+ *
+ * @param[in] sdi The device instance.
+ * @param[in] entries List of struct sr_config_batch_entry. Floating
+ *        references in the entries' data are sunk and unreferenced
+ *        after use.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Error.
+ * @retval SR_ERR_ARG A key can't be set on the device or channel group,
+ *         or a value has the wrong type. Nothing was applied.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_config_set_batch(const struct sr_dev_inst *sdi,
+		GSList *entries)
+{
+	struct sr_config_batch_entry *entry;
+	GSList *l;
+	int ret;
+
+	for (l = entries; l; l = l->next) {
+		entry = l->data;
+		if (entry->data)
+			g_variant_ref_sink(entry->data);
+	}
+
+	if (!sdi || !sdi->driver)
+		ret = SR_ERR;
+	else if (!sdi->driver->config_set)
+		ret = SR_ERR_ARG;
+	else
+		ret = SR_OK;
+
+	for (l = entries; l && ret == SR_OK; l = l->next) {
+		entry = l->data;
+		if (!entry->data)
+			ret = SR_ERR;
+		else if (check_key(sdi->driver, sdi, entry->cg, entry->key,
+				SR_CONF_SET, entry->data) != SR_OK)
+			ret = SR_ERR_ARG;
+		else
+			ret = sr_variant_type_check(entry->key, entry->data);
+	}
+
+	if (ret == SR_OK) {
+		for (l = entries; l; l = l->next) {
+			entry = l->data;
+			log_key(sdi, entry->cg, entry->key, SR_CONF_SET,
+				entry->data);
+		}
+		if (sdi->driver->config_set_batch) {
+			ret = sdi->driver->config_set_batch(sdi, entries);
+		} else {
+			for (l = entries; l && ret == SR_OK; l = l->next) {
+				entry = l->data;
+				ret = sdi->driver->config_set(entry->key,
+					entry->data, sdi, entry->cg);
+			}
+		}
+	}
+
+	for (l = entries; l; l = l->next) {
+		entry = l->data;
+		if (entry->data)
+			g_variant_unref(entry->data);
+	}
+
+	return ret;
+}
+
 /**
  * Apply configuration settings to the device hardware.
  *
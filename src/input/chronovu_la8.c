@@ -38,14 +38,17 @@ struct context {
 	uint64_t samplerate;
 };
 
-static int format_match(GHashTable *metadata)
+static int format_match(GHashTable *metadata, unsigned int *confidence)
 {
 	int size;
 
 	size = GPOINTER_TO_INT(g_hash_table_lookup(metadata,
 			GINT_TO_POINTER(SR_INPUT_META_FILESIZE)));
-	if (size == CHRONOVU_LA8_FILESIZE)
+	if (size == CHRONOVU_LA8_FILESIZE) {
+		/* Other files may well have the same size. */
+		*confidence = SR_INPUT_CONFIDENCE_HINT;
 		return SR_OK;
+	}
 
 	return SR_ERR;
 }
@@ -308,6 +308,9 @@ SR_API struct sr_input *sr_input_new(const struct sr_input_module *imod,
 	return in;
 }
 
+/* Header size for modules which use the header, but don't specify a size. */
+#define DEFAULT_HEADER_SIZE 128
+
 /* Returns TRUE if all required meta items are available. */
 static gboolean check_required_metadata(const uint8_t *metadata, uint8_t *avail)
 {
@@ -330,6 +333,52 @@ static gboolean check_required_metadata(const uint8_t *metadata, uint8_t *avail)
 	return TRUE;
 }
 
+/* Returns the number of header bytes the module wants to see. */
+static size_t module_header_size(const struct sr_input_module *imod)
+{
+	unsigned int m;
+
+	if (imod->header_size)
+		return imod->header_size;
+
+	for (m = 0; m < sizeof(imod->metadata); m++) {
+		if ((imod->metadata[m] & ~SR_INPUT_META_REQUIRED) == SR_INPUT_META_HEADER)
+			return DEFAULT_HEADER_SIZE;
+	}
+
+	return 0;
+}
+
+/*
+ * Fill in the modules which can identify a stream, in the order they
+ * should be probed: those which need the least data first. These are
+ * usually the ones checking for a magic number.
+ */
+static void get_probe_order(const struct sr_input_module **order)
+{
+	const struct sr_input_module *imod;
+	unsigned int i, j, n;
+
+	n = 0;
+	for (i = 0; input_module_list[i]; i++) {
+		imod = input_module_list[i];
+		if (!imod->metadata[0]) {
+			/* Module has no metadata for matching so will take
+			 * any input. No point in letting it try to match. */
+			continue;
+		}
+		/* Insertion sort, keeping the list order for equal sizes. */
+		for (j = n; j > 0; j--) {
+			if (module_header_size(order[j - 1]) <= module_header_size(imod))
+				break;
+			order[j] = order[j - 1];
+		}
+		order[j] = imod;
+		n++;
+	}
+	order[n] = NULL;
+}
+
 /**
  * Try to find an input module that can parse the given buffer.
  *
@@ -349,9 +398,10 @@ static gboolean check_required_metadata(const uint8_t *metadata, uint8_t *avail)
  */
 SR_API int sr_input_scan_buffer(GString *buf, const struct sr_input **in)
 {
-	const struct sr_input_module *imod;
+	const struct sr_input_module *imod, *best_imod;
+	const struct sr_input_module *order[G_N_ELEMENTS(input_module_list)];
 	GHashTable *meta;
-	unsigned int m, i;
+	unsigned int m, i, confidence, best_confidence;
 	int ret;
 	uint8_t mitem, avail_metadata[8];
 
@@ -361,13 +411,11 @@ SR_API int sr_input_scan_buffer(GString *buf, const struct sr_input **in)
 
 	*in = NULL;
 	ret = SR_ERR;
-	for (i = 0; input_module_list[i]; i++) {
-		imod = input_module_list[i];
-		if (!imod->metadata[0]) {
-			/* Module has no metadata for matching so will take
-			 * any input. No point in letting it try to match. */
-			continue;
-		}
+	best_imod = NULL;
+	best_confidence = G_MAXUINT;
+	get_probe_order(order);
+	for (i = 0; order[i]; i++) {
+		imod = order[i];
 		if (!check_required_metadata(imod->metadata, avail_metadata))
 			/* Cannot satisfy this module's requirements. */
 			continue;
@@ -384,7 +432,8 @@ SR_API int sr_input_scan_buffer(GString *buf, const struct sr_input **in)
 			continue;
 		}
 		sr_spew("Trying module %s.", imod->id);
-		ret = imod->format_match(meta);
+		confidence = G_MAXUINT;
+		ret = imod->format_match(meta, &confidence);
 		g_hash_table_destroy(meta);
 		if (ret == SR_ERR_DATA) {
 			/* Module recognized this buffer, but cannot handle it. */
@@ -394,22 +443,60 @@ SR_API int sr_input_scan_buffer(GString *buf, const struct sr_input **in)
 			continue;
 		} else if (ret != SR_OK) {
 			/* Can be SR_ERR_NA. */
+			if (best_imod)
+				continue;
 			return ret;
 		}
 
-		/* Found a matching module. */
-		sr_spew("Module %s matched.", imod->id);
-		*in = sr_input_new(imod, NULL);
+		sr_spew("Module %s matched, confidence %u.", imod->id, confidence);
+		if (confidence < best_confidence) {
+			best_imod = imod;
+			best_confidence = confidence;
+		}
+		/* Nothing can beat a magic number match. */
+		if (confidence <= SR_INPUT_CONFIDENCE_MAGIC)
+			break;
+	}
+
+	if (best_imod) {
+		sr_spew("Using module %s.", best_imod->id);
+		*in = sr_input_new(best_imod, NULL);
 		g_string_insert_len((*in)->buf, 0, buf->str, buf->len);
-		break;
+		ret = SR_OK;
 	}
 
 	return ret;
 }
 
+/* Make sure the header holds at least 'size' bytes, if the file has them. */
+static int read_header(FILE *stream, GString *header, size_t size)
+{
+	size_t len, count;
+
+	len = header->len;
+	if (len >= size || feof(stream))
+		return SR_OK;
+
+	g_string_set_size(header, size);
+	count = fread(header->str + len, 1, size - len, stream);
+	if (count != size - len && ferror(stream)) {
+		g_string_set_size(header, len);
+		return SR_ERR;
+	}
+	g_string_set_size(header, len + count);
+
+	return SR_OK;
+}
+
 /**
  * Try to find an input module that can parse the given file.
  *
+ * The modules are probed in order of the amount of data they need to
+ * identify a file, and only as much of the file is read as the module
+ * which is probed next needs. Probing stops as soon as a module finds
+ * a signature or magic number. Otherwise the module with the highest
+ * confidence is used.
+ *
  * If an input module is found, an instance is created into *in.
  * Otherwise, *in contains NULL.
  *
@@ -418,11 +505,11 @@ SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in)
 {
 	int64_t filesize;
 	FILE *stream;
-	const struct sr_input_module *imod;
+	const struct sr_input_module *imod, *best_imod;
+	const struct sr_input_module *order[G_N_ELEMENTS(input_module_list)];
 	GHashTable *meta;
 	GString *header;
-	size_t count;
-	unsigned int midx, i;
+	unsigned int midx, i, confidence, best_confidence;
 	int ret;
 	uint8_t avail_metadata[8];
 
@@ -444,18 +531,7 @@ SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in)
 		fclose(stream);
 		return SR_ERR;
 	}
-	/* This actually allocates 256 bytes to allow for NUL termination. */
-	header = g_string_sized_new(255);
-	count = fread(header->str, 1, header->allocated_len - 1, stream);
-
-	if (count != header->allocated_len - 1 && ferror(stream)) {
-		sr_err("Failed to read %s: %s", filename, g_strerror(errno));
-		fclose(stream);
-		g_string_free(header, TRUE);
-		return SR_ERR;
-	}
-	fclose(stream);
-	g_string_set_size(header, count);
+	header = g_string_sized_new(DEFAULT_HEADER_SIZE);
 
 	meta = g_hash_table_new(NULL, NULL);
 	g_hash_table_insert(meta, GINT_TO_POINTER(SR_INPUT_META_FILENAME),
@@ -472,33 +548,51 @@ SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in)
 	/* TODO: MIME type */
 
 	ret = SR_ERR;
+	best_imod = NULL;
+	best_confidence = G_MAXUINT;
+	get_probe_order(order);
 
-	for (i = 0; input_module_list[i]; i++) {
-		imod = input_module_list[i];
-		if (!imod->metadata[0]) {
-			/* Module has no metadata for matching so will take
-			 * any input. No point in letting it try to match. */
-			continue;
-		}
+	for (i = 0; order[i]; i++) {
+		imod = order[i];
 		if (!check_required_metadata(imod->metadata, avail_metadata))
 			/* Cannot satisfy this module's requirements. */
 			continue;
 
+		if (read_header(stream, header, module_header_size(imod)) != SR_OK) {
+			sr_err("Failed to read %s: %s", filename, g_strerror(errno));
+			ret = SR_ERR;
+			best_imod = NULL;
+			break;
+		}
+
 		sr_dbg("Trying module %s.", imod->id);
 
-		ret = imod->format_match(meta);
-		if (ret == SR_ERR) {
-			/* Module didn't recognize this buffer. */
+		confidence = G_MAXUINT;
+		ret = imod->format_match(meta, &confidence);
+		if (ret == SR_ERR || ret == SR_ERR_NA) {
+			/* Module didn't recognize this file. */
 			continue;
 		} else if (ret != SR_OK) {
-			/* Module recognized this buffer, but cannot handle it. */
+			/* Module recognized this file, but cannot handle it. */
 			break;
 		}
-		/* Found a matching module. */
-		sr_dbg("Module %s matched.", imod->id);
 
-		*in = sr_input_new(imod, NULL);
-		break;
+		sr_dbg("Module %s matched, confidence %u.", imod->id, confidence);
+		if (confidence < best_confidence) {
+			best_imod = imod;
+			best_confidence = confidence;
+		}
+		/* Nothing can beat a magic number match. */
+		if (confidence <= SR_INPUT_CONFIDENCE_MAGIC)
+			break;
+	}
+	fclose(stream);
+
+	if (best_imod) {
+		sr_dbg("Using module %s, read %" G_GSIZE_FORMAT " bytes.",
+			best_imod->id, header->len);
+		*in = sr_input_new(best_imod, NULL);
+		ret = SR_OK;
 	}
 	g_hash_table_destroy(meta);
 	g_string_free(header, TRUE);
@@ -506,6 +600,22 @@ SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in)
 	return ret;
 }
 
+/**
+ * Return the input module of an input instance, e.g. one that was
+ * found by sr_input_scan_file().
+ *
+ * @since 0.5.0
+ */
+SR_API const struct sr_input_module *sr_input_module_get(const struct sr_input *in)
+{
+	if (!in) {
+		sr_err("Invalid input instance NULL!");
+		return NULL;
+	}
+
+	return in->module;
+}
+
 /**
  * Return the input instance's (virtual) device instance. This can be
  * used to find out the number of channels and other information.
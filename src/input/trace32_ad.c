@@ -150,13 +150,20 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int format_match(GHashTable *metadata)
+static int format_match(GHashTable *metadata, unsigned int *confidence)
 {
 	GString *buf;
+	int ret;
 
 	buf = g_hash_table_lookup(metadata, GINT_TO_POINTER(SR_INPUT_META_HEADER));
+	if (buf->len < 80)
+		return SR_ERR;
 
-	return process_header(buf, NULL);
+	ret = process_header(buf, NULL);
+	if (ret == SR_OK)
+		*confidence = SR_INPUT_CONFIDENCE_MAGIC;
+
+	return ret;
 }
 
 static int process_header(GString *buf, struct context *inc)
@@ -796,6 +803,7 @@ SR_PRIV struct sr_input_module input_trace32_ad = {
 	.exts = (const char*[]){"ad", NULL},
 	.options = get_options,
 	.metadata = { SR_INPUT_META_HEADER | SR_INPUT_META_REQUIRED },
+	.header_size = 80,
 	.format_match = format_match,
 	.init = init,
 	.receive = receive,
@@ -260,7 +260,7 @@ static gboolean parse_header(const struct sr_input *in, GString *buf)
 	return status;
 }
 
-static int format_match(GHashTable *metadata)
+static int format_match(GHashTable *metadata, unsigned int *confidence)
 {
 	GString *buf, *tmpbuf;
 	gboolean status;
@@ -278,7 +278,12 @@ static int format_match(GHashTable *metadata)
 	g_free(name);
 	g_free(contents);
 
-	return status ? SR_OK : SR_ERR;
+	if (!status)
+		return SR_ERR;
+
+	*confidence = SR_INPUT_CONFIDENCE_STRUCTURE;
+
+	return SR_OK;
 }
 
 /* Send all accumulated bytes from inc->buffer. */
@@ -638,6 +643,8 @@ SR_PRIV struct sr_input_module input_vcd = {
 	.desc = "Value Change Dump",
 	.exts = (const char*[]){"vcd", NULL},
 	.metadata = { SR_INPUT_META_HEADER | SR_INPUT_META_REQUIRED },
+	/* The first section, e.g. a $date or $comment, must fit. */
+	.header_size = 4096,
 	.options = get_options,
 	.format_match = format_match,
 	.init = init,
@@ -25,13 +25,18 @@
 #include <ctype.h>
 #include <string.h>
 #include <stdint.h>
+#include <math.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
 #define LOG_PREFIX "input/wav"
 
-/* How many bytes at a time to process and send to the session bus. */
-#define CHUNK_SIZE 4096
+/*
+ * How many bytes at a time to send to the session bus. Samples are passed
+ * on in their native encoding, so this is only limited by how much data
+ * frontends want to handle per packet.
+ */
+#define CHUNK_SIZE               (256 * 1024)
 
 /* Minimum size of header + 1 8-bit mono PCM sample. */
 #define MIN_DATA_CHUNK_OFFSET    45
@@ -51,6 +56,11 @@ struct context {
 	int num_channels;
 	int unitsize;
 	gboolean found_data;
+	/* Number of sample bytes left in the data chunk. */
+	uint64_t data_remaining;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
 };
 
 static int parse_wav_header(GString *buf, struct context *inc)
@@ -69,18 +79,13 @@ static int parse_wav_header(GString *buf, struct context *inc)
 	if (num_channels == 0)
 		return SR_ERR;
 	unitsize = samplesize / num_channels;
-	if (unitsize != 1 && unitsize != 2 && unitsize != 4) {
-		sr_err("Only 8, 16 or 32 bits per sample supported.");
+	if (unitsize == 0 || samplesize % num_channels) {
+		sr_err("Invalid block alignment %u for %u channels.",
+			samplesize, num_channels);
 		return SR_ERR_DATA;
 	}
 
-	if (fmt_code == WAVE_FORMAT_PCM_) {
-	} else if (fmt_code == WAVE_FORMAT_IEEE_FLOAT_) {
-		if (unitsize != 4) {
-			sr_err("only 32-bit floats supported.");
-			return SR_ERR_DATA;
-		}
-	} else if (fmt_code == WAVE_FORMAT_EXTENSIBLE_) {
+	if (fmt_code == WAVE_FORMAT_EXTENSIBLE_) {
 		if (buf->len < 70)
 			/* Not enough for extensible header and next chunk. */
 			return SR_ERR_NA;
@@ -93,18 +98,26 @@ static int parse_wav_header(GString *buf, struct context *inc)
 			sr_err("WAV extension must be 22 bytes.");
 			return SR_ERR;
 		}
-		if (RL16(buf->str + 34) != RL16(buf->str + 38)) {
-			sr_err("Reduced valid bits per sample not supported.");
+		/*
+		 * Samples with fewer valid bits than the container size are
+		 * left-aligned, so they can be treated like full-size ones.
+		 */
+		if (RL16(buf->str + 38) > RL16(buf->str + 34)) {
+			sr_err("Invalid number of valid bits per sample.");
 			return SR_ERR_DATA;
 		}
 		/* Real format code is the first two bytes of the GUID. */
 		fmt_code = RL16(buf->str + 44);
-		if (fmt_code != WAVE_FORMAT_PCM_ && fmt_code != WAVE_FORMAT_IEEE_FLOAT_) {
-			sr_err("Only PCM and floating point samples are supported.");
+	}
+
+	if (fmt_code == WAVE_FORMAT_PCM_) {
+		if (unitsize > 4) {
+			sr_err("Only 8, 16, 24 or 32 bits per sample supported.");
 			return SR_ERR_DATA;
 		}
-		if (fmt_code == WAVE_FORMAT_IEEE_FLOAT_ && unitsize != 4) {
-			sr_err("only 32-bit floats supported.");
+	} else if (fmt_code == WAVE_FORMAT_IEEE_FLOAT_) {
+		if (unitsize != sizeof(float) && unitsize != sizeof(double)) {
+			sr_err("Only 32-bit or 64-bit floats supported.");
 			return SR_ERR_DATA;
 		}
 	} else {
@@ -124,7 +137,7 @@ static int parse_wav_header(GString *buf, struct context *inc)
 	return SR_OK;
 }
 
-static int format_match(GHashTable *metadata)
+static int format_match(GHashTable *metadata, unsigned int *confidence)
 {
 	GString *buf;
 	int ret;
@@ -143,6 +156,8 @@ static int format_match(GHashTable *metadata)
 	if ((ret = parse_wav_header(buf, NULL)) != SR_OK)
 		return ret;
 
+	*confidence = SR_INPUT_CONFIDENCE_MAGIC;
+
 	return SR_OK;
 }
 
@@ -156,81 +171,87 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int find_data_chunk(GString *buf, int initial_offset)
+/*
+ * Returns the offset of the first sample, 0 if more data is needed to
+ * find it, or -1 if there's no data chunk where it's expected.
+ */
+static int find_data_chunk(GString *buf, int initial_offset, uint64_t *size)
 {
-	unsigned int offset, i;
+	uint64_t offset;
+	unsigned int i;
 
 	offset = initial_offset;
-	while (offset < MIN(MAX_DATA_CHUNK_OFFSET, buf->len)) {
-		if (!memcmp(buf->str + offset, "data", 4))
+	while (offset <= MAX_DATA_CHUNK_OFFSET && offset + 8 <= buf->len) {
+		if (!memcmp(buf->str + offset, "data", 4)) {
+			*size = RL32(buf->str + offset + 4);
 			/* Skip into the samples. */
 			return offset + 8;
+		}
 		for (i = 0; i < 4; i++) {
 			if (!isalnum(buf->str[offset + i])
 					&& !isblank(buf->str[offset + i]))
 				/* Doesn't look like a chunk ID. */
 				return -1;
 		}
-		/* Skip past this chunk. */
+		/* Skip past this chunk, including its pad byte. */
 		offset += 8 + RL32(buf->str + offset + 4);
+		offset += offset & 1;
 	}
 
 	if (offset > MAX_DATA_CHUNK_OFFSET)
 		return -1;
 
-	return offset;
+	return 0;
 }
 
-static void send_chunk(const struct sr_input *in, int offset, int num_samples)
+/* Describe how samples are stored, so they can be passed on as-is. */
+static void init_encoding(const struct sr_input *in)
 {
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog_old analog;
+	struct sr_datafeed_analog analog;
 	struct context *inc;
-	float fdata[CHUNK_SIZE];
-	int total_samples, samplenum;
-	char *s, *d;
+	uint64_t maxval;
+	int digits;
 
 	inc = in->priv;
 
-	s = in->buf->str + offset;
-	d = (char *)fdata;
-	memset(fdata, 0, CHUNK_SIZE);
-	total_samples = num_samples * inc->num_channels;
-	for (samplenum = 0; samplenum < total_samples; samplenum++) {
-		if (inc->fmt_code == WAVE_FORMAT_PCM_) {
-			switch (inc->unitsize) {
-			case 1:
-				/* 8-bit PCM samples are unsigned. */
-				fdata[samplenum] = *(uint8_t*)(s) / (float)255;
-				break;
-			case 2:
-				fdata[samplenum] = RL16S(s) / (float)INT16_MAX;
-				break;
-			case 4:
-				fdata[samplenum] = RL32S(s) / (float)INT32_MAX;
-				break;
-			}
-		} else {
-			/* BINARY32 float */
-#ifdef WORDS_BIGENDIAN
-			int i;
-			for (i = 0; i < inc->unitsize; i++)
-				d[i] = s[inc->unitsize - 1 - i];
-#else
-			memcpy(d, s, inc->unitsize);
-#endif
-		}
-		s += inc->unitsize;
-		d += inc->unitsize;
+	if (inc->fmt_code == WAVE_FORMAT_IEEE_FLOAT_) {
+		digits = inc->unitsize == sizeof(double) ? 15 : 7;
+		maxval = 1;
+	} else if (inc->unitsize == 1) {
+		/* 8-bit PCM samples are unsigned. */
+		maxval = UINT8_MAX;
+		digits = 3;
+	} else {
+		maxval = (UINT64_C(1) << (inc->unitsize * 8 - 1)) - 1;
+		digits = ceil(log10(maxval));
 	}
-	packet.type = SR_DF_ANALOG_OLD;
-	packet.payload = &analog;
-	analog.channels = in->sdi->channels;
+
+	sr_analog_init(&analog, &inc->encoding, &inc->meaning, &inc->spec,
+			digits);
+	inc->encoding.unitsize = inc->unitsize;
+	inc->encoding.is_float = inc->fmt_code == WAVE_FORMAT_IEEE_FLOAT_;
+	inc->encoding.is_signed = inc->encoding.is_float || inc->unitsize > 1;
+	/* WAV files are always little endian. */
+	inc->encoding.is_bigendian = FALSE;
+	sr_rational_set(&inc->encoding.scale, 1, maxval);
+	inc->meaning.channels = in->sdi->channels;
+}
+
+static void send_chunk(const struct sr_input *in, gsize offset, int num_samples)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct context *inc;
+
+	inc = in->priv;
+
+	analog.data = in->buf->str + offset;
 	analog.num_samples = num_samples;
-	analog.mq = 0;
-	analog.mqflags = 0;
-	analog.unit = 0;
-	analog.data = fdata;
+	analog.encoding = &inc->encoding;
+	analog.meaning = &inc->meaning;
+	analog.spec = &inc->spec;
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
 	sr_session_send(in->sdi, &packet);
 }
 
@@ -240,8 +261,9 @@ static int process_buffer(struct sr_input *in)
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
 	struct sr_config *src;
-	int offset, chunk_samples, total_samples, processed, max_chunk_samples;
-	int num_samples, i;
+	uint64_t size, avail, max_chunk, len;
+	gsize offset;
+	int ret;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -260,35 +282,40 @@ static int process_buffer(struct sr_input *in)
 
 	if (!inc->found_data) {
 		/* Skip past size of 'fmt ' chunk. */
-		i = 20 + RL32(in->buf->str + 16);
-		offset = find_data_chunk(in->buf, i);
-		if (offset < 0) {
-			if (in->buf->len > MAX_DATA_CHUNK_OFFSET) {
-				sr_err("Couldn't find data chunk.");
-				return SR_ERR;
-			}
+		ret = find_data_chunk(in->buf, 20 + RL32(in->buf->str + 16),
+				&size);
+		if (ret < 0) {
+			sr_err("Couldn't find data chunk.");
+			return SR_ERR;
 		}
+		if (ret == 0)
+			/* Not enough data yet. */
+			return SR_OK;
+		/* Streaming writers may leave the size unset. */
+		if (size == 0 || size == UINT32_MAX)
+			size = UINT64_MAX;
+		inc->data_remaining = size;
 		inc->found_data = TRUE;
+		offset = ret;
 	} else
 		offset = 0;
 
-	/* Round off up to the last channels * unitsize boundary. */
-	chunk_samples = (in->buf->len - offset) / inc->samplesize;
-	max_chunk_samples = CHUNK_SIZE / inc->samplesize;
-	processed = 0;
-	total_samples = chunk_samples;
-	while (processed < total_samples) {
-		if (chunk_samples > max_chunk_samples)
-			num_samples = max_chunk_samples;
-		else
-			num_samples = chunk_samples;
-		send_chunk(in, offset, num_samples);
-		offset += num_samples * inc->samplesize;
-		chunk_samples -= num_samples;
-		processed += num_samples;
+	/* Round off to the last channels * unitsize boundary. */
+	avail = MIN(in->buf->len - offset, inc->data_remaining);
+	avail -= avail % inc->samplesize;
+	max_chunk = CHUNK_SIZE - CHUNK_SIZE % inc->samplesize;
+	while (avail > 0) {
+		len = MIN(avail, max_chunk);
+		send_chunk(in, offset, len / inc->samplesize);
+		offset += len;
+		avail -= len;
+		inc->data_remaining -= len;
 	}
 
-	if ((unsigned int)offset < in->buf->len) {
+	if (inc->data_remaining < (uint64_t)inc->samplesize) {
+		/* Anything after the data chunk is of no interest. */
+		g_string_truncate(in->buf, 0);
+	} else if (offset < in->buf->len) {
 		/*
 		 * The incoming buffer wasn't processed completely. Stash
 		 * the leftover data for next time.
@@ -328,6 +355,7 @@ static int receive(struct sr_input *in, GString *buf)
 			snprintf(channelname, 8, "CH%d", i + 1);
 			sr_channel_new(in->sdi, i, SR_CHANNEL_ANALOG, TRUE, channelname);
 		}
+		init_encoding(in);
 
 		/* sdi is ready, notify frontend. */
 		in->sdi_ready = TRUE;
@@ -365,6 +393,8 @@ SR_PRIV struct sr_input_module input_wav = {
 	.desc = "WAV file",
 	.exts = (const char*[]){"wav", NULL},
 	.metadata = { SR_INPUT_META_HEADER | SR_INPUT_META_REQUIRED },
+	/* Enough for the extensible format chunk. */
+	.header_size = 70,
 	.format_match = format_match,
 	.init = init,
 	.receive = receive,
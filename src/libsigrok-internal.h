@@ -94,6 +94,38 @@ struct zip_stat;
                   (((unsigned)((const uint8_t*)(x))[1] <<  8) | \
                     (unsigned)((const uint8_t*)(x))[0]))
 
+/**
+ * Read a 24 bits big endian unsigned integer out of memory.
+ * @param x a pointer to the input memory
+ * @return the corresponding unsigned integer
+ */
+#define RB24(x)  (((unsigned)((const uint8_t*)(x))[0] << 16) | \
+                  ((unsigned)((const uint8_t*)(x))[1] <<  8) | \
+                   (unsigned)((const uint8_t*)(x))[2])
+
+/**
+ * Read a 24 bits little endian unsigned integer out of memory.
+ * @param x a pointer to the input memory
+ * @return the corresponding unsigned integer
+ */
+#define RL24(x)  (((unsigned)((const uint8_t*)(x))[2] << 16) | \
+                  ((unsigned)((const uint8_t*)(x))[1] <<  8) | \
+                   (unsigned)((const uint8_t*)(x))[0])
+
+/**
+ * Read a 24 bits big endian signed integer out of memory.
+ * @param x a pointer to the input memory
+ * @return the corresponding signed integer
+ */
+#define RB24S(x)  ((int32_t)(RB24(x) << 8) >> 8)
+
+/**
+ * Read a 24 bits little endian signed integer out of memory.
+ * @param x a pointer to the input memory
+ * @return the corresponding signed integer
+ */
+#define RL24S(x)  ((int32_t)(RL24(x) << 8) >> 8)
+
 /**
  * Read a 32 bits big endian unsigned integer out of memory.
  * @param x a pointer to the input memory
@@ -193,6 +225,20 @@ struct zip_stat;
  */
 #define RLFL(x)  ((union { uint32_t u; float f; }) { .u = RL32(x) }.f)
 
+/**
+ * Read a 64 bits big endian double out of memory.
+ * @param x a pointer to the input memory
+ * @return the corresponding double
+ */
+#define RBDBL(x)  ((union { uint64_t u; double d; }) { .u = RB64(x) }.d)
+
+/**
+ * Read a 64 bits little endian double out of memory.
+ * @param x a pointer to the input memory
+ * @return the corresponding double
+ */
+#define RLDBL(x)  ((union { uint64_t u; double d; }) { .u = RL64(x) }.d)
+
 /**
  * Write a 8 bits unsigned integer to memory.
  * @param p a pointer to the output memory
@@ -271,11 +317,14 @@ struct sr_context {
 	struct sr_dev_driver **driver_list;
 #ifdef HAVE_LIBUSB_1_0
 	libusb_context *libusb_ctx;
+	struct sr_hotplug *hotplug;
 #endif
 	sr_resource_open_callback resource_open_cb;
 	sr_resource_close_callback resource_close_cb;
 	sr_resource_read_callback resource_read_cb;
 	void *resource_cb_data;
+	/* The drivers initialized with this context, for sr_exit(). */
+	GSList *drivers;
 };
 
 /** Input module metadata keys. */
@@ -284,13 +333,26 @@ enum sr_input_meta_keys {
 	SR_INPUT_META_FILENAME = 0x01,
 	/** The input file's size in bytes. */
 	SR_INPUT_META_FILESIZE = 0x02,
-	/** The first 128 bytes of the file, provided as a GString. */
+	/**
+	 * The start of the file, provided as a GString. Holds at least
+	 * the module's header_size bytes, unless the file is shorter.
+	 */
 	SR_INPUT_META_HEADER = 0x04,
 
 	/** The module cannot identify a file without this metadata. */
 	SR_INPUT_META_REQUIRED = 0x80,
 };
 
+/** Confidence levels reported by input modules' format_match(). */
+enum {
+	/** A signature or magic number matched, no need to probe further. */
+	SR_INPUT_CONFIDENCE_MAGIC = 1,
+	/** The stream's structure could be parsed. */
+	SR_INPUT_CONFIDENCE_STRUCTURE = 10,
+	/** A weak hint matched, e.g. the file size. */
+	SR_INPUT_CONFIDENCE_HINT = 100,
+};
+
 /** Input (file) module struct. */
 struct sr_input {
 	/**
@@ -347,6 +409,14 @@ struct sr_input_module {
 	 */
 	const uint8_t metadata[8];
 
+	/**
+	 * Maximum number of bytes from the start of the stream this module
+	 * needs in SR_INPUT_META_HEADER to identify it. Modules which need
+	 * fewer bytes are probed first. If 0, the module does not look at
+	 * the header at all.
+	 */
+	const size_t header_size;
+
 	/**
 	 * Returns a NULL-terminated list of options this module can take.
 	 * Can be NULL, if the module has no options.
@@ -357,6 +427,9 @@ struct sr_input_module {
 	 * Check if this input module can load and parse the specified stream.
 	 *
 	 * @param[in] metadata Metadata the module can use to identify the stream.
+	 * @param[out] confidence How sure the module is about the match, if
+	 *   SR_OK is returned. SR_INPUT_CONFIDENCE_MAGIC is the best value,
+	 *   larger values mean less confidence.
 	 *
 	 * @retval SR_OK This module knows the format.
 	 * @retval SR_ERR_NA There wasn't enough data for this module to
@@ -366,7 +439,7 @@ struct sr_input_module {
 	 *   that the module does not support.
 	 * @retval SR_ERR This module does not know the format.
 	 */
-	int (*format_match) (GHashTable *metadata);
+	int (*format_match) (GHashTable *metadata, unsigned int *confidence);
 
 	/**
 	 * Initialize the input module.
@@ -752,7 +825,8 @@ extern SR_PRIV struct sr_dev_driver **drivers_lists[];
 
 SR_PRIV const GVariantType *sr_variant_type_get(int datatype);
 SR_PRIV int sr_variant_type_check(uint32_t key, GVariant *data);
-SR_PRIV void sr_hw_cleanup_all(const struct sr_context *ctx);
+SR_PRIV void sr_hw_context_add(struct sr_context *ctx);
+SR_PRIV void sr_hw_cleanup_all(struct sr_context *ctx);
 SR_PRIV struct sr_config *sr_config_new(uint32_t key, GVariant *data);
 SR_PRIV void sr_config_free(struct sr_config *src);
 
@@ -788,6 +862,9 @@ struct sr_session {
 	unsigned int stop_check_id;
 	/** Whether the session has been started. */
 	gboolean running;
+
+	/** Flight recorder state, or NULL if not in flight recorder mode. */
+	struct flight_recorder *recorder;
 };
 
 SR_PRIV int sr_session_source_add_internal(struct sr_session *session,
@@ -834,6 +911,31 @@ SR_PRIV void sr_zip_discard(struct zip *archive);
 SR_PRIV GKeyFile *sr_sessionfile_read_metadata(struct zip *archive,
 			const struct zip_stat *entry);
 
+/* Newest session file version understood. */
+#define SR_SESSIONFILE_VERSION_MAX 3
+
+/*
+ * Logic chunks stored as transition lists (see output/srzip.c) are named
+ * like raw ones, plus this suffix. They need session file version 3.
+ */
+#define SR_SESSIONFILE_EDGES_SUFFIX ".edges"
+
+/*
+ * Metadata keys with the number of logic samples, and of samples per
+ * analog channel, written at the end of the capture. Older files don't
+ * have them. Readers take keys starting with "probe" or "analog" for
+ * channel names, so these mustn't.
+ */
+#define SR_SESSIONFILE_LOGIC_SAMPLES "total logic samples"
+#define SR_SESSIONFILE_ANALOG_SAMPLES "total analog samples"
+
+/*
+ * Prefix of the metadata key with the decimal digits of analog channel N,
+ * numbered as in "analogN". Written at the end of the capture, for the
+ * channels that had any.
+ */
+#define SR_SESSIONFILE_ANALOG_DIGITS "digits"
+
 /*--- analog.c --------------------------------------------------------------*/
 
 SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
@@ -841,6 +943,8 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
                            struct sr_analog_meaning *meaning,
                            struct sr_analog_spec *spec,
                            int digits);
+SR_PRIV gboolean sr_analog_plane_owns_encoding(
+		const struct sr_datafeed_analog_planar *planar, uint32_t idx);
 
 /*--- std.c -----------------------------------------------------------------*/
 
@@ -857,6 +961,10 @@ SR_PRIV int std_serial_dev_acquisition_stop(struct sr_dev_inst *sdi,
 #endif
 SR_PRIV int std_session_send_df_header(const struct sr_dev_inst *sdi,
 		const char *prefix);
+SR_PRIV int std_session_send_df_gap(const struct sr_dev_inst *sdi,
+		uint64_t start, uint64_t length);
+SR_PRIV GSList *std_config_batch_sort(GSList *entries,
+		const uint32_t *keys, unsigned int num_keys);
 SR_PRIV int std_dev_clear(const struct sr_dev_driver *driver,
 		std_dev_clear_callback clear_private);
 SR_PRIV int std_serial_dev_close(struct sr_dev_inst *sdi);
@@ -887,17 +995,36 @@ SR_PRIV int sr_atof_ascii(const char *str, float *ret);
 
 /*--- soft-trigger.c --------------------------------------------------------*/
 
+struct soft_trigger_stage;
+struct soft_trigger_decoder;
+struct soft_trigger_run;
+struct soft_trigger_runt;
+struct soft_trigger_check;
+
 struct soft_trigger_logic {
 	const struct sr_dev_inst *sdi;
 	const struct sr_trigger *trigger;
-	int count;
 	int unitsize;
 	int cur_stage;
+	/* The last sample of the previous buffer. */
 	uint8_t *prev_sample;
 	uint8_t *pre_trigger_buffer;
 	uint8_t *pre_trigger_head;
 	int pre_trigger_size;
 	int pre_trigger_fill;
+	/* Number of samples in the buffers checked before the current one. */
+	uint64_t buf_pos;
+	/* Number of samples fed to the decoders and run counters. */
+	uint64_t num_seen;
+	int num_stages;
+	struct soft_trigger_stage *stages;
+	int num_decoders;
+	struct soft_trigger_decoder *decoders;
+	int num_runs;
+	struct soft_trigger_run *runs;
+	/* The matches reading the decoders and run counters. */
+	int num_held;
+	struct soft_trigger_check **held;
 };
 
 SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
@@ -907,6 +1034,36 @@ SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *st);
 SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *st, uint8_t *buf,
 		int len, int *pre_trigger_samples);
 
+struct soft_trigger_analog {
+	const struct sr_dev_inst *sdi;
+	const struct sr_trigger *trigger;
+	int cur_stage;
+	int num_stages;
+	struct soft_trigger_stage *stages;
+	/* The last sample of each channel in the previous buffer. */
+	int num_channels;
+	float *prev;
+	/* Number of samples in the buffers checked before the current one. */
+	uint64_t buf_pos;
+	/* Number of samples fed to the runt trackers. */
+	uint64_t num_seen;
+	int num_runts;
+	struct soft_trigger_runt *runts;
+	/* The matches reading the runt trackers. */
+	int num_held;
+	struct soft_trigger_check **held;
+	/* Samples the caller keeps to send before the trigger. */
+	int pre_trigger_samples;
+};
+
+SR_PRIV struct soft_trigger_analog *soft_trigger_analog_new(
+		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
+		int pre_trigger_samples);
+SR_PRIV void soft_trigger_analog_free(struct soft_trigger_analog *sta);
+SR_PRIV int soft_trigger_analog_check(struct soft_trigger_analog *sta,
+		const float *const *data, int num_samples,
+		int *pre_trigger_samples);
+
 /*--- hardware/serial.c -----------------------------------------------------*/
 
 #ifdef HAVE_LIBSERIALPORT
@@ -971,6 +1128,8 @@ SR_PRIV int usb_source_add(struct sr_session *session, struct sr_context *ctx,
 		int timeout, sr_receive_data_callback cb, void *cb_data);
 SR_PRIV int usb_source_remove(struct sr_session *session, struct sr_context *ctx);
 SR_PRIV int usb_get_port_path(libusb_device *dev, char *path, int path_len);
+SR_PRIV GSList *usb_id_append(GSList *ids, uint16_t vid, uint16_t pid,
+		const char *manufacturer, const char *product);
 #endif
 
 
@@ -980,6 +1139,8 @@ struct sr_modbus_dev_inst {
 	const char *name;
 	const char *prefix;
 	int priv_size;
+	/* Requests the transport can have awaiting replies at once. */
+	int max_requests;
 	GSList *(*scan)(int modbusaddr);
 	int (*dev_inst_new)(void *priv, const char *resource,
 		char **params, const char *serialcomm, int modbusaddr);
@@ -991,6 +1152,7 @@ struct sr_modbus_dev_inst {
 	int (*read_begin)(void *priv, uint8_t *function_code);
 	int (*read_data)(void *priv, uint8_t *buf, int maxlen);
 	int (*read_end)(void *priv);
+	int (*reply_ready)(void *priv);
 	int (*close)(void *priv);
 	void (*free)(void *priv);
 	unsigned int read_timeout_ms;
@@ -1014,6 +1176,8 @@ SR_PRIV int sr_modbus_reply(struct sr_modbus_dev_inst *modbus,
 SR_PRIV int sr_modbus_request_reply(struct sr_modbus_dev_inst *modbus,
                                     uint8_t *request, int request_size,
                                     uint8_t *reply, int reply_size);
+SR_PRIV int sr_modbus_reply_ready(struct sr_modbus_dev_inst *modbus);
+SR_PRIV int sr_modbus_max_requests(const struct sr_modbus_dev_inst *modbus);
 SR_PRIV int sr_modbus_read_coils(struct sr_modbus_dev_inst *modbus,
                                  int address, int nb_coils, uint8_t *coils);
 SR_PRIV int sr_modbus_read_holding_registers(struct sr_modbus_dev_inst *modbus,
@@ -1052,25 +1216,25 @@ struct es519xx_info {
 
 SR_PRIV gboolean sr_es519xx_2400_11b_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_es519xx_2400_11b_parse(const uint8_t *buf, float *floatval,
-		struct sr_datafeed_analog_old *analog, void *info);
+		struct sr_datafeed_analog *analog, void *info);
 SR_PRIV gboolean sr_es519xx_2400_11b_altfn_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_es519xx_2400_11b_altfn_parse(const uint8_t *buf,
-		float *floatval, struct sr_datafeed_analog_old *analog, void *info);
+		float *floatval, struct sr_datafeed_analog *analog, void *info);
 SR_PRIV gboolean sr_es519xx_19200_11b_5digits_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_es519xx_19200_11b_5digits_parse(const uint8_t *buf,
-		float *floatval, struct sr_datafeed_analog_old *analog, void *info);
+		float *floatval, struct sr_datafeed_analog *analog, void *info);
 SR_PRIV gboolean sr_es519xx_19200_11b_clamp_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_es519xx_19200_11b_clamp_parse(const uint8_t *buf,
-		float *floatval, struct sr_datafeed_analog_old *analog, void *info);
+		float *floatval, struct sr_datafeed_analog *analog, void *info);
 SR_PRIV gboolean sr_es519xx_19200_11b_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_es519xx_19200_11b_parse(const uint8_t *buf, float *floatval,
-		struct sr_datafeed_analog_old *analog, void *info);
+		struct sr_datafeed_analog *analog, void *info);
 SR_PRIV gboolean sr_es519xx_19200_14b_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_es519xx_19200_14b_parse(const uint8_t *buf, float *floatval,
-		struct sr_datafeed_analog_old *analog, void *info);
+		struct sr_datafeed_analog *analog, void *info);
 SR_PRIV gboolean sr_es519xx_19200_14b_sel_lpf_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_es519xx_19200_14b_sel_lpf_parse(const uint8_t *buf,
-		float *floatval, struct sr_datafeed_analog_old *analog, void *info);
+		float *floatval, struct sr_datafeed_analog *analog, void *info);
 
 /*--- hardware/dmm/fs9922.c -------------------------------------------------*/
 
@@ -1087,8 +1251,8 @@ struct fs9922_info {
 
 SR_PRIV gboolean sr_fs9922_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_fs9922_parse(const uint8_t *buf, float *floatval,
-			    struct sr_datafeed_analog_old *analog, void *info);
-SR_PRIV void sr_fs9922_z1_diode(struct sr_datafeed_analog_old *analog, void *info);
+			    struct sr_datafeed_analog *analog, void *info);
+SR_PRIV void sr_fs9922_z1_diode(struct sr_datafeed_analog *analog, void *info);
 
 /*--- hardware/dmm/fs9721.c -------------------------------------------------*/
 
@@ -1103,12 +1267,12 @@ struct fs9721_info {
 
 SR_PRIV gboolean sr_fs9721_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_fs9721_parse(const uint8_t *buf, float *floatval,
-			    struct sr_datafeed_analog_old *analog, void *info);
-SR_PRIV void sr_fs9721_00_temp_c(struct sr_datafeed_analog_old *analog, void *info);
-SR_PRIV void sr_fs9721_01_temp_c(struct sr_datafeed_analog_old *analog, void *info);
-SR_PRIV void sr_fs9721_10_temp_c(struct sr_datafeed_analog_old *analog, void *info);
-SR_PRIV void sr_fs9721_01_10_temp_f_c(struct sr_datafeed_analog_old *analog, void *info);
-SR_PRIV void sr_fs9721_max_c_min(struct sr_datafeed_analog_old *analog, void *info);
+			    struct sr_datafeed_analog *analog, void *info);
+SR_PRIV void sr_fs9721_00_temp_c(struct sr_datafeed_analog *analog, void *info);
+SR_PRIV void sr_fs9721_01_temp_c(struct sr_datafeed_analog *analog, void *info);
+SR_PRIV void sr_fs9721_10_temp_c(struct sr_datafeed_analog *analog, void *info);
+SR_PRIV void sr_fs9721_01_10_temp_f_c(struct sr_datafeed_analog *analog, void *info);
+SR_PRIV void sr_fs9721_max_c_min(struct sr_datafeed_analog *analog, void *info);
 
 /*--- hardware/dmm/dtm0660.c ------------------------------------------------*/
 
@@ -1124,7 +1288,7 @@ struct dtm0660_info {
 
 SR_PRIV gboolean sr_dtm0660_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_dtm0660_parse(const uint8_t *buf, float *floatval,
-			struct sr_datafeed_analog_old *analog, void *info);
+			struct sr_datafeed_analog *analog, void *info);
 
 /*--- hardware/dmm/m2110.c --------------------------------------------------*/
 
@@ -1132,7 +1296,7 @@ SR_PRIV int sr_dtm0660_parse(const uint8_t *buf, float *floatval,
 
 SR_PRIV gboolean sr_m2110_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_m2110_parse(const uint8_t *buf, float *floatval,
-			     struct sr_datafeed_analog_old *analog, void *info);
+			     struct sr_datafeed_analog *analog, void *info);
 
 /*--- hardware/dmm/metex14.c ------------------------------------------------*/
 
@@ -1151,7 +1315,7 @@ SR_PRIV int sr_metex14_packet_request(struct sr_serial_dev_inst *serial);
 #endif
 SR_PRIV gboolean sr_metex14_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_metex14_parse(const uint8_t *buf, float *floatval,
-			     struct sr_datafeed_analog_old *analog, void *info);
+			     struct sr_datafeed_analog *analog, void *info);
 
 /*--- hardware/dmm/rs9lcd.c -------------------------------------------------*/
 
@@ -1162,7 +1326,7 @@ struct rs9lcd_info { int dummy; };
 
 SR_PRIV gboolean sr_rs9lcd_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_rs9lcd_parse(const uint8_t *buf, float *floatval,
-			    struct sr_datafeed_analog_old *analog, void *info);
+			    struct sr_datafeed_analog *analog, void *info);
 
 /*--- hardware/dmm/bm25x.c --------------------------------------------------*/
 
@@ -1173,7 +1337,7 @@ struct bm25x_info { int dummy; };
 
 SR_PRIV gboolean sr_brymen_bm25x_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_brymen_bm25x_parse(const uint8_t *buf, float *floatval,
-			     struct sr_datafeed_analog_old *analog, void *info);
+			     struct sr_datafeed_analog *analog, void *info);
 
 /*--- hardware/dmm/ut71x.c --------------------------------------------------*/
 
@@ -1188,7 +1352,7 @@ struct ut71x_info {
 
 SR_PRIV gboolean sr_ut71x_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_ut71x_parse(const uint8_t *buf, float *floatval,
-		struct sr_datafeed_analog_old *analog, void *info);
+		struct sr_datafeed_analog *analog, void *info);
 
 /*--- hardware/dmm/vc870.c --------------------------------------------------*/
 
@@ -1209,7 +1373,7 @@ struct vc870_info {
 
 SR_PRIV gboolean sr_vc870_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_vc870_parse(const uint8_t *buf, float *floatval,
-		struct sr_datafeed_analog_old *analog, void *info);
+		struct sr_datafeed_analog *analog, void *info);
 
 /*--- hardware/lcr/es51919.c ------------------------------------------------*/
 
@@ -1241,7 +1405,7 @@ struct ut372_info {
 
 SR_PRIV gboolean sr_ut372_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_ut372_parse(const uint8_t *buf, float *floatval,
-		struct sr_datafeed_analog_old *analog, void *info);
+		struct sr_datafeed_analog *analog, void *info);
 
 /*--- hardware/scale/kern.c -------------------------------------------------*/
 
@@ -1254,6 +1418,6 @@ struct kern_info {
 
 SR_PRIV gboolean sr_kern_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_kern_parse(const uint8_t *buf, float *floatval,
-		struct sr_datafeed_analog_old *analog, void *info);
+		struct sr_datafeed_analog *analog, void *info);
 
 #endif
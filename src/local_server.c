@@ -0,0 +1,909 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ *
+ * Serve devices to other processes on the same machine.
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#ifdef HAVE_HW_REMOTE_LOCAL
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "hardware/remote-local/protocol.h"
+#endif
+
+#undef LOG_PREFIX
+#define LOG_PREFIX "local-server"
+
+/**
+ * @defgroup grp_local_server Local server
+ *
+ * Serve devices to other processes on the same machine.
+ *
+ * A local server owns a set of devices and makes them available over an
+ * AF_UNIX socket. Other processes use them through the "remote-local"
+ * driver, by scanning with SR_CONF_CONN set to the socket path. They can
+ * get, set and list the configuration of the devices, and subscribe to
+ * their datafeed. All clients that start an acquisition on the same device
+ * share one session: the first one starts it, later ones join it, and it
+ * is stopped when the last one leaves.
+ *
+ * A minimal capture daemon is:
+ *
+ * @code{.c}
+ * sr_local_server_new(ctx, "/run/sigrok/local.sock", &server);
+ * for (l = devices; l; l = l->next)
+ *         sr_local_server_dev_add(server, l->data);
+ * sr_local_server_run(server);
+ * sr_local_server_free(server);
+ * @endcode
+ *
+ * This is only available on systems with AF_UNIX sockets, and if libsigrok
+ * was built with the remote-local driver.
+ *
+ * @{
+ */
+
+#ifdef HAVE_HW_REMOTE_LOCAL
+
+/* Drop clients that fall further behind than this many messages. */
+#define CLIENT_MAX_QUEUED 128
+
+/* Maximum number of requests to handle per wakeup of a client. */
+#define CLIENT_MAX_REQUESTS 16
+
+struct server_dev;
+
+struct server_client {
+	struct sr_local_server *server;
+	int fd;
+	GSource *source;
+	/* Messages the socket didn't take yet, and the watch sending them. */
+	GQueue *queue;
+	GSource *out_source;
+	/* Set if the client fell too far behind, or its socket failed. */
+	gboolean failed;
+	/* The device whose datafeed this client is subscribed to. */
+	struct server_dev *dev;
+};
+
+struct server_dev {
+	struct sr_local_server *server;
+	struct sr_dev_inst *sdi;
+	struct sr_session *session;
+	/* Clients receiving the datafeed, in order of subscription. */
+	GSList *subscribers;
+	/* The header of the running acquisition, for clients joining it. */
+	struct sr_datafeed_header header;
+	gboolean have_header;
+	/* The latest value of each key sent in an SR_DF_META, likewise. */
+	GSList *meta_config;
+	/* Set once the running acquisition has sent its SR_DF_END. */
+	gboolean ended;
+};
+
+struct sr_local_server {
+	struct sr_context *ctx;
+	char *path;
+	int listen_fd;
+	GMainContext *main_context;
+	GMainLoop *main_loop;
+	GSource *listen_source;
+	/* Devices, indexed by their position in this array. */
+	GPtrArray *devs;
+	GSList *clients;
+};
+
+static void client_free(struct server_client *client)
+{
+	struct sr_local_server *server;
+
+	server = client->server;
+	server->clients = g_slist_remove(server->clients, client);
+	g_source_destroy(client->source);
+	g_source_unref(client->source);
+	if (client->out_source) {
+		g_source_destroy(client->out_source);
+		g_source_unref(client->out_source);
+	}
+	g_queue_free_full(client->queue, (GDestroyNotify)rl_msg_free);
+	close(client->fd);
+	g_free(client);
+}
+
+/* Send as many queued messages as the socket takes. */
+static int client_flush(struct server_client *client)
+{
+	struct rl_msg *msg;
+	int ret;
+
+	while ((msg = g_queue_peek_head(client->queue))) {
+		if ((ret = rl_msg_send(client->fd, msg)) == SR_ERR_TIMEOUT)
+			break;
+		if (ret != SR_OK)
+			return ret;
+		rl_msg_free(g_queue_pop_head(client->queue));
+	}
+
+	return SR_OK;
+}
+
+static void client_drop(struct server_client *client);
+
+static gboolean client_writable(GIOChannel *source, GIOCondition condition,
+		gpointer user_data)
+{
+	struct server_client *client;
+
+	(void)source;
+	(void)condition;
+
+	client = user_data;
+
+	if (client_flush(client) != SR_OK) {
+		client_drop(client);
+		return G_SOURCE_REMOVE;
+	}
+	if (!g_queue_is_empty(client->queue))
+		return G_SOURCE_CONTINUE;
+
+	g_source_unref(client->out_source);
+	client->out_source = NULL;
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Copy a message for the queue, with its own reference to any memfd. */
+static struct rl_msg *msg_copy(const struct rl_msg *msg)
+{
+	struct rl_msg *copy;
+
+	copy = rl_msg_new(msg->type);
+	g_byte_array_append(copy->body, msg->body->data, msg->body->len);
+	if (msg->fd >= 0 && (copy->fd = fcntl(msg->fd, F_DUPFD_CLOEXEC, 0)) < 0) {
+		sr_err("Failed to duplicate fd: %s.", g_strerror(errno));
+		rl_msg_free(copy);
+		return NULL;
+	}
+
+	return copy;
+}
+
+/*
+ * Send a message without blocking the server. What the socket doesn't
+ * take right away is queued, and sent once the client catches up. A
+ * client that falls too far behind is marked as failed, for the caller
+ * to drop.
+ */
+static int client_send(struct server_client *client, const struct rl_msg *msg)
+{
+	GIOChannel *channel;
+	struct rl_msg *copy;
+	int ret;
+
+	if (client->failed)
+		return SR_ERR_IO;
+
+	if (g_queue_is_empty(client->queue)) {
+		ret = rl_msg_send(client->fd, msg);
+		if (ret == SR_OK)
+			return SR_OK;
+		if (ret != SR_ERR_TIMEOUT) {
+			client->failed = TRUE;
+			return ret;
+		}
+	}
+
+	if (g_queue_get_length(client->queue) >= CLIENT_MAX_QUEUED) {
+		sr_warn("Client on fd %d is too slow.", client->fd);
+		client->failed = TRUE;
+		return SR_ERR_IO;
+	}
+	if (!(copy = msg_copy(msg))) {
+		client->failed = TRUE;
+		return SR_ERR_IO;
+	}
+	g_queue_push_tail(client->queue, copy);
+
+	if (!client->out_source) {
+		channel = g_io_channel_unix_new(client->fd);
+		client->out_source = g_io_create_watch(channel, G_IO_OUT);
+		g_io_channel_unref(channel);
+		g_source_set_callback(client->out_source,
+				(GSourceFunc)client_writable, client, NULL);
+		g_source_attach(client->out_source,
+				client->server->main_context);
+	}
+
+	return SR_OK;
+}
+
+static int client_send_packet(struct server_client *client,
+		const struct sr_datafeed_packet *packet)
+{
+	GSList *msgs, *l;
+	int ret;
+
+	ret = SR_OK;
+	msgs = rl_packet_encode(packet);
+	for (l = msgs; l && ret == SR_OK; l = l->next)
+		ret = client_send(client, l->data);
+	g_slist_free_full(msgs, (GDestroyNotify)rl_msg_free);
+
+	return ret;
+}
+
+/* Take a client off the datafeed, stopping the acquisition if it was the last. */
+static void unsubscribe(struct server_client *client, gboolean send_end)
+{
+	struct server_dev *dev;
+	struct sr_datafeed_packet packet;
+
+	if (!(dev = client->dev))
+		return;
+
+	dev->subscribers = g_slist_remove(dev->subscribers, client);
+	client->dev = NULL;
+
+	if (send_end) {
+		packet.type = SR_DF_END;
+		packet.payload = NULL;
+		client_send_packet(client, &packet);
+	}
+
+	if (!dev->subscribers && !dev->ended) {
+		sr_dbg("Last client left, stopping acquisition.");
+		sr_session_stop(dev->session);
+	}
+}
+
+static void client_drop(struct server_client *client)
+{
+	sr_dbg("Dropping client on fd %d.", client->fd);
+	unsubscribe(client, FALSE);
+	client_free(client);
+}
+
+/* Remember the latest value of each key, to replay it to joining clients. */
+static void meta_cache(struct server_dev *dev,
+		const struct sr_datafeed_meta *meta)
+{
+	struct sr_config *src, *cached;
+	GSList *l, *c;
+
+	for (l = meta->config; l; l = l->next) {
+		src = l->data;
+		for (c = dev->meta_config; c; c = c->next) {
+			cached = c->data;
+			if (cached->key == src->key)
+				break;
+		}
+		if (c) {
+			g_variant_unref(cached->data);
+			cached->data = g_variant_ref(src->data);
+		} else {
+			dev->meta_config = g_slist_append(dev->meta_config,
+					sr_config_new(src->key, src->data));
+		}
+	}
+}
+
+static void meta_clear(struct server_dev *dev)
+{
+	g_slist_free_full(dev->meta_config, (GDestroyNotify)sr_config_free);
+	dev->meta_config = NULL;
+}
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct server_dev *dev;
+	struct server_client *client;
+	GSList *msgs, *m, *l, *failed;
+
+	(void)sdi;
+
+	dev = cb_data;
+
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		dev->header = *(const struct sr_datafeed_header *)packet->payload;
+		dev->have_header = TRUE;
+		dev->ended = FALSE;
+		meta_clear(dev);
+		break;
+	case SR_DF_META:
+		meta_cache(dev, packet->payload);
+		break;
+	case SR_DF_END:
+		dev->ended = TRUE;
+		break;
+	}
+
+	/* Encode once, then hand the same messages (and memfds) to all. */
+	msgs = rl_packet_encode(packet);
+	failed = NULL;
+	for (l = dev->subscribers; l; l = l->next) {
+		client = l->data;
+		for (m = msgs; m; m = m->next) {
+			if (client_send(client, m->data) != SR_OK) {
+				failed = g_slist_append(failed, client);
+				break;
+			}
+		}
+	}
+	g_slist_free_full(msgs, (GDestroyNotify)rl_msg_free);
+
+	for (l = failed; l; l = l->next)
+		client_drop(l->data);
+	g_slist_free(failed);
+
+	if (packet->type == SR_DF_END) {
+		/* The feed is over; the clients close their connections. */
+		for (l = dev->subscribers; l; l = l->next) {
+			client = l->data;
+			client->dev = NULL;
+		}
+		g_slist_free(dev->subscribers);
+		dev->subscribers = NULL;
+		dev->have_header = FALSE;
+		meta_clear(dev);
+	}
+}
+
+static void session_stopped(void *cb_data)
+{
+	struct server_dev *dev;
+
+	dev = cb_data;
+	sr_dbg("Acquisition on %s device stopped.", dev->sdi->driver->name);
+}
+
+static void send_reply(struct server_client *client, int status,
+		GVariant *data)
+{
+	struct rl_msg *reply;
+
+	reply = rl_msg_new(RL_MSG_REPLY);
+	rl_put_u32(reply, status);
+	rl_put_u8(reply, data != NULL);
+	if (data)
+		rl_put_variant(reply, data);
+	client_send(client, reply);
+	rl_msg_free(reply);
+}
+
+static GVariant *dev_list_variant(struct sr_local_server *server)
+{
+	struct server_dev *dev;
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ch;
+	struct sr_channel_group *cg;
+	GVariantBuilder gvb, gvb_ch, gvb_cg, gvb_idx;
+	GSList *l, *c;
+	guint i;
+
+	g_variant_builder_init(&gvb, G_VARIANT_TYPE("a(ssssa(iibs)a(sai))"));
+	for (i = 0; i < server->devs->len; i++) {
+		dev = g_ptr_array_index(server->devs, i);
+		sdi = dev->sdi;
+		g_variant_builder_init(&gvb_ch, G_VARIANT_TYPE("a(iibs)"));
+		for (l = sdi->channels; l; l = l->next) {
+			ch = l->data;
+			g_variant_builder_add(&gvb_ch, "(iibs)", ch->index,
+					ch->type, ch->enabled, ch->name);
+		}
+		g_variant_builder_init(&gvb_cg, G_VARIANT_TYPE("a(sai)"));
+		for (l = sdi->channel_groups; l; l = l->next) {
+			cg = l->data;
+			g_variant_builder_init(&gvb_idx, G_VARIANT_TYPE("ai"));
+			for (c = cg->channels; c; c = c->next) {
+				ch = c->data;
+				g_variant_builder_add(&gvb_idx, "i", ch->index);
+			}
+			g_variant_builder_add(&gvb_cg, "(sai)", cg->name, &gvb_idx);
+		}
+		g_variant_builder_add(&gvb, "(ssssa(iibs)a(sai))",
+				sdi->vendor ? sdi->vendor : "",
+				sdi->model ? sdi->model : "",
+				sdi->version ? sdi->version : "",
+				sdi->serial_num ? sdi->serial_num : "",
+				&gvb_ch, &gvb_cg);
+	}
+
+	return g_variant_ref_sink(g_variant_builder_end(&gvb));
+}
+
+/* Look up the device a request is about. */
+static int request_dev(struct sr_local_server *server, struct rl_msg *req,
+		struct server_dev **dev)
+{
+	uint32_t index;
+
+	index = rl_get_u32(req);
+	if (index >= server->devs->len) {
+		sr_err("Request for unknown device %u.", index);
+		return SR_ERR_ARG;
+	}
+	*dev = g_ptr_array_index(server->devs, index);
+
+	return SR_OK;
+}
+
+/* Look up the channel group a request is about, if any. */
+static int request_cg(struct server_dev *dev, struct rl_msg *req,
+		struct sr_channel_group **cg)
+{
+	struct sr_channel_group *g;
+	char *cg_name;
+	GSList *l;
+
+	*cg = NULL;
+	if (!(cg_name = rl_get_str(req)))
+		return SR_OK;
+	for (l = dev->sdi->channel_groups; l; l = l->next) {
+		g = l->data;
+		if (!strcmp(g->name, cg_name))
+			*cg = g;
+	}
+	if (!*cg)
+		sr_err("Request for unknown channel group '%s'.", cg_name);
+	g_free(cg_name);
+
+	return *cg ? SR_OK : SR_ERR_ARG;
+}
+
+static void handle_start(struct server_client *client, struct rl_msg *req)
+{
+	struct server_dev *dev;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_channel *ch;
+	GSList *l;
+	uint32_t num_channels, i;
+	int ret;
+
+	if (client->dev) {
+		send_reply(client, SR_ERR, NULL);
+		return;
+	}
+	if ((ret = request_dev(client->server, req, &dev)) != SR_OK) {
+		send_reply(client, ret, NULL);
+		return;
+	}
+	num_channels = rl_get_u32(req);
+
+	if (!sr_session_is_running(dev->session)) {
+		/* The first client decides which channels are enabled. */
+		l = dev->sdi->channels;
+		for (i = 0; i < num_channels && l; i++, l = l->next) {
+			ch = l->data;
+			sr_dev_channel_enable(ch, rl_get_u8(req));
+		}
+		if ((ret = sr_session_start(dev->session)) != SR_OK) {
+			send_reply(client, ret, NULL);
+			return;
+		}
+	} else if (dev->ended) {
+		/* Still winding down, can't be joined or restarted yet. */
+		send_reply(client, SR_ERR, NULL);
+		return;
+	}
+
+	send_reply(client, SR_OK, NULL);
+
+	client->dev = dev;
+	dev->subscribers = g_slist_append(dev->subscribers, client);
+	if (dev->have_header) {
+		packet.type = SR_DF_HEADER;
+		packet.payload = &dev->header;
+		client_send_packet(client, &packet);
+	}
+	if (dev->meta_config) {
+		/* Bring the client up to date on what changed since. */
+		meta.config = dev->meta_config;
+		packet.type = SR_DF_META;
+		packet.payload = &meta;
+		client_send_packet(client, &packet);
+	}
+}
+
+static void handle_request(struct server_client *client, struct rl_msg *req)
+{
+	struct sr_local_server *server;
+	struct server_dev *dev;
+	struct sr_channel_group *cg;
+	GVariant *data, *value;
+	uint32_t key;
+	int ret;
+
+	server = client->server;
+	data = NULL;
+
+	switch (req->type) {
+	case RL_MSG_HELLO:
+		ret = rl_get_u32(req) == RL_PROTOCOL_VERSION ? SR_OK : SR_ERR_NA;
+		send_reply(client, ret, NULL);
+		break;
+	case RL_MSG_DEV_LIST:
+		data = dev_list_variant(server);
+		send_reply(client, SR_OK, data);
+		break;
+	case RL_MSG_CONFIG_GET:
+	case RL_MSG_CONFIG_SET:
+	case RL_MSG_CONFIG_LIST:
+		if ((ret = request_dev(server, req, &dev)) == SR_OK) {
+			key = rl_get_u32(req);
+			ret = request_cg(dev, req, &cg);
+		}
+		if (ret != SR_OK) {
+			send_reply(client, ret, NULL);
+			break;
+		}
+		if (req->type == RL_MSG_CONFIG_GET) {
+			ret = sr_config_get(dev->sdi->driver, dev->sdi, cg, key, &data);
+		} else if (req->type == RL_MSG_CONFIG_LIST) {
+			ret = sr_config_list(dev->sdi->driver, dev->sdi, cg, key, &data);
+		} else if (!(value = rl_get_variant(req))) {
+			ret = SR_ERR_ARG;
+		} else {
+			ret = sr_config_set(dev->sdi, cg, key, value);
+		}
+		send_reply(client, ret, ret == SR_OK ? data : NULL);
+		break;
+	case RL_MSG_START:
+		handle_start(client, req);
+		break;
+	case RL_MSG_STOP:
+		unsubscribe(client, TRUE);
+		break;
+	default:
+		sr_err("Unknown request of type %u.", req->type);
+		send_reply(client, SR_ERR_ARG, NULL);
+		break;
+	}
+
+	if (data)
+		g_variant_unref(data);
+}
+
+static gboolean client_receive(GIOChannel *source, GIOCondition condition,
+		gpointer user_data)
+{
+	struct server_client *client;
+	struct rl_msg *req;
+	int i;
+
+	(void)source;
+	(void)condition;
+
+	client = user_data;
+
+	for (i = 0; i < CLIENT_MAX_REQUESTS; i++) {
+		if (rl_msg_recv(client->fd, 0, &req) != SR_OK) {
+			client_drop(client);
+			return G_SOURCE_REMOVE;
+		}
+		if (!req)
+			break;
+		if (req->truncated)
+			sr_err("Truncated request of type %u.", req->type);
+		handle_request(client, req);
+		rl_msg_free(req);
+		if (client->failed) {
+			client_drop(client);
+			return G_SOURCE_REMOVE;
+		}
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+static gboolean client_accept(GIOChannel *source, GIOCondition condition,
+		gpointer user_data)
+{
+	struct sr_local_server *server;
+	struct server_client *client;
+	GIOChannel *channel;
+	int fd;
+
+	(void)source;
+	(void)condition;
+
+	server = user_data;
+
+	if ((fd = accept(server->listen_fd, NULL, NULL)) < 0) {
+		sr_err("Failed to accept client: %s.", g_strerror(errno));
+		return G_SOURCE_CONTINUE;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	/* All clients share one main loop, none may block it. */
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	client = g_malloc0(sizeof(struct server_client));
+	client->server = server;
+	client->fd = fd;
+	client->queue = g_queue_new();
+
+	channel = g_io_channel_unix_new(fd);
+	client->source = g_io_create_watch(channel, G_IO_IN | G_IO_HUP | G_IO_ERR);
+	g_io_channel_unref(channel);
+	g_source_set_callback(client->source, (GSourceFunc)client_receive,
+			client, NULL);
+	g_source_attach(client->source, server->main_context);
+
+	server->clients = g_slist_append(server->clients, client);
+	sr_dbg("New client on fd %d.", fd);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void server_dev_free(struct server_dev *dev)
+{
+	if (sr_session_is_running(dev->session) == TRUE)
+		sr_err("Device %s still acquiring on server shutdown.",
+				dev->sdi->connection_id);
+	sr_session_destroy(dev->session);
+	sr_dev_close(dev->sdi);
+	g_slist_free(dev->subscribers);
+	meta_clear(dev);
+	g_free(dev);
+}
+
+#endif
+
+/**
+ * Create a local server.
+ *
+ * @param ctx The libsigrok context. Must not be NULL.
+ * @param path The path of the socket to listen on. An existing socket
+ *             at this path is replaced. Must not be NULL.
+ * @param server Set to the new server. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_IO The socket could not be set up.
+ * @retval SR_ERR_NA Local servers aren't supported on this system.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_local_server_new(struct sr_context *ctx, const char *path,
+		struct sr_local_server **server)
+{
+#ifdef HAVE_HW_REMOTE_LOCAL
+	struct sr_local_server *s;
+	GIOChannel *channel;
+	int fd;
+
+	if (!ctx || !path || !server)
+		return SR_ERR_ARG;
+
+	if ((fd = rl_socket_listen(path)) < 0)
+		return SR_ERR_IO;
+
+	s = g_malloc0(sizeof(struct sr_local_server));
+	s->ctx = ctx;
+	s->path = g_strdup(path);
+	s->listen_fd = fd;
+	s->main_context = g_main_context_new();
+	s->devs = g_ptr_array_new_with_free_func((GDestroyNotify)server_dev_free);
+
+	channel = g_io_channel_unix_new(fd);
+	s->listen_source = g_io_create_watch(channel, G_IO_IN);
+	g_io_channel_unref(channel);
+	g_source_set_callback(s->listen_source, (GSourceFunc)client_accept,
+			s, NULL);
+	g_source_attach(s->listen_source, s->main_context);
+
+	sr_info("Listening on %s.", path);
+	*server = s;
+
+	return SR_OK;
+#else
+	(void)ctx;
+	(void)path;
+	(void)server;
+
+	sr_err("Local servers are not supported on this system.");
+
+	return SR_ERR_NA;
+#endif
+}
+
+/**
+ * Serve a device.
+ *
+ * The device is opened, and stays open until the server is freed. It
+ * must not be used in any other session meanwhile.
+ *
+ * @param server The server. Must not be NULL.
+ * @param sdi The device to serve. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR The device could not be opened.
+ * @retval SR_ERR_NA Local servers aren't supported on this system.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_local_server_dev_add(struct sr_local_server *server,
+		struct sr_dev_inst *sdi)
+{
+#ifdef HAVE_HW_REMOTE_LOCAL
+	struct server_dev *dev;
+	int ret;
+
+	if (!server || !sdi || !sdi->driver)
+		return SR_ERR_ARG;
+
+	if ((ret = sr_dev_open(sdi)) != SR_OK) {
+		sr_err("Failed to open %s device.", sdi->driver->name);
+		return ret;
+	}
+
+	dev = g_malloc0(sizeof(struct server_dev));
+	dev->server = server;
+	dev->sdi = sdi;
+	sr_session_new(server->ctx, &dev->session);
+	sr_session_dev_add(dev->session, sdi);
+	sr_session_datafeed_callback_add(dev->session, datafeed_in, dev);
+	sr_session_stopped_callback_set(dev->session, session_stopped, dev);
+	g_ptr_array_add(server->devs, dev);
+
+	return SR_OK;
+#else
+	(void)server;
+	(void)sdi;
+
+	return SR_ERR_NA;
+#endif
+}
+
+/**
+ * Run a local server.
+ *
+ * This serves clients and runs the acquisitions they start, until
+ * sr_local_server_stop() is called. It uses its own GLib main context,
+ * which is made the thread-default context meanwhile.
+ *
+ * @param server The server. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR The server is already running.
+ * @retval SR_ERR_NA Local servers aren't supported on this system.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_local_server_run(struct sr_local_server *server)
+{
+#ifdef HAVE_HW_REMOTE_LOCAL
+	if (!server)
+		return SR_ERR_ARG;
+	if (server->main_loop) {
+		sr_err("Server is already running.");
+		return SR_ERR;
+	}
+
+	server->main_loop = g_main_loop_new(server->main_context, FALSE);
+	g_main_context_push_thread_default(server->main_context);
+	g_main_loop_run(server->main_loop);
+	g_main_context_pop_thread_default(server->main_context);
+	g_main_loop_unref(server->main_loop);
+	server->main_loop = NULL;
+
+	return SR_OK;
+#else
+	(void)server;
+
+	return SR_ERR_NA;
+#endif
+}
+
+#ifdef HAVE_HW_REMOTE_LOCAL
+static gboolean server_stop_sync(gpointer user_data)
+{
+	struct sr_local_server *server;
+
+	server = user_data;
+	if (server->main_loop)
+		g_main_loop_quit(server->main_loop);
+
+	return G_SOURCE_REMOVE;
+}
+#endif
+
+/**
+ * Stop a running local server.
+ *
+ * This makes sr_local_server_run() return. It may be called from
+ * another thread.
+ *
+ * @param server The server. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA Local servers aren't supported on this system.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_local_server_stop(struct sr_local_server *server)
+{
+#ifdef HAVE_HW_REMOTE_LOCAL
+	if (!server)
+		return SR_ERR_ARG;
+
+	g_main_context_invoke(server->main_context, server_stop_sync, server);
+
+	return SR_OK;
+#else
+	(void)server;
+
+	return SR_ERR_NA;
+#endif
+}
+
+/**
+ * Free a local server.
+ *
+ * All clients are disconnected, the devices are closed and the socket
+ * is removed. The server must not be running.
+ *
+ * @param server The server. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA Local servers aren't supported on this system.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_local_server_free(struct sr_local_server *server)
+{
+#ifdef HAVE_HW_REMOTE_LOCAL
+	if (!server)
+		return SR_ERR_ARG;
+
+	while (server->clients)
+		client_free(server->clients->data);
+	g_ptr_array_free(server->devs, TRUE);
+
+	g_source_destroy(server->listen_source);
+	g_source_unref(server->listen_source);
+	close(server->listen_fd);
+	unlink(server->path);
+	g_main_context_unref(server->main_context);
+	g_free(server->path);
+	g_free(server);
+
+	return SR_OK;
+#else
+	(void)server;
+
+	return SR_ERR_NA;
+#endif
+}
+
+/** @} */
@@ -25,9 +25,11 @@
 
 #define LOG_PREFIX "modbus"
 
+SR_PRIV extern const struct sr_modbus_dev_inst modbus_tcp_dev;
 SR_PRIV extern const struct sr_modbus_dev_inst modbus_serial_rtu_dev;
 
 static const struct sr_modbus_dev_inst *modbus_devs[] = {
+	&modbus_tcp_dev,
 #ifdef HAVE_LIBSERIALPORT
 	&modbus_serial_rtu_dev,  /* Must be last as it matches any resource. */
 #endif
@@ -312,6 +314,39 @@ SR_PRIV int sr_modbus_request_reply(struct sr_modbus_dev_inst *modbus,
 	return sr_modbus_reply(modbus, reply, reply_size);
 }
 
+/**
+ * Check whether the reply to the oldest outstanding request has arrived.
+ *
+ * This doesn't block, so it can be called from an event source callback,
+ * before sr_modbus_reply() reads the reply.
+ *
+ * @param modbus Previously initialized Modbus device structure.
+ *
+ * @return TRUE if the reply can be read without waiting, FALSE if it
+ *         hasn't fully arrived yet, or a negative error code on failure.
+ */
+SR_PRIV int sr_modbus_reply_ready(struct sr_modbus_dev_inst *modbus)
+{
+	if (!modbus->reply_ready)
+		return TRUE;
+
+	return modbus->reply_ready(modbus->priv);
+}
+
+/**
+ * Get the number of requests that can be awaiting replies at once.
+ *
+ * Replies are always read in the order the requests were sent in.
+ *
+ * @param modbus Previously initialized Modbus device structure.
+ *
+ * @return The number of requests, at least 1.
+ */
+SR_PRIV int sr_modbus_max_requests(const struct sr_modbus_dev_inst *modbus)
+{
+	return MAX(modbus->max_requests, 1);
+}
+
 enum {
 	MODBUS_READ_COILS = 0x01,
 	MODBUS_READ_HOLDING_REGISTERS = 0x03,
@@ -26,12 +26,57 @@
 
 #define LOG_PREFIX "modbus_serial"
 
-#define BUFFER_SIZE 1024
+/* Address, PDU and CRC. */
+#define FRAME_SIZE 256
+/* The most data a reply can carry, with address, function, count and CRC. */
+#define MAX_BYTE_COUNT (FRAME_SIZE - 6)
+
+#define READ_TIMEOUT_MS 1000
 
 struct modbus_serial_rtu {
 	struct sr_serial_dev_inst *serial;
 	uint8_t slave_addr;
-	uint16_t crc;
+	/* The reply being received, address and CRC included. */
+	uint8_t frame[FRAME_SIZE];
+	int frame_len;
+	/* Where read_data() continues in a complete frame. */
+	int read_pos;
+};
+
+/* CRC-16/MODBUS, reflected polynomial 0xA001. */
+static const uint16_t crc_table[256] = {
+	0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+	0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+	0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+	0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+	0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+	0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+	0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+	0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+	0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+	0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+	0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+	0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+	0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+	0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+	0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+	0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+	0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+	0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+	0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+	0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+	0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+	0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+	0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+	0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+	0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+	0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+	0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+	0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+	0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+	0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+	0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+	0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040,
 };
 
 static int modbus_serial_rtu_dev_inst_new(void *priv, const char *resource,
@@ -58,6 +103,8 @@ static int modbus_serial_rtu_open(void *priv)
 	if (serial_flush(serial) != SR_OK)
 		return SR_ERR;
 
+	modbus->frame_len = 0;
+
 	return SR_OK;
 }
 
@@ -82,20 +129,11 @@ static int modbus_serial_rtu_source_remove(struct sr_session *session,
 static uint16_t modbus_serial_rtu_crc(uint16_t crc,
 		const uint8_t *buffer, int len)
 {
-	int i;
-
 	if (!buffer || len < 0)
 		return crc;
 
-	while (len--) {
-		crc ^= *buffer++;
-		for (i = 0; i < 8; i++) {
-			int carry = crc & 1;
-			crc >>= 1;
-			if (carry)
-				crc ^= 0xA001;
-		}
-	}
+	while (len--)
+		crc = (crc >> 8) ^ crc_table[(crc ^ *buffer++) & 0xFF];
 
 	return crc;
 }
@@ -103,46 +141,153 @@ static uint16_t modbus_serial_rtu_crc(uint16_t crc,
 static int modbus_serial_rtu_send(void *priv,
 		const uint8_t *buffer, int buffer_size)
 {
-	int result;
+	int result, len;
 	struct modbus_serial_rtu *modbus = priv;
-	struct sr_serial_dev_inst *serial = modbus->serial;
-	uint8_t slave_addr = modbus->slave_addr;
+	uint8_t frame[FRAME_SIZE];
 	uint16_t crc;
 
-	result = serial_write_nonblocking(serial, &slave_addr, sizeof(slave_addr));
-	if (result < 0)
-		return result;
+	if (buffer_size > FRAME_SIZE - 3)
+		return SR_ERR_ARG;
 
-	result = serial_write_nonblocking(serial, buffer, buffer_size);
-	if (result < 0)
-		return result;
+	/* Assemble the frame, so it goes out without gaps in between. */
+	W8(frame, modbus->slave_addr);
+	memcpy(frame + 1, buffer, buffer_size);
+	len = 1 + buffer_size;
+	crc = modbus_serial_rtu_crc(0xFFFF, frame, len);
+	WL16(frame + len, crc);
+	len += 2;
 
-	crc = modbus_serial_rtu_crc(0xFFFF, &slave_addr, sizeof(slave_addr));
-	crc = modbus_serial_rtu_crc(crc, buffer, buffer_size);
-
-	result = serial_write_nonblocking(serial, &crc, sizeof(crc));
+	result = serial_write_blocking(modbus->serial, frame, len,
+			READ_TIMEOUT_MS);
 	if (result < 0)
 		return result;
+	if (result < len) {
+		sr_err("Only sent %d/%d bytes of Modbus frame.", result, len);
+		return SR_ERR;
+	}
 
 	return SR_OK;
 }
 
+/*
+ * Bytes still missing from the frame being received: up to where its
+ * length is known, or else to its end. -1 for an unknown function, or
+ * a byte count which doesn't fit in a frame.
+ */
+static int modbus_serial_rtu_missing(const struct modbus_serial_rtu *modbus)
+{
+	const uint8_t *frame = modbus->frame;
+	int len = modbus->frame_len;
+
+	/* Address and function code. */
+	if (len < 2)
+		return 2 - len;
+
+	if (frame[1] & 0x80)
+		return 5 - len;
+
+	switch (frame[1]) {
+	case 0x01:
+	case 0x02:
+	case 0x03:
+	case 0x04:
+		/* Byte count, data, CRC. */
+		if (len < 3)
+			return 3 - len;
+		if (frame[2] > MAX_BYTE_COUNT)
+			return -1;
+		return 3 + frame[2] + 2 - len;
+	case 0x05:
+	case 0x06:
+	case 0x0F:
+	case 0x10:
+		/* Address and value or quantity, CRC. */
+		return 8 - len;
+	default:
+		return -1;
+	}
+}
+
+/*
+ * Receive the rest of the frame, as far as it has arrived, or within
+ * timeout_ms if that's not 0. Bytes that can't start a reply from our
+ * slave are skipped, so a garbled frame doesn't throw off the next.
+ *
+ * Returns TRUE once the frame is complete, FALSE if it isn't yet.
+ */
+static int modbus_serial_rtu_receive(struct modbus_serial_rtu *modbus,
+		unsigned int timeout_ms)
+{
+	gint64 deadline;
+	int missing, ret, skip;
+	unsigned int remaining;
+
+	deadline = g_get_monotonic_time() + timeout_ms * 1000;
+
+	while ((missing = modbus_serial_rtu_missing(modbus))) {
+		if (missing < 0) {
+			/* Drop the frame, as for a CRC error. */
+			if (modbus->frame_len >= 3)
+				sr_err("Invalid byte count %d in reply.",
+					modbus->frame[2]);
+			else
+				sr_err("Unsupported function code 0x%02X in reply.",
+					modbus->frame[1]);
+			modbus->frame_len = 0;
+			return SR_ERR_DATA;
+		}
+		if (!timeout_ms) {
+			ret = serial_read_nonblocking(modbus->serial,
+					modbus->frame + modbus->frame_len, missing);
+		} else {
+			remaining = MAX(deadline - g_get_monotonic_time(), 0) / 1000;
+			if (!remaining)
+				return FALSE;
+			ret = serial_read_blocking(modbus->serial,
+					modbus->frame + modbus->frame_len, missing,
+					remaining);
+		}
+		if (ret < 0)
+			return ret;
+		if (ret == 0 && !timeout_ms)
+			return FALSE;
+		modbus->frame_len += ret;
+
+		for (skip = 0; skip < modbus->frame_len; skip++)
+			if (modbus->frame[skip] == modbus->slave_addr)
+				break;
+		if (skip) {
+			sr_dbg("Skipping %d bytes before the reply.", skip);
+			modbus->frame_len -= skip;
+			memmove(modbus->frame, modbus->frame + skip,
+				modbus->frame_len);
+		}
+	}
+
+	return TRUE;
+}
+
+static int modbus_serial_rtu_reply_ready(void *priv)
+{
+	return modbus_serial_rtu_receive(priv, 0);
+}
+
 static int modbus_serial_rtu_read_begin(void *priv, uint8_t *function_code)
 {
 	struct modbus_serial_rtu *modbus = priv;
-	uint8_t slave_addr;
 	int ret;
 
-	ret = serial_read_blocking(modbus->serial, &slave_addr, 1, 100);
-	if (ret != 1 || slave_addr != modbus->slave_addr)
-		return ret;
-
-	ret = serial_read_blocking(modbus->serial, function_code, 1, 100);
-	if (ret != 1)
+	ret = modbus_serial_rtu_receive(modbus, READ_TIMEOUT_MS);
+	if (ret < 0)
 		return ret;
+	if (!ret) {
+		sr_err("Timed out waiting for Modbus reply.");
+		modbus->frame_len = 0;
+		return SR_ERR_TIMEOUT;
+	}
 
-	modbus->crc = modbus_serial_rtu_crc(0xFFFF, &slave_addr, sizeof(slave_addr));
-	modbus->crc = modbus_serial_rtu_crc(modbus->crc, function_code, 1);
+	*function_code = modbus->frame[1];
+	modbus->read_pos = 2;
 
 	return SR_OK;
 }
@@ -150,27 +295,31 @@ static int modbus_serial_rtu_read_begin(void *priv, uint8_t *function_code)
 static int modbus_serial_rtu_read_data(void *priv, uint8_t *buf, int maxlen)
 {
 	struct modbus_serial_rtu *modbus = priv;
-	int ret;
+	int len;
 
-	ret = serial_read_nonblocking(modbus->serial, buf, maxlen); 
-	if (ret < 0)
-		return ret;
-	modbus->crc = modbus_serial_rtu_crc(modbus->crc, buf, ret); 
-	return ret; 
+	/* The reply is already complete, up to its CRC. */
+	len = MIN(maxlen, modbus->frame_len - 2 - modbus->read_pos);
+	if (len <= 0)
+		return SR_ERR_DATA;
+	memcpy(buf, modbus->frame + modbus->read_pos, len);
+	modbus->read_pos += len;
+
+	return len;
 }
 
 static int modbus_serial_rtu_read_end(void *priv)
 {
 	struct modbus_serial_rtu *modbus = priv;
-	uint16_t crc;
-	int ret;
+	uint16_t crc, frame_crc;
+	int len;
 
-	ret = serial_read_blocking(modbus->serial, &crc, sizeof(crc), 100);
-	if (ret != 2)
-		return ret;
+	len = modbus->frame_len - 2;
+	crc = modbus_serial_rtu_crc(0xFFFF, modbus->frame, len);
+	frame_crc = RL16(modbus->frame + len);
+	modbus->frame_len = 0;
 
-	if (crc != modbus->crc) {
-		sr_err("CRC error (0x%04X vs 0x%04X).", crc, modbus->crc);
+	if (crc != frame_crc) {
+		sr_err("CRC error (0x%04X vs 0x%04X).", frame_crc, crc);
 		return SR_ERR_DATA;
 	}
 
@@ -195,6 +344,7 @@ SR_PRIV const struct sr_modbus_dev_inst modbus_serial_rtu_dev = {
 	.name          = "serial_rtu",
 	.prefix        = "",
 	.priv_size     = sizeof(struct modbus_serial_rtu),
+	.max_requests  = 1,
 	.scan          = NULL,
 	.dev_inst_new  = modbus_serial_rtu_dev_inst_new,
 	.open          = modbus_serial_rtu_open,
@@ -204,6 +354,7 @@ SR_PRIV const struct sr_modbus_dev_inst modbus_serial_rtu_dev = {
 	.read_begin    = modbus_serial_rtu_read_begin,
 	.read_data     = modbus_serial_rtu_read_data,
 	.read_end      = modbus_serial_rtu_read_end,
+	.reply_ready   = modbus_serial_rtu_reply_ready,
 	.close         = modbus_serial_rtu_close,
 	.free          = modbus_serial_rtu_free,
 };
@@ -0,0 +1,403 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#ifdef _WIN32
+#define _WIN32_WINNT 0x0501
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#endif
+#include <glib.h>
+#include <string.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#endif
+#include <errno.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "modbus_tcp"
+
+#define DEFAULT_PORT "502"
+
+/*
+ * The MBAP header: transaction ID, protocol ID (always 0), length of
+ * the rest of the frame, unit ID.
+ */
+#define HEADER_SIZE 7
+#define FRAME_SIZE (HEADER_SIZE + 253)
+
+#define READ_TIMEOUT_MS 1000
+
+/*
+ * Most gateways handle a few transactions at once; the spec suggests
+ * servers accept at least 16 per connection.
+ */
+#define MAX_REQUESTS 8
+
+struct modbus_tcp {
+	char *address;
+	char *port;
+	int socket;
+	uint8_t unit_id;
+	uint16_t next_tid;
+	/* Transaction IDs of the requests awaiting replies, oldest first. */
+	GQueue pending;
+	/* Replies that arrived before the ones to older requests. */
+	GSList *early;
+	/* The frame being received. */
+	uint8_t rx[FRAME_SIZE];
+	int rx_len;
+	/* The reply being read, and where read_data() continues in it. */
+	uint8_t *reply;
+	int read_pos;
+};
+
+static int modbus_tcp_dev_inst_new(void *priv, const char *resource,
+		char **params, const char *serialcomm, int modbusaddr)
+{
+	struct modbus_tcp *tcp = priv;
+
+	(void)resource;
+	(void)serialcomm;
+
+	if (!params || !params[1]) {
+		sr_err("Invalid parameters.");
+		return SR_ERR;
+	}
+
+	tcp->address = g_strdup(params[1]);
+	tcp->port    = g_strdup(params[2] ? params[2] : DEFAULT_PORT);
+	tcp->socket  = -1;
+	tcp->unit_id = modbusaddr;
+	g_queue_init(&tcp->pending);
+
+	return SR_OK;
+}
+
+static int modbus_tcp_open(void *priv)
+{
+	struct modbus_tcp *tcp = priv;
+	struct addrinfo hints;
+	struct addrinfo *results, *res;
+	int err;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	err = getaddrinfo(tcp->address, tcp->port, &hints, &results);
+
+	if (err) {
+		sr_err("Address lookup failed: %s:%s: %s", tcp->address, tcp->port,
+			gai_strerror(err));
+		return SR_ERR;
+	}
+
+	for (res = results; res; res = res->ai_next) {
+		if ((tcp->socket = socket(res->ai_family, res->ai_socktype,
+						res->ai_protocol)) < 0)
+			continue;
+		if (connect(tcp->socket, res->ai_addr, res->ai_addrlen) != 0) {
+			close(tcp->socket);
+			tcp->socket = -1;
+			continue;
+		}
+		break;
+	}
+
+	freeaddrinfo(results);
+
+	if (tcp->socket < 0) {
+		sr_err("Failed to connect to %s:%s: %s", tcp->address, tcp->port,
+				g_strerror(errno));
+		return SR_ERR;
+	}
+
+	tcp->rx_len = 0;
+
+	return SR_OK;
+}
+
+static int modbus_tcp_source_add(struct sr_session *session, void *priv,
+		int events, int timeout, sr_receive_data_callback cb, void *cb_data)
+{
+	struct modbus_tcp *tcp = priv;
+
+	return sr_session_source_add(session, tcp->socket, events, timeout,
+			cb, cb_data);
+}
+
+static int modbus_tcp_source_remove(struct sr_session *session, void *priv)
+{
+	struct modbus_tcp *tcp = priv;
+
+	return sr_session_source_remove(session, tcp->socket);
+}
+
+static int modbus_tcp_send(void *priv, const uint8_t *buffer, int buffer_size)
+{
+	struct modbus_tcp *tcp = priv;
+	uint8_t frame[FRAME_SIZE];
+	int len, sent, ret;
+
+	if (buffer_size > FRAME_SIZE - HEADER_SIZE)
+		return SR_ERR_ARG;
+
+	if (g_queue_get_length(&tcp->pending) >= MAX_REQUESTS) {
+		sr_err("Too many Modbus requests awaiting replies.");
+		return SR_ERR;
+	}
+
+	WB16(frame + 0, tcp->next_tid);
+	WB16(frame + 2, 0);
+	WB16(frame + 4, 1 + buffer_size);
+	W8(frame + 6, tcp->unit_id);
+	memcpy(frame + HEADER_SIZE, buffer, buffer_size);
+	len = HEADER_SIZE + buffer_size;
+
+	for (sent = 0; sent < len; sent += ret) {
+		ret = send(tcp->socket, frame + sent, len - sent, 0);
+		if (ret < 0) {
+			sr_err("Send error: %s", g_strerror(errno));
+			return SR_ERR;
+		}
+	}
+
+	g_queue_push_tail(&tcp->pending, GUINT_TO_POINTER(tcp->next_tid));
+	tcp->next_tid++;
+
+	return SR_OK;
+}
+
+static int modbus_tcp_frame_len(const uint8_t *frame)
+{
+	return HEADER_SIZE - 1 + RB16(frame + 4);
+}
+
+/* Hand a complete frame over to the request it answers, if any. */
+static void modbus_tcp_dispatch(struct modbus_tcp *tcp)
+{
+	uint16_t tid;
+	gpointer frame;
+
+	tid = RB16(tcp->rx);
+	tcp->rx_len = 0;
+
+	if (RB16(tcp->rx + 2) != 0 || R8(tcp->rx + 6) != tcp->unit_id) {
+		sr_dbg("Dropping frame for another protocol or unit.");
+		return;
+	}
+
+	if (!g_queue_find(&tcp->pending, GUINT_TO_POINTER(tid))) {
+		sr_dbg("Dropping reply to unknown transaction %u.", tid);
+		return;
+	}
+
+	frame = g_memdup(tcp->rx, modbus_tcp_frame_len(tcp->rx));
+	tcp->early = g_slist_append(tcp->early, frame);
+}
+
+/* Take the reply to the oldest request, if it has arrived. */
+static gboolean modbus_tcp_take_reply(struct modbus_tcp *tcp)
+{
+	GSList *l;
+	uint16_t tid;
+
+	if (tcp->reply)
+		return TRUE;
+	if (g_queue_is_empty(&tcp->pending))
+		return FALSE;
+
+	tid = GPOINTER_TO_UINT(g_queue_peek_head(&tcp->pending));
+	for (l = tcp->early; l; l = l->next) {
+		if (RB16(l->data) != tid)
+			continue;
+		tcp->reply = l->data;
+		tcp->early = g_slist_delete_link(tcp->early, l);
+		g_queue_pop_head(&tcp->pending);
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*
+ * Receive frames until the reply to the oldest request is there, as far
+ * as they have arrived, or within timeout_ms if that's not 0.
+ *
+ * Returns TRUE once the reply is there, FALSE if it isn't yet.
+ */
+static int modbus_tcp_receive(struct modbus_tcp *tcp, unsigned int timeout_ms)
+{
+	GPollFD pollfd;
+	gint64 deadline;
+	int missing, len, timeout;
+
+	deadline = g_get_monotonic_time() + timeout_ms * 1000;
+
+	while (!modbus_tcp_take_reply(tcp)) {
+		if (g_queue_is_empty(&tcp->pending)) {
+			sr_err("No Modbus request awaits a reply.");
+			return SR_ERR;
+		}
+
+		if (tcp->rx_len < HEADER_SIZE) {
+			missing = HEADER_SIZE - tcp->rx_len;
+		} else {
+			len = RB16(tcp->rx + 4);
+			if (len < 2 || len > FRAME_SIZE - HEADER_SIZE + 1) {
+				sr_err("Invalid Modbus frame length %d.", len);
+				tcp->rx_len = 0;
+				return SR_ERR_DATA;
+			}
+			missing = modbus_tcp_frame_len(tcp->rx) - tcp->rx_len;
+			if (!missing) {
+				modbus_tcp_dispatch(tcp);
+				continue;
+			}
+		}
+
+		timeout = 0;
+		if (timeout_ms) {
+			timeout = MAX(deadline - g_get_monotonic_time(), 0) / 1000;
+			if (!timeout)
+				return FALSE;
+		}
+		pollfd.fd = tcp->socket;
+		pollfd.events = G_IO_IN;
+		pollfd.revents = 0;
+		if (g_poll(&pollfd, 1, timeout) <= 0) {
+			if (!timeout_ms)
+				return FALSE;
+			continue;
+		}
+
+		len = recv(tcp->socket, tcp->rx + tcp->rx_len, missing, 0);
+		if (len < 0) {
+			sr_err("Receive error: %s", g_strerror(errno));
+			return SR_ERR;
+		}
+		if (len == 0) {
+			sr_err("Connection closed by the server.");
+			return SR_ERR;
+		}
+		tcp->rx_len += len;
+	}
+
+	return TRUE;
+}
+
+static int modbus_tcp_reply_ready(void *priv)
+{
+	return modbus_tcp_receive(priv, 0);
+}
+
+static int modbus_tcp_read_begin(void *priv, uint8_t *function_code)
+{
+	struct modbus_tcp *tcp = priv;
+	int ret;
+
+	ret = modbus_tcp_receive(tcp, READ_TIMEOUT_MS);
+	if (ret < 0)
+		return ret;
+	if (!ret) {
+		/* Give up on it, or every later reply would wait for it. */
+		sr_err("Timed out waiting for Modbus reply.");
+		g_queue_pop_head(&tcp->pending);
+		return SR_ERR_TIMEOUT;
+	}
+
+	*function_code = tcp->reply[HEADER_SIZE];
+	tcp->read_pos = HEADER_SIZE + 1;
+
+	return SR_OK;
+}
+
+static int modbus_tcp_read_data(void *priv, uint8_t *buf, int maxlen)
+{
+	struct modbus_tcp *tcp = priv;
+	int len;
+
+	len = MIN(maxlen, modbus_tcp_frame_len(tcp->reply) - tcp->read_pos);
+	if (len <= 0)
+		return SR_ERR_DATA;
+	memcpy(buf, tcp->reply + tcp->read_pos, len);
+	tcp->read_pos += len;
+
+	return len;
+}
+
+static int modbus_tcp_read_end(void *priv)
+{
+	struct modbus_tcp *tcp = priv;
+
+	g_free(tcp->reply);
+	tcp->reply = NULL;
+
+	return SR_OK;
+}
+
+static int modbus_tcp_close(void *priv)
+{
+	struct modbus_tcp *tcp = priv;
+
+	g_queue_clear(&tcp->pending);
+	g_slist_free_full(tcp->early, g_free);
+	tcp->early = NULL;
+	g_free(tcp->reply);
+	tcp->reply = NULL;
+
+	if (close(tcp->socket) < 0)
+		return SR_ERR;
+
+	tcp->socket = -1;
+
+	return SR_OK;
+}
+
+static void modbus_tcp_free(void *priv)
+{
+	struct modbus_tcp *tcp = priv;
+
+	g_free(tcp->address);
+	g_free(tcp->port);
+}
+
+SR_PRIV const struct sr_modbus_dev_inst modbus_tcp_dev = {
+	.name          = "TCP",
+	.prefix        = "tcp",
+	.priv_size     = sizeof(struct modbus_tcp),
+	.max_requests  = MAX_REQUESTS,
+	.scan          = NULL,
+	.dev_inst_new  = modbus_tcp_dev_inst_new,
+	.open          = modbus_tcp_open,
+	.source_add    = modbus_tcp_source_add,
+	.source_remove = modbus_tcp_source_remove,
+	.send          = modbus_tcp_send,
+	.read_begin    = modbus_tcp_read_begin,
+	.read_data     = modbus_tcp_read_data,
+	.read_end      = modbus_tcp_read_end,
+	.reply_ready   = modbus_tcp_reply_ready,
+	.close         = modbus_tcp_close,
+	.free          = modbus_tcp_free,
+};
@@ -27,16 +27,28 @@
 
 #define LOG_PREFIX "output/analog"
 
+/* Rough size of an output line, to size the output buffer up front. */
+#define LINE_SIZE_ESTIMATE 32
+
 struct context {
 	int num_enabled_channels;
 	GPtrArray *channellist;
 	int digits;
 	float *fdata;
+	/* "<name>: " line prefix per channel, built on first use. */
+	GHashTable *prefixes;
+	/* Unit suffix of the last packet, and what it was derived from. */
+	gboolean suffix_valid;
+	int suffix_mq;
+	int suffix_unit;
+	uint64_t suffix_mqflags;
+	char *suffix;
 };
 
 enum {
 	DIGITS_ALL,
 	DIGITS_SPEC,
+	DIGITS_SHORTEST,
 };
 
 static int init(struct sr_output *o, GHashTable *options)
@@ -53,6 +65,8 @@ static int init(struct sr_output *o, GHashTable *options)
 	s = g_variant_get_string(g_hash_table_lookup(options, "digits"), NULL);
 	if (!strcmp(s, "all"))
 		ctx->digits = DIGITS_ALL;
+	else if (!strcmp(s, "shortest"))
+		ctx->digits = DIGITS_SHORTEST;
 	else
 		ctx->digits = DIGITS_SPEC;
 
@@ -66,213 +80,60 @@ static int init(struct sr_output *o, GHashTable *options)
 		ctx->num_enabled_channels++;
 	}
 	ctx->fdata = NULL;
+	ctx->prefixes = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+			NULL, g_free);
 
 	return SR_OK;
 }
 
-static void si_printf(float value, GString *out, const char *unitstr)
+/*
+ * Make sure the cached unit suffix matches the packet. Consecutive
+ * packets nearly always have the same one, so this is rarely rebuilt.
+ */
+static void update_suffix(struct context *ctx,
+		const struct sr_datafeed_analog *analog)
 {
-	float v;
+	const struct sr_analog_meaning *meaning;
+
+	meaning = analog->meaning;
+	if (ctx->suffix_valid && ctx->suffix_mq == (int)meaning->mq
+			&& ctx->suffix_unit == (int)meaning->unit
+			&& ctx->suffix_mqflags == meaning->mqflags)
+		return;
+
+	g_free(ctx->suffix);
+	sr_analog_unit_to_string(analog, &ctx->suffix);
+	ctx->suffix_valid = TRUE;
+	ctx->suffix_mq = meaning->mq;
+	ctx->suffix_unit = meaning->unit;
+	ctx->suffix_mqflags = meaning->mqflags;
+}
 
-	if (signbit(value))
-		v = -(value);
-	else
-		v = value;
+static const char *channel_prefix(struct context *ctx,
+		const struct sr_channel *ch)
+{
+	char *prefix;
 
-	if (v < 1e-12 || v > 1e+12)
-		g_string_append_printf(out, "%f %s", value, unitstr);
-	else if (v > 1e+9)
-		g_string_append_printf(out, "%f G%s", value / 1e+9, unitstr);
-	else if (v > 1e+6)
-		g_string_append_printf(out, "%f M%s", value / 1e+6, unitstr);
-	else if (v > 1e+3)
-		g_string_append_printf(out, "%f k%s", value / 1e+3, unitstr);
-	else if (v < 1e-9)
-		g_string_append_printf(out, "%f n%s", value * 1e+9, unitstr);
-	else if (v < 1e-6)
-		g_string_append_printf(out, "%f u%s", value * 1e+6, unitstr);
-	else if (v < 1e-3)
-		g_string_append_printf(out, "%f m%s", value * 1e+3, unitstr);
-	else
-		g_string_append_printf(out, "%f %s", value, unitstr);
+	if (!(prefix = g_hash_table_lookup(ctx->prefixes, ch))) {
+		prefix = g_strconcat(ch->name, ": ", NULL);
+		g_hash_table_insert(ctx->prefixes, (void *)ch, prefix);
+	}
 
+	return prefix;
 }
 
-/* Please use the same order as in enum sr_unit (libsigrok.h). */
-static void fancyprint(int unit, int mqflags, float value, GString *out)
+/* Append one "<name>: <value> <unit>" line. */
+static void print_value(struct context *ctx, const char *prefix,
+		float value, int digits, GString *out)
 {
-	switch (unit) {
-	case SR_UNIT_VOLT:
-		si_printf(value, out, "V");
-		break;
-	case SR_UNIT_AMPERE:
-		si_printf(value, out, "A");
-		break;
-	case SR_UNIT_OHM:
-		si_printf(value, out, "");
-		g_string_append_unichar(out, 0x2126);
-		break;
-	case SR_UNIT_FARAD:
-		si_printf(value, out, "F");
-		break;
-	case SR_UNIT_KELVIN:
-		si_printf(value, out, "K");
-		break;
-	case SR_UNIT_CELSIUS:
-		si_printf(value, out, "");
-		g_string_append_unichar(out, 0x00b0);
-		g_string_append_c(out, 'C');
-		break;
-	case SR_UNIT_FAHRENHEIT:
-		si_printf(value, out, "");
-		g_string_append_unichar(out, 0x00b0);
-		g_string_append_c(out, 'F');
-		break;
-	case SR_UNIT_HERTZ:
-		si_printf(value, out, "Hz");
-		break;
-	case SR_UNIT_PERCENTAGE:
-		g_string_append_printf(out, "%f %%", value);
-		break;
-	case SR_UNIT_BOOLEAN:
-		if (value > 0)
-			g_string_append_printf(out, "TRUE");
-		else
-			g_string_append_printf(out, "FALSE");
-		break;
-	case SR_UNIT_SECOND:
-		si_printf(value, out, "s");
-		break;
-	case SR_UNIT_SIEMENS:
-		si_printf(value, out, "S");
-		break;
-	case SR_UNIT_DECIBEL_MW:
-		si_printf(value, out, "dBu");
-		break;
-	case SR_UNIT_DECIBEL_VOLT:
-		si_printf(value, out, "dBV");
-		break;
-	case SR_UNIT_UNITLESS:
-		si_printf(value, out, "");
-		break;
-	case SR_UNIT_DECIBEL_SPL:
-		if (mqflags & SR_MQFLAG_SPL_FREQ_WEIGHT_A)
-			si_printf(value, out, "dB(A)");
-		else if (mqflags & SR_MQFLAG_SPL_FREQ_WEIGHT_C)
-			si_printf(value, out, "dB(C)");
-		else if (mqflags & SR_MQFLAG_SPL_FREQ_WEIGHT_Z)
-			si_printf(value, out, "dB(Z)");
-		else
-			/* No frequency weighting, or non-standard "flat" */
-			si_printf(value, out, "dB(SPL)");
-		if (mqflags & SR_MQFLAG_SPL_TIME_WEIGHT_S)
-			g_string_append(out, " S");
-		else if (mqflags & SR_MQFLAG_SPL_TIME_WEIGHT_F)
-			g_string_append(out, " F");
-		if (mqflags & SR_MQFLAG_SPL_LAT)
-			g_string_append(out, " LAT");
-		else if (mqflags & SR_MQFLAG_SPL_PCT_OVER_ALARM)
-			/* Not a standard function for SLMs, so this is
-			 * a made-up notation. */
-			g_string_append(out, " %oA");
-		break;
-	case SR_UNIT_CONCENTRATION:
-		g_string_append_printf(out, "%f ppm", value * (1000 * 1000));
-		break;
-	case SR_UNIT_REVOLUTIONS_PER_MINUTE:
-		si_printf(value, out, "RPM");
-		break;
-	case SR_UNIT_VOLT_AMPERE:
-		si_printf(value, out, "VA");
-		break;
-	case SR_UNIT_WATT:
-		si_printf(value, out, "W");
-		break;
-	case SR_UNIT_WATT_HOUR:
-		si_printf(value, out, "Wh");
-		break;
-	case SR_UNIT_METER_SECOND:
-		si_printf(value, out, "m/s");
-		break;
-	case SR_UNIT_HECTOPASCAL:
-		si_printf(value, out, "hPa");
-		break;
-	case SR_UNIT_HUMIDITY_293K:
-		si_printf(value, out, "%rF");
-		break;
-	case SR_UNIT_DEGREE:
-		si_printf(value, out, "");
-		g_string_append_unichar(out, 0x00b0);
-		break;
-	case SR_UNIT_HENRY:
-		si_printf(value, out, "H");
-		break;
-	case SR_UNIT_GRAM:
-		si_printf(value, out, "g");
-		break;
-	case SR_UNIT_CARAT:
-		si_printf(value, out, "ct");
-		break;
-	case SR_UNIT_OUNCE:
-		si_printf(value, out, "oz");
-		break;
-	case SR_UNIT_TROY_OUNCE:
-		si_printf(value, out, "oz t");
-		break;
-	case SR_UNIT_POUND:
-		si_printf(value, out, "lb");
-		break;
-	case SR_UNIT_PENNYWEIGHT:
-		si_printf(value, out, "dwt");
-		break;
-	case SR_UNIT_GRAIN:
-		si_printf(value, out, "gr");
-		break;
-	case SR_UNIT_TAEL:
-		si_printf(value, out, "tael");
-		break;
-	case SR_UNIT_MOMME:
-		si_printf(value, out, "momme");
-		break;
-	case SR_UNIT_TOLA:
-		si_printf(value, out, "tola");
-		break;
-	case SR_UNIT_PIECE:
-		si_printf(value, out, "pcs");
-		break;
-	default:
-		si_printf(value, out, "");
-		break;
-	}
-
-	/* Please use the same order as in enum sr_mqflag (libsigrok.h). */
-	if (mqflags & SR_MQFLAG_AC)
-		g_string_append_printf(out, " AC");
-	if (mqflags & SR_MQFLAG_DC)
-		g_string_append_printf(out, " DC");
-	if (mqflags & SR_MQFLAG_RMS)
-		g_string_append_printf(out, " RMS");
-	if (mqflags & SR_MQFLAG_DIODE)
-		g_string_append_printf(out, " DIODE");
-	if (mqflags & SR_MQFLAG_HOLD)
-		g_string_append_printf(out, " HOLD");
-	if (mqflags & SR_MQFLAG_MAX)
-		g_string_append_printf(out, " MAX");
-	if (mqflags & SR_MQFLAG_MIN)
-		g_string_append_printf(out, " MIN");
-	if (mqflags & SR_MQFLAG_AUTORANGE)
-		g_string_append_printf(out, " AUTO");
-	if (mqflags & SR_MQFLAG_RELATIVE)
-		g_string_append_printf(out, " REL");
-	/* Note: SR_MQFLAG_SPL_* is handled above. */
-	if (mqflags & SR_MQFLAG_DURATION)
-		g_string_append_printf(out, " DURATION");
-	if (mqflags & SR_MQFLAG_AVG)
-		g_string_append_printf(out, " AVG");
-	if (mqflags & SR_MQFLAG_REFERENCE)
-		g_string_append_printf(out, " REF");
-	if (mqflags & SR_MQFLAG_UNSTABLE)
-		g_string_append_printf(out, " UNSTABLE");
+	char buf[SR_FLOAT_STRING_SIZE];
+	int len;
+
+	g_string_append(out, prefix);
+	len = sr_float_to_string(buf, value, digits);
+	g_string_append_len(out, buf, len);
+	g_string_append_c(out, ' ');
+	g_string_append(out, ctx->suffix);
 	g_string_append_c(out, '\n');
 }
 
@@ -280,14 +141,12 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		GString **out)
 {
 	struct context *ctx;
-	const struct sr_datafeed_analog_old *analog_old;
 	const struct sr_datafeed_analog *analog;
-	struct sr_channel *ch;
+	const char **prefixes;
 	GSList *l;
 	float *fdata;
 	unsigned int i;
-	int num_channels, c, ret, si, digits;
-	char *number, *suffix;
+	int num_channels, c, ret, digits;
 
 	*out = NULL;
 	if (!o || !o->sdi)
@@ -301,20 +160,6 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	case SR_DF_FRAME_END:
 		*out = g_string_new("FRAME-END\n");
 		break;
-	case SR_DF_ANALOG_OLD:
-		analog_old = packet->payload;
-		fdata = (float *)analog_old->data;
-		*out = g_string_sized_new(512);
-		num_channels = g_slist_length(analog_old->channels);
-		for (si = 0; si < analog_old->num_samples; si++) {
-			for (l = analog_old->channels, c = 0; l; l = l->next, c++) {
-				ch = l->data;
-				g_string_append_printf(*out, "%s: ", ch->name);
-				fancyprint(analog_old->unit, analog_old->mqflags,
-						fdata[si * num_channels + c], *out);
-			}
-		}
-		break;
 	case SR_DF_ANALOG:
 		analog = packet->payload;
 		num_channels = g_slist_length(analog->meaning->channels);
@@ -324,31 +169,33 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		ctx->fdata = fdata;
 		if ((ret = sr_analog_to_float(analog, fdata)) != SR_OK)
 			return ret;
-		*out = g_string_sized_new(512);
-		if (analog->encoding->is_digits_decimal) {
+		if (ctx->digits == DIGITS_SHORTEST) {
+			digits = -1;
+		} else if (analog->encoding->is_digits_decimal) {
 			if (ctx->digits == DIGITS_ALL)
 				digits = analog->encoding->digits;
 			else
 				digits = analog->spec->spec_digits;
+			/* Resolution coarser than one unit, e.g. 1 kOhm steps. */
+			if (digits < 0)
+				digits = 0;
 		} else {
 			/* TODO we don't know how to print by number of bits yet. */
 			digits = 6;
 		}
-		sr_analog_unit_to_string(analog, &suffix);
+		update_suffix(ctx, analog);
+		*out = g_string_sized_new(analog->num_samples
+				* num_channels * LINE_SIZE_ESTIMATE);
+		prefixes = g_malloc(sizeof(char *) * num_channels);
+		for (l = analog->meaning->channels, c = 0; l; l = l->next, c++)
+			prefixes[c] = channel_prefix(ctx, l->data);
 		for (i = 0; i < analog->num_samples; i++) {
-			for (l = analog->meaning->channels, c = 0; l; l = l->next, c++) {
-				ch = l->data;
-				g_string_append_printf(*out, "%s: ", ch->name);
-				number = g_strdup_printf("%.*f", digits,
-						fdata[i * num_channels + c]);
-				g_string_append(*out, number);
-				g_free(number);
-				g_string_append(*out, " ");
-				g_string_append(*out, suffix);
-				g_string_append(*out, "\n");
+			for (c = 0; c < num_channels; c++) {
+				print_value(ctx, prefixes[c],
+						fdata[i * num_channels + c], digits, *out);
 			}
 		}
-		g_free(suffix);
+		g_free(prefixes);
 		break;
 	}
 
@@ -368,6 +215,8 @@ static const struct sr_option *get_options(void)
 				g_variant_ref_sink(g_variant_new_string("all")));
 		options[0].values = g_slist_append(options[0].values,
 				g_variant_ref_sink(g_variant_new_string("spec")));
+		options[0].values = g_slist_append(options[0].values,
+				g_variant_ref_sink(g_variant_new_string("shortest")));
 	}
 
 	return options;
@@ -385,6 +234,8 @@ static int cleanup(struct sr_output *o)
 	g_variant_unref(options[0].def);
 	g_slist_free_full(options[0].values, (GDestroyNotify)g_variant_unref);
 	g_free(ctx->fdata);
+	g_hash_table_destroy(ctx->prefixes);
+	g_free(ctx->suffix);
 	g_free(ctx);
 	o->priv = NULL;
 
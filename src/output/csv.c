@@ -27,6 +27,9 @@
 
 #define LOG_PREFIX "output/csv"
 
+/* Digits after the decimal point of analog values, as with "%f". */
+#define ANALOG_DIGITS 6
+
 struct context {
 	unsigned int num_enabled_channels;
 	uint64_t samplerate;
@@ -37,6 +40,7 @@ struct context {
 	/* For analog measurements split into frames, not packets. */
 	struct sr_channel **analog_channels;
 	float *analog_vals; /* Analog values stored until the end of the frame. */
+	int *analog_digits; /* Decimals to print each of those with. */
 	unsigned int num_analog_channels;
 	gboolean inframe;
 };
@@ -85,6 +89,7 @@ static int init(struct sr_output *o, GHashTable *options)
 	ctx->analog_channels = g_malloc(sizeof(struct sr_channel *)
 					* ctx->num_analog_channels);
 	ctx->analog_vals = g_malloc(sizeof(float) * ctx->num_analog_channels);
+	ctx->analog_digits = g_malloc(sizeof(int) * ctx->num_analog_channels);
 
 	/* Once more to map the enabled channels. */
 	for (i = 0, l = o->sdi->channels, j = 0; l; l = l->next) {
@@ -164,8 +169,20 @@ static void init_output(GString **out, struct context *ctx,
 	}
 }
 
+/*
+ * The number of decimals to print a packet's values with: its own
+ * resolution if it has a decimal one, otherwise ANALOG_DIGITS.
+ */
+static int analog_digits(const struct sr_analog_encoding *encoding)
+{
+	if (!encoding->is_digits_decimal)
+		return ANALOG_DIGITS;
+
+	return MAX(encoding->digits, 0);
+}
+
 static void handle_analog_frame(struct context *ctx, GSList *channels,
-		unsigned int num_samples, float *data)
+		unsigned int num_samples, float *data, int digits)
 {
 	unsigned int numch, nums, i, j, s;
 	GSList *l;
@@ -180,28 +197,107 @@ static void handle_analog_frame(struct context *ctx, GSList *channels,
 	l = channels;
 	for (i = 0; i < nums; i++) {
 		for (j = 0; j < ctx->num_analog_channels; j++) {
-			if (ctx->analog_channels[j] == l->data)
+			if (ctx->analog_channels[j] == l->data) {
 				ctx->analog_vals[j] = data[s++];
+				ctx->analog_digits[j] = digits;
+			}
 		}
 		l = l->next;
 	}
 }
 
+/*
+ * Planar packets are written straight from the planes: one row per
+ * sample, each column reading from the plane of its channel.
+ */
+static int handle_analog_planar(const struct sr_output *o,
+		const struct sr_datafeed_analog_planar *planar, GString **out)
+{
+	struct context *ctx;
+	const struct sr_analog_plane *plane;
+	float *data;
+	int *col_plane, *digits, ret, len;
+	unsigned int j, k;
+	uint32_t s, num_samples;
+	gchar buf[SR_FLOAT_STRING_SIZE];
+
+	ctx = o->priv;
+	num_samples = planar->num_samples;
+	if (!planar->num_planes || !num_samples)
+		return SR_OK;
+
+	data = g_malloc(sizeof(float) * num_samples * planar->num_planes);
+	if ((ret = sr_analog_planar_to_float(planar, data)) != SR_OK) {
+		g_free(data);
+		return ret;
+	}
+	digits = g_malloc(sizeof(int) * planar->num_planes);
+	for (k = 0; k < planar->num_planes; k++)
+		digits[k] = analog_digits(planar->planes[k].encoding);
+
+	if (ctx->inframe) {
+		/* Keep the most recent value of each channel. */
+		for (k = 0; k < planar->num_planes; k++) {
+			plane = &planar->planes[k];
+			for (j = 0; j < ctx->num_analog_channels; j++) {
+				if (ctx->analog_channels[j] != plane->channel)
+					continue;
+				ctx->analog_vals[j] =
+					data[k * num_samples + num_samples - 1];
+				ctx->analog_digits[j] = digits[k];
+			}
+		}
+		g_free(digits);
+		g_free(data);
+		return SR_OK;
+	}
+
+	/* Map each column to the plane carrying its channel, if any. */
+	col_plane = g_malloc(sizeof(int) * ctx->num_enabled_channels);
+	for (j = 0; j < ctx->num_enabled_channels; j++) {
+		col_plane[j] = -1;
+		for (k = 0; k < planar->num_planes; k++)
+			if (planar->planes[k].channel == ctx->channels[j])
+				col_plane[j] = k;
+	}
+
+	init_output(out, ctx, o);
+	for (s = 0; s < num_samples; s++) {
+		for (j = 0; j < ctx->num_enabled_channels; j++) {
+			if (col_plane[j] >= 0) {
+				k = col_plane[j];
+				len = sr_float_to_string(buf,
+					data[k * num_samples + s], digits[k]);
+				g_string_append_len(*out, buf, len);
+			}
+			g_string_append_c(*out, ctx->separator);
+		}
+		g_string_truncate(*out, (*out)->len - 1);
+		g_string_append_c(*out, '\n');
+	}
+
+	g_free(col_plane);
+	g_free(digits);
+	g_free(data);
+
+	return SR_OK;
+}
+
 static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
 		GString **out)
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
-	const struct sr_datafeed_analog_old *analog_old;
 	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_gap *gap;
 	const struct sr_config *src;
 	unsigned int num_samples;
 	float *data;
 	GSList *l, *channels;
 	struct context *ctx;
-	int idx;
-	uint64_t i, j, k, nums, numch;
-	gchar *p, c;
+	int idx, len, digits, *col_idx;
+	uint64_t i, j, numch;
+	gchar *p, c, buf[SR_FLOAT_STRING_SIZE];
 	int ret = SR_OK;
 
 	*out = NULL;
@@ -220,12 +316,21 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			ctx->samplerate = g_variant_get_uint64(src->data);
 		}
 		break;
+	case SR_DF_GAP:
+		/* There are no rows for lost samples, note where they'd be. */
+		gap = packet->payload;
+		init_output(out, ctx, o);
+		g_string_append_printf(*out, "; Gap: %" PRIu64 " samples lost\n",
+				gap->length);
+		break;
 	case SR_DF_FRAME_BEGIN:
 		/*
 		 * Special case - we start gathering data from analog channels
 		 * and wait for SR_DF_FRAME_END to dump it.
 		 */
 		memset(ctx->analog_vals, 0, sizeof(float) * ctx->num_analog_channels);
+		for (i = 0; i < ctx->num_analog_channels; i++)
+			ctx->analog_digits[i] = ANALOG_DIGITS;
 		ctx->inframe = TRUE;
 		ret = SR_OK;
 		break;
@@ -237,8 +342,11 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 
 		for (i = 0, j = 0; i < ctx->num_enabled_channels; i++) {
 			if (ctx->channels[i]->type == SR_CHANNEL_ANALOG) {
-				g_string_append_printf(*out, "%f",
-							ctx->analog_vals[j++]);
+				len = sr_float_to_string(buf,
+						ctx->analog_vals[j],
+						ctx->analog_digits[j]);
+				g_string_append_len(*out, buf, len);
+				j++;
 			}
 			g_string_append_c(*out, ctx->separator);
 		}
@@ -268,58 +376,54 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			g_string_append_printf(*out, "\n");
 		}
 		break;
-	case SR_DF_ANALOG_OLD:
 	case SR_DF_ANALOG:
-		analog_old = packet->payload;
 		analog = packet->payload;
-
-		if (packet->type == SR_DF_ANALOG_OLD) {
-			channels = analog_old->channels;
-			numch = g_slist_length(channels);
-			num_samples = analog_old->num_samples;
-			data = analog_old->data;
-		} else {
-			channels = analog->meaning->channels;
-			numch = g_slist_length(channels);
-			num_samples = analog->num_samples;
-			data = g_malloc(sizeof(float) * num_samples * numch);
-			ret = sr_analog_to_float(analog, data);
-			if (ret != SR_OK)
-				return ret;
+		channels = analog->meaning->channels;
+		numch = g_slist_length(channels);
+		num_samples = analog->num_samples;
+		digits = analog_digits(analog->encoding);
+		data = g_malloc(sizeof(float) * num_samples * numch);
+		ret = sr_analog_to_float(analog, data);
+		if (ret != SR_OK) {
+			g_free(data);
+			return ret;
 		}
 
 		if (ctx->inframe) {
-			handle_analog_frame(ctx, channels, num_samples, data);
+			handle_analog_frame(ctx, channels, num_samples, data,
+					digits);
+			g_free(data);
 			break;
 		}
 
 		init_output(out, ctx, o);
-		k = 0;
-		l = NULL;
 
-		if (num_samples > numch)
-			nums = num_samples / numch;
-		else
-			nums = 1;
+		/*
+		 * There are num_samples values for each channel, interleaved.
+		 * Map each column to its channel's position in the packet.
+		 */
+		col_idx = g_malloc(sizeof(int) * ctx->num_enabled_channels);
+		for (j = 0; j < ctx->num_enabled_channels; j++)
+			col_idx[j] = g_slist_index(channels, ctx->channels[j]);
 
-		for (i = 0; i < nums; i++) {
+		for (i = 0; i < num_samples; i++) {
 			for (j = 0; j < ctx->num_enabled_channels; j++) {
-				if (ctx->channels[j]->type == SR_CHANNEL_ANALOG) {
-					if (!l)
-						l = channels;
-
-					if (ctx->channels[j] == l->data) {
-						g_string_append_printf(*out,
-							"%f", data[k++]);
-					}
-
-					l = l->next;
+				if (col_idx[j] >= 0) {
+					len = sr_float_to_string(buf,
+						data[i * numch + col_idx[j]],
+						digits);
+					g_string_append_len(*out, buf, len);
 				}
 				g_string_append_c(*out, ctx->separator);
 			}
 			g_string_truncate(*out, (*out)->len - 1);
 			g_string_append_printf(*out, "\n");
 		}
+		g_free(col_idx);
+		g_free(data);
+		break;
+	case SR_DF_ANALOG_PLANAR:
+		ret = handle_analog_planar(o, packet->payload, out);
 		break;
 	}
 
@@ -338,6 +442,7 @@ static int cleanup(struct sr_output *o)
 		g_free(ctx->channels);
 		g_free(ctx->analog_channels);
 		g_free(ctx->analog_vals);
+		g_free(ctx->analog_digits);
 		g_free(o->priv);
 		o->priv = NULL;
 	}
@@ -350,7 +455,7 @@ SR_PRIV struct sr_output_module output_csv = {
 	.name = "CSV",
 	.desc = "Comma-separated values",
 	.exts = (const char*[]){"csv", NULL},
-	.flags = 0,
+	.flags = SR_OUTPUT_ANALOG_PLANAR,
 	.options = NULL,
 	.init = init,
 	.receive = receive,
@@ -65,6 +65,7 @@ extern SR_PRIV struct sr_output_module output_csv;
 extern SR_PRIV struct sr_output_module output_analog;
 extern SR_PRIV struct sr_output_module output_srzip;
 extern SR_PRIV struct sr_output_module output_wav;
+extern SR_PRIV struct sr_output_module output_shmring;
 /* @endcond */
 
 static const struct sr_output_module *output_module_list[] = {
@@ -80,6 +81,7 @@ static const struct sr_output_module *output_module_list[] = {
 	&output_analog,
 	&output_srzip,
 	&output_wav,
+	&output_shmring,
 	NULL,
 };
 
@@ -323,17 +325,85 @@ SR_API const struct sr_output *sr_output_new(const struct sr_output_module *omod
 	return op;
 }
 
+/**
+ * Hand a planar packet to a module which doesn't know the layout, as
+ * one single-channel SR_DF_ANALOG packet per plane.
+ */
+static int send_planes(const struct sr_output *o,
+		const struct sr_datafeed_analog_planar *planar, GString **out)
+{
+	const struct sr_analog_plane *plane;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_meaning meaning;
+	GSList channels;
+	GString *plane_out;
+	const uint8_t *src;
+	uint8_t *packed;
+	unsigned int unitsize, stride;
+	uint32_t i, j;
+	int ret;
+
+	*out = NULL;
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+	ret = SR_OK;
+	for (i = 0; i < planar->num_planes && ret == SR_OK; i++) {
+		plane = &planar->planes[i];
+		unitsize = plane->encoding->unitsize;
+		stride = plane->stride ? plane->stride : unitsize;
+		packed = NULL;
+		if (stride != unitsize) {
+			packed = g_malloc(planar->num_samples * unitsize);
+			src = plane->data;
+			for (j = 0; j < planar->num_samples; j++)
+				memcpy(packed + j * unitsize, src + j * stride,
+					unitsize);
+		}
+		meaning = *plane->meaning;
+		channels.data = plane->channel;
+		channels.next = NULL;
+		meaning.channels = &channels;
+		analog.data = packed ? packed : plane->data;
+		analog.num_samples = planar->num_samples;
+		analog.encoding = plane->encoding;
+		analog.meaning = &meaning;
+		analog.spec = plane->spec;
+
+		plane_out = NULL;
+		ret = o->module->receive(o, &packet, &plane_out);
+		g_free(packed);
+		if (!plane_out)
+			continue;
+		if (*out) {
+			g_string_append_len(*out, plane_out->str, plane_out->len);
+			g_string_free(plane_out, TRUE);
+		} else {
+			*out = plane_out;
+		}
+	}
+
+	return ret;
+}
+
 /**
  * Send a packet to the specified output instance.
  *
  * The instance's output is returned as a newly allocated GString,
  * which must be freed by the caller.
  *
+ * Modules which don't set SR_OUTPUT_ANALOG_PLANAR receive an
+ * SR_DF_ANALOG_PLANAR packet as one SR_DF_ANALOG packet per plane.
+ *
  * @since 0.4.0
  */
 SR_API int sr_output_send(const struct sr_output *o,
 		const struct sr_datafeed_packet *packet, GString **out)
 {
+	if (packet->type == SR_DF_ANALOG_PLANAR
+			&& !(o->module->flags & SR_OUTPUT_ANALOG_PLANAR))
+		return send_planes(o, packet->payload, out);
+
 	return o->module->receive(o, packet, out);
 }
 
@@ -0,0 +1,767 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Shared-memory ring buffer output.
+ *
+ * Logic and analog packets are published into a POSIX shared memory
+ * object, from which any number of local processes can read them without
+ * going through a pipe. The object consists of a header page followed by
+ * the ring data area:
+ *
+ *  - The header carries the stream properties (samplerate, unitsize,
+ *    channel map) and two monotonically increasing byte positions into
+ *    the ring: write_pos is the end of the last complete record, and
+ *    reserve_pos is the end of the record currently being written.
+ *
+ *  - Each record is a struct shmring_record_hdr followed by its payload,
+ *    padded to a multiple of 8 bytes. Records may wrap around the end of
+ *    the data area.
+ *
+ * The producer never waits for readers. A reader that falls behind by
+ * more than the size of the data area detects that its data has been
+ * overwritten (reserve_pos has moved past it), skips forward to the
+ * newest record and reports the number of lost records.
+ *
+ * Use sr_shmring_reader_open() and friends to read from the ring.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#if defined(HAVE_SHM_OPEN) && defined(HAVE_SYS_MMAN_H)
+#define HAVE_SHMRING 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define LOG_PREFIX "output/shmring"
+
+#define SHMRING_MAGIC "SRSHMRNG"
+#define SHMRING_VERSION 1
+#define SHMRING_HEADER_SIZE 4096
+#define SHMRING_MAX_CHANNELS 128
+#define SHMRING_MIN_SIZE (64 * 1024)
+#define SHMRING_DEFAULT_SIZE (16 * 1024 * 1024)
+#define SHMRING_DEFAULT_NAME "/sigrok"
+
+/* Interval in which a waiting reader checks for new records. */
+#define SHMRING_POLL_US 100
+
+#define SHMRING_ALIGN(x) (((x) + 7) & ~(uint64_t)7)
+
+/** Layout of the header page at the start of the shared memory object. */
+struct shmring_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;
+	/** Size of the ring data area, a power of two. */
+	uint64_t data_size;
+	uint64_t samplerate;
+	uint32_t unitsize;
+	uint32_t num_channels;
+	/** Set by the producer when it has written its last record. */
+	uint32_t finished;
+	uint32_t reserved;
+	/* Keep the positions in their own cache lines. */
+	uint8_t pad0[64 - 48];
+	uint64_t write_pos;
+	uint8_t pad1[64 - 8];
+	uint64_t reserve_pos;
+	uint8_t pad2[64 - 8];
+	/** Number of records written so far. */
+	uint64_t seq;
+	uint8_t pad3[64 - 8];
+	struct sr_shmring_channel channels[SHMRING_MAX_CHANNELS];
+};
+
+/** Header of a single record in the ring. */
+struct shmring_record_hdr {
+	uint32_t type;
+	uint32_t unitsize;
+	uint64_t seq;
+	uint64_t length;
+	int32_t channel;
+	uint32_t num_channels;
+	int32_t mq;
+	int32_t unit;
+	uint64_t mqflags;
+};
+
+struct sr_shmring_reader {
+	int fd;
+	uint8_t *map;
+	size_t map_size;
+	struct shmring_header *hdr;
+	uint8_t *data;
+	uint64_t data_size;
+	uint64_t read_pos;
+	/** Sequence number of the next record, or -1 if none seen yet. */
+	int64_t next_seq;
+	uint8_t *buf;
+	struct sr_shmring_info info;
+	struct sr_shmring_channel *channels;
+};
+
+struct out_context {
+	char *name;
+	int fd;
+	uint8_t *map;
+	size_t map_size;
+	struct shmring_header *hdr;
+	uint8_t *data;
+	uint64_t data_size;
+	/** Largest payload a single record may carry. */
+	uint64_t max_payload;
+	float *fbuf;
+	gboolean finished;
+};
+
+static struct sr_option options[] = {
+	{ "name", "Name", "Name of the shared memory object", NULL, NULL },
+	{ "size", "Size", "Size of the ring buffer in bytes", NULL, NULL },
+	ALL_ZERO
+};
+
+#ifdef HAVE_SHMRING
+
+static uint64_t load_pos(const uint64_t *pos)
+{
+	return __atomic_load_n(pos, __ATOMIC_ACQUIRE);
+}
+
+static void store_pos(uint64_t *pos, uint64_t value)
+{
+	__atomic_store_n(pos, value, __ATOMIC_RELEASE);
+}
+
+static void ring_copy_in(uint8_t *data, uint64_t data_size, uint64_t pos,
+		const void *src, uint64_t len)
+{
+	uint64_t offset, first;
+
+	offset = pos & (data_size - 1);
+	first = MIN(len, data_size - offset);
+	memcpy(data + offset, src, first);
+	if (len > first)
+		memcpy(data, (const uint8_t *)src + first, len - first);
+}
+
+static void ring_copy_out(const uint8_t *data, uint64_t data_size,
+		uint64_t pos, void *dest, uint64_t len)
+{
+	uint64_t offset, first;
+
+	offset = pos & (data_size - 1);
+	first = MIN(len, data_size - offset);
+	memcpy(dest, data + offset, first);
+	if (len > first)
+		memcpy((uint8_t *)dest + first, data, len - first);
+}
+
+static void write_record(struct out_context *outc,
+		struct shmring_record_hdr *rec, const void *payload)
+{
+	uint64_t pos, end;
+
+	pos = outc->hdr->write_pos;
+	end = pos + SHMRING_ALIGN(sizeof(*rec) + rec->length);
+	rec->seq = outc->hdr->seq;
+
+	/*
+	 * Announce the region we're about to overwrite before touching
+	 * it, so readers can tell whether their copy is still valid.
+	 */
+	store_pos(&outc->hdr->reserve_pos, end);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	ring_copy_in(outc->data, outc->data_size, pos, rec, sizeof(*rec));
+	ring_copy_in(outc->data, outc->data_size, pos + sizeof(*rec),
+		payload, rec->length);
+
+	outc->hdr->seq++;
+	store_pos(&outc->hdr->write_pos, end);
+}
+
+static void write_logic(struct out_context *outc,
+		const struct sr_datafeed_logic *logic)
+{
+	struct shmring_record_hdr rec;
+	const uint8_t *p;
+	uint64_t left, chunk, max_chunk;
+
+	if (logic->unitsize == 0)
+		return;
+
+	outc->hdr->unitsize = logic->unitsize;
+	max_chunk = outc->max_payload - outc->max_payload % logic->unitsize;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.type = SR_DF_LOGIC;
+	rec.unitsize = logic->unitsize;
+	rec.channel = -1;
+
+	p = logic->data;
+	left = logic->length;
+	while (left > 0) {
+		chunk = MIN(left, max_chunk);
+		rec.length = chunk;
+		write_record(outc, &rec, p);
+		p += chunk;
+		left -= chunk;
+	}
+}
+
+static int write_analog(struct out_context *outc,
+		const struct sr_datafeed_analog *analog)
+{
+	struct shmring_record_hdr rec;
+	struct sr_channel *ch;
+	const float *p;
+	uint64_t left, chunk, max_chunk;
+	unsigned int num_channels;
+	int ret;
+
+	num_channels = g_slist_length(analog->meaning->channels);
+	if (num_channels == 0 || analog->num_samples == 0)
+		return SR_OK;
+
+	left = (uint64_t)analog->num_samples * num_channels;
+	outc->fbuf = g_realloc(outc->fbuf, left * sizeof(float));
+	if ((ret = sr_analog_to_float(analog, outc->fbuf)) != SR_OK)
+		return ret;
+
+	ch = analog->meaning->channels->data;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.type = SR_DF_ANALOG;
+	rec.channel = ch->index;
+	rec.num_channels = num_channels;
+	rec.mq = analog->meaning->mq;
+	rec.unit = analog->meaning->unit;
+	rec.mqflags = analog->meaning->mqflags;
+
+	/* Never split the values of one sample across two records. */
+	max_chunk = outc->max_payload / sizeof(float);
+	max_chunk -= max_chunk % num_channels;
+
+	p = outc->fbuf;
+	while (left > 0) {
+		chunk = MIN(left, max_chunk);
+		rec.length = chunk * sizeof(float);
+		write_record(outc, &rec, p);
+		p += chunk;
+		left -= chunk;
+	}
+
+	return SR_OK;
+}
+
+static void write_end(struct out_context *outc)
+{
+	struct shmring_record_hdr rec;
+
+	if (outc->finished)
+		return;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.type = SR_DF_END;
+	rec.channel = -1;
+	write_record(outc, &rec, NULL);
+
+	__atomic_store_n(&outc->hdr->finished, 1, __ATOMIC_RELEASE);
+	outc->finished = TRUE;
+}
+
+static void fill_header(const struct sr_output *o, struct shmring_header *hdr,
+		uint64_t data_size)
+{
+	struct sr_channel *ch;
+	struct sr_shmring_channel *sch;
+	GVariant *gvar;
+	GSList *l;
+	unsigned int num_logic;
+
+	memset(hdr, 0, sizeof(*hdr));
+	memcpy(hdr->magic, SHMRING_MAGIC, sizeof(hdr->magic));
+	hdr->version = SHMRING_VERSION;
+	hdr->header_size = SHMRING_HEADER_SIZE;
+	hdr->data_size = data_size;
+
+	if (o->sdi && sr_config_get(o->sdi->driver, o->sdi, NULL,
+			SR_CONF_SAMPLERATE, &gvar) == SR_OK) {
+		hdr->samplerate = g_variant_get_uint64(gvar);
+		g_variant_unref(gvar);
+	}
+
+	num_logic = 0;
+	for (l = o->sdi ? o->sdi->channels : NULL; l; l = l->next) {
+		ch = l->data;
+		if (ch->type == SR_CHANNEL_LOGIC)
+			num_logic++;
+		if (hdr->num_channels == SHMRING_MAX_CHANNELS) {
+			sr_warn("Too many channels, not announcing '%s'.",
+				ch->name);
+			continue;
+		}
+		sch = &hdr->channels[hdr->num_channels++];
+		sch->index = ch->index;
+		sch->type = ch->type;
+		sch->enabled = ch->enabled;
+		g_strlcpy(sch->name, ch->name, sizeof(sch->name));
+	}
+	hdr->unitsize = (num_logic + 7) / 8;
+}
+
+static int init(struct sr_output *o, GHashTable *options)
+{
+	struct out_context *outc;
+	const char *name;
+	uint64_t size, data_size;
+
+	name = g_variant_get_string(g_hash_table_lookup(options, "name"), NULL);
+	if (!name[0] && o->filename && o->filename[0])
+		name = o->filename;
+	if (!name[0])
+		name = SHMRING_DEFAULT_NAME;
+
+	/* The data area must be a power of two in size. */
+	size = g_variant_get_uint64(g_hash_table_lookup(options, "size"));
+	data_size = SHMRING_MIN_SIZE;
+	while (data_size < size)
+		data_size <<= 1;
+
+	outc = g_malloc0(sizeof(struct out_context));
+	if (name[0] == '/')
+		outc->name = g_strdup(name);
+	else
+		outc->name = g_strdup_printf("/%s", name);
+	outc->data_size = data_size;
+	outc->max_payload = data_size / 4;
+	outc->map_size = SHMRING_HEADER_SIZE + data_size;
+
+	outc->fd = shm_open(outc->name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (outc->fd < 0) {
+		sr_err("Failed to create shared memory object '%s': %s.",
+			outc->name, g_strerror(errno));
+		goto err_free;
+	}
+
+	if (ftruncate(outc->fd, outc->map_size) < 0) {
+		sr_err("Failed to resize shared memory object: %s.",
+			g_strerror(errno));
+		goto err_unlink;
+	}
+
+	outc->map = mmap(NULL, outc->map_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED, outc->fd, 0);
+	if (outc->map == MAP_FAILED) {
+		sr_err("Failed to map shared memory object: %s.",
+			g_strerror(errno));
+		goto err_unlink;
+	}
+
+	outc->hdr = (struct shmring_header *)outc->map;
+	outc->data = outc->map + SHMRING_HEADER_SIZE;
+	fill_header(o, outc->hdr, data_size);
+
+	sr_info("Publishing samples in '%s' (%" PRIu64 " bytes).",
+		outc->name, data_size);
+
+	o->priv = outc;
+
+	return SR_OK;
+
+err_unlink:
+	close(outc->fd);
+	shm_unlink(outc->name);
+err_free:
+	g_free(outc->name);
+	g_free(outc);
+
+	return SR_ERR;
+}
+
+static int receive(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, GString **out)
+{
+	struct out_context *outc;
+	const struct sr_datafeed_meta *meta;
+	const struct sr_config *src;
+	GSList *l;
+
+	*out = NULL;
+	if (!o || !o->priv)
+		return SR_ERR_ARG;
+	outc = o->priv;
+
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key != SR_CONF_SAMPLERATE)
+				continue;
+			outc->hdr->samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_LOGIC:
+		write_logic(outc, packet->payload);
+		break;
+	case SR_DF_ANALOG:
+		return write_analog(outc, packet->payload);
+	case SR_DF_END:
+		write_end(outc);
+		break;
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_output *o)
+{
+	struct out_context *outc;
+
+	if (!o || !o->priv)
+		return SR_ERR_ARG;
+	outc = o->priv;
+
+	write_end(outc);
+
+	/* Readers which have the object mapped keep their copy. */
+	munmap(outc->map, outc->map_size);
+	close(outc->fd);
+	shm_unlink(outc->name);
+
+	g_free(outc->fbuf);
+	g_free(outc->name);
+	g_free(outc);
+	o->priv = NULL;
+
+	return SR_OK;
+}
+
+#else
+
+static int init(struct sr_output *o, GHashTable *options)
+{
+	(void)o;
+	(void)options;
+
+	sr_err("Shared memory is not supported on this platform.");
+
+	return SR_ERR_NA;
+}
+
+static int receive(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, GString **out)
+{
+	(void)o;
+	(void)packet;
+
+	*out = NULL;
+
+	return SR_ERR_NA;
+}
+
+static int cleanup(struct sr_output *o)
+{
+	(void)o;
+
+	return SR_OK;
+}
+
+#endif
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_string(""));
+		options[1].def = g_variant_ref_sink(
+				g_variant_new_uint64(SHMRING_DEFAULT_SIZE));
+	}
+
+	return options;
+}
+
+/**
+ * @addtogroup grp_output
+ *
+ * @{
+ */
+
+/**
+ * Attach to a shared-memory ring created by the "shmring" output module.
+ *
+ * Reading starts with the next record the producer writes.
+ *
+ * @param reader Will be set to a newly allocated reader. Must not be NULL.
+ * @param name Name of the shared memory object, as given to the output
+ *             module. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid arguments.
+ * @retval SR_ERR_NA Shared memory is not supported on this platform.
+ * @retval SR_ERR Other error.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_shmring_reader_open(struct sr_shmring_reader **reader,
+		const char *name)
+{
+#ifdef HAVE_SHMRING
+	struct sr_shmring_reader *r;
+	struct shmring_header *hdr;
+	struct stat st;
+	char *shm_name;
+
+	if (!reader || !name)
+		return SR_ERR_ARG;
+
+	if (name[0] == '/')
+		shm_name = g_strdup(name);
+	else
+		shm_name = g_strdup_printf("/%s", name);
+
+	r = g_malloc0(sizeof(struct sr_shmring_reader));
+	r->fd = shm_open(shm_name, O_RDONLY, 0);
+	if (r->fd < 0) {
+		sr_err("Failed to open shared memory object '%s': %s.",
+			shm_name, g_strerror(errno));
+		g_free(shm_name);
+		g_free(r);
+		return SR_ERR;
+	}
+	g_free(shm_name);
+
+	if (fstat(r->fd, &st) < 0 || st.st_size < SHMRING_HEADER_SIZE) {
+		sr_err("Shared memory object is too small.");
+		goto err_close;
+	}
+
+	r->map_size = st.st_size;
+	r->map = mmap(NULL, r->map_size, PROT_READ, MAP_SHARED, r->fd, 0);
+	if (r->map == MAP_FAILED) {
+		sr_err("Failed to map shared memory object: %s.",
+			g_strerror(errno));
+		goto err_close;
+	}
+
+	hdr = (struct shmring_header *)r->map;
+	if (memcmp(hdr->magic, SHMRING_MAGIC, sizeof(hdr->magic))
+			|| hdr->version != SHMRING_VERSION
+			|| hdr->header_size + hdr->data_size != r->map_size
+			|| hdr->num_channels > SHMRING_MAX_CHANNELS) {
+		sr_err("Not a shmring shared memory object.");
+		munmap(r->map, r->map_size);
+		goto err_close;
+	}
+
+	r->hdr = hdr;
+	r->data = r->map + hdr->header_size;
+	r->data_size = hdr->data_size;
+	r->read_pos = load_pos(&hdr->write_pos);
+	r->next_seq = -1;
+	r->buf = g_malloc(r->data_size);
+	r->channels = g_malloc(SHMRING_MAX_CHANNELS * sizeof(*r->channels));
+
+	*reader = r;
+
+	return SR_OK;
+
+err_close:
+	close(r->fd);
+	g_free(r);
+
+	return SR_ERR;
+#else
+	(void)reader;
+	(void)name;
+
+	return SR_ERR_NA;
+#endif
+}
+
+/**
+ * Get the stream properties announced by the producer.
+ *
+ * The returned data is owned by the reader, and is valid until the next
+ * call to this function or sr_shmring_reader_close().
+ *
+ * @param reader The reader. Must not be NULL.
+ *
+ * @return The stream properties, or NULL on error.
+ *
+ * @since 0.5.0
+ */
+SR_API const struct sr_shmring_info *sr_shmring_reader_info(
+		struct sr_shmring_reader *reader)
+{
+#ifdef HAVE_SHMRING
+	if (!reader)
+		return NULL;
+
+	reader->info.samplerate = reader->hdr->samplerate;
+	reader->info.unitsize = reader->hdr->unitsize;
+	reader->info.num_channels = reader->hdr->num_channels;
+	memcpy(reader->channels, reader->hdr->channels,
+		reader->info.num_channels * sizeof(*reader->channels));
+	reader->info.channels = reader->channels;
+
+	return &reader->info;
+#else
+	(void)reader;
+
+	return NULL;
+#endif
+}
+
+/**
+ * Read the next record from a shared-memory ring.
+ *
+ * If the reader fell so far behind that the producer overwrote records it
+ * had not read yet, it skips ahead to the newest data. The number of
+ * records skipped is reported in the lost field of the next record.
+ *
+ * @param reader The reader. Must not be NULL.
+ * @param record Will be filled with the record. Must not be NULL.
+ * @param timeout_ms Maximum time to wait for a record, in milliseconds.
+ *                   0 returns immediately, -1 waits forever.
+ *
+ * @retval SR_OK A record was read.
+ * @retval SR_ERR_TIMEOUT No record arrived within the timeout.
+ * @retval SR_ERR_ARG Invalid arguments.
+ * @retval SR_ERR_NA Shared memory is not supported on this platform.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_shmring_read(struct sr_shmring_reader *reader,
+		struct sr_shmring_record *record, int timeout_ms)
+{
+#ifdef HAVE_SHMRING
+	struct shmring_header *hdr;
+	struct shmring_record_hdr rec;
+	uint64_t write_pos;
+	int64_t deadline;
+
+	if (!reader || !record)
+		return SR_ERR_ARG;
+
+	hdr = reader->hdr;
+	deadline = g_get_monotonic_time() + (int64_t)timeout_ms * 1000;
+
+	for (;;) {
+		write_pos = load_pos(&hdr->write_pos);
+
+		if (write_pos == reader->read_pos) {
+			if (timeout_ms >= 0 && g_get_monotonic_time() >= deadline)
+				return SR_ERR_TIMEOUT;
+			g_usleep(SHMRING_POLL_US);
+			continue;
+		}
+
+		if (write_pos - reader->read_pos <= reader->data_size) {
+			ring_copy_out(reader->data, reader->data_size,
+				reader->read_pos, &rec, sizeof(rec));
+			if (rec.length <= reader->data_size - sizeof(rec))
+				ring_copy_out(reader->data, reader->data_size,
+					reader->read_pos + sizeof(rec),
+					reader->buf, rec.length);
+
+			/* Did the producer start overwriting what we copied? */
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (load_pos(&hdr->reserve_pos) - reader->read_pos
+					<= reader->data_size)
+				break;
+		}
+
+		/* Overrun: continue with the newest record. */
+		sr_dbg("Reader overrun, skipping to newest data.");
+		reader->read_pos = load_pos(&hdr->write_pos);
+	}
+
+	reader->read_pos += SHMRING_ALIGN(sizeof(rec) + rec.length);
+
+	memset(record, 0, sizeof(*record));
+	record->type = rec.type;
+	record->seq = rec.seq;
+	if (reader->next_seq >= 0)
+		record->lost = rec.seq - reader->next_seq;
+	record->unitsize = rec.unitsize;
+	record->channel = rec.channel;
+	record->num_channels = rec.num_channels;
+	record->mq = rec.mq;
+	record->unit = rec.unit;
+	record->mqflags = rec.mqflags;
+	record->data = reader->buf;
+	record->length = rec.length;
+
+	reader->next_seq = rec.seq + 1;
+
+	return SR_OK;
+#else
+	(void)reader;
+	(void)record;
+	(void)timeout_ms;
+
+	return SR_ERR_NA;
+#endif
+}
+
+/**
+ * Detach from a shared-memory ring and free the reader.
+ *
+ * @param reader The reader. May be NULL.
+ *
+ * @since 0.5.0
+ */
+SR_API void sr_shmring_reader_close(struct sr_shmring_reader *reader)
+{
+#ifdef HAVE_SHMRING
+	if (!reader)
+		return;
+
+	munmap(reader->map, reader->map_size);
+	close(reader->fd);
+	g_free(reader->buf);
+	g_free(reader->channels);
+	g_free(reader);
+#else
+	(void)reader;
+#endif
+}
+
+/** @} */
+
+SR_PRIV struct sr_output_module output_shmring = {
+	.id = "shmring",
+	.name = "Shared memory ring",
+	.desc = "Live samples in a shared memory ring buffer",
+	.exts = NULL,
+	.flags = SR_OUTPUT_INTERNAL_IO_HANDLING,
+	.options = get_options,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
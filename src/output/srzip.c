@@ -29,20 +29,55 @@
 
 #define LOG_PREFIX "output/srzip"
 
+/* Largest chunk of zero samples written in place of lost samples. */
+#define GAP_CHUNK_SIZE (4 * 1024 * 1024)
+
+/*
+ * Logic chunks with few transitions are stored as transition lists, in
+ * a "logic-1-N.edges" entry in place of "logic-1-N". Such a list is:
+ *
+ *  - the number of samples in the chunk, as a little endian u64,
+ *  - the first sample (unitsize bytes),
+ *  - for every sample differing from the one before it, the distance in
+ *    samples from the previous transition (or the start of the chunk)
+ *    as an unsigned LEB128 number, followed by the new sample.
+ *
+ * A chunk is stored this way if its list takes at most this fraction of
+ * the raw samples' size. Files with transition lists are version 3.
+ */
+#define EDGES_SIZE_DIVISOR 4
+
+/* Longest unsigned LEB128 encoding of a 64-bit number. */
+#define LEB128_MAX_LEN 10
+
 struct out_context {
 	gboolean zip_created;
 	uint64_t samplerate;
 	char *filename;
 	gint first_analog_index;
 	gint *analog_index_map;
+	unsigned int num_analog_channels;
+	/* Chunks written per analog channel, to number the next one. */
+	unsigned int *analog_chunks;
+	/* Logic unitsize, as seen in the data or derived from the channels. */
+	int unitsize;
+	/* Store sparse logic chunks as transition lists. */
+	gboolean transitions;
+	/* The "version" entry says 3 already. */
+	gboolean version_3;
+	/* Samples written, recorded in the metadata at the end. */
+	uint64_t logic_samples;
+	uint64_t *analog_samples;
+	/* Decimal digits per analog channel, G_MININT if none were seen. */
+	int *analog_digits;
+	/* Gaps seen, as "start:length" strings, recorded at the end. */
+	GPtrArray *gaps;
 };
 
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct out_context *outc;
 
-	(void)options;
-
 	if (!o->filename || o->filename[0] == '\0') {
 		sr_info("srzip output module requires a file name, cannot save.");
 		return SR_ERR_ARG;
@@ -50,6 +85,9 @@ static int init(struct sr_output *o, GHashTable *options)
 
 	outc = g_malloc0(sizeof(struct out_context));
 	outc->filename = g_strdup(o->filename);
+	outc->transitions = g_variant_get_boolean(g_hash_table_lookup(options,
+			"transitions"));
+	outc->gaps = g_ptr_array_new_with_free_func(g_free);
 	o->priv = outc;
 
 	return SR_OK;
@@ -129,6 +167,7 @@ static int zip_create(const struct sr_output *o)
 
 	/* Only set capturefile and probes if we will actually save logic data. */
 	if (enabled_logic_channels > 0) {
+		outc->unitsize = (logic_channels + 7) / 8;
 		g_key_file_set_string(meta, devgroup, "capturefile", "logic-1");
 		g_key_file_set_integer(meta, devgroup, "total probes", logic_channels);
 	}
@@ -139,9 +178,14 @@ static int zip_create(const struct sr_output *o)
 
 	g_key_file_set_integer(meta, devgroup, "total analog", enabled_analog_channels);
 
-	/* Make the array one entry larger than needed so we can use the final
-	 * 0 as terminator. */
+	/* Channel index 0 is valid, so the arrays carry their own count. */
+	outc->num_analog_channels = enabled_analog_channels;
 	outc->analog_index_map = g_malloc0(sizeof(gint) * (enabled_analog_channels + 1));
+	outc->analog_chunks = g_malloc0(sizeof(unsigned int) * (enabled_analog_channels + 1));
+	outc->analog_samples = g_malloc0(sizeof(uint64_t) * (enabled_analog_channels + 1));
+	outc->analog_digits = g_malloc(sizeof(int) * (enabled_analog_channels + 1));
+	for (index = 0; index <= enabled_analog_channels; index++)
+		outc->analog_digits[index] = G_MININT;
 
 	index = 0;
 	for (l = o->sdi->channels; l; l = l->next) {
@@ -187,6 +231,86 @@ static int zip_create(const struct sr_output *o)
 	return SR_OK;
 }
 
+/* Index of the first sample from i on which differs from its predecessor. */
+static uint64_t next_transition(const uint8_t *buf, int unitsize,
+		uint64_t i, uint64_t num_samples)
+{
+	if (unitsize == 1) {
+		while (i < num_samples && buf[i] == buf[i - 1])
+			i++;
+	} else {
+		while (i < num_samples && !memcmp(buf + i * unitsize,
+				buf + (i - 1) * unitsize, unitsize))
+			i++;
+	}
+
+	return i;
+}
+
+/*
+ * Encode a chunk of logic samples as a transition list. Returns NULL if
+ * the list would be too large to be worth it.
+ */
+static uint8_t *edges_encode(const uint8_t *buf, int unitsize, int length,
+		size_t *edges_len)
+{
+	uint8_t *edges;
+	uint64_t num_samples, i, last, delta;
+	size_t max_len, pos;
+
+	num_samples = length / unitsize;
+	max_len = length / EDGES_SIZE_DIVISOR;
+	if (num_samples < 2 || max_len < 8 + (size_t)unitsize)
+		return NULL;
+
+	edges = g_malloc(max_len);
+	for (i = 0; i < 8; i++)
+		edges[i] = (num_samples >> (i * 8)) & 0xff;
+	memcpy(edges + 8, buf, unitsize);
+	pos = 8 + unitsize;
+
+	last = 0;
+	i = 1;
+	while ((i = next_transition(buf, unitsize, i, num_samples)) < num_samples) {
+		if (pos + LEB128_MAX_LEN + unitsize > max_len) {
+			g_free(edges);
+			return NULL;
+		}
+		delta = i - last;
+		while (delta >= 0x80) {
+			edges[pos++] = (delta & 0x7f) | 0x80;
+			delta >>= 7;
+		}
+		edges[pos++] = delta;
+		memcpy(edges + pos, buf + i * unitsize, unitsize);
+		pos += unitsize;
+		last = i++;
+	}
+	*edges_len = pos;
+
+	return edges;
+}
+
+/* Mark the file as containing transition lists. */
+static int zip_set_version_3(struct zip *archive)
+{
+	struct zip_source *versrc;
+	int64_t index;
+
+	if ((index = zip_name_locate(archive, "version", 0)) < 0) {
+		sr_err("No version in zipfile.");
+		return SR_ERR;
+	}
+	versrc = zip_source_buffer(archive, "3", 1, FALSE);
+	if (zip_replace(archive, index, versrc) < 0) {
+		sr_err("Failed to replace version: %s", zip_strerror(archive));
+		zip_source_free(versrc);
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
 static int zip_append(const struct sr_output *o, unsigned char *buf,
 		int unitsize, int length)
 {
@@ -204,6 +328,8 @@ static int zip_append(const struct sr_output *o, unsigned char *buf,
 	gsize metalen;
 	char *chunkname;
 	unsigned int next_chunk_num;
+	uint8_t *edges;
+	size_t edges_len;
 
 	outc = o->priv;
 	if (!(archive = zip_open(outc->filename, 0, NULL)))
@@ -281,115 +407,279 @@ static int zip_append(const struct sr_output *o, unsigned char *buf,
 		sr_warn("Chunk size %d not a multiple of the"
 			" unit size %d.", length, unitsize);
 	}
-	logicsrc = zip_source_buffer(archive, buf, length, FALSE);
-	chunkname = g_strdup_printf("logic-1-%u", next_chunk_num);
+	edges = NULL;
+	if (outc->transitions)
+		edges = edges_encode(buf, unitsize, length, &edges_len);
+	if (edges && !outc->version_3 && zip_set_version_3(archive) != SR_OK) {
+		zip_discard(archive);
+		g_free(edges);
+		g_free(metabuf);
+		return SR_ERR;
+	}
+	if (edges) {
+		logicsrc = zip_source_buffer(archive, edges, edges_len, FALSE);
+		chunkname = g_strdup_printf("logic-1-%u" SR_SESSIONFILE_EDGES_SUFFIX,
+				next_chunk_num);
+	} else {
+		logicsrc = zip_source_buffer(archive, buf, length, FALSE);
+		chunkname = g_strdup_printf("logic-1-%u", next_chunk_num);
+	}
 	i = zip_add(archive, chunkname, logicsrc);
-	g_free(chunkname);
 	if (i < 0) {
-		sr_err("Failed to add chunk 'logic-1-%u': %s",
-			next_chunk_num, zip_strerror(archive));
+		sr_err("Failed to add chunk '%s': %s", chunkname,
+			zip_strerror(archive));
 		zip_source_free(logicsrc);
 		zip_discard(archive);
+		g_free(chunkname);
+		g_free(edges);
 		g_free(metabuf);
 		return SR_ERR;
 	}
+	g_free(chunkname);
 	if (zip_close(archive) < 0) {
 		sr_err("Error saving session file: %s", zip_strerror(archive));
 		zip_discard(archive);
+		g_free(edges);
 		g_free(metabuf);
 		return SR_ERR;
 	}
+	if (edges)
+		outc->version_3 = TRUE;
+	g_free(edges);
 	g_free(metabuf);
+	outc->logic_samples += length / unitsize;
 
 	return SR_OK;
 }
 
-static int zip_append_analog(const struct sr_output *o,
-		const struct sr_datafeed_analog *analog)
+/* Position of an analog channel in analog_index_map, or -1. */
+static int analog_slot(const struct out_context *outc,
+		const struct sr_channel *ch)
+{
+	unsigned int i;
+
+	for (i = 0; i < outc->num_analog_channels; i++)
+		if (outc->analog_index_map[i] == ch->index)
+			return i;
+
+	return -1;
+}
+
+/*
+ * Add one chunk per plane, all in a single pass over the archive. The
+ * float buffers must stay around until zip_close() has read them.
+ */
+static int zip_append_planes(const struct sr_output *o,
+		const struct sr_analog_plane *planes, unsigned int num_planes,
+		uint32_t num_samples)
 {
 	struct out_context *outc;
 	struct zip *archive;
 	struct zip_source *analogsrc;
-	int64_t i, num_files;
-	struct zip_stat zs;
-	uint64_t chunk_num;
-	const char *entry_name;
-	char *basename;
-	gsize baselen;
-	struct sr_channel *channel;
-	float *chunkbuf;
+	const struct sr_analog_plane *plane;
+	float **chunkbufs;
 	gsize chunksize;
 	char *chunkname;
-	unsigned int next_chunk_num, index;
+	int *slots, ret;
+	unsigned int k;
 
 	outc = o->priv;
-	if (!(archive = zip_open(outc->filename, 0, NULL)))
-		return SR_ERR;
 
-	if (zip_stat(archive, "metadata", 0, &zs) < 0) {
-		sr_err("Failed to open metadata: %s", zip_strerror(archive));
-		zip_discard(archive);
-		return SR_ERR;
+	/* When reading the file, analog channels must be consecutive.
+	 * Thus we need a global channel index map as we don't know in
+	 * which order the channel data comes in. */
+	slots = g_malloc(sizeof(int) * num_planes);
+	for (k = 0; k < num_planes; k++) {
+		if ((slots[k] = analog_slot(outc, planes[k].channel)) < 0) {
+			g_free(slots);
+			return SR_ERR_ARG;  /* Channel index was not in the list */
+		}
 	}
 
-	/* TODO: support packets covering multiple channels */
-	if (g_slist_length(analog->meaning->channels) != 1) {
-		sr_err("Analog packets covering multiple channels not supported yet");
+	if (!(archive = zip_open(outc->filename, 0, NULL))) {
+		g_free(slots);
 		return SR_ERR;
 	}
-	channel = analog->meaning->channels->data;
 
-	/* When reading the file, analog channels must be consecutive.
-	 * Thus we need a global channel index map as we don't know in
-	 * which order the channel data comes in. */
-	for (index = 0; outc->analog_index_map[index]; index++)
-		if (outc->analog_index_map[index] == channel->index)
+	chunksize = sizeof(float) * num_samples;
+	chunkbufs = g_malloc0(sizeof(float *) * num_planes);
+	ret = SR_OK;
+	for (k = 0; k < num_planes && ret == SR_OK; k++) {
+		plane = &planes[k];
+		if (!(chunkbufs[k] = g_try_malloc(chunksize))) {
+			ret = SR_ERR_MALLOC;
+			break;
+		}
+		if ((ret = sr_analog_plane_to_float(plane, num_samples,
+				chunkbufs[k])) != SR_OK)
 			break;
-	if (!outc->analog_index_map[index])
-		return SR_ERR_ARG;  /* Channel index was not in the list */
-
-	index += outc->first_analog_index;
 
-	basename = g_strdup_printf("analog-1-%u", index);
-	baselen = strlen(basename);
-	next_chunk_num = 1;
-	num_files = zip_get_num_entries(archive, 0);
-	for (i = 0; i < num_files; i++) {
-		entry_name = zip_get_name(archive, i, 0);
-		if (!entry_name || strncmp(entry_name, basename, baselen) != 0) {
-			continue;
-		} else if (entry_name[baselen] == '-') {
-			chunk_num = g_ascii_strtoull(entry_name + baselen + 1, NULL, 10);
-			if (chunk_num < G_MAXINT && chunk_num >= next_chunk_num)
-				next_chunk_num = chunk_num + 1;
+		outc->analog_chunks[slots[k]]++;
+		outc->analog_samples[slots[k]] += num_samples;
+		if (plane->encoding->is_digits_decimal)
+			outc->analog_digits[slots[k]] = plane->encoding->digits;
+
+		analogsrc = zip_source_buffer(archive, chunkbufs[k],
+				chunksize, FALSE);
+		chunkname = g_strdup_printf("analog-1-%u-%u",
+				outc->first_analog_index + slots[k],
+				outc->analog_chunks[slots[k]]);
+		if (zip_add(archive, chunkname, analogsrc) < 0) {
+			sr_err("Failed to add chunk '%s': %s", chunkname,
+				zip_strerror(archive));
+			zip_source_free(analogsrc);
+			ret = SR_ERR;
 		}
+		g_free(chunkname);
+	}
+
+	if (ret != SR_OK) {
+		zip_discard(archive);
+	} else if (zip_close(archive) < 0) {
+		sr_err("Error saving session file: %s", zip_strerror(archive));
+		zip_discard(archive);
+		ret = SR_ERR;
+	}
+
+	for (k = 0; k < num_planes; k++)
+		g_free(chunkbufs[k]);
+	g_free(chunkbufs);
+	g_free(slots);
+
+	return ret;
+}
+
+/* Interleaved packets are written as one strided plane per channel. */
+static int zip_append_analog(const struct sr_output *o,
+		const struct sr_datafeed_analog *analog)
+{
+	struct sr_analog_plane *planes;
+	unsigned int k, num_planes, unitsize;
+	GSList *l;
+	int ret;
+
+	num_planes = g_slist_length(analog->meaning->channels);
+	unitsize = analog->encoding->unitsize;
+	planes = g_malloc0(sizeof(struct sr_analog_plane) * num_planes);
+	for (l = analog->meaning->channels, k = 0; l; l = l->next, k++) {
+		planes[k].channel = l->data;
+		planes[k].data = (uint8_t *)analog->data + k * unitsize;
+		planes[k].stride = num_planes * unitsize;
+		planes[k].encoding = analog->encoding;
+		planes[k].meaning = analog->meaning;
+		planes[k].spec = analog->spec;
 	}
+	ret = zip_append_planes(o, planes, num_planes, analog->num_samples);
+	g_free(planes);
 
-	chunksize = sizeof(float) * analog->num_samples;
-	if (!(chunkbuf = g_try_malloc(chunksize)))
+	return ret;
+}
+
+/*
+ * Record the number of samples written in the metadata, so that readers
+ * don't have to go through the data for it.
+ *
+ * Gaps go in as a list of "start:length" entries in the "gaps" key, all
+ * at once rather than rewriting the archive for each of them. Readers
+ * which don't know about gaps ignore the key.
+ */
+static int zip_record_totals(const struct sr_output *o)
+{
+	struct out_context *outc;
+	struct zip *archive;
+	struct zip_source *metasrc;
+	struct zip_stat zs;
+	GKeyFile *kf;
+	uint64_t analog_samples;
+	unsigned int i;
+	char *metabuf, *key;
+	gsize metalen;
+
+	outc = o->priv;
+	if (!(archive = zip_open(outc->filename, 0, NULL)))
 		return SR_ERR;
-	if (sr_analog_to_float(analog, chunkbuf) != SR_OK)
+
+	if (zip_stat(archive, "metadata", 0, &zs) < 0) {
+		sr_err("Failed to open metadata: %s", zip_strerror(archive));
+		zip_discard(archive);
 		return SR_ERR;
+	}
+	kf = sr_sessionfile_read_metadata(archive, &zs);
+	if (!kf) {
+		zip_discard(archive);
+		return SR_ERR_DATA;
+	}
 
-	analogsrc = zip_source_buffer(archive, chunkbuf, chunksize, FALSE);
-	chunkname = g_strdup_printf("%s-%u", basename, next_chunk_num);
-	i = zip_add(archive, chunkname, analogsrc);
-	g_free(chunkname);
-	if (i < 0) {
-		sr_err("Failed to add chunk '%s': %s", chunkname, zip_strerror(archive));
-		zip_source_free(analogsrc);
+	analog_samples = 0;
+	for (i = 0; i < outc->num_analog_channels; i++)
+		analog_samples = MAX(analog_samples, outc->analog_samples[i]);
+	g_key_file_set_uint64(kf, "device 1", SR_SESSIONFILE_LOGIC_SAMPLES,
+			outc->logic_samples);
+	g_key_file_set_uint64(kf, "device 1", SR_SESSIONFILE_ANALOG_SAMPLES,
+			analog_samples);
+	for (i = 0; i < outc->num_analog_channels; i++) {
+		if (outc->analog_digits[i] == G_MININT)
+			continue;
+		key = g_strdup_printf(SR_SESSIONFILE_ANALOG_DIGITS "%u",
+				outc->first_analog_index + i);
+		g_key_file_set_integer(kf, "device 1", key,
+				outc->analog_digits[i]);
+		g_free(key);
+	}
+	if (outc->gaps->len > 0)
+		g_key_file_set_string_list(kf, "device 1", "gaps",
+				(const gchar * const *)outc->gaps->pdata,
+				outc->gaps->len);
+
+	metabuf = g_key_file_to_data(kf, &metalen, NULL);
+	g_key_file_free(kf);
+	metasrc = zip_source_buffer(archive, metabuf, metalen, FALSE);
+	if (zip_replace(archive, zs.index, metasrc) < 0) {
+		sr_err("Failed to replace metadata: %s", zip_strerror(archive));
+		zip_source_free(metasrc);
 		zip_discard(archive);
+		g_free(metabuf);
 		return SR_ERR;
 	}
 	if (zip_close(archive) < 0) {
 		sr_err("Error saving session file: %s", zip_strerror(archive));
 		zip_discard(archive);
+		g_free(metabuf);
 		return SR_ERR;
 	}
+	g_free(metabuf);
 
 	return SR_OK;
 }
 
+/*
+ * Write all-zero logic samples in place of lost ones, so that the
+ * samples after the gap keep their position in the file.
+ */
+static int zip_append_gap(const struct sr_output *o, uint64_t num_samples)
+{
+	struct out_context *outc;
+	unsigned char *buf;
+	uint64_t chunk_samples, n;
+	int ret;
+
+	outc = o->priv;
+	if (!outc->unitsize)
+		return SR_OK;
+
+	chunk_samples = MIN(num_samples, GAP_CHUNK_SIZE / outc->unitsize);
+	buf = g_malloc0(chunk_samples * outc->unitsize);
+	ret = SR_OK;
+	while (num_samples > 0 && ret == SR_OK) {
+		n = MIN(num_samples, chunk_samples);
+		ret = zip_append(o, buf, outc->unitsize, n * outc->unitsize);
+		num_samples -= n;
+	}
+	g_free(buf);
+
+	return ret;
+}
+
 static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
 		GString **out)
 {
@@ -397,6 +687,8 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_analog_planar *planar;
+	const struct sr_datafeed_gap *gap;
 	const struct sr_config *src;
 	GSList *l;
 
@@ -423,6 +715,7 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			outc->zip_created = TRUE;
 		}
 		logic = packet->payload;
+		outc->unitsize = logic->unitsize;
 		ret = zip_append(o, logic->data, logic->unitsize, logic->length);
 		if (ret != SR_OK)
 			return ret;
@@ -438,19 +731,48 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		if (ret != SR_OK)
 			return ret;
 		break;
+	case SR_DF_ANALOG_PLANAR:
+		if (!outc->zip_created) {
+			if ((ret = zip_create(o)) != SR_OK)
+				return ret;
+			outc->zip_created = TRUE;
+		}
+		planar = packet->payload;
+		ret = zip_append_planes(o, planar->planes, planar->num_planes,
+				planar->num_samples);
+		if (ret != SR_OK)
+			return ret;
+		break;
+	case SR_DF_GAP:
+		if (!outc->zip_created) {
+			if ((ret = zip_create(o)) != SR_OK)
+				return ret;
+			outc->zip_created = TRUE;
+		}
+		gap = packet->payload;
+		g_ptr_array_add(outc->gaps, g_strdup_printf("%" PRIu64
+				":%" PRIu64, gap->start, gap->length));
+		if ((ret = zip_append_gap(o, gap->length)) != SR_OK)
+			return ret;
+		break;
+	case SR_DF_END:
+		if (outc->zip_created && (ret = zip_record_totals(o)) != SR_OK)
+			return ret;
+		break;
 	}
 
 	return SR_OK;
 }
 
 static struct sr_option options[] = {
+	{ "transitions", "Transitions", "Store sparse logic as transition lists", NULL, NULL },
 	ALL_ZERO
 };
 
 static const struct sr_option *get_options(void)
 {
 	if (!options[0].def)
-		options[0].def = g_variant_ref_sink(g_variant_new_string(""));
+		options[0].def = g_variant_ref_sink(g_variant_new_boolean(TRUE));
 
 	return options;
 }
@@ -462,6 +784,10 @@ static int cleanup(struct sr_output *o)
 	outc = o->priv;
 	g_variant_unref(options[0].def);
 	g_free(outc->analog_index_map);
+	g_free(outc->analog_chunks);
+	g_free(outc->analog_samples);
+	g_free(outc->analog_digits);
+	g_ptr_array_free(outc->gaps, TRUE);
 	g_free(outc->filename);
 	g_free(outc);
 	o->priv = NULL;
@@ -474,7 +800,7 @@ SR_PRIV struct sr_output_module output_srzip = {
 	.name = "srzip",
 	.desc = "srzip session file",
 	.exts = (const char*[]){"sr", NULL},
-	.flags = SR_OUTPUT_INTERNAL_IO_HANDLING,
+	.flags = SR_OUTPUT_INTERNAL_IO_HANDLING | SR_OUTPUT_ANALOG_PLANAR,
 	.options = get_options,
 	.init = init,
 	.receive = receive,
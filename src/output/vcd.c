@@ -37,6 +37,8 @@ struct context {
 	int *channel_index;
 	uint64_t samplerate;
 	uint64_t samplecount;
+	/* All channels are unknown after a gap, until the next sample. */
+	gboolean after_gap;
 };
 
 static int init(struct sr_output *o, GHashTable *options)
@@ -153,11 +155,24 @@ static GString *gen_header(const struct sr_output *o)
 	return header;
 }
 
+/*
+ * The time of the current sample, in timescale units. Without a known
+ * samplerate, each sample counts as one unit.
+ */
+static double sample_time(const struct context *ctx)
+{
+	if (ctx->samplerate == 0)
+		return ctx->samplecount;
+
+	return (double)ctx->samplecount / ctx->samplerate * ctx->period;
+}
+
 static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
 		GString **out)
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_gap *gap;
 	const struct sr_config *src;
 	GSList *l;
 	struct context *ctx;
@@ -209,14 +224,14 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 						>> (index % 8)) & 1;
 
 				/* VCD only contains deltas/changes of signals. */
-				if (prevbit == curbit && ctx->samplecount > 0)
+				if (prevbit == curbit && ctx->samplecount > 0
+						&& !ctx->after_gap)
 					continue;
 
 				/* Output timestamp of subsequent signal changes. */
 				if (!timestamp_written)
 					g_string_append_printf(*out, "#%.0f",
-						(double)ctx->samplecount /
-							ctx->samplerate * ctx->period);
+						sample_time(ctx));
 
 				/* Output which signal changed to which value. */
 				g_string_append_c(*out, ' ');
@@ -230,14 +245,37 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 				g_string_append_c(*out, '\n');
 
 			ctx->samplecount++;
+			ctx->after_gap = FALSE;
 			memcpy(ctx->prevsample, sample, logic->unitsize);
 		}
 		break;
+	case SR_DF_GAP:
+		gap = packet->payload;
+
+		if (!ctx->header_done) {
+			*out = gen_header(o);
+			ctx->header_done = TRUE;
+		} else {
+			*out = g_string_sized_new(512);
+		}
+
+		/* The signals are unknown for the duration of the gap. */
+		g_string_append_printf(*out, "$comment %" PRIu64
+				" samples lost $end\n", gap->length);
+		g_string_append_printf(*out, "#%.0f", sample_time(ctx));
+		for (p = 0; p < ctx->num_enabled_channels; p++) {
+			g_string_append(*out, " x");
+			g_string_append_c(*out, '!' + p);
+		}
+		g_string_append_c(*out, '\n');
+
+		ctx->samplecount += gap->length;
+		ctx->after_gap = TRUE;
+		break;
 	case SR_DF_END:
 		/* Write final timestamp as length indicator. */
 		*out = g_string_sized_new(512);
-		g_string_printf(*out, "#%.0f\n",
-				(double)ctx->samplecount / ctx->samplerate * ctx->period);
+		g_string_printf(*out, "#%.0f\n", sample_time(ctx));
 		break;
 	}
 
@@ -18,6 +18,7 @@
  */
 
 #include <config.h>
+#include <limits.h>
 #include <string.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
@@ -27,63 +28,313 @@
 /* Minimum/maximum number of samples per channel to put in a data chunk */
 #define MIN_DATA_CHUNK_SAMPLES 10
 
+/*
+ * Initial and maximum number of samples per channel to hold back while
+ * waiting for the other channels' data. The staging area grows as
+ * needed; a channel which falls further behind than the maximum is an
+ * error.
+ */
+#define MIN_STAGED_SAMPLES 4096
+#define MAX_STAGED_SAMPLES (16 * 1024 * 1024)
+
+enum sample_format {
+	FORMAT_FLOAT32,
+	FORMAT_PCM16,
+	FORMAT_PCM24,
+};
+
+static const struct {
+	const char *name;
+	int unitsize;
+} sample_formats[] = {
+	[FORMAT_FLOAT32] = { "float32", 4 },
+	[FORMAT_PCM16] = { "pcm16", 2 },
+	[FORMAT_PCM24] = { "pcm24", 3 },
+};
+
 struct out_context {
 	double scale;
+	enum sample_format format;
+	int unitsize;
 	gboolean header_done;
 	uint64_t samplerate;
 	int num_channels;
 	GSList *channels;
-	int chanbuf_size;
+	/* Staging for packets which don't carry all channels, in output format. */
 	int *chanbuf_used;
+	int *chanbuf_size;
 	uint8_t **chanbuf;
 	float *fdata;
+	int *chan_idx;
 };
 
-static int realloc_chanbufs(const struct sr_output *o, int size)
+/*
+ * A packet's samples: converted to floats for float input, as sent in
+ * the packet for integer input.
+ */
+struct sample_src {
+	const float *fdata;
+	const struct sr_analog_encoding *encoding;
+	const uint8_t *data;
+};
+
+/*
+ * Converts num_samples floats taken 'src_stride' floats apart to the
+ * output format, storing them 'stride' bytes apart. The loops are kept
+ * free of function calls and branches on the sample values, so the
+ * compiler can vectorize them.
+ */
+static void convert_samples(const struct out_context *outc, uint8_t *dst,
+		int stride, const float *src, int src_stride, int num_samples)
 {
-	struct out_context *outc;
+	float gain, v;
+	int32_t code;
 	int i;
 
-	outc = o->priv;
-	for (i = 0; i < outc->num_channels; i++) {
-		if (!(outc->chanbuf[i] = g_try_realloc(outc->chanbuf[i], sizeof(float) * size))) { 
-			sr_err("Unable to allocate enough output buffer memory.");
-			return SR_ERR;
+	gain = outc->scale != 0.0 ? 1.0 / outc->scale : 1.0;
+
+	switch (outc->format) {
+	case FORMAT_FLOAT32:
+		for (i = 0; i < num_samples; i++)
+			WLFL(dst + i * stride, src[i * src_stride] * gain);
+		break;
+	case FORMAT_PCM16:
+		gain *= INT16_MAX;
+		for (i = 0; i < num_samples; i++) {
+			v = src[i * src_stride] * gain;
+			v = v > INT16_MAX ? INT16_MAX : v;
+			v = v < INT16_MIN ? INT16_MIN : v;
+			code = (int32_t)(v + (v < 0 ? -0.5f : 0.5f));
+			WL16(dst + i * stride, code);
 		}
-		outc->chanbuf_used[i] = 0;
+		break;
+	case FORMAT_PCM24:
+		gain *= 0x7fffff;
+		for (i = 0; i < num_samples; i++) {
+			v = src[i * src_stride] * gain;
+			v = v > 0x7fffff ? 0x7fffff : v;
+			v = v < -0x800000 ? -0x800000 : v;
+			code = (int32_t)(v + (v < 0 ? -0.5f : 0.5f));
+			dst[i * stride] = code & 0xff;
+			dst[i * stride + 1] = (code >> 8) & 0xff;
+			dst[i * stride + 2] = (code >> 16) & 0xff;
+		}
+		break;
 	}
-	outc->chanbuf_size = size;
+}
 
-	return SR_OK;
+/* Reads an integer sample of 1, 2, 3, 4 or 8 bytes. */
+static inline int64_t read_int(const struct sr_analog_encoding *enc,
+		const uint8_t *p)
+{
+	switch (enc->unitsize) {
+	case 1:
+		return enc->is_signed ? (int8_t)p[0] : p[0];
+	case 2:
+		if (enc->is_bigendian)
+			return enc->is_signed ? RB16S(p) : RB16(p);
+		return enc->is_signed ? RL16S(p) : RL16(p);
+	case 3:
+		if (enc->is_bigendian)
+			return enc->is_signed ? RB24S(p) : RB24(p);
+		return enc->is_signed ? RL24S(p) : RL24(p);
+	case 4:
+		if (enc->is_bigendian)
+			return enc->is_signed ? RB32S(p) : RB32(p);
+		return enc->is_signed ? RL32S(p) : RL32(p);
+	default:
+		if (enc->is_bigendian)
+			return (int64_t)RB64(p);
+		return (int64_t)RL64(p);
+	}
 }
 
-static int flush_chanbufs(const struct sr_output *o, GString *out)
+/*
+ * Converts num_samples integer samples taken 'src_stride' samples apart
+ * to the output format, storing them 'stride' bytes apart. The packet's
+ * scale and offset are applied in double precision, so integer input
+ * doesn't lose resolution to a float on the way.
+ */
+static void convert_int_samples(const struct out_context *outc, uint8_t *dst,
+		int stride, const struct sr_analog_encoding *enc,
+		const uint8_t *src, int src_stride, int num_samples)
 {
-	struct out_context *outc;
-	int num_samples, i, j;
-	char *buf, *bufp;
+	double gain, scale, offset, v;
+	int32_t code;
+	int i;
 
-	outc = o->priv;
+	gain = outc->scale != 0.0 ? 1.0 / outc->scale : 1.0;
+	scale = (double)enc->scale.p / enc->scale.q * gain;
+	offset = (double)enc->offset.p / enc->offset.q * gain;
+	src_stride *= enc->unitsize;
 
-	/* Any one of them will do. */
-	num_samples = outc->chanbuf_used[0];
-	if (!(buf = g_try_malloc(4 * num_samples * outc->num_channels))) {
-		sr_err("Unable to allocate enough interleaved output buffer memory.");
-		return SR_ERR;
+	switch (outc->format) {
+	case FORMAT_FLOAT32:
+		for (i = 0; i < num_samples; i++)
+			WLFL(dst + i * stride,
+				read_int(enc, src + i * src_stride) * scale + offset);
+		break;
+	case FORMAT_PCM16:
+		scale *= INT16_MAX;
+		offset *= INT16_MAX;
+		for (i = 0; i < num_samples; i++) {
+			v = read_int(enc, src + i * src_stride) * scale + offset;
+			v = v > INT16_MAX ? INT16_MAX : v;
+			v = v < INT16_MIN ? INT16_MIN : v;
+			code = (int32_t)(v + (v < 0 ? -0.5 : 0.5));
+			WL16(dst + i * stride, code);
+		}
+		break;
+	case FORMAT_PCM24:
+		scale *= 0x7fffff;
+		offset *= 0x7fffff;
+		for (i = 0; i < num_samples; i++) {
+			v = read_int(enc, src + i * src_stride) * scale + offset;
+			v = v > 0x7fffff ? 0x7fffff : v;
+			v = v < -0x800000 ? -0x800000 : v;
+			code = (int32_t)(v + (v < 0 ? -0.5 : 0.5));
+			dst[i * stride] = code & 0xff;
+			dst[i * stride + 1] = (code >> 8) & 0xff;
+			dst[i * stride + 2] = (code >> 16) & 0xff;
+		}
+		break;
 	}
+}
 
-	bufp = buf;
-	for (i = 0; i < num_samples; i++) {
-		for (j = 0; j < outc->num_channels; j++) {
-			memcpy(bufp, outc->chanbuf[j] + i * 4, 4);
-			bufp += 4;
+/*
+ * Converts num_samples of the packet's samples, starting at the sample
+ * with index first and taking every src_stride-th one.
+ */
+static void convert_src(const struct out_context *outc, uint8_t *dst,
+		int stride, const struct sample_src *src, int first,
+		int src_stride, int num_samples)
+{
+	if (src->fdata)
+		convert_samples(outc, dst, stride, src->fdata + first,
+			src_stride, num_samples);
+	else
+		convert_int_samples(outc, dst, stride, src->encoding,
+			src->data + first * src->encoding->unitsize,
+			src_stride, num_samples);
+}
+
+/* Appends space for num_samples interleaved samples, and returns it. */
+static uint8_t *append_samples(struct out_context *outc, GString *out,
+		int num_samples)
+{
+	gsize len, size;
+
+	size = (gsize)num_samples * outc->num_channels * outc->unitsize;
+	len = out->len;
+	g_string_set_size(out, len + size);
+
+	return (uint8_t *)out->str + len;
+}
+
+/*
+ * Writes out num_samples samples per channel. At the end of the stream,
+ * channels which have less than that are filled up with silence.
+ */
+static void flush_chanbufs(struct out_context *outc, GString *out,
+		int num_samples)
+{
+	uint8_t *dst;
+	int frame, i, j, n;
+
+	if (num_samples <= 0)
+		return;
+
+	dst = append_samples(outc, out, num_samples);
+	frame = outc->num_channels * outc->unitsize;
+	for (i = 0; i < outc->num_channels; i++) {
+		n = MIN(num_samples, outc->chanbuf_used[i]);
+		if (n < num_samples)
+			sr_warn("Channel data missing, writing silence.");
+		for (j = 0; j < num_samples; j++) {
+			if (j < n)
+				memcpy(dst + j * frame + i * outc->unitsize,
+					outc->chanbuf[i] + j * outc->unitsize,
+					outc->unitsize);
+			else
+				memset(dst + j * frame + i * outc->unitsize,
+					0, outc->unitsize);
 		}
+		if (n == 0)
+			continue;
+		memmove(outc->chanbuf[i], outc->chanbuf[i] + n * outc->unitsize,
+			(outc->chanbuf_used[i] - n) * outc->unitsize);
+		outc->chanbuf_used[i] -= n;
 	}
-	g_string_append_len(out, buf, 4 * num_samples * outc->num_channels);
-	g_free(buf);
+}
 
-	for (i = 0; i < outc->num_channels; i++)
-		outc->chanbuf_used[i] = 0;
+/*
+ * Returns the number of samples staged for all channels, and whether
+ * any are staged at all.
+ */
+static int staged_samples(const struct out_context *outc, gboolean *any)
+{
+	int i, size;
+
+	size = outc->num_channels ? INT_MAX : 0;
+	*any = FALSE;
+	for (i = 0; i < outc->num_channels; i++) {
+		size = MIN(size, outc->chanbuf_used[i]);
+		if (outc->chanbuf_used[i] > 0)
+			*any = TRUE;
+	}
+
+	return size;
+}
+
+/* Makes room for num_samples more samples in a channel's staging area. */
+static int chanbuf_reserve(struct out_context *outc, int idx, int num_samples)
+{
+	uint8_t *buf;
+	int needed, size;
+
+	if (num_samples > MAX_STAGED_SAMPLES - outc->chanbuf_used[idx]) {
+		sr_err("More than %d samples waiting for other channels' data.",
+				MAX_STAGED_SAMPLES);
+		return SR_ERR;
+	}
+	needed = outc->chanbuf_used[idx] + num_samples;
+	if (needed <= outc->chanbuf_size[idx])
+		return SR_OK;
+
+	size = MAX(outc->chanbuf_size[idx], MIN_STAGED_SAMPLES);
+	while (size < needed)
+		size = MIN(size * 2, MAX_STAGED_SAMPLES);
+	buf = g_try_realloc(outc->chanbuf[idx], (gsize)size * outc->unitsize);
+	if (!buf)
+		return SR_ERR_MALLOC;
+	outc->chanbuf[idx] = buf;
+	outc->chanbuf_size[idx] = size;
+
+	return SR_OK;
+}
+
+/*
+ * Stages num_samples samples of the packet's channels, and writes out
+ * what has become available for all channels.
+ */
+static int stage_samples(struct out_context *outc, GString *out,
+		const struct sample_src *src, int num_channels, int num_samples)
+{
+	gboolean any;
+	int idx, j, size, ret;
+
+	for (j = 0; j < num_channels; j++) {
+		idx = outc->chan_idx[j];
+		if ((ret = chanbuf_reserve(outc, idx, num_samples)) != SR_OK)
+			return ret;
+		convert_src(outc, outc->chanbuf[idx]
+			+ outc->chanbuf_used[idx] * outc->unitsize,
+			outc->unitsize, src, j, num_channels, num_samples);
+		outc->chanbuf_used[idx] += num_samples;
+	}
+	size = staged_samples(outc, &any);
+	if (size > MIN_DATA_CHUNK_SAMPLES)
+		flush_chanbufs(outc, out, size);
 
 	return SR_OK;
 }
@@ -92,12 +343,28 @@ static int init(struct sr_output *o, GHashTable *options)
 {
 	struct out_context *outc;
 	struct sr_channel *ch;
+	const char *format;
+	unsigned int i;
 	GSList *l;
 
 	outc = g_malloc0(sizeof(struct out_context));
 	o->priv = outc;
 	outc->scale = g_variant_get_double(g_hash_table_lookup(options, "scale"));
 
+	format = g_variant_get_string(g_hash_table_lookup(options, "format"), NULL);
+	for (i = 0; i < ARRAY_SIZE(sample_formats); i++) {
+		if (!strcmp(format, sample_formats[i].name))
+			break;
+	}
+	if (i == ARRAY_SIZE(sample_formats)) {
+		sr_err("Unknown sample format '%s'.", format);
+		g_free(outc);
+		o->priv = NULL;
+		return SR_ERR_ARG;
+	}
+	outc->format = i;
+	outc->unitsize = sample_formats[i].unitsize;
+
 	for (l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
 		if (ch->type != SR_CHANNEL_ANALOG)
@@ -108,11 +375,10 @@ static int init(struct sr_output *o, GHashTable *options)
 		outc->num_channels++;
 	}
 
-	outc->chanbuf = g_malloc0(sizeof(float *) * outc->num_channels);
+	outc->chanbuf = g_malloc0(sizeof(uint8_t *) * outc->num_channels);
 	outc->chanbuf_used = g_malloc0(sizeof(int) * outc->num_channels);
-
-	/* Start off the interleaved buffer with 100 samples/channel. */
-	realloc_chanbufs(o, 100);
+	outc->chanbuf_size = g_malloc0(sizeof(int) * outc->num_channels);
+	outc->chan_idx = g_malloc0(sizeof(int) * outc->num_channels);
 
 	return SR_OK;
 }
@@ -127,8 +393,8 @@ static void add_data_chunk(const struct sr_output *o, GString *gs)
 	/* Remaining chunk size */
 	WL32(tmp, 0x12);
 	g_string_append_len(gs, tmp, 4);
-	/* Format code 3 = IEEE float */
-	WL16(tmp, 0x0003);
+	/* Format code 1 = PCM, 3 = IEEE float */
+	WL16(tmp, outc->format == FORMAT_FLOAT32 ? 0x0003 : 0x0001);
 	g_string_append_len(gs, tmp, 2);
 	/* Number of channels */
 	WL16(tmp, outc->num_channels);
@@ -136,14 +402,14 @@ static void add_data_chunk(const struct sr_output *o, GString *gs)
 	/* Samplerate */
 	WL32(tmp, outc->samplerate);
 	g_string_append_len(gs, tmp, 4);
-	/* Byterate, using 32-bit floats. */
-	WL32(tmp, outc->samplerate * outc->num_channels * 4);
+	/* Byterate */
+	WL32(tmp, outc->samplerate * outc->num_channels * outc->unitsize);
 	g_string_append_len(gs, tmp, 4);
 	/* Blockalign */
-	WL16(tmp, outc->num_channels * 4);
+	WL16(tmp, outc->num_channels * outc->unitsize);
 	g_string_append_len(gs, tmp, 2);
 	/* Bits per sample */
-	WL16(tmp, 32);
+	WL16(tmp, outc->unitsize * 8);
 	g_string_append_len(gs, tmp, 2);
 	WL16(tmp, 0);
 	g_string_append_len(gs, tmp, 2);
@@ -154,6 +420,14 @@ static void add_data_chunk(const struct sr_output *o, GString *gs)
 	g_string_append_len(gs, tmp, 4);
 }
 
+/*
+ * The output is streamed, so the RIFF and data chunk sizes aren't known
+ * when the header goes out. They are maxed out, which readers take as
+ * "until the end of the file". A frontend writing to a seekable file can
+ * fill them in after the capture: the RIFF size at offset 4 is the file
+ * size minus 8, the data chunk size at offset 42 is the file size minus
+ * the 46 bytes of header.
+ */
 static GString *gen_header(const struct sr_output *o)
 {
 	struct out_context *outc;
@@ -181,72 +455,21 @@ static GString *gen_header(const struct sr_output *o)
 	return header;
 }
 
-/*
- * Stores the float in little-endian BINARY32 IEEE-754 2008 format.
- */
-static void float_to_le(uint8_t *buf, float value)
-{
-	char *old;
-
-	old = (char *)&value;
-#ifdef WORDS_BIGENDIAN
-	buf[0] = old[3];
-	buf[1] = old[2];
-	buf[2] = old[1];
-	buf[3] = old[0];
-#else
-	buf[0] = old[0];
-	buf[1] = old[1];
-	buf[2] = old[2];
-	buf[3] = old[3];
-#endif
-}
-
-/*
- * Returns the number of samples used in the current channel buffers,
- * or -1 if they're not all the same.
- */
-static int check_chanbuf_size(const struct sr_output *o)
-{
-	struct out_context *outc;
-	int size, i;
-
-	outc = o->priv;
-	size = 0;
-	for (i = 0; i < outc->num_channels; i++) {
-		if (size == 0) {
-			if (outc->chanbuf_used[i] == 0) {
-				/* Nothing in all the buffers yet. */
-				size = -1;
-				break;
-			} else
-				/* New high water mark. */
-				size = outc->chanbuf_used[i];
-		} else if (outc->chanbuf_used[i] != size) {
-			/* All channel buffers are not equally full yet. */
-			size = -1;
-			break;
-		}
-	}
-
-	return size;
-}
-
 static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
 		GString **out)
 {
 	struct out_context *outc;
 	const struct sr_datafeed_meta *meta;
-	const struct sr_datafeed_analog_old *analog_old;
 	const struct sr_datafeed_analog *analog;
 	const struct sr_config *src;
 	struct sr_channel *ch;
+	struct sample_src samples;
 	GSList *l;
 	const GSList *channels;
-	float f;
-	int num_channels, num_samples, size, *chan_idx, idx, i, j, ret;
+	gboolean in_order, any;
+	int num_channels, num_samples, size, i, ret;
 	float *data;
-	uint8_t *buf;
+	uint8_t *dst;
 
 	*out = NULL;
 	if (!o || !o->sdi || !(outc = o->priv))
@@ -262,7 +485,6 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			outc->samplerate = g_variant_get_uint64(src->data);
 		}
 		break;
-	case SR_DF_ANALOG_OLD:
 	case SR_DF_ANALOG:
 		if (!outc->header_done) {
 			*out = gen_header(o);
@@ -270,24 +492,36 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		} else
 			*out = g_string_sized_new(512);
 
-		analog_old = packet->payload;
 		analog = packet->payload;
+		num_samples = analog->num_samples;
+		channels = analog->meaning->channels;
+		num_channels = g_slist_length(analog->meaning->channels);
 
-		if (packet->type == SR_DF_ANALOG_OLD) {
-			num_samples = analog_old->num_samples;
-			channels = analog_old->channels;
-			num_channels = g_slist_length(analog_old->channels);
-			data = analog_old->data;
-		} else {
-			num_samples = analog->num_samples;
-			channels = analog->meaning->channels;
-			num_channels = g_slist_length(analog->meaning->channels);
+		/* Integer samples are converted straight from the packet. */
+		memset(&samples, 0, sizeof(samples));
+		if (analog->encoding->is_float) {
 			if (!(data = g_try_realloc(outc->fdata, sizeof(float) * num_samples * num_channels)))
 				return SR_ERR_MALLOC;
 			outc->fdata = data;
 			ret = sr_analog_to_float(analog, data);
 			if (ret != SR_OK)
 				return ret;
+			samples.fdata = data;
+		} else {
+			switch (analog->encoding->unitsize) {
+			case 1: case 2: case 3: case 4: case 8:
+				break;
+			default:
+				sr_err("Unsupported sample size %d.",
+						analog->encoding->unitsize);
+				return SR_ERR;
+			}
+			if (!analog->encoding->scale.q || !analog->encoding->offset.q) {
+				sr_err("Invalid scale or offset.");
+				return SR_ERR_ARG;
+			}
+			samples.encoding = analog->encoding;
+			samples.data = analog->data;
 		}
 
 		if (num_samples == 0)
@@ -299,41 +533,41 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			return SR_ERR;
 		}
 
-		if (num_samples > outc->chanbuf_size) {
-			if (realloc_chanbufs(o, analog_old->num_samples) != SR_OK)
-				return SR_ERR_MALLOC;
-		}
-
 		/* Index the channels in this packet, so we can interleave quicker. */
-		chan_idx = g_malloc(sizeof(int) * outc->num_channels);
-		for (i = 0; i < num_channels; i++) {
-			ch = g_slist_nth_data((GSList *) channels, i);
-			chan_idx[i] = g_slist_index(outc->channels, ch);
-		}
-
-		for (i = 0; i < num_samples; i++) {
-			for (j = 0; j < num_channels; j++) {
-				idx = chan_idx[j];
-				buf = outc->chanbuf[idx] + outc->chanbuf_used[idx]++ * 4;
-				f = data[i * num_channels + j];
-				if (outc->scale != 0.0)
-					f /= outc->scale;
-				float_to_le(buf, f);
+		in_order = num_channels == outc->num_channels;
+		for (l = (GSList *)channels, i = 0; l; l = l->next, i++) {
+			ch = l->data;
+			outc->chan_idx[i] = g_slist_index(outc->channels, ch);
+			if (outc->chan_idx[i] < 0) {
+				sr_err("Packet has data for an unknown channel.");
+				return SR_ERR;
 			}
+			in_order = in_order && outc->chan_idx[i] == i;
 		}
-		g_free(chan_idx);
 
-		size = check_chanbuf_size(o);
-		if (size > MIN_DATA_CHUNK_SAMPLES)
-			if (flush_chanbufs(o, *out) != SR_OK)
-				return SR_ERR;
+		/*
+		 * Packets with all channels in order are converted straight
+		 * into the output, unless data of other packets is pending.
+		 */
+		staged_samples(outc, &any);
+		if (in_order && !any) {
+			dst = append_samples(outc, *out, num_samples);
+			convert_src(outc, dst, outc->unitsize, &samples, 0, 1,
+				num_samples * num_channels);
+		} else {
+			ret = stage_samples(outc, *out, &samples, num_channels,
+				num_samples);
+			if (ret != SR_OK)
+				return ret;
+		}
 		break;
 	case SR_DF_END:
-		size = check_chanbuf_size(o);
+		size = 0;
+		for (i = 0; i < outc->num_channels; i++)
+			size = MAX(size, outc->chanbuf_used[i]);
 		if (size > 0) {
-			*out = g_string_sized_new(4 * size * outc->num_channels);
-			if (flush_chanbufs(o, *out) != SR_OK)
-				return SR_ERR;
+			*out = g_string_sized_new(size * outc->num_channels * outc->unitsize);
+			flush_chanbufs(outc, *out, size);
 		}
 		break;
 	}
@@ -343,13 +577,23 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 
 static struct sr_option options[] = {
 	{ "scale", "Scale", "Scale values by factor", NULL, NULL },
+	{ "format", "Format", "Sample format", NULL, NULL },
 	ALL_ZERO
 };
 
 static const struct sr_option *get_options(void)
 {
-	if (!options[0].def)
+	unsigned int i;
+
+	if (!options[0].def) {
 		options[0].def = g_variant_ref_sink(g_variant_new_double(0.0));
+		options[1].def = g_variant_ref_sink(g_variant_new_string(
+				sample_formats[FORMAT_FLOAT32].name));
+		for (i = 0; i < ARRAY_SIZE(sample_formats); i++)
+			options[1].values = g_slist_append(options[1].values,
+				g_variant_ref_sink(g_variant_new_string(
+					sample_formats[i].name)));
+	}
 
 	return options;
 }
@@ -361,11 +605,12 @@ static int cleanup(struct sr_output *o)
 
 	outc = o->priv;
 	g_slist_free(outc->channels);
-	g_variant_unref(options[0].def);
 	for (i = 0; i < outc->num_channels; i++)
 		g_free(outc->chanbuf[i]);
 	g_free(outc->chanbuf_used);
+	g_free(outc->chanbuf_size);
 	g_free(outc->chanbuf);
+	g_free(outc->chan_idx);
 	g_free(outc->fdata);
 	g_free(outc);
 	o->priv = NULL;
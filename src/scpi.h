@@ -85,6 +85,11 @@ struct sr_scpi_dev_inst {
 	int (*read_begin)(void *priv);
 	int (*read_data)(void *priv, char *buf, int maxlen);
 	int (*read_complete)(void *priv);
+	/* Optional, for transports with out of band signalling. */
+	int (*clear)(void *priv);
+	int (*read_stb)(void *priv, uint8_t *stb);
+	/* Optional, whether a query may be sent before the last is answered. */
+	int (*pipelined)(void *priv);
 	int (*close)(struct sr_scpi_dev_inst *scpi);
 	void (*free)(void *priv);
 	unsigned int read_timeout_ms;
@@ -110,6 +115,9 @@ SR_PRIV int sr_scpi_send_variadic(struct sr_scpi_dev_inst *scpi,
 SR_PRIV int sr_scpi_read_begin(struct sr_scpi_dev_inst *scpi);
 SR_PRIV int sr_scpi_read_data(struct sr_scpi_dev_inst *scpi, char *buf, int maxlen);
 SR_PRIV int sr_scpi_read_complete(struct sr_scpi_dev_inst *scpi);
+SR_PRIV int sr_scpi_device_clear(struct sr_scpi_dev_inst *scpi);
+SR_PRIV int sr_scpi_read_stb(struct sr_scpi_dev_inst *scpi, uint8_t *stb);
+SR_PRIV gboolean sr_scpi_pipelined(struct sr_scpi_dev_inst *scpi);
 SR_PRIV int sr_scpi_close(struct sr_scpi_dev_inst *scpi);
 SR_PRIV void sr_scpi_free(struct sr_scpi_dev_inst *scpi);
 
@@ -69,6 +69,7 @@ static int parse_strict_bool(const char *str, gboolean *ret)
 SR_PRIV extern const struct sr_scpi_dev_inst scpi_serial_dev;
 SR_PRIV extern const struct sr_scpi_dev_inst scpi_tcp_raw_dev;
 SR_PRIV extern const struct sr_scpi_dev_inst scpi_tcp_rigol_dev;
+SR_PRIV extern const struct sr_scpi_dev_inst scpi_hislip_dev;
 SR_PRIV extern const struct sr_scpi_dev_inst scpi_usbtmc_libusb_dev;
 SR_PRIV extern const struct sr_scpi_dev_inst scpi_vxi_dev;
 SR_PRIV extern const struct sr_scpi_dev_inst scpi_visa_dev;
@@ -77,6 +78,7 @@ SR_PRIV extern const struct sr_scpi_dev_inst scpi_libgpib_dev;
 static const struct sr_scpi_dev_inst *scpi_devs[] = {
 	&scpi_tcp_raw_dev,
 	&scpi_tcp_rigol_dev,
+	&scpi_hislip_dev,
 #ifdef HAVE_LIBUSB_1_0
 	&scpi_usbtmc_libusb_dev,
 #endif
@@ -347,6 +349,61 @@ SR_PRIV int sr_scpi_read_complete(struct sr_scpi_dev_inst *scpi)
 	return scpi->read_complete(scpi->priv);
 }
 
+/**
+ * Clear the SCPI device, as an IEEE 488.2 device clear.
+ *
+ * The device drops any pending commands and unread responses, so that the
+ * next command starts from a clean state.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ *
+ * @return SR_OK on success, SR_ERR_NA if the transport can't clear the
+ *         device, SR_ERR on failure.
+ */
+SR_PRIV int sr_scpi_device_clear(struct sr_scpi_dev_inst *scpi)
+{
+	if (!scpi->clear)
+		return SR_ERR_NA;
+
+	return scpi->clear(scpi->priv);
+}
+
+/**
+ * Read the IEEE 488.2 status byte of the SCPI device, out of band.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param stb Where to store the status byte.
+ *
+ * @return SR_OK on success, SR_ERR_NA if the transport has no way of
+ *         reading the status byte, SR_ERR on failure.
+ */
+SR_PRIV int sr_scpi_read_stb(struct sr_scpi_dev_inst *scpi, uint8_t *stb)
+{
+	if (!scpi->read_stb)
+		return SR_ERR_NA;
+
+	return scpi->read_stb(scpi->priv, stb);
+}
+
+/**
+ * Check whether the next query may be sent while the response to the
+ * previous one is still being read.
+ *
+ * The instrument then queues the responses, and reading the next one
+ * starts with sr_scpi_read_begin() once the current one is complete.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ *
+ * @return TRUE if the transport supports this, FALSE otherwise.
+ */
+SR_PRIV gboolean sr_scpi_pipelined(struct sr_scpi_dev_inst *scpi)
+{
+	if (!scpi->pipelined)
+		return FALSE;
+
+	return scpi->pipelined(scpi->priv);
+}
+
 /**
  * Close SCPI device.
  *
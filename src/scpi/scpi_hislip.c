@@ -0,0 +1,727 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * HiSLIP (IVI-6.1) transport.
+ *
+ * A HiSLIP session uses two TCP connections to the instrument: the
+ * synchronous channel carries the SCPI commands and responses, the
+ * asynchronous channel device clear, status queries and service
+ * requests. Every message starts with a 16 byte header:
+ *
+ *   'H' 'S' <type> <control code> <parameter, u32 BE> <length, u64 BE>
+ *
+ * followed by <length> bytes of payload. A command or response is sent
+ * as any number of Data messages and a final DataEnd message, whose end
+ * is the IEEE 488.2 END. This is what tells where block data responses
+ * end, without looking into the data.
+ *
+ * The resource string is hislip/<host>/<subaddress>, where the
+ * subaddress (usually "hislip0") may carry the port, as in VISA:
+ * hislip/192.168.1.10/hislip0,4880.
+ */
+
+#include <config.h>
+#ifdef _WIN32
+#define _WIN32_WINNT 0x0501
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#endif
+#include <glib.h>
+#include <string.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#endif
+#include <errno.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "scpi.h"
+
+#define LOG_PREFIX "scpi_hislip"
+
+#define HISLIP_PORT		"4880"
+#define HISLIP_SUBADDRESS	"hislip0"
+/* Protocol version 1.0. */
+#define HISLIP_VERSION		0x0100
+#define HISLIP_VENDOR_ID	(('S' << 8) | 'R')
+#define HISLIP_HEADER_SIZE	16
+#define HISLIP_INITIAL_ID	0xffffff00
+
+/*
+ * Responses are passed on as they come in, so any message size works.
+ * Tell the instrument so, letting it send a whole waveform in one go.
+ */
+#define HISLIP_MAX_MESSAGE_SIZE	G_MAXUINT64
+
+/* Largest error message text that gets logged. */
+#define HISLIP_MAX_ERROR_LEN	256
+
+enum hislip_message_type {
+	HISLIP_INITIALIZE = 0,
+	HISLIP_INITIALIZE_RESPONSE = 1,
+	HISLIP_FATAL_ERROR = 2,
+	HISLIP_ERROR = 3,
+	HISLIP_ASYNC_LOCK = 4,
+	HISLIP_ASYNC_LOCK_RESPONSE = 5,
+	HISLIP_DATA = 6,
+	HISLIP_DATA_END = 7,
+	HISLIP_DEVICE_CLEAR_COMPLETE = 8,
+	HISLIP_DEVICE_CLEAR_ACKNOWLEDGE = 9,
+	HISLIP_ASYNC_REMOTE_LOCAL_CONTROL = 10,
+	HISLIP_ASYNC_REMOTE_LOCAL_RESPONSE = 11,
+	HISLIP_TRIGGER = 12,
+	HISLIP_INTERRUPTED = 13,
+	HISLIP_ASYNC_INTERRUPTED = 14,
+	HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE = 15,
+	HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE_RESPONSE = 16,
+	HISLIP_ASYNC_INITIALIZE = 17,
+	HISLIP_ASYNC_INITIALIZE_RESPONSE = 18,
+	HISLIP_ASYNC_DEVICE_CLEAR = 19,
+	HISLIP_ASYNC_SERVICE_REQUEST = 20,
+	HISLIP_ASYNC_STATUS_QUERY = 21,
+	HISLIP_ASYNC_STATUS_RESPONSE = 22,
+	HISLIP_ASYNC_DEVICE_CLEAR_ACKNOWLEDGE = 23,
+};
+
+/* Control code bits. */
+#define HISLIP_RMT_DELIVERED	0x01
+#define HISLIP_OVERLAPPED	0x01
+
+struct hislip_header {
+	uint8_t type;
+	uint8_t control;
+	uint32_t parameter;
+	uint64_t length;
+};
+
+struct scpi_hislip {
+	char *address;
+	char *port;
+	char *subaddress;
+	int sync_socket;
+	int async_socket;
+	/* Overlapped mode, as opposed to synchronized mode. */
+	gboolean overlapped;
+	uint16_t session_id;
+	/* Largest message the instrument accepts, header included. */
+	uint64_t max_message_size;
+	/* ID of the next message to send. */
+	uint32_t message_id;
+	/* ID of the DataEnd message the expected response answers. */
+	uint32_t response_id;
+	/* ID of the last query sent while a response was still being read. */
+	uint32_t next_response_id;
+	gboolean next_response;
+	/* A complete response was read since the last message sent. */
+	gboolean rmt_delivered;
+	/* The message being read. */
+	uint32_t data_id;
+	uint64_t data_left;
+	gboolean data_end;
+	gboolean response_complete;
+};
+
+static int hislip_recv(int sock, void *buf, size_t len)
+{
+	char *p = buf;
+	int ret;
+
+	while (len > 0) {
+		ret = recv(sock, p, len, 0);
+		if (ret < 0) {
+			sr_err("Receive error: %s", g_strerror(errno));
+			return SR_ERR;
+		}
+		if (ret == 0) {
+			sr_err("Connection closed by instrument.");
+			return SR_ERR;
+		}
+		p += ret;
+		len -= ret;
+	}
+
+	return SR_OK;
+}
+
+static int hislip_skip(int sock, uint64_t len)
+{
+	char buf[256];
+	size_t chunk;
+
+	while (len > 0) {
+		chunk = MIN(len, sizeof(buf));
+		if (hislip_recv(sock, buf, chunk) != SR_OK)
+			return SR_ERR;
+		len -= chunk;
+	}
+
+	return SR_OK;
+}
+
+static int hislip_send(int sock, uint8_t type, uint8_t control,
+		uint32_t parameter, const void *payload, uint64_t len)
+{
+	uint8_t *msg;
+	size_t size, sent;
+	int ret;
+
+	/* One send per message, so Nagle doesn't hold back the payload. */
+	size = HISLIP_HEADER_SIZE + len;
+	msg = g_malloc(size);
+	msg[0] = 'H';
+	msg[1] = 'S';
+	msg[2] = type;
+	msg[3] = control;
+	WB32(&msg[4], parameter);
+	WB32(&msg[8], len >> 32);
+	WB32(&msg[12], len);
+	if (len)
+		memcpy(&msg[HISLIP_HEADER_SIZE], payload, len);
+
+	for (sent = 0; sent < size; sent += ret) {
+		ret = send(sock, (const char *)msg + sent, size - sent, 0);
+		if (ret < 0) {
+			sr_err("Send error: %s", g_strerror(errno));
+			g_free(msg);
+			return SR_ERR;
+		}
+	}
+	g_free(msg);
+
+	return SR_OK;
+}
+
+static int hislip_recv_header(int sock, struct hislip_header *hdr)
+{
+	uint8_t buf[HISLIP_HEADER_SIZE];
+
+	if (hislip_recv(sock, buf, sizeof(buf)) != SR_OK)
+		return SR_ERR;
+
+	if (buf[0] != 'H' || buf[1] != 'S') {
+		sr_err("Invalid message header.");
+		return SR_ERR;
+	}
+
+	hdr->type = buf[2];
+	hdr->control = buf[3];
+	hdr->parameter = RB32(&buf[4]);
+	hdr->length = RB64(&buf[8]);
+
+	return SR_OK;
+}
+
+/* Log the text of an Error or FatalError message. */
+static int hislip_log_error(int sock, const struct hislip_header *hdr)
+{
+	char text[HISLIP_MAX_ERROR_LEN + 1];
+	size_t len;
+
+	len = MIN(hdr->length, HISLIP_MAX_ERROR_LEN);
+	if (hislip_recv(sock, text, len) != SR_OK)
+		return SR_ERR;
+	text[len] = '\0';
+	if (hislip_skip(sock, hdr->length - len) != SR_OK)
+		return SR_ERR;
+
+	sr_err("%s %d from instrument: %s.",
+		hdr->type == HISLIP_FATAL_ERROR ? "Fatal error" : "Error",
+		hdr->control, text);
+
+	return SR_OK;
+}
+
+/*
+ * Receive a message of the given type, leaving its payload to be read
+ * by the caller.
+ */
+static int hislip_expect(int sock, uint8_t type, struct hislip_header *hdr)
+{
+	if (hislip_recv_header(sock, hdr) != SR_OK)
+		return SR_ERR;
+
+	if (hdr->type == HISLIP_ERROR || hdr->type == HISLIP_FATAL_ERROR) {
+		hislip_log_error(sock, hdr);
+		return SR_ERR;
+	}
+
+	if (hdr->type != type) {
+		sr_err("Expected message type %d, received %d.",
+			type, hdr->type);
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+static int hislip_connect(struct scpi_hislip *hislip, int *sock)
+{
+	struct addrinfo hints;
+	struct addrinfo *results, *res;
+	int err;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	*sock = -1;
+	err = getaddrinfo(hislip->address, hislip->port, &hints, &results);
+
+	if (err) {
+		sr_err("Address lookup failed: %s:%s: %s", hislip->address,
+			hislip->port, gai_strerror(err));
+		return SR_ERR;
+	}
+
+	for (res = results; res; res = res->ai_next) {
+		if ((*sock = socket(res->ai_family, res->ai_socktype,
+						res->ai_protocol)) < 0)
+			continue;
+		if (connect(*sock, res->ai_addr, res->ai_addrlen) != 0) {
+			close(*sock);
+			*sock = -1;
+			continue;
+		}
+		break;
+	}
+
+	freeaddrinfo(results);
+
+	if (*sock < 0) {
+		sr_err("Failed to connect to %s:%s: %s", hislip->address,
+			hislip->port, g_strerror(errno));
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+static void hislip_reset(struct scpi_hislip *hislip)
+{
+	hislip->message_id = HISLIP_INITIAL_ID;
+	hislip->response_id = HISLIP_INITIAL_ID;
+	hislip->next_response = FALSE;
+	hislip->rmt_delivered = FALSE;
+	hislip->data_left = 0;
+	hislip->data_end = FALSE;
+	hislip->response_complete = TRUE;
+}
+
+/*
+ * In overlapped mode, responses to queries the caller gave up on can
+ * still arrive. They answer older messages, so they are dropped.
+ */
+static gboolean hislip_stale(const struct scpi_hislip *hislip, uint32_t id)
+{
+	return hislip->overlapped && (int32_t)(id - hislip->response_id) < 0;
+}
+
+static int scpi_hislip_dev_inst_new(void *priv, struct drv_context *drvc,
+		const char *resource, char **params, const char *serialcomm)
+{
+	struct scpi_hislip *hislip = priv;
+	char **subaddress;
+
+	(void)drvc;
+	(void)resource;
+	(void)serialcomm;
+
+	if (!params || !params[1]) {
+		sr_err("Invalid parameters.");
+		return SR_ERR;
+	}
+
+	hislip->address = g_strdup(params[1]);
+	if (params[2] && params[2][0]) {
+		subaddress = g_strsplit(params[2], ",", 2);
+		hislip->subaddress = g_strdup(subaddress[0]);
+		hislip->port = g_strdup(subaddress[1] ? subaddress[1] : HISLIP_PORT);
+		g_strfreev(subaddress);
+	} else {
+		hislip->subaddress = g_strdup(HISLIP_SUBADDRESS);
+		hislip->port = g_strdup(HISLIP_PORT);
+	}
+	hislip->sync_socket = -1;
+	hislip->async_socket = -1;
+
+	return SR_OK;
+}
+
+static int scpi_hislip_close(struct sr_scpi_dev_inst *scpi);
+
+static int scpi_hislip_open(struct sr_scpi_dev_inst *scpi)
+{
+	struct scpi_hislip *hislip = scpi->priv;
+	struct hislip_header hdr;
+	uint8_t size[8];
+
+	if (hislip_connect(hislip, &hislip->sync_socket) != SR_OK)
+		return SR_ERR;
+
+	if (hislip_send(hislip->sync_socket, HISLIP_INITIALIZE, 0,
+			(HISLIP_VERSION << 16) | HISLIP_VENDOR_ID,
+			hislip->subaddress, strlen(hislip->subaddress)) != SR_OK)
+		goto err;
+	if (hislip_expect(hislip->sync_socket, HISLIP_INITIALIZE_RESPONSE,
+			&hdr) != SR_OK)
+		goto err;
+	if (hislip_skip(hislip->sync_socket, hdr.length) != SR_OK)
+		goto err;
+	hislip->overlapped = hdr.control & HISLIP_OVERLAPPED;
+	hislip->session_id = hdr.parameter & 0xffff;
+	sr_dbg("Session %d, server protocol version %d.%d, %s mode.",
+		hislip->session_id, hdr.parameter >> 24,
+		(hdr.parameter >> 16) & 0xff,
+		hislip->overlapped ? "overlapped" : "synchronized");
+
+	if (hislip_connect(hislip, &hislip->async_socket) != SR_OK)
+		goto err;
+
+	if (hislip_send(hislip->async_socket, HISLIP_ASYNC_INITIALIZE, 0,
+			hislip->session_id, NULL, 0) != SR_OK)
+		goto err;
+	if (hislip_expect(hislip->async_socket,
+			HISLIP_ASYNC_INITIALIZE_RESPONSE, &hdr) != SR_OK)
+		goto err;
+	if (hislip_skip(hislip->async_socket, hdr.length) != SR_OK)
+		goto err;
+
+	WB32(&size[0], HISLIP_MAX_MESSAGE_SIZE >> 32);
+	WB32(&size[4], HISLIP_MAX_MESSAGE_SIZE);
+	if (hislip_send(hislip->async_socket,
+			HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE, 0, 0,
+			size, sizeof(size)) != SR_OK)
+		goto err;
+	if (hislip_expect(hislip->async_socket,
+			HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE_RESPONSE, &hdr) != SR_OK)
+		goto err;
+	if (hdr.length != sizeof(size)) {
+		sr_err("Invalid maximum message size response.");
+		goto err;
+	}
+	if (hislip_recv(hislip->async_socket, size, sizeof(size)) != SR_OK)
+		goto err;
+	hislip->max_message_size = RB64(size);
+	sr_dbg("Instrument accepts messages of up to %" PRIu64 " bytes.",
+		hislip->max_message_size);
+
+	hislip_reset(hislip);
+
+	return SR_OK;
+
+err:
+	scpi_hislip_close(scpi);
+	return SR_ERR;
+}
+
+static int scpi_hislip_source_add(struct sr_session *session, void *priv,
+		int events, int timeout, sr_receive_data_callback cb, void *cb_data)
+{
+	struct scpi_hislip *hislip = priv;
+
+	return sr_session_source_add(session, hislip->sync_socket, events,
+			timeout, cb, cb_data);
+}
+
+static int scpi_hislip_source_remove(struct sr_session *session, void *priv)
+{
+	struct scpi_hislip *hislip = priv;
+
+	return sr_session_source_remove(session, hislip->sync_socket);
+}
+
+static int scpi_hislip_send(void *priv, const char *command)
+{
+	struct scpi_hislip *hislip = priv;
+	gchar *terminated_command;
+	const char *p;
+	size_t len, chunk, max_payload;
+	uint8_t type, control;
+	int ret;
+
+	terminated_command = g_strconcat(command, "\n", NULL);
+	len = strlen(terminated_command);
+
+	/* Split the command if the instrument can't take it in one message. */
+	max_payload = MAX(hislip->max_message_size, HISLIP_HEADER_SIZE + 1)
+			- HISLIP_HEADER_SIZE;
+
+	ret = SR_OK;
+	for (p = terminated_command; len > 0; p += chunk, len -= chunk) {
+		chunk = MIN(len, max_payload);
+		type = chunk < len ? HISLIP_DATA : HISLIP_DATA_END;
+		control = hislip->rmt_delivered ? HISLIP_RMT_DELIVERED : 0;
+		ret = hislip_send(hislip->sync_socket, type, control,
+				hislip->message_id, p, chunk);
+		if (ret != SR_OK)
+			break;
+		hislip->rmt_delivered = FALSE;
+		if (type == HISLIP_DATA_END && !hislip->response_complete) {
+			/* The rest of the current response is still wanted. */
+			hislip->next_response_id = hislip->message_id;
+			hislip->next_response = TRUE;
+		} else if (type == HISLIP_DATA_END) {
+			hislip->response_id = hislip->message_id;
+		}
+		hislip->message_id += 2;
+	}
+	g_free(terminated_command);
+
+	if (ret != SR_OK)
+		return SR_ERR;
+
+	sr_spew("Successfully sent SCPI command: '%s'.", command);
+
+	return SR_OK;
+}
+
+static int scpi_hislip_read_begin(void *priv)
+{
+	struct scpi_hislip *hislip = priv;
+
+	if (hislip->next_response) {
+		hislip->response_id = hislip->next_response_id;
+		hislip->next_response = FALSE;
+	}
+	hislip->response_complete = FALSE;
+
+	return SR_OK;
+}
+
+static int scpi_hislip_read_data(void *priv, char *buf, int maxlen)
+{
+	struct scpi_hislip *hislip = priv;
+	struct hislip_header hdr;
+	int len;
+
+	if (hislip->response_complete)
+		return SR_ERR;
+
+	/* Find the next message with payload of the expected response. */
+	while (hislip->data_left == 0 || hislip_stale(hislip, hislip->data_id)) {
+		if (hislip_skip(hislip->sync_socket, hislip->data_left) != SR_OK)
+			return SR_ERR;
+		hislip->data_left = 0;
+
+		if (hislip_recv_header(hislip->sync_socket, &hdr) != SR_OK)
+			return SR_ERR;
+
+		switch (hdr.type) {
+		case HISLIP_DATA:
+		case HISLIP_DATA_END:
+			hislip->data_id = hdr.parameter;
+			hislip->data_left = hdr.length;
+			hislip->data_end = hdr.type == HISLIP_DATA_END;
+			if (hislip_stale(hislip, hdr.parameter)) {
+				sr_dbg("Dropping response to message %08x.",
+					hdr.parameter);
+				continue;
+			}
+			if (hislip->data_end && hdr.length == 0) {
+				hislip->response_complete = TRUE;
+				hislip->rmt_delivered = TRUE;
+				return 0;
+			}
+			break;
+		case HISLIP_INTERRUPTED:
+			sr_dbg("Response interrupted by a new command.");
+			break;
+		case HISLIP_ERROR:
+			if (hislip_log_error(hislip->sync_socket, &hdr) != SR_OK)
+				return SR_ERR;
+			break;
+		case HISLIP_FATAL_ERROR:
+			hislip_log_error(hislip->sync_socket, &hdr);
+			return SR_ERR;
+		default:
+			sr_dbg("Ignoring message type %d.", hdr.type);
+			if (hislip_skip(hislip->sync_socket, hdr.length) != SR_OK)
+				return SR_ERR;
+			break;
+		}
+	}
+
+	len = recv(hislip->sync_socket, buf,
+			MIN((uint64_t)maxlen, hislip->data_left), 0);
+
+	if (len < 0) {
+		sr_err("Receive error: %s", g_strerror(errno));
+		return SR_ERR;
+	}
+	if (len == 0) {
+		sr_err("Connection closed by instrument.");
+		return SR_ERR;
+	}
+
+	hislip->data_left -= len;
+	if (hislip->data_left == 0 && hislip->data_end) {
+		/* The END of the response, after the last byte of payload. */
+		hislip->response_complete = TRUE;
+		hislip->rmt_delivered = TRUE;
+	}
+
+	return len;
+}
+
+static int scpi_hislip_read_complete(void *priv)
+{
+	struct scpi_hislip *hislip = priv;
+
+	return hislip->response_complete;
+}
+
+/*
+ * Device clear, as described in IVI-6.1 section 6.12: the instrument
+ * drops its pending input and output, and anything still in flight on
+ * the synchronous channel is discarded up to its acknowledgement.
+ */
+static int scpi_hislip_clear(void *priv)
+{
+	struct scpi_hislip *hislip = priv;
+	struct hislip_header hdr;
+	uint8_t features;
+
+	if (hislip_send(hislip->async_socket, HISLIP_ASYNC_DEVICE_CLEAR, 0,
+			0, NULL, 0) != SR_OK)
+		return SR_ERR;
+	if (hislip_expect(hislip->async_socket,
+			HISLIP_ASYNC_DEVICE_CLEAR_ACKNOWLEDGE, &hdr) != SR_OK)
+		return SR_ERR;
+	if (hislip_skip(hislip->async_socket, hdr.length) != SR_OK)
+		return SR_ERR;
+
+	/* Go along with the mode the instrument prefers. */
+	features = hdr.control;
+	if (hislip_send(hislip->sync_socket, HISLIP_DEVICE_CLEAR_COMPLETE,
+			features, 0, NULL, 0) != SR_OK)
+		return SR_ERR;
+
+	if (hislip_skip(hislip->sync_socket, hislip->data_left) != SR_OK)
+		return SR_ERR;
+	while (1) {
+		if (hislip_recv_header(hislip->sync_socket, &hdr) != SR_OK)
+			return SR_ERR;
+		if (hdr.type == HISLIP_FATAL_ERROR) {
+			hislip_log_error(hislip->sync_socket, &hdr);
+			return SR_ERR;
+		}
+		if (hislip_skip(hislip->sync_socket, hdr.length) != SR_OK)
+			return SR_ERR;
+		if (hdr.type == HISLIP_DEVICE_CLEAR_ACKNOWLEDGE)
+			break;
+	}
+
+	hislip->overlapped = hdr.control & HISLIP_OVERLAPPED;
+	hislip_reset(hislip);
+
+	sr_dbg("Device clear complete, %s mode.",
+		hislip->overlapped ? "overlapped" : "synchronized");
+
+	return SR_OK;
+}
+
+static int scpi_hislip_read_stb(void *priv, uint8_t *stb)
+{
+	struct scpi_hislip *hislip = priv;
+	struct hislip_header hdr;
+	uint8_t control;
+
+	control = hislip->rmt_delivered ? HISLIP_RMT_DELIVERED : 0;
+	if (hislip_send(hislip->async_socket, HISLIP_ASYNC_STATUS_QUERY,
+			control, hislip->message_id - 2, NULL, 0) != SR_OK)
+		return SR_ERR;
+	hislip->rmt_delivered = FALSE;
+
+	/* Service requests may have queued up on the channel meanwhile. */
+	while (1) {
+		if (hislip_recv_header(hislip->async_socket, &hdr) != SR_OK)
+			return SR_ERR;
+		if (hislip_skip(hislip->async_socket, hdr.length) != SR_OK)
+			return SR_ERR;
+		if (hdr.type == HISLIP_ASYNC_STATUS_RESPONSE)
+			break;
+		if (hdr.type == HISLIP_ASYNC_SERVICE_REQUEST)
+			sr_dbg("Service request, status byte 0x%02x.",
+				hdr.control);
+		else
+			sr_dbg("Ignoring async message type %d.", hdr.type);
+	}
+
+	*stb = hdr.control;
+
+	return SR_OK;
+}
+
+/*
+ * Only in overlapped mode does the instrument queue the responses. In
+ * synchronized mode a new query interrupts the one being answered.
+ */
+static int scpi_hislip_pipelined(void *priv)
+{
+	struct scpi_hislip *hislip = priv;
+
+	return hislip->overlapped;
+}
+
+static int scpi_hislip_close(struct sr_scpi_dev_inst *scpi)
+{
+	struct scpi_hislip *hislip = scpi->priv;
+	int ret;
+
+	ret = SR_OK;
+	if (hislip->async_socket >= 0 && close(hislip->async_socket) < 0)
+		ret = SR_ERR;
+	if (hislip->sync_socket >= 0 && close(hislip->sync_socket) < 0)
+		ret = SR_ERR;
+	hislip->async_socket = -1;
+	hislip->sync_socket = -1;
+
+	return ret;
+}
+
+static void scpi_hislip_free(void *priv)
+{
+	struct scpi_hislip *hislip = priv;
+
+	g_free(hislip->address);
+	g_free(hislip->port);
+	g_free(hislip->subaddress);
+}
+
+SR_PRIV const struct sr_scpi_dev_inst scpi_hislip_dev = {
+	.name          = "HiSLIP",
+	.prefix        = "hislip",
+	.priv_size     = sizeof(struct scpi_hislip),
+	.dev_inst_new  = scpi_hislip_dev_inst_new,
+	.open          = scpi_hislip_open,
+	.source_add    = scpi_hislip_source_add,
+	.source_remove = scpi_hislip_source_remove,
+	.send          = scpi_hislip_send,
+	.read_begin    = scpi_hislip_read_begin,
+	.read_data     = scpi_hislip_read_data,
+	.read_complete = scpi_hislip_read_complete,
+	.clear         = scpi_hislip_clear,
+	.read_stb      = scpi_hislip_read_stb,
+	.pipelined     = scpi_hislip_pipelined,
+	.close         = scpi_hislip_close,
+	.free          = scpi_hislip_free,
+};
@@ -68,6 +68,118 @@ struct fd_source {
 	GPollFD pollfd;
 };
 
+/** Number of samples per packet when the flight recorder sends history. */
+#define RECORDER_CHUNK_SAMPLES 4096
+
+/** Default memory budget of the flight recorder's sample history. */
+#define RECORDER_MAX_BYTES (256 * 1024 * 1024)
+
+/** Maximum number of packets without samples held with the history. */
+#define RECORDER_MAX_EVENTS 1024
+
+/** A ring of the most recent samples of one stream.
+ * @internal
+ */
+struct recorder_ring {
+	/** Room for capacity samples of size bytes each. */
+	uint8_t *buf;
+	uint32_t size;
+	uint64_t capacity;
+	/** Index of the sample slot which will be stored next. */
+	uint64_t head;
+	/** Number of valid samples in buf. */
+	uint64_t fill;
+	/** Number of samples stored since the history was last sent. */
+	uint64_t total;
+	/** Number of samples still to pass on in the post-trigger window. */
+	uint64_t post_left;
+};
+
+/** Kinds of sample streams the flight recorder keeps history for.
+ * @internal
+ */
+enum recorder_kind {
+	RECORDER_LOGIC,
+	RECORDER_ANALOG,
+	RECORDER_PLANAR,
+};
+
+/** A run of planar samples with consecutive sample numbers.
+ * @internal
+ */
+struct recorder_segment {
+	/** Where the run starts, counted like ring.total. */
+	uint64_t start;
+	uint64_t frame;
+	uint64_t sample;
+};
+
+/** History of one stream: the logic data, or the analog or planar
+ * packets for one set of channels.
+ * @internal
+ */
+struct recorder_stream {
+	struct recorder_ring ring;
+	enum recorder_kind kind;
+	/** The channels, in the order their values are interleaved. */
+	GSList *channels;
+	uint32_t num_channels;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	/** For planar streams, a plane per channel. A sample slot holds
+	 *  the planes' values back to back, at the given offsets. */
+	struct sr_analog_plane *planes;
+	uint32_t *plane_offsets;
+	struct sr_analog_encoding *plane_encodings;
+	struct sr_analog_meaning *plane_meanings;
+	struct sr_analog_spec *plane_specs;
+	/** For planar streams, struct recorder_segment, oldest first. */
+	GQueue segments;
+	/** How far the history was sent, counted like ring.total. */
+	uint64_t sent;
+};
+
+/** A packet without samples, held back along with the history.
+ * @internal
+ */
+struct recorder_event {
+	struct sr_datafeed_packet *packet;
+	/** Each stream's ring.total when the packet arrived, in the order
+	 *  of the recorder's streams. Later streams had no samples yet. */
+	uint64_t *marks;
+	guint num_marks;
+};
+
+/** State of the session's flight recorder.
+ * @see sr_session_recorder_set()
+ * @internal
+ */
+struct flight_recorder {
+	/** Number of samples to keep from before a trigger. */
+	uint64_t pre_samples;
+	/** Number of samples to pass on after a trigger. */
+	uint64_t post_samples;
+	/** Memory budget of the history, shared evenly by the streams. */
+	uint64_t max_bytes;
+
+	/** A struct recorder_stream per stream, in order of appearance. */
+	GSList *streams;
+	/** Packets without samples, struct recorder_event, oldest first. */
+	GQueue events;
+
+	/** Whether we're passing on data after a trigger. */
+	gboolean in_post;
+
+	/** Set by sr_session_snapshot(), handled with the next packet. */
+	gint snapshot_pending;
+};
+
+static void recorder_free(struct flight_recorder *rec);
+static void recorder_reset(struct flight_recorder *rec);
+static void recorder_stream_resize(struct flight_recorder *rec,
+		struct recorder_stream *new_rs, uint32_t size);
+
 /** FD event source prepare() method.
  * This is called immediately before poll().
  */
@@ -258,6 +370,8 @@ SR_API int sr_session_destroy(struct sr_session *session)
 
 	sr_session_datafeed_callback_remove_all(session);
 
+	recorder_free(session->recorder);
+
 	g_hash_table_unref(session->event_sources);
 
 	g_mutex_clear(&session->main_mutex);
@@ -808,6 +922,9 @@ SR_API int sr_session_start(struct sr_session *session)
 
 	sr_info("Starting.");
 
+	if (session->recorder)
+		recorder_reset(session->recorder);
+
 	session->running = TRUE;
 
 	/* Have all devices start acquisition. */
@@ -1024,6 +1141,150 @@ SR_API int sr_session_stopped_callback_set(struct sr_session *session,
 	return SR_OK;
 }
 
+/**
+ * Set up flight recorder mode for a session.
+ *
+ * In flight recorder mode, logic, analog and planar analog data is not
+ * passed to the datafeed callbacks as it arrives. Instead, the session
+ * keeps the most recent @a pre_samples samples in a ring buffer, while
+ * acquisition keeps running. When a trigger occurs, this history is sent
+ * to the datafeed callbacks, followed by an SR_DF_TRIGGER packet and the
+ * next @a post_samples samples. After that, the session goes back to
+ * recording history until the next trigger.
+ *
+ * A trigger is either an SR_DF_TRIGGER packet sent by a device (as a
+ * result of a hardware or soft trigger), or a call to
+ * sr_session_snapshot().
+ *
+ * The history is kept in ring buffers of @a pre_samples samples, one for
+ * the logic data and one for each set of analog or planar channels. They
+ * are allocated once, when the first packet of their kind arrives, and
+ * the data is only copied into them. Together they take no more memory
+ * than set with sr_session_recorder_max_bytes_set(), 256 MiB by default;
+ * each stream gets an even share. Both the history and the post-trigger
+ * window are counted per channel.
+ *
+ * Other packets, such as SR_DF_GAP, SR_DF_META or frame boundaries, are
+ * held back along with the history. When it is sent, they come in the
+ * same order relative to the samples as they did from the device. The
+ * streams are sent interleaved, lined up at the trigger.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param pre_samples Number of samples to keep from before a trigger.
+ * @param post_samples Number of samples to pass on after a trigger.
+ *                     If both are 0, flight recorder mode is disabled.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ * @retval SR_ERR The session is running.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_session_recorder_set(struct sr_session *session,
+		uint64_t pre_samples, uint64_t post_samples)
+{
+	struct flight_recorder *rec;
+
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (session->running) {
+		sr_err("Cannot change flight recorder mode while running.");
+		return SR_ERR;
+	}
+
+	recorder_free(session->recorder);
+	session->recorder = NULL;
+
+	if (pre_samples == 0 && post_samples == 0)
+		return SR_OK;
+
+	rec = g_malloc0(sizeof(struct flight_recorder));
+	rec->pre_samples = pre_samples;
+	rec->post_samples = post_samples;
+	rec->max_bytes = RECORDER_MAX_BYTES;
+	session->recorder = rec;
+
+	return SR_OK;
+}
+
+/**
+ * Set the memory budget of a session's flight recorder.
+ *
+ * The history of each stream of samples is limited to its share of
+ * @a max_bytes, as well as to the number of samples set with
+ * sr_session_recorder_set(). That resets the budget to its default.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param max_bytes Memory to use for the history, in bytes. Must not be 0.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA The session is not in flight recorder mode.
+ * @retval SR_ERR The session is running.
+ *
+ * @see sr_session_recorder_set()
+ * @since 0.5.0
+ */
+SR_API int sr_session_recorder_max_bytes_set(struct sr_session *session,
+		uint64_t max_bytes)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (max_bytes == 0)
+		return SR_ERR_ARG;
+
+	if (!session->recorder)
+		return SR_ERR_NA;
+
+	if (session->running) {
+		sr_err("Cannot change flight recorder mode while running.");
+		return SR_ERR;
+	}
+
+	session->recorder->max_bytes = max_bytes;
+	recorder_stream_resize(session->recorder, NULL, 0);
+
+	return SR_OK;
+}
+
+/**
+ * Trigger the flight recorder of a session.
+ *
+ * The recorded history and the following post-trigger samples will be
+ * sent to the datafeed callbacks, as if a trigger had occurred on the
+ * device. This is safe to call from any thread; the snapshot is taken
+ * when the next packet arrives on the session bus.
+ *
+ * @param session The session to use. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ * @retval SR_ERR_NA The session is not in flight recorder mode.
+ *
+ * @see sr_session_recorder_set()
+ * @since 0.5.0
+ */
+SR_API int sr_session_snapshot(struct sr_session *session)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (!session->recorder)
+		return SR_ERR_NA;
+
+	g_atomic_int_set(&session->recorder->snapshot_pending, 1);
+
+	return SR_OK;
+}
+
 /**
  * Debug helper.
  *
@@ -1034,6 +1295,8 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog_old *analog_old;
 	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_gap *gap;
+	const struct sr_datafeed_analog_planar *planar;
 
 	/* Please use the same order as in libsigrok.h. */
 	switch (packet->type) {
@@ -1070,12 +1333,820 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 		sr_dbg("bus: Received SR_DF_ANALOG packet (%d samples).",
 		       analog->num_samples);
 		break;
+	case SR_DF_GAP:
+		gap = packet->payload;
+		sr_dbg("bus: Received SR_DF_GAP packet (%" PRIu64 " samples "
+		       "from %" PRIu64 ").", gap->length, gap->start);
+		break;
+	case SR_DF_ANALOG_PLANAR:
+		planar = packet->payload;
+		sr_dbg("bus: Received SR_DF_ANALOG_PLANAR packet (%d planes, "
+		       "%d samples).", planar->num_planes, planar->num_samples);
+		break;
 	default:
 		sr_dbg("bus: Received unknown packet type: %d.", packet->type);
 		break;
 	}
 }
 
+/** Pass a packet to all datafeed callbacks of the session. */
+static void send_to_callbacks(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	GSList *l;
+	struct datafeed_callback *cb_struct;
+
+	for (l = sdi->session->datafeed_callbacks; l; l = l->next) {
+		if (sr_log_loglevel_get() >= SR_LOG_DBG)
+			datafeed_dump(packet);
+		cb_struct = l->data;
+		cb_struct->cb(sdi, packet, cb_struct->cb_data);
+	}
+}
+
+/*
+ * Get a piece of the ring, starting @a skip samples after the oldest one.
+ * Returns the number of samples which are stored contiguously there, up
+ * to @a num_samples.
+ */
+static uint64_t ring_peek(const struct recorder_ring *ring, uint64_t skip,
+		uint64_t num_samples, uint8_t **data)
+{
+	uint64_t start;
+
+	start = (ring->head + ring->capacity - ring->fill + skip)
+			% ring->capacity;
+	*data = ring->buf + start * ring->size;
+
+	return MIN(num_samples, ring->capacity - start);
+}
+
+/*
+ * Give the ring room for capacity samples of the given size. The newest
+ * samples are kept, unless the sample size changes.
+ */
+static void ring_resize(struct recorder_ring *ring, uint64_t capacity,
+		uint32_t size)
+{
+	uint8_t *buf, *data;
+	uint64_t keep, skip, done, n;
+
+	if (size == ring->size && capacity == ring->capacity)
+		return;
+
+	buf = g_malloc(capacity * size);
+	keep = size == ring->size ? MIN(ring->fill, capacity) : 0;
+	skip = ring->fill - keep;
+	for (done = 0; done < keep; done += n) {
+		n = ring_peek(ring, skip + done, keep - done, &data);
+		memcpy(buf + done * size, data, n * size);
+	}
+	g_free(ring->buf);
+	ring->buf = buf;
+	ring->size = size;
+	ring->capacity = capacity;
+	ring->head = capacity ? keep % capacity : 0;
+	ring->fill = keep;
+}
+
+/* Append samples to the ring, overwriting the oldest ones. */
+static void ring_store(struct recorder_ring *ring, const uint8_t *data,
+		uint64_t num_samples)
+{
+	uint64_t chunk;
+
+	ring->total += num_samples;
+	if (ring->capacity == 0)
+		return;
+
+	if (num_samples > ring->capacity) {
+		data += (num_samples - ring->capacity) * ring->size;
+		num_samples = ring->capacity;
+	}
+	ring->fill = MIN(ring->fill + num_samples, ring->capacity);
+
+	while (num_samples > 0) {
+		chunk = MIN(num_samples, ring->capacity - ring->head);
+		memcpy(ring->buf + ring->head * ring->size, data,
+				chunk * ring->size);
+		ring->head = (ring->head + chunk) % ring->capacity;
+		data += chunk * ring->size;
+		num_samples -= chunk;
+	}
+}
+
+/*
+ * Append the samples [first, first + num_samples) of a planar packet to
+ * a planar stream's ring. Each plane's value goes to its offset in the
+ * sample slot.
+ */
+static void ring_store_planar(struct recorder_stream *rs,
+		const struct sr_datafeed_analog_planar *planar,
+		uint64_t first, uint64_t num_samples)
+{
+	struct recorder_ring *ring;
+	const struct sr_analog_plane *plane;
+	const uint8_t *src;
+	uint8_t *dst;
+	uint64_t chunk, i;
+	uint32_t p, unitsize, stride;
+
+	ring = &rs->ring;
+	ring->total += num_samples;
+	if (ring->capacity == 0)
+		return;
+
+	if (num_samples > ring->capacity) {
+		first += num_samples - ring->capacity;
+		num_samples = ring->capacity;
+	}
+	ring->fill = MIN(ring->fill + num_samples, ring->capacity);
+
+	while (num_samples > 0) {
+		chunk = MIN(num_samples, ring->capacity - ring->head);
+		dst = ring->buf + ring->head * ring->size;
+		for (p = 0; p < planar->num_planes; p++) {
+			plane = &planar->planes[p];
+			unitsize = plane->encoding->unitsize;
+			stride = plane->stride ? plane->stride : unitsize;
+			src = (const uint8_t *)plane->data + first * stride;
+			for (i = 0; i < chunk; i++)
+				memcpy(dst + i * ring->size + rs->plane_offsets[p],
+					src + i * stride, unitsize);
+		}
+		ring->head = (ring->head + chunk) % ring->capacity;
+		first += chunk;
+		num_samples -= chunk;
+	}
+}
+
+static void recorder_segments_clear(struct recorder_stream *rs)
+{
+	struct recorder_segment *seg;
+
+	while ((seg = g_queue_pop_head(&rs->segments)))
+		g_free(seg);
+}
+
+static void recorder_stream_free(struct recorder_stream *rs)
+{
+	recorder_segments_clear(rs);
+	g_free(rs->ring.buf);
+	g_slist_free(rs->channels);
+	g_free(rs->planes);
+	g_free(rs->plane_offsets);
+	g_free(rs->plane_encodings);
+	g_free(rs->plane_meanings);
+	g_free(rs->plane_specs);
+	g_free(rs);
+}
+
+static void recorder_event_free(struct recorder_event *ev)
+{
+	sr_packet_free(ev->packet);
+	g_free(ev->marks);
+	g_free(ev);
+}
+
+static void recorder_reset(struct flight_recorder *rec)
+{
+	struct recorder_stream *rs;
+	struct recorder_event *ev;
+	GSList *l;
+
+	for (l = rec->streams; l; l = l->next) {
+		rs = l->data;
+		rs->ring.head = 0;
+		rs->ring.fill = 0;
+		rs->ring.total = 0;
+		recorder_segments_clear(rs);
+	}
+	while ((ev = g_queue_pop_head(&rec->events)))
+		recorder_event_free(ev);
+	rec->in_post = FALSE;
+	g_atomic_int_set(&rec->snapshot_pending, 0);
+}
+
+static void recorder_free(struct flight_recorder *rec)
+{
+	if (!rec)
+		return;
+
+	recorder_reset(rec);
+	g_slist_free_full(rec->streams, (GDestroyNotify)recorder_stream_free);
+	g_free(rec);
+}
+
+static gboolean channels_equal(GSList *a, GSList *b)
+{
+	for (; a && b; a = a->next, b = b->next) {
+		if (a->data != b->data)
+			return FALSE;
+	}
+
+	return !a && !b;
+}
+
+/*
+ * Size the streams' rings. Each stream gets an even share of the memory
+ * budget, and no more than pre_samples. A new stream shrinks the others'
+ * share; their newest samples are kept. If new_rs is given, its ring is
+ * set up for samples of the given size.
+ */
+static void recorder_stream_resize(struct flight_recorder *rec,
+		struct recorder_stream *new_rs, uint32_t size)
+{
+	struct recorder_stream *rs;
+	uint64_t share;
+	GSList *l;
+
+	share = rec->max_bytes / MAX(g_slist_length(rec->streams), 1);
+	for (l = rec->streams; l; l = l->next) {
+		rs = l->data;
+		if (rs == new_rs || rs->ring.size == 0)
+			continue;
+		ring_resize(&rs->ring, MIN(rec->pre_samples,
+				share / rs->ring.size), rs->ring.size);
+	}
+	if (new_rs)
+		ring_resize(&new_rs->ring, MIN(rec->pre_samples, share / size),
+				size);
+}
+
+static gboolean planes_equal(GSList *channels,
+		const struct sr_datafeed_analog_planar *planar)
+{
+	uint32_t i;
+
+	for (i = 0; channels && i < planar->num_planes;
+			channels = channels->next, i++) {
+		if (channels->data != planar->planes[i].channel)
+			return FALSE;
+	}
+
+	return !channels && i == planar->num_planes;
+}
+
+static struct recorder_stream *recorder_stream_new(struct flight_recorder *rec,
+		enum recorder_kind kind, GSList *channels)
+{
+	struct recorder_stream *rs;
+
+	rs = g_malloc0(sizeof(struct recorder_stream));
+	rs->kind = kind;
+	rs->channels = g_slist_copy(channels);
+	rs->num_channels = MAX(g_slist_length(rs->channels), 1);
+	/* Streams showing up during the window get their share. */
+	rs->ring.post_left = rec->in_post ? rec->post_samples : 0;
+	rec->streams = g_slist_append(rec->streams, rs);
+
+	return rs;
+}
+
+/*
+ * Find the history for a stream. It is set up when the stream is first
+ * seen, and its ring is allocated once and for all, unless the sample
+ * size or the number of streams changes.
+ */
+static struct recorder_stream *recorder_stream_get(struct flight_recorder *rec,
+		enum recorder_kind kind, GSList *channels, uint32_t size)
+{
+	struct recorder_stream *rs;
+	GSList *l;
+
+	for (l = rec->streams; l; l = l->next) {
+		rs = l->data;
+		if (rs->kind == kind && channels_equal(rs->channels, channels))
+			break;
+	}
+	if (!l) {
+		rs = recorder_stream_new(rec, kind, channels);
+		recorder_stream_resize(rec, rs, size);
+	} else if (rs->ring.size != size) {
+		recorder_stream_resize(rec, rs, size);
+	}
+
+	return rs;
+}
+
+/*
+ * Find the history for the planes of a planar packet, and take on their
+ * descriptions. Like recorder_stream_get(), a new set of channels or a
+ * new sample size is all that resizes the ring.
+ */
+static struct recorder_stream *recorder_planar_get(struct flight_recorder *rec,
+		const struct sr_datafeed_analog_planar *planar)
+{
+	struct recorder_stream *rs;
+	const struct sr_analog_plane *plane;
+	GSList *l, *channels;
+	uint32_t i, size;
+
+	for (l = rec->streams; l; l = l->next) {
+		rs = l->data;
+		if (rs->kind == RECORDER_PLANAR
+				&& planes_equal(rs->channels, planar))
+			break;
+	}
+	if (!l) {
+		channels = NULL;
+		for (i = planar->num_planes; i > 0; i--)
+			channels = g_slist_prepend(channels,
+				planar->planes[i - 1].channel);
+		rs = recorder_stream_new(rec, RECORDER_PLANAR, channels);
+		g_slist_free(channels);
+		rs->planes = g_malloc0(planar->num_planes * sizeof(*rs->planes));
+		rs->plane_offsets = g_malloc0(planar->num_planes
+				* sizeof(*rs->plane_offsets));
+		rs->plane_encodings = g_malloc0(planar->num_planes
+				* sizeof(*rs->plane_encodings));
+		rs->plane_meanings = g_malloc0(planar->num_planes
+				* sizeof(*rs->plane_meanings));
+		rs->plane_specs = g_malloc0(planar->num_planes
+				* sizeof(*rs->plane_specs));
+	}
+
+	size = 0;
+	for (i = 0; i < planar->num_planes; i++) {
+		plane = &planar->planes[i];
+		rs->plane_offsets[i] = size;
+		size += plane->encoding->unitsize;
+		rs->plane_encodings[i] = *plane->encoding;
+		rs->plane_meanings[i] = *plane->meaning;
+		rs->plane_meanings[i].channels = NULL;
+		rs->plane_specs[i] = *plane->spec;
+		rs->planes[i].channel = plane->channel;
+		rs->planes[i].encoding = &rs->plane_encodings[i];
+		rs->planes[i].meaning = &rs->plane_meanings[i];
+		rs->planes[i].spec = &rs->plane_specs[i];
+	}
+	if (!l || rs->ring.size != size)
+		recorder_stream_resize(rec, rs, size);
+
+	return rs;
+}
+
+/*
+ * Note where the last num_samples samples stored from a planar packet,
+ * starting at its sample first, went in a stream's history. A new
+ * segment starts unless they follow on from the last one. Only the
+ * segments still in the ring are kept.
+ */
+static void recorder_segment_add(struct recorder_stream *rs,
+		const struct sr_datafeed_analog_planar *planar, uint64_t first,
+		uint64_t num_samples)
+{
+	struct recorder_segment *seg, *next;
+	uint64_t start, oldest;
+
+	if (num_samples == 0)
+		return;
+
+	start = rs->ring.total - num_samples;
+	seg = g_queue_peek_tail(&rs->segments);
+	if (!seg || seg->frame != planar->frame || seg->sample
+			+ (start - seg->start) != planar->sample + first) {
+		seg = g_malloc(sizeof(struct recorder_segment));
+		seg->start = start;
+		seg->frame = planar->frame;
+		seg->sample = planar->sample + first;
+		g_queue_push_tail(&rs->segments, seg);
+	}
+
+	oldest = rs->ring.total - rs->ring.fill;
+	while ((next = g_queue_peek_nth(&rs->segments, 1))
+			&& next->start <= oldest)
+		g_free(g_queue_pop_head(&rs->segments));
+}
+
+/* Find the segment of a planar stream which a sample belongs to. */
+static const struct recorder_segment *recorder_segment_find(
+		const struct recorder_stream *rs, uint64_t pos, uint64_t *end)
+{
+	const struct recorder_segment *seg, *next;
+	GList *l;
+
+	seg = NULL;
+	*end = rs->ring.total;
+	for (l = rs->segments.head; l; l = l->next) {
+		next = l->data;
+		if (next->start > pos) {
+			*end = next->start;
+			break;
+		}
+		seg = next;
+	}
+
+	return seg;
+}
+
+/* Send samples [from, to) of a stream's history, counted like ring.total. */
+static void recorder_send_stream(const struct sr_dev_inst *sdi,
+		struct recorder_stream *rs, uint64_t from, uint64_t to)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	struct sr_datafeed_analog_planar planar;
+	const struct recorder_segment *seg;
+	uint8_t *data;
+	uint64_t first, n, seg_end;
+	uint32_t i;
+
+	first = rs->ring.total - rs->ring.fill;
+	for (from = MAX(from, first); from < to; from += n) {
+		n = ring_peek(&rs->ring, from - first, to - from, &data);
+		switch (rs->kind) {
+		case RECORDER_LOGIC:
+			packet.type = SR_DF_LOGIC;
+			packet.payload = &logic;
+			logic.unitsize = rs->ring.size;
+			logic.data = data;
+			logic.length = n * logic.unitsize;
+			break;
+		case RECORDER_ANALOG:
+			packet.type = SR_DF_ANALOG;
+			packet.payload = &analog;
+			analog.encoding = &rs->encoding;
+			analog.meaning = &rs->meaning;
+			analog.spec = &rs->spec;
+			analog.data = data;
+			analog.num_samples = n;
+			break;
+		case RECORDER_PLANAR:
+			/* A packet doesn't span segments. */
+			seg = recorder_segment_find(rs, from, &seg_end);
+			n = MIN(n, seg_end - from);
+			packet.type = SR_DF_ANALOG_PLANAR;
+			packet.payload = &planar;
+			planar.frame = seg ? seg->frame : 0;
+			planar.sample = seg ? seg->sample + (from - seg->start) : 0;
+			planar.num_samples = n;
+			planar.num_planes = rs->num_channels;
+			planar.planes = rs->planes;
+			for (i = 0; i < rs->num_channels; i++) {
+				rs->planes[i].data = data + rs->plane_offsets[i];
+				rs->planes[i].stride = rs->ring.size;
+			}
+			break;
+		}
+		send_to_callbacks(sdi, &packet);
+	}
+}
+
+/*
+ * How far a stream's history goes before an event, or all of it if
+ * there is no event.
+ */
+static uint64_t recorder_stream_end(const struct recorder_stream *rs,
+		guint idx, const struct recorder_event *ev)
+{
+	if (!ev)
+		return rs->ring.total;
+
+	return idx < ev->num_marks ? ev->marks[idx] : 0;
+}
+
+/*
+ * Send the streams' history up to an event, or all of it. The streams
+ * are lined up at their ends, and sent interleaved in chunks to keep
+ * them in step.
+ */
+static void recorder_send_until(const struct sr_dev_inst *sdi,
+		struct flight_recorder *rec, const struct recorder_event *ev)
+{
+	struct recorder_stream *rs;
+	uint64_t end, left, keep;
+	GSList *l;
+	guint i;
+
+	for (;;) {
+		left = 0;
+		for (l = rec->streams, i = 0; l; l = l->next, i++) {
+			rs = l->data;
+			end = recorder_stream_end(rs, i, ev);
+			if (end > rs->sent)
+				left = MAX(left, end - rs->sent);
+		}
+		if (left == 0)
+			break;
+		keep = left > RECORDER_CHUNK_SAMPLES
+				? left - RECORDER_CHUNK_SAMPLES : 0;
+		for (l = rec->streams, i = 0; l; l = l->next, i++) {
+			rs = l->data;
+			end = recorder_stream_end(rs, i, ev);
+			if (end <= rs->sent || end - rs->sent <= keep)
+				continue;
+			recorder_send_stream(sdi, rs, rs->sent, end - keep);
+			rs->sent = end - keep;
+		}
+	}
+}
+
+/*
+ * Send the history in the order it arrived, then start passing on
+ * post-trigger data.
+ */
+static void recorder_trigger(const struct sr_dev_inst *sdi,
+		struct flight_recorder *rec)
+{
+	struct sr_datafeed_packet packet;
+	struct recorder_stream *rs;
+	struct recorder_event *ev;
+	GSList *l;
+	uint64_t total;
+
+	total = 0;
+	for (l = rec->streams; l; l = l->next) {
+		rs = l->data;
+		rs->sent = rs->ring.total - rs->ring.fill;
+		total = MAX(total, rs->ring.fill);
+	}
+
+	sr_dbg("Flight recorder triggered, sending %" PRIu64 " samples and "
+		"%u other packets of history.", total, rec->events.length);
+
+	while ((ev = g_queue_pop_head(&rec->events))) {
+		recorder_send_until(sdi, rec, ev);
+		send_to_callbacks(sdi, ev->packet);
+		recorder_event_free(ev);
+	}
+	recorder_send_until(sdi, rec, NULL);
+
+	packet.type = SR_DF_TRIGGER;
+	packet.payload = NULL;
+	send_to_callbacks(sdi, &packet);
+
+	for (l = rec->streams; l; l = l->next) {
+		rs = l->data;
+		rs->ring.head = 0;
+		rs->ring.fill = 0;
+		rs->ring.total = 0;
+		rs->ring.post_left = rec->post_samples;
+		recorder_segments_clear(rs);
+	}
+	rec->in_post = rec->post_samples > 0;
+}
+
+static void recorder_check_post_done(struct flight_recorder *rec)
+{
+	struct recorder_stream *rs;
+	GSList *l;
+
+	for (l = rec->streams; l; l = l->next) {
+		rs = l->data;
+		if (rs->ring.post_left > 0)
+			return;
+	}
+
+	sr_dbg("Flight recorder post-trigger window done.");
+	rec->in_post = FALSE;
+}
+
+/*
+ * Whether samples which came after an event have been dropped from the
+ * history, so that it no longer lines up with them.
+ */
+static gboolean recorder_event_stale(const struct flight_recorder *rec,
+		const struct recorder_event *ev)
+{
+	const struct recorder_stream *rs;
+	GSList *l;
+	guint i;
+
+	for (l = rec->streams, i = 0; l && i < ev->num_marks; l = l->next, i++) {
+		rs = l->data;
+		if (ev->marks[i] < rs->ring.total - rs->ring.fill)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*
+ * Drop events which no longer belong with the history: gaps, and whole
+ * frames, whose samples have been overwritten. Meta packets stay, as
+ * they still apply to what follows.
+ */
+static void recorder_prune(struct flight_recorder *rec)
+{
+	struct recorder_event *ev;
+	GList *l, *next, *begin;
+
+	begin = NULL;
+	for (l = rec->events.head; l && recorder_event_stale(rec, l->data);
+			l = next) {
+		next = l->next;
+		ev = l->data;
+		switch (ev->packet->type) {
+		case SR_DF_GAP:
+			recorder_event_free(ev);
+			g_queue_delete_link(&rec->events, l);
+			break;
+		case SR_DF_FRAME_BEGIN:
+			begin = l;
+			break;
+		case SR_DF_FRAME_END:
+			if (!begin)
+				break;
+			recorder_event_free(begin->data);
+			g_queue_delete_link(&rec->events, begin);
+			recorder_event_free(ev);
+			g_queue_delete_link(&rec->events, l);
+			begin = NULL;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/* Hold back a packet without samples, along with the history. */
+static int recorder_add_event(struct flight_recorder *rec,
+		const struct sr_datafeed_packet *packet)
+{
+	struct recorder_event *ev;
+	struct recorder_stream *rs;
+	GSList *l;
+	guint i;
+	int ret;
+
+	ev = g_malloc0(sizeof(struct recorder_event));
+	if ((ret = sr_packet_copy(packet, &ev->packet)) != SR_OK) {
+		g_free(ev->packet);
+		g_free(ev);
+		return ret;
+	}
+	ev->num_marks = g_slist_length(rec->streams);
+	ev->marks = g_malloc(ev->num_marks * sizeof(uint64_t));
+	for (l = rec->streams, i = 0; l; l = l->next, i++) {
+		rs = l->data;
+		ev->marks[i] = rs->ring.total;
+	}
+	g_queue_push_tail(&rec->events, ev);
+
+	if (rec->events.length > RECORDER_MAX_EVENTS) {
+		sr_dbg("Too many packets in the flight recorder history, "
+			"dropping the oldest.");
+		recorder_event_free(g_queue_pop_head(&rec->events));
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Pass on as much of a packet's samples as the post-trigger window of
+ * its stream takes. Returns the number of samples passed on.
+ */
+static uint64_t recorder_pass(const struct sr_dev_inst *sdi,
+		struct flight_recorder *rec, struct recorder_stream *rs,
+		const struct sr_datafeed_packet *packet, uint64_t num_samples)
+{
+	struct sr_datafeed_packet post_packet;
+	struct sr_datafeed_logic post_logic;
+	struct sr_datafeed_analog post_analog;
+	struct sr_datafeed_analog_planar post_planar;
+	uint64_t pass;
+
+	if (!rec->in_post)
+		return 0;
+
+	pass = MIN(num_samples, rs->ring.post_left);
+	rs->ring.post_left -= pass;
+	if (pass == num_samples) {
+		send_to_callbacks(sdi, packet);
+	} else if (pass > 0) {
+		post_packet.type = packet->type;
+		switch (rs->kind) {
+		case RECORDER_LOGIC:
+			post_logic = *(const struct sr_datafeed_logic *)packet->payload;
+			post_logic.length = pass * post_logic.unitsize;
+			post_packet.payload = &post_logic;
+			break;
+		case RECORDER_ANALOG:
+			post_analog = *(const struct sr_datafeed_analog *)packet->payload;
+			post_analog.num_samples = pass;
+			post_packet.payload = &post_analog;
+			break;
+		case RECORDER_PLANAR:
+			post_planar = *(const struct sr_datafeed_analog_planar *)packet->payload;
+			post_planar.num_samples = pass;
+			post_packet.payload = &post_planar;
+			break;
+		}
+		send_to_callbacks(sdi, &post_packet);
+	}
+	recorder_check_post_done(rec);
+
+	return pass;
+}
+
+/*
+ * Run a packet through the flight recorder: samples are either added to
+ * the history, or passed on if we're in the post-trigger window. Other
+ * packets are held back with the history, in order, outside the window.
+ */
+static int recorder_receive(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	struct flight_recorder *rec;
+	struct recorder_stream *rs;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_analog_planar *planar;
+	uint64_t num_samples, pass;
+	uint32_t i;
+	int ret;
+
+	rec = sdi->session->recorder;
+
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		if (logic->unitsize == 0)
+			return SR_ERR_ARG;
+		rs = recorder_stream_get(rec, RECORDER_LOGIC, NULL,
+				logic->unitsize);
+		num_samples = logic->length / logic->unitsize;
+		pass = recorder_pass(sdi, rec, rs, packet, num_samples);
+		/* Whatever isn't passed on becomes history. */
+		ring_store(&rs->ring,
+			(const uint8_t *)logic->data + pass * logic->unitsize,
+			num_samples - pass);
+		recorder_prune(rec);
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		if (!analog->encoding || !analog->meaning || !analog->spec
+				|| analog->encoding->unitsize == 0)
+			return SR_ERR_ARG;
+		rs = recorder_stream_get(rec, RECORDER_ANALOG,
+			analog->meaning->channels, analog->encoding->unitsize
+			* MAX(g_slist_length(analog->meaning->channels), 1));
+		rs->encoding = *analog->encoding;
+		rs->meaning = *analog->meaning;
+		rs->meaning.channels = rs->channels;
+		rs->spec = *analog->spec;
+		/* Samples per channel, the channels' values are interleaved. */
+		num_samples = analog->num_samples;
+		pass = recorder_pass(sdi, rec, rs, packet, num_samples);
+		ring_store(&rs->ring,
+			(const uint8_t *)analog->data + pass * rs->ring.size,
+			num_samples - pass);
+		recorder_prune(rec);
+		break;
+	case SR_DF_ANALOG_PLANAR:
+		planar = packet->payload;
+		if (planar->num_planes == 0)
+			return SR_ERR_ARG;
+		for (i = 0; i < planar->num_planes; i++) {
+			if (!planar->planes[i].encoding
+					|| !planar->planes[i].meaning
+					|| !planar->planes[i].spec
+					|| planar->planes[i].encoding->unitsize == 0)
+				return SR_ERR_ARG;
+		}
+		rs = recorder_planar_get(rec, planar);
+		num_samples = planar->num_samples;
+		pass = recorder_pass(sdi, rec, rs, packet, num_samples);
+		ring_store_planar(rs, planar, pass, num_samples - pass);
+		recorder_segment_add(rs, planar, pass, num_samples - pass);
+		recorder_prune(rec);
+		break;
+	case SR_DF_HEADER:
+		send_to_callbacks(sdi, packet);
+		break;
+	case SR_DF_TRIGGER:
+		if (rec->in_post)
+			send_to_callbacks(sdi, packet);
+		else
+			recorder_trigger(sdi, rec);
+		return SR_OK;
+	case SR_DF_END:
+		/* History which was never triggered is discarded. */
+		recorder_reset(rec);
+		send_to_callbacks(sdi, packet);
+		return SR_OK;
+	default:
+		if (rec->in_post)
+			send_to_callbacks(sdi, packet);
+		else if ((ret = recorder_add_event(rec, packet)) != SR_OK)
+			return ret;
+		break;
+	}
+
+	if (g_atomic_int_get(&rec->snapshot_pending)) {
+		g_atomic_int_set(&rec->snapshot_pending, 0);
+		if (rec->in_post)
+			sr_dbg("Snapshot requested during post-trigger window, "
+				"ignoring.");
+		else
+			recorder_trigger(sdi, rec);
+	}
+
+	return SR_OK;
+}
+
 /**
  * Send a packet to whatever is listening on the datafeed bus.
  *
@@ -1093,7 +2164,6 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet)
 {
 	GSList *l;
-	struct datafeed_callback *cb_struct;
 	struct sr_datafeed_packet *packet_in, *packet_out;
 	struct sr_transform *t;
 	int ret;
@@ -1114,7 +2184,11 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 	}
 
 	if (packet->type == SR_DF_ANALOG_OLD) {
-		/* Convert to SR_DF_ANALOG. */
+		/*
+		 * Convert to SR_DF_ANALOG. All in-tree drivers send that
+		 * directly; this is only kept for out-of-tree ones, whose
+		 * digits are unknown.
+		 */
 		const struct sr_datafeed_analog_old *analog_old = packet->payload;
 		struct sr_analog_encoding encoding;
 		struct sr_analog_meaning meaning;
@@ -1183,14 +2257,12 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 
 	/*
 	 * If the last transform did output a packet, pass it to all datafeed
-	 * callbacks.
+	 * callbacks, or have the flight recorder decide what to pass on.
 	 */
-	for (l = sdi->session->datafeed_callbacks; l; l = l->next) {
-		if (sr_log_loglevel_get() >= SR_LOG_DBG)
-			datafeed_dump(packet);
-		cb_struct = l->data;
-		cb_struct->cb(sdi, packet, cb_struct->cb_data);
-	}
+	if (sdi->session->recorder)
+		return recorder_receive(sdi, packet);
+
+	send_to_callbacks(sdi, packet);
 
 	return SR_OK;
 }
@@ -1502,7 +2574,15 @@ SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	struct sr_datafeed_analog_old *analog_old_copy;
 	const struct sr_datafeed_analog *analog;
 	struct sr_datafeed_analog *analog_copy;
+	const struct sr_datafeed_analog_planar *planar;
+	struct sr_datafeed_analog_planar *planar_copy;
+	const struct sr_analog_plane *plane;
+	struct sr_analog_plane *plane_copy;
+	const uint8_t *src;
 	uint8_t *payload;
+	unsigned int unitsize, stride;
+	uint32_t i, j;
+	gsize size;
 
 	*copy = g_malloc0(sizeof(struct sr_datafeed_packet));
 	(*copy)->type = packet->type;
@@ -1510,6 +2590,8 @@ SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
 	case SR_DF_HEADER:
@@ -1517,10 +2599,14 @@ SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
 		memcpy(payload, packet->payload, sizeof(struct sr_datafeed_header));
 		(*copy)->payload = payload;
 		break;
+	case SR_DF_GAP:
+		(*copy)->payload = g_memdup(packet->payload,
+				sizeof(struct sr_datafeed_gap));
+		break;
 	case SR_DF_META:
 		meta = packet->payload;
 		meta_copy = g_malloc0(sizeof(struct sr_datafeed_meta));
-		g_slist_foreach(meta->config, (GFunc)copy_src, meta_copy->config);
+		g_slist_foreach(meta->config, (GFunc)copy_src, meta_copy);
 		(*copy)->payload = meta_copy;
 		break;
 	case SR_DF_LOGIC:
@@ -1528,7 +2614,7 @@ SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
 		logic_copy = g_malloc(sizeof(*logic_copy));
 		logic_copy->length = logic->length;
 		logic_copy->unitsize = logic->unitsize;
-		memcpy(logic_copy->data, logic->data, logic->length * logic->unitsize);
+		logic_copy->data = g_memdup(logic->data, logic->length);
 		(*copy)->payload = logic_copy;
 		break;
 	case SR_DF_ANALOG_OLD:
@@ -1547,10 +2633,10 @@ SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	case SR_DF_ANALOG:
 		analog = packet->payload;
 		analog_copy = g_malloc(sizeof(*analog_copy));
-		analog_copy->data = g_malloc(
-				analog->encoding->unitsize * analog->num_samples);
-		memcpy(analog_copy->data, analog->data,
-				analog->encoding->unitsize * analog->num_samples);
+		/* num_samples counts samples per channel. */
+		size = analog->encoding->unitsize * analog->num_samples
+				* MAX(g_slist_length(analog->meaning->channels), 1);
+		analog_copy->data = g_memdup(analog->data, size);
 		analog_copy->num_samples = analog->num_samples;
 		analog_copy->encoding = g_memdup(analog->encoding,
 				sizeof(struct sr_analog_encoding));
@@ -1562,6 +2648,38 @@ SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
 				sizeof(struct sr_analog_spec));
 		(*copy)->payload = analog_copy;
 		break;
+	case SR_DF_ANALOG_PLANAR:
+		/*
+		 * Every plane gets its own packed data and descriptors, so
+		 * the copy can be freed plane by plane.
+		 */
+		planar = packet->payload;
+		planar_copy = g_memdup(planar, sizeof(*planar_copy));
+		planar_copy->planes = g_malloc0(planar->num_planes *
+				sizeof(struct sr_analog_plane));
+		for (i = 0; i < planar->num_planes; i++) {
+			plane = &planar->planes[i];
+			plane_copy = &planar_copy->planes[i];
+			unitsize = plane->encoding->unitsize;
+			stride = plane->stride ? plane->stride : unitsize;
+			payload = g_malloc(unitsize * planar->num_samples);
+			src = plane->data;
+			for (j = 0; j < planar->num_samples; j++)
+				memcpy(payload + j * unitsize, src + j * stride,
+						unitsize);
+			plane_copy->channel = plane->channel;
+			plane_copy->data = payload;
+			plane_copy->stride = 0;
+			plane_copy->encoding = g_memdup(plane->encoding,
+					sizeof(struct sr_analog_encoding));
+			plane_copy->meaning = g_memdup(plane->meaning,
+					sizeof(struct sr_analog_meaning));
+			plane_copy->meaning->channels = NULL;
+			plane_copy->spec = g_memdup(plane->spec,
+					sizeof(struct sr_analog_spec));
+		}
+		(*copy)->payload = planar_copy;
+		break;
 	default:
 		sr_err("Unknown packet type %d", packet->type);
 		return SR_ERR;
@@ -1576,15 +2694,20 @@ void sr_packet_free(struct sr_datafeed_packet *packet)
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog_old *analog_old;
 	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_analog_planar *planar;
 	struct sr_config *src;
 	GSList *l;
+	uint32_t i;
 
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
 	case SR_DF_HEADER:
+	case SR_DF_GAP:
 		/* Payload is a simple struct. */
 		g_free((void *)packet->payload);
 		break;
@@ -1618,6 +2741,17 @@ void sr_packet_free(struct sr_datafeed_packet *packet)
 		g_free(analog->spec);
 		g_free((void *)packet->payload);
 		break;
+	case SR_DF_ANALOG_PLANAR:
+		planar = packet->payload;
+		for (i = 0; i < planar->num_planes; i++) {
+			g_free(planar->planes[i].data);
+			g_free(planar->planes[i].encoding);
+			g_free(planar->planes[i].meaning);
+			g_free(planar->planes[i].spec);
+		}
+		g_free(planar->planes);
+		g_free((void *)packet->payload);
+		break;
 	default:
 		sr_err("Unknown packet type %d", packet->type);
 	}
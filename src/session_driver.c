@@ -23,6 +23,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <string.h>
 #include <zip.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
@@ -48,8 +49,18 @@ struct session_vdev {
 	int num_analog_channels;
 	int cur_analog_channel;
 	GArray *analog_channels;
+	/* Digits of each analog channel, G_MININT if not recorded. */
+	int *analog_digits;
 	int cur_chunk;
 	gboolean finished;
+	/* Logic chunk stored as a transition list, see output/srzip.c. */
+	uint8_t *edges;
+	size_t edges_len;
+	size_t edges_pos;
+	uint64_t edges_samples;
+	uint64_t edges_cur;
+	uint64_t edges_next;
+	uint8_t *edges_value;
 };
 
 static const uint32_t devopts[] = {
@@ -61,41 +72,186 @@ static const uint32_t devopts[] = {
 	SR_CONF_SESSIONFILE | SR_CONF_SET,
 };
 
+static int edges_next(struct session_vdev *vdev)
+{
+	uint64_t delta;
+	int shift;
+
+	if (vdev->edges_pos == vdev->edges_len) {
+		vdev->edges_next = vdev->edges_samples;
+		return SR_OK;
+	}
+
+	delta = 0;
+	shift = 0;
+	do {
+		if (vdev->edges_pos == vdev->edges_len || shift > 63)
+			return SR_ERR_DATA;
+		delta |= (uint64_t)(vdev->edges[vdev->edges_pos] & 0x7f) << shift;
+		shift += 7;
+	} while (vdev->edges[vdev->edges_pos++] & 0x80);
+
+	if (delta == 0 || delta > vdev->edges_samples - vdev->edges_next ||
+			vdev->edges_len - vdev->edges_pos < (size_t)vdev->unitsize)
+		return SR_ERR_DATA;
+	vdev->edges_next += delta;
+
+	return SR_OK;
+}
+
+/* Read a whole transition list chunk, and start expanding it. */
+static int edges_open(struct session_vdev *vdev, const char *name,
+		const struct zip_stat *zs)
+{
+	struct zip_file *zf;
+	zip_int64_t len;
+	int i;
+
+	if (!vdev->unitsize || zs->size > G_MAXSIZE ||
+			zs->size < 8 + (zip_uint64_t)vdev->unitsize) {
+		sr_err("Invalid transition list '%s'.", name);
+		return SR_ERR_DATA;
+	}
+	if (!(vdev->edges = g_try_malloc(zs->size))) {
+		sr_err("Failed to allocate transition list buffer.");
+		return SR_ERR_MALLOC;
+	}
+	vdev->edges_len = zs->size;
+	if (!(zf = zip_fopen_index(vdev->archive, zs->index, 0)))
+		return SR_ERR;
+	len = zip_fread(zf, vdev->edges, vdev->edges_len);
+	zip_fclose(zf);
+	if (len < 0 || (size_t)len != vdev->edges_len) {
+		sr_err("Failed to read '%s'.", name);
+		return SR_ERR;
+	}
+
+	vdev->edges_samples = 0;
+	for (i = 0; i < 8; i++)
+		vdev->edges_samples |= (uint64_t)vdev->edges[i] << (i * 8);
+	vdev->edges_value = vdev->edges + 8;
+	vdev->edges_pos = 8 + vdev->unitsize;
+	vdev->edges_cur = 0;
+	vdev->edges_next = 0;
+	if (edges_next(vdev) != SR_OK) {
+		sr_err("Invalid transition list '%s'.", name);
+		return SR_ERR_DATA;
+	}
+	sr_dbg("Opened %s.", name);
+
+	return SR_OK;
+}
+
+static void edges_close(struct session_vdev *vdev)
+{
+	g_free(vdev->edges);
+	vdev->edges = NULL;
+}
+
+/*
+ * Expand up to max_samples samples of the transition list into buf.
+ * Returns the number of bytes written, or a negative error code.
+ */
+static int edges_expand(struct session_vdev *vdev, uint8_t *buf,
+		uint64_t max_samples)
+{
+	uint64_t run, n, done;
+	int unitsize;
+
+	unitsize = vdev->unitsize;
+	n = 0;
+	while (n < max_samples && vdev->edges_cur < vdev->edges_samples) {
+		if (vdev->edges_cur == vdev->edges_next) {
+			vdev->edges_value = vdev->edges + vdev->edges_pos;
+			vdev->edges_pos += unitsize;
+			if (edges_next(vdev) != SR_OK) {
+				sr_err("Invalid transition list.");
+				return SR_ERR_DATA;
+			}
+		}
+		run = MIN(vdev->edges_next - vdev->edges_cur, max_samples - n);
+		if (unitsize == 1) {
+			memset(buf + n, vdev->edges_value[0], run);
+		} else {
+			/* Fill by doubling the part already written. */
+			memcpy(buf + n * unitsize, vdev->edges_value, unitsize);
+			for (done = 1; done < run; done *= 2)
+				memcpy(buf + (n + done) * unitsize,
+					buf + n * unitsize,
+					MIN(done, run - done) * unitsize);
+		}
+		n += run;
+		vdev->edges_cur += run;
+	}
+
+	return n * unitsize;
+}
+
+/*
+ * Open a chunk of capture data: a raw one, or, for logic data, one
+ * stored as a transition list. Returns SR_ERR_NA if there's neither.
+ */
+static int open_chunk(struct session_vdev *vdev, const char *name)
+{
+	struct zip_stat zs;
+	char *edges_name;
+	int ret;
+
+	if (zip_stat(vdev->archive, name, 0, &zs) != -1) {
+		if (!(vdev->capfile = zip_fopen(vdev->archive, name, 0)))
+			return SR_ERR;
+		sr_dbg("Opened %s.", name);
+		return SR_OK;
+	}
+
+	if (vdev->cur_analog_channel != 0)
+		return SR_ERR_NA;
+	edges_name = g_strconcat(name, SR_SESSIONFILE_EDGES_SUFFIX, NULL);
+	if (zip_stat(vdev->archive, edges_name, 0, &zs) != -1)
+		ret = edges_open(vdev, edges_name, &zs);
+	else
+		ret = SR_ERR_NA;
+	g_free(edges_name);
+	if (ret != SR_OK && ret != SR_ERR_NA)
+		edges_close(vdev);
+
+	return ret;
+}
+
 static gboolean stream_session_data(struct sr_dev_inst *sdi)
 {
 	struct session_vdev *vdev;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
-	struct sr_datafeed_analog_old analog;
-	struct zip_stat zs;
-	int ret, got_data;
-	char capturefile[16];
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	int ret, got_data, digits;
+	char capturefile[32];
 	void *buf;
 
 	got_data = FALSE;
 	vdev = sdi->priv;
 
-	if (!vdev->capfile) {
+	if (!vdev->capfile && !vdev->edges) {
 		/* No capture file opened yet, or finished with the last
 		 * chunked one. */
 		if (vdev->capturefile && (vdev->cur_chunk == 0)) {
 			/* capturefile is always the unchunked base name. */
-			if (zip_stat(vdev->archive, vdev->capturefile, 0, &zs) != -1) {
+			if ((ret = open_chunk(vdev, vdev->capturefile)) == SR_OK) {
 				/* No chunks, just a single capture file. */
 				vdev->cur_chunk = 0;
-				if (!(vdev->capfile = zip_fopen(vdev->archive,
-						vdev->capturefile, 0)))
-					return FALSE;
-				sr_dbg("Opened %s.", vdev->capturefile);
+			} else if (ret != SR_ERR_NA) {
+				return FALSE;
 			} else {
 				/* Try as first chunk filename. */
-				snprintf(capturefile, 15, "%s-1", vdev->capturefile);
-				if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
+				snprintf(capturefile, sizeof(capturefile), "%s-1",
+						vdev->capturefile);
+				if ((ret = open_chunk(vdev, capturefile)) == SR_OK) {
 					vdev->cur_chunk = 1;
-					if (!(vdev->capfile = zip_fopen(vdev->archive,
-							capturefile, 0)))
-						return FALSE;
-					sr_dbg("Opened %s.", capturefile);
+				} else if (ret != SR_ERR_NA) {
+					return FALSE;
 				} else {
 					sr_err("No capture file '%s' in " "session file '%s'.",
 							vdev->capturefile, vdev->sessionfile);
@@ -105,13 +261,12 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 		} else {
 			/* Capture data is chunked, advance to the next chunk. */
 			vdev->cur_chunk++;
-			snprintf(capturefile, 15, "%s-%d", vdev->capturefile,
-					vdev->cur_chunk);
-			if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
-				if (!(vdev->capfile = zip_fopen(vdev->archive,
-						capturefile, 0)))
-					return FALSE;
-				sr_dbg("Opened %s.", capturefile);
+			snprintf(capturefile, sizeof(capturefile), "%s-%d",
+					vdev->capturefile, vdev->cur_chunk);
+			if ((ret = open_chunk(vdev, capturefile)) == SR_OK) {
+				/* Carry on with this chunk. */
+			} else if (ret != SR_ERR_NA) {
+				return FALSE;
 			} else if (vdev->cur_analog_channel < vdev->num_analog_channels) {
 				vdev->capturefile = g_strdup_printf("analog-1-%d",
 						vdev->num_channels + vdev->cur_analog_channel + 1);
@@ -128,25 +283,38 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 	buf = g_malloc(CHUNKSIZE);
 
 	/* unitsize is not defined for purely analog session files. */
-	if (vdev->unitsize)
+	if (vdev->edges)
+		ret = edges_expand(vdev, buf, CHUNKSIZE / vdev->unitsize);
+	else if (vdev->unitsize)
 		ret = zip_fread(vdev->capfile, buf,
 				CHUNKSIZE / vdev->unitsize * vdev->unitsize);
 	else
 		ret = zip_fread(vdev->capfile, buf, CHUNKSIZE);
 
+	if (ret < 0 && vdev->edges) {
+		edges_close(vdev);
+		g_free(buf);
+		return FALSE;
+	}
+
 	if (ret > 0) {
 		got_data = TRUE;
 		if (vdev->cur_analog_channel != 0) {
-			packet.type = SR_DF_ANALOG_OLD;
+			packet.type = SR_DF_ANALOG;
 			packet.payload = &analog;
-			analog.channels = g_slist_prepend(NULL,
+			digits = vdev->analog_digits[vdev->cur_analog_channel - 1];
+			sr_analog_init(&analog, &encoding, &meaning, &spec,
+					MAX(digits, 0));
+			if (digits == G_MININT)
+				encoding.is_digits_decimal = FALSE;
+			meaning.channels = g_slist_prepend(NULL,
 					g_array_index(vdev->analog_channels,
 						struct sr_channel *, vdev->cur_analog_channel - 1));
+			meaning.mq = SR_MQ_VOLTAGE;
+			meaning.unit = SR_UNIT_VOLT;
+			meaning.mqflags = SR_MQFLAG_DC;
 			analog.num_samples = ret / sizeof(float);
-			analog.mq = SR_MQ_VOLTAGE;
-			analog.unit = SR_UNIT_VOLT;
-			analog.mqflags = SR_MQFLAG_DC;
-			analog.data = (float *) buf;
+			analog.data = buf;
 		} else {
 			if (ret % vdev->unitsize != 0)
 				sr_warn("Read size %d not a multiple of the"
@@ -159,10 +327,16 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 		}
 		vdev->bytes_read += ret;
 		sr_session_send(sdi, &packet);
+		if (packet.type == SR_DF_ANALOG)
+			g_slist_free(meaning.channels);
 	} else {
 		/* done with this capture file */
-		zip_fclose(vdev->capfile);
-		vdev->capfile = NULL;
+		if (vdev->edges) {
+			edges_close(vdev);
+		} else {
+			zip_fclose(vdev->capfile);
+			vdev->capfile = NULL;
+		}
 		if (vdev->cur_chunk != 0) {
 			/* There might be more chunks, so don't fall through
 			 * to the SR_DF_END here. */
@@ -195,6 +369,7 @@ static int receive_data(int fd, int revents, void *cb_data)
 		zip_fclose(vdev->capfile);
 		vdev->capfile = NULL;
 	}
+	edges_close(vdev);
 	if (vdev->archive) {
 		zip_discard(vdev->archive);
 		vdev->archive = NULL;
@@ -247,6 +422,7 @@ static int dev_close(struct sr_dev_inst *sdi)
 	const struct session_vdev *const vdev = sdi->priv;
 	g_free(vdev->sessionfile);
 	g_free(vdev->capturefile);
+	g_free(vdev->analog_digits);
 
 	g_free(sdi->priv);
 	sdi->priv = NULL;
@@ -338,6 +514,40 @@ static int config_list(uint32_t key, GVariant **data, const struct sr_dev_inst *
 	return SR_OK;
 }
 
+/* The digits srzip recorded for each analog channel, if any. */
+static void read_analog_digits(struct session_vdev *vdev)
+{
+	struct zip_stat zs;
+	GKeyFile *kf;
+	GError *error;
+	char *key;
+	int i, digits;
+
+	g_free(vdev->analog_digits);
+	vdev->analog_digits = g_malloc(sizeof(int)
+			* MAX(vdev->num_analog_channels, 1));
+	for (i = 0; i < vdev->num_analog_channels; i++)
+		vdev->analog_digits[i] = G_MININT;
+
+	if (zip_stat(vdev->archive, "metadata", 0, &zs) < 0)
+		return;
+	if (!(kf = sr_sessionfile_read_metadata(vdev->archive, &zs)))
+		return;
+
+	for (i = 0; i < vdev->num_analog_channels; i++) {
+		key = g_strdup_printf(SR_SESSIONFILE_ANALOG_DIGITS "%d",
+				vdev->num_channels + i + 1);
+		error = NULL;
+		digits = g_key_file_get_integer(kf, "device 1", key, &error);
+		if (!error)
+			vdev->analog_digits[i] = CLAMP(digits, G_MININT8, G_MAXINT8);
+		else
+			g_error_free(error);
+		g_free(key);
+	}
+	g_key_file_free(kf);
+}
+
 static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 {
 	struct session_vdev *vdev;
@@ -368,6 +578,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 		       "zip error %d.", vdev->sessionfile, ret);
 		return SR_ERR;
 	}
+	read_analog_digits(vdev);
 
 	/* Send header packet to the session bus. */
 	std_session_send_df_header(sdi, LOG_PREFIX);
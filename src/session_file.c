@@ -104,8 +104,12 @@ SR_PRIV GKeyFile *sr_sessionfile_read_metadata(struct zip *archive,
 	return keyfile;
 }
 
-/** @private */
-SR_PRIV int sr_sessionfile_check(const char *filename)
+/*
+ * Open a session file, and check its version and metadata. The archive
+ * is left open upon success, for the caller to zip_discard().
+ */
+static int sessionfile_open(const char *filename, struct zip **archive_out,
+		uint64_t *version_out)
 {
 	struct zip *archive;
 	struct zip_file *zf;
@@ -144,7 +148,7 @@ SR_PRIV int sr_sessionfile_check(const char *filename)
 	zip_fclose(zf);
 	s[ret] = '\0';
 	version = g_ascii_strtoull(s, NULL, 10);
-	if (version == 0 || version > 2) {
+	if (version == 0 || version > SR_SESSIONFILE_VERSION_MAX) {
 		sr_dbg("Cannot handle sigrok session file version %" PRIu64 ".",
 			version);
 		zip_discard(archive);
@@ -158,11 +162,67 @@ SR_PRIV int sr_sessionfile_check(const char *filename)
 		zip_discard(archive);
 		return SR_ERR;
 	}
+
+	*archive_out = archive;
+	if (version_out)
+		*version_out = version;
+
+	return SR_OK;
+}
+
+/** @private */
+SR_PRIV int sr_sessionfile_check(const char *filename)
+{
+	struct zip *archive;
+	int ret;
+
+	if ((ret = sessionfile_open(filename, &archive, NULL)) != SR_OK)
+		return ret;
 	zip_discard(archive);
 
 	return SR_OK;
 }
 
+/*
+ * Create num channels named after their index, starting at first, and
+ * append them to the list. sr_channel_new() walks the list for every
+ * channel, this doesn't. The new channels are also added to the array,
+ * so they can be looked up by position.
+ */
+static void channels_add(struct sr_dev_inst *sdi, GSList **list,
+		GPtrArray *array, int first, int num, int type)
+{
+	struct sr_channel *ch;
+	GSList *l, *new;
+	int k;
+
+	new = NULL;
+	for (k = first + num - 1; k >= first; k--) {
+		ch = g_malloc0(sizeof(struct sr_channel));
+		ch->sdi = sdi;
+		ch->index = k;
+		ch->type = type;
+		ch->name = g_strdup_printf("%d", k);
+		new = g_slist_prepend(new, ch);
+	}
+	for (l = new; l; l = l->next)
+		g_ptr_array_add(array, l->data);
+	*list = g_slist_concat(*list, new);
+}
+
+/* The channel a "probeN" or "analogN" metadata key refers to. */
+static struct sr_channel *channel_from_key(GPtrArray *array,
+		const char *num)
+{
+	uint64_t n;
+
+	n = g_ascii_strtoull(num, NULL, 10);
+	if (n == 0 || n > array->len)
+		return NULL;
+
+	return g_ptr_array_index(array, n - 1);
+}
+
 SR_PRIV struct sr_dev_inst *sr_session_prepare_sdi(const char *filename, struct sr_session **session)
 {
 	struct sr_dev_inst *sdi = NULL;
@@ -205,21 +265,17 @@ SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 	struct zip_stat zs;
 	struct sr_dev_inst *sdi;
 	struct sr_channel *ch;
+	GPtrArray *channels;
 	int ret, i, j;
 	uint64_t tmp_u64;
-	int total_channels, total_analog, k;
-	GSList *l;
+	int total_channels, total_analog;
 	int unitsize;
 	char **sections, **keys, *val;
-	char channelname[SR_MAX_CHANNELNAME_LEN + 1];
 	gboolean file_has_logic;
 
-	if ((ret = sr_sessionfile_check(filename)) != SR_OK)
+	if ((ret = sessionfile_open(filename, &archive, NULL)) != SR_OK)
 		return ret;
 
-	if (!(archive = zip_open(filename, 0, NULL)))
-		return SR_ERR;
-
 	if (zip_stat(archive, "metadata", 0, &zs) < 0) {
 		zip_discard(archive);
 		return SR_ERR;
@@ -235,6 +291,7 @@ SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 	}
 
 	total_channels = 0;
+	channels = g_ptr_array_new();
 
 	error = NULL;
 	ret = SR_OK;
@@ -247,6 +304,7 @@ SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 		if (!strncmp(sections[i], "device ", 7)) {
 			/* device section */
 			sdi = NULL;
+			g_ptr_array_set_size(channels, 0);
 			keys = g_key_file_get_keys(kf, sections[i], NULL, NULL);
 
 			/* File contains analog data if there are analog channels. */
@@ -300,12 +358,8 @@ SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 					}
 					sr_config_set(sdi, NULL, SR_CONF_NUM_LOGIC_CHANNELS,
 							g_variant_new_int32(total_channels));
-					for (k = 0; k < total_channels; k++) {
-						g_snprintf(channelname, sizeof(channelname),
-								"%d", k);
-						sr_channel_new(sdi, k, SR_CHANNEL_LOGIC,
-								FALSE, channelname);
-					}
+					channels_add(sdi, &sdi->channels, channels, 0,
+							total_channels, SR_CHANNEL_LOGIC);
 				} else if (!strcmp(keys[j], "total analog")) {
 					total_analog = g_key_file_get_integer(kf,
 							sections[i], keys[j], &error);
@@ -315,20 +369,12 @@ SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 					}
 					sr_config_set(sdi, NULL, SR_CONF_NUM_ANALOG_CHANNELS,
 							g_variant_new_int32(total_analog));
-					for (k = total_channels; k < (total_channels + total_analog); k++) {
-						g_snprintf(channelname, sizeof(channelname),
-								"%d", k);
-						sr_channel_new(sdi, k, SR_CHANNEL_ANALOG,
-								FALSE, channelname);
-					}
+					channels_add(sdi, &sdi->channels, channels,
+							total_channels, total_analog,
+							SR_CHANNEL_ANALOG);
 				} else if (!strncmp(keys[j], "probe", 5)) {
-					tmp_u64 = g_ascii_strtoull(keys[j] + 5, NULL, 10);
-					if (!sdi || tmp_u64 == 0 || tmp_u64 > G_MAXINT) {
-						ret = SR_ERR_DATA;
-						break;
-					}
-					ch = g_slist_nth_data(sdi->channels, tmp_u64 - 1);
-					if (!ch) {
+					ch = channel_from_key(channels, keys[j] + 5);
+					if (!sdi || !ch) {
 						ret = SR_ERR_DATA;
 						break;
 					}
@@ -343,20 +389,8 @@ SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 					g_free(val);
 					sr_dev_channel_enable(ch, TRUE);
 				} else if (!strncmp(keys[j], "analog", 6)) {
-					tmp_u64 = g_ascii_strtoull(keys[j]+6, NULL, 10);
-					if (!sdi || tmp_u64 == 0 || tmp_u64 > G_MAXINT) {
-						ret = SR_ERR_DATA;
-						break;
-					}
-					ch = NULL;
-					for (l = sdi->channels; l; l = l->next) {
-						ch = l->data;
-						if ((guint64)ch->index == tmp_u64 - 1)
-							break;
-						else
-							ch = NULL;
-					}
-					if (!ch) {
+					ch = channel_from_key(channels, keys[j] + 6);
+					if (!sdi || !ch) {
 						ret = SR_ERR_DATA;
 						break;
 					}
@@ -377,6 +411,7 @@ SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 	}
 	g_strfreev(sections);
 	g_key_file_free(kf);
+	g_ptr_array_free(channels, TRUE);
 
 	if (error) {
 		sr_err("Failed to parse metadata: %s", error->message);
@@ -385,4 +420,222 @@ SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 	return ret;
 }
 
+/* Number of samples in a transition list chunk, from its header. */
+static int edges_num_samples(struct zip *archive, const struct zip_stat *zs,
+		uint64_t *num_samples)
+{
+	struct zip_file *zf;
+	uint8_t buf[8];
+	int i;
+
+	if (!(zf = zip_fopen_index(archive, zs->index, 0)))
+		return SR_ERR;
+	i = zip_fread(zf, buf, sizeof(buf));
+	zip_fclose(zf);
+	if (i != sizeof(buf)) {
+		sr_err("Invalid transition list '%s'.", zs->name);
+		return SR_ERR_DATA;
+	}
+
+	*num_samples = 0;
+	for (i = 0; i < 8; i++)
+		*num_samples |= (uint64_t)buf[i] << (i * 8);
+
+	return SR_OK;
+}
+
+/*
+ * Count the samples of a file written without sample counts in its
+ * metadata, from the sizes of its chunks. Analog samples are counted for
+ * the analog channel numbered analog_num.
+ */
+static int count_samples(struct zip *archive,
+		struct sr_session_file_info *info, int analog_num)
+{
+	struct zip_stat zs;
+	int64_t i, num_entries;
+	uint64_t n;
+	char *analog_prefix;
+	int ret;
+
+	analog_prefix = g_strdup_printf("analog-1-%d-", analog_num);
+	num_entries = zip_get_num_entries(archive, 0);
+	ret = SR_OK;
+	for (i = 0; i < num_entries && ret == SR_OK; i++) {
+		if (zip_stat_index(archive, i, 0, &zs) < 0 || !zs.name)
+			continue;
+		if (!strncmp(zs.name, "logic-1", 7) &&
+				(zs.name[7] == '\0' || zs.name[7] == '-')) {
+			if (g_str_has_suffix(zs.name, SR_SESSIONFILE_EDGES_SUFFIX)) {
+				ret = edges_num_samples(archive, &zs, &n);
+				info->logic_samples += n;
+			} else if (info->unitsize > 0) {
+				info->logic_samples += zs.size / info->unitsize;
+			}
+		} else if (analog_num > 0 &&
+				g_str_has_prefix(zs.name, analog_prefix)) {
+			info->analog_samples += zs.size / sizeof(float);
+		}
+	}
+	g_free(analog_prefix);
+
+	return ret;
+}
+
+/**
+ * Get a summary of a session file, without loading it into a session.
+ *
+ * This opens the file once, and reads the metadata only, along with the
+ * headers of transition list chunks in files which don't record their
+ * sample counts.
+ *
+ * @param[in] filename The name of the session file.
+ * @param[out] info The summary. Must be freed with
+ *                  sr_session_file_info_free().
+ *
+ * @retval SR_OK Success
+ * @retval SR_ERR_ARG Invalid argument
+ * @retval SR_ERR_DATA Malformed session file
+ * @retval SR_ERR This is not a session file
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_session_file_info(const char *filename,
+		struct sr_session_file_info **info)
+{
+	struct sr_session_file_info *fi;
+	struct sr_channel *ch;
+	struct zip *archive;
+	struct zip_stat zs;
+	GKeyFile *kf;
+	GPtrArray *channels;
+	const char *devgroup;
+	char **keys, *val;
+	uint64_t version;
+	int ret, j, total_probes, total_analog, analog_num, n;
+	gboolean has_counts;
+
+	if (!info)
+		return SR_ERR_ARG;
+
+	if ((ret = sessionfile_open(filename, &archive, &version)) != SR_OK)
+		return ret;
+
+	if (zip_stat(archive, "metadata", 0, &zs) < 0) {
+		zip_discard(archive);
+		return SR_ERR;
+	}
+	if (!(kf = sr_sessionfile_read_metadata(archive, &zs))) {
+		zip_discard(archive);
+		return SR_ERR_DATA;
+	}
+
+	fi = g_malloc0(sizeof(struct sr_session_file_info));
+	fi->version = version;
+	channels = g_ptr_array_new();
+	devgroup = "device 1";
+	ret = SR_OK;
+
+	val = g_key_file_get_string(kf, devgroup, "samplerate", NULL);
+	if (val && sr_parse_sizestring(val, &fi->samplerate) != SR_OK)
+		ret = SR_ERR_DATA;
+	g_free(val);
+
+	/* As in sr_session_load(), only files with logic data have a
+	 * capturefile, and only those have a meaningful unitsize. */
+	total_probes = 0;
+	if (g_key_file_has_key(kf, devgroup, "capturefile", NULL)) {
+		fi->unitsize = g_key_file_get_integer(kf, devgroup,
+				"unitsize", NULL);
+		total_probes = g_key_file_get_integer(kf, devgroup,
+				"total probes", NULL);
+	}
+	total_analog = g_key_file_get_integer(kf, devgroup,
+			"total analog", NULL);
+	if (fi->unitsize < 0 || total_probes < 0 || total_analog < 0)
+		ret = SR_ERR_DATA;
+
+	if (ret == SR_OK) {
+		channels_add(NULL, &fi->channels, channels, 0,
+				total_probes, SR_CHANNEL_LOGIC);
+		channels_add(NULL, &fi->channels, channels, total_probes,
+				total_analog, SR_CHANNEL_ANALOG);
+	}
+
+	analog_num = 0;
+	keys = NULL;
+	if (ret == SR_OK)
+		keys = g_key_file_get_keys(kf, devgroup, NULL, NULL);
+	for (j = 0; keys && keys[j] && ret == SR_OK; j++) {
+		if (!strncmp(keys[j], "probe", 5)) {
+			ch = channel_from_key(channels, keys[j] + 5);
+		} else if (!strncmp(keys[j], "analog", 6) &&
+				g_ascii_isdigit(keys[j][6])) {
+			ch = channel_from_key(channels, keys[j] + 6);
+			n = g_ascii_strtoull(keys[j] + 6, NULL, 10);
+			if (analog_num == 0 || n < analog_num)
+				analog_num = n;
+		} else {
+			continue;
+		}
+		if (!ch || !(val = g_key_file_get_string(kf, devgroup,
+				keys[j], NULL))) {
+			ret = SR_ERR_DATA;
+			break;
+		}
+		g_free(ch->name);
+		ch->name = val;
+		ch->enabled = TRUE;
+	}
+	g_strfreev(keys);
+
+	has_counts = g_key_file_has_key(kf, devgroup,
+			SR_SESSIONFILE_LOGIC_SAMPLES, NULL);
+	if (ret == SR_OK && has_counts) {
+		fi->logic_samples = g_key_file_get_uint64(kf, devgroup,
+				SR_SESSIONFILE_LOGIC_SAMPLES, NULL);
+		fi->analog_samples = g_key_file_get_uint64(kf, devgroup,
+				SR_SESSIONFILE_ANALOG_SAMPLES, NULL);
+	} else if (ret == SR_OK) {
+		ret = count_samples(archive, fi, analog_num);
+	}
+
+	g_ptr_array_free(channels, TRUE);
+	g_key_file_free(kf);
+	zip_discard(archive);
+
+	if (ret != SR_OK) {
+		sr_session_file_info_free(fi);
+		return ret;
+	}
+	*info = fi;
+
+	return SR_OK;
+}
+
+/**
+ * Free a session file summary.
+ *
+ * @param info The summary, as returned by sr_session_file_info(). May
+ *             be NULL.
+ *
+ * @since 0.5.0
+ */
+SR_API void sr_session_file_info_free(struct sr_session_file_info *info)
+{
+	GSList *l;
+	struct sr_channel *ch;
+
+	if (!info)
+		return;
+
+	for (l = info->channels; l; l = l->next) {
+		ch = l->data;
+		g_free(ch->name);
+		g_free(ch);
+	}
+	g_slist_free(info->channels);
+	g_free(info);
+}
+
 /** @} */
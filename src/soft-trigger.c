@@ -26,6 +26,364 @@
 #define LOG_PREFIX "soft-trigger"
 /* @endcond */
 
+/*
+ * Protocol trigger matches (SR_TRIGGER_UART, SR_TRIGGER_SPI and
+ * SR_TRIGGER_I2C) each have a decoder, which sees every sample exactly
+ * once, whatever the trigger stage. When a frame matches, the decoder
+ * notes the sample it ended on, and the match holds on that sample only.
+ */
+struct soft_trigger_decoder {
+	const struct sr_trigger_match *match;
+	const struct sr_trigger_protocol *proto;
+	/* Where the data, clock and select bits are in a sample. */
+	int data_offset, clock_offset, select_offset;
+	uint8_t data_mask, clock_mask, select_mask;
+	/* Line levels on the previous sample. */
+	gboolean data, clock;
+	/* SPI: the clock level after the edge which samples data. */
+	gboolean sample_level;
+	/* Whether a UART frame or an I2C transfer is being decoded. */
+	gboolean busy;
+	/* Bits received so far in the current frame, and their value. */
+	unsigned int num_bits;
+	uint32_t word;
+	/* UART: the bit period in 1/256 samples. */
+	uint64_t period;
+	/* UART: samples since the start bit edge, and when to read a bit. */
+	uint64_t elapsed;
+	uint64_t next;
+	/* The sample on which the last matching frame ended. */
+	uint64_t event;
+};
+
+/*
+ * Pulse width and timeout matches (SR_TRIGGER_PULSE and SR_TRIGGER_TIMEOUT)
+ * read the run counter of their channel. However many matches share it,
+ * a run counter is stepped once per sample, so the cost of a sample does
+ * not grow with the number of conditions.
+ */
+struct soft_trigger_run {
+	/* Where the channel's bit is in a sample. */
+	int offset;
+	uint8_t mask;
+	/* The current level, and for how many samples it has lasted. */
+	gboolean level;
+	uint64_t length;
+	/* Whether the current level began with an edge, not the acquisition. */
+	gboolean whole;
+	/* The sample of the last edge, and the width of the pulse it ended
+	 * (0 if that pulse began before the acquisition). */
+	uint64_t edge;
+	uint64_t width;
+};
+
+/*
+ * Runt matches (SR_TRIGGER_RUNT) share a tracker per channel and pair of
+ * thresholds. It notes each pulse which leaves the region below the low
+ * threshold (or above the high one), and returns to it without reaching
+ * the other threshold.
+ */
+struct soft_trigger_runt {
+	int index;
+	float low, high;
+	/* The region of the previous sample, see runt_region(). */
+	int region;
+	/* Where the pulse between the thresholds came from, 0 if unknown. */
+	int from;
+	/* The sample on which the pulse between the thresholds began. */
+	uint64_t start;
+	/* The sample on which the last runt ended, its width and polarity. */
+	uint64_t event;
+	uint64_t width;
+	gboolean positive;
+};
+
+/* A trigger match, as set up for the acquisition. */
+struct soft_trigger_check {
+	const struct sr_trigger_match *match;
+	/* Logic: where the channel's bit is in a sample. */
+	int offset;
+	uint8_t mask;
+	/* What protocol, pulse width, timeout and runt matches read. */
+	struct soft_trigger_decoder *decoder;
+	struct soft_trigger_run *run;
+	struct soft_trigger_runt *runt;
+	/* Condition matches: the polarities to match, and the bounds in
+	 * samples (G_MAXUINT64 if there is no upper bound). */
+	gboolean positive, negative;
+	uint64_t min, max;
+	/*
+	 * Matches reading a decoder, run counter or runt tracker: whether
+	 * the match held on each of the last samples, indexed by position
+	 * modulo the number of stages. The stages rewind by fewer samples
+	 * than that, and the trackers have moved on by then.
+	 */
+	gboolean *held;
+};
+
+struct soft_trigger_stage {
+	const struct sr_trigger_stage *stage;
+	int num_checks;
+	struct soft_trigger_check *checks;
+};
+
+static void decoder_bit_init(const struct sr_channel *ch, int *offset,
+		uint8_t *mask)
+{
+	*offset = ch->index / 8;
+	*mask = 1 << (ch->index % 8);
+}
+
+static int samplerate_get(const struct sr_dev_inst *sdi, uint64_t *samplerate)
+{
+	GVariant *gvar;
+
+	if (*samplerate)
+		return SR_OK;
+
+	if (sr_config_get(sdi->driver, sdi, NULL, SR_CONF_SAMPLERATE,
+			&gvar) != SR_OK) {
+		sr_err("Soft trigger needs the samplerate.");
+		return SR_ERR;
+	}
+	*samplerate = g_variant_get_uint64(gvar);
+	g_variant_unref(gvar);
+	if (!*samplerate) {
+		sr_err("Soft trigger needs the samplerate.");
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+/* Convert nanoseconds to samples, without overflowing below 18 GHz. */
+static uint64_t ns_to_samples(uint64_t ns, uint64_t samplerate,
+		gboolean round_up)
+{
+	uint64_t samples, rest;
+
+	samples = ns / SR_GHZ(1) * samplerate;
+	rest = ns % SR_GHZ(1) * samplerate;
+	samples += rest / SR_GHZ(1);
+	if (round_up && rest % SR_GHZ(1))
+		samples++;
+
+	return samples;
+}
+
+static struct soft_trigger_stage *stages_new(const struct sr_trigger *trigger,
+		int *num_stages)
+{
+	struct soft_trigger_stage *stages, *st;
+	struct soft_trigger_check *check;
+	struct sr_trigger_match *match;
+	GSList *l, *m;
+
+	*num_stages = 0;
+	stages = g_malloc0(g_slist_length(trigger->stages)
+			* sizeof(struct soft_trigger_stage));
+	for (l = trigger->stages; l; l = l->next) {
+		st = &stages[(*num_stages)++];
+		st->stage = l->data;
+		st->checks = g_malloc0(g_slist_length(st->stage->matches)
+				* sizeof(struct soft_trigger_check));
+		for (m = st->stage->matches; m; m = m->next) {
+			match = m->data;
+			if (!match->channel->enabled)
+				/* Ignore disabled channels with a trigger. */
+				continue;
+			check = &st->checks[st->num_checks++];
+			check->match = match;
+			decoder_bit_init(match->channel, &check->offset,
+					&check->mask);
+		}
+	}
+
+	return stages;
+}
+
+static void stages_free(struct soft_trigger_stage *stages, int num_stages)
+{
+	int i, j;
+
+	for (i = 0; i < num_stages; i++) {
+		for (j = 0; j < stages[i].num_checks; j++)
+			g_free(stages[i].checks[j].held);
+		g_free(stages[i].checks);
+	}
+	g_free(stages);
+}
+
+/*
+ * Set up the history of the matches which read a tracker, and list them
+ * so that it can be kept up to date without going through all stages.
+ */
+static struct soft_trigger_check **held_init(struct soft_trigger_stage *stages,
+		int num_stages, int *num_held)
+{
+	struct soft_trigger_check **held, *check;
+	int i, j;
+
+	*num_held = 0;
+	held = NULL;
+	for (i = 0; i < num_stages; i++) {
+		for (j = 0; j < stages[i].num_checks; j++) {
+			check = &stages[i].checks[j];
+			if (!check->decoder && !check->run && !check->runt)
+				continue;
+			check->held = g_malloc0(num_stages * sizeof(gboolean));
+			held = g_realloc(held, (*num_held + 1) * sizeof(*held));
+			held[(*num_held)++] = check;
+		}
+	}
+
+	return held;
+}
+
+static int conditions_init(const struct sr_dev_inst *sdi,
+		struct soft_trigger_stage *stages, int num_stages)
+{
+	struct soft_trigger_check *check;
+	const struct sr_trigger_condition *cond;
+	uint64_t samplerate;
+	uint32_t polarity;
+	int i, j;
+
+	samplerate = 0;
+	for (i = 0; i < num_stages; i++) {
+		for (j = 0; j < stages[i].num_checks; j++) {
+			check = &stages[i].checks[j];
+			cond = check->match->condition;
+			if (!cond)
+				continue;
+			polarity = cond->flags
+					& (SR_TRIGGER_POSITIVE | SR_TRIGGER_NEGATIVE);
+			check->positive = !polarity
+					|| (polarity & SR_TRIGGER_POSITIVE);
+			check->negative = !polarity
+					|| (polarity & SR_TRIGGER_NEGATIVE);
+			check->min = cond->min;
+			check->max = cond->max ? cond->max : G_MAXUINT64;
+			if (cond->flags & SR_TRIGGER_NANOSECONDS) {
+				if (samplerate_get(sdi, &samplerate) != SR_OK)
+					return SR_ERR;
+				/* Only whole samples within the bounds match. */
+				check->min = ns_to_samples(cond->min,
+						samplerate, TRUE);
+				if (cond->max)
+					check->max = ns_to_samples(cond->max,
+							samplerate, FALSE);
+			}
+			if (check->match->match == SR_TRIGGER_TIMEOUT)
+				check->min = MAX(check->min, 1);
+		}
+	}
+
+	return SR_OK;
+}
+
+static int decoders_init(struct soft_trigger_logic *stl)
+{
+	struct soft_trigger_check *check;
+	struct soft_trigger_decoder *dec;
+	const struct sr_trigger_match *match;
+	const struct sr_trigger_protocol *proto;
+	uint64_t samplerate;
+	int num, i, j;
+
+	num = 0;
+	for (i = 0; i < stl->num_stages; i++) {
+		for (j = 0; j < stl->stages[i].num_checks; j++) {
+			if (stl->stages[i].checks[j].match->protocol)
+				num++;
+		}
+	}
+	if (!num)
+		return SR_OK;
+
+	stl->decoders = g_malloc0(num * sizeof(struct soft_trigger_decoder));
+	samplerate = 0;
+	for (i = 0; i < stl->num_stages; i++) {
+		for (j = 0; j < stl->stages[i].num_checks; j++) {
+			check = &stl->stages[i].checks[j];
+			match = check->match;
+			if (!match->protocol)
+				continue;
+			proto = match->protocol;
+			dec = &stl->decoders[stl->num_decoders++];
+			check->decoder = dec;
+			dec->match = match;
+			dec->proto = proto;
+			dec->event = G_MAXUINT64;
+			decoder_bit_init(match->channel, &dec->data_offset,
+					&dec->data_mask);
+			if (proto->clock)
+				decoder_bit_init(proto->clock, &dec->clock_offset,
+						&dec->clock_mask);
+			if (proto->select)
+				decoder_bit_init(proto->select, &dec->select_offset,
+						&dec->select_mask);
+			if (match->match == SR_TRIGGER_SPI) {
+				dec->sample_level = !(proto->flags & SR_TRIGGER_SPI_CPOL)
+					== !(proto->flags & SR_TRIGGER_SPI_CPHA);
+			} else if (match->match == SR_TRIGGER_UART) {
+				if (samplerate_get(stl->sdi, &samplerate) != SR_OK)
+					return SR_ERR;
+				/* At least three samples per bit. */
+				if (samplerate / 3 < proto->baudrate) {
+					sr_err("Samplerate %" PRIu64 " is too low for "
+						"a UART trigger at %" PRIu64 " baud.",
+						samplerate, proto->baudrate);
+					return SR_ERR;
+				}
+				dec->period = samplerate * 256 / proto->baudrate;
+			}
+		}
+	}
+
+	return SR_OK;
+}
+
+static void runs_init(struct soft_trigger_logic *stl)
+{
+	struct soft_trigger_check *check;
+	int num, i, j, k;
+
+	num = 0;
+	for (i = 0; i < stl->num_stages; i++) {
+		for (j = 0; j < stl->stages[i].num_checks; j++) {
+			check = &stl->stages[i].checks[j];
+			if (check->match->match == SR_TRIGGER_PULSE ||
+					check->match->match == SR_TRIGGER_TIMEOUT)
+				num++;
+		}
+	}
+	if (!num)
+		return;
+
+	stl->runs = g_malloc0(num * sizeof(struct soft_trigger_run));
+	for (i = 0; i < stl->num_stages; i++) {
+		for (j = 0; j < stl->stages[i].num_checks; j++) {
+			check = &stl->stages[i].checks[j];
+			if (check->match->match != SR_TRIGGER_PULSE &&
+					check->match->match != SR_TRIGGER_TIMEOUT)
+				continue;
+			/* One run counter per channel. */
+			for (k = 0; k < stl->num_runs; k++) {
+				if (stl->runs[k].offset == check->offset &&
+						stl->runs[k].mask == check->mask)
+					break;
+			}
+			if (k == stl->num_runs) {
+				stl->runs[k].offset = check->offset;
+				stl->runs[k].mask = check->mask;
+				stl->num_runs++;
+			}
+			check->run = &stl->runs[k];
+		}
+	}
+}
+
 SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
 		int pre_trigger_samples)
@@ -46,11 +404,30 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		return NULL;
 	}
 
+	stl->stages = stages_new(trigger, &stl->num_stages);
+	if (!stl->num_stages) {
+		sr_err("Trigger has no stages.");
+		soft_trigger_logic_free(stl);
+		return NULL;
+	}
+
+	if (conditions_init(sdi, stl->stages, stl->num_stages) != SR_OK ||
+			decoders_init(stl) != SR_OK) {
+		soft_trigger_logic_free(stl);
+		return NULL;
+	}
+	runs_init(stl);
+	stl->held = held_init(stl->stages, stl->num_stages, &stl->num_held);
+
 	return stl;
 }
 
 SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *stl)
 {
+	g_free(stl->held);
+	stages_free(stl->stages, stl->num_stages);
+	g_free(stl->runs);
+	g_free(stl->decoders);
 	g_free(stl->pre_trigger_buffer);
 	g_free(stl->prev_sample);
 	g_free(stl);
@@ -114,32 +491,289 @@ static void pre_trigger_send(struct soft_trigger_logic *stl,
 	}
 }
 
+/* Parity of the low 16 bits of a word: TRUE if an odd number are set. */
+static gboolean word_parity(uint32_t word)
+{
+	word ^= word >> 8;
+	word ^= word >> 4;
+	word ^= word >> 2;
+	word ^= word >> 1;
+
+	return word & 1;
+}
+
+static void uart_step(struct soft_trigger_decoder *dec, gboolean bit,
+		uint64_t pos)
+{
+	const struct sr_trigger_protocol *proto;
+	unsigned int num_bits, k;
+	gboolean prev;
+
+	proto = dec->proto;
+	if (proto->flags & SR_TRIGGER_UART_INVERTED)
+		bit = !bit;
+	prev = dec->data;
+	dec->data = bit;
+
+	if (!dec->busy) {
+		/* Wait for the falling edge of a start bit. */
+		if (prev && !bit) {
+			dec->busy = TRUE;
+			dec->elapsed = 0;
+			dec->num_bits = 0;
+			dec->word = 0;
+			dec->next = dec->period / 512;
+		}
+		return;
+	}
+	if (++dec->elapsed < dec->next)
+		return;
+
+	/* In the middle of bit k of the frame, counting the start bit. */
+	k = dec->num_bits++;
+	dec->next = (2 * k + 3) * dec->period / 512;
+	num_bits = proto->num_bits;
+	if (proto->parity != SR_TRIGGER_PARITY_NONE)
+		num_bits++;
+
+	if (k == 0) {
+		/* A start bit which doesn't last was a glitch. */
+		if (bit)
+			dec->busy = FALSE;
+		return;
+	}
+	if (k <= num_bits) {
+		/* Data bits come LSB first, then the parity bit. */
+		dec->word |= (uint32_t)bit << (k - 1);
+		return;
+	}
+
+	/* The stop bit ends the frame, and must be high. */
+	dec->busy = FALSE;
+	if (!bit)
+		return;
+	if (proto->parity == SR_TRIGGER_PARITY_ODD && !word_parity(dec->word))
+		return;
+	if (proto->parity == SR_TRIGGER_PARITY_EVEN && word_parity(dec->word))
+		return;
+	dec->word &= (1 << proto->num_bits) - 1;
+	if ((dec->word & proto->mask) == (proto->value & proto->mask))
+		dec->event = pos;
+}
+
+static void spi_step(struct soft_trigger_decoder *dec, const uint8_t *sample,
+		gboolean bit, uint64_t pos)
+{
+	const struct sr_trigger_protocol *proto;
+	gboolean clock, prev_clock, select;
+
+	proto = dec->proto;
+	clock = (sample[dec->clock_offset] & dec->clock_mask) != 0;
+	prev_clock = dec->clock;
+	dec->clock = clock;
+
+	if (proto->select) {
+		select = (sample[dec->select_offset] & dec->select_mask) != 0;
+		if (!(proto->flags & SR_TRIGGER_SPI_CS_HIGH))
+			select = !select;
+		if (!select) {
+			/* The next word starts when the chip is selected. */
+			dec->num_bits = 0;
+			dec->word = 0;
+			return;
+		}
+	}
+	if (clock == prev_clock || clock != dec->sample_level)
+		return;
+
+	if (proto->flags & SR_TRIGGER_SPI_LSB_FIRST)
+		dec->word |= (uint32_t)bit << dec->num_bits;
+	else
+		dec->word = (dec->word << 1) | bit;
+	if (++dec->num_bits < proto->num_bits)
+		return;
+
+	if ((dec->word & proto->mask) == (proto->value & proto->mask))
+		dec->event = pos;
+	dec->num_bits = 0;
+	dec->word = 0;
+}
+
+static void i2c_step(struct soft_trigger_decoder *dec, const uint8_t *sample,
+		gboolean sda, uint64_t pos)
+{
+	const struct sr_trigger_protocol *proto;
+	gboolean scl, prev_scl, prev_sda, read;
+
+	proto = dec->proto;
+	scl = (sample[dec->clock_offset] & dec->clock_mask) != 0;
+	prev_scl = dec->clock;
+	prev_sda = dec->data;
+	dec->clock = scl;
+	dec->data = sda;
+
+	if (scl && prev_scl && sda != prev_sda) {
+		/* SDA falling while SCL is high is a (repeated) START, rising a STOP. */
+		dec->busy = !sda;
+		dec->num_bits = 0;
+		dec->word = 0;
+		return;
+	}
+	if (!dec->busy || !scl || prev_scl)
+		return;
+
+	/*
+	 * A bit on each rising edge of SCL: the address and R/W bit, the
+	 * ACK, then the first data byte.
+	 */
+	dec->num_bits++;
+	if (dec->num_bits == 9)
+		return;
+	dec->word = ((dec->word << 1) | sda) & 0xff;
+	if (dec->num_bits == 8) {
+		read = dec->word & 1;
+		if (((dec->word >> 1) & proto->mask) != (proto->value & proto->mask)
+				|| (read && (proto->flags & SR_TRIGGER_I2C_WRITE))
+				|| (!read && (proto->flags & SR_TRIGGER_I2C_READ))) {
+			dec->busy = FALSE;
+		} else if (!(proto->flags & SR_TRIGGER_I2C_DATA)) {
+			dec->event = pos;
+			dec->busy = FALSE;
+		}
+	} else if (dec->num_bits == 17) {
+		if ((dec->word & proto->data_mask) == (proto->data & proto->data_mask))
+			dec->event = pos;
+		dec->busy = FALSE;
+	}
+}
+
+static void decoders_step(struct soft_trigger_logic *stl,
+		const uint8_t *sample, uint64_t pos)
+{
+	struct soft_trigger_decoder *dec;
+	gboolean bit;
+	int i;
+
+	for (i = 0; i < stl->num_decoders; i++) {
+		dec = &stl->decoders[i];
+		bit = (sample[dec->data_offset] & dec->data_mask) != 0;
+		if (pos == 0) {
+			/* Nothing to compare the first sample's levels to. */
+			dec->data = bit;
+			if (dec->match->match == SR_TRIGGER_UART &&
+					(dec->proto->flags & SR_TRIGGER_UART_INVERTED))
+				dec->data = !bit;
+			dec->clock = (sample[dec->clock_offset] & dec->clock_mask) != 0;
+			continue;
+		}
+		switch (dec->match->match) {
+		case SR_TRIGGER_UART:
+			uart_step(dec, bit, pos);
+			break;
+		case SR_TRIGGER_SPI:
+			spi_step(dec, sample, bit, pos);
+			break;
+		case SR_TRIGGER_I2C:
+			i2c_step(dec, sample, bit, pos);
+			break;
+		}
+	}
+}
+
+static void runs_step(struct soft_trigger_logic *stl, const uint8_t *sample,
+		uint64_t pos)
+{
+	struct soft_trigger_run *run;
+	gboolean bit;
+	int i;
+
+	for (i = 0; i < stl->num_runs; i++) {
+		run = &stl->runs[i];
+		bit = (sample[run->offset] & run->mask) != 0;
+		if (pos == 0) {
+			run->level = bit;
+			run->length = 1;
+			continue;
+		}
+		if (bit == run->level) {
+			run->length++;
+			continue;
+		}
+		/* An edge ends the pulse at the previous level. */
+		run->width = run->whole ? run->length : 0;
+		run->edge = pos;
+		run->level = bit;
+		run->length = 1;
+		run->whole = TRUE;
+	}
+}
+
+static gboolean run_check_match(const struct soft_trigger_check *check,
+		uint64_t pos)
+{
+	const struct soft_trigger_run *run;
+
+	run = check->run;
+	if (check->match->match == SR_TRIGGER_TIMEOUT) {
+		/* Holds on the sample which reaches the time, once per level. */
+		if (run->length != check->min)
+			return FALSE;
+		return run->level ? check->positive : check->negative;
+	}
+
+	/* Holds on the edge which ends a pulse. */
+	if (run->edge != pos || !run->width)
+		return FALSE;
+	if (!(run->level ? check->negative : check->positive))
+		return FALSE;
+
+	return run->width >= check->min && run->width <= check->max;
+}
+
+/* Note which of the matches reading a tracker hold on a new sample. */
+static void logic_held_step(struct soft_trigger_logic *stl, uint64_t pos)
+{
+	struct soft_trigger_check *check;
+	gboolean result;
+	int i;
+
+	for (i = 0; i < stl->num_held; i++) {
+		check = stl->held[i];
+		if (check->decoder)
+			result = check->decoder->event == pos;
+		else
+			result = run_check_match(check, pos);
+		check->held[pos % stl->num_stages] = result;
+	}
+}
+
 static gboolean logic_check_match(struct soft_trigger_logic *stl,
-		uint8_t *sample, struct sr_trigger_match *match)
+		const uint8_t *sample, const uint8_t *prev_sample, uint64_t pos,
+		const struct soft_trigger_check *check)
 {
 	int bit, prev_bit;
 	gboolean result;
 
-	stl->count++;
+	if (check->held)
+		return check->held[pos % stl->num_stages];
+
 	result = FALSE;
-	bit = *(sample + match->channel->index / 8)
-			& (1 << (match->channel->index % 8));
-	if (match->match == SR_TRIGGER_ZERO)
+	bit = sample[check->offset] & check->mask;
+	if (check->match->match == SR_TRIGGER_ZERO)
 		result = bit == 0;
-	else if (match->match == SR_TRIGGER_ONE)
+	else if (check->match->match == SR_TRIGGER_ONE)
 		result = bit != 0;
 	else {
 		/* Edge matches. */
-		if (stl->count == 1)
+		if (pos == 0)
 			/* First sample, don't have enough for an edge match yet. */
 			return FALSE;
-		prev_bit = *(stl->prev_sample + match->channel->index / 8)
-				& (1 << (match->channel->index % 8));
-		if (match->match == SR_TRIGGER_RISING)
+		prev_bit = prev_sample[check->offset] & check->mask;
+		if (check->match->match == SR_TRIGGER_RISING)
 			result = prev_bit == 0 && bit != 0;
-		else if (match->match == SR_TRIGGER_FALLING)
+		else if (check->match->match == SR_TRIGGER_FALLING)
 			result = prev_bit != 0 && bit == 0;
-		else if (match->match == SR_TRIGGER_EDGE)
+		else if (check->match->match == SR_TRIGGER_EDGE)
 			result = prev_bit != bit;
 	}
 
@@ -152,36 +786,45 @@ SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 		uint8_t *buf, int len, int *pre_trigger_samples)
 {
 	struct sr_datafeed_packet packet;
-	struct sr_trigger_stage *stage;
-	struct sr_trigger_match *match;
-	GSList *l, *l_stage;
+	struct soft_trigger_stage *stage;
+	const uint8_t *prev_sample;
+	uint64_t pos;
 	int offset;
-	int i;
+	int i, j;
 	gboolean match_found;
 
 	offset = -1;
 	for (i = 0; i < len; i += stl->unitsize) {
-		l_stage = g_slist_nth(stl->trigger->stages, stl->cur_stage);
-		stage = l_stage->data;
-		if (!stage->matches)
+		/*
+		 * The stages may rewind over samples seen before, which
+		 * the decoders and run counters mustn't see again. What
+		 * their matches made of those samples is kept instead.
+		 */
+		pos = stl->buf_pos + i / stl->unitsize;
+		if (pos == stl->num_seen) {
+			runs_step(stl, buf + i, pos);
+			decoders_step(stl, buf + i, pos);
+			logic_held_step(stl, pos);
+			stl->num_seen++;
+		}
+		prev_sample = i > 0 ? buf + i - stl->unitsize : stl->prev_sample;
+
+		stage = &stl->stages[stl->cur_stage];
+		if (!stage->stage->matches)
 			/* No matches supplied, client error. */
 			return SR_ERR_ARG;
 
 		match_found = TRUE;
-		for (l = stage->matches; l; l = l->next) {
-			match = l->data;
-			if (!match->channel->enabled)
-				/* Ignore disabled channels with a trigger. */
-				continue;
-			if (!logic_check_match(stl, buf + i, match)) {
+		for (j = 0; j < stage->num_checks; j++) {
+			if (!logic_check_match(stl, buf + i, prev_sample, pos,
+					&stage->checks[j])) {
 				match_found = FALSE;
 				break;
 			}
 		}
-		memcpy(stl->prev_sample, buf + i, stl->unitsize);
 		if (match_found) {
 			/* Matched on the current stage. */
-			if (l_stage->next) {
+			if (stl->cur_stage + 1 < stl->num_stages) {
 				/* Advance to next stage. */
 				stl->cur_stage++;
 			} else {
@@ -217,6 +860,295 @@ SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 
 	if (offset == -1)
 		pre_trigger_append(stl, buf, len);
+	if (len >= stl->unitsize)
+		memcpy(stl->prev_sample, buf + len - stl->unitsize, stl->unitsize);
+	stl->buf_pos += len / stl->unitsize;
+
+	return offset;
+}
+
+static void runts_init(struct soft_trigger_analog *sta)
+{
+	struct soft_trigger_check *check;
+	struct soft_trigger_runt *runt;
+	const struct sr_trigger_condition *cond;
+	int num, index, i, j, k;
+
+	num = 0;
+	for (i = 0; i < sta->num_stages; i++) {
+		for (j = 0; j < sta->stages[i].num_checks; j++) {
+			if (sta->stages[i].checks[j].match->match == SR_TRIGGER_RUNT)
+				num++;
+		}
+	}
+	if (!num)
+		return;
+
+	sta->runts = g_malloc0(num * sizeof(struct soft_trigger_runt));
+	for (i = 0; i < sta->num_stages; i++) {
+		for (j = 0; j < sta->stages[i].num_checks; j++) {
+			check = &sta->stages[i].checks[j];
+			if (check->match->match != SR_TRIGGER_RUNT)
+				continue;
+			cond = check->match->condition;
+			index = check->match->channel->index;
+			/* One tracker per channel and pair of thresholds. */
+			for (k = 0; k < sta->num_runts; k++) {
+				runt = &sta->runts[k];
+				if (runt->index == index && runt->low == cond->low
+						&& runt->high == cond->high)
+					break;
+			}
+			runt = &sta->runts[k];
+			if (k == sta->num_runts) {
+				runt->index = index;
+				runt->low = cond->low;
+				runt->high = cond->high;
+				runt->event = G_MAXUINT64;
+				sta->num_runts++;
+			}
+			check->runt = runt;
+		}
+	}
+}
+
+SR_PRIV struct soft_trigger_analog *soft_trigger_analog_new(
+		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
+		int pre_trigger_samples)
+{
+	struct soft_trigger_analog *sta;
+	struct soft_trigger_stage *st;
+	const struct sr_channel *ch;
+	int i, j, k, n;
+
+	sta = g_malloc0(sizeof(struct soft_trigger_analog));
+	sta->sdi = sdi;
+	sta->trigger = trigger;
+	sta->num_channels = g_slist_length(sdi->channels);
+	sta->prev = g_malloc0(sta->num_channels * sizeof(float));
+	sta->pre_trigger_samples = pre_trigger_samples;
+
+	sta->stages = stages_new(trigger, &sta->num_stages);
+
+	/*
+	 * Only analog samples pass through here, so matches on other
+	 * channels can never fire. Drop them, and the stages they leave
+	 * empty, rather than stall the trigger.
+	 */
+	for (i = n = 0; i < sta->num_stages; i++) {
+		st = &sta->stages[i];
+		for (j = k = 0; j < st->num_checks; j++) {
+			ch = st->checks[j].match->channel;
+			if (ch->type != SR_CHANNEL_ANALOG) {
+				sr_warn("Ignoring trigger match on non-analog "
+						"channel %s.", ch->name);
+				continue;
+			}
+			st->checks[k++] = st->checks[j];
+		}
+		st->num_checks = k;
+		if (!k) {
+			g_free(st->checks);
+			continue;
+		}
+		sta->stages[n++] = *st;
+	}
+	sta->num_stages = n;
+	if (!sta->num_stages) {
+		sr_err("Trigger has no analog matches.");
+		soft_trigger_analog_free(sta);
+		return NULL;
+	}
+
+	if (conditions_init(sdi, sta->stages, sta->num_stages) != SR_OK) {
+		soft_trigger_analog_free(sta);
+		return NULL;
+	}
+	runts_init(sta);
+	sta->held = held_init(sta->stages, sta->num_stages, &sta->num_held);
+
+	return sta;
+}
+
+SR_PRIV void soft_trigger_analog_free(struct soft_trigger_analog *sta)
+{
+	g_free(sta->held);
+	stages_free(sta->stages, sta->num_stages);
+	g_free(sta->runts);
+	g_free(sta->prev);
+	g_free(sta);
+}
+
+/* -1 below the low threshold, 1 above the high one, 0 in between. */
+static int runt_region(const struct soft_trigger_runt *runt, float value)
+{
+	if (value < runt->low)
+		return -1;
+	if (value > runt->high)
+		return 1;
+
+	return 0;
+}
+
+static void runts_step(struct soft_trigger_analog *sta,
+		const float *const *data, int i, uint64_t pos)
+{
+	struct soft_trigger_runt *runt;
+	int region;
+	int k;
+
+	for (k = 0; k < sta->num_runts; k++) {
+		runt = &sta->runts[k];
+		region = runt_region(runt, data[runt->index][i]);
+		if (pos == 0 || region == runt->region) {
+			runt->region = region;
+			continue;
+		}
+		if (region == 0) {
+			runt->start = pos;
+			runt->from = runt->region;
+		} else if (runt->region == 0 && region == runt->from) {
+			/* Back where it came from: that was a runt. */
+			runt->event = pos;
+			runt->width = pos - runt->start;
+			runt->positive = region < 0;
+		}
+		runt->region = region;
+	}
+}
+
+static gboolean runt_check_match(const struct soft_trigger_check *check,
+		uint64_t pos)
+{
+	const struct soft_trigger_runt *runt;
+
+	/* Holds on the sample which ends a runt. */
+	runt = check->runt;
+	if (runt->event != pos)
+		return FALSE;
+	if (!(runt->positive ? check->positive : check->negative))
+		return FALSE;
+
+	return runt->width >= check->min && runt->width <= check->max;
+}
+
+/* Note which of the runt matches hold on a new sample. */
+static void analog_held_step(struct soft_trigger_analog *sta, uint64_t pos)
+{
+	struct soft_trigger_check *check;
+	int i;
+
+	for (i = 0; i < sta->num_held; i++) {
+		check = sta->held[i];
+		check->held[pos % sta->num_stages] = runt_check_match(check, pos);
+	}
+}
+
+static gboolean analog_check_match(const struct soft_trigger_analog *sta,
+		const float *const *data, int i, uint64_t pos,
+		const struct soft_trigger_check *check)
+{
+	float value, cur, prev;
+	gboolean rising, falling;
+	int index;
+
+	if (check->held)
+		return check->held[pos % sta->num_stages];
+
+	index = check->match->channel->index;
+	value = check->match->value;
+	cur = data[index][i];
+
+	switch (check->match->match) {
+	case SR_TRIGGER_OVER:
+		return cur > value;
+	case SR_TRIGGER_UNDER:
+		return cur < value;
+	}
+
+	/* Edge matches. */
+	if (pos == 0)
+		/* First sample, don't have enough for an edge match yet. */
+		return FALSE;
+	prev = i > 0 ? data[index][i - 1] : sta->prev[index];
+	rising = prev < value && cur >= value;
+	falling = prev >= value && cur < value;
+	if (check->match->match == SR_TRIGGER_RISING)
+		return rising;
+	if (check->match->match == SR_TRIGGER_FALLING)
+		return falling;
+
+	return rising || falling;
+}
+
+/*
+ * Checks num_samples samples of each channel, data being indexed by the
+ * channel index. The channels without a trigger match may be NULL.
+ *
+ * Returns the offset (in samples) within data of where the trigger
+ * occurred, or -1 if not triggered. Only the channels with a match pass
+ * through here, so the caller keeps the pre-trigger data: when the
+ * trigger fires, pre_trigger_samples is set to how many samples before
+ * the offset it has to send, before it sends SR_DF_TRIGGER.
+ */
+SR_PRIV int soft_trigger_analog_check(struct soft_trigger_analog *sta,
+		const float *const *data, int num_samples, int *pre_trigger_samples)
+{
+	struct soft_trigger_stage *stage;
+	uint64_t pos;
+	int offset;
+	int i, j;
+	gboolean match_found;
+
+	offset = -1;
+	for (i = 0; i < num_samples; i++) {
+		/* As with logic, the runt trackers see each sample once. */
+		pos = sta->buf_pos + i;
+		if (pos == sta->num_seen) {
+			runts_step(sta, data, i, pos);
+			analog_held_step(sta, pos);
+			sta->num_seen++;
+		}
+
+		stage = &sta->stages[sta->cur_stage];
+		if (!stage->stage->matches)
+			/* No matches supplied, client error. */
+			return SR_ERR_ARG;
+
+		match_found = TRUE;
+		for (j = 0; j < stage->num_checks; j++) {
+			if (!analog_check_match(sta, data, i, pos,
+					&stage->checks[j])) {
+				match_found = FALSE;
+				break;
+			}
+		}
+		if (match_found) {
+			if (sta->cur_stage + 1 < sta->num_stages) {
+				sta->cur_stage++;
+			} else {
+				offset = i;
+				if (pre_trigger_samples)
+					*pre_trigger_samples = MIN(pos,
+						(uint64_t)sta->pre_trigger_samples);
+				break;
+			}
+		} else if (sta->cur_stage > 0) {
+			/* Retry stage 0 from the sample after its match. */
+			i -= sta->cur_stage;
+			if (i < -1)
+				i = -1;
+			sta->cur_stage = 0;
+		}
+	}
+
+	if (num_samples > 0) {
+		for (j = 0; j < sta->num_channels; j++) {
+			if (data[j])
+				sta->prev[j] = data[j][num_samples - 1];
+		}
+	}
+	sta->buf_pos += num_samples;
 
 	return offset;
 }
@@ -105,6 +105,87 @@ SR_PRIV int std_session_send_df_header(const struct sr_dev_inst *sdi,
 	return SR_OK;
 }
 
+/**
+ * Standard API helper for sending an SR_DF_GAP packet.
+ *
+ * @param sdi The device instance to use.
+ * @param start Index of the first lost sample.
+ * @param length Number of samples lost.
+ *
+ * @return SR_OK upon success, or a negative error code upon errors.
+ */
+SR_PRIV int std_session_send_df_gap(const struct sr_dev_inst *sdi,
+		uint64_t start, uint64_t length)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_gap gap;
+
+	sr_dbg("Lost %" PRIu64 " samples from sample %" PRIu64 ".",
+			length, start);
+
+	packet.type = SR_DF_GAP;
+	packet.payload = &gap;
+	gap.start = start;
+	gap.length = length;
+
+	return sr_session_send(sdi, &packet);
+}
+
+struct batch_order {
+	const uint32_t *keys;
+	unsigned int num_keys;
+};
+
+static unsigned int batch_rank(const struct batch_order *order, uint32_t key)
+{
+	unsigned int i;
+
+	for (i = 0; i < order->num_keys; i++)
+		if (order->keys[i] == key)
+			break;
+
+	return i;
+}
+
+static gint batch_compare(gconstpointer a, gconstpointer b, gpointer data)
+{
+	const struct sr_config_batch_entry *ea = a, *eb = b;
+	unsigned int ra, rb;
+
+	ra = batch_rank(data, ea->key);
+	rb = batch_rank(data, eb->key);
+
+	return (ra > rb) - (ra < rb);
+}
+
+/**
+ * Standard API helper for ordering the settings of a batch.
+ *
+ * This function can be used by config_set_batch() driver API callbacks
+ * which need some keys applied before others, e.g. the timebase before
+ * a trigger position which depends on it.
+ *
+ * @param entries List of struct sr_config_batch_entry.
+ * @param keys Config keys in the order they must be applied. Keys not
+ *             in this array are applied last.
+ * @param num_keys Number of entries in keys.
+ *
+ * @return A sorted copy of entries, to be freed with g_slist_free().
+ *         Entries with the same key keep their order.
+ */
+SR_PRIV GSList *std_config_batch_sort(GSList *entries,
+		const uint32_t *keys, unsigned int num_keys)
+{
+	struct batch_order order;
+
+	order.keys = keys;
+	order.num_keys = num_keys;
+
+	/* g_slist_sort() is a stable merge sort. */
+	return g_slist_sort_with_data(g_slist_copy(entries),
+			batch_compare, &order);
+}
+
 #ifdef HAVE_LIBSERIALPORT
 
 /**
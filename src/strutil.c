@@ -24,6 +24,7 @@
 #include <string.h>
 #include <strings.h>
 #include <errno.h>
+#include <math.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -211,6 +212,217 @@ SR_PRIV int sr_atof_ascii(const char *str, float *ret)
 	return SR_OK;
 }
 
+/* Exactly representable powers of ten, for scaling values to integers. */
+static const double pow10_tab[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static const uint64_t pow10_u64[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+	10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+	100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+	100000000000000ULL, 1000000000000000ULL,
+};
+
+#define POW10_MAX ((int)ARRAY_SIZE(pow10_tab) - 1)
+
+/* Return x * 10^k, with at most two roundings. */
+static double scale_pow10(double x, int k)
+{
+	while (k > POW10_MAX) {
+		x *= pow10_tab[POW10_MAX];
+		k -= POW10_MAX;
+	}
+	while (k < -POW10_MAX) {
+		x /= pow10_tab[POW10_MAX];
+		k += POW10_MAX;
+	}
+
+	return k >= 0 ? x * pow10_tab[k] : x / pow10_tab[-k];
+}
+
+/* Write n as exactly 'width' decimal digits (zero padded) to p. */
+static char *put_digits(char *p, uint64_t n, int width)
+{
+	int i;
+
+	for (i = width - 1; i >= 0; i--) {
+		p[i] = '0' + n % 10;
+		n /= 10;
+	}
+
+	return p + width;
+}
+
+/* Write n in decimal without leading zeroes to p. */
+static char *put_uint(char *p, uint64_t n)
+{
+	uint64_t t;
+	int width;
+
+	for (width = 1, t = n; t >= 10; t /= 10)
+		width++;
+
+	return put_digits(p, n, width);
+}
+
+static int put_special(char *buf, float value)
+{
+	const char *s;
+
+	if (isnan(value))
+		s = "nan";
+	else if (isinf(value))
+		s = signbit(value) ? "-inf" : "inf";
+	else
+		s = signbit(value) ? "-0" : "0";
+	strcpy(buf, s);
+
+	return strlen(s);
+}
+
+/*
+ * Find the shortest decimal significand (at most 9 digits) which reads
+ * back as the same float. The candidate must be inside the rounding
+ * interval of the value by a safe margin, so that the rounding errors
+ * of the double arithmetic used here can't make it read back as one of
+ * the neighbours.
+ */
+static int shortest_digits(float value, uint64_t *digits, int *exp10)
+{
+	double a, d, lo, hi, m;
+	float fa;
+	int p, e, k;
+
+	fa = fabsf(value);
+	a = fa;
+	hi = (double)nextafterf(fa, INFINITY) - a;
+	lo = a - (double)nextafterf(fa, 0);
+	if (isinf(hi))
+		hi = lo;
+	hi = a + hi * (0.5 - 1e-6);
+	lo = a - lo * (0.5 - 1e-6);
+
+	e = (int)floor(log10(a));
+	if (scale_pow10(a, -e) >= 10)
+		e++;
+	else if (scale_pow10(a, -e) < 1)
+		e--;
+
+	for (p = 1; p <= 9; p++) {
+		k = p - 1 - e;
+		m = nearbyint(scale_pow10(a, k));
+		d = scale_pow10(m, -k);
+		if (p == 9 || (d > lo && d < hi))
+			break;
+	}
+
+	/* Rounding may carry over into an extra digit, e.g. 9.99 -> 10.0. */
+	if (m >= pow10_u64[p]) {
+		m /= 10;
+		e++;
+	}
+	*digits = (uint64_t)m;
+	while (p > 1 && *digits % 10 == 0) {
+		*digits /= 10;
+		p--;
+	}
+	*exp10 = e;
+
+	return p;
+}
+
+/**
+ * Convert a float to its decimal string representation, independent of
+ * the locale and without going through printf().
+ *
+ * With a non-negative number of digits, the value is printed as with
+ * "%.*f", rounding to nearest (ties to even), except that at most
+ * SR_FLOAT_MAX_DIGITS digits after the decimal point are printed. With
+ * a negative number of digits, the shortest string which reads back as
+ * the exact same float using strtof() is printed, switching to exponent
+ * notation for very large or very small values. Values very close to a
+ * rounding boundary get 9 significant digits instead, to stay on the
+ * safe side.
+ *
+ * @param buf Buffer of at least SR_FLOAT_STRING_SIZE bytes to write the
+ *            NUL-terminated result to.
+ * @param value The value to convert.
+ * @param digits The number of digits after the decimal point, or -1 for
+ *               the shortest round-trip representation.
+ *
+ * @return The length of the string written to buf.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_float_to_string(char *buf, float value, int digits)
+{
+	char *p, *start, fmt[8];
+	double scaled;
+	uint64_t m;
+	int n, e;
+
+	if (!isfinite(value) || (digits < 0 && value == 0))
+		return put_special(buf, value);
+
+	p = buf;
+	if (signbit(value))
+		*p++ = '-';
+
+	if (digits >= 0) {
+		digits = MIN(digits, SR_FLOAT_MAX_DIGITS);
+		scaled = nearbyint(fabs((double)value) * pow10_tab[digits]);
+		if (scaled >= 1e18) {
+			/* Too large for the integer path, rare enough. */
+			g_snprintf(fmt, sizeof(fmt), "%%.%df", digits);
+			g_ascii_formatd(buf, SR_FLOAT_STRING_SIZE, fmt, value);
+			return strlen(buf);
+		}
+		m = (uint64_t)scaled;
+		p = put_uint(p, m / pow10_u64[digits]);
+		if (digits) {
+			*p++ = '.';
+			p = put_digits(p, m % pow10_u64[digits], digits);
+		}
+		*p = '\0';
+		return p - buf;
+	}
+
+	n = shortest_digits(value, &m, &e);
+	if (e < -5 || e > 8) {
+		/* d[.ddd]e[+-]xx */
+		start = p;
+		p = put_digits(p + 1, m, n);
+		start[0] = start[1];
+		if (n > 1)
+			start[1] = '.';
+		else
+			p--;
+		*p++ = 'e';
+		*p++ = e < 0 ? '-' : '+';
+		p = put_digits(p, ABS(e), ABS(e) >= 100 ? 3 : 2);
+	} else if (e < 0) {
+		/* 0.000ddd */
+		*p++ = '0';
+		*p++ = '.';
+		p = put_digits(p, 0, -e - 1);
+		p = put_digits(p, m, n);
+	} else if (n <= e + 1) {
+		/* ddd000 */
+		p = put_digits(p, m, n);
+		p = put_digits(p, 0, e + 1 - n);
+	} else {
+		/* ddd.ddd */
+		p = put_digits(p, m / pow10_u64[n - e - 1], e + 1);
+		*p++ = '.';
+		p = put_digits(p, m % pow10_u64[n - e - 1], n - e - 1);
+	}
+	*p = '\0';
+
+	return p - buf;
+}
+
 /**
  * Convert a numeric value value to its "natural" string representation
  * in SI units.
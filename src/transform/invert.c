@@ -30,12 +30,9 @@ static int receive(const struct sr_transform *t,
 		struct sr_datafeed_packet **packet_out)
 {
 	const struct sr_datafeed_logic *logic;
-	const struct sr_datafeed_analog_old *analog_old;
 	const struct sr_datafeed_analog *analog;
-	struct sr_channel *ch;
-	GSList *l;
-	float *fdata, *f;
-	int si, num_channels, c;
+	const struct sr_datafeed_analog_planar *planar;
+	struct sr_analog_encoding *encoding;
 	uint8_t *b;
 	int64_t p;
 	uint64_t i, j, q;
@@ -54,20 +51,6 @@ static int receive(const struct sr_transform *t,
 			}
 		}
 		break;
-	case SR_DF_ANALOG_OLD:
-		analog_old = packet_in->payload;
-		fdata = (float *)analog_old->data;
-		num_channels = g_slist_length(analog_old->channels);
-		for (si = 0; si < analog_old->num_samples; si++) {
-			/* For now invert all values in all channels. */
-			for (l = analog_old->channels, c = 0; l; l = l->next, c++) {
-				ch = l->data;
-				(void)ch;
-				f = &fdata[si * num_channels + c];
-				*f = 1.0 / *f;
-			}
-		}
-		break;
 	case SR_DF_ANALOG:
 		analog = packet_in->payload;
 		p = analog->encoding->scale.p;
@@ -77,6 +60,20 @@ static int receive(const struct sr_transform *t,
 		analog->encoding->scale.p = (p < 0) ? -q : q;
 		analog->encoding->scale.q = (p < 0) ? -p : p;
 		break;
+	case SR_DF_ANALOG_PLANAR:
+		planar = packet_in->payload;
+		for (i = 0; i < planar->num_planes; i++) {
+			if (!sr_analog_plane_owns_encoding(planar, i))
+				continue;
+			encoding = planar->planes[i].encoding;
+			p = encoding->scale.p;
+			q = encoding->scale.q;
+			if (q > INT64_MAX)
+				return SR_ERR;
+			encoding->scale.p = (p < 0) ? -q : q;
+			encoding->scale.q = (p < 0) ? -p : p;
+		}
+		break;
 	default:
 		sr_spew("Unsupported packet type %d, ignoring.", packet_in->type);
 		break;
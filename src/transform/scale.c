@@ -49,38 +49,31 @@ static int receive(const struct sr_transform *t,
 		struct sr_datafeed_packet **packet_out)
 {
 	struct context *ctx;
-	const struct sr_datafeed_analog_old *analog_old;
 	const struct sr_datafeed_analog *analog;
-	struct sr_channel *ch;
-	GSList *l;
-	float *fdata;
-	float factor;
-	int i, num_channels, c;
+	const struct sr_datafeed_analog_planar *planar;
+	struct sr_analog_encoding *encoding;
+	uint32_t i;
 
 	if (!t || !t->sdi || !packet_in || !packet_out)
 		return SR_ERR_ARG;
 	ctx = t->priv;
 
 	switch (packet_in->type) {
-	case SR_DF_ANALOG_OLD:
-		analog_old = packet_in->payload;
-		fdata = (float *)analog_old->data;
-		num_channels = g_slist_length(analog_old->channels);
-		factor = (float) ctx->factor.p / ctx->factor.q;
-		for (i = 0; i < analog_old->num_samples; i++) {
-			/* For now scale all values in all channels. */
-			for (l = analog_old->channels, c = 0; l; l = l->next, c++) {
-				ch = l->data;
-				(void)ch;
-				fdata[i * num_channels + c] *= factor;
-			}
-		}
-		break;
 	case SR_DF_ANALOG:
 		analog = packet_in->payload;
 		analog->encoding->scale.p *= ctx->factor.p;
 		analog->encoding->scale.q *= ctx->factor.q;
 		break;
+	case SR_DF_ANALOG_PLANAR:
+		planar = packet_in->payload;
+		for (i = 0; i < planar->num_planes; i++) {
+			if (!sr_analog_plane_owns_encoding(planar, i))
+				continue;
+			encoding = planar->planes[i].encoding;
+			encoding->scale.p *= ctx->factor.p;
+			encoding->scale.q *= ctx->factor.q;
+		}
+		break;
 	default:
 		sr_spew("Unsupported packet type %d, ignoring.", packet_in->type);
 		break;
@@ -39,6 +39,16 @@
  * @{
  */
 
+static void match_free(void *data)
+{
+	struct sr_trigger_match *match;
+
+	match = data;
+	g_free(match->protocol);
+	g_free(match->condition);
+	g_free(match);
+}
+
 /**
  * Create a new trigger.
  *
@@ -83,7 +93,7 @@ SR_API void sr_trigger_free(struct sr_trigger *trig)
 		stage = l->data;
 
 		if (stage->matches)
-			g_slist_free_full(stage->matches, g_free);
+			g_slist_free_full(stage->matches, match_free);
 	}
 	g_slist_free_full(trig->stages, g_free);
 
@@ -178,4 +188,171 @@ SR_API int sr_trigger_match_add(struct sr_trigger_stage *stage,
 	return SR_OK;
 }
 
+/**
+ * Allocate a new protocol trigger match and add it to the specified
+ * trigger stage.
+ *
+ * A protocol match decodes UART frames, SPI words or I2C transfers from
+ * one or more logic channels as samples stream in, and matches on their
+ * content. Only soft triggers support protocol matches, see the
+ * SR_CONF_TRIGGER_MATCH list of the device.
+ *
+ * The caller is responsible to free the trigger (including all stages and
+ * matches) using sr_trigger_free() once it is no longer needed.
+ *
+ * @param stage The trigger stage to add the match to. Must not be NULL.
+ * @param ch The data channel for this trigger match. Must not be NULL.
+ *           Must be of type SR_CHANNEL_LOGIC.
+ * @param trigger_match One of SR_TRIGGER_UART, SR_TRIGGER_SPI or
+ *                      SR_TRIGGER_I2C.
+ * @param protocol What to decode and match. Must not be NULL. The match
+ *                 keeps a copy of it.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument(s) were passed to this functions.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_trigger_protocol_match_add(struct sr_trigger_stage *stage,
+		struct sr_channel *ch, int trigger_match,
+		const struct sr_trigger_protocol *protocol)
+{
+	struct sr_trigger_match *match;
+	unsigned int num_bits;
+
+	if (!stage || !ch || !protocol)
+		return SR_ERR_ARG;
+
+	if (ch->type != SR_CHANNEL_LOGIC) {
+		sr_err("Protocol trigger matches need a logic channel.");
+		return SR_ERR_ARG;
+	}
+
+	num_bits = protocol->num_bits ? protocol->num_bits : 8;
+	switch (trigger_match) {
+	case SR_TRIGGER_UART:
+		if (!protocol->baudrate) {
+			sr_err("UART trigger match needs a baud rate.");
+			return SR_ERR_ARG;
+		}
+		if (num_bits < 5 || num_bits > 9) {
+			sr_err("Invalid number of UART data bits: %u.", num_bits);
+			return SR_ERR_ARG;
+		}
+		if (protocol->parity != SR_TRIGGER_PARITY_NONE &&
+				protocol->parity != SR_TRIGGER_PARITY_ODD &&
+				protocol->parity != SR_TRIGGER_PARITY_EVEN) {
+			sr_err("Invalid UART parity: %d.", protocol->parity);
+			return SR_ERR_ARG;
+		}
+		break;
+	case SR_TRIGGER_SPI:
+		if (num_bits > 32) {
+			sr_err("Invalid SPI word size: %u.", num_bits);
+			return SR_ERR_ARG;
+		}
+		/* Fall through. */
+	case SR_TRIGGER_I2C:
+		if (!protocol->clock || protocol->clock->type != SR_CHANNEL_LOGIC
+				|| (protocol->select &&
+				protocol->select->type != SR_CHANNEL_LOGIC)) {
+			sr_err("Protocol trigger match needs a logic clock channel.");
+			return SR_ERR_ARG;
+		}
+		break;
+	default:
+		sr_err("Invalid protocol trigger match: %d.", trigger_match);
+		return SR_ERR_ARG;
+	}
+
+	match = g_malloc0(sizeof(struct sr_trigger_match));
+	match->channel = ch;
+	match->match = trigger_match;
+	match->protocol = g_memdup(protocol, sizeof(struct sr_trigger_protocol));
+	match->protocol->num_bits = num_bits;
+	stage->matches = g_slist_append(stage->matches, match);
+
+	return SR_OK;
+}
+
+/**
+ * Allocate a new pulse width, timeout or runt trigger match and add it to
+ * the specified trigger stage.
+ *
+ * Only soft triggers support these matches, see the SR_CONF_TRIGGER_MATCH
+ * list of the device.
+ *
+ * The caller is responsible to free the trigger (including all stages and
+ * matches) using sr_trigger_free() once it is no longer needed.
+ *
+ * @param stage The trigger stage to add the match to. Must not be NULL.
+ * @param ch The data channel for this trigger match. Must not be NULL.
+ *           Must be of type SR_CHANNEL_LOGIC for SR_TRIGGER_PULSE and
+ *           SR_TRIGGER_TIMEOUT, and of type SR_CHANNEL_ANALOG for
+ *           SR_TRIGGER_RUNT.
+ * @param trigger_match One of SR_TRIGGER_PULSE, SR_TRIGGER_TIMEOUT or
+ *                      SR_TRIGGER_RUNT.
+ * @param condition The bounds and thresholds to apply. Must not be NULL.
+ *                  The match keeps a copy of it.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument(s) were passed to this functions.
+ *
+ * @since 0.5.0
+ */
+SR_API int sr_trigger_condition_match_add(struct sr_trigger_stage *stage,
+		struct sr_channel *ch, int trigger_match,
+		const struct sr_trigger_condition *condition)
+{
+	struct sr_trigger_match *match;
+
+	if (!stage || !ch || !condition)
+		return SR_ERR_ARG;
+
+	switch (trigger_match) {
+	case SR_TRIGGER_PULSE:
+	case SR_TRIGGER_TIMEOUT:
+		if (ch->type != SR_CHANNEL_LOGIC) {
+			sr_err("Pulse and timeout trigger matches need a "
+					"logic channel.");
+			return SR_ERR_ARG;
+		}
+		if (trigger_match == SR_TRIGGER_TIMEOUT && !condition->min) {
+			sr_err("Timeout trigger match needs a time.");
+			return SR_ERR_ARG;
+		}
+		break;
+	case SR_TRIGGER_RUNT:
+		if (ch->type != SR_CHANNEL_ANALOG) {
+			sr_err("Runt trigger matches need an analog channel.");
+			return SR_ERR_ARG;
+		}
+		if (!(condition->low < condition->high)) {
+			sr_err("Invalid runt thresholds: %f, %f.",
+					condition->low, condition->high);
+			return SR_ERR_ARG;
+		}
+		break;
+	default:
+		sr_err("Invalid condition trigger match: %d.", trigger_match);
+		return SR_ERR_ARG;
+	}
+
+	if (trigger_match != SR_TRIGGER_TIMEOUT && condition->max
+			&& condition->min > condition->max) {
+		sr_err("Invalid pulse width bounds: %" PRIu64 " > %" PRIu64 ".",
+				condition->min, condition->max);
+		return SR_ERR_ARG;
+	}
+
+	match = g_malloc0(sizeof(struct sr_trigger_match));
+	match->channel = ch;
+	match->match = trigger_match;
+	match->condition = g_memdup(condition,
+			sizeof(struct sr_trigger_condition));
+	stage->matches = g_slist_append(stage->matches, match);
+
+	return SR_OK;
+}
+
 /** @} */
@@ -510,3 +510,38 @@ SR_PRIV int usb_get_port_path(libusb_device *dev, char *path, int path_len)
 
 	return SR_OK;
 }
+
+/**
+ * Add a USB device to a driver's list for sr_dev_driver.usb_ids(),
+ * unless it's listed already.
+ *
+ * @param ids The list so far, or NULL.
+ * @param vid USB vendor ID.
+ * @param pid USB product ID.
+ * @param manufacturer Prefix of the manufacturer string, or NULL.
+ * @param product Prefix of the product string, or NULL.
+ *
+ * @return The list with the device.
+ */
+SR_PRIV GSList *usb_id_append(GSList *ids, uint16_t vid, uint16_t pid,
+		const char *manufacturer, const char *product)
+{
+	struct sr_usb_id *id;
+	GSList *l;
+
+	for (l = ids; l; l = l->next) {
+		id = l->data;
+		if (id->vid == vid && id->pid == pid
+				&& !g_strcmp0(id->manufacturer, manufacturer)
+				&& !g_strcmp0(id->product, product))
+			return ids;
+	}
+
+	id = g_malloc(sizeof(struct sr_usb_id));
+	id->vid = vid;
+	id->pid = pid;
+	id->manufacturer = manufacturer;
+	id->product = product;
+
+	return g_slist_append(ids, id);
+}
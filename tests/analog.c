@@ -196,6 +196,89 @@ START_TEST(test_set_rational_null)
 }
 END_TEST
 
+START_TEST(test_interleave)
+{
+	unsigned int i, k;
+	int16_t a[4], b[4], c[4], inter[12], out[3][4];
+	const void *planes[3] = { a, b, c };
+	void *outplanes[3] = { out[0], out[1], out[2] };
+
+	for (i = 0; i < 4; i++) {
+		a[i] = i;
+		b[i] = 100 + i;
+		c[i] = -1000 - i;
+	}
+	sr_analog_interleave(planes, 3, sizeof(int16_t), 4, inter);
+	for (i = 0; i < 4; i++) {
+		fail_unless(inter[i * 3] == a[i]);
+		fail_unless(inter[i * 3 + 1] == b[i]);
+		fail_unless(inter[i * 3 + 2] == c[i]);
+	}
+
+	memset(out, 0, sizeof(out));
+	sr_analog_deinterleave(inter, 3, sizeof(int16_t), 4, outplanes);
+	for (k = 0; k < 3; k++)
+		fail_unless(!memcmp(out[k], planes[k], sizeof(a)),
+			"Plane %u differs after the round trip.", k);
+}
+END_TEST
+
+/* A strided plane reads its channel straight out of an interleaved buffer. */
+START_TEST(test_planar_to_float)
+{
+	int ret;
+	unsigned int i, k;
+	int16_t inter[6];
+	float fout[6];
+	struct sr_channel ch[2];
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_plane planes[2];
+	struct sr_datafeed_analog_planar planar;
+
+	memset(&encoding, 0, sizeof(encoding));
+	encoding.unitsize = sizeof(int16_t);
+	encoding.is_signed = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+	encoding.scale.p = 1;
+	encoding.scale.q = 10;
+	encoding.offset.p = 0;
+	encoding.offset.q = 1;
+	memset(&meaning, 0, sizeof(meaning));
+
+	for (i = 0; i < 3; i++) {
+		inter[i * 2] = 10 * i;
+		inter[i * 2 + 1] = -20 * (int)i;
+	}
+	for (k = 0; k < 2; k++) {
+		planes[k].channel = &ch[k];
+		planes[k].data = &inter[k];
+		planes[k].stride = 2 * sizeof(int16_t);
+		planes[k].encoding = &encoding;
+		planes[k].meaning = &meaning;
+		planes[k].spec = NULL;
+	}
+	memset(&planar, 0, sizeof(planar));
+	planar.num_samples = 3;
+	planar.num_planes = 2;
+	planar.planes = planes;
+
+	ret = sr_analog_planar_to_float(&planar, fout);
+	fail_unless(ret == SR_OK, "sr_analog_planar_to_float() failed: %d.", ret);
+	for (i = 0; i < 3; i++) {
+		fail_unless(fabs(fout[i] - 1.0 * i) <= 0.001,
+			"%f != %f", fout[i], 1.0 * i);
+		fail_unless(fabs(fout[3 + i] + 2.0 * i) <= 0.001,
+			"%f != %f", fout[3 + i], -2.0 * i);
+	}
+
+	ret = sr_analog_plane_to_float(NULL, 3, fout);
+	fail_unless(ret == SR_ERR_ARG);
+}
+END_TEST
+
 Suite *suite_analog(void)
 {
 	Suite *s;
@@ -212,5 +295,10 @@ Suite *suite_analog(void)
 	tcase_add_test(tc, test_set_rational_null);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("planar");
+	tcase_add_test(tc, test_interleave);
+	tcase_add_test(tc, test_planar_to_float);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -19,7 +19,9 @@
  */
 
 #include <config.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -30,7 +32,8 @@
  *  - Check whether an sr_init() call with a proper sr_ctx works.
  *    If it returns != SR_OK (or segfaults) this test will fail.
  *    The sr_init() call (among other things) also runs sanity checks on
- *    all libsigrok hardware drivers and errors out upon issues.
+ *    all libsigrok hardware drivers and errors out upon issues, as the
+ *    testsuite sets LIBSIGROK_SANITY_CHECKS.
  *
  *  - Check whether a subsequent sr_exit() with that sr_ctx works.
  *    If it returns != SR_OK (or segfaults) this test will fail.
@@ -163,6 +166,118 @@ START_TEST(test_exit_null)
 }
 END_TEST
 
+#ifdef HAVE_HW_AGILENT_DMM
+/*
+ * Check that sr_init() leaves the drivers alone, and that a driver is
+ * initialized on first use.
+ */
+START_TEST(test_driver_lazy_init)
+{
+	int ret;
+	struct sr_context *sr_ctx;
+	struct sr_dev_driver **drivers, *driver;
+	GSList *devices;
+
+	ret = sr_init(&sr_ctx);
+	fail_unless(ret == SR_OK, "sr_init() failed: %d.", ret);
+	drivers = sr_driver_list(sr_ctx);
+	for (driver = NULL; *drivers && !driver; drivers++)
+		if (!strcmp((*drivers)->name, "agilent-dmm"))
+			driver = *drivers;
+	fail_unless(driver != NULL, "Driver not found.");
+	fail_unless(driver->context == NULL, "Driver was initialized early.");
+	fail_unless(sr_dev_list(driver) == NULL, "Uninitialized driver has "
+		"devices.");
+
+	/* No conn, so this finds nothing, but has to initialize the driver. */
+	devices = sr_driver_scan(driver, NULL);
+	fail_unless(devices == NULL, "Found devices without a conn.");
+	fail_unless(driver->context != NULL, "Driver wasn't initialized.");
+
+	ret = sr_exit(sr_ctx);
+	fail_unless(ret == SR_OK, "sr_exit() failed: %d.", ret);
+	fail_unless(driver->context == NULL, "Driver wasn't cleaned up.");
+}
+END_TEST
+
+/*
+ * Check that with two contexts, each sr_exit() only cleans up the drivers
+ * of its own context, and that a driver isn't initialized on first use
+ * while it's unclear which context it belongs to.
+ */
+START_TEST(test_driver_two_contexts)
+{
+	int ret;
+	struct sr_context *sr_ctx1, *sr_ctx2;
+	struct sr_dev_driver **drivers, *driver;
+
+	ret = sr_init(&sr_ctx1);
+	fail_unless(ret == SR_OK, "sr_init() 1 failed: %d.", ret);
+	ret = sr_init(&sr_ctx2);
+	fail_unless(ret == SR_OK, "sr_init() 2 failed: %d.", ret);
+	drivers = sr_driver_list(sr_ctx1);
+	for (driver = NULL; *drivers && !driver; drivers++)
+		if (!strcmp((*drivers)->name, "agilent-dmm"))
+			driver = *drivers;
+	fail_unless(driver != NULL, "Driver not found.");
+
+	fail_unless(sr_driver_scan(driver, NULL) == NULL);
+	fail_unless(driver->context == NULL, "Driver was initialized with "
+		"either context.");
+
+	ret = sr_driver_init(sr_ctx1, driver);
+	fail_unless(ret == SR_OK, "sr_driver_init() failed: %d.", ret);
+	ret = sr_exit(sr_ctx2);
+	fail_unless(ret == SR_OK, "sr_exit() 2 failed: %d.", ret);
+	fail_unless(driver->context != NULL, "Driver was cleaned up by the "
+		"other context.");
+	ret = sr_exit(sr_ctx1);
+	fail_unless(ret == SR_OK, "sr_exit() 1 failed: %d.", ret);
+	fail_unless(driver->context == NULL, "Driver wasn't cleaned up.");
+}
+END_TEST
+#endif
+
+static double init_exit_usecs(unsigned int num)
+{
+	struct sr_context *sr_ctx;
+	unsigned int i;
+	int64_t start;
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < num; i++) {
+		fail_unless(sr_init(&sr_ctx) == SR_OK, "sr_init() failed.");
+		fail_unless(sr_exit(sr_ctx) == SR_OK, "sr_exit() failed.");
+	}
+
+	return (double)(g_get_monotonic_time() - start) / num;
+}
+
+/*
+ * Time an sr_init()/sr_exit() pair, with and without the sanity checks.
+ * This only runs when LIBSIGROK_TEST_BENCHMARKS is set, and the figures
+ * go to stderr.
+ */
+START_TEST(test_init_benchmark)
+{
+	const unsigned int num = 200;
+	double plain, checked;
+
+	if (!g_getenv("LIBSIGROK_TEST_BENCHMARKS"))
+		return;
+
+	g_unsetenv("LIBSIGROK_SANITY_CHECKS");
+	plain = init_exit_usecs(num);
+	g_setenv("LIBSIGROK_SANITY_CHECKS", "1", TRUE);
+	checked = init_exit_usecs(num);
+	g_unsetenv("LIBSIGROK_SANITY_CHECKS");
+
+	fprintf(stderr,
+		"sr_init()/sr_exit(): %.1f us, %.1f us with sanity checks.\n",
+		plain, checked);
+}
+END_TEST
+
 Suite *suite_core(void)
 {
 	Suite *s;
@@ -178,6 +293,15 @@ Suite *suite_core(void)
 	tcase_add_test(tc, test_init_exit_3_reverse);
 	tcase_add_test(tc, test_init_null);
 	tcase_add_test(tc, test_exit_null);
+#ifdef HAVE_HW_AGILENT_DMM
+	tcase_add_test(tc, test_driver_lazy_init);
+	tcase_add_test(tc, test_driver_two_contexts);
+#endif
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("init_benchmark");
+	tcase_set_timeout(tc, 60);
+	tcase_add_test(tc, test_init_benchmark);
 	suite_add_tcase(s, tc);
 
 	return s;
@@ -0,0 +1,303 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+#include "modbus_sim.h"
+#include "serial_sim.h"
+
+#if defined(HAVE_HW_MAYNUO_M97) && !defined(_WIN32)
+
+struct feed_check {
+	uint64_t num_voltages;
+	uint64_t num_currents;
+	/* Readings that weren't the next voltage, or the fixed current. */
+	uint64_t mismatches;
+	int num_ends;
+};
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct feed_check *check;
+	const struct sr_datafeed_analog *analog;
+	float value, expected;
+
+	(void)sdi;
+
+	check = cb_data;
+
+	switch (packet->type) {
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		fail_unless(sr_analog_to_float(analog, &value) == SR_OK);
+		if (analog->meaning->mq == SR_MQ_VOLTAGE) {
+			/* The number of earlier reads, see modbus_sim.h. */
+			expected = (check->num_voltages++ %
+				SRTEST_MODBUS_SIM_SEQ_MOD) / 10.0;
+		} else {
+			expected = SRTEST_MODBUS_SIM_CURRENT;
+			check->num_currents++;
+		}
+		if (fabs(value - expected) > 0.001)
+			check->mismatches++;
+		break;
+	case SR_DF_END:
+		check->num_ends++;
+		break;
+	}
+}
+
+/* Scan for the load on conn, and open it. */
+static struct sr_dev_inst *open_load(const char *conn)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	struct sr_config *src;
+	GSList *options, *devices;
+	int ret;
+
+	driver = srtest_driver_get("maynuo-m97");
+	srtest_driver_init(srtest_ctx, driver);
+
+	src = g_malloc(sizeof(struct sr_config));
+	src->key = SR_CONF_CONN;
+	src->data = g_variant_ref_sink(g_variant_new_string(conn));
+	options = g_slist_append(NULL, src);
+	devices = sr_driver_scan(driver, options);
+	g_variant_unref(src->data);
+	g_free(src);
+	g_slist_free(options);
+
+	fail_unless(g_slist_length(devices) == 1,
+		"Expected one load on %s, found %u.", conn,
+		g_slist_length(devices));
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	ret = sr_dev_open(sdi);
+	fail_unless(ret == SR_OK, "Failed to open device: %d.", ret);
+
+	return sdi;
+}
+
+/* Take num_samples measurements; returns how long that took. */
+static double run_acquisition(struct sr_dev_inst *sdi,
+		struct feed_check *check, uint64_t num_samples)
+{
+	struct sr_session *sess;
+	int64_t start;
+	int ret;
+
+	ret = sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+			g_variant_new_uint64(num_samples));
+	fail_unless(ret == SR_OK, "Failed to set sample limit: %d.", ret);
+
+	ret = sr_session_new(srtest_ctx, &sess);
+	fail_unless(ret == SR_OK, "sr_session_new() failed: %d.", ret);
+	sr_session_dev_add(sess, sdi);
+	sr_session_datafeed_callback_add(sess, datafeed_in, check);
+	memset(check, 0, sizeof(*check));
+
+	start = g_get_monotonic_time();
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	start = g_get_monotonic_time() - start;
+	sr_session_destroy(sess);
+
+	fail_unless(check->num_ends == 1, "Got %d end packets.",
+		check->num_ends);
+	fail_unless(check->num_voltages == num_samples &&
+		check->num_currents == num_samples,
+		"Got %" PRIu64 " voltages and %" PRIu64 " currents.",
+		check->num_voltages, check->num_currents);
+	fail_unless(check->mismatches == 0,
+		"%" PRIu64 " readings were out of order or wrong.",
+		check->mismatches);
+
+	return start / 1e6;
+}
+
+static void tcp_acquisition(gboolean reorder)
+{
+	struct srtest_modbus_sim *sim;
+	struct sr_dev_inst *sdi;
+	struct feed_check check;
+
+	sim = srtest_modbus_sim_new(reorder);
+	sdi = open_load(srtest_modbus_sim_conn(sim));
+	run_acquisition(sdi, &check, 50);
+	fail_unless(srtest_modbus_sim_max_pending(sim) > 1,
+		"Requests weren't pipelined.");
+	sr_dev_close(sdi);
+	srtest_modbus_sim_free(sim);
+}
+
+START_TEST(test_tcp)
+{
+	tcp_acquisition(FALSE);
+}
+END_TEST
+
+/* Replies matched to their requests by transaction ID. */
+START_TEST(test_tcp_reordered)
+{
+	tcp_acquisition(TRUE);
+}
+END_TEST
+
+#ifdef HAVE_LIBSERIALPORT
+START_TEST(test_rtu)
+{
+	struct srtest_serial_sim *sim;
+	struct srtest_serial_sim_dev *dev;
+	struct sr_dev_inst *sdi;
+	struct feed_check check;
+
+	if (!srtest_serial_sim_active())
+		return;
+
+	sim = srtest_serial_sim_new();
+	dev = srtest_serial_sim_dev_add(sim, SRTEST_SERIAL_SIM_MAYNUO, 9600);
+	sdi = open_load(srtest_serial_sim_dev_path(dev));
+	run_acquisition(sdi, &check, 20);
+	sr_dev_close(sdi);
+	srtest_serial_sim_free(sim);
+}
+END_TEST
+
+/*
+ * A reply whose byte count runs past the end of any frame is dropped,
+ * and the acquisition carries on in sync with the next one.
+ */
+START_TEST(test_rtu_bad_byte_count)
+{
+	struct srtest_serial_sim *sim;
+	struct srtest_serial_sim_dev *dev;
+	struct sr_dev_inst *sdi;
+	struct feed_check check;
+	uint8_t reply[3 + 0xFF + 2];
+
+	if (!srtest_serial_sim_active())
+		return;
+
+	sim = srtest_serial_sim_new();
+	dev = srtest_serial_sim_dev_add(sim, SRTEST_SERIAL_SIM_MAYNUO, 9600);
+	sdi = open_load(srtest_serial_sim_dev_path(dev));
+	/* None of the bytes after the count looks like the slave address. */
+	memset(reply, 0xFF, sizeof(reply));
+	reply[0] = SRTEST_MODBUS_SIM_UNIT;
+	reply[1] = 0x03;
+	srtest_serial_sim_dev_bad_reply(dev, reply, sizeof(reply));
+	run_acquisition(sdi, &check, 20);
+	sr_dev_close(sdi);
+	srtest_serial_sim_free(sim);
+}
+END_TEST
+#endif
+
+/*
+ * Measurements per second over Modbus TCP, through a gateway with
+ * SRTEST_MODBUS_SIM_LATENCY, and over RTU at the load's baudrates. This
+ * only runs when LIBSIGROK_TEST_BENCHMARKS is set, and the figures go
+ * to stderr.
+ */
+START_TEST(test_poll_rate)
+{
+	struct srtest_modbus_sim *tcp_sim;
+	struct sr_dev_inst *sdi;
+	struct feed_check check;
+	double secs;
+#ifdef HAVE_LIBSERIALPORT
+	static const unsigned int baudrates[] = { 9600, 115200 };
+	struct srtest_serial_sim *serial_sim;
+	struct srtest_serial_sim_dev *dev;
+	unsigned int i;
+#endif
+
+	if (!g_getenv("LIBSIGROK_TEST_BENCHMARKS"))
+		return;
+
+	tcp_sim = srtest_modbus_sim_new(FALSE);
+	sdi = open_load(srtest_modbus_sim_conn(tcp_sim));
+	secs = run_acquisition(sdi, &check, 2000);
+	fprintf(stderr, "tcp: %" PRIu64 " samples in %.2f s, %.0f samples/s, "
+		"up to %u requests pending.\n", check.num_voltages, secs,
+		check.num_voltages / secs,
+		srtest_modbus_sim_max_pending(tcp_sim));
+	sr_dev_close(sdi);
+	srtest_modbus_sim_free(tcp_sim);
+
+#ifdef HAVE_LIBSERIALPORT
+	if (!srtest_serial_sim_active())
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(baudrates); i++) {
+		serial_sim = srtest_serial_sim_new();
+		dev = srtest_serial_sim_dev_add(serial_sim,
+				SRTEST_SERIAL_SIM_MAYNUO, baudrates[i]);
+		sdi = open_load(srtest_serial_sim_dev_path(dev));
+		secs = run_acquisition(sdi, &check, 200);
+		fprintf(stderr, "rtu @ %u: %" PRIu64 " samples in %.2f s, "
+			"%.0f samples/s.\n", baudrates[i], check.num_voltages,
+			secs, check.num_voltages / secs);
+		sr_dev_close(sdi);
+		srtest_serial_sim_free(serial_sim);
+	}
+#endif
+}
+END_TEST
+
+#endif
+
+Suite *suite_driver_modbus(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("driver-modbus");
+
+	tc = tcase_create("sim");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 30);
+#if defined(HAVE_HW_MAYNUO_M97) && !defined(_WIN32)
+	tcase_add_test(tc, test_tcp);
+	tcase_add_test(tc, test_tcp_reordered);
+#ifdef HAVE_LIBSERIALPORT
+	tcase_add_test(tc, test_rtu);
+	tcase_add_test(tc, test_rtu_bad_byte_count);
+#endif
+#endif
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("sim_benchmark");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 120);
+#if defined(HAVE_HW_MAYNUO_M97) && !defined(_WIN32)
+	tcase_add_test(tc, test_poll_rate);
+#endif
+	suite_add_tcase(s, tc);
+
+	return s;
+}
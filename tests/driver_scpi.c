@@ -0,0 +1,725 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+#include "scpi_sim.h"
+
+#if (defined(HAVE_HW_RIGOL_DS) || defined(HAVE_HW_HAMEG_HMO) || \
+	defined(HAVE_HW_SCPI_PPS)) && !defined(_WIN32)
+
+/* Scan for the simulated instrument with the driver, and open it. */
+static struct sr_dev_inst *open_device(struct srtest_scpi_sim *sim,
+		const char *driver_name)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	struct sr_config *src;
+	GSList *options, *devices;
+	int ret;
+
+	driver = srtest_driver_get(driver_name);
+	srtest_driver_init(srtest_ctx, driver);
+
+	src = g_malloc(sizeof(struct sr_config));
+	src->key = SR_CONF_CONN;
+	src->data = g_variant_ref_sink(g_variant_new_string(
+			srtest_scpi_sim_conn(sim)));
+	options = g_slist_append(NULL, src);
+	devices = sr_driver_scan(driver, options);
+	g_variant_unref(src->data);
+	g_free(src);
+	g_slist_free(options);
+
+	fail_unless(g_slist_length(devices) == 1,
+		"Expected one device on %s, found %u.",
+		srtest_scpi_sim_conn(sim), g_slist_length(devices));
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	ret = sr_dev_open(sdi);
+	fail_unless(ret == SR_OK, "Failed to open device: %d.", ret);
+
+	return sdi;
+}
+
+static struct sr_channel_group *find_group(struct sr_dev_inst *sdi,
+		const char *name)
+{
+	struct sr_channel_group *cg;
+	GSList *l;
+
+	for (l = sr_dev_inst_channel_groups_get(sdi); l; l = l->next) {
+		cg = l->data;
+		if (!strcmp(cg->name, name))
+			return cg;
+	}
+	fail("No channel group %s.", name);
+
+	return NULL;
+}
+
+/* The batch must be rejected, with nothing sent to the instrument. */
+static void check_rejected(struct srtest_scpi_sim *sim,
+		struct sr_dev_inst *sdi, GSList *entries)
+{
+	char *settings;
+	int ret;
+
+	ret = sr_config_set_batch(sdi, entries);
+	fail_unless(ret == SR_ERR_ARG, "Invalid batch returned %d.", ret);
+	settings = srtest_scpi_sim_take_settings(sim);
+	fail_unless(!settings[0], "Invalid batch was applied: %s", settings);
+	g_free(settings);
+}
+
+#endif
+
+#if defined(HAVE_HW_RIGOL_DS) && !defined(_WIN32)
+
+/* Samples per :WAV:DATA? the DS1000Z takes, over anything but serial. */
+#define DS1000Z_BLOCK_SAMPLES 250000
+
+struct feed_check {
+	/* Samples received per channel, all checked against the memory. */
+	uint64_t samples[SRTEST_SCPI_SIM_CHANNELS];
+	uint64_t mismatches;
+	int num_frames;
+	int num_ends;
+	/* Stop the session at the first data packet. */
+	struct sr_session *stop_session;
+};
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct feed_check *check;
+	const struct sr_datafeed_analog *analog;
+	const struct sr_channel *ch;
+	uint64_t offset;
+	float *values;
+	int i;
+
+	(void)sdi;
+
+	check = cb_data;
+
+	switch (packet->type) {
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		ch = analog->meaning->channels->data;
+		offset = check->samples[ch->index];
+		/* The ADC bytes come as they are, and convert to volts. */
+		fail_unless(analog->encoding->unitsize == 1
+			&& !analog->encoding->is_float,
+			"Samples weren't passed on as bytes.");
+		values = g_malloc(sizeof(float) * analog->num_samples);
+		fail_unless(sr_analog_to_float(analog, values) == SR_OK);
+		for (i = 0; i < analog->num_samples; i++) {
+			if (values[i] != srtest_scpi_sim_volts(
+					srtest_scpi_sim_sample(ch->index,
+						offset + i)))
+				check->mismatches++;
+		}
+		g_free(values);
+		check->samples[ch->index] += analog->num_samples;
+		if (check->stop_session) {
+			sr_session_stop(check->stop_session);
+			check->stop_session = NULL;
+		}
+		break;
+	case SR_DF_FRAME_END:
+		check->num_frames++;
+		break;
+	case SR_DF_END:
+		check->num_ends++;
+		break;
+	}
+}
+
+/* Scan for the simulated scope and open it, reading from its memory. */
+static struct sr_dev_inst *open_scope(struct srtest_scpi_sim *sim,
+		unsigned int num_channels)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ch;
+	GSList *l;
+	int ret;
+
+	sdi = open_device(sim, "rigol-ds");
+
+	ret = sr_config_set(sdi, NULL, SR_CONF_DATA_SOURCE,
+			g_variant_new_string("Memory"));
+	fail_unless(ret == SR_OK, "Failed to select memory: %d.", ret);
+	ret = sr_config_set(sdi, NULL, SR_CONF_LIMIT_FRAMES,
+			g_variant_new_uint64(1));
+	fail_unless(ret == SR_OK, "Failed to set frame limit: %d.", ret);
+
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		ch = l->data;
+		sr_dev_channel_enable(ch, ch->index < (int)num_channels);
+	}
+
+	return sdi;
+}
+
+static double run_acquisition(struct sr_dev_inst *sdi,
+		struct feed_check *check, gboolean stop_early)
+{
+	struct sr_session *sess;
+	int64_t start;
+	int ret;
+
+	ret = sr_session_new(srtest_ctx, &sess);
+	fail_unless(ret == SR_OK, "sr_session_new() failed: %d.", ret);
+	sr_session_dev_add(sess, sdi);
+	sr_session_datafeed_callback_add(sess, datafeed_in, check);
+	memset(check, 0, sizeof(*check));
+	if (stop_early)
+		check->stop_session = sess;
+
+	start = g_get_monotonic_time();
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	start = g_get_monotonic_time() - start;
+	sr_session_destroy(sess);
+
+	fail_unless(check->num_ends == 1, "Got %d end packets.",
+		check->num_ends);
+
+	return start / 1e6;
+}
+
+/* The whole memory must have arrived, intact. */
+static void check_frame(const struct feed_check *check,
+		unsigned int num_channels)
+{
+	unsigned int i;
+
+	fail_unless(check->num_frames == 1, "Got %d frames.",
+		check->num_frames);
+	fail_unless(check->mismatches == 0, "%" PRIu64 " samples were wrong.",
+		check->mismatches);
+	for (i = 0; i < num_channels; i++) {
+		fail_unless(check->samples[i] ==
+			SRTEST_SCPI_SIM_MEMORY / num_channels,
+			"Got %" PRIu64 " samples on CH%u.",
+			check->samples[i], i + 1);
+	}
+}
+
+static void download(enum srtest_scpi_sim_transport transport)
+{
+	struct srtest_scpi_sim *sim;
+	struct sr_dev_inst *sdi;
+	struct feed_check check;
+
+	sim = srtest_scpi_sim_new(transport);
+	sdi = open_scope(sim, 2);
+	run_acquisition(sdi, &check, FALSE);
+	check_frame(&check, 2);
+	sr_dev_close(sdi);
+	srtest_scpi_sim_free(sim);
+}
+
+START_TEST(test_hislip)
+{
+	download(SRTEST_SCPI_SIM_HISLIP);
+}
+END_TEST
+
+START_TEST(test_hislip_overlapped)
+{
+	download(SRTEST_SCPI_SIM_HISLIP_OVERLAPPED);
+}
+END_TEST
+
+/*
+ * Stopping in the middle of a block leaves the rest of it on its way.
+ * A device clear gets rid of it, so the next acquisition works.
+ */
+START_TEST(test_hislip_clear)
+{
+	struct srtest_scpi_sim *sim;
+	struct sr_dev_inst *sdi;
+	struct feed_check check;
+
+	sim = srtest_scpi_sim_new(SRTEST_SCPI_SIM_HISLIP);
+	sdi = open_scope(sim, 2);
+
+	run_acquisition(sdi, &check, TRUE);
+	fail_unless(check.num_frames == 0, "Completed a frame.");
+	fail_unless(srtest_scpi_sim_clears(sim) == 1,
+		"%" PRIu64 " device clears.", srtest_scpi_sim_clears(sim));
+
+	run_acquisition(sdi, &check, FALSE);
+	check_frame(&check, 2);
+
+	sr_dev_close(sdi);
+	srtest_scpi_sim_free(sim);
+}
+END_TEST
+
+/* Empty blocks are requested again, after backing off, until data comes. */
+START_TEST(test_empty_blocks)
+{
+	struct srtest_scpi_sim *sim;
+	struct sr_dev_inst *sdi;
+	struct feed_check check;
+
+	sim = srtest_scpi_sim_new(SRTEST_SCPI_SIM_TCP_RIGOL);
+	sdi = open_scope(sim, 2);
+	srtest_scpi_sim_empty_blocks(sim, 8);
+
+	run_acquisition(sdi, &check, FALSE);
+	check_frame(&check, 2);
+
+	sr_dev_close(sdi);
+	srtest_scpi_sim_free(sim);
+}
+END_TEST
+
+static unsigned int count_lines(const char *text, const char *line)
+{
+	char **lines;
+	unsigned int i, n;
+
+	lines = g_strsplit(text, "\n", 0);
+	for (n = 0, i = 0; lines[i]; i++)
+		n += !strcmp(lines[i], line);
+	g_strfreev(lines);
+
+	return n;
+}
+
+/*
+ * Download one channel over a link which takes latency_us for the scope
+ * to start answering each data block, and moves bytes_per_sec. Returns
+ * the time taken.
+ */
+static double download_link(enum srtest_scpi_sim_transport transport,
+		uint64_t latency_us, uint64_t bytes_per_sec, uint64_t *overlaps)
+{
+	struct srtest_scpi_sim *sim;
+	struct sr_dev_inst *sdi;
+	struct feed_check check;
+	char *queries;
+	unsigned int blocks;
+	double secs;
+
+	sim = srtest_scpi_sim_new(transport);
+	srtest_scpi_sim_link(sim, latency_us, bytes_per_sec);
+	sdi = open_scope(sim, 1);
+	g_free(srtest_scpi_sim_take_queries(sim));
+
+	secs = run_acquisition(sdi, &check, FALSE);
+	check_frame(&check, 1);
+
+	queries = srtest_scpi_sim_take_queries(sim);
+	blocks = count_lines(queries, ":WAV:DATA?");
+	fail_unless(blocks == SRTEST_SCPI_SIM_MEMORY / DS1000Z_BLOCK_SAMPLES,
+		"Memory read in %u blocks.", blocks);
+	g_free(queries);
+	*overlaps = srtest_scpi_sim_overlaps(sim);
+
+	sr_dev_close(sdi);
+	srtest_scpi_sim_free(sim);
+
+	return secs;
+}
+
+/*
+ * The memory is read in the largest blocks the scope takes. Where the
+ * scope queues its responses, the next block is requested as soon as
+ * the current one starts arriving. Otherwise, not before it's complete.
+ */
+START_TEST(test_block_pipelining)
+{
+	uint64_t overlaps;
+
+	download_link(SRTEST_SCPI_SIM_HISLIP, 1000, 50000000, &overlaps);
+	fail_unless(overlaps == 0, "%" PRIu64 " queries interrupted a "
+		"response in synchronized mode.", overlaps);
+
+	/* Each block takes 5 ms, the next request is out well before. */
+	download_link(SRTEST_SCPI_SIM_HISLIP_OVERLAPPED, 1000, 50000000,
+		&overlaps);
+	fail_unless(overlaps > 0, "No block was requested before the "
+		"previous one was read.");
+}
+END_TEST
+
+/*
+ * A block's worth of latency on the link: requesting the next block
+ * ahead hides most of it.
+ */
+START_TEST(test_block_pipelining_benchmark)
+{
+	uint64_t overlaps;
+	double synchronized, overlapped;
+
+	if (!g_getenv("LIBSIGROK_TEST_BENCHMARKS"))
+		return;
+
+	synchronized = download_link(SRTEST_SCPI_SIM_HISLIP, 5000, 50000000,
+		&overlaps);
+	overlapped = download_link(SRTEST_SCPI_SIM_HISLIP_OVERLAPPED, 5000,
+		50000000, &overlaps);
+	fail_unless(overlapped < synchronized * 0.8,
+		"Pipelined download took %.2f s, %.2f s without.",
+		overlapped, synchronized);
+}
+END_TEST
+
+/*
+ * A batch is checked as a whole before anything is sent, applied in
+ * the order the scope needs, and completed with a single *OPC?.
+ */
+START_TEST(test_config_batch)
+{
+	struct srtest_scpi_sim *sim;
+	struct sr_dev_inst *sdi;
+	struct sr_config_batch_entry entries[3];
+	GSList *list;
+	char *settings, *scale, *offset;
+	uint64_t opcs;
+	int ret;
+
+	sim = srtest_scpi_sim_new(SRTEST_SCPI_SIM_HISLIP);
+	sdi = open_scope(sim, 2);
+	g_free(srtest_scpi_sim_take_settings(sim));
+
+	/* The trigger position depends on the timebase given after it. */
+	entries[0].cg = NULL;
+	entries[0].key = SR_CONF_HORIZ_TRIGGERPOS;
+	entries[0].data = g_variant_new_double(0.25);
+	entries[1].cg = find_group(sdi, "CH1");
+	entries[1].key = SR_CONF_VDIV;
+	entries[1].data = g_variant_new("(tt)", (uint64_t)1, (uint64_t)1);
+	entries[2].cg = NULL;
+	entries[2].key = SR_CONF_TIMEBASE;
+	entries[2].data = g_variant_new("(tt)", (uint64_t)1, (uint64_t)1000);
+	list = g_slist_append(NULL, &entries[0]);
+	list = g_slist_append(list, &entries[1]);
+	list = g_slist_append(list, &entries[2]);
+
+	opcs = srtest_scpi_sim_opcs(sim);
+	ret = sr_config_set_batch(sdi, list);
+	fail_unless(ret == SR_OK, "sr_config_set_batch() failed: %d.", ret);
+	fail_unless(srtest_scpi_sim_opcs(sim) == opcs + 1,
+		"Expected one *OPC?, got %" PRIu64 ".",
+		srtest_scpi_sim_opcs(sim) - opcs);
+	settings = srtest_scpi_sim_take_settings(sim);
+	scale = strstr(settings, ":TIM:SCAL");
+	offset = strstr(settings, ":TIM:OFFS");
+	fail_unless(scale && offset && scale < offset,
+		"Timebase not set before trigger position: %s", settings);
+	fail_unless(strstr(settings, ":CHAN1:SCAL") != NULL,
+		"No vdiv set: %s", settings);
+	g_free(settings);
+
+	/* SR_CONF_SAMPLERATE can't be set, so nothing may be applied. */
+	entries[0].cg = NULL;
+	entries[0].key = SR_CONF_TIMEBASE;
+	entries[0].data = g_variant_new("(tt)", (uint64_t)1, (uint64_t)1000);
+	entries[1].cg = NULL;
+	entries[1].key = SR_CONF_SAMPLERATE;
+	entries[1].data = g_variant_new_uint64(1000000);
+	g_slist_free(list);
+	list = g_slist_append(NULL, &entries[0]);
+	list = g_slist_append(list, &entries[1]);
+	check_rejected(sim, sdi, list);
+
+	/* Nor if a value isn't one of the scope's. */
+	entries[0].data = g_variant_new("(tt)", (uint64_t)1, (uint64_t)1000);
+	entries[1].cg = find_group(sdi, "CH1");
+	entries[1].key = SR_CONF_VDIV;
+	entries[1].data = g_variant_new("(tt)", (uint64_t)3, (uint64_t)7);
+	check_rejected(sim, sdi, list);
+
+	entries[0].data = g_variant_new("(tt)", (uint64_t)1, (uint64_t)1000);
+	entries[1].cg = NULL;
+	entries[1].key = SR_CONF_HORIZ_TRIGGERPOS;
+	entries[1].data = g_variant_new_double(1.5);
+	check_rejected(sim, sdi, list);
+	g_slist_free(list);
+
+	sr_dev_close(sdi);
+	srtest_scpi_sim_free(sim);
+}
+END_TEST
+
+/*
+ * Download the full memory of one channel over each transport. This
+ * only runs when LIBSIGROK_TEST_BENCHMARKS is set, and the figures go
+ * to stderr.
+ *
+ * VXI-11 isn't compared, as it takes a portmapper (rpcbind) to find the
+ * instrument. tcp-raw can't tell where a block ends, so tcp-rigol,
+ * which prefixes every response with its length, stands in for plain
+ * TCP.
+ */
+START_TEST(test_download_speed)
+{
+	static const struct {
+		enum srtest_scpi_sim_transport transport;
+		const char *name;
+	} transports[] = {
+		{ SRTEST_SCPI_SIM_HISLIP, "hislip, synchronized" },
+		{ SRTEST_SCPI_SIM_HISLIP_OVERLAPPED, "hislip, overlapped" },
+		{ SRTEST_SCPI_SIM_TCP_RIGOL, "tcp-rigol" },
+	};
+	struct srtest_scpi_sim *sim;
+	struct sr_dev_inst *sdi;
+	struct feed_check check;
+	double secs;
+	unsigned int i;
+
+	if (!g_getenv("LIBSIGROK_TEST_BENCHMARKS"))
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(transports); i++) {
+		sim = srtest_scpi_sim_new(transports[i].transport);
+		sdi = open_scope(sim, 1);
+		secs = run_acquisition(sdi, &check, FALSE);
+		check_frame(&check, 1);
+		fprintf(stderr,
+			"%s: %" PRIu64 " samples in %.2f s, %.1f MB/s.\n",
+			transports[i].name, check.samples[0], secs,
+			check.samples[0] / secs / 1e6);
+		sr_dev_close(sdi);
+		srtest_scpi_sim_free(sim);
+	}
+}
+END_TEST
+
+#endif
+
+#if defined(HAVE_HW_HAMEG_HMO) && !defined(_WIN32)
+
+/*
+ * A batch is checked against the model's tables before anything is
+ * sent, and completed with a single *OPC? and sample rate update.
+ */
+START_TEST(test_config_batch_hmo)
+{
+	struct srtest_scpi_sim *sim;
+	struct sr_dev_inst *sdi;
+	struct sr_config_batch_entry entries[4];
+	GSList *list;
+	char *settings, *queries, **lines, *scale, *pos;
+	uint64_t opcs;
+	int ret, i, updates;
+
+	sim = srtest_scpi_sim_new_instrument(SRTEST_SCPI_SIM_HISLIP,
+			SRTEST_SCPI_SIM_HAMEG_HMO);
+	sdi = open_device(sim, "hameg-hmo");
+	g_free(srtest_scpi_sim_take_settings(sim));
+	g_free(srtest_scpi_sim_take_queries(sim));
+
+	entries[0].cg = NULL;
+	entries[0].key = SR_CONF_HORIZ_TRIGGERPOS;
+	entries[0].data = g_variant_new_double(0.25);
+	entries[1].cg = find_group(sdi, "CH1");
+	entries[1].key = SR_CONF_VDIV;
+	entries[1].data = g_variant_new("(tt)", (uint64_t)1, (uint64_t)1);
+	entries[2].cg = find_group(sdi, "CH2");
+	entries[2].key = SR_CONF_COUPLING;
+	entries[2].data = g_variant_new_string("AC");
+	entries[3].cg = NULL;
+	entries[3].key = SR_CONF_TIMEBASE;
+	entries[3].data = g_variant_new("(tt)", (uint64_t)1, (uint64_t)1000);
+	list = NULL;
+	for (i = 0; i < 4; i++)
+		list = g_slist_append(list, &entries[i]);
+
+	opcs = srtest_scpi_sim_opcs(sim);
+	ret = sr_config_set_batch(sdi, list);
+	fail_unless(ret == SR_OK, "sr_config_set_batch() failed: %d.", ret);
+	fail_unless(srtest_scpi_sim_opcs(sim) == opcs + 1,
+		"Expected one *OPC?, got %" PRIu64 ".",
+		srtest_scpi_sim_opcs(sim) - opcs);
+	settings = srtest_scpi_sim_take_settings(sim);
+	scale = strstr(settings, ":TIM:SCAL");
+	pos = strstr(settings, ":TIM:POS");
+	fail_unless(scale && pos && scale < pos,
+		"Timebase not set before trigger position: %s", settings);
+	fail_unless(strstr(settings, ":CHAN1:SCAL") != NULL,
+		"No vdiv set: %s", settings);
+	fail_unless(strstr(settings, ":CHAN2:COUP AC") != NULL,
+		"No coupling set: %s", settings);
+	g_free(settings);
+
+	queries = srtest_scpi_sim_take_queries(sim);
+	lines = g_strsplit(queries, "\n", 0);
+	updates = 0;
+	for (i = 0; lines[i]; i++) {
+		if (g_str_has_suffix(lines[i], ":DATA:POINTS?") ||
+				!strcmp(lines[i], ":ACQ:SRAT?"))
+			updates++;
+	}
+	fail_unless(updates == 1, "Expected one sample rate update, got %d: %s",
+		updates, queries);
+	g_strfreev(lines);
+	g_free(queries);
+	g_slist_free(list);
+
+	/* A value which isn't one of the model's is rejected up front. */
+	entries[0].cg = NULL;
+	entries[0].key = SR_CONF_TIMEBASE;
+	entries[0].data = g_variant_new("(tt)", (uint64_t)1, (uint64_t)1000);
+	entries[1].cg = find_group(sdi, "CH1");
+	entries[1].key = SR_CONF_VDIV;
+	entries[1].data = g_variant_new("(tt)", (uint64_t)3, (uint64_t)7);
+	list = g_slist_append(NULL, &entries[0]);
+	list = g_slist_append(list, &entries[1]);
+	check_rejected(sim, sdi, list);
+
+	entries[0].data = g_variant_new("(tt)", (uint64_t)1, (uint64_t)1000);
+	entries[1].cg = NULL;
+	entries[1].key = SR_CONF_HORIZ_TRIGGERPOS;
+	entries[1].data = g_variant_new_double(1.5);
+	check_rejected(sim, sdi, list);
+	g_slist_free(list);
+
+	sr_dev_close(sdi);
+	srtest_scpi_sim_free(sim);
+}
+END_TEST
+
+#endif
+
+#if defined(HAVE_HW_SCPI_PPS) && !defined(_WIN32)
+
+/*
+ * A batch is checked against the outputs' ranges before anything is
+ * sent. It's applied one output after the other, each switched off
+ * first and on last.
+ */
+START_TEST(test_config_batch_pps)
+{
+	struct srtest_scpi_sim *sim;
+	struct sr_dev_inst *sdi;
+	struct sr_channel_group *out1, *out2, *out3;
+	struct sr_config_batch_entry entries[5];
+	GSList *list;
+	char *settings;
+	int ret, i;
+
+	sim = srtest_scpi_sim_new_instrument(SRTEST_SCPI_SIM_HISLIP,
+			SRTEST_SCPI_SIM_RIGOL_DP832);
+	sdi = open_device(sim, "scpi-pps");
+	g_free(srtest_scpi_sim_take_settings(sim));
+	out1 = find_group(sdi, "1");
+	out2 = find_group(sdi, "2");
+	out3 = find_group(sdi, "3");
+
+	entries[0].cg = out2;
+	entries[0].key = SR_CONF_ENABLED;
+	entries[0].data = g_variant_new_boolean(TRUE);
+	entries[1].cg = out1;
+	entries[1].key = SR_CONF_CURRENT_LIMIT;
+	entries[1].data = g_variant_new_double(1.0);
+	entries[2].cg = out2;
+	entries[2].key = SR_CONF_VOLTAGE_TARGET;
+	entries[2].data = g_variant_new_double(3.3);
+	entries[3].cg = out1;
+	entries[3].key = SR_CONF_ENABLED;
+	entries[3].data = g_variant_new_boolean(FALSE);
+	entries[4].cg = out1;
+	entries[4].key = SR_CONF_VOLTAGE_TARGET;
+	entries[4].data = g_variant_new_double(12.0);
+	list = NULL;
+	for (i = 0; i < 5; i++)
+		list = g_slist_append(list, &entries[i]);
+
+	ret = sr_config_set_batch(sdi, list);
+	fail_unless(ret == SR_OK, "sr_config_set_batch() failed: %d.", ret);
+	settings = srtest_scpi_sim_take_settings(sim);
+	fail_unless(!strcmp(settings,
+		":INST:NSEL 1\n"
+		":OUTP OFF\n"
+		":SOUR:CURR 1.000000\n"
+		":SOUR:VOLT 12.000000\n"
+		":INST:NSEL 2\n"
+		":SOUR:VOLT 3.300000\n"
+		":OUTP ON\n"), "Batch applied as:\n%s", settings);
+	g_free(settings);
+	g_slist_free(list);
+
+	/* Output 3 only goes up to 5 V. */
+	entries[0].cg = out1;
+	entries[0].key = SR_CONF_VOLTAGE_TARGET;
+	entries[0].data = g_variant_new_double(5.0);
+	entries[1].cg = out3;
+	entries[1].key = SR_CONF_VOLTAGE_TARGET;
+	entries[1].data = g_variant_new_double(12.0);
+	list = g_slist_append(NULL, &entries[0]);
+	list = g_slist_append(list, &entries[1]);
+	check_rejected(sim, sdi, list);
+	g_slist_free(list);
+
+	sr_dev_close(sdi);
+	srtest_scpi_sim_free(sim);
+}
+END_TEST
+
+#endif
+
+Suite *suite_driver_scpi(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("driver-scpi");
+
+	tc = tcase_create("sim");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 60);
+#if defined(HAVE_HW_RIGOL_DS) && !defined(_WIN32)
+	tcase_add_test(tc, test_hislip);
+	tcase_add_test(tc, test_hislip_overlapped);
+	tcase_add_test(tc, test_hislip_clear);
+	tcase_add_test(tc, test_empty_blocks);
+	tcase_add_test(tc, test_block_pipelining);
+	tcase_add_test(tc, test_config_batch);
+#endif
+#if defined(HAVE_HW_HAMEG_HMO) && !defined(_WIN32)
+	tcase_add_test(tc, test_config_batch_hmo);
+#endif
+#if defined(HAVE_HW_SCPI_PPS) && !defined(_WIN32)
+	tcase_add_test(tc, test_config_batch_pps);
+#endif
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("sim_benchmark");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 120);
+#if defined(HAVE_HW_RIGOL_DS) && !defined(_WIN32)
+	tcase_add_test(tc, test_download_speed);
+	tcase_add_test(tc, test_block_pipelining_benchmark);
+#endif
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,774 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <glib/gstdio.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+#include "serial_sim.h"
+
+#define FLEET_FS9721 32
+#define FLEET_METEX14 16
+#define FLEET_SAMPLES 20
+
+struct meter {
+	const struct sr_dev_inst *sdi;
+	/* Shows its measurement number, see serial_sim.h. */
+	struct srtest_serial_sim_dev *dev;
+	uint64_t num_packets;
+	int64_t last_seq;
+	gboolean seq_ok;
+};
+
+struct reading {
+	int mq;
+	float value;
+};
+
+struct feed_stats {
+	struct meter *meters;
+	int num_meters;
+	int num_ends;
+	uint64_t num_packets;
+	uint64_t num_latencies;
+	int64_t latency_sum;
+	int64_t latency_max;
+	/* Wall clock and CPU time the session took. */
+	double secs;
+	int64_t cpu_us;
+	/* Everything the devices sent, if not NULL. */
+	GArray *readings;
+	/* Outputs every packet also goes through, if not NULL. */
+	const struct sr_output *csv, *srzip;
+	/* Readings of digits_mq must have this many decimals in csv. */
+	int digits_mq;
+	int digits;
+	uint64_t digits_wrong;
+	int last_digits;
+};
+
+/* A driver family, and the decimals its voltage readings have. */
+struct digits_case {
+	const char *name;
+	const char *driver;
+	int type;
+	unsigned int baudrate;
+	/* Set a voltage target, and enable the output, for supplies. */
+	double voltage;
+	gboolean enable;
+	int digits;
+};
+
+#if defined(HAVE_HW_SERIAL_DMM) || defined(HAVE_HW_KORAD_KAXXXXP) \
+	|| defined(HAVE_HW_MANSON_HCS_3XXX)
+#define HAVE_DIGITS_CASES
+static const struct digits_case digits_cases[] = {
+#ifdef HAVE_HW_SERIAL_DMM
+	{ "fs9721", "digitek-dt4000zc", SRTEST_SERIAL_SIM_FS9721, 2400,
+		0, FALSE, 3 },
+	{ "metex14", "metex-m3640d", SRTEST_SERIAL_SIM_METEX14, 1200,
+		0, FALSE, 3 },
+#endif
+#ifdef HAVE_HW_KORAD_KAXXXXP
+	{ "korad", "korad-kaxxxxp", SRTEST_SERIAL_SIM_KORAD, 9600,
+		5.0, TRUE, 2 },
+#endif
+#ifdef HAVE_HW_MANSON_HCS_3XXX
+	{ "manson", "manson-hcs-3xxx", SRTEST_SERIAL_SIM_MANSON, 9600,
+		5.0, FALSE, 2 },
+#endif
+};
+#endif
+
+static int64_t thread_cpu_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void meter_packet(struct feed_stats *stats, struct meter *m,
+		float value)
+{
+	int64_t seq, sent_at, latency;
+
+	m->num_packets++;
+
+	seq = lroundf(value * 1000);
+	if (m->last_seq >= 0 &&
+			seq != (m->last_seq + 1) % SRTEST_SERIAL_SIM_SEQ_MOD)
+		m->seq_ok = FALSE;
+	m->last_seq = seq;
+
+	if (!(sent_at = srtest_serial_sim_dev_sent_at(m->dev, seq)))
+		return;
+	latency = g_get_monotonic_time() - sent_at;
+	stats->latency_sum += latency;
+	stats->latency_max = MAX(stats->latency_max, latency);
+	stats->num_latencies++;
+}
+
+/*
+ * Pass a packet on to the srzip and csv outputs, and check the decimals
+ * csv printed for a reading.
+ */
+static void outputs_send(struct feed_stats *stats,
+		const struct sr_datafeed_packet *packet)
+{
+	const struct sr_datafeed_analog *analog;
+	GString *out;
+	const char *row, *dot;
+	int decimals, ret;
+
+	ret = sr_output_send(stats->srzip, packet, &out);
+	fail_unless(ret == SR_OK, "srzip output failed: %d.", ret);
+	if (out)
+		g_string_free(out, TRUE);
+
+	ret = sr_output_send(stats->csv, packet, &out);
+	fail_unless(ret == SR_OK, "csv output failed: %d.", ret);
+	if (!out)
+		return;
+	if (packet->type == SR_DF_ANALOG) {
+		analog = packet->payload;
+		stats->last_digits = analog->encoding->digits;
+		/* The reading is the last row, after any header. */
+		while (out->len && out->str[out->len - 1] == '\n')
+			g_string_truncate(out, out->len - 1);
+		row = strrchr(out->str, '\n');
+		row = row ? row + 1 : out->str;
+		dot = strchr(row, '.');
+		decimals = dot ? (int)strlen(dot + 1) : 0;
+		if (analog->meaning->mq == stats->digits_mq &&
+				decimals != stats->digits)
+			stats->digits_wrong++;
+	}
+	g_string_free(out, TRUE);
+}
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct feed_stats *stats;
+	const struct sr_datafeed_analog *analog;
+	struct reading r;
+	float value;
+	int i;
+
+	stats = cb_data;
+	if (stats->csv)
+		outputs_send(stats, packet);
+
+	switch (packet->type) {
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		/* The meters send one reading per packet. */
+		fail_unless(analog->num_samples == 1 &&
+			g_slist_length(analog->meaning->channels) == 1,
+			"Expected a single reading.");
+		fail_unless(sr_analog_to_float(analog, &value) == SR_OK);
+		stats->num_packets++;
+		if (stats->readings) {
+			r.mq = analog->meaning->mq;
+			r.value = value;
+			g_array_append_val(stats->readings, r);
+		}
+		for (i = 0; i < stats->num_meters; i++) {
+			if (stats->meters[i].sdi == sdi) {
+				meter_packet(stats, &stats->meters[i], value);
+				break;
+			}
+		}
+		break;
+	case SR_DF_END:
+		stats->num_ends++;
+		break;
+	}
+}
+
+static struct sr_dev_driver *driver_init(const char *drivername)
+{
+	struct sr_dev_driver *driver;
+
+	driver = srtest_driver_get(drivername);
+	srtest_driver_init(srtest_ctx, driver);
+
+	return driver;
+}
+
+/* Scan for the device on the simulated port, and open it. */
+static struct sr_dev_inst *open_device(struct sr_dev_driver *driver,
+		struct srtest_serial_sim_dev *dev)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_config *src;
+	GSList *options, *devices;
+	int ret;
+
+	src = g_malloc(sizeof(struct sr_config));
+	src->key = SR_CONF_CONN;
+	src->data = g_variant_ref_sink(g_variant_new_string(
+			srtest_serial_sim_dev_path(dev)));
+	options = g_slist_append(NULL, src);
+	devices = sr_driver_scan(driver, options);
+	g_variant_unref(src->data);
+	g_free(src);
+	g_slist_free(options);
+
+	fail_unless(g_slist_length(devices) == 1,
+		"Expected one %s on %s, found %u.", driver->name,
+		srtest_serial_sim_dev_path(dev), g_slist_length(devices));
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	ret = sr_dev_open(sdi);
+	fail_unless(ret == SR_OK, "Failed to open device: %d.", ret);
+
+	return sdi;
+}
+
+static void set_config(const struct sr_dev_inst *sdi, uint32_t key,
+		GVariant *data)
+{
+	int ret;
+
+	ret = sr_config_set(sdi, NULL, key, data);
+	fail_unless(ret == SR_OK, "Failed to set config key %u: %d.", key, ret);
+}
+
+/* Run all devices in one session. The drivers close them when done. */
+static void run_acquisition(GSList *sdis, struct feed_stats *stats)
+{
+	struct sr_session *sess;
+	GSList *l;
+	int64_t start, cpu;
+	int ret;
+
+	ret = sr_session_new(srtest_ctx, &sess);
+	fail_unless(ret == SR_OK, "sr_session_new() failed: %d.", ret);
+	for (l = sdis; l; l = l->next)
+		sr_session_dev_add(sess, l->data);
+	sr_session_datafeed_callback_add(sess, datafeed_in, stats);
+
+	start = g_get_monotonic_time();
+	cpu = thread_cpu_us();
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	stats->cpu_us = thread_cpu_us() - cpu;
+	stats->secs = (g_get_monotonic_time() - start) / 1e6;
+	sr_session_destroy(sess);
+
+	fail_unless(stats->num_ends == 1, "Got %d end packets.",
+		stats->num_ends);
+}
+
+/* Benchmark figures go to stderr, apart from the test results. */
+static void report(const char *name, const struct feed_stats *stats)
+{
+	fprintf(stderr, "%s: %" PRIu64 " packets, %.1f packets/s, "
+		"%.1f us CPU per packet", name, stats->num_packets,
+		stats->num_packets / stats->secs,
+		(double)stats->cpu_us / MAX(stats->num_packets, 1));
+	if (stats->num_latencies)
+		fprintf(stderr, ", latency %.2f ms mean, %.2f ms max",
+			stats->latency_sum / 1e3 / stats->num_latencies,
+			stats->latency_max / 1e3);
+	fprintf(stderr, ".\n");
+}
+
+static void check_meters(const struct feed_stats *stats, uint64_t limit)
+{
+	int i;
+
+	for (i = 0; i < stats->num_meters; i++) {
+		fail_unless(stats->meters[i].num_packets == limit,
+			"Meter %d sent %" PRIu64 " packets, expected %" PRIu64 ".",
+			i, stats->meters[i].num_packets, limit);
+		fail_unless(stats->meters[i].seq_ok,
+			"Meter %d skipped or repeated a measurement.", i);
+	}
+}
+
+static void meter_init(struct meter *m, const struct sr_dev_inst *sdi,
+		struct srtest_serial_sim_dev *dev)
+{
+	m->sdi = sdi;
+	m->dev = dev;
+	m->num_packets = 0;
+	m->last_seq = -1;
+	m->seq_ok = TRUE;
+}
+
+#ifdef HAVE_HW_SERIAL_DMM
+/* A meter sending continuously, at its real baudrate. */
+START_TEST(test_fs9721)
+{
+	struct srtest_serial_sim *sim;
+	struct srtest_serial_sim_dev *dev;
+	struct sr_dev_inst *sdi;
+	struct feed_stats stats;
+	struct meter m;
+	GSList *sdis;
+	guint i;
+
+	if (!srtest_serial_sim_active())
+		return;
+
+	sim = srtest_serial_sim_new();
+	dev = srtest_serial_sim_dev_add(sim, SRTEST_SERIAL_SIM_FS9721, 2400);
+	sdi = open_device(driver_init("digitek-dt4000zc"), dev);
+	set_config(sdi, SR_CONF_LIMIT_SAMPLES, g_variant_new_uint64(20));
+
+	memset(&stats, 0, sizeof(stats));
+	meter_init(&m, sdi, dev);
+	stats.meters = &m;
+	stats.num_meters = 1;
+	stats.readings = g_array_new(FALSE, FALSE, sizeof(struct reading));
+	sdis = g_slist_append(NULL, sdi);
+	run_acquisition(sdis, &stats);
+	g_slist_free(sdis);
+
+	check_meters(&stats, 20);
+	fail_unless(stats.num_latencies == 20, "Latency of %" PRIu64
+		" packets measured.", stats.num_latencies);
+	for (i = 0; i < stats.readings->len; i++) {
+		fail_unless(g_array_index(stats.readings, struct reading, i).mq
+			== SR_MQ_VOLTAGE, "Packet %u isn't a voltage.", i);
+	}
+	g_array_free(stats.readings, TRUE);
+
+	srtest_serial_sim_free(sim);
+}
+END_TEST
+
+/*
+ * A meter sending as fast as it can, so one read holds many frames: none
+ * of them goes out past the sample limit.
+ */
+START_TEST(test_fs9721_limit)
+{
+	struct srtest_serial_sim *sim;
+	struct srtest_serial_sim_dev *dev;
+	struct sr_dev_inst *sdi;
+	struct feed_stats stats;
+	struct meter m;
+	GSList *sdis;
+
+	if (!srtest_serial_sim_active())
+		return;
+
+	sim = srtest_serial_sim_new();
+	dev = srtest_serial_sim_dev_add(sim, SRTEST_SERIAL_SIM_FS9721, 0);
+	sdi = open_device(driver_init("digitek-dt4000zc"), dev);
+	set_config(sdi, SR_CONF_LIMIT_SAMPLES, g_variant_new_uint64(5));
+
+	memset(&stats, 0, sizeof(stats));
+	meter_init(&m, sdi, dev);
+	stats.meters = &m;
+	stats.num_meters = 1;
+	sdis = g_slist_append(NULL, sdi);
+	run_acquisition(sdis, &stats);
+	g_slist_free(sdis);
+
+	check_meters(&stats, 5);
+
+	srtest_serial_sim_free(sim);
+}
+END_TEST
+
+/* A meter sending a frame for each request. */
+START_TEST(test_metex14)
+{
+	struct srtest_serial_sim *sim;
+	struct srtest_serial_sim_dev *dev;
+	struct sr_dev_inst *sdi;
+	struct feed_stats stats;
+	struct meter m;
+	GSList *sdis;
+
+	if (!srtest_serial_sim_active())
+		return;
+
+	sim = srtest_serial_sim_new();
+	dev = srtest_serial_sim_dev_add(sim, SRTEST_SERIAL_SIM_METEX14, 1200);
+	sdi = open_device(driver_init("metex-m3640d"), dev);
+	set_config(sdi, SR_CONF_LIMIT_SAMPLES, g_variant_new_uint64(10));
+
+	memset(&stats, 0, sizeof(stats));
+	meter_init(&m, sdi, dev);
+	stats.meters = &m;
+	stats.num_meters = 1;
+	sdis = g_slist_append(NULL, sdi);
+	run_acquisition(sdis, &stats);
+	g_slist_free(sdis);
+
+	check_meters(&stats, 10);
+
+	srtest_serial_sim_free(sim);
+}
+END_TEST
+
+/* Frames as recorded from a meter being switched between functions. */
+START_TEST(test_metex14_recorded)
+{
+	const char *frames = "AC  0.230   V\r" "OH  1.000KOhm\r"
+			"DC -0.012  mA\r";
+	const struct reading expected[] = {
+		{ SR_MQ_VOLTAGE, 0.230 },
+		{ SR_MQ_RESISTANCE, 1000 },
+		{ SR_MQ_CURRENT, -0.000012 },
+	};
+	struct srtest_serial_sim *sim;
+	struct srtest_serial_sim_dev *dev;
+	struct sr_dev_inst *sdi;
+	struct feed_stats stats;
+	struct reading *r;
+	GSList *sdis;
+	guint i, j;
+
+	if (!srtest_serial_sim_active())
+		return;
+
+	sim = srtest_serial_sim_new();
+	dev = srtest_serial_sim_dev_add(sim, SRTEST_SERIAL_SIM_METEX14, 0);
+	srtest_serial_sim_dev_set_frames(dev, (const uint8_t *)frames,
+			strlen(frames));
+	sdi = open_device(driver_init("metex-m3640d"), dev);
+	set_config(sdi, SR_CONF_LIMIT_SAMPLES, g_variant_new_uint64(9));
+
+	memset(&stats, 0, sizeof(stats));
+	stats.readings = g_array_new(FALSE, FALSE, sizeof(struct reading));
+	sdis = g_slist_append(NULL, sdi);
+	run_acquisition(sdis, &stats);
+	g_slist_free(sdis);
+
+	fail_unless(stats.readings->len == 9, "Got %u packets.",
+		stats.readings->len);
+	/* The recording goes round; the scan used up some of it. */
+	r = &g_array_index(stats.readings, struct reading, 0);
+	for (j = 0; j < G_N_ELEMENTS(expected); j++) {
+		if (r->mq == expected[j].mq)
+			break;
+	}
+	fail_unless(j < G_N_ELEMENTS(expected), "Unexpected mq %d.", r->mq);
+	for (i = 0; i < stats.readings->len; i++, j++) {
+		r = &g_array_index(stats.readings, struct reading, i);
+		fail_unless(r->mq == expected[j % 3].mq,
+			"Packet %u: mq %d, expected %d.", i, r->mq,
+			expected[j % 3].mq);
+		fail_unless(fabs(r->value - expected[j % 3].value) <=
+			fabs(expected[j % 3].value) * 1e-4,
+			"Packet %u: value %g, expected %g.", i, r->value,
+			expected[j % 3].value);
+	}
+	g_array_free(stats.readings, TRUE);
+
+	srtest_serial_sim_free(sim);
+}
+END_TEST
+
+/*
+ * Dozens of meters on one session: the streaming ones all at 2400 baud,
+ * the polled ones at 1200. This takes a while, so it only runs when
+ * LIBSIGROK_TEST_BENCHMARKS is set.
+ */
+START_TEST(test_dmm_fleet)
+{
+	struct srtest_serial_sim *sim;
+	struct srtest_serial_sim_dev *dev;
+	struct sr_dev_inst *sdi;
+	struct feed_stats stats;
+	struct meter meters[FLEET_FS9721 + FLEET_METEX14];
+	struct sr_dev_driver *fs9721, *metex14;
+	GSList *sdis;
+	char name[64];
+	int i;
+
+	if (!srtest_serial_sim_active())
+		return;
+	if (!g_getenv("LIBSIGROK_TEST_BENCHMARKS"))
+		return;
+
+	fs9721 = driver_init("digitek-dt4000zc");
+	metex14 = driver_init("metex-m3640d");
+	sim = srtest_serial_sim_new();
+	sdis = NULL;
+	for (i = 0; i < FLEET_FS9721 + FLEET_METEX14; i++) {
+		if (i < FLEET_FS9721) {
+			dev = srtest_serial_sim_dev_add(sim,
+					SRTEST_SERIAL_SIM_FS9721, 2400);
+			sdi = open_device(fs9721, dev);
+		} else {
+			dev = srtest_serial_sim_dev_add(sim,
+					SRTEST_SERIAL_SIM_METEX14, 1200);
+			sdi = open_device(metex14, dev);
+		}
+		set_config(sdi, SR_CONF_LIMIT_SAMPLES,
+				g_variant_new_uint64(FLEET_SAMPLES));
+		meter_init(&meters[i], sdi, dev);
+		sdis = g_slist_append(sdis, sdi);
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	stats.meters = meters;
+	stats.num_meters = FLEET_FS9721 + FLEET_METEX14;
+	snprintf(name, sizeof(name), "fleet of %d fs9721 + %d metex14",
+		FLEET_FS9721, FLEET_METEX14);
+	run_acquisition(sdis, &stats);
+	g_slist_free(sdis);
+
+	check_meters(&stats, FLEET_SAMPLES);
+	report(name, &stats);
+
+	srtest_serial_sim_free(sim);
+}
+END_TEST
+#endif
+
+#ifdef HAVE_HW_KORAD_KAXXXXP
+START_TEST(test_korad)
+{
+	struct srtest_serial_sim *sim;
+	struct srtest_serial_sim_dev *dev;
+	struct sr_dev_inst *sdi;
+	struct feed_stats stats;
+	struct reading *r;
+	GSList *sdis;
+	guint i, num_voltages;
+
+	if (!srtest_serial_sim_active())
+		return;
+
+	sim = srtest_serial_sim_new();
+	dev = srtest_serial_sim_dev_add(sim, SRTEST_SERIAL_SIM_KORAD, 9600);
+	sdi = open_device(driver_init("korad-kaxxxxp"), dev);
+	set_config(sdi, SR_CONF_VOLTAGE_TARGET, g_variant_new_double(5.0));
+	set_config(sdi, SR_CONF_ENABLED, g_variant_new_boolean(TRUE));
+	set_config(sdi, SR_CONF_LIMIT_SAMPLES, g_variant_new_uint64(3));
+
+	memset(&stats, 0, sizeof(stats));
+	stats.readings = g_array_new(FALSE, FALSE, sizeof(struct reading));
+	sdis = g_slist_append(NULL, sdi);
+	run_acquisition(sdis, &stats);
+	g_slist_free(sdis);
+
+	num_voltages = 0;
+	for (i = 0; i < stats.readings->len; i++) {
+		r = &g_array_index(stats.readings, struct reading, i);
+		if (r->mq != SR_MQ_VOLTAGE)
+			continue;
+		fail_unless(fabs(r->value - 5.0) < 0.005,
+			"Voltage %g, expected 5.0.", r->value);
+		num_voltages++;
+	}
+	fail_unless(num_voltages == 3, "Got %u voltages.", num_voltages);
+	g_array_free(stats.readings, TRUE);
+
+	srtest_serial_sim_free(sim);
+}
+END_TEST
+#endif
+
+#ifdef HAVE_HW_MANSON_HCS_3XXX
+START_TEST(test_manson)
+{
+	struct srtest_serial_sim *sim;
+	struct srtest_serial_sim_dev *dev;
+	struct sr_dev_inst *sdi;
+	struct feed_stats stats;
+	struct reading *r;
+	GSList *sdis;
+	guint i;
+
+	if (!srtest_serial_sim_active())
+		return;
+
+	sim = srtest_serial_sim_new();
+	dev = srtest_serial_sim_dev_add(sim, SRTEST_SERIAL_SIM_MANSON, 9600);
+	sdi = open_device(driver_init("manson-hcs-3xxx"), dev);
+	set_config(sdi, SR_CONF_VOLTAGE_TARGET, g_variant_new_double(5.0));
+	set_config(sdi, SR_CONF_LIMIT_SAMPLES, g_variant_new_uint64(20));
+
+	memset(&stats, 0, sizeof(stats));
+	stats.readings = g_array_new(FALSE, FALSE, sizeof(struct reading));
+	sdis = g_slist_append(NULL, sdi);
+	run_acquisition(sdis, &stats);
+	g_slist_free(sdis);
+
+	/* A voltage and a current packet per sample. */
+	fail_unless(stats.readings->len == 40, "Got %u packets.",
+		stats.readings->len);
+	for (i = 0; i < stats.readings->len; i++) {
+		r = &g_array_index(stats.readings, struct reading, i);
+		if (r->mq == SR_MQ_VOLTAGE)
+			fail_unless(fabs(r->value - 5.0) < 0.005,
+				"Voltage %g, expected 5.0.", r->value);
+		else
+			fail_unless(fabs(r->value - 0.5) < 0.005,
+				"Current %g, expected 0.5.", r->value);
+	}
+	g_array_free(stats.readings, TRUE);
+
+	srtest_serial_sim_free(sim);
+}
+END_TEST
+#endif
+
+#ifdef HAVE_DIGITS_CASES
+static void replay_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct feed_stats *stats;
+	const struct sr_datafeed_analog *analog;
+
+	(void)sdi;
+
+	stats = cb_data;
+	if (packet->type != SR_DF_ANALOG)
+		return;
+
+	analog = packet->payload;
+	stats->num_packets++;
+	if (!analog->encoding->is_digits_decimal ||
+			analog->encoding->digits != stats->digits)
+		stats->digits_wrong++;
+}
+
+/*
+ * Each driver family's readings keep their decimals through the csv and
+ * srzip outputs, and when the srzip file is loaded again.
+ * Note: _i is the loop variable from tcase_add_loop_test().
+ */
+START_TEST(test_digits)
+{
+	const struct digits_case *c;
+	struct srtest_serial_sim *sim;
+	struct srtest_serial_sim_dev *dev;
+	struct sr_dev_inst *sdi;
+	struct sr_session *sess;
+	struct feed_stats stats;
+	GSList *sdis;
+	gchar *dir, *filename;
+	int digits, ret;
+
+	if (!srtest_serial_sim_active())
+		return;
+
+	c = &digits_cases[_i];
+	dir = g_dir_make_tmp("sigrok-test-XXXXXX", NULL);
+	fail_unless(dir != NULL, "Failed to create temporary directory.");
+	filename = g_build_filename(dir, "digits.sr", NULL);
+
+	sim = srtest_serial_sim_new();
+	dev = srtest_serial_sim_dev_add(sim, c->type, c->baudrate);
+	sdi = open_device(driver_init(c->driver), dev);
+	if (c->voltage > 0)
+		set_config(sdi, SR_CONF_VOLTAGE_TARGET,
+				g_variant_new_double(c->voltage));
+	if (c->enable)
+		set_config(sdi, SR_CONF_ENABLED, g_variant_new_boolean(TRUE));
+	set_config(sdi, SR_CONF_LIMIT_SAMPLES, g_variant_new_uint64(5));
+
+	memset(&stats, 0, sizeof(stats));
+	stats.csv = sr_output_new(sr_output_find("csv"), NULL, sdi, NULL);
+	stats.srzip = sr_output_new(sr_output_find("srzip"), NULL, sdi,
+			filename);
+	fail_unless(stats.csv && stats.srzip, "Failed to create outputs.");
+	stats.digits_mq = SR_MQ_VOLTAGE;
+	stats.digits = c->digits;
+	sdis = g_slist_append(NULL, sdi);
+	run_acquisition(sdis, &stats);
+	g_slist_free(sdis);
+	sr_output_free(stats.csv);
+	sr_output_free(stats.srzip);
+	srtest_serial_sim_free(sim);
+
+	fail_unless(stats.num_packets > 0, "%s: no readings.", c->name);
+	fail_unless(stats.digits_wrong == 0, "%s: %" PRIu64 " csv rows "
+		"without %d decimals.", c->name, stats.digits_wrong, c->digits);
+
+	/* srzip records the digits of the last reading of each channel. */
+	digits = stats.last_digits;
+	memset(&stats, 0, sizeof(stats));
+	stats.digits = digits;
+	ret = sr_session_load(srtest_ctx, filename, &sess);
+	fail_unless(ret == SR_OK, "sr_session_load() failed: %d.", ret);
+	sr_session_datafeed_callback_add(sess, replay_in, &stats);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	sr_session_destroy(sess);
+
+	fail_unless(stats.num_packets > 0, "%s: nothing loaded.", c->name);
+	fail_unless(stats.digits_wrong == 0, "%s: %" PRIu64 " packets "
+		"loaded without their digits.", c->name, stats.digits_wrong);
+
+	g_unlink(filename);
+	g_free(filename);
+	g_rmdir(dir);
+	g_free(dir);
+}
+END_TEST
+#endif
+
+Suite *suite_driver_serial(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("driver-serial");
+
+	tc = tcase_create("sim");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 30);
+#ifdef HAVE_HW_SERIAL_DMM
+	tcase_add_test(tc, test_fs9721);
+	tcase_add_test(tc, test_fs9721_limit);
+	tcase_add_test(tc, test_metex14);
+	tcase_add_test(tc, test_metex14_recorded);
+#endif
+#ifdef HAVE_HW_KORAD_KAXXXXP
+	tcase_add_test(tc, test_korad);
+#endif
+#ifdef HAVE_HW_MANSON_HCS_3XXX
+	tcase_add_test(tc, test_manson);
+#endif
+#ifdef HAVE_DIGITS_CASES
+	tcase_add_loop_test(tc, test_digits, 0, ARRAY_SIZE(digits_cases));
+#endif
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("sim_benchmark");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 120);
+#ifdef HAVE_HW_SERIAL_DMM
+	tcase_add_test(tc, test_dmm_fleet);
+#endif
+	suite_add_tcase(s, tc);
+
+	return s;
+}
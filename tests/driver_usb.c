@@ -0,0 +1,1094 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <glib/gstdio.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+#include "usb_replay.h"
+
+/* Size of the synthetic firmware served to the drivers. */
+#define FIRMWARE_SIZE 12345
+
+/*
+ * Size of one bulk record in the benchmark captures. Records are multiples
+ * of 256 bytes, so the byte counter pattern runs on across them.
+ */
+#define PATTERN_SIZE (1024 * 1024)
+
+#define VENDOR_IN 0xc0
+
+/*
+ * saleae-logic16 and asix-sigma aren't covered. The Logic16 answers an
+ * encrypted handshake on EP1 at open, which can't be synthesized here
+ * without a capture of a real device. asix-sigma talks to its FTDI chip
+ * through libftdi, which the replay doesn't stand in for.
+ */
+
+#define FX2LAFW_BENCH_SAMPLES (128 * 1024 * 1024)
+#define TRIGGER_BENCH_RECORDS 32
+#define HANTEK_BENCH_SAMPLES (4 * 1000 * 1000)
+#define HANTEK_BENCH_ROUNDS 8
+
+struct feed_stats {
+	int num_ends;
+	uint64_t logic_bytes;
+	uint64_t analog_samples;
+	/* Offset of the next logic byte in the bulk IN stream. */
+	uint64_t stream_pos;
+	gboolean pattern_ok;
+};
+
+static int firmware_open(struct sr_resource *res, const char *name,
+		void *cb_data)
+{
+	(void)name;
+	(void)cb_data;
+
+	res->size = FIRMWARE_SIZE;
+	res->handle = g_malloc0(sizeof(uint64_t));
+
+	return SR_OK;
+}
+
+static int firmware_close(struct sr_resource *res, void *cb_data)
+{
+	(void)cb_data;
+
+	g_free(res->handle);
+	res->handle = NULL;
+
+	return SR_OK;
+}
+
+static gssize firmware_read(const struct sr_resource *res, void *buf,
+		size_t count, void *cb_data)
+{
+	uint64_t *pos;
+	size_t i;
+
+	(void)cb_data;
+
+	pos = res->handle;
+	count = MIN(count, res->size - *pos);
+	for (i = 0; i < count; i++)
+		((uint8_t *)buf)[i] = (*pos + i) * 7;
+	*pos += count;
+
+	return count;
+}
+
+static uint8_t *pattern_new(size_t size)
+{
+	uint8_t *buf;
+	size_t i;
+
+	buf = g_malloc(size);
+	for (i = 0; i < size; i++)
+		buf[i] = i & 0xff;
+
+	return buf;
+}
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct feed_stats *stats;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	const uint8_t *data;
+
+	(void)sdi;
+
+	stats = cb_data;
+
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		data = logic->data;
+		/* The stream is a byte counter; check both ends of the packet. */
+		if (logic->length > 0 && (data[0] != (stats->stream_pos & 0xff)
+				|| data[logic->length - 1] !=
+				((stats->stream_pos + logic->length - 1) & 0xff)))
+			stats->pattern_ok = FALSE;
+		stats->stream_pos += logic->length;
+		stats->logic_bytes += logic->length;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		stats->analog_samples += analog->num_samples;
+		break;
+	case SR_DF_END:
+		stats->num_ends++;
+		break;
+	}
+}
+
+static void run_session(struct sr_dev_inst *sdi, struct sr_trigger *trigger,
+		sr_datafeed_callback cb, void *cb_data)
+{
+	struct sr_session *sess;
+	int ret;
+
+	ret = sr_session_new(srtest_ctx, &sess);
+	fail_unless(ret == SR_OK, "sr_session_new() failed: %d.", ret);
+	sr_session_dev_add(sess, sdi);
+	sr_session_trigger_set(sess, trigger);
+	sr_session_datafeed_callback_add(sess, cb, cb_data);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	sr_session_destroy(sess);
+}
+
+static void run_acquisition(struct sr_dev_inst *sdi, struct feed_stats *stats)
+{
+	run_session(sdi, NULL, datafeed_in, stats);
+}
+
+/* Scan for the one device in the loaded capture, and open it. */
+static struct sr_dev_inst *open_device(const char *drivername)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	GSList *devices;
+	int ret;
+
+	driver = srtest_driver_get(drivername);
+	srtest_driver_init(srtest_ctx, driver);
+	sr_resource_set_hooks(srtest_ctx, firmware_open, firmware_close,
+			firmware_read, NULL);
+
+	devices = sr_driver_scan(driver, NULL);
+	fail_unless(g_slist_length(devices) == 1,
+		"Expected one device, found %u.", g_slist_length(devices));
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	fail_unless(srtest_usb_replay_firmware_size() == FIRMWARE_SIZE,
+		"Uploaded %" PRIu64 " bytes of firmware.",
+		srtest_usb_replay_firmware_size());
+
+	ret = sr_dev_open(sdi);
+	fail_unless(ret == SR_OK, "Failed to open device: %d.", ret);
+
+	return sdi;
+}
+
+static void set_uint64(const struct sr_dev_inst *sdi, uint32_t key,
+		uint64_t value)
+{
+	int ret;
+
+	ret = sr_config_set(sdi, NULL, key, g_variant_new_uint64(value));
+	fail_unless(ret == SR_OK, "Failed to set config key %u: %d.", key, ret);
+}
+
+/*
+ * Only the benchmarks report, and they only run on request. The figures
+ * go to stderr, apart from the test results.
+ */
+static void report(const char *name, uint64_t num_bytes, uint64_t num_samples,
+		int64_t wall_us, clock_t cpu)
+{
+	double cpu_ns;
+
+	cpu_ns = (double)cpu * 1e9 / CLOCKS_PER_SEC;
+	fprintf(stderr,
+		"%s: %" PRIu64 " samples, %.1f MB/s, %.2f ns CPU per sample.\n",
+		name, num_samples, (double)num_bytes / MAX(wall_us, 1),
+		cpu_ns / MAX(num_samples, 1));
+}
+
+#ifdef HAVE_HW_FX2LAFW
+/* A Cypress FX2 which takes the fx2lafw firmware, without any samples yet. */
+static struct srtest_usb_capture *fx2lafw_capture_new(void)
+{
+	struct srtest_usb_capture *cap;
+	const uint8_t version[] = { 1, 4 };
+	const uint8_t revid = 1;
+
+	cap = srtest_usb_capture_new();
+	srtest_usb_capture_device(cap, 0x04b4, 0x8613, NULL, NULL, NULL);
+	srtest_usb_capture_renumerate(cap, 0x04b4, 0x8613,
+			"sigrok", "fx2lafw", NULL);
+	srtest_usb_capture_control(cap, 0, VENDOR_IN, 0xb0, 0, 0,
+			version, sizeof(version));
+	srtest_usb_capture_control(cap, 0, VENDOR_IN, 0xb2, 0, 0, &revid, 1);
+
+	return cap;
+}
+
+static void fx2lafw_load(int num_records, uint32_t record_size,
+		uint64_t interval_us, int flags)
+{
+	struct srtest_usb_capture *cap;
+	uint8_t *pattern;
+	char *path;
+	int i;
+
+	cap = fx2lafw_capture_new();
+	pattern = pattern_new(record_size);
+	for (i = 0; i < num_records; i++)
+		srtest_usb_capture_bulk(cap, (i + 1) * interval_us, 0x82,
+				pattern, record_size);
+	g_free(pattern);
+
+	path = srtest_usb_capture_save(cap);
+	srtest_usb_capture_free(cap);
+	srtest_usb_replay_load(path, flags);
+	g_unlink(path);
+	g_free(path);
+}
+
+/*
+ * Replay 50 records of 10ms each, in real time. The acquisition has to
+ * take as long as the 400ms worth of samples it asks for, and get them
+ * all in the order they were captured.
+ */
+START_TEST(test_fx2lafw_throttled)
+{
+	struct sr_dev_inst *sdi;
+	struct feed_stats stats;
+	int64_t start;
+
+	if (!srtest_usb_replay_active())
+		return;
+
+	/* 16 channels at 1MHz is 20000 bytes per 10ms; round up to 256. */
+	fx2lafw_load(50, 20480, 10000, SRTEST_USB_REPLAY_THROTTLE);
+	sdi = open_device("fx2lafw");
+	set_uint64(sdi, SR_CONF_SAMPLERATE, SR_MHZ(1));
+	set_uint64(sdi, SR_CONF_LIMIT_SAMPLES, 400000);
+
+	memset(&stats, 0, sizeof(stats));
+	stats.pattern_ok = TRUE;
+	start = g_get_monotonic_time();
+	run_acquisition(sdi, &stats);
+	start = g_get_monotonic_time() - start;
+
+	fail_unless(stats.num_ends == 1, "Got %d ends.", stats.num_ends);
+	fail_unless(stats.logic_bytes == 400000 * 2,
+		"Got %" PRIu64 " logic bytes.", stats.logic_bytes);
+	fail_unless(stats.pattern_ok, "Logic data out of order.");
+	fail_unless(start >= 350 * 1000,
+		"Acquisition took only %" PRIi64 "us.", start);
+
+	sr_dev_close(sdi);
+	srtest_usb_replay_unload();
+}
+END_TEST
+
+START_TEST(test_fx2lafw_benchmark)
+{
+	struct sr_dev_inst *sdi;
+	struct feed_stats stats;
+	int64_t start;
+	clock_t cpu;
+
+	if (!srtest_usb_replay_active())
+		return;
+	/* 128M samples take a while, so this only runs on request. */
+	if (!g_getenv("LIBSIGROK_TEST_BENCHMARKS"))
+		return;
+
+	fx2lafw_load(1, PATTERN_SIZE, 0, SRTEST_USB_REPLAY_LOOP);
+	sdi = open_device("fx2lafw");
+	/* The fastest rate the FX2 manages with all 16 channels. */
+	set_uint64(sdi, SR_CONF_SAMPLERATE, SR_MHZ(12));
+	set_uint64(sdi, SR_CONF_LIMIT_SAMPLES, FX2LAFW_BENCH_SAMPLES);
+
+	memset(&stats, 0, sizeof(stats));
+	stats.pattern_ok = TRUE;
+	start = g_get_monotonic_time();
+	cpu = clock();
+	run_acquisition(sdi, &stats);
+	cpu = clock() - cpu;
+	start = g_get_monotonic_time() - start;
+
+	fail_unless(stats.logic_bytes == (uint64_t)FX2LAFW_BENCH_SAMPLES * 2,
+		"Got %" PRIu64 " logic bytes.", stats.logic_bytes);
+	fail_unless(stats.pattern_ok, "Logic data out of order.");
+	report("fx2lafw", stats.logic_bytes, stats.logic_bytes / 2, start, cpu);
+
+	sr_dev_close(sdi);
+	srtest_usb_replay_unload();
+}
+END_TEST
+
+/* Logic channels carrying the protocol trigger test signals. */
+enum {
+	LINE_UART,
+	LINE_SCK,
+	LINE_MOSI,
+	LINE_CS,
+	LINE_SCL,
+	LINE_SDA,
+	LINE_EDGE,
+};
+
+/* 16 channel logic samples, built up one signal change at a time. */
+struct wave {
+	GByteArray *samples;
+	uint16_t level;
+	/* UART bit period in 1/256 samples. */
+	uint64_t period;
+};
+
+struct trigger_stats {
+	int num_triggers;
+	int num_ends;
+	/* All logic data, and how much of it came before the trigger. */
+	GByteArray *logic;
+	unsigned int trigger_pos;
+};
+
+static void wave_init(struct wave *w, uint64_t samplerate, uint64_t baudrate)
+{
+	w->samples = g_byte_array_new();
+	w->level = (1 << LINE_UART) | (1 << LINE_CS) | (1 << LINE_SCL)
+		| (1 << LINE_SDA);
+	w->period = samplerate * 256 / baudrate;
+}
+
+static unsigned int wave_pos(const struct wave *w)
+{
+	return w->samples->len / 2;
+}
+
+static void wave_set(struct wave *w, int line, gboolean high)
+{
+	if (high)
+		w->level |= 1 << line;
+	else
+		w->level &= ~(1 << line);
+}
+
+static void wave_hold(struct wave *w, unsigned int num_samples)
+{
+	uint8_t sample[2];
+
+	sample[0] = w->level & 0xff;
+	sample[1] = w->level >> 8;
+	while (num_samples--)
+		g_byte_array_append(w->samples, sample, 2);
+}
+
+/* An 8N1 UART frame: start bit, data bits LSB first, stop bit. */
+static void wave_uart(struct wave *w, uint8_t byte)
+{
+	uint64_t start;
+	int i;
+
+	start = (uint64_t)wave_pos(w) * 256;
+	for (i = 0; i < 10; i++) {
+		wave_set(w, LINE_UART, i == 9 || (i > 0 && (byte >> (i - 1)) & 1));
+		wave_hold(w, (start + (i + 1) * w->period + 128) / 256
+				- wave_pos(w));
+	}
+}
+
+/* A mode 0 SPI byte, MSB first, with the chip selected around it. */
+static void wave_spi(struct wave *w, uint8_t byte)
+{
+	int i;
+
+	wave_set(w, LINE_CS, FALSE);
+	wave_hold(w, 2);
+	for (i = 7; i >= 0; i--) {
+		wave_set(w, LINE_MOSI, (byte >> i) & 1);
+		wave_hold(w, 2);
+		wave_set(w, LINE_SCK, TRUE);
+		wave_hold(w, 2);
+		wave_set(w, LINE_SCK, FALSE);
+	}
+	wave_hold(w, 2);
+	wave_set(w, LINE_CS, TRUE);
+	wave_hold(w, 2);
+}
+
+static void wave_i2c_byte(struct wave *w, uint8_t byte)
+{
+	int i;
+
+	/* Eight bits MSB first, then the ACK. */
+	for (i = 8; i >= 0; i--) {
+		wave_set(w, LINE_SDA, i > 0 && (byte >> (i - 1)) & 1);
+		wave_hold(w, 2);
+		wave_set(w, LINE_SCL, TRUE);
+		wave_hold(w, 2);
+		wave_set(w, LINE_SCL, FALSE);
+	}
+}
+
+/* An I2C transfer of a single data byte, from START to STOP. */
+static void wave_i2c(struct wave *w, uint8_t addr, gboolean read, uint8_t data)
+{
+	wave_set(w, LINE_SDA, FALSE);
+	wave_hold(w, 2);
+	wave_set(w, LINE_SCL, FALSE);
+	wave_i2c_byte(w, (addr << 1) | read);
+	wave_i2c_byte(w, data);
+	wave_set(w, LINE_SDA, FALSE);
+	wave_hold(w, 2);
+	wave_set(w, LINE_SCL, TRUE);
+	wave_hold(w, 2);
+	wave_set(w, LINE_SDA, TRUE);
+	wave_hold(w, 2);
+}
+
+static void trigger_feed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct trigger_stats *stats;
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+
+	stats = cb_data;
+
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		g_byte_array_append(stats->logic, logic->data, logic->length);
+		break;
+	case SR_DF_TRIGGER:
+		if (!stats->num_triggers++)
+			stats->trigger_pos = stats->logic->len / 2;
+		break;
+	case SR_DF_END:
+		stats->num_ends++;
+		break;
+	}
+}
+
+static struct sr_channel *channel_get(const struct sr_dev_inst *sdi, int line)
+{
+	return g_slist_nth_data(sr_dev_inst_channels_get(sdi), line);
+}
+
+/* Open the device to acquire the samples loaded, all of them kept. */
+static struct sr_dev_inst *trigger_device_open(const struct wave *w)
+{
+	struct sr_dev_inst *sdi;
+
+	sdi = open_device("fx2lafw");
+	set_uint64(sdi, SR_CONF_SAMPLERATE, SR_MHZ(1));
+	/* Enough pre-trigger samples for all of the signal. */
+	set_uint64(sdi, SR_CONF_LIMIT_SAMPLES, wave_pos(w) * 4);
+	set_uint64(sdi, SR_CONF_CAPTURE_RATIO, 50);
+
+	return sdi;
+}
+
+/*
+ * Acquire the samples loaded, and check the trigger fired once, between
+ * match_start and match_end. If they are equal, check it didn't fire.
+ * Frees the trigger, and closes the device.
+ */
+static void trigger_device_run(struct sr_dev_inst *sdi,
+		struct sr_trigger *trigger, const struct wave *w,
+		unsigned int match_start, unsigned int match_end)
+{
+	struct trigger_stats stats;
+
+	memset(&stats, 0, sizeof(stats));
+	stats.logic = g_byte_array_new();
+	run_session(sdi, trigger, trigger_feed_in, &stats);
+
+	fail_unless(stats.num_ends == 1, "Got %d ends.", stats.num_ends);
+	if (match_start == match_end) {
+		fail_unless(stats.num_triggers == 0 && stats.logic->len == 0,
+			"Triggered at sample %u, expected no trigger.",
+			stats.trigger_pos);
+	} else {
+		fail_unless(stats.num_triggers == 1,
+			"Got %d triggers.", stats.num_triggers);
+		fail_unless(stats.trigger_pos >= match_start
+			&& stats.trigger_pos < match_end,
+			"Triggered at sample %u, not in %u-%u.",
+			stats.trigger_pos, match_start, match_end);
+		/* Everything from the start is kept as pre-trigger samples. */
+		fail_unless(stats.logic->len == w->samples->len
+			&& !memcmp(stats.logic->data, w->samples->data,
+			w->samples->len),
+			"Logic data differs from what was captured.");
+	}
+
+	g_byte_array_free(stats.logic, TRUE);
+	sr_trigger_free(trigger);
+	sr_dev_close(sdi);
+}
+
+/*
+ * Acquire the samples loaded, with the trigger on a protocol match. The
+ * clock and select lines are -1 if the protocol has none.
+ */
+static void protocol_trigger_run(const struct wave *w, int trigger_match,
+		struct sr_trigger_protocol *protocol, int data_line,
+		int clock_line, int select_line,
+		unsigned int match_start, unsigned int match_end)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	int ret;
+
+	sdi = trigger_device_open(w);
+	if (clock_line >= 0)
+		protocol->clock = channel_get(sdi, clock_line);
+	if (select_line >= 0)
+		protocol->select = channel_get(sdi, select_line);
+	trigger = sr_trigger_new(NULL);
+	stage = sr_trigger_stage_add(trigger);
+	ret = sr_trigger_protocol_match_add(stage, channel_get(sdi, data_line),
+			trigger_match, protocol);
+	fail_unless(ret == SR_OK, "Failed to add trigger match: %d.", ret);
+
+	trigger_device_run(sdi, trigger, w, match_start, match_end);
+}
+
+/*
+ * Each protocol's frame matched comes after one which doesn't match, and
+ * with the other protocols' traffic around it. The signal spans several
+ * USB transfers, so frames are split across the buffers checked.
+ */
+START_TEST(test_fx2lafw_protocol_trigger)
+{
+	struct srtest_usb_capture *cap;
+	struct sr_trigger_protocol protocol;
+	struct wave w;
+	unsigned int uart[2], spi[2], i2c[2];
+	char *path;
+
+	if (!srtest_usb_replay_active())
+		return;
+
+	wave_init(&w, SR_MHZ(1), 115200);
+	wave_hold(&w, 1000);
+	wave_uart(&w, 0x41);
+	wave_hold(&w, 5000);
+	wave_spi(&w, 0x12);
+	wave_hold(&w, 5000);
+	wave_i2c(&w, 0x51, TRUE, 0x99);
+	wave_hold(&w, 5000);
+	uart[0] = wave_pos(&w);
+	wave_uart(&w, 0xa5);
+	uart[1] = wave_pos(&w);
+	wave_hold(&w, 5000);
+	spi[0] = wave_pos(&w);
+	wave_spi(&w, 0x5a);
+	spi[1] = wave_pos(&w);
+	wave_hold(&w, 5000);
+	i2c[0] = wave_pos(&w);
+	wave_i2c(&w, 0x50, TRUE, 0x99);
+	i2c[1] = wave_pos(&w);
+	wave_hold(&w, 1000);
+
+	cap = fx2lafw_capture_new();
+	srtest_usb_capture_bulk(cap, 0, 0x82, w.samples->data, w.samples->len);
+	path = srtest_usb_capture_save(cap);
+	srtest_usb_capture_free(cap);
+
+	srtest_usb_replay_load(path, 0);
+	memset(&protocol, 0, sizeof(protocol));
+	protocol.baudrate = 115200;
+	protocol.value = 0xa5;
+	protocol.mask = 0xff;
+	protocol_trigger_run(&w, SR_TRIGGER_UART, &protocol, LINE_UART, -1, -1,
+			uart[0], uart[1]);
+	srtest_usb_replay_unload();
+
+	srtest_usb_replay_load(path, 0);
+	memset(&protocol, 0, sizeof(protocol));
+	protocol.value = 0x5a;
+	protocol.mask = 0xff;
+	protocol_trigger_run(&w, SR_TRIGGER_SPI, &protocol, LINE_MOSI,
+			LINE_SCK, LINE_CS, spi[0], spi[1]);
+	srtest_usb_replay_unload();
+
+	srtest_usb_replay_load(path, 0);
+	memset(&protocol, 0, sizeof(protocol));
+	protocol.flags = SR_TRIGGER_I2C_READ;
+	protocol.value = 0x50;
+	protocol.mask = 0x7f;
+	protocol_trigger_run(&w, SR_TRIGGER_I2C, &protocol, LINE_SDA,
+			LINE_SCL, -1, i2c[0], i2c[1]);
+	srtest_usb_replay_unload();
+
+	g_unlink(path);
+	g_free(path);
+	g_byte_array_free(w.samples, TRUE);
+}
+END_TEST
+
+/*
+ * Acquire the samples loaded, with the trigger on a pulse width or timeout
+ * match on the edge line. It must fire on sample match_at, or not at all
+ * if that is -1.
+ */
+static void condition_trigger_run(const char *path, const struct wave *w,
+		int trigger_match, uint32_t flags, uint64_t min, uint64_t max,
+		int match_at)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct sr_trigger_condition condition;
+	int ret;
+
+	srtest_usb_replay_load(path, 0);
+	sdi = trigger_device_open(w);
+	memset(&condition, 0, sizeof(condition));
+	condition.flags = flags;
+	condition.min = min;
+	condition.max = max;
+	trigger = sr_trigger_new(NULL);
+	stage = sr_trigger_stage_add(trigger);
+	ret = sr_trigger_condition_match_add(stage, channel_get(sdi, LINE_EDGE),
+			trigger_match, &condition);
+	fail_unless(ret == SR_OK, "Failed to add trigger match: %d.", ret);
+
+	if (match_at < 0)
+		trigger_device_run(sdi, trigger, w, 0, 0);
+	else
+		trigger_device_run(sdi, trigger, w, match_at, match_at + 1);
+	srtest_usb_replay_unload();
+}
+
+/*
+ * High pulses of 3, 8 and 40 samples, with lows of 10 and 20 samples
+ * between them, 5000 before and 6000 after. Pulse matches fire on the
+ * edge which ends the pulse, timeouts on the sample which reaches the
+ * time.
+ */
+START_TEST(test_fx2lafw_condition_trigger)
+{
+	struct srtest_usb_capture *cap;
+	struct wave w;
+	unsigned int short_end, mid_end, long_start, long_end;
+	char *path;
+
+	if (!srtest_usb_replay_active())
+		return;
+
+	wave_init(&w, SR_MHZ(1), 115200);
+	wave_hold(&w, 5000);
+	wave_set(&w, LINE_EDGE, TRUE);
+	wave_hold(&w, 3);
+	wave_set(&w, LINE_EDGE, FALSE);
+	short_end = wave_pos(&w);
+	wave_hold(&w, 10);
+	wave_set(&w, LINE_EDGE, TRUE);
+	wave_hold(&w, 8);
+	wave_set(&w, LINE_EDGE, FALSE);
+	mid_end = wave_pos(&w);
+	wave_hold(&w, 20);
+	wave_set(&w, LINE_EDGE, TRUE);
+	long_start = wave_pos(&w);
+	wave_hold(&w, 40);
+	wave_set(&w, LINE_EDGE, FALSE);
+	long_end = wave_pos(&w);
+	wave_hold(&w, 6000);
+
+	cap = fx2lafw_capture_new();
+	srtest_usb_capture_bulk(cap, 0, 0x82, w.samples->data, w.samples->len);
+	path = srtest_usb_capture_save(cap);
+	srtest_usb_capture_free(cap);
+
+	/* Shorter than, longer than, and within a range. */
+	condition_trigger_run(path, &w, SR_TRIGGER_PULSE,
+			SR_TRIGGER_POSITIVE, 0, 5, short_end);
+	condition_trigger_run(path, &w, SR_TRIGGER_PULSE,
+			SR_TRIGGER_POSITIVE, 20, 0, long_end);
+	condition_trigger_run(path, &w, SR_TRIGGER_PULSE,
+			SR_TRIGGER_POSITIVE, 6, 10, mid_end);
+	condition_trigger_run(path, &w, SR_TRIGGER_PULSE,
+			SR_TRIGGER_POSITIVE, 4, 7, -1);
+	/* Low pulses; the first one began before the acquisition. */
+	condition_trigger_run(path, &w, SR_TRIGGER_PULSE,
+			SR_TRIGGER_NEGATIVE, 15, 25, long_start);
+	condition_trigger_run(path, &w, SR_TRIGGER_PULSE,
+			SR_TRIGGER_NEGATIVE, 30, 0, -1);
+	/* 7.5-8.5 us at 1 MHz only takes 8 samples. */
+	condition_trigger_run(path, &w, SR_TRIGGER_PULSE,
+			SR_TRIGGER_NANOSECONDS, 7500, 8500, mid_end);
+	condition_trigger_run(path, &w, SR_TRIGGER_PULSE,
+			SR_TRIGGER_NANOSECONDS, 8100, 8900, -1);
+
+	condition_trigger_run(path, &w, SR_TRIGGER_TIMEOUT,
+			SR_TRIGGER_POSITIVE, 30, 0, long_start + 29);
+	condition_trigger_run(path, &w, SR_TRIGGER_TIMEOUT,
+			SR_TRIGGER_POSITIVE, 41, 0, -1);
+	condition_trigger_run(path, &w, SR_TRIGGER_TIMEOUT,
+			SR_TRIGGER_NEGATIVE | SR_TRIGGER_NANOSECONDS,
+			5001000, 0, long_end + 5000);
+	/* Either level, from the start of the acquisition. */
+	condition_trigger_run(path, &w, SR_TRIGGER_TIMEOUT, 0, 10, 0, 9);
+
+	g_unlink(path);
+	g_free(path);
+	g_byte_array_free(w.samples, TRUE);
+}
+END_TEST
+
+/* The benchmark's trigger, which only matches in the last record. */
+static void bench_match_add(struct sr_trigger_stage *stage,
+		const struct sr_dev_inst *sdi, int trigger_match)
+{
+	struct sr_trigger_protocol protocol;
+	int ret;
+
+	memset(&protocol, 0, sizeof(protocol));
+	protocol.mask = 0xff;
+	switch (trigger_match) {
+	case SR_TRIGGER_UART:
+		protocol.baudrate = SR_MHZ(1);
+		protocol.value = 0xa5;
+		ret = sr_trigger_protocol_match_add(stage,
+			channel_get(sdi, LINE_UART), trigger_match, &protocol);
+		break;
+	case SR_TRIGGER_SPI:
+		protocol.clock = channel_get(sdi, LINE_SCK);
+		protocol.select = channel_get(sdi, LINE_CS);
+		protocol.value = 0x5a;
+		ret = sr_trigger_protocol_match_add(stage,
+			channel_get(sdi, LINE_MOSI), trigger_match, &protocol);
+		break;
+	case SR_TRIGGER_I2C:
+		protocol.clock = channel_get(sdi, LINE_SCL);
+		protocol.value = 0x50;
+		ret = sr_trigger_protocol_match_add(stage,
+			channel_get(sdi, LINE_SDA), trigger_match, &protocol);
+		break;
+	default:
+		ret = sr_trigger_match_add(stage, channel_get(sdi, LINE_EDGE),
+			trigger_match, 0);
+		break;
+	}
+	fail_unless(ret == SR_OK, "Failed to add trigger match: %d.", ret);
+}
+
+/*
+ * The soft trigger checks every sample until it fires. Time acquisitions
+ * which trigger only after a long stream of UART, SPI and I2C traffic,
+ * on a plain edge and on each protocol.
+ */
+START_TEST(test_fx2lafw_trigger_benchmark)
+{
+	const int matches[] = {
+		SR_TRIGGER_RISING, SR_TRIGGER_UART, SR_TRIGGER_SPI, SR_TRIGGER_I2C,
+	};
+	const char *names[] = {
+		"edge trigger", "UART trigger", "SPI trigger", "I2C trigger",
+	};
+	struct srtest_usb_capture *cap;
+	struct sr_dev_inst *sdi;
+	struct sr_trigger *trigger;
+	struct trigger_stats stats;
+	struct wave busy, last;
+	uint64_t num_samples;
+	char *path;
+	int64_t start;
+	clock_t cpu;
+	unsigned int i;
+
+	if (!srtest_usb_replay_active())
+		return;
+	if (!g_getenv("LIBSIGROK_TEST_BENCHMARKS"))
+		return;
+
+	/* Traffic which doesn't match any of the triggers fills a record. */
+	wave_init(&busy, SR_MHZ(12), SR_MHZ(1));
+	while (wave_pos(&busy) < PATTERN_SIZE / 2 - 1000) {
+		wave_uart(&busy, 0x55);
+		wave_spi(&busy, 0x12);
+		wave_i2c(&busy, 0x51, FALSE, 0x99);
+	}
+	wave_hold(&busy, PATTERN_SIZE / 2 - wave_pos(&busy));
+	wave_init(&last, SR_MHZ(12), SR_MHZ(1));
+	wave_uart(&last, 0xa5);
+	wave_spi(&last, 0x5a);
+	wave_i2c(&last, 0x50, FALSE, 0x99);
+	wave_set(&last, LINE_EDGE, TRUE);
+	wave_hold(&last, 1000);
+
+	cap = fx2lafw_capture_new();
+	for (i = 0; i < TRIGGER_BENCH_RECORDS; i++)
+		srtest_usb_capture_bulk(cap, 0, 0x82, busy.samples->data,
+				busy.samples->len);
+	srtest_usb_capture_bulk(cap, 0, 0x82, last.samples->data,
+			last.samples->len);
+	path = srtest_usb_capture_save(cap);
+	srtest_usb_capture_free(cap);
+	num_samples = (uint64_t)TRIGGER_BENCH_RECORDS * PATTERN_SIZE / 2;
+
+	for (i = 0; i < G_N_ELEMENTS(matches); i++) {
+		srtest_usb_replay_load(path, 0);
+		sdi = open_device("fx2lafw");
+		set_uint64(sdi, SR_CONF_SAMPLERATE, SR_MHZ(12));
+		set_uint64(sdi, SR_CONF_LIMIT_SAMPLES, 1000);
+		trigger = sr_trigger_new(NULL);
+		bench_match_add(sr_trigger_stage_add(trigger), sdi, matches[i]);
+
+		memset(&stats, 0, sizeof(stats));
+		stats.logic = g_byte_array_new();
+		start = g_get_monotonic_time();
+		cpu = clock();
+		run_session(sdi, trigger, trigger_feed_in, &stats);
+		cpu = clock() - cpu;
+		start = g_get_monotonic_time() - start;
+
+		fail_unless(stats.num_triggers == 1, "%s fired %d times.",
+			names[i], stats.num_triggers);
+		fail_unless(stats.logic->len == 1000 * 2,
+			"Got %u logic bytes.", stats.logic->len);
+		report(names[i], num_samples * 2, num_samples, start, cpu);
+
+		g_byte_array_free(stats.logic, TRUE);
+		sr_trigger_free(trigger);
+		sr_dev_close(sdi);
+		srtest_usb_replay_unload();
+	}
+
+	g_unlink(path);
+	g_free(path);
+	g_byte_array_free(busy.samples, TRUE);
+	g_byte_array_free(last.samples, TRUE);
+}
+END_TEST
+#endif
+
+#ifdef HAVE_HW_FX2LAFW
+struct hotplug_stats {
+	int num_arrived;
+	int num_left;
+	unsigned int num_devices;
+	gboolean other_driver;
+};
+
+static void hotplug_in(const struct sr_hotplug_event *event, void *cb_data)
+{
+	struct hotplug_stats *stats;
+
+	stats = cb_data;
+
+	if (strcmp(event->driver->name, "fx2lafw"))
+		stats->other_driver = TRUE;
+	if (event->type == SR_HOTPLUG_ARRIVED) {
+		stats->num_arrived++;
+		stats->num_devices += g_slist_length(event->devices);
+	} else {
+		stats->num_left++;
+	}
+}
+
+static void hotplug_wait(int timeout_ms)
+{
+	int i, ret;
+
+	for (i = 0; i < 3; i++) {
+		ret = sr_hotplug_handle_events(srtest_ctx, timeout_ms);
+		fail_unless(ret == SR_OK, "Failed to handle events: %d.", ret);
+	}
+}
+
+static void hotplug_check(const struct hotplug_stats *stats,
+		int num_arrived, int num_left)
+{
+	fail_unless(stats->num_arrived == num_arrived
+		&& stats->num_left == num_left,
+		"Got %d arrivals and %d removals.", stats->num_arrived,
+		stats->num_left);
+	fail_unless(stats->num_devices == (unsigned int)num_arrived,
+		"Found %u devices.", stats->num_devices);
+	fail_unless(!stats->other_driver, "Reported for another driver.");
+}
+
+/*
+ * A cold FX2 next to a device no driver handles. The FX2 is reported
+ * once, and not again when it renumerates after its firmware upload.
+ * Unplugged and plugged in again, it's reported gone, then new.
+ */
+static void hotplug_run(int flags, int timeout_ms)
+{
+	struct srtest_usb_capture *cap;
+	struct hotplug_stats stats;
+	char *path;
+	int ret;
+
+	cap = srtest_usb_capture_new();
+	srtest_usb_capture_device(cap, 0x04b4, 0x8613, NULL, NULL, NULL);
+	srtest_usb_capture_renumerate(cap, 0x04b4, 0x8613,
+			"sigrok", "fx2lafw", NULL);
+	srtest_usb_capture_device(cap, 0x046d, 0xc52b,
+			"Logitech", "USB Receiver", NULL);
+	path = srtest_usb_capture_save(cap);
+	srtest_usb_capture_free(cap);
+	srtest_usb_replay_load(path, flags);
+	g_unlink(path);
+	g_free(path);
+	sr_resource_set_hooks(srtest_ctx, firmware_open, firmware_close,
+			firmware_read, NULL);
+
+	memset(&stats, 0, sizeof(stats));
+	ret = sr_hotplug_subscribe(srtest_ctx, hotplug_in, &stats);
+	fail_unless(ret == SR_OK, "Failed to subscribe: %d.", ret);
+
+	hotplug_wait(timeout_ms);
+	hotplug_check(&stats, 1, 0);
+	fail_unless(srtest_usb_replay_firmware_size() == FIRMWARE_SIZE,
+		"Uploaded %" PRIu64 " bytes of firmware.",
+		srtest_usb_replay_firmware_size());
+
+	srtest_usb_replay_unplug(0);
+	hotplug_wait(timeout_ms);
+	hotplug_check(&stats, 1, 1);
+
+	srtest_usb_replay_plug(0);
+	hotplug_wait(timeout_ms);
+	hotplug_check(&stats, 2, 1);
+
+	sr_hotplug_unsubscribe(srtest_ctx);
+	srtest_usb_replay_unload();
+}
+
+START_TEST(test_hotplug)
+{
+	if (!srtest_usb_replay_active())
+		return;
+
+	hotplug_run(0, 10);
+}
+END_TEST
+
+/* Where libusb has no hotplug support, the bus is polled. */
+START_TEST(test_hotplug_polled)
+{
+	if (!srtest_usb_replay_active())
+		return;
+
+	hotplug_run(SRTEST_USB_REPLAY_NO_HOTPLUG, 600);
+}
+END_TEST
+#endif
+
+#ifdef HAVE_HW_HANTEK_6XXX
+/*
+ * The driver reads a single transfer per acquisition, so this runs a
+ * number of short acquisitions from one endless stream.
+ */
+START_TEST(test_hantek_6xxx_benchmark)
+{
+	struct srtest_usb_capture *cap;
+	struct sr_dev_inst *sdi;
+	struct feed_stats stats;
+	uint8_t *pattern;
+	char *path;
+	int64_t start;
+	clock_t cpu;
+	int i;
+
+	if (!srtest_usb_replay_active())
+		return;
+	if (!g_getenv("LIBSIGROK_TEST_BENCHMARKS"))
+		return;
+
+	cap = srtest_usb_capture_new();
+	srtest_usb_capture_device(cap, 0x04b4, 0x6022, NULL, NULL, NULL);
+	srtest_usb_capture_renumerate(cap, 0x04b5, 0x6022, NULL, NULL, NULL);
+	pattern = pattern_new(PATTERN_SIZE);
+	srtest_usb_capture_bulk(cap, 0, 0x86, pattern, PATTERN_SIZE);
+	g_free(pattern);
+	path = srtest_usb_capture_save(cap);
+	srtest_usb_capture_free(cap);
+	srtest_usb_replay_load(path, SRTEST_USB_REPLAY_LOOP);
+	g_unlink(path);
+	g_free(path);
+
+	sdi = open_device("hantek-6xxx");
+	set_uint64(sdi, SR_CONF_SAMPLERATE, SR_MHZ(8));
+	set_uint64(sdi, SR_CONF_LIMIT_SAMPLES, HANTEK_BENCH_SAMPLES);
+
+	memset(&stats, 0, sizeof(stats));
+	start = g_get_monotonic_time();
+	cpu = clock();
+	for (i = 0; i < HANTEK_BENCH_ROUNDS; i++)
+		run_acquisition(sdi, &stats);
+	cpu = clock() - cpu;
+	start = g_get_monotonic_time() - start;
+
+	fail_unless(stats.num_ends == HANTEK_BENCH_ROUNDS,
+		"Got %d ends.", stats.num_ends);
+	fail_unless(stats.analog_samples ==
+		(uint64_t)HANTEK_BENCH_SAMPLES * HANTEK_BENCH_ROUNDS,
+		"Got %" PRIu64 " analog samples.", stats.analog_samples);
+	/* Two channels, one byte per sample each. */
+	report("hantek-6xxx", stats.analog_samples * 2, stats.analog_samples,
+		start, cpu);
+
+	sr_dev_close(sdi);
+	srtest_usb_replay_unload();
+}
+END_TEST
+#endif
+
+Suite *suite_driver_usb(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("driver-usb");
+
+	tc = tcase_create("replay");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 30);
+#ifdef HAVE_HW_FX2LAFW
+	tcase_add_test(tc, test_fx2lafw_throttled);
+	tcase_add_test(tc, test_fx2lafw_protocol_trigger);
+	tcase_add_test(tc, test_fx2lafw_condition_trigger);
+#endif
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("hotplug");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 30);
+#ifdef HAVE_HW_FX2LAFW
+	tcase_add_test(tc, test_hotplug);
+	tcase_add_test(tc, test_hotplug_polled);
+#endif
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("replay_benchmark");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 120);
+#ifdef HAVE_HW_FX2LAFW
+	tcase_add_test(tc, test_fx2lafw_benchmark);
+	tcase_add_test(tc, test_fx2lafw_trigger_benchmark);
+#endif
+#ifdef HAVE_HW_HANTEK_6XXX
+	tcase_add_test(tc, test_hantek_6xxx_benchmark);
+#endif
+	suite_add_tcase(s, tc);
+
+	return s;
+}
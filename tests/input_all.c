@@ -20,10 +20,19 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
 
+/* Size of the generated files, large enough to notice reading all of them. */
+#define SCAN_FILE_SIZE (4 * 1024 * 1024)
+
+/* Upper bound for the time it takes to identify a file, in microseconds. */
+#define SCAN_MAX_TIME_US (500 * 1000)
+
 /* Check whether at least one input module is available. */
 START_TEST(test_input_available)
 {
@@ -34,6 +43,142 @@ START_TEST(test_input_available)
 }
 END_TEST
 
+static GString *gen_vcd(void)
+{
+	GString *s;
+	unsigned int i;
+
+	s = g_string_new("$timescale 1 ns $end\n"
+		"$scope module top $end\n"
+		"$var wire 1 ! a $end\n"
+		"$upscope $end\n"
+		"$enddefinitions $end\n");
+	for (i = 0; s->len < SCAN_FILE_SIZE; i++)
+		g_string_append_printf(s, "#%u\n%u!\n", i, i & 1);
+
+	return s;
+}
+
+static GString *gen_wav(void)
+{
+	GString *s;
+	static const char hdr[] =
+		"RIFF\x24\x00\x40\x00WAVE"
+		"fmt \x10\x00\x00\x00\x01\x00\x01\x00"
+		"\x44\xac\x00\x00\x88\x58\x01\x00\x02\x00\x10\x00"
+		"data\x00\x00\x40\x00";
+
+	s = g_string_new_len(hdr, sizeof(hdr) - 1);
+	while (s->len < SCAN_FILE_SIZE)
+		g_string_append_len(s, "\x00\x10\x00\xf0", 4);
+
+	return s;
+}
+
+static GString *gen_csv(void)
+{
+	GString *s;
+	unsigned int i;
+
+	s = g_string_new("a,b,c,d\n");
+	for (i = 0; s->len < SCAN_FILE_SIZE; i++)
+		g_string_append_printf(s, "%u,%u,%u,%u\n",
+			i & 1, (i >> 1) & 1, (i >> 2) & 1, (i >> 3) & 1);
+
+	return s;
+}
+
+static GString *gen_srzip(void)
+{
+	GString *s;
+
+	/* Local file header of a zip archive, as found in session files. */
+	s = g_string_new_len("PK\x03\x04\x14\x00\x00\x00\x08\x00", 10);
+	g_string_set_size(s, SCAN_FILE_SIZE);
+	memset(s->str + 10, 0x5a, s->len - 10);
+
+	return s;
+}
+
+static GString *gen_raw(void)
+{
+	GString *s;
+	unsigned int i;
+
+	s = g_string_sized_new(SCAN_FILE_SIZE);
+	for (i = 0; i < SCAN_FILE_SIZE; i++)
+		g_string_append_c(s, (i * 7) ^ (i >> 8));
+
+	return s;
+}
+
+static const struct {
+	const char *name;
+	GString *(*gen)(void);
+	/* Expected module, or NULL if no module should match. */
+	const char *id;
+} scan_files[] = {
+	{ "test.vcd", gen_vcd, "vcd" },
+	{ "test.wav", gen_wav, "wav" },
+	{ "test.csv", gen_csv, NULL },
+	{ "test.sr", gen_srzip, NULL },
+	{ "test.bin", gen_raw, NULL },
+};
+
+/*
+ * Check whether sr_input_scan_file() picks the right module, quickly,
+ * for large files of various formats.
+ */
+START_TEST(test_input_scan_file)
+{
+	const struct sr_input *in;
+	const char *id;
+	GString *contents;
+	gchar *dir, *filename;
+	gint64 start, elapsed;
+	unsigned int i;
+	int ret;
+
+	dir = g_dir_make_tmp("sigrok-test-XXXXXX", NULL);
+	fail_unless(dir != NULL, "Failed to create temporary directory.");
+
+	for (i = 0; i < ARRAY_SIZE(scan_files); i++) {
+		filename = g_build_filename(dir, scan_files[i].name, NULL);
+		contents = scan_files[i].gen();
+		fail_unless(g_file_set_contents(filename, contents->str,
+				contents->len, NULL), "Failed to write %s.",
+				filename);
+		g_string_free(contents, TRUE);
+
+		start = g_get_monotonic_time();
+		ret = sr_input_scan_file(filename, &in);
+		elapsed = g_get_monotonic_time() - start;
+
+		if (scan_files[i].id) {
+			fail_unless(ret == SR_OK && in != NULL,
+				"%s not identified: %d.", scan_files[i].name, ret);
+			id = sr_input_id_get(sr_input_module_get(in));
+			fail_unless(!strcmp(id, scan_files[i].id),
+				"%s identified as %s.", scan_files[i].name, id);
+			sr_input_free(in);
+		} else {
+			fail_unless(in == NULL, "%s identified as %s.",
+				scan_files[i].name,
+				sr_input_id_get(sr_input_module_get(in)));
+		}
+		fail_unless(elapsed < SCAN_MAX_TIME_US,
+			"Identifying %s took %" G_GINT64_FORMAT " us.",
+			scan_files[i].name, elapsed);
+
+		g_unlink(filename);
+		g_free(filename);
+	}
+
+	g_rmdir(dir);
+	g_free(dir);
+}
+END_TEST
+
 Suite *suite_input_all(void)
 {
 	Suite *s;
@@ -45,5 +190,9 @@ Suite *suite_input_all(void)
 	tcase_add_test(tc, test_input_available);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("scan");
+	tcase_add_test(tc, test_input_scan_file);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
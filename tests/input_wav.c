@@ -0,0 +1,391 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#define WAVE_FORMAT_PCM         0x0001
+#define WAVE_FORMAT_IEEE_FLOAT  0x0003
+#define WAVE_FORMAT_EXTENSIBLE  0xfffe
+
+/* Number of frames in the generated files checked sample by sample. */
+#define NUM_FRAMES 100000
+
+/* Feed the input module in odd-sized pieces to exercise partial samples. */
+#define PIECE_SIZE 7777
+
+/* Size of the data chunk of the generated large file. */
+#define LARGE_DATA_SIZE (UINT64_C(3) * 1024 * 1024 * 1024)
+#define LARGE_PIECE_SIZE (4 * 1024 * 1024)
+
+struct wav_format {
+	int fmt_code;
+	gboolean extensible;
+	int unitsize;
+	int num_channels;
+};
+
+static const struct wav_format wav_formats[] = {
+	{ WAVE_FORMAT_PCM, FALSE, 1, 1 },
+	{ WAVE_FORMAT_PCM, FALSE, 2, 2 },
+	{ WAVE_FORMAT_PCM, FALSE, 3, 2 },
+	{ WAVE_FORMAT_PCM, FALSE, 4, 3 },
+	{ WAVE_FORMAT_IEEE_FLOAT, FALSE, 4, 2 },
+	{ WAVE_FORMAT_IEEE_FLOAT, FALSE, 8, 2 },
+	{ WAVE_FORMAT_PCM, TRUE, 3, 4 },
+	{ WAVE_FORMAT_IEEE_FLOAT, TRUE, 8, 1 },
+};
+
+struct wav_check {
+	const struct wav_format *fmt;
+	/* Check every sample against sample_value(), or just count them. */
+	gboolean check_values;
+	uint64_t num_samples;
+	gboolean have_seen_df_end;
+	float *fdata;
+};
+
+static void put_le(GString *s, uint64_t value, int size)
+{
+	int i;
+
+	for (i = 0; i < size; i++)
+		g_string_append_c(s, (value >> (i * 8)) & 0xff);
+}
+
+static GString *gen_wav_header(const struct wav_format *fmt, uint64_t data_size)
+{
+	GString *s;
+	int block_align;
+
+	block_align = fmt->unitsize * fmt->num_channels;
+
+	s = g_string_new("RIFF");
+	put_le(s, MIN(data_size + (fmt->extensible ? 60 : 36), UINT32_MAX), 4);
+	g_string_append(s, "WAVEfmt ");
+	put_le(s, fmt->extensible ? 40 : 16, 4);
+	put_le(s, fmt->extensible ? WAVE_FORMAT_EXTENSIBLE : fmt->fmt_code, 2);
+	put_le(s, fmt->num_channels, 2);
+	put_le(s, 48000, 4);
+	put_le(s, 48000 * block_align, 4);
+	put_le(s, block_align, 2);
+	put_le(s, fmt->unitsize * 8, 2);
+	if (fmt->extensible) {
+		put_le(s, 22, 2);
+		put_le(s, fmt->unitsize * 8, 2);
+		put_le(s, 0, 4);
+		/* Subformat GUID, only the format code is looked at. */
+		put_le(s, fmt->fmt_code, 2);
+		g_string_append_len(s, "\x00\x00\x00\x00\x10\x00\x80\x00"
+				"\x00\xaa\x00\x38\x9b\x71", 14);
+	}
+	g_string_append(s, "data");
+	put_le(s, MIN(data_size, UINT32_MAX), 4);
+
+	return s;
+}
+
+/* The full scale value of a PCM format. */
+static uint64_t pcm_max(const struct wav_format *fmt)
+{
+	if (fmt->unitsize == 1)
+		return UINT8_MAX;
+
+	return (UINT64_C(1) << (fmt->unitsize * 8 - 1)) - 1;
+}
+
+/* The raw code of the k-th sample in a generated PCM file. */
+static int64_t pcm_code(const struct wav_format *fmt, uint64_t k)
+{
+	if (fmt->unitsize == 1)
+		return k % 256;
+
+	return ((int)(k % 200) - 100) * (int64_t)(pcm_max(fmt) / 100);
+}
+
+/* The expected value of the k-th sample in a generated file. */
+static double sample_value(const struct wav_format *fmt, uint64_t k)
+{
+	if (fmt->fmt_code == WAVE_FORMAT_PCM)
+		return pcm_code(fmt, k) / (double)pcm_max(fmt);
+
+	return ((int)(k % 200) - 100) / 100.0;
+}
+
+static void gen_wav_samples(GString *s, const struct wav_format *fmt,
+		uint64_t num_frames)
+{
+	union { float f; uint32_t u; } f32;
+	union { double d; uint64_t u; } f64;
+	uint64_t k;
+
+	for (k = 0; k < num_frames * fmt->num_channels; k++) {
+		if (fmt->fmt_code == WAVE_FORMAT_PCM) {
+			put_le(s, pcm_code(fmt, k), fmt->unitsize);
+		} else if (fmt->unitsize == 4) {
+			f32.f = sample_value(fmt, k);
+			put_le(s, f32.u, 4);
+		} else {
+			f64.d = sample_value(fmt, k);
+			put_le(s, f64.u, 8);
+		}
+	}
+}
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_analog *analog;
+	struct wav_check *check;
+	unsigned int num_channels, i;
+	uint64_t k;
+	double expected;
+	int ret;
+
+	(void)sdi;
+
+	check = cb_data;
+	fail_unless(!check->have_seen_df_end, "Packet after SR_DF_END.");
+
+	switch (packet->type) {
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		num_channels = g_slist_length(analog->meaning->channels);
+		fail_unless(num_channels == (unsigned int)check->fmt->num_channels,
+			"Got %u channels in a packet.", num_channels);
+		fail_unless(analog->encoding->unitsize == check->fmt->unitsize,
+			"Got unitsize %d.", analog->encoding->unitsize);
+		if (check->check_values) {
+			check->fdata = g_realloc(check->fdata, analog->num_samples
+					* num_channels * sizeof(float));
+			ret = sr_analog_to_float(analog, check->fdata);
+			fail_unless(ret == SR_OK, "sr_analog_to_float() failed: %d.",
+					ret);
+			for (i = 0; i < analog->num_samples * num_channels; i++) {
+				k = check->num_samples * num_channels + i;
+				expected = sample_value(check->fmt, k);
+				fail_unless(fabs(check->fdata[i] - expected) < 1e-4,
+					"Sample %" PRIu64 ": %f != %f.", k,
+					check->fdata[i], expected);
+			}
+		}
+		check->num_samples += analog->num_samples;
+		break;
+	case SR_DF_END:
+		check->have_seen_df_end = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+static void run_input(GString *header, const struct wav_format *fmt,
+		gboolean check_values, struct wav_check *check,
+		GString *(*next_piece)(void *), void *data)
+{
+	const struct sr_input_module *imod;
+	const struct sr_input *in;
+	struct sr_session *session;
+	GString *piece;
+	int ret;
+
+	memset(check, 0, sizeof(*check));
+	check->fmt = fmt;
+	check->check_values = check_values;
+
+	imod = sr_input_find("wav");
+	fail_unless(imod != NULL, "Failed to find input module.");
+	in = sr_input_new(imod, NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	ret = sr_input_send(in, header);
+	fail_unless(ret == SR_OK, "sr_input_send() error: %d.", ret);
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, check);
+	sr_session_dev_add(session, sr_input_dev_inst_get(in));
+
+	while ((piece = next_piece(data))) {
+		ret = sr_input_send(in, piece);
+		g_string_free(piece, TRUE);
+		fail_unless(ret == SR_OK, "sr_input_send() error: %d.", ret);
+	}
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d.", ret);
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+	g_free(check->fdata);
+	check->fdata = NULL;
+}
+
+struct pieces {
+	const GString *buf;
+	gsize offset;
+};
+
+static GString *next_piece(void *data)
+{
+	struct pieces *p;
+	gsize len;
+
+	p = data;
+	if (p->offset >= p->buf->len)
+		return NULL;
+	len = MIN(PIECE_SIZE, p->buf->len - p->offset);
+	p->offset += len;
+
+	return g_string_new_len(p->buf->str + p->offset - len, len);
+}
+
+/*
+ * Check whether all supported sample formats are decoded correctly,
+ * with all channels interleaved in the same packets.
+ */
+START_TEST(test_input_wav_formats)
+{
+	const struct wav_format *fmt;
+	struct wav_check check;
+	struct pieces pieces;
+	GString *header, *samples;
+
+	/* Note: _i is the loop variable from tcase_add_loop_test(). */
+	fmt = &wav_formats[_i];
+
+	samples = g_string_new(NULL);
+	gen_wav_samples(samples, fmt, NUM_FRAMES);
+	/* A trailing chunk must not be taken for samples. */
+	g_string_append_len(samples, "LIST\x04\x00\x00\x00INFO", 12);
+
+	header = gen_wav_header(fmt, NUM_FRAMES * fmt->unitsize * fmt->num_channels);
+
+	pieces.buf = samples;
+	pieces.offset = 0;
+	run_input(header, fmt, TRUE, &check, next_piece, &pieces);
+
+	fail_unless(check.have_seen_df_end, "No SR_DF_END seen.");
+	fail_unless(check.num_samples == NUM_FRAMES,
+		"Expected %d samples, got %" PRIu64 ".", NUM_FRAMES,
+		check.num_samples);
+
+	g_string_free(header, TRUE);
+	g_string_free(samples, TRUE);
+}
+END_TEST
+
+static GString *next_large_piece(void *data)
+{
+	uint64_t *remaining;
+	GString *s;
+	gsize len;
+
+	remaining = data;
+	if (*remaining == 0)
+		return NULL;
+	len = MIN(LARGE_PIECE_SIZE, *remaining);
+	*remaining -= len;
+
+	s = g_string_sized_new(len);
+	g_string_set_size(s, len);
+	memset(s->str, 0, len);
+
+	return s;
+}
+
+/*
+ * Check whether a file whose data size doesn't fit the header, as
+ * streaming writers leave it, is read up to its end.
+ */
+START_TEST(test_input_wav_unsized)
+{
+	static const struct wav_format fmt = { WAVE_FORMAT_PCM, TRUE, 3, 2 };
+	struct wav_check check;
+	GString *header;
+	uint64_t remaining, expected;
+
+	header = gen_wav_header(&fmt, UINT32_MAX);
+	remaining = 3 * LARGE_PIECE_SIZE;
+	expected = remaining / (fmt.unitsize * fmt.num_channels);
+
+	run_input(header, &fmt, FALSE, &check, next_large_piece, &remaining);
+
+	fail_unless(check.have_seen_df_end, "No SR_DF_END seen.");
+	fail_unless(check.num_samples == expected,
+		"Expected %" PRIu64 " samples, got %" PRIu64 ".", expected,
+		check.num_samples);
+
+	g_string_free(header, TRUE);
+}
+END_TEST
+
+/*
+ * Check whether a multi-gigabyte file is streamed through completely,
+ * without the data size overflowing anywhere. This takes a while, so it
+ * only runs when LIBSIGROK_TEST_BENCHMARKS is set.
+ */
+START_TEST(test_input_wav_large)
+{
+	static const struct wav_format fmt = { WAVE_FORMAT_PCM, TRUE, 3, 2 };
+	struct wav_check check;
+	GString *header;
+	uint64_t remaining, expected;
+
+	if (!g_getenv("LIBSIGROK_TEST_BENCHMARKS"))
+		return;
+
+	header = gen_wav_header(&fmt, LARGE_DATA_SIZE);
+	remaining = LARGE_DATA_SIZE;
+	expected = LARGE_DATA_SIZE / (fmt.unitsize * fmt.num_channels);
+
+	run_input(header, &fmt, FALSE, &check, next_large_piece, &remaining);
+
+	fail_unless(check.have_seen_df_end, "No SR_DF_END seen.");
+	fail_unless(check.num_samples == expected,
+		"Expected %" PRIu64 " samples, got %" PRIu64 ".", expected,
+		check.num_samples);
+
+	g_string_free(header, TRUE);
+}
+END_TEST
+
+Suite *suite_input_wav(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("input-wav");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_loop_test(tc, test_input_wav_formats, 0,
+			ARRAY_SIZE(wav_formats));
+	tcase_add_test(tc, test_input_wav_unsized);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("large");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 120);
+	tcase_add_test(tc, test_input_wav_large);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -161,3 +161,73 @@ GArray *srtest_get_enabled_logic_channels(const struct sr_dev_inst *sdi)
 
 	return channels;
 }
+
+/*
+ * Get the demo device, with the given samplerate and sample limit. Either
+ * is left at the driver's default if 0.
+ */
+struct sr_dev_inst *srtest_demo_dev_get(uint64_t samplerate,
+		uint64_t limit_samples)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	GSList *devices;
+	int ret;
+
+	driver = srtest_driver_get("demo");
+	srtest_driver_init(srtest_ctx, driver);
+	devices = sr_driver_scan(driver, NULL);
+	fail_unless(devices != NULL, "No demo device found.");
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	if (samplerate) {
+		ret = sr_config_set(sdi, NULL, SR_CONF_SAMPLERATE,
+				g_variant_new_uint64(samplerate));
+		fail_unless(ret == SR_OK, "Failed to set samplerate: %d.", ret);
+	}
+	if (limit_samples) {
+		ret = sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+				g_variant_new_uint64(limit_samples));
+		fail_unless(ret == SR_OK, "Failed to set sample limit: %d.",
+			ret);
+	}
+
+	return sdi;
+}
+
+/*
+ * Check whether the plane of channel A0 in a planar packet from the demo
+ * device has the default square wave in it, at the right sample numbers:
+ * five samples of -25 V, then five of 25 V, from sample 0 on.
+ */
+gboolean srtest_demo_planar_check(const struct sr_datafeed_analog_planar *planar)
+{
+	const struct sr_analog_plane *plane;
+	const uint8_t *data;
+	unsigned int stride;
+	uint64_t sample;
+	uint32_t i, j;
+	float value, expected;
+
+	for (i = 0; i < planar->num_planes; i++) {
+		plane = &planar->planes[i];
+		if (strcmp(plane->channel->name, "A0"))
+			continue;
+		if (plane->encoding->unitsize != sizeof(float)
+				|| !plane->encoding->is_float)
+			return FALSE;
+		stride = plane->stride ? plane->stride : sizeof(float);
+		data = plane->data;
+		for (j = 0; j < planar->num_samples; j++) {
+			memcpy(&value, data + j * stride, sizeof(value));
+			sample = planar->sample + j;
+			expected = (sample / 5) % 2 ? 25.0 : -25.0;
+			if (value != expected)
+				return FALSE;
+		}
+		return TRUE;
+	}
+
+	return FALSE;
+}
@@ -42,11 +42,26 @@ void srtest_check_samplerate(struct sr_context *sr_ctx, const char *drivername,
 
 GArray *srtest_get_enabled_logic_channels(const struct sr_dev_inst *sdi);
 
+struct sr_dev_inst *srtest_demo_dev_get(uint64_t samplerate,
+		uint64_t limit_samples);
+gboolean srtest_demo_planar_check(const struct sr_datafeed_analog_planar *planar);
+
 Suite *suite_core(void);
 Suite *suite_driver_all(void);
+Suite *suite_driver_usb(void);
+Suite *suite_driver_serial(void);
+Suite *suite_driver_scpi(void);
+Suite *suite_driver_modbus(void);
 Suite *suite_input_all(void);
 Suite *suite_input_binary(void);
+Suite *suite_input_wav(void);
+Suite *suite_local_server(void);
 Suite *suite_output_all(void);
+Suite *suite_output_gap(void);
+Suite *suite_output_planar(void);
+Suite *suite_output_shmring(void);
+Suite *suite_output_srzip(void);
+Suite *suite_output_wav(void);
 Suite *suite_transform_all(void);
 Suite *suite_session(void);
 Suite *suite_strutil(void);
@@ -0,0 +1,316 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <glib/gstdio.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#define NUM_SAMPLES 200000
+#define NUM_CLIENTS 2
+
+struct client_feed {
+	struct sr_dev_inst *sdi;
+	int num_headers;
+	int num_ends;
+	uint64_t logic_bytes;
+	uint64_t analog_samples;
+	uint64_t planar_samples;
+	gboolean bad_planar;
+	gboolean data_after_end;
+};
+
+/* Serve the demo device until killed. */
+static void run_server(const char *path, int ready_fd)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_local_server *server;
+
+	sdi = srtest_demo_dev_get(0, 0);
+
+	if (sr_local_server_new(srtest_ctx, path, &server) != SR_OK)
+		_exit(EXIT_FAILURE);
+	if (sr_local_server_dev_add(server, sdi) != SR_OK)
+		_exit(EXIT_FAILURE);
+
+	if (write(ready_fd, "r", 1) != 1)
+		_exit(EXIT_FAILURE);
+	close(ready_fd);
+
+	sr_local_server_run(server);
+	sr_local_server_free(server);
+
+	_exit(EXIT_SUCCESS);
+}
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct client_feed *feeds, *feed;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_analog_planar *planar;
+	int i;
+
+	feeds = cb_data;
+	feed = NULL;
+	for (i = 0; i < NUM_CLIENTS; i++) {
+		if (feeds[i].sdi == sdi)
+			feed = &feeds[i];
+	}
+	fail_unless(feed != NULL, "Packet from unknown device.");
+	if (feed->num_ends > 0)
+		feed->data_after_end = TRUE;
+
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		feed->num_headers++;
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		feed->logic_bytes += logic->length;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		feed->analog_samples += analog->num_samples;
+		break;
+	case SR_DF_ANALOG_PLANAR:
+		/* All of them, in order, with the samples in place. */
+		planar = packet->payload;
+		if (planar->sample != feed->planar_samples
+				|| planar->num_planes < 2
+				|| !srtest_demo_planar_check(planar))
+			feed->bad_planar = TRUE;
+		feed->planar_samples += planar->num_samples;
+		break;
+	case SR_DF_END:
+		feed->num_ends++;
+		break;
+	}
+}
+
+static struct sr_dev_inst *scan_server(struct sr_dev_driver *driver,
+		const char *path)
+{
+	struct sr_config src;
+	struct sr_dev_inst *sdi;
+	GSList *options, *devices;
+
+	src.key = SR_CONF_CONN;
+	src.data = g_variant_new_string(path);
+	options = g_slist_append(NULL, &src);
+	devices = sr_driver_scan(driver, options);
+	g_slist_free(options);
+	g_variant_unref(src.data);
+
+	fail_unless(g_slist_length(devices) == 1,
+		"Expected one device, found %u.", g_slist_length(devices));
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	return sdi;
+}
+
+/* Fork a server process at a new socket path, and wait until it's up. */
+static pid_t server_start(gchar **dir, gchar **path)
+{
+	pid_t pid;
+	int fds[2];
+	char c;
+
+	*dir = g_dir_make_tmp("sigrok-test-XXXXXX", NULL);
+	fail_unless(*dir != NULL, "Failed to create temporary directory.");
+	*path = g_build_filename(*dir, "local.sock", NULL);
+
+	fail_unless(pipe(fds) == 0, "pipe() failed.");
+	pid = fork();
+	fail_unless(pid >= 0, "fork() failed.");
+	if (pid == 0) {
+		close(fds[0]);
+		run_server(*path, fds[1]);
+	}
+	close(fds[1]);
+	fail_unless(read(fds[0], &c, 1) == 1, "Server failed to start.");
+	close(fds[0]);
+
+	return pid;
+}
+
+static void server_stop(pid_t pid, gchar *dir, gchar *path)
+{
+	kill(pid, SIGTERM);
+	fail_unless(waitpid(pid, NULL, 0) == pid, "waitpid() failed.");
+
+	g_unlink(path);
+	g_free(path);
+	g_rmdir(dir);
+	g_free(dir);
+}
+
+/*
+ * Check whether two clients can configure a demo device in the server
+ * process, and both receive the datafeed of the one acquisition.
+ */
+START_TEST(test_local_server_demo)
+{
+	struct sr_dev_driver *driver;
+	struct sr_session *sess;
+	struct client_feed feeds[NUM_CLIENTS];
+	GVariant *gvar;
+	gchar *dir, *path;
+	pid_t pid;
+	int ret, i;
+
+	driver = srtest_driver_get("remote-local");
+	pid = server_start(&dir, &path);
+
+	srtest_driver_init(srtest_ctx, driver);
+	memset(feeds, 0, sizeof(feeds));
+	for (i = 0; i < NUM_CLIENTS; i++) {
+		feeds[i].sdi = scan_server(driver, path);
+		fail_unless(!strcmp(sr_dev_inst_model_get(feeds[i].sdi),
+			"Demo device"), "Wrong model.");
+		ret = sr_dev_open(feeds[i].sdi);
+		fail_unless(ret == SR_OK, "Failed to open device: %d.", ret);
+	}
+
+	/* Settings made by one client are seen by the other. */
+	ret = sr_config_set(feeds[0].sdi, NULL, SR_CONF_SAMPLERATE,
+			g_variant_new_uint64(SR_MHZ(1)));
+	fail_unless(ret == SR_OK, "Failed to set samplerate: %d.", ret);
+	ret = sr_config_set(feeds[0].sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+			g_variant_new_uint64(NUM_SAMPLES));
+	fail_unless(ret == SR_OK, "Failed to set sample limit: %d.", ret);
+	ret = sr_config_get(driver, feeds[1].sdi, NULL, SR_CONF_SAMPLERATE, &gvar);
+	fail_unless(ret == SR_OK, "Failed to get samplerate: %d.", ret);
+	fail_unless(g_variant_get_uint64(gvar) == SR_MHZ(1),
+		"Got samplerate %" PRIu64 ".", g_variant_get_uint64(gvar));
+	g_variant_unref(gvar);
+
+	ret = sr_session_new(srtest_ctx, &sess);
+	fail_unless(ret == SR_OK, "sr_session_new() failed: %d.", ret);
+	for (i = 0; i < NUM_CLIENTS; i++)
+		sr_session_dev_add(sess, feeds[i].sdi);
+	sr_session_datafeed_callback_add(sess, datafeed_in, feeds);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	sr_session_destroy(sess);
+
+	for (i = 0; i < NUM_CLIENTS; i++) {
+		fail_unless(feeds[i].num_headers == 1,
+			"Client %d got %d headers.", i, feeds[i].num_headers);
+		fail_unless(feeds[i].num_ends == 1,
+			"Client %d got %d ends.", i, feeds[i].num_ends);
+		fail_unless(!feeds[i].data_after_end,
+			"Client %d got packets after the end.", i);
+		fail_unless(feeds[i].analog_samples > 0,
+			"Client %d got no analog samples.", i);
+	}
+	/* The first client started the acquisition, and saw all of it. */
+	fail_unless(feeds[0].logic_bytes == NUM_SAMPLES,
+		"Client 0 got %" PRIu64 " logic bytes.", feeds[0].logic_bytes);
+	/* The second joined it, maybe a little late. */
+	fail_unless(feeds[1].logic_bytes > 0
+		&& feeds[1].logic_bytes <= feeds[0].logic_bytes,
+		"Client 1 got %" PRIu64 " logic bytes.", feeds[1].logic_bytes);
+
+	for (i = 0; i < NUM_CLIENTS; i++)
+		sr_dev_close(feeds[i].sdi);
+
+	server_stop(pid, dir, path);
+}
+END_TEST
+
+/*
+ * Check whether planar analog packets make it from the server to the
+ * client, with every plane's samples intact.
+ */
+START_TEST(test_local_server_planar)
+{
+	struct sr_dev_driver *driver;
+	struct sr_session *sess;
+	struct client_feed feeds[NUM_CLIENTS];
+	gchar *dir, *path;
+	pid_t pid;
+	int ret;
+
+	driver = srtest_driver_get("remote-local");
+	pid = server_start(&dir, &path);
+
+	srtest_driver_init(srtest_ctx, driver);
+	memset(feeds, 0, sizeof(feeds));
+	feeds[0].sdi = scan_server(driver, path);
+	ret = sr_dev_open(feeds[0].sdi);
+	fail_unless(ret == SR_OK, "Failed to open device: %d.", ret);
+	ret = sr_config_set(feeds[0].sdi, NULL, SR_CONF_SAMPLERATE,
+			g_variant_new_uint64(SR_MHZ(1)));
+	fail_unless(ret == SR_OK, "Failed to set samplerate: %d.", ret);
+	ret = sr_config_set(feeds[0].sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+			g_variant_new_uint64(NUM_SAMPLES));
+	fail_unless(ret == SR_OK, "Failed to set sample limit: %d.", ret);
+	ret = sr_config_set(feeds[0].sdi, NULL, SR_CONF_ANALOG_PLANAR,
+			g_variant_new_boolean(TRUE));
+	fail_unless(ret == SR_OK, "Failed to enable planar packets: %d.", ret);
+
+	ret = sr_session_new(srtest_ctx, &sess);
+	fail_unless(ret == SR_OK, "sr_session_new() failed: %d.", ret);
+	sr_session_dev_add(sess, feeds[0].sdi);
+	sr_session_datafeed_callback_add(sess, datafeed_in, feeds);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	sr_session_destroy(sess);
+
+	fail_unless(feeds[0].num_ends == 1, "Got %d ends.", feeds[0].num_ends);
+	fail_unless(feeds[0].analog_samples == 0,
+		"Got %" PRIu64 " interleaved analog samples.",
+		feeds[0].analog_samples);
+	fail_unless(feeds[0].planar_samples == NUM_SAMPLES,
+		"Got %" PRIu64 " planar samples.", feeds[0].planar_samples);
+	fail_unless(!feeds[0].bad_planar, "Planar samples out of place.");
+
+	sr_dev_close(feeds[0].sdi);
+	server_stop(pid, dir, path);
+}
+END_TEST
+
+Suite *suite_local_server(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("local-server");
+
+	tc = tcase_create("demo");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 30);
+	tcase_add_test(tc, test_local_server_demo);
+	tcase_add_test(tc, test_local_server_planar);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -30,15 +30,29 @@ int main(void)
 	Suite *s;
 	SRunner *srunner;
 
+	/* Have sr_init() run its internal driver and module sanity checks. */
+	g_setenv("LIBSIGROK_SANITY_CHECKS", "1", TRUE);
+
 	s = suite_create("mastersuite");
 	srunner = srunner_create(s);
 
 	/* Add all testsuites to the master suite. */
 	srunner_add_suite(srunner, suite_core());
 	srunner_add_suite(srunner, suite_driver_all());
+	srunner_add_suite(srunner, suite_driver_usb());
+	srunner_add_suite(srunner, suite_driver_serial());
+	srunner_add_suite(srunner, suite_driver_scpi());
+	srunner_add_suite(srunner, suite_driver_modbus());
 	srunner_add_suite(srunner, suite_input_all());
 	srunner_add_suite(srunner, suite_input_binary());
+	srunner_add_suite(srunner, suite_input_wav());
+	srunner_add_suite(srunner, suite_local_server());
 	srunner_add_suite(srunner, suite_output_all());
+	srunner_add_suite(srunner, suite_output_gap());
+	srunner_add_suite(srunner, suite_output_planar());
+	srunner_add_suite(srunner, suite_output_shmring());
+	srunner_add_suite(srunner, suite_output_srzip());
+	srunner_add_suite(srunner, suite_output_wav());
 	srunner_add_suite(srunner, suite_transform_all());
 	srunner_add_suite(srunner, suite_session());
 	srunner_add_suite(srunner, suite_strutil());
@@ -0,0 +1,512 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <check.h>
+#include "modbus_sim.h"
+
+/* The part of the M9812 register map the maynuo-m97 driver uses. */
+#define COIL_BASE	0x0500
+#define NUM_COILS	0x30
+#define REG_BASE	0x0A00
+#define NUM_REGS	0x108
+#define REG_U		0x0B00
+#define REG_I		0x0B02
+#define REG_MODEL	0x0B06
+#define REG_EDITION	0x0B07
+
+#define M9812_MODEL	101
+#define M9812_EDITION	11
+
+#define MODBUS_ILLEGAL_FUNCTION		0x01
+#define MODBUS_ILLEGAL_DATA_ADDRESS	0x02
+#define MODBUS_ILLEGAL_DATA_VALUE	0x03
+
+struct srtest_modbus_slave {
+	uint8_t coils[NUM_COILS];
+	uint16_t regs[NUM_REGS];
+	uint64_t seq;
+};
+
+static unsigned int rb16(const uint8_t *p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static void wb16(uint8_t *p, unsigned int value)
+{
+	p[0] = value >> 8;
+	p[1] = value;
+}
+
+static void set_float(struct srtest_modbus_slave *slave, unsigned int reg,
+		float value)
+{
+	union {
+		float f;
+		uint32_t u;
+	} v;
+
+	v.f = value;
+	slave->regs[reg - REG_BASE] = v.u >> 16;
+	slave->regs[reg - REG_BASE + 1] = v.u & 0xFFFF;
+}
+
+struct srtest_modbus_slave *srtest_modbus_slave_new(void)
+{
+	struct srtest_modbus_slave *slave;
+
+	slave = g_malloc0(sizeof(struct srtest_modbus_slave));
+	slave->regs[REG_MODEL - REG_BASE] = M9812_MODEL;
+	slave->regs[REG_EDITION - REG_BASE] = M9812_EDITION;
+
+	return slave;
+}
+
+/* Length of the request PDU starting at pdu, or 0 if it's not known yet. */
+size_t srtest_modbus_pdu_len(const uint8_t *pdu, size_t len)
+{
+	if (len < 1)
+		return 0;
+
+	switch (pdu[0]) {
+	case 0x01:
+	case 0x03:
+	case 0x05:
+	case 0x06:
+		return 5;
+	case 0x0F:
+	case 0x10:
+		return len < 6 ? 0 : 6 + pdu[5];
+	default:
+		/* Answered as an illegal function. */
+		return 1;
+	}
+}
+
+static size_t exception(uint8_t function, uint8_t code, uint8_t *reply)
+{
+	reply[0] = function | 0x80;
+	reply[1] = code;
+
+	return 2;
+}
+
+/* Answer a request PDU; returns the length of the reply PDU. */
+size_t srtest_modbus_slave_pdu(struct srtest_modbus_slave *slave,
+		const uint8_t *request, size_t len, uint8_t *reply)
+{
+	unsigned int addr, count, i;
+
+	if (len < 5 || len != srtest_modbus_pdu_len(request, len))
+		return exception(request[0], MODBUS_ILLEGAL_FUNCTION, reply);
+
+	addr = rb16(request + 1);
+	count = rb16(request + 3);
+	reply[0] = request[0];
+
+	switch (request[0]) {
+	case 0x01:
+		if (count < 1 || count > 2000)
+			return exception(request[0], MODBUS_ILLEGAL_DATA_VALUE, reply);
+		if (addr < COIL_BASE || addr + count > COIL_BASE + NUM_COILS)
+			return exception(request[0], MODBUS_ILLEGAL_DATA_ADDRESS, reply);
+		reply[1] = (count + 7) / 8;
+		memset(reply + 2, 0, reply[1]);
+		for (i = 0; i < count; i++) {
+			if (slave->coils[addr - COIL_BASE + i])
+				reply[2 + i / 8] |= 1 << (i % 8);
+		}
+		return 2 + reply[1];
+	case 0x03:
+		if (count < 1 || count > 125)
+			return exception(request[0], MODBUS_ILLEGAL_DATA_VALUE, reply);
+		if (addr < REG_BASE || addr + count > REG_BASE + NUM_REGS)
+			return exception(request[0], MODBUS_ILLEGAL_DATA_ADDRESS, reply);
+		if (addr <= REG_U && addr + count > REG_U) {
+			set_float(slave, REG_U,
+				(slave->seq++ % SRTEST_MODBUS_SIM_SEQ_MOD) / 10.0);
+			set_float(slave, REG_I, SRTEST_MODBUS_SIM_CURRENT);
+		}
+		reply[1] = 2 * count;
+		for (i = 0; i < count; i++)
+			wb16(reply + 2 + 2 * i, slave->regs[addr - REG_BASE + i]);
+		return 2 + reply[1];
+	case 0x05:
+		if (count != 0xFF00 && count != 0x0000)
+			return exception(request[0], MODBUS_ILLEGAL_DATA_VALUE, reply);
+		if (addr < COIL_BASE || addr >= COIL_BASE + NUM_COILS)
+			return exception(request[0], MODBUS_ILLEGAL_DATA_ADDRESS, reply);
+		slave->coils[addr - COIL_BASE] = count == 0xFF00;
+		memcpy(reply, request, 5);
+		return 5;
+	case 0x10:
+		if (count < 1 || count > 123 || request[5] != 2 * count)
+			return exception(request[0], MODBUS_ILLEGAL_DATA_VALUE, reply);
+		if (addr < REG_BASE || addr + count > REG_BASE + NUM_REGS)
+			return exception(request[0], MODBUS_ILLEGAL_DATA_ADDRESS, reply);
+		for (i = 0; i < count; i++)
+			slave->regs[addr - REG_BASE + i] = rb16(request + 6 + 2 * i);
+		memcpy(reply, request, 5);
+		return 5;
+	default:
+		return exception(request[0], MODBUS_ILLEGAL_FUNCTION, reply);
+	}
+}
+
+void srtest_modbus_slave_free(struct srtest_modbus_slave *slave)
+{
+	g_free(slave);
+}
+
+/* CRC-16/MODBUS; RTU frames carry it little endian. */
+uint16_t srtest_modbus_crc(const uint8_t *buf, size_t len)
+{
+	uint16_t crc;
+	int i;
+
+	crc = 0xFFFF;
+	while (len--) {
+		crc ^= *buf++;
+		for (i = 0; i < 8; i++)
+			crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+	}
+
+	return crc;
+}
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/* Transaction ID, protocol ID, length, unit ID. */
+#define MBAP_HEADER_SIZE	7
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+struct tcp_reply {
+	int64_t ready_at;
+	size_t len;
+	uint8_t data[];
+};
+
+struct srtest_modbus_sim {
+	GThread *thread;
+	GMutex mutex;
+	gboolean stop;
+	int wakeup[2];
+	int listener;
+	int fd;
+	char *conn;
+	gboolean reorder;
+	GByteArray *rx;
+	/* Replies waiting for their time, oldest first. */
+	GQueue replies;
+	/* What is being sent. */
+	GByteArray *tx;
+	unsigned int max_pending;
+	struct srtest_modbus_slave *slave;
+};
+
+static void wake(struct srtest_modbus_sim *sim)
+{
+	if (write(sim->wakeup[1], "w", 1) < 0) {
+		/* The pipe is full, so the thread wakes anyway. */
+	}
+}
+
+static void connection_close(struct srtest_modbus_sim *sim)
+{
+	if (sim->fd >= 0)
+		close(sim->fd);
+	sim->fd = -1;
+	g_byte_array_set_size(sim->rx, 0);
+	g_byte_array_set_size(sim->tx, 0);
+	g_queue_foreach(&sim->replies, (GFunc)g_free, NULL);
+	g_queue_clear(&sim->replies);
+}
+
+static void accept_connection(struct srtest_modbus_sim *sim)
+{
+	int fd;
+
+	if ((fd = accept(sim->listener, NULL, NULL)) < 0)
+		return;
+
+	connection_close(sim);
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+	sim->fd = fd;
+}
+
+static void handle_request(struct srtest_modbus_sim *sim, const uint8_t *frame,
+		size_t len, int64_t now)
+{
+	struct tcp_reply *r;
+	uint8_t pdu[256];
+	size_t pdu_len;
+
+	if (rb16(frame + 2) != 0 || frame[6] != SRTEST_MODBUS_SIM_UNIT)
+		return;
+
+	pdu_len = srtest_modbus_slave_pdu(sim->slave, frame + MBAP_HEADER_SIZE,
+			len - MBAP_HEADER_SIZE, pdu);
+
+	r = g_malloc(sizeof(struct tcp_reply) + MBAP_HEADER_SIZE + pdu_len);
+	memcpy(r->data, frame, 4);
+	wb16(r->data + 4, 1 + pdu_len);
+	r->data[6] = frame[6];
+	memcpy(r->data + MBAP_HEADER_SIZE, pdu, pdu_len);
+	r->len = MBAP_HEADER_SIZE + pdu_len;
+	r->ready_at = now + SRTEST_MODBUS_SIM_LATENCY;
+	g_queue_push_tail(&sim->replies, r);
+
+	sim->max_pending = MAX(sim->max_pending,
+			g_queue_get_length(&sim->replies));
+}
+
+static void receive(struct srtest_modbus_sim *sim, int64_t now)
+{
+	uint8_t buf[4096];
+	ssize_t len;
+	size_t frame_len;
+
+	while ((len = recv(sim->fd, buf, sizeof(buf), 0)) > 0)
+		g_byte_array_append(sim->rx, buf, len);
+	if (len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+		connection_close(sim);
+		return;
+	}
+
+	while (sim->rx->len >= MBAP_HEADER_SIZE) {
+		frame_len = MBAP_HEADER_SIZE - 1 + rb16(sim->rx->data + 4);
+		if (sim->rx->len < frame_len)
+			break;
+		if (frame_len > MBAP_HEADER_SIZE)
+			handle_request(sim, sim->rx->data, frame_len, now);
+		g_byte_array_remove_range(sim->rx, 0, frame_len);
+	}
+}
+
+/*
+ * Move the replies that are due to the output, and send what it can
+ * take. Returns TRUE if the socket is full, and otherwise updates
+ * next_wake with when the next reply is due.
+ */
+static gboolean transmit(struct srtest_modbus_sim *sim, int64_t now,
+		int64_t *next_wake)
+{
+	struct tcp_reply *r;
+	GList *l, *due;
+	ssize_t len;
+
+	for (;;) {
+		due = NULL;
+		for (l = sim->replies.head; l; l = l->next) {
+			r = l->data;
+			if (r->ready_at > now)
+				break;
+			due = l;
+			if (!sim->reorder)
+				break;
+		}
+		if (!due)
+			break;
+		r = due->data;
+		g_byte_array_append(sim->tx, r->data, r->len);
+		g_free(r);
+		g_queue_delete_link(&sim->replies, due);
+	}
+	if ((r = g_queue_peek_head(&sim->replies)))
+		*next_wake = MIN(*next_wake, r->ready_at);
+
+	while (sim->tx->len > 0) {
+		len = send(sim->fd, sim->tx->data, sim->tx->len, MSG_NOSIGNAL);
+		if (len < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return TRUE;
+			connection_close(sim);
+			return FALSE;
+		}
+		g_byte_array_remove_range(sim->tx, 0, len);
+	}
+
+	return FALSE;
+}
+
+static gpointer sim_thread(gpointer data)
+{
+	struct srtest_modbus_sim *sim;
+	struct pollfd fds[3];
+	int64_t now, next_wake;
+	int nfds, timeout;
+	char c;
+
+	sim = data;
+
+	g_mutex_lock(&sim->mutex);
+	while (!sim->stop) {
+		fds[0].fd = sim->wakeup[0];
+		fds[0].events = POLLIN;
+		fds[1].fd = sim->listener;
+		fds[1].events = POLLIN;
+		nfds = 2;
+		now = g_get_monotonic_time();
+		next_wake = G_MAXINT64;
+		if (sim->fd >= 0) {
+			fds[2].fd = sim->fd;
+			fds[2].events = POLLIN;
+			if (transmit(sim, now, &next_wake))
+				fds[2].events |= POLLOUT;
+			if (sim->fd >= 0)
+				nfds = 3;
+		}
+		g_mutex_unlock(&sim->mutex);
+
+		if (next_wake == G_MAXINT64)
+			timeout = -1;
+		else
+			timeout = (next_wake - now + 999) / 1000;
+		poll(fds, nfds, timeout);
+
+		g_mutex_lock(&sim->mutex);
+		while (read(sim->wakeup[0], &c, 1) == 1);
+		if (fds[1].revents & POLLIN)
+			accept_connection(sim);
+		else if (nfds > 2 && sim->fd == fds[2].fd &&
+				(fds[2].revents & (POLLIN | POLLHUP | POLLERR)))
+			receive(sim, g_get_monotonic_time());
+	}
+	g_mutex_unlock(&sim->mutex);
+
+	return NULL;
+}
+
+struct srtest_modbus_sim *srtest_modbus_sim_new(gboolean reorder)
+{
+	struct srtest_modbus_sim *sim;
+	struct sockaddr_in addr;
+	socklen_t addrlen;
+
+	sim = g_malloc0(sizeof(struct srtest_modbus_sim));
+	sim->reorder = reorder;
+	sim->fd = -1;
+	sim->rx = g_byte_array_new();
+	sim->tx = g_byte_array_new();
+	g_queue_init(&sim->replies);
+	sim->slave = srtest_modbus_slave_new();
+
+	sim->listener = socket(AF_INET, SOCK_STREAM, 0);
+	fail_unless(sim->listener >= 0, "socket() failed.");
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addrlen = sizeof(addr);
+	fail_unless(bind(sim->listener, (struct sockaddr *)&addr,
+		sizeof(addr)) == 0, "bind() failed: %s.", g_strerror(errno));
+	fail_unless(listen(sim->listener, 4) == 0, "listen() failed.");
+	getsockname(sim->listener, (struct sockaddr *)&addr, &addrlen);
+
+	sim->conn = g_strdup_printf("tcp/127.0.0.1/%u", ntohs(addr.sin_port));
+
+	fail_unless(pipe(sim->wakeup) == 0, "pipe() failed.");
+	fcntl(sim->wakeup[0], F_SETFL, O_NONBLOCK);
+	fcntl(sim->wakeup[1], F_SETFL, O_NONBLOCK);
+	g_mutex_init(&sim->mutex);
+	sim->thread = g_thread_new("modbus-sim", sim_thread, sim);
+
+	return sim;
+}
+
+const char *srtest_modbus_sim_conn(const struct srtest_modbus_sim *sim)
+{
+	return sim->conn;
+}
+
+unsigned int srtest_modbus_sim_max_pending(struct srtest_modbus_sim *sim)
+{
+	unsigned int max_pending;
+
+	g_mutex_lock(&sim->mutex);
+	max_pending = sim->max_pending;
+	g_mutex_unlock(&sim->mutex);
+
+	return max_pending;
+}
+
+void srtest_modbus_sim_free(struct srtest_modbus_sim *sim)
+{
+	g_mutex_lock(&sim->mutex);
+	sim->stop = TRUE;
+	g_mutex_unlock(&sim->mutex);
+	wake(sim);
+	g_thread_join(sim->thread);
+
+	connection_close(sim);
+	g_byte_array_free(sim->rx, TRUE);
+	g_byte_array_free(sim->tx, TRUE);
+	srtest_modbus_slave_free(sim->slave);
+	close(sim->listener);
+	close(sim->wakeup[0]);
+	close(sim->wakeup[1]);
+	g_mutex_clear(&sim->mutex);
+	g_free(sim->conn);
+	g_free(sim);
+}
+
+#else
+
+struct srtest_modbus_sim *srtest_modbus_sim_new(gboolean reorder)
+{
+	(void)reorder;
+
+	fail("The Modbus TCP simulator isn't available in this build.");
+
+	return NULL;
+}
+
+const char *srtest_modbus_sim_conn(const struct srtest_modbus_sim *sim)
+{
+	(void)sim;
+
+	return NULL;
+}
+
+unsigned int srtest_modbus_sim_max_pending(struct srtest_modbus_sim *sim)
+{
+	(void)sim;
+
+	return 0;
+}
+
+void srtest_modbus_sim_free(struct srtest_modbus_sim *sim)
+{
+	(void)sim;
+}
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBSIGROK_TESTS_MODBUS_SIM_H
+#define LIBSIGROK_TESTS_MODBUS_SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <glib.h>
+
+/*
+ * A simulated Maynuo M9812 electronic load, as a Modbus slave.
+ *
+ * The measured voltage shows how often it has been read before, modulo
+ * SRTEST_MODBUS_SIM_SEQ_MOD, in units of 0.1V. The current is always
+ * SRTEST_MODBUS_SIM_CURRENT.
+ *
+ * A srtest_modbus_slave holds the registers and answers request PDUs;
+ * the pty device in serial_sim.c uses one to speak Modbus RTU.
+ *
+ * A srtest_modbus_sim serves a slave over Modbus TCP on a local port,
+ * from a thread. Each reply goes out SRTEST_MODBUS_SIM_LATENCY us after
+ * its request came in, as from a gateway to a slower bus. With reorder
+ * set, of the replies due at once, the newest goes out first.
+ */
+
+#define SRTEST_MODBUS_SIM_UNIT		1
+#define SRTEST_MODBUS_SIM_SEQ_MOD	10000
+#define SRTEST_MODBUS_SIM_CURRENT	1.5
+#define SRTEST_MODBUS_SIM_LATENCY	2000
+
+struct srtest_modbus_slave;
+struct srtest_modbus_sim;
+
+struct srtest_modbus_slave *srtest_modbus_slave_new(void);
+size_t srtest_modbus_pdu_len(const uint8_t *pdu, size_t len);
+size_t srtest_modbus_slave_pdu(struct srtest_modbus_slave *slave,
+		const uint8_t *request, size_t len, uint8_t *reply);
+void srtest_modbus_slave_free(struct srtest_modbus_slave *slave);
+uint16_t srtest_modbus_crc(const uint8_t *buf, size_t len);
+
+struct srtest_modbus_sim *srtest_modbus_sim_new(gboolean reorder);
+const char *srtest_modbus_sim_conn(const struct srtest_modbus_sim *sim);
+unsigned int srtest_modbus_sim_max_pending(struct srtest_modbus_sim *sim);
+void srtest_modbus_sim_free(struct srtest_modbus_sim *sim);
+
+#endif
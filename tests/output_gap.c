@@ -0,0 +1,451 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zip.h>
+#include <glib/gstdio.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#define SAMPLERATE SR_KHZ(10)
+#define NUM_CHANNELS 4
+/* Samples in each of the three logic packets. */
+#define NUM_SAMPLES 100
+#define GAP1_LENGTH 50
+#define GAP2_LENGTH 30
+#define TOTAL_SAMPLES (3 * NUM_SAMPLES + GAP1_LENGTH + GAP2_LENGTH)
+
+/*
+ * The logic value of a sample, by its position in the whole stream.
+ * Never zero, so that lost samples stand out, and changing with every
+ * sample, so that VCD writes a timestamp for each of them.
+ */
+static uint8_t sample_value(uint64_t sample)
+{
+	return sample % 15 + 1;
+}
+
+static gboolean in_gap(uint64_t sample)
+{
+	if (sample >= NUM_SAMPLES && sample < NUM_SAMPLES + GAP1_LENGTH)
+		return TRUE;
+	if (sample >= 2 * NUM_SAMPLES + GAP1_LENGTH
+			&& sample < 2 * NUM_SAMPLES + GAP1_LENGTH + GAP2_LENGTH)
+		return TRUE;
+
+	return FALSE;
+}
+
+static struct sr_dev_inst *dev_new(void)
+{
+	struct sr_dev_inst *sdi;
+	char name[8];
+	int c;
+
+	sdi = sr_dev_inst_user_new("sigrok", "gap-test", NULL);
+	for (c = 0; c < NUM_CHANNELS; c++) {
+		g_snprintf(name, sizeof(name), "D%d", c);
+		sr_dev_inst_channel_add(sdi, c, SR_CHANNEL_LOGIC, name);
+	}
+
+	return sdi;
+}
+
+/* Send a packet, and append what the module made of it to all. */
+static void send(const struct sr_output *o, uint16_t type,
+		const void *payload, GString *all)
+{
+	struct sr_datafeed_packet packet;
+	GString *out;
+	int ret;
+
+	packet.type = type;
+	packet.payload = payload;
+	out = NULL;
+	ret = sr_output_send(o, &packet, &out);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	if (out) {
+		g_string_append_len(all, out->str, out->len);
+		g_string_free(out, TRUE);
+	}
+}
+
+static void send_logic(const struct sr_output *o, uint64_t start,
+		GString *all)
+{
+	struct sr_datafeed_logic logic;
+	uint8_t data[NUM_SAMPLES];
+	int i;
+
+	for (i = 0; i < NUM_SAMPLES; i++)
+		data[i] = sample_value(start + i);
+	logic.length = NUM_SAMPLES;
+	logic.unitsize = 1;
+	logic.data = data;
+	send(o, SR_DF_LOGIC, &logic, all);
+}
+
+static void send_gap(const struct sr_output *o, uint64_t start,
+		uint64_t length, GString *all)
+{
+	struct sr_datafeed_gap gap;
+
+	gap.start = start;
+	gap.length = length;
+	send(o, SR_DF_GAP, &gap, all);
+}
+
+/*
+ * Send three logic packets with a gap before each of the last two, and
+ * the end packet. The samplerate only goes out if with_meta is set.
+ */
+static GString *send_feed(const struct sr_output *o, gboolean with_meta)
+{
+	struct sr_datafeed_meta meta;
+	struct sr_config src;
+	GString *all;
+	uint64_t start;
+
+	all = g_string_new(NULL);
+	if (with_meta) {
+		src.key = SR_CONF_SAMPLERATE;
+		src.data = g_variant_new_uint64(SAMPLERATE);
+		meta.config = g_slist_append(NULL, &src);
+		send(o, SR_DF_META, &meta, all);
+		g_slist_free(meta.config);
+		g_variant_unref(src.data);
+	}
+
+	start = 0;
+	send_logic(o, start, all);
+	start += NUM_SAMPLES;
+	send_gap(o, start, GAP1_LENGTH, all);
+	start += GAP1_LENGTH;
+	send_logic(o, start, all);
+	start += NUM_SAMPLES;
+	send_gap(o, start, GAP2_LENGTH, all);
+	start += GAP2_LENGTH;
+	send_logic(o, start, all);
+	send(o, SR_DF_END, NULL, all);
+
+	return all;
+}
+
+static GString *output_feed(char *id, gboolean with_meta)
+{
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	GString *all;
+
+	sdi = dev_new();
+	o = sr_output_new(sr_output_find(id), NULL, sdi, NULL);
+	fail_unless(o != NULL, "Failed to create %s output instance.", id);
+	all = send_feed(o, with_meta);
+	sr_output_free(o);
+
+	return all;
+}
+
+/*
+ * Check whether the CSV output writes a row for each sample which was
+ * received, and notes each gap where its rows would have been.
+ */
+START_TEST(test_output_gap_csv)
+{
+	GString *all;
+	gchar **lines, *expected;
+	uint64_t s;
+	int i, c, gaps;
+
+	all = output_feed("csv", TRUE);
+	lines = g_strsplit(all->str, "\n", 0);
+	s = 0;
+	gaps = 0;
+	for (i = 0; lines[i]; i++) {
+		if (g_str_has_prefix(lines[i], "; Gap: ")) {
+			expected = g_strdup_printf("; Gap: %d samples lost",
+				gaps ? GAP2_LENGTH : GAP1_LENGTH);
+			fail_unless(!strcmp(lines[i], expected),
+				"Gap line is '%s', expected '%s'.",
+				lines[i], expected);
+			g_free(expected);
+			fail_unless(in_gap(s), "Gap noted at sample %" PRIu64
+				".", s);
+			s += gaps ? GAP2_LENGTH : GAP1_LENGTH;
+			gaps++;
+			continue;
+		}
+		if (!lines[i][0] || lines[i][0] == ';')
+			continue;
+		fail_unless(s < TOTAL_SAMPLES, "Too many rows.");
+		fail_if(in_gap(s), "Row for lost sample %" PRIu64 ".", s);
+		fail_unless(strlen(lines[i]) == 2 * NUM_CHANNELS - 1,
+			"Row %" PRIu64 " is '%s'.", s, lines[i]);
+		for (c = 0; c < NUM_CHANNELS; c++) {
+			fail_unless(lines[i][2 * c] ==
+				((sample_value(s) >> c) & 1 ? '1' : '0'),
+				"Row %" PRIu64 " is '%s'.", s, lines[i]);
+		}
+		s++;
+	}
+	fail_unless(gaps == 2, "Got %d gap lines.", gaps);
+	fail_unless(s == TOTAL_SAMPLES, "Got up to sample %" PRIu64 ".", s);
+	g_strfreev(lines);
+	g_string_free(all, TRUE);
+}
+END_TEST
+
+/* The VCD line marking all channels unknown at the given time. */
+static gchar *vcd_unknown(uint64_t time)
+{
+	GString *s;
+	int c;
+
+	s = g_string_new(NULL);
+	g_string_printf(s, "#%" PRIu64, time);
+	for (c = 0; c < NUM_CHANNELS; c++)
+		g_string_append_printf(s, " x%c", '!' + c);
+
+	return g_string_free(s, FALSE);
+}
+
+/* The VCD line setting all channels to a sample's value. */
+static gchar *vcd_sample(uint64_t time, uint64_t sample)
+{
+	GString *s;
+	int c;
+
+	s = g_string_new(NULL);
+	g_string_printf(s, "\n#%" PRIu64, time);
+	for (c = 0; c < NUM_CHANNELS; c++)
+		g_string_append_printf(s, " %d%c",
+			(sample_value(sample) >> c) & 1, '!' + c);
+	g_string_append_c(s, '\n');
+
+	return g_string_free(s, FALSE);
+}
+
+/*
+ * Check whether the VCD output marks the channels unknown at the start
+ * of each gap, and carries on with the time after it. At 10kHz, the
+ * timescale is 1us, so each sample takes 100 units.
+ */
+START_TEST(test_output_gap_vcd)
+{
+	GString *all;
+	gchar *expected, *end;
+
+	all = output_feed("vcd", TRUE);
+
+	fail_unless(strstr(all->str, "$comment 50 samples lost $end\n") != NULL,
+		"First gap not noted.");
+	fail_unless(strstr(all->str, "$comment 30 samples lost $end\n") != NULL,
+		"Second gap not noted.");
+
+	expected = vcd_unknown(NUM_SAMPLES * 100);
+	fail_unless(strstr(all->str, expected) != NULL,
+		"Missing '%s'.", expected);
+	g_free(expected);
+	expected = vcd_unknown((2 * NUM_SAMPLES + GAP1_LENGTH) * 100);
+	fail_unless(strstr(all->str, expected) != NULL,
+		"Missing '%s'.", expected);
+	g_free(expected);
+
+	/* The first sample after a gap has all channels written. */
+	expected = vcd_sample((NUM_SAMPLES + GAP1_LENGTH) * 100,
+		NUM_SAMPLES + GAP1_LENGTH);
+	fail_unless(strstr(all->str, expected) != NULL,
+		"Missing '%s'.", g_strstrip(expected));
+	g_free(expected);
+
+	end = g_strdup_printf("\n#%d\n", TOTAL_SAMPLES * 100);
+	fail_unless(g_str_has_suffix(all->str, end),
+		"Output doesn't end at sample %d.", TOTAL_SAMPLES);
+	g_free(end);
+
+	g_string_free(all, TRUE);
+}
+END_TEST
+
+/*
+ * Check whether the VCD output copes with gaps when the samplerate is
+ * unknown, counting time in samples rather than dividing by zero.
+ */
+START_TEST(test_output_gap_vcd_no_samplerate)
+{
+	GString *all;
+	gchar *expected;
+
+	all = output_feed("vcd", FALSE);
+
+	fail_if(strstr(all->str, "inf") != NULL, "Infinite timestamp.");
+	fail_if(strstr(all->str, "nan") != NULL, "NaN timestamp.");
+	expected = vcd_unknown(NUM_SAMPLES);
+	fail_unless(strstr(all->str, expected) != NULL,
+		"Missing '%s'.", expected);
+	g_free(expected);
+	expected = g_strdup_printf("\n#%d\n", TOTAL_SAMPLES);
+	fail_unless(g_str_has_suffix(all->str, expected),
+		"Output doesn't end at sample %d.", TOTAL_SAMPLES);
+	g_free(expected);
+
+	g_string_free(all, TRUE);
+}
+END_TEST
+
+struct load_check {
+	uint64_t samples;
+	uint64_t mismatches;
+};
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct load_check *check;
+	const struct sr_datafeed_logic *logic;
+	const uint8_t *data;
+	uint64_t i, s;
+
+	(void)sdi;
+
+	check = cb_data;
+	if (packet->type != SR_DF_LOGIC)
+		return;
+
+	logic = packet->payload;
+	fail_unless(logic->unitsize == 1, "Loaded unitsize %d.",
+		logic->unitsize);
+	data = logic->data;
+	for (i = 0; i < logic->length; i++) {
+		s = check->samples + i;
+		if (data[i] != (in_gap(s) ? 0 : sample_value(s)))
+			check->mismatches++;
+	}
+	check->samples += logic->length;
+}
+
+/* The "gaps" key of the archive's metadata, or NULL. */
+static gchar *srzip_gaps(const char *filename)
+{
+	struct zip *archive;
+	struct zip_file *zf;
+	struct zip_stat zs;
+	GKeyFile *kf;
+	gchar *buf, *gaps;
+	zip_int64_t len;
+
+	archive = zip_open(filename, 0, NULL);
+	fail_unless(archive != NULL, "Failed to open archive.");
+	fail_unless(zip_stat(archive, "metadata", 0, &zs) == 0,
+		"No metadata in archive.");
+	zf = zip_fopen_index(archive, zs.index, 0);
+	fail_unless(zf != NULL, "Failed to open metadata.");
+	buf = g_malloc(zs.size);
+	len = zip_fread(zf, buf, zs.size);
+	fail_unless(len == (zip_int64_t)zs.size, "Failed to read metadata.");
+	zip_fclose(zf);
+	zip_discard(archive);
+
+	kf = g_key_file_new();
+	fail_unless(g_key_file_load_from_data(kf, buf, zs.size, 0, NULL),
+		"Failed to parse metadata.");
+	g_free(buf);
+	gaps = g_key_file_get_value(kf, "device 1", "gaps", NULL);
+	g_key_file_free(kf);
+
+	return gaps;
+}
+
+/*
+ * Check whether the srzip archive holds the gaps as zero samples, so
+ * that the samples after them stay in place, and lists them in the
+ * metadata.
+ */
+START_TEST(test_output_gap_srzip)
+{
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	struct sr_session *sess;
+	struct load_check check;
+	GString *all;
+	gchar *dir, *filename, *gaps, *expected;
+	int ret;
+
+	dir = g_dir_make_tmp("sigrok-test-XXXXXX", NULL);
+	fail_unless(dir != NULL, "Failed to create temporary directory.");
+	filename = g_build_filename(dir, "gap.sr", NULL);
+
+	sdi = dev_new();
+	o = sr_output_new(sr_output_find("srzip"), NULL, sdi, filename);
+	fail_unless(o != NULL, "Failed to create output instance.");
+	all = send_feed(o, TRUE);
+	g_string_free(all, TRUE);
+	sr_output_free(o);
+
+	gaps = srzip_gaps(filename);
+	expected = g_strdup_printf("%d:%d;%d:%d;",
+		NUM_SAMPLES, GAP1_LENGTH,
+		2 * NUM_SAMPLES + GAP1_LENGTH, GAP2_LENGTH);
+	fail_unless(gaps != NULL, "No gaps in metadata.");
+	fail_unless(!strcmp(gaps, expected), "Gaps are '%s', expected '%s'.",
+		gaps, expected);
+	g_free(expected);
+	g_free(gaps);
+
+	memset(&check, 0, sizeof(check));
+	ret = sr_session_load(srtest_ctx, filename, &sess);
+	fail_unless(ret == SR_OK, "sr_session_load() failed: %d.", ret);
+	sr_session_datafeed_callback_add(sess, datafeed_in, &check);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	sr_session_destroy(sess);
+
+	fail_unless(check.samples == TOTAL_SAMPLES,
+		"Loaded %" PRIu64 " samples.", check.samples);
+	fail_unless(check.mismatches == 0, "%" PRIu64 " samples were wrong.",
+		check.mismatches);
+
+	g_unlink(filename);
+	g_free(filename);
+	g_rmdir(dir);
+	g_free(dir);
+}
+END_TEST
+
+Suite *suite_output_gap(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("output-gap");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_output_gap_csv);
+	tcase_add_test(tc, test_output_gap_vcd);
+	tcase_add_test(tc, test_output_gap_vcd_no_samplerate);
+	tcase_add_test(tc, test_output_gap_srzip);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
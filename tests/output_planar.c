@@ -0,0 +1,366 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#define SAMPLERATE SR_KHZ(1)
+#define NUM_CHANNELS 3
+/* Samples per channel in each of the two packets. */
+#define NUM_SAMPLES 100
+
+/*
+ * The same multi-channel data, sent as one planar packet followed by one
+ * interleaved packet. Of the planar packet, the first plane is packed,
+ * the others point into an interleaved buffer.
+ */
+struct test_feed {
+	struct sr_dev_inst *sdi;
+	GSList *channels;
+	float packed[NUM_SAMPLES];
+	float strided[NUM_SAMPLES * (NUM_CHANNELS - 1)];
+	float interleaved[NUM_SAMPLES * NUM_CHANNELS];
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	struct sr_analog_plane planes[NUM_CHANNELS];
+	struct sr_datafeed_analog_planar planar;
+	struct sr_datafeed_analog analog;
+};
+
+/* The value of a channel's sample, exact in a float and at one decimal. */
+static float sample_value(int channel, uint64_t sample)
+{
+	return channel * 1000 + sample + 0.5;
+}
+
+static void feed_init(struct test_feed *feed)
+{
+	struct sr_channel *ch;
+	char name[8];
+	int c, s;
+
+	memset(feed, 0, sizeof(*feed));
+	feed->sdi = sr_dev_inst_user_new("sigrok", "planar-test", NULL);
+	for (c = 0; c < NUM_CHANNELS; c++) {
+		g_snprintf(name, sizeof(name), "A%d", c);
+		sr_dev_inst_channel_add(feed->sdi, c, SR_CHANNEL_ANALOG, name);
+	}
+	feed->channels = g_slist_copy(sr_dev_inst_channels_get(feed->sdi));
+
+	feed->encoding.unitsize = sizeof(float);
+	feed->encoding.is_signed = TRUE;
+	feed->encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	feed->encoding.is_bigendian = TRUE;
+#endif
+	feed->encoding.digits = 1;
+	feed->encoding.is_digits_decimal = TRUE;
+	feed->encoding.scale.p = 1;
+	feed->encoding.scale.q = 1;
+	feed->encoding.offset.q = 1;
+	feed->meaning.mq = SR_MQ_VOLTAGE;
+	feed->meaning.unit = SR_UNIT_VOLT;
+	feed->meaning.channels = feed->channels;
+	feed->spec.spec_digits = 1;
+
+	for (s = 0; s < NUM_SAMPLES; s++) {
+		feed->packed[s] = sample_value(0, s);
+		for (c = 1; c < NUM_CHANNELS; c++)
+			feed->strided[s * (NUM_CHANNELS - 1) + c - 1] =
+				sample_value(c, s);
+		for (c = 0; c < NUM_CHANNELS; c++)
+			feed->interleaved[s * NUM_CHANNELS + c] =
+				sample_value(c, NUM_SAMPLES + s);
+	}
+
+	for (c = 0; c < NUM_CHANNELS; c++) {
+		ch = g_slist_nth_data(feed->channels, c);
+		feed->planes[c].channel = ch;
+		if (c == 0) {
+			feed->planes[c].data = feed->packed;
+		} else {
+			feed->planes[c].data = &feed->strided[c - 1];
+			feed->planes[c].stride =
+				sizeof(float) * (NUM_CHANNELS - 1);
+		}
+		feed->planes[c].encoding = &feed->encoding;
+		feed->planes[c].meaning = &feed->meaning;
+		feed->planes[c].spec = &feed->spec;
+	}
+	feed->planar.num_samples = NUM_SAMPLES;
+	feed->planar.num_planes = NUM_CHANNELS;
+	feed->planar.planes = feed->planes;
+
+	feed->analog.data = feed->interleaved;
+	feed->analog.num_samples = NUM_SAMPLES;
+	feed->analog.encoding = &feed->encoding;
+	feed->analog.meaning = &feed->meaning;
+	feed->analog.spec = &feed->spec;
+}
+
+static void feed_free(struct test_feed *feed)
+{
+	g_slist_free(feed->channels);
+}
+
+/* Send a packet, and append what the module made of it to all. */
+static void send(const struct sr_output *o, uint16_t type,
+		const void *payload, GString *all)
+{
+	struct sr_datafeed_packet packet;
+	GString *out;
+	int ret;
+
+	packet.type = type;
+	packet.payload = payload;
+	out = NULL;
+	ret = sr_output_send(o, &packet, &out);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	if (out) {
+		g_string_append_len(all, out->str, out->len);
+		g_string_free(out, TRUE);
+	}
+}
+
+/* Send the whole feed, with its meta and end packets. */
+static GString *send_feed(const struct sr_output *o, struct test_feed *feed)
+{
+	struct sr_datafeed_meta meta;
+	struct sr_config src;
+	GString *all;
+
+	all = g_string_new(NULL);
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_new_uint64(SAMPLERATE);
+	meta.config = g_slist_append(NULL, &src);
+	send(o, SR_DF_META, &meta, all);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+
+	send(o, SR_DF_ANALOG_PLANAR, &feed->planar, all);
+	send(o, SR_DF_ANALOG, &feed->analog, all);
+	send(o, SR_DF_END, NULL, all);
+
+	return all;
+}
+
+/*
+ * Check whether the CSV output writes one row per sample for both
+ * layouts, with each value in its channel's column.
+ */
+START_TEST(test_output_planar_csv)
+{
+	const struct sr_output *o;
+	struct test_feed feed;
+	GString *all;
+	gchar **lines, *expected;
+	int i, s;
+
+	feed_init(&feed);
+	o = sr_output_new(sr_output_find("csv"), NULL, feed.sdi, NULL);
+	fail_unless(o != NULL, "Failed to create output instance.");
+	all = send_feed(o, &feed);
+	sr_output_free(o);
+
+	lines = g_strsplit(all->str, "\n", 0);
+	s = 0;
+	for (i = 0; lines[i]; i++) {
+		if (!lines[i][0] || lines[i][0] == ';')
+			continue;
+		fail_unless(s < 2 * NUM_SAMPLES, "Too many rows.");
+		expected = g_strdup_printf("%.1f,%.1f,%.1f",
+			sample_value(0, s), sample_value(1, s),
+			sample_value(2, s));
+		fail_unless(!strcmp(lines[i], expected),
+			"Row %d is '%s', expected '%s'.", s, lines[i], expected);
+		g_free(expected);
+		s++;
+	}
+	fail_unless(s == 2 * NUM_SAMPLES, "Got %d rows.", s);
+	g_strfreev(lines);
+	g_string_free(all, TRUE);
+
+	feed_free(&feed);
+}
+END_TEST
+
+struct load_check {
+	uint64_t samples[NUM_CHANNELS];
+	uint64_t mismatches;
+};
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct load_check *check;
+	const struct sr_datafeed_analog *analog;
+	struct sr_channel *ch;
+	float *values;
+	uint32_t i;
+	int c;
+
+	(void)sdi;
+
+	check = cb_data;
+	if (packet->type != SR_DF_ANALOG)
+		return;
+
+	analog = packet->payload;
+	fail_unless(g_slist_length(analog->meaning->channels) == 1,
+		"Loaded a packet for several channels.");
+	ch = analog->meaning->channels->data;
+	c = ch->name[1] - '0';
+	fail_unless(c >= 0 && c < NUM_CHANNELS, "Unknown channel %s.",
+		ch->name);
+	values = g_malloc(sizeof(float) * analog->num_samples);
+	fail_unless(sr_analog_to_float(analog, values) == SR_OK);
+	for (i = 0; i < analog->num_samples; i++) {
+		if (values[i] != sample_value(c, check->samples[c] + i))
+			check->mismatches++;
+	}
+	g_free(values);
+	check->samples[c] += analog->num_samples;
+}
+
+/*
+ * Check whether both layouts end up in the srzip archive as the
+ * channels' samples, in order, by reading the archive back.
+ */
+START_TEST(test_output_planar_srzip)
+{
+	const struct sr_output *o;
+	struct sr_session *sess;
+	struct test_feed feed;
+	struct load_check check;
+	GString *all;
+	gchar *dir, *filename;
+	int ret, c;
+
+	dir = g_dir_make_tmp("sigrok-test-XXXXXX", NULL);
+	fail_unless(dir != NULL, "Failed to create temporary directory.");
+	filename = g_build_filename(dir, "planar.sr", NULL);
+
+	feed_init(&feed);
+	o = sr_output_new(sr_output_find("srzip"), NULL, feed.sdi, filename);
+	fail_unless(o != NULL, "Failed to create output instance.");
+	all = send_feed(o, &feed);
+	g_string_free(all, TRUE);
+	sr_output_free(o);
+	feed_free(&feed);
+
+	memset(&check, 0, sizeof(check));
+	ret = sr_session_load(srtest_ctx, filename, &sess);
+	fail_unless(ret == SR_OK, "sr_session_load() failed: %d.", ret);
+	sr_session_datafeed_callback_add(sess, datafeed_in, &check);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	sr_session_destroy(sess);
+
+	for (c = 0; c < NUM_CHANNELS; c++) {
+		fail_unless(check.samples[c] == 2 * NUM_SAMPLES,
+			"Loaded %" PRIu64 " samples of A%d.",
+			check.samples[c], c);
+	}
+	fail_unless(check.mismatches == 0, "%" PRIu64 " samples were wrong.",
+		check.mismatches);
+
+	g_unlink(filename);
+	g_free(filename);
+	g_rmdir(dir);
+	g_free(dir);
+}
+END_TEST
+
+/*
+ * Check whether a module which doesn't handle planar packets gets one
+ * packed single-channel packet per plane, by comparing its output with
+ * that for such packets sent by hand.
+ */
+START_TEST(test_output_planar_fallback)
+{
+	const struct sr_output *o;
+	struct test_feed feed;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_meaning meaning;
+	GSList channel;
+	GString *planar_out, *plane_out;
+	float values[NUM_SAMPLES];
+	int c, s;
+
+	feed_init(&feed);
+	fail_if(sr_output_test_flag(sr_output_find("analog"),
+		SR_OUTPUT_ANALOG_PLANAR),
+		"The analog module handles planar packets.");
+
+	o = sr_output_new(sr_output_find("analog"), NULL, feed.sdi, NULL);
+	fail_unless(o != NULL, "Failed to create output instance.");
+	planar_out = g_string_new(NULL);
+	send(o, SR_DF_ANALOG_PLANAR, &feed.planar, planar_out);
+	sr_output_free(o);
+
+	o = sr_output_new(sr_output_find("analog"), NULL, feed.sdi, NULL);
+	fail_unless(o != NULL, "Failed to create output instance.");
+	plane_out = g_string_new(NULL);
+	for (c = 0; c < NUM_CHANNELS; c++) {
+		for (s = 0; s < NUM_SAMPLES; s++)
+			values[s] = sample_value(c, s);
+		meaning = feed.meaning;
+		channel.data = g_slist_nth_data(feed.channels, c);
+		channel.next = NULL;
+		meaning.channels = &channel;
+		analog = feed.analog;
+		analog.data = values;
+		analog.meaning = &meaning;
+		send(o, SR_DF_ANALOG, &analog, plane_out);
+	}
+	sr_output_free(o);
+
+	fail_unless(planar_out->len > 0, "No output for the planar packet.");
+	fail_unless(!strcmp(planar_out->str, plane_out->str),
+		"Planar packet output differs.");
+	g_string_free(planar_out, TRUE);
+	g_string_free(plane_out, TRUE);
+
+	feed_free(&feed);
+}
+END_TEST
+
+Suite *suite_output_planar(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("output-planar");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_output_planar_csv);
+	tcase_add_test(tc, test_output_planar_srzip);
+	tcase_add_test(tc, test_output_planar_fallback);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,517 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#define RING_NAME "/sigrok-test-shmring"
+#define NUM_SAMPLES (4 * 1000 * 1000)
+/* The smallest ring there is, of which a record carries a quarter. */
+#define SMALL_RING_SIZE (64 * 1024)
+#define MAX_PAYLOAD (SMALL_RING_SIZE / 4)
+#define SAMPLERATE SR_KHZ(200)
+#define NUM_LOGIC_CHANNELS 12
+#define NUM_ANALOG_CHANNELS 2
+#define NUM_ANALOG_SAMPLES 50
+
+/* Exit codes of the reader process. */
+enum {
+	READER_OK,
+	READER_OPEN_FAILED,
+	READER_TIMEOUT,
+	READER_BAD_SEQUENCE,
+	READER_NO_DATA,
+};
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_output *o;
+	GString *out;
+
+	(void)sdi;
+
+	o = cb_data;
+	sr_output_send(o, packet, &out);
+	if (out)
+		g_string_free(out, TRUE);
+}
+
+/* A device with 12 logic channels, so two bytes per sample, and A0/A1. */
+static struct sr_dev_inst *dev_new(void)
+{
+	struct sr_dev_inst *sdi;
+	char name[8];
+	int i;
+
+	sdi = sr_dev_inst_user_new("sigrok", "shmring-test", NULL);
+	for (i = 0; i < NUM_LOGIC_CHANNELS; i++) {
+		g_snprintf(name, sizeof(name), "D%d", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+	for (i = 0; i < NUM_ANALOG_CHANNELS; i++) {
+		g_snprintf(name, sizeof(name), "A%d", i);
+		sr_dev_inst_channel_add(sdi, NUM_LOGIC_CHANNELS + i,
+			SR_CHANNEL_ANALOG, name);
+	}
+
+	return sdi;
+}
+
+/* A shmring output into the smallest ring, with the samplerate sent. */
+static const struct sr_output *output_new(struct sr_dev_inst *sdi)
+{
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_config src;
+	GHashTable *opts;
+	GString *out;
+
+	opts = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(opts, "name",
+			g_variant_ref_sink(g_variant_new_string(RING_NAME)));
+	g_hash_table_insert(opts, "size",
+			g_variant_ref_sink(g_variant_new_uint64(SMALL_RING_SIZE)));
+	o = sr_output_new(sr_output_find("shmring"), opts, sdi, NULL);
+	g_hash_table_destroy(opts);
+	fail_unless(o != NULL, "Failed to create shmring output.");
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_new_uint64(SAMPLERATE);
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+
+	return o;
+}
+
+static void send_packet(const struct sr_output *o, uint16_t type,
+		const void *payload)
+{
+	struct sr_datafeed_packet packet;
+	GString *out;
+	int ret;
+
+	packet.type = type;
+	packet.payload = payload;
+	ret = sr_output_send(o, &packet, &out);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	fail_unless(out == NULL, "Got output from the shmring module.");
+}
+
+/* Send length bytes of logic data, each byte telling where it is. */
+static void send_logic(const struct sr_output *o, uint64_t start,
+		uint64_t length)
+{
+	struct sr_datafeed_logic logic;
+	uint8_t *data;
+	uint64_t i;
+
+	data = g_malloc(length);
+	for (i = 0; i < length; i++)
+		data[i] = (start + i) * 7 + 3;
+	logic.length = length;
+	logic.unitsize = 2;
+	logic.data = data;
+	send_packet(o, SR_DF_LOGIC, &logic);
+	g_free(data);
+}
+
+static gboolean logic_check(const struct sr_shmring_record *rec,
+		uint64_t start)
+{
+	const uint8_t *data;
+	uint64_t i;
+
+	data = rec->data;
+	for (i = 0; i < rec->length; i++) {
+		if (data[i] != (uint8_t)((start + i) * 7 + 3))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void read_record(struct sr_shmring_reader *reader,
+		struct sr_shmring_record *rec)
+{
+	int ret;
+
+	ret = sr_shmring_read(reader, rec, 0);
+	fail_unless(ret == SR_OK, "sr_shmring_read() failed: %d.", ret);
+}
+
+/*
+ * Check whether the reader gets the stream properties and the packets
+ * as sent: logic data split into records of at most a quarter of the
+ * ring, analog values interleaved with their channels, and the end.
+ */
+START_TEST(test_shmring_payload)
+{
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_shmring_reader *reader;
+	const struct sr_shmring_info *info;
+	struct sr_shmring_record rec;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	float values[NUM_ANALOG_SAMPLES * NUM_ANALOG_CHANNELS];
+	const float *read_values;
+	uint64_t seq, offset, length;
+	unsigned int i;
+
+	sdi = dev_new();
+	o = output_new(sdi);
+	fail_unless(sr_shmring_reader_open(&reader, RING_NAME) == SR_OK,
+		"Failed to open the reader.");
+
+	info = sr_shmring_reader_info(reader);
+	fail_unless(info != NULL, "No stream properties.");
+	fail_unless(info->samplerate == SAMPLERATE, "Samplerate is %" PRIu64
+		".", info->samplerate);
+	fail_unless(info->unitsize == 2, "Unitsize is %u.", info->unitsize);
+	fail_unless(info->num_channels == NUM_LOGIC_CHANNELS
+		+ NUM_ANALOG_CHANNELS, "Got %u channels.", info->num_channels);
+	fail_unless(!strcmp(info->channels[11].name, "D11")
+		&& info->channels[11].type == SR_CHANNEL_LOGIC);
+	fail_unless(!strcmp(info->channels[12].name, "A0")
+		&& info->channels[12].type == SR_CHANNEL_ANALOG
+		&& info->channels[12].index == NUM_LOGIC_CHANNELS);
+
+	/* Two full records and the rest. */
+	length = 2 * MAX_PAYLOAD + 1000;
+	send_logic(o, 0, length);
+	offset = 0;
+	for (seq = 0; offset < length; seq++) {
+		read_record(reader, &rec);
+		fail_unless(rec.type == SR_DF_LOGIC, "Record type %d.",
+			rec.type);
+		fail_unless(rec.seq == seq && rec.lost == 0,
+			"Record %" PRIu64 " is %" PRIu64 ", %" PRIu64 " lost.",
+			seq, rec.seq, rec.lost);
+		fail_unless(rec.unitsize == 2, "Unitsize %u.", rec.unitsize);
+		fail_unless(rec.length == MIN(MAX_PAYLOAD, length - offset),
+			"Record of %" PRIu64 " bytes.", rec.length);
+		fail_unless(logic_check(&rec, offset),
+			"Wrong logic data at %" PRIu64 ".", offset);
+		offset += rec.length;
+	}
+	fail_unless(seq == 3, "Logic data took %" PRIu64 " records.", seq);
+
+	for (i = 0; i < G_N_ELEMENTS(values); i++)
+		values[i] = i + 0.5;
+	memset(&encoding, 0, sizeof(encoding));
+	encoding.unitsize = sizeof(float);
+	encoding.is_signed = TRUE;
+	encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+	encoding.scale.p = 1;
+	encoding.scale.q = 1;
+	encoding.offset.q = 1;
+	memset(&meaning, 0, sizeof(meaning));
+	meaning.mq = SR_MQ_VOLTAGE;
+	meaning.unit = SR_UNIT_VOLT;
+	meaning.mqflags = SR_MQFLAG_DC;
+	meaning.channels = g_slist_nth(sr_dev_inst_channels_get(sdi),
+		NUM_LOGIC_CHANNELS);
+	memset(&spec, 0, sizeof(spec));
+	memset(&analog, 0, sizeof(analog));
+	analog.data = values;
+	analog.num_samples = NUM_ANALOG_SAMPLES;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	send_packet(o, SR_DF_ANALOG, &analog);
+
+	read_record(reader, &rec);
+	fail_unless(rec.type == SR_DF_ANALOG, "Record type %d.", rec.type);
+	fail_unless(rec.seq == 3 && rec.lost == 0);
+	fail_unless(rec.channel == NUM_LOGIC_CHANNELS, "First channel %d.",
+		rec.channel);
+	fail_unless(rec.num_channels == NUM_ANALOG_CHANNELS,
+		"%u channels.", rec.num_channels);
+	fail_unless(rec.mq == SR_MQ_VOLTAGE && rec.unit == SR_UNIT_VOLT
+		&& rec.mqflags == SR_MQFLAG_DC, "Wrong meaning.");
+	fail_unless(rec.length == sizeof(values), "Record of %" PRIu64
+		" bytes.", rec.length);
+	read_values = rec.data;
+	for (i = 0; i < G_N_ELEMENTS(values); i++)
+		fail_unless(read_values[i] == values[i],
+			"Value %u is %f.", i, read_values[i]);
+
+	send_packet(o, SR_DF_END, NULL);
+	read_record(reader, &rec);
+	fail_unless(rec.type == SR_DF_END, "Record type %d.", rec.type);
+	fail_unless(sr_shmring_read(reader, &rec, 0) == SR_ERR_TIMEOUT,
+		"Got a record after the end.");
+
+	sr_shmring_reader_close(reader);
+	sr_output_free(o);
+}
+END_TEST
+
+/*
+ * Check whether records wrapping around the end of the ring read back
+ * intact, with record sizes which don't divide the ring size.
+ */
+START_TEST(test_shmring_wraparound)
+{
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_shmring_reader *reader;
+	struct sr_shmring_record rec;
+	uint64_t seq, offset;
+
+	sdi = dev_new();
+	o = output_new(sdi);
+	fail_unless(sr_shmring_reader_open(&reader, RING_NAME) == SR_OK,
+		"Failed to open the reader.");
+
+	/* Five times round the ring. */
+	offset = 0;
+	for (seq = 0; offset < 5 * SMALL_RING_SIZE; seq++) {
+		send_logic(o, offset, 3002);
+		read_record(reader, &rec);
+		fail_unless(rec.seq == seq && rec.lost == 0,
+			"Record %" PRIu64 " is %" PRIu64 ", %" PRIu64 " lost.",
+			seq, rec.seq, rec.lost);
+		fail_unless(rec.length == 3002, "Record of %" PRIu64
+			" bytes.", rec.length);
+		fail_unless(logic_check(&rec, offset),
+			"Wrong logic data in record %" PRIu64 ".", seq);
+		offset += rec.length;
+	}
+
+	sr_shmring_reader_close(reader);
+	sr_output_free(o);
+}
+END_TEST
+
+/*
+ * Check whether a reader which falls more than the ring behind skips to
+ * the newest data, and reports how many records it lost.
+ */
+START_TEST(test_shmring_overrun)
+{
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_shmring_reader *reader;
+	struct sr_shmring_record rec;
+	uint64_t i;
+
+	sdi = dev_new();
+	o = output_new(sdi);
+	fail_unless(sr_shmring_reader_open(&reader, RING_NAME) == SR_OK,
+		"Failed to open the reader.");
+
+	send_logic(o, 0, 1000);
+	read_record(reader, &rec);
+	fail_unless(rec.seq == 0 && rec.lost == 0);
+
+	/* Twice the ring's worth, none of it read. */
+	for (i = 1; i <= 2 * SMALL_RING_SIZE / 4000; i++)
+		send_logic(o, i * 4000, 4000);
+	fail_unless(sr_shmring_read(reader, &rec, 0) == SR_ERR_TIMEOUT,
+		"Read overwritten data.");
+
+	/* The reader picks up again with the next record. */
+	send_logic(o, i * 4000, 4000);
+	read_record(reader, &rec);
+	fail_unless(rec.seq == i, "Got record %" PRIu64 ", expected %"
+		PRIu64 ".", rec.seq, i);
+	fail_unless(rec.lost == i - 1, "%" PRIu64 " records lost, expected %"
+		PRIu64 ".", rec.lost, i - 1);
+	fail_unless(logic_check(&rec, i * 4000), "Wrong logic data.");
+
+	sr_shmring_reader_close(reader);
+	sr_output_free(o);
+}
+END_TEST
+
+/*
+ * Check whether a reader attaching while the producer is under way
+ * starts with the next record, with the stream properties already there.
+ */
+START_TEST(test_shmring_attach)
+{
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_shmring_reader *reader;
+	const struct sr_shmring_info *info;
+	struct sr_shmring_record rec;
+	uint64_t i;
+
+	sdi = dev_new();
+	o = output_new(sdi);
+	for (i = 0; i < 10; i++)
+		send_logic(o, i * 2000, 2000);
+
+	fail_unless(sr_shmring_reader_open(&reader, RING_NAME) == SR_OK,
+		"Failed to open the reader.");
+	info = sr_shmring_reader_info(reader);
+	fail_unless(info->samplerate == SAMPLERATE && info->unitsize == 2,
+		"Wrong stream properties.");
+	fail_unless(sr_shmring_read(reader, &rec, 0) == SR_ERR_TIMEOUT,
+		"Got a record written before attaching.");
+
+	send_logic(o, i * 2000, 2000);
+	read_record(reader, &rec);
+	fail_unless(rec.seq == i && rec.lost == 0,
+		"Got record %" PRIu64 ", %" PRIu64 " lost.", rec.seq, rec.lost);
+	fail_unless(logic_check(&rec, i * 2000), "Wrong logic data.");
+
+	send_packet(o, SR_DF_END, NULL);
+	read_record(reader, &rec);
+	fail_unless(rec.type == SR_DF_END && rec.seq == i + 1 && rec.lost == 0);
+
+	sr_shmring_reader_close(reader);
+	sr_output_free(o);
+}
+END_TEST
+
+/* Consume records until the end of the stream, then exit. */
+static void run_reader(int ready_fd)
+{
+	struct sr_shmring_reader *reader;
+	struct sr_shmring_record rec;
+	uint64_t next_seq, logic_bytes;
+	gboolean first;
+	int ret;
+
+	if (sr_shmring_reader_open(&reader, RING_NAME) != SR_OK)
+		_exit(READER_OPEN_FAILED);
+
+	/* Tell the producer we're attached. */
+	if (write(ready_fd, "r", 1) != 1)
+		_exit(READER_OPEN_FAILED);
+	close(ready_fd);
+
+	first = TRUE;
+	next_seq = 0;
+	logic_bytes = 0;
+	for (;;) {
+		ret = sr_shmring_read(reader, &rec, 10 * 1000);
+		if (ret != SR_OK)
+			_exit(READER_TIMEOUT);
+		if (!first && rec.seq != next_seq + rec.lost)
+			_exit(READER_BAD_SEQUENCE);
+		first = FALSE;
+		next_seq = rec.seq + 1;
+		if (rec.type == SR_DF_LOGIC)
+			logic_bytes += rec.length;
+		else if (rec.type == SR_DF_END)
+			break;
+	}
+
+	sr_shmring_reader_close(reader);
+
+	_exit(logic_bytes > 0 ? READER_OK : READER_NO_DATA);
+}
+
+/*
+ * Check whether a consumer in another process can follow the demo
+ * driver at its full rate through the shmring output module.
+ */
+START_TEST(test_shmring_demo)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_session *sess;
+	const struct sr_output *o;
+	GHashTable *opts;
+	pid_t pid;
+	int ret, status, fds[2];
+	char c;
+
+	sdi = srtest_demo_dev_get(SR_GHZ(1), NUM_SAMPLES);
+
+	opts = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(opts, "name",
+			g_variant_ref_sink(g_variant_new_string(RING_NAME)));
+	o = sr_output_new(sr_output_find("shmring"), opts, sdi, NULL);
+	g_hash_table_destroy(opts);
+	fail_unless(o != NULL, "Failed to create shmring output.");
+
+	fail_unless(pipe(fds) == 0, "pipe() failed.");
+	pid = fork();
+	fail_unless(pid >= 0, "fork() failed.");
+	if (pid == 0) {
+		close(fds[0]);
+		run_reader(fds[1]);
+	}
+	close(fds[1]);
+	fail_unless(read(fds[0], &c, 1) == 1, "Reader failed to attach.");
+	close(fds[0]);
+
+	ret = sr_session_new(srtest_ctx, &sess);
+	fail_unless(ret == SR_OK, "sr_session_new() failed: %d.", ret);
+	sr_session_dev_add(sess, sdi);
+	sr_session_datafeed_callback_add(sess, datafeed_in, (void *)o);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	sr_session_destroy(sess);
+
+	sr_output_free(o);
+
+	fail_unless(waitpid(pid, &status, 0) == pid, "waitpid() failed.");
+	fail_unless(WIFEXITED(status), "Reader crashed.");
+	fail_unless(WEXITSTATUS(status) == READER_OK,
+		"Reader failed: %d.", WEXITSTATUS(status));
+}
+END_TEST
+
+Suite *suite_output_shmring(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("output-shmring");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_shmring_payload);
+	tcase_add_test(tc, test_shmring_wraparound);
+	tcase_add_test(tc, test_shmring_overrun);
+	tcase_add_test(tc, test_shmring_attach);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("demo");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 30);
+	tcase_add_test(tc, test_shmring_demo);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
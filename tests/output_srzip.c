@@ -0,0 +1,432 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#define SAMPLERATE SR_MHZ(8)
+
+/* Samples per logic packet sent to the output module. */
+#define PACKET_SAMPLES (1024 * 1024)
+
+#define BASIC_SAMPLES (4 * 1024 * 1024)
+#define BENCH_SAMPLES (64 * 1024 * 1024)
+
+/* UART on channel 0: 115200 baud, a 32 byte message every 5ms. */
+#define UART_BIT_SAMPLES (SAMPLERATE / 115200)
+#define UART_INTERVAL (SAMPLERATE / 200)
+#define UART_MESSAGE_LEN 32
+
+/* SPI on channels 1-3 (CLK, MOSI, CS#): 8 bytes at 1MHz every 20ms. */
+#define SPI_BIT_SAMPLES (SAMPLERATE / SR_MHZ(1))
+#define SPI_INTERVAL (SAMPLERATE / 50)
+#define SPI_MESSAGE_LEN 8
+
+struct load_stats {
+	const uint8_t *expected;
+	int unitsize;
+	uint64_t num_bytes;
+	gboolean data_ok;
+};
+
+static void set_bit(uint8_t *buf, int unitsize, uint64_t start, uint64_t len,
+		uint64_t num_samples, int bit, gboolean value)
+{
+	uint64_t i;
+
+	for (i = start; i < MIN(start + len, num_samples); i++) {
+		if (value)
+			buf[i * unitsize] |= 1 << bit;
+		else
+			buf[i * unitsize] &= ~(1 << bit);
+	}
+}
+
+/*
+ * Logic data as captured from a board talking on a UART and an SPI bus
+ * now and then, idle otherwise. Other channels (and bytes) stay low.
+ */
+static uint8_t *gen_bursty(int unitsize, uint64_t num_samples)
+{
+	uint8_t *buf, byte;
+	uint64_t t, pos;
+	int i, b;
+
+	buf = g_malloc0(num_samples * unitsize);
+	/* Idle UART line and SPI chip select are high. */
+	set_bit(buf, unitsize, 0, num_samples, num_samples, 0, TRUE);
+	set_bit(buf, unitsize, 0, num_samples, num_samples, 3, TRUE);
+
+	for (t = 0; t < num_samples; t += UART_INTERVAL) {
+		pos = t;
+		for (i = 0; i < UART_MESSAGE_LEN; i++) {
+			byte = (t / UART_INTERVAL + i) * 37;
+			/* Start bit, data bits LSB first, stop bit. */
+			set_bit(buf, unitsize, pos, UART_BIT_SAMPLES,
+				num_samples, 0, FALSE);
+			pos += UART_BIT_SAMPLES;
+			for (b = 0; b < 8; b++, pos += UART_BIT_SAMPLES)
+				set_bit(buf, unitsize, pos, UART_BIT_SAMPLES,
+					num_samples, 0, (byte >> b) & 1);
+			pos += UART_BIT_SAMPLES;
+		}
+	}
+
+	for (t = SPI_INTERVAL / 2; t < num_samples; t += SPI_INTERVAL) {
+		set_bit(buf, unitsize, t, SPI_MESSAGE_LEN * 8 * SPI_BIT_SAMPLES,
+			num_samples, 3, FALSE);
+		pos = t;
+		for (i = 0; i < SPI_MESSAGE_LEN; i++) {
+			byte = (t / SPI_INTERVAL + i) * 91;
+			for (b = 7; b >= 0; b--, pos += SPI_BIT_SAMPLES) {
+				set_bit(buf, unitsize, pos, SPI_BIT_SAMPLES,
+					num_samples, 2, (byte >> b) & 1);
+				set_bit(buf, unitsize, pos + SPI_BIT_SAMPLES / 2,
+					SPI_BIT_SAMPLES / 2, num_samples, 1, TRUE);
+			}
+		}
+	}
+
+	return buf;
+}
+
+/* Noise, which no transition list can beat. */
+static uint8_t *gen_dense(int unitsize, uint64_t num_samples)
+{
+	uint8_t *buf;
+	uint64_t i;
+
+	buf = g_malloc(num_samples * unitsize);
+	for (i = 0; i < num_samples * unitsize; i++)
+		buf[i] = (i * 7) ^ (i >> 8);
+
+	return buf;
+}
+
+static struct sr_dev_inst *dev_new(int unitsize)
+{
+	struct sr_dev_inst *sdi;
+	char name[16];
+	int i;
+
+	sdi = sr_dev_inst_user_new("sigrok", "srzip-test", NULL);
+	for (i = 0; i < unitsize * 8; i++) {
+		g_snprintf(name, sizeof(name), "D%d", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+
+	return sdi;
+}
+
+/*
+ * Write the samples to an srzip file; returns the time taken in us.
+ * Without the end packet, the file has no sample counts in its metadata,
+ * like the ones written before those were added.
+ */
+static int64_t save(const char *filename, const uint8_t *buf, int unitsize,
+		uint64_t num_samples, gboolean transitions, gboolean end)
+{
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_datafeed_logic logic;
+	struct sr_config src;
+	GHashTable *opts;
+	GString *out;
+	uint64_t i, n;
+	int64_t start;
+	int ret;
+
+	sdi = dev_new(unitsize);
+	opts = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(opts, "transitions",
+			g_variant_ref_sink(g_variant_new_boolean(transitions)));
+	o = sr_output_new(sr_output_find("srzip"), opts, sdi, filename);
+	g_hash_table_destroy(opts);
+	fail_unless(o != NULL, "Failed to create output instance.");
+
+	start = g_get_monotonic_time();
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_new_uint64(SAMPLERATE);
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	ret = sr_output_send(o, &packet, &out);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = unitsize;
+	for (i = 0; i < num_samples; i += n) {
+		n = MIN(num_samples - i, PACKET_SAMPLES);
+		logic.length = n * unitsize;
+		logic.data = (uint8_t *)buf + i * unitsize;
+		ret = sr_output_send(o, &packet, &out);
+		fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	}
+
+	if (end) {
+		packet.type = SR_DF_END;
+		packet.payload = NULL;
+		ret = sr_output_send(o, &packet, &out);
+		fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	}
+
+	start = g_get_monotonic_time() - start;
+	sr_output_free(o);
+
+	return start;
+}
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct load_stats *stats;
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+
+	stats = cb_data;
+	if (packet->type != SR_DF_LOGIC)
+		return;
+
+	logic = packet->payload;
+	if (logic->unitsize != stats->unitsize || memcmp(logic->data,
+			stats->expected + stats->num_bytes, logic->length))
+		stats->data_ok = FALSE;
+	stats->num_bytes += logic->length;
+}
+
+/* Load the file, and compare it to the samples. Returns the time taken. */
+static int64_t load(const char *filename, const uint8_t *expected,
+		int unitsize, uint64_t num_samples)
+{
+	struct sr_session *sess;
+	struct load_stats stats;
+	int64_t start;
+	int ret;
+
+	stats.expected = expected;
+	stats.unitsize = unitsize;
+	stats.num_bytes = 0;
+	stats.data_ok = TRUE;
+
+	start = g_get_monotonic_time();
+	ret = sr_session_load(srtest_ctx, filename, &sess);
+	fail_unless(ret == SR_OK, "sr_session_load() failed: %d.", ret);
+	sr_session_datafeed_callback_add(sess, datafeed_in, &stats);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	sr_session_destroy(sess);
+	start = g_get_monotonic_time() - start;
+
+	fail_unless(stats.num_bytes == num_samples * unitsize,
+		"Loaded %" PRIu64 " bytes.", stats.num_bytes);
+	fail_unless(stats.data_ok, "Loaded data differs.");
+
+	return start;
+}
+
+static gsize file_size(const char *filename)
+{
+	GStatBuf st;
+
+	fail_unless(g_stat(filename, &st) == 0, "Failed to stat %s.", filename);
+
+	return st.st_size;
+}
+
+static void roundtrip(uint8_t *(*gen)(int, uint64_t), int unitsize,
+		uint64_t num_samples, gboolean transitions, gsize *size)
+{
+	gchar *dir, *filename;
+	uint8_t *buf;
+
+	dir = g_dir_make_tmp("sigrok-test-XXXXXX", NULL);
+	fail_unless(dir != NULL, "Failed to create temporary directory.");
+	filename = g_build_filename(dir, "test.sr", NULL);
+
+	buf = gen(unitsize, num_samples);
+	save(filename, buf, unitsize, num_samples, transitions, TRUE);
+	*size = file_size(filename);
+	load(filename, buf, unitsize, num_samples);
+	g_free(buf);
+
+	g_unlink(filename);
+	g_free(filename);
+	g_rmdir(dir);
+	g_free(dir);
+}
+
+/*
+ * Check whether sparse logic survives the trip through transition
+ * lists, at one and two bytes per sample, and whether it saves space.
+ */
+START_TEST(test_output_srzip_transitions)
+{
+	gsize raw_size, edges_size;
+	int unitsize;
+
+	for (unitsize = 1; unitsize <= 2; unitsize++) {
+		roundtrip(gen_bursty, unitsize, BASIC_SAMPLES, FALSE, &raw_size);
+		roundtrip(gen_bursty, unitsize, BASIC_SAMPLES, TRUE, &edges_size);
+		fail_unless(edges_size < raw_size, "Transition lists take %"
+			G_GSIZE_FORMAT " bytes, raw samples %" G_GSIZE_FORMAT ".",
+			edges_size, raw_size);
+	}
+}
+END_TEST
+
+/* Check whether dense logic is still stored, and loaded, as it is. */
+START_TEST(test_output_srzip_dense)
+{
+	gsize raw_size, size;
+
+	roundtrip(gen_dense, 1, BASIC_SAMPLES, FALSE, &raw_size);
+	roundtrip(gen_dense, 1, BASIC_SAMPLES, TRUE, &size);
+	fail_unless(size == raw_size, "Dense data stored differently.");
+}
+END_TEST
+
+/*
+ * Check the session file summary, from the sample counts in the metadata
+ * and from the chunks (raw and transition lists) of files without them.
+ */
+START_TEST(test_output_srzip_info)
+{
+	struct sr_session_file_info *info;
+	struct sr_channel *ch;
+	gchar *dir, *filename;
+	uint8_t *buf;
+	int ret, mode;
+
+	dir = g_dir_make_tmp("sigrok-test-XXXXXX", NULL);
+	fail_unless(dir != NULL, "Failed to create temporary directory.");
+	filename = g_build_filename(dir, "test.sr", NULL);
+
+	buf = gen_bursty(2, BASIC_SAMPLES);
+	for (mode = 0; mode < 4; mode++) {
+		save(filename, buf, 2, BASIC_SAMPLES, mode & 1, mode & 2);
+		ret = sr_session_file_info(filename, &info);
+		fail_unless(ret == SR_OK, "sr_session_file_info() failed: %d.",
+			ret);
+		fail_unless(info->samplerate == SAMPLERATE, "Samplerate %"
+			PRIu64 ".", info->samplerate);
+		fail_unless(info->unitsize == 2, "Unitsize %d.", info->unitsize);
+		fail_unless(info->logic_samples == BASIC_SAMPLES,
+			"%" PRIu64 " logic samples.", info->logic_samples);
+		fail_unless(info->analog_samples == 0, "%" PRIu64
+			" analog samples.", info->analog_samples);
+		fail_unless(g_slist_length(info->channels) == 16,
+			"%u channels.", g_slist_length(info->channels));
+		ch = g_slist_nth_data(info->channels, 15);
+		fail_unless(ch->index == 15 && ch->enabled &&
+			!strcmp(ch->name, "D15"), "Wrong channel %s.", ch->name);
+		sr_session_file_info_free(info);
+		g_unlink(filename);
+	}
+	g_free(buf);
+
+	g_free(filename);
+	g_rmdir(dir);
+	g_free(dir);
+}
+END_TEST
+
+/*
+ * Time saving, loading and getting the info of a large file, raw and in
+ * transitions. This only runs when LIBSIGROK_TEST_BENCHMARKS is set, and
+ * the figures go to stderr.
+ */
+START_TEST(test_output_srzip_benchmark)
+{
+	struct sr_session_file_info *info;
+	gchar *dir, *filename;
+	uint8_t *buf;
+	int64_t save_us, load_us, info_us;
+	double mbytes;
+	int transitions;
+
+	if (!g_getenv("LIBSIGROK_TEST_BENCHMARKS"))
+		return;
+
+	dir = g_dir_make_tmp("sigrok-test-XXXXXX", NULL);
+	fail_unless(dir != NULL, "Failed to create temporary directory.");
+	filename = g_build_filename(dir, "bench.sr", NULL);
+
+	buf = gen_bursty(1, BENCH_SAMPLES);
+	mbytes = BENCH_SAMPLES / 1e6;
+	for (transitions = 0; transitions <= 1; transitions++) {
+		save_us = save(filename, buf, 1, BENCH_SAMPLES, transitions,
+				TRUE);
+		load_us = load(filename, buf, 1, BENCH_SAMPLES);
+		info_us = g_get_monotonic_time();
+		fail_unless(sr_session_file_info(filename, &info) == SR_OK,
+			"sr_session_file_info() failed.");
+		info_us = g_get_monotonic_time() - info_us;
+		sr_session_file_info_free(info);
+		fprintf(stderr, "srzip %s: %" G_GSIZE_FORMAT
+			" bytes for %.1f MB, write %.1f MB/s, read %.1f MB/s, "
+			"info %" PRId64 " us.\n",
+			transitions ? "transitions" : "raw", file_size(filename),
+			mbytes, mbytes * 1e6 / MAX(save_us, 1),
+			mbytes * 1e6 / MAX(load_us, 1), info_us);
+		g_unlink(filename);
+	}
+	g_free(buf);
+
+	g_free(filename);
+	g_rmdir(dir);
+	g_free(dir);
+}
+END_TEST
+
+Suite *suite_output_srzip(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("output-srzip");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 30);
+	tcase_add_test(tc, test_output_srzip_transitions);
+	tcase_add_test(tc, test_output_srzip_dense);
+	tcase_add_test(tc, test_output_srzip_info);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("benchmark");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 120);
+	tcase_add_test(tc, test_output_srzip_benchmark);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,455 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#define NUM_CHANNELS 2
+#define NUM_FRAMES 50000
+
+/* Size of the header written by the WAV output module. */
+#define OUT_HEADER_SIZE 46
+
+struct output_file {
+	const struct sr_output *o;
+	FILE *f;
+};
+
+static void put_le(GString *s, uint32_t value, int size)
+{
+	int i;
+
+	for (i = 0; i < size; i++)
+		g_string_append_c(s, (value >> (i * 8)) & 0xff);
+}
+
+static uint32_t get_le(const char *p, int size)
+{
+	uint32_t value;
+	int i;
+
+	value = 0;
+	for (i = 0; i < size; i++)
+		value |= (uint32_t)(uint8_t)p[i] << (i * 8);
+
+	return value;
+}
+
+/* The k-th sample of the generated file, going beyond full scale. */
+static float sample_value(uint64_t k)
+{
+	return ((int)(k % 300) - 150) / 100.0;
+}
+
+/* The k-th sample as 16-bit PCM, clamped to full scale. */
+static int16_t pcm16_value(uint64_t k)
+{
+	float v;
+
+	v = sample_value(k) * INT16_MAX;
+	v = MIN(MAX(v, INT16_MIN), INT16_MAX);
+
+	return (int16_t)(v + (v < 0 ? -0.5f : 0.5f));
+}
+
+/* A 32-bit float WAV file, as written by default by the WAV output. */
+static GString *gen_float_wav(void)
+{
+	union { float f; uint32_t u; } f32;
+	GString *s;
+	uint32_t data_size;
+	uint64_t k;
+
+	data_size = NUM_FRAMES * NUM_CHANNELS * 4;
+	s = g_string_new("RIFF");
+	put_le(s, data_size + 36, 4);
+	g_string_append(s, "WAVEfmt ");
+	put_le(s, 16, 4);
+	put_le(s, 3, 2);
+	put_le(s, NUM_CHANNELS, 2);
+	put_le(s, 48000, 4);
+	put_le(s, 48000 * NUM_CHANNELS * 4, 4);
+	put_le(s, NUM_CHANNELS * 4, 2);
+	put_le(s, 32, 2);
+	g_string_append(s, "data");
+	put_le(s, data_size, 4);
+	for (k = 0; k < NUM_FRAMES * NUM_CHANNELS; k++) {
+		f32.f = sample_value(k);
+		put_le(s, f32.u, 4);
+	}
+
+	return s;
+}
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct output_file *of;
+	GString *out;
+	int ret;
+
+	(void)sdi;
+
+	of = cb_data;
+	ret = sr_output_send(of->o, packet, &out);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	if (out) {
+		fwrite(out->str, 1, out->len, of->f);
+		fflush(of->f);
+		g_string_free(out, TRUE);
+	}
+}
+
+/*
+ * Check whether 16-bit PCM output is scaled and clamped correctly, and
+ * whether the sizes in the streamed header are maxed out.
+ */
+START_TEST(test_output_wav_pcm16)
+{
+	const struct sr_input *in;
+	struct sr_session *session;
+	struct output_file of;
+	GHashTable *opts;
+	GString *wav, *header;
+	gchar *dir, *filename, *contents;
+	gsize len;
+	uint64_t k;
+	int ret;
+
+	dir = g_dir_make_tmp("sigrok-test-XXXXXX", NULL);
+	fail_unless(dir != NULL, "Failed to create temporary directory.");
+	filename = g_build_filename(dir, "out.wav", NULL);
+
+	in = sr_input_new(sr_input_find("wav"), NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	wav = gen_float_wav();
+	/* The header and first frame, enough to get the channels set up. */
+	header = g_string_new_len(wav->str, 44 + NUM_CHANNELS * 4);
+	ret = sr_input_send(in, header);
+	fail_unless(ret == SR_OK, "sr_input_send() error: %d.", ret);
+	g_string_free(header, TRUE);
+
+	opts = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(opts, "format",
+			g_variant_ref_sink(g_variant_new_string("pcm16")));
+	of.o = sr_output_new(sr_output_find("wav"), opts,
+			sr_input_dev_inst_get(in), filename);
+	g_hash_table_destroy(opts);
+	fail_unless(of.o != NULL, "Failed to create output instance.");
+	of.f = g_fopen(filename, "wb");
+	fail_unless(of.f != NULL, "Failed to open %s.", filename);
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, &of);
+	sr_session_dev_add(session, sr_input_dev_inst_get(in));
+
+	g_string_erase(wav, 0, 44 + NUM_CHANNELS * 4);
+	ret = sr_input_send(in, wav);
+	fail_unless(ret == SR_OK, "sr_input_send() error: %d.", ret);
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d.", ret);
+
+	fclose(of.f);
+	sr_output_free(of.o);
+	sr_input_free(in);
+	sr_session_destroy(session);
+	g_string_free(wav, TRUE);
+
+	fail_unless(g_file_get_contents(filename, &contents, &len, NULL),
+			"Failed to read %s.", filename);
+	fail_unless(len == OUT_HEADER_SIZE + NUM_FRAMES * NUM_CHANNELS * 2,
+			"Output file has %" G_GSIZE_FORMAT " bytes.", len);
+	fail_unless(get_le(contents + 4, 4) == 0xffffffff, "Wrong RIFF size.");
+	fail_unless(get_le(contents + 20, 2) == 1, "Not a PCM file.");
+	fail_unless(get_le(contents + 34, 2) == 16, "Not 16 bits per sample.");
+	fail_unless(!memcmp(contents + 38, "data", 4), "No data chunk.");
+	fail_unless(get_le(contents + 42, 4) == 0xffffffff,
+			"Wrong data chunk size.");
+	for (k = 0; k < NUM_FRAMES * NUM_CHANNELS; k++) {
+		fail_unless((int16_t)get_le(contents + OUT_HEADER_SIZE + k * 2, 2)
+				== pcm16_value(k), "Sample %" PRIu64 " is wrong.", k);
+	}
+
+	g_free(contents);
+	g_unlink(filename);
+	g_free(filename);
+	g_rmdir(dir);
+	g_free(dir);
+}
+END_TEST
+
+/*
+ * A device with two analog channels, and an integer packet of them. The
+ * channels in the packet can be a subset of the device's, in any order.
+ */
+struct int_feed {
+	struct sr_dev_inst *sdi;
+	GSList *channels;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	struct sr_datafeed_analog analog;
+	struct sr_datafeed_packet packet;
+	int16_t data[2 * 1000];
+};
+
+static void int_feed_init(struct int_feed *feed)
+{
+	memset(feed, 0, sizeof(*feed));
+	feed->sdi = sr_dev_inst_user_new("sigrok", "wav-test", NULL);
+	sr_dev_inst_channel_add(feed->sdi, 0, SR_CHANNEL_ANALOG, "A0");
+	sr_dev_inst_channel_add(feed->sdi, 1, SR_CHANNEL_ANALOG, "A1");
+
+	/* Full scale of 16-bit PCM, so samples map to codes one to one. */
+	feed->encoding.unitsize = sizeof(int16_t);
+	feed->encoding.is_signed = TRUE;
+#ifdef WORDS_BIGENDIAN
+	feed->encoding.is_bigendian = TRUE;
+#endif
+	feed->encoding.scale.p = 1;
+	feed->encoding.scale.q = INT16_MAX;
+	feed->encoding.offset.q = 1;
+	feed->meaning.mq = SR_MQ_VOLTAGE;
+	feed->meaning.unit = SR_UNIT_VOLT;
+	feed->analog.data = feed->data;
+	feed->analog.encoding = &feed->encoding;
+	feed->analog.meaning = &feed->meaning;
+	feed->analog.spec = &feed->spec;
+	feed->packet.type = SR_DF_ANALOG;
+	feed->packet.payload = &feed->analog;
+}
+
+/* The s-th sample of channel c. */
+static int16_t int_value(int c, int s)
+{
+	return (c ? -1000 : 1000) - s;
+}
+
+/*
+ * Send samples first..first + num_samples - 1 of the given channels,
+ * interleaved in that order, and append the output to all.
+ */
+static void int_feed_send(struct int_feed *feed, const struct sr_output *o,
+		const int *chans, int num_chans, int first, int num_samples,
+		GString *all)
+{
+	GString *out;
+	int ret, c, s;
+
+	g_slist_free(feed->channels);
+	feed->channels = NULL;
+	for (c = 0; c < num_chans; c++)
+		feed->channels = g_slist_append(feed->channels, g_slist_nth_data(
+				sr_dev_inst_channels_get(feed->sdi), chans[c]));
+	feed->meaning.channels = feed->channels;
+	for (s = 0; s < num_samples; s++) {
+		for (c = 0; c < num_chans; c++)
+			feed->data[s * num_chans + c] =
+				int_value(chans[c], first + s);
+	}
+	feed->analog.num_samples = num_samples;
+
+	out = NULL;
+	ret = sr_output_send(o, &feed->packet, &out);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	if (out) {
+		g_string_append_len(all, out->str, out->len);
+		g_string_free(out, TRUE);
+	}
+}
+
+static const struct sr_output *int_output_new(struct int_feed *feed,
+		const char *format)
+{
+	const struct sr_output *o;
+	GHashTable *opts;
+
+	opts = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(opts, "format",
+			g_variant_ref_sink(g_variant_new_string(format)));
+	o = sr_output_new(sr_output_find("wav"), opts, feed->sdi, NULL);
+	g_hash_table_destroy(opts);
+	fail_unless(o != NULL, "Failed to create output instance.");
+
+	return o;
+}
+
+static void int_output_end(const struct sr_output *o, GString *all)
+{
+	struct sr_datafeed_packet packet;
+	GString *out;
+	int ret;
+
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	out = NULL;
+	ret = sr_output_send(o, &packet, &out);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	if (out) {
+		g_string_append_len(all, out->str, out->len);
+		g_string_free(out, TRUE);
+	}
+}
+
+/*
+ * Check that a second instance still gets valid option defaults, after
+ * the first one was freed.
+ */
+START_TEST(test_output_wav_options)
+{
+	struct int_feed feed;
+	const struct sr_output *o;
+	const struct sr_option **opts;
+	int i;
+
+	int_feed_init(&feed);
+	for (i = 0; i < 2; i++) {
+		o = int_output_new(&feed, "pcm16");
+		sr_output_free(o);
+	}
+	opts = sr_output_options_get(sr_output_find("wav"));
+	fail_unless(opts != NULL && opts[1] != NULL, "No options.");
+	fail_unless(!strcmp(g_variant_get_string(opts[1]->def, NULL),
+			"float32"), "Wrong default format.");
+	fail_unless(g_slist_length(opts[1]->values) == 3,
+			"Wrong number of formats.");
+	sr_output_options_free(opts);
+	g_slist_free(feed.channels);
+}
+END_TEST
+
+/*
+ * Check that 24-bit PCM from 32-bit integer samples is rounded exactly.
+ * A float only holds 24 bits, which doesn't leave any to round with.
+ */
+START_TEST(test_output_wav_pcm24_int)
+{
+	struct int_feed feed;
+	const struct sr_output *o;
+	GString *all, *out;
+	int32_t data[2 * 100];
+	int64_t n, expected;
+	int ret, k;
+
+	int_feed_init(&feed);
+	feed.encoding.unitsize = sizeof(int32_t);
+	feed.encoding.scale.q = (uint64_t)1 << 31;
+	feed.channels = g_slist_copy(sr_dev_inst_channels_get(feed.sdi));
+	feed.meaning.channels = feed.channels;
+	/* Spread over the full range, with all bits in use. */
+	for (k = 0; k < 2 * 100; k++)
+		data[k] = (int32_t)(0x7ffffff7u - (uint32_t)k * 0x00a3d70bu);
+	feed.analog.data = data;
+	feed.analog.num_samples = 100;
+
+	o = int_output_new(&feed, "pcm24");
+	all = g_string_new(NULL);
+	out = NULL;
+	ret = sr_output_send(o, &feed.packet, &out);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	g_string_append_len(all, out->str, out->len);
+	g_string_free(out, TRUE);
+	int_output_end(o, all);
+	sr_output_free(o);
+
+	fail_unless(all->len == OUT_HEADER_SIZE + 2 * 100 * 3,
+			"Output has %" G_GSIZE_FORMAT " bytes.", all->len);
+	fail_unless(get_le(all->str + 34, 2) == 24, "Not 24 bits per sample.");
+	for (k = 0; k < 2 * 100; k++) {
+		/* Rounded half away from zero, in integer arithmetic. */
+		n = (int64_t)data[k] * 0x7fffff;
+		expected = n >= 0 ? (n + (1 << 30)) >> 31
+				: -((-n + (1 << 30)) >> 31);
+		fail_unless(get_le(all->str + OUT_HEADER_SIZE + k * 3, 3)
+				== ((uint32_t)expected & 0xffffff),
+				"Sample %d is wrong.", k);
+	}
+	g_string_free(all, TRUE);
+	g_slist_free(feed.channels);
+}
+END_TEST
+
+/*
+ * Send packets carrying one channel only, or both in reverse order, and
+ * check that the channels stay aligned in the interleaved output. At the
+ * end, the channel which is behind is padded with silence.
+ */
+START_TEST(test_output_wav_partial)
+{
+	static const int a0[] = { 0 }, a1[] = { 1 }, both[] = { 1, 0 };
+	struct int_feed feed;
+	const struct sr_output *o;
+	GString *all;
+	int16_t expected;
+	int s, c;
+
+	int_feed_init(&feed);
+	o = int_output_new(&feed, "pcm16");
+	all = g_string_new(NULL);
+	int_feed_send(&feed, o, a1, 1, 0, 200, all);
+	int_feed_send(&feed, o, a0, 1, 0, 100, all);
+	/* A1 is ahead: only what A0 has caught up with goes out. */
+	fail_unless(all->len == OUT_HEADER_SIZE + 100 * 2 * 2,
+			"Output has %" G_GSIZE_FORMAT " bytes.", all->len);
+	int_feed_send(&feed, o, a0, 1, 100, 100, all);
+	int_feed_send(&feed, o, both, 2, 200, 50, all);
+	fail_unless(all->len == OUT_HEADER_SIZE + 250 * 2 * 2,
+			"Output has %" G_GSIZE_FORMAT " bytes.", all->len);
+	int_feed_send(&feed, o, a0, 1, 250, 10, all);
+	int_output_end(o, all);
+	sr_output_free(o);
+
+	fail_unless(all->len == OUT_HEADER_SIZE + 260 * 2 * 2,
+			"Output has %" G_GSIZE_FORMAT " bytes.", all->len);
+	for (s = 0; s < 260; s++) {
+		for (c = 0; c < 2; c++) {
+			expected = s >= 250 && c == 1 ? 0 : int_value(c, s);
+			fail_unless((int16_t)get_le(all->str + OUT_HEADER_SIZE
+					+ (s * 2 + c) * 2, 2) == expected,
+					"Sample %d of A%d is wrong.", s, c);
+		}
+	}
+	g_string_free(all, TRUE);
+	g_slist_free(feed.channels);
+}
+END_TEST
+
+Suite *suite_output_wav(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("output-wav");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_output_wav_pcm16);
+	tcase_add_test(tc, test_output_wav_options);
+	tcase_add_test(tc, test_output_wav_pcm24_int);
+	tcase_add_test(tc, test_output_wav_partial);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
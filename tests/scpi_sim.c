@@ -0,0 +1,884 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <check.h>
+#include "scpi_sim.h"
+
+#define SCOPE_YREF	127
+
+uint8_t srtest_scpi_sim_sample(unsigned int channel, uint64_t offset)
+{
+	return (offset * 7 + (offset >> 9) + channel * 61) & 0xff;
+}
+
+float srtest_scpi_sim_volts(uint8_t sample)
+{
+	/* As rigol-ds computes it, at 1V/div and no offset. */
+	return ((int)sample - SCOPE_YREF) * (1.0 / 25.6);
+}
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define HISLIP_HEADER_SIZE	16
+#define HISLIP_VERSION		0x0100
+#define HISLIP_VENDOR_ID	(('S' << 8) | 'R')
+/* Largest message the simulated instrument accepts. */
+#define HISLIP_MAX_MESSAGE_SIZE	4096
+
+/* The message types the server deals with, see src/scpi/scpi_hislip.c. */
+#define HISLIP_INITIALIZE			0
+#define HISLIP_INITIALIZE_RESPONSE		1
+#define HISLIP_DATA				6
+#define HISLIP_DATA_END				7
+#define HISLIP_DEVICE_CLEAR_COMPLETE		8
+#define HISLIP_DEVICE_CLEAR_ACKNOWLEDGE		9
+#define HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE	15
+#define HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE_RESPONSE 16
+#define HISLIP_ASYNC_INITIALIZE			17
+#define HISLIP_ASYNC_INITIALIZE_RESPONSE	18
+#define HISLIP_ASYNC_DEVICE_CLEAR		19
+#define HISLIP_ASYNC_STATUS_QUERY		21
+#define HISLIP_ASYNC_STATUS_RESPONSE		22
+#define HISLIP_ASYNC_DEVICE_CLEAR_ACKNOWLEDGE	23
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+struct connection {
+	int fd;
+	GByteArray *rx;
+	/* Queued messages, the head possibly partly sent. */
+	GQueue tx;
+	size_t tx_offset;
+};
+
+struct srtest_scpi_sim {
+	enum srtest_scpi_sim_transport transport;
+	enum srtest_scpi_sim_instrument instrument;
+	GThread *thread;
+	GMutex mutex;
+	gboolean stop;
+	int wakeup[2];
+	int listener;
+	char *conn;
+
+	/* Synchronous (or only) and asynchronous channel. */
+	struct connection sync;
+	struct connection async;
+	uint16_t session_id;
+	uint64_t client_max_message_size;
+	/* Input discarded until the client completes a device clear. */
+	gboolean clearing;
+	uint64_t clears;
+	/* The command message being received, and the ID of its end. */
+	GString *command;
+	uint32_t message_id;
+
+	/* Commands other than queries, queries, and *OPC? queries, received. */
+	GString *settings;
+	GString *queries;
+	uint64_t opcs;
+	/* Number of :WAV:DATA? queries still to answer with no data. */
+	uint64_t empty_blocks;
+	/* Queries which came in before the previous response was sent. */
+	uint64_t overlaps;
+
+	/* The link: answer latency, and rate limit of the synchronous channel. */
+	uint64_t latency_us;
+	uint64_t bytes_per_sec;
+	/* Until when a :WAV:DATA? query is being prepared, or 0. */
+	int64_t busy_until;
+	/* When the rate limit lets the next bytes go. */
+	int64_t tx_time;
+
+	/* Scope state. */
+	gboolean display[SRTEST_SCPI_SIM_CHANNELS];
+	unsigned int source;
+	uint64_t start;
+	uint64_t stop_at;
+};
+
+static void wake(struct srtest_scpi_sim *sim)
+{
+	if (write(sim->wakeup[1], "w", 1) < 0) {
+		/* The pipe is full, so the thread wakes anyway. */
+	}
+}
+
+static void connection_close(struct connection *c)
+{
+	if (c->fd >= 0)
+		close(c->fd);
+	c->fd = -1;
+	g_byte_array_set_size(c->rx, 0);
+	while (!g_queue_is_empty(&c->tx))
+		g_byte_array_free(g_queue_pop_head(&c->tx), TRUE);
+	c->tx_offset = 0;
+}
+
+/* Drop all queued output, except for what is needed to end a message. */
+static void connection_drop_tx(struct connection *c)
+{
+	GByteArray *head;
+
+	head = c->tx_offset ? g_queue_pop_head(&c->tx) : NULL;
+	while (!g_queue_is_empty(&c->tx))
+		g_byte_array_free(g_queue_pop_head(&c->tx), TRUE);
+	if (head)
+		g_queue_push_head(&c->tx, head);
+}
+
+static void queue_message(struct connection *c, uint8_t type,
+		uint8_t control, uint32_t parameter, const void *payload,
+		uint64_t len)
+{
+	GByteArray *msg;
+	uint8_t hdr[HISLIP_HEADER_SIZE];
+	int i;
+
+	hdr[0] = 'H';
+	hdr[1] = 'S';
+	hdr[2] = type;
+	hdr[3] = control;
+	for (i = 0; i < 4; i++)
+		hdr[4 + i] = parameter >> (24 - 8 * i);
+	for (i = 0; i < 8; i++)
+		hdr[8 + i] = len >> (56 - 8 * i);
+
+	msg = g_byte_array_sized_new(HISLIP_HEADER_SIZE + len);
+	g_byte_array_append(msg, hdr, sizeof(hdr));
+	g_byte_array_append(msg, payload, len);
+	g_queue_push_tail(&c->tx, msg);
+}
+
+static void queue_response(struct srtest_scpi_sim *sim, const uint8_t *data,
+		size_t len)
+{
+	GByteArray *msg;
+	uint8_t prefix[4];
+	size_t max, chunk;
+	int i;
+
+	if (sim->transport == SRTEST_SCPI_SIM_TCP_RIGOL) {
+		for (i = 0; i < 4; i++)
+			prefix[i] = len >> (8 * i);
+		msg = g_byte_array_sized_new(sizeof(prefix) + len);
+		g_byte_array_append(msg, prefix, sizeof(prefix));
+		g_byte_array_append(msg, data, len);
+		g_queue_push_tail(&sim->sync.tx, msg);
+		return;
+	}
+
+	max = MIN(SRTEST_SCPI_SIM_FRAGMENT,
+		sim->client_max_message_size - HISLIP_HEADER_SIZE);
+	do {
+		chunk = MIN(len, max);
+		queue_message(&sim->sync, chunk < len ? HISLIP_DATA :
+			HISLIP_DATA_END, 0, sim->message_id, data, chunk);
+		data += chunk;
+		len -= chunk;
+	} while (len > 0);
+}
+
+static void reply(struct srtest_scpi_sim *sim, const char *format, ...)
+{
+	va_list args;
+	char *text;
+
+	va_start(args, format);
+	text = g_strdup_vprintf(format, args);
+	va_end(args);
+	queue_response(sim, (const uint8_t *)text, strlen(text));
+	g_free(text);
+}
+
+static void reply_waveform(struct srtest_scpi_sim *sim)
+{
+	uint8_t *data;
+	uint64_t start, stop, i;
+	size_t len;
+
+	if (sim->empty_blocks > 0) {
+		/* The scope hasn't copied anything to its output buffer yet. */
+		sim->empty_blocks--;
+		reply(sim, "#9000000000\n");
+		return;
+	}
+
+	start = MAX(sim->start, 1);
+	stop = MIN(sim->stop_at, SRTEST_SCPI_SIM_MEMORY);
+	len = stop >= start ? stop - start + 1 : 0;
+
+	data = g_malloc(11 + len + 1);
+	snprintf((char *)data, 12, "#9%09zu", len);
+	for (i = 0; i < len; i++)
+		data[11 + i] = srtest_scpi_sim_sample(sim->source,
+				start - 1 + i);
+	data[11 + len] = '\n';
+	queue_response(sim, data, 11 + len + 1);
+	g_free(data);
+}
+
+/* Answer a query, as far as the hameg-hmo driver uses it. */
+static void hmo_command(struct srtest_scpi_sim *sim, const char *cmd)
+{
+	unsigned int ch;
+
+	if (sscanf(cmd, ":CHAN%u:STAT?", &ch) == 1 &&
+			ch >= 1 && ch <= SRTEST_SCPI_SIM_CHANNELS)
+		reply(sim, "%d\n", sim->display[ch - 1]);
+	else if (g_str_has_suffix(cmd, ":SCAL?"))
+		/* Both are in the driver's tables in this notation. */
+		reply(sim, g_str_has_prefix(cmd, ":TIM") ? "1.000E-03\n" :
+			"1.000E+00\n");
+	else if (g_str_has_suffix(cmd, ":COUP?"))
+		reply(sim, "DC\n");
+	else if (!strcmp(cmd, ":TRIG:A:SOUR?"))
+		reply(sim, "CH1\n");
+	else if (!strcmp(cmd, ":TRIG:A:EDGE:SLOP?"))
+		reply(sim, "POS\n");
+	else if (g_str_has_suffix(cmd, ":DATA:POINTS?"))
+		reply(sim, "12000\n");
+	else if (g_str_has_suffix(cmd, "?"))
+		reply(sim, "0\n");
+}
+
+/*
+ * Run a command, as far as the rigol-ds driver uses it, or pass it on to
+ * the other instruments.
+ */
+static void scope_command(struct srtest_scpi_sim *sim, const char *cmd)
+{
+	static const char *idns[] = {
+		[SRTEST_SCPI_SIM_RIGOL_DS] = "RIGOL TECHNOLOGIES,DS1054Z,"
+			"DS1ZA000000001,00.04.04.SP4",
+		[SRTEST_SCPI_SIM_HAMEG_HMO] = "HAMEG,HMO1024,000000001,05.886",
+		[SRTEST_SCPI_SIM_RIGOL_DP832] = "RIGOL TECHNOLOGIES,DP832,"
+			"DP8A000000001,00.01.14",
+	};
+	unsigned int ch;
+	unsigned long long n;
+	char state[4];
+
+	if (!g_str_has_suffix(cmd, "?"))
+		g_string_append_printf(sim->settings, "%s\n", cmd);
+	else
+		g_string_append_printf(sim->queries, "%s\n", cmd);
+
+	if (!strcmp(cmd, "*IDN?"))
+		reply(sim, "%s\n", idns[sim->instrument]);
+	else if (!strcmp(cmd, "*OPC?")) {
+		sim->opcs++;
+		reply(sim, "1\n");
+	}
+	else if (!strcmp(cmd, "*ESR?"))
+		reply(sim, "0\n");
+	else if (sim->instrument == SRTEST_SCPI_SIM_HAMEG_HMO)
+		hmo_command(sim, cmd);
+	else if (sim->instrument == SRTEST_SCPI_SIM_RIGOL_DP832) {
+		/* Outputs are off, protections are off, nothing is measured. */
+		if (g_str_has_suffix(cmd, "?"))
+			reply(sim, "0\n");
+	}
+	else if (sscanf(cmd, ":CHAN%u:DISP%3s", &ch, state) == 2 &&
+			ch >= 1 && ch <= SRTEST_SCPI_SIM_CHANNELS &&
+			!strcmp(state, "?"))
+		reply(sim, "%d\n", sim->display[ch - 1]);
+	else if (sscanf(cmd, ":CHAN%u:DISP %3s", &ch, state) == 2 &&
+			ch >= 1 && ch <= SRTEST_SCPI_SIM_CHANNELS)
+		sim->display[ch - 1] = !strcmp(state, "ON");
+	else if (g_str_has_suffix(cmd, ":SCAL?"))
+		reply(sim, "%e\n", g_str_has_prefix(cmd, ":TIM") ? 1e-3 : 1.0);
+	else if (g_str_has_suffix(cmd, ":OFFS?"))
+		reply(sim, "%e\n", 0.0);
+	else if (g_str_has_suffix(cmd, ":COUP?"))
+		reply(sim, "DC\n");
+	else if (!strcmp(cmd, ":TRIG:EDGE:SOUR?"))
+		reply(sim, "CHAN1\n");
+	else if (!strcmp(cmd, ":TRIG:EDGE:SLOP?"))
+		reply(sim, "POS\n");
+	else if (!strcmp(cmd, ":TRIG:STAT?"))
+		/* A single shot is over as soon as it's started. */
+		reply(sim, "STOP\n");
+	else if (sscanf(cmd, ":WAV:SOUR CHAN%u", &ch) == 1)
+		sim->source = ch - 1;
+	else if (sscanf(cmd, ":WAV:START %llu", &n) == 1)
+		sim->start = n;
+	else if (sscanf(cmd, ":WAV:STOP %llu", &n) == 1)
+		sim->stop_at = n;
+	else if (!strcmp(cmd, ":WAV:YREF?"))
+		reply(sim, "%d\n", SCOPE_YREF);
+	else if (!strcmp(cmd, ":WAV:DATA?")) {
+		if (!g_queue_is_empty(&sim->sync.tx))
+			sim->overlaps++;
+		if (sim->latency_us)
+			sim->busy_until = g_get_monotonic_time() +
+				sim->latency_us;
+		else
+			reply_waveform(sim);
+	}
+	else if (g_str_has_suffix(cmd, "?"))
+		reply(sim, "0\n");
+}
+
+/* Run the complete commands, up to one which keeps the scope busy. */
+static void scope_input(struct srtest_scpi_sim *sim, const char *text,
+		size_t len)
+{
+	char *cmd;
+	size_t end;
+
+	g_string_append_len(sim->command, text, len);
+	while (!sim->busy_until) {
+		end = strcspn(sim->command->str, "\r\n");
+		if (end == sim->command->len)
+			break;
+		cmd = g_strndup(sim->command->str, end);
+		g_string_erase(sim->command, 0, end + 1);
+		if (cmd[0])
+			scope_command(sim, cmd);
+		g_free(cmd);
+	}
+}
+
+static uint64_t read_u64(const uint8_t *p)
+{
+	uint64_t v;
+	int i;
+
+	for (v = 0, i = 0; i < 8; i++)
+		v = (v << 8) | p[i];
+
+	return v;
+}
+
+static void hislip_sync_message(struct srtest_scpi_sim *sim, uint8_t type,
+		uint8_t control, uint32_t parameter, const uint8_t *payload,
+		uint64_t len)
+{
+	(void)control;
+
+	switch (type) {
+	case HISLIP_INITIALIZE:
+		queue_message(&sim->sync, HISLIP_INITIALIZE_RESPONSE,
+			sim->transport == SRTEST_SCPI_SIM_HISLIP_OVERLAPPED,
+			(HISLIP_VERSION << 16) | ++sim->session_id, NULL, 0);
+		break;
+	case HISLIP_DATA:
+	case HISLIP_DATA_END:
+		if (sim->clearing)
+			break;
+		sim->message_id = parameter;
+		scope_input(sim, (const char *)payload, len);
+		if (type == HISLIP_DATA_END && sim->command->len)
+			scope_input(sim, "\n", 1);
+		break;
+	case HISLIP_DEVICE_CLEAR_COMPLETE:
+		sim->clearing = FALSE;
+		queue_message(&sim->sync, HISLIP_DEVICE_CLEAR_ACKNOWLEDGE,
+			sim->transport == SRTEST_SCPI_SIM_HISLIP_OVERLAPPED,
+			0, NULL, 0);
+		break;
+	}
+}
+
+static void hislip_async_message(struct srtest_scpi_sim *sim, uint8_t type,
+		uint32_t parameter, const uint8_t *payload, uint64_t len)
+{
+	uint8_t size[8];
+	int i;
+
+	(void)parameter;
+
+	switch (type) {
+	case HISLIP_ASYNC_INITIALIZE:
+		queue_message(&sim->async, HISLIP_ASYNC_INITIALIZE_RESPONSE, 0,
+			HISLIP_VENDOR_ID, NULL, 0);
+		break;
+	case HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE:
+		if (len == 8)
+			sim->client_max_message_size = read_u64(payload);
+		for (i = 0; i < 8; i++)
+			size[i] = (uint64_t)HISLIP_MAX_MESSAGE_SIZE >> (56 - 8 * i);
+		queue_message(&sim->async,
+			HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE_RESPONSE, 0, 0,
+			size, sizeof(size));
+		break;
+	case HISLIP_ASYNC_DEVICE_CLEAR:
+		connection_drop_tx(&sim->sync);
+		g_string_truncate(sim->command, 0);
+		sim->busy_until = 0;
+		sim->clearing = TRUE;
+		sim->clears++;
+		queue_message(&sim->async, HISLIP_ASYNC_DEVICE_CLEAR_ACKNOWLEDGE,
+			sim->transport == SRTEST_SCPI_SIM_HISLIP_OVERLAPPED,
+			0, NULL, 0);
+		break;
+	case HISLIP_ASYNC_STATUS_QUERY:
+		queue_message(&sim->async, HISLIP_ASYNC_STATUS_RESPONSE, 0, 0,
+			NULL, 0);
+		break;
+	}
+}
+
+/* Handle all complete messages received on a HiSLIP connection. */
+static void hislip_input(struct srtest_scpi_sim *sim, struct connection *c)
+{
+	const uint8_t *p;
+	uint64_t len;
+	uint32_t parameter;
+
+	/* A busy scope leaves further messages queued. */
+	while (c->rx->len >= HISLIP_HEADER_SIZE &&
+			!(c == &sim->sync && sim->busy_until)) {
+		p = c->rx->data;
+		len = read_u64(&p[8]);
+		if (c->rx->len < HISLIP_HEADER_SIZE + len)
+			break;
+		parameter = (uint32_t)p[4] << 24 | p[5] << 16 | p[6] << 8 | p[7];
+		if (c == &sim->sync)
+			hislip_sync_message(sim, p[2], p[3], parameter,
+				&p[HISLIP_HEADER_SIZE], len);
+		else
+			hislip_async_message(sim, p[2], parameter,
+				&p[HISLIP_HEADER_SIZE], len);
+		g_byte_array_remove_range(c->rx, 0, HISLIP_HEADER_SIZE + len);
+	}
+}
+
+/*
+ * Both HiSLIP channels connect to the same port. The first message
+ * tells which one a new connection is.
+ */
+static void accept_connection(struct srtest_scpi_sim *sim)
+{
+	struct connection *c;
+	uint8_t hdr[HISLIP_HEADER_SIZE];
+	int fd;
+
+	if ((fd = accept(sim->listener, NULL, NULL)) < 0)
+		return;
+
+	if (sim->transport == SRTEST_SCPI_SIM_TCP_RIGOL) {
+		c = &sim->sync;
+	} else {
+		if (recv(fd, hdr, sizeof(hdr), MSG_PEEK | MSG_WAITALL)
+				!= sizeof(hdr)) {
+			close(fd);
+			return;
+		}
+		c = hdr[2] == HISLIP_ASYNC_INITIALIZE ? &sim->async : &sim->sync;
+	}
+
+	connection_close(c);
+	if (c == &sim->sync) {
+		g_string_truncate(sim->command, 0);
+		sim->busy_until = 0;
+		sim->clearing = FALSE;
+	}
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+	c->fd = fd;
+}
+
+static void receive(struct srtest_scpi_sim *sim, struct connection *c)
+{
+	uint8_t buf[4096];
+	ssize_t len;
+
+	while ((len = recv(c->fd, buf, sizeof(buf), 0)) > 0)
+		g_byte_array_append(c->rx, buf, len);
+	if (len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+		connection_close(c);
+		return;
+	}
+
+	if (sim->transport == SRTEST_SCPI_SIM_TCP_RIGOL) {
+		scope_input(sim, (const char *)c->rx->data, c->rx->len);
+		g_byte_array_set_size(c->rx, 0);
+	} else {
+		hislip_input(sim, c);
+	}
+}
+
+/* Microseconds until the link lets more data go, or -1 for no limit. */
+static int64_t tx_wait(struct srtest_scpi_sim *sim, struct connection *c)
+{
+	if (c != &sim->sync || !sim->bytes_per_sec)
+		return -1;
+
+	return MAX(sim->tx_time - g_get_monotonic_time(), 0);
+}
+
+static void transmit(struct srtest_scpi_sim *sim, struct connection *c)
+{
+	GByteArray *msg;
+	size_t max;
+	ssize_t len;
+	int64_t wait;
+
+	while ((msg = g_queue_peek_head(&c->tx))) {
+		max = msg->len - c->tx_offset;
+		if ((wait = tx_wait(sim, c)) > 0)
+			return;
+		if (wait == 0)
+			/* Let a millisecond's worth go at a time. */
+			max = MIN(max, MAX(sim->bytes_per_sec / 1000, 1));
+		len = send(c->fd, msg->data + c->tx_offset, max, MSG_NOSIGNAL);
+		if (len < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				connection_close(c);
+			return;
+		}
+		if (wait == 0)
+			sim->tx_time = g_get_monotonic_time() +
+				len * G_USEC_PER_SEC / sim->bytes_per_sec;
+		c->tx_offset += len;
+		if (c->tx_offset < msg->len)
+			return;
+		g_byte_array_free(g_queue_pop_head(&c->tx), TRUE);
+		c->tx_offset = 0;
+	}
+}
+
+static gpointer sim_thread(gpointer data)
+{
+	struct srtest_scpi_sim *sim;
+	struct connection *conns[2], *polled[4];
+	struct pollfd fds[4];
+	int64_t wait, tx;
+	int nfds, i;
+	char c;
+
+	sim = data;
+	conns[0] = &sim->sync;
+	conns[1] = &sim->async;
+
+	g_mutex_lock(&sim->mutex);
+	while (!sim->stop) {
+		fds[0].fd = sim->wakeup[0];
+		fds[0].events = POLLIN;
+		fds[1].fd = sim->listener;
+		fds[1].events = POLLIN;
+		nfds = 2;
+		wait = !sim->busy_until ? -1 :
+			MAX(sim->busy_until - g_get_monotonic_time(), 0);
+		for (i = 0; i < 2; i++) {
+			if (conns[i]->fd < 0)
+				continue;
+			fds[nfds].fd = conns[i]->fd;
+			fds[nfds].events = POLLIN;
+			if (!g_queue_is_empty(&conns[i]->tx)) {
+				if ((tx = tx_wait(sim, conns[i])) > 0)
+					wait = wait < 0 ? tx : MIN(wait, tx);
+				else
+					fds[nfds].events |= POLLOUT;
+			}
+			polled[nfds++] = conns[i];
+		}
+		g_mutex_unlock(&sim->mutex);
+
+		/* Round up, so as not to spin until the time has come. */
+		poll(fds, nfds, wait < 0 ? -1 : (int)((wait + 999) / 1000));
+
+		g_mutex_lock(&sim->mutex);
+		while (read(sim->wakeup[0], &c, 1) == 1);
+		if (fds[1].revents & POLLIN)
+			accept_connection(sim);
+		if (sim->busy_until &&
+				g_get_monotonic_time() >= sim->busy_until) {
+			/* Answer, then take the commands held back. */
+			sim->busy_until = 0;
+			reply_waveform(sim);
+			scope_input(sim, "", 0);
+			if (sim->transport != SRTEST_SCPI_SIM_TCP_RIGOL)
+				hislip_input(sim, &sim->sync);
+		}
+		for (i = 2; i < nfds; i++) {
+			/* The connection may have been replaced meanwhile. */
+			if (polled[i]->fd != fds[i].fd)
+				continue;
+			if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+				receive(sim, polled[i]);
+			if (polled[i]->fd >= 0)
+				transmit(sim, polled[i]);
+		}
+	}
+	g_mutex_unlock(&sim->mutex);
+
+	return NULL;
+}
+
+struct srtest_scpi_sim *srtest_scpi_sim_new(
+		enum srtest_scpi_sim_transport transport)
+{
+	return srtest_scpi_sim_new_instrument(transport,
+			SRTEST_SCPI_SIM_RIGOL_DS);
+}
+
+struct srtest_scpi_sim *srtest_scpi_sim_new_instrument(
+		enum srtest_scpi_sim_transport transport,
+		enum srtest_scpi_sim_instrument instrument)
+{
+	struct srtest_scpi_sim *sim;
+	struct sockaddr_in addr;
+	socklen_t addrlen;
+	int i;
+
+	sim = g_malloc0(sizeof(struct srtest_scpi_sim));
+	sim->transport = transport;
+	sim->instrument = instrument;
+	sim->sync.fd = sim->async.fd = -1;
+	sim->sync.rx = g_byte_array_new();
+	sim->async.rx = g_byte_array_new();
+	g_queue_init(&sim->sync.tx);
+	g_queue_init(&sim->async.tx);
+	sim->command = g_string_new(NULL);
+	sim->settings = g_string_new(NULL);
+	sim->queries = g_string_new(NULL);
+	sim->client_max_message_size = G_MAXUINT64;
+	for (i = 0; i < SRTEST_SCPI_SIM_CHANNELS; i++)
+		sim->display[i] = i < 2;
+
+	sim->listener = socket(AF_INET, SOCK_STREAM, 0);
+	fail_unless(sim->listener >= 0, "socket() failed.");
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addrlen = sizeof(addr);
+	fail_unless(bind(sim->listener, (struct sockaddr *)&addr,
+		sizeof(addr)) == 0, "bind() failed: %s.", g_strerror(errno));
+	fail_unless(listen(sim->listener, 4) == 0, "listen() failed.");
+	getsockname(sim->listener, (struct sockaddr *)&addr, &addrlen);
+
+	if (transport == SRTEST_SCPI_SIM_TCP_RIGOL)
+		sim->conn = g_strdup_printf("tcp-rigol/127.0.0.1/%u",
+				ntohs(addr.sin_port));
+	else
+		sim->conn = g_strdup_printf("hislip/127.0.0.1/hislip0,%u",
+				ntohs(addr.sin_port));
+
+	fail_unless(pipe(sim->wakeup) == 0, "pipe() failed.");
+	fcntl(sim->wakeup[0], F_SETFL, O_NONBLOCK);
+	fcntl(sim->wakeup[1], F_SETFL, O_NONBLOCK);
+	g_mutex_init(&sim->mutex);
+	sim->thread = g_thread_new("scpi-sim", sim_thread, sim);
+
+	return sim;
+}
+
+const char *srtest_scpi_sim_conn(const struct srtest_scpi_sim *sim)
+{
+	return sim->conn;
+}
+
+uint64_t srtest_scpi_sim_clears(struct srtest_scpi_sim *sim)
+{
+	uint64_t clears;
+
+	g_mutex_lock(&sim->mutex);
+	clears = sim->clears;
+	g_mutex_unlock(&sim->mutex);
+
+	return clears;
+}
+
+uint64_t srtest_scpi_sim_opcs(struct srtest_scpi_sim *sim)
+{
+	uint64_t opcs;
+
+	g_mutex_lock(&sim->mutex);
+	opcs = sim->opcs;
+	g_mutex_unlock(&sim->mutex);
+
+	return opcs;
+}
+
+void srtest_scpi_sim_empty_blocks(struct srtest_scpi_sim *sim, uint64_t n)
+{
+	g_mutex_lock(&sim->mutex);
+	sim->empty_blocks = n;
+	g_mutex_unlock(&sim->mutex);
+}
+
+void srtest_scpi_sim_link(struct srtest_scpi_sim *sim, uint64_t latency_us,
+		uint64_t bytes_per_sec)
+{
+	g_mutex_lock(&sim->mutex);
+	sim->latency_us = latency_us;
+	sim->bytes_per_sec = bytes_per_sec;
+	g_mutex_unlock(&sim->mutex);
+}
+
+uint64_t srtest_scpi_sim_overlaps(struct srtest_scpi_sim *sim)
+{
+	uint64_t overlaps;
+
+	g_mutex_lock(&sim->mutex);
+	overlaps = sim->overlaps;
+	g_mutex_unlock(&sim->mutex);
+
+	return overlaps;
+}
+
+char *srtest_scpi_sim_take_settings(struct srtest_scpi_sim *sim)
+{
+	char *settings;
+
+	g_mutex_lock(&sim->mutex);
+	settings = g_strdup(sim->settings->str);
+	g_string_truncate(sim->settings, 0);
+	g_mutex_unlock(&sim->mutex);
+
+	return settings;
+}
+
+char *srtest_scpi_sim_take_queries(struct srtest_scpi_sim *sim)
+{
+	char *queries;
+
+	g_mutex_lock(&sim->mutex);
+	queries = g_strdup(sim->queries->str);
+	g_string_truncate(sim->queries, 0);
+	g_mutex_unlock(&sim->mutex);
+
+	return queries;
+}
+
+void srtest_scpi_sim_free(struct srtest_scpi_sim *sim)
+{
+	g_mutex_lock(&sim->mutex);
+	sim->stop = TRUE;
+	g_mutex_unlock(&sim->mutex);
+	wake(sim);
+	g_thread_join(sim->thread);
+
+	connection_close(&sim->sync);
+	connection_close(&sim->async);
+	g_byte_array_free(sim->sync.rx, TRUE);
+	g_byte_array_free(sim->async.rx, TRUE);
+	g_string_free(sim->command, TRUE);
+	g_string_free(sim->settings, TRUE);
+	g_string_free(sim->queries, TRUE);
+	close(sim->listener);
+	close(sim->wakeup[0]);
+	close(sim->wakeup[1]);
+	g_mutex_clear(&sim->mutex);
+	g_free(sim->conn);
+	g_free(sim);
+}
+
+#else
+
+struct srtest_scpi_sim *srtest_scpi_sim_new(
+		enum srtest_scpi_sim_transport transport)
+{
+	(void)transport;
+
+	fail("The SCPI simulator isn't available in this build.");
+
+	return NULL;
+}
+
+struct srtest_scpi_sim *srtest_scpi_sim_new_instrument(
+		enum srtest_scpi_sim_transport transport,
+		enum srtest_scpi_sim_instrument instrument)
+{
+	(void)transport;
+	(void)instrument;
+
+	fail("The SCPI simulator isn't available in this build.");
+
+	return NULL;
+}
+
+const char *srtest_scpi_sim_conn(const struct srtest_scpi_sim *sim)
+{
+	(void)sim;
+
+	return NULL;
+}
+
+uint64_t srtest_scpi_sim_clears(struct srtest_scpi_sim *sim)
+{
+	(void)sim;
+
+	return 0;
+}
+
+uint64_t srtest_scpi_sim_opcs(struct srtest_scpi_sim *sim)
+{
+	(void)sim;
+
+	return 0;
+}
+
+void srtest_scpi_sim_empty_blocks(struct srtest_scpi_sim *sim, uint64_t n)
+{
+	(void)sim;
+	(void)n;
+}
+
+void srtest_scpi_sim_link(struct srtest_scpi_sim *sim, uint64_t latency_us,
+		uint64_t bytes_per_sec)
+{
+	(void)sim;
+	(void)latency_us;
+	(void)bytes_per_sec;
+}
+
+uint64_t srtest_scpi_sim_overlaps(struct srtest_scpi_sim *sim)
+{
+	(void)sim;
+
+	return 0;
+}
+
+char *srtest_scpi_sim_take_settings(struct srtest_scpi_sim *sim)
+{
+	(void)sim;
+
+	return NULL;
+}
+
+char *srtest_scpi_sim_take_queries(struct srtest_scpi_sim *sim)
+{
+	(void)sim;
+
+	return NULL;
+}
+
+void srtest_scpi_sim_free(struct srtest_scpi_sim *sim)
+{
+	(void)sim;
+}
+
+#endif
@@ -0,0 +1,91 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBSIGROK_TESTS_SCPI_SIM_H
+#define LIBSIGROK_TESTS_SCPI_SIM_H
+
+#include <stdint.h>
+#include <glib.h>
+
+/*
+ * A simulated SCPI instrument on a local TCP port, served by a thread.
+ *
+ * The instrument is a Rigol DS1054Z by default, as far as the rigol-ds
+ * driver asks it things. Its sample memory holds srtest_scpi_sim_sample()
+ * on every channel, which reads back as srtest_scpi_sim_volts(). It can
+ * also pose as an oscilloscope or a power supply of other drivers, for
+ * their settings; those have no sample memory.
+ *
+ * The server speaks HiSLIP, in synchronized or overlapped mode, or the
+ * length prefixed protocol of the tcp-rigol transport. The HiSLIP server
+ * sends responses as messages of at most SRTEST_SCPI_SIM_FRAGMENT bytes,
+ * so long ones take several Data messages.
+ */
+
+enum srtest_scpi_sim_transport {
+	SRTEST_SCPI_SIM_HISLIP,
+	SRTEST_SCPI_SIM_HISLIP_OVERLAPPED,
+	SRTEST_SCPI_SIM_TCP_RIGOL,
+};
+
+enum srtest_scpi_sim_instrument {
+	/* Rigol DS1054Z, for rigol-ds. */
+	SRTEST_SCPI_SIM_RIGOL_DS,
+	/* Hameg HMO1024, for hameg-hmo. */
+	SRTEST_SCPI_SIM_HAMEG_HMO,
+	/* Rigol DP832, for scpi-pps. */
+	SRTEST_SCPI_SIM_RIGOL_DP832,
+};
+
+#define SRTEST_SCPI_SIM_FRAGMENT 100000
+
+#define SRTEST_SCPI_SIM_CHANNELS 4
+/* Samples of memory, split evenly between the enabled channels. */
+#define SRTEST_SCPI_SIM_MEMORY 12000000
+
+struct srtest_scpi_sim;
+
+struct srtest_scpi_sim *srtest_scpi_sim_new(
+		enum srtest_scpi_sim_transport transport);
+struct srtest_scpi_sim *srtest_scpi_sim_new_instrument(
+		enum srtest_scpi_sim_transport transport,
+		enum srtest_scpi_sim_instrument instrument);
+const char *srtest_scpi_sim_conn(const struct srtest_scpi_sim *sim);
+uint64_t srtest_scpi_sim_clears(struct srtest_scpi_sim *sim);
+/* Number of *OPC? queries received. */
+uint64_t srtest_scpi_sim_opcs(struct srtest_scpi_sim *sim);
+/* Answer the next n :WAV:DATA? queries with an empty block. */
+void srtest_scpi_sim_empty_blocks(struct srtest_scpi_sim *sim, uint64_t n);
+/*
+ * Take latency_us to start answering each :WAV:DATA? query, taking no
+ * other commands meanwhile, and send at most bytes_per_sec (0 for no
+ * limit).
+ */
+void srtest_scpi_sim_link(struct srtest_scpi_sim *sim, uint64_t latency_us,
+		uint64_t bytes_per_sec);
+/* Number of :WAV:DATA? queries received while a response was being sent. */
+uint64_t srtest_scpi_sim_overlaps(struct srtest_scpi_sim *sim);
+/* Commands other than queries received since the last call, one per line. */
+char *srtest_scpi_sim_take_settings(struct srtest_scpi_sim *sim);
+/* Queries received since the last call, one per line. */
+char *srtest_scpi_sim_take_queries(struct srtest_scpi_sim *sim);
+void srtest_scpi_sim_free(struct srtest_scpi_sim *sim);
+
+uint8_t srtest_scpi_sim_sample(unsigned int channel, uint64_t offset);
+float srtest_scpi_sim_volts(uint8_t sample);
+
+#endif
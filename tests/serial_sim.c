@@ -0,0 +1,1337 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* For posix_openpt() and friends. */
+#define _XOPEN_SOURCE 600
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "serial_sim.h"
+#include "modbus_sim.h"
+
+#if defined(HAVE_LIBSERIALPORT) && !defined(_WIN32)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <libserialport.h>
+
+/* Both DMM protocols use 14 byte frames. */
+#define FRAME_SIZE	14
+
+/* Start bit, eight data bits and a stop bit. */
+#define BITS_PER_BYTE	10
+
+/* Frames a continuously sending meter keeps queued ahead. */
+#define FRAMES_AHEAD	2
+
+/* What the simulated power supplies drive. */
+#define LOAD_OHMS	10.0
+
+struct tx_chunk {
+	/* When the last byte has gone over the line. */
+	int64_t ready_at;
+	/* Measurement number, for meter frames; -1 otherwise. */
+	int64_t seq;
+	size_t len;
+	size_t offset;
+	uint8_t data[];
+};
+
+struct srtest_serial_sim_dev {
+	struct srtest_serial_sim *sim;
+	enum srtest_serial_sim_type type;
+	unsigned int baudrate;
+	int master;
+	char *path;
+	/* The driver has the port open. */
+	gboolean open;
+	/* When the line is free for the next transmission. */
+	int64_t line_free;
+	GQueue tx;
+	GByteArray *rx;
+	uint64_t seq;
+	uint64_t frames_sent;
+	int64_t sent_at[SRTEST_SERIAL_SIM_SEQ_MOD];
+	/* Recorded frames, sent in place of synthesized ones. */
+	uint8_t *frames;
+	size_t num_frames;
+	/* Power supply state. */
+	double voltage;
+	double current;
+	gboolean output;
+	/* Modbus slave state. */
+	struct srtest_modbus_slave *slave;
+	/* Sent in place of the next Modbus reply, if set. */
+	GByteArray *bad_reply;
+};
+
+struct srtest_serial_sim {
+	/* Protects the devices, and the sim thread's view of them. */
+	GMutex mutex;
+	GThread *thread;
+	int wakeup[2];
+	gboolean stop;
+	GPtrArray *devs;
+};
+
+struct sp_port_config {
+	int baudrate;
+	int bits;
+	int parity;
+	int stopbits;
+	int rts;
+	int cts;
+	int dtr;
+	int dsr;
+	int xon_xoff;
+};
+
+struct sp_port {
+	char *name;
+	struct srtest_serial_sim_dev *dev;
+	int fd;
+	/*
+	 * A pty has no line settings worth applying; the simulator paces
+	 * the data itself. The configuration is only kept for reading back.
+	 */
+	struct sp_port_config config;
+};
+
+static const char *type_names[] = {
+	[SRTEST_SERIAL_SIM_FS9721] = "FS9721 DMM",
+	[SRTEST_SERIAL_SIM_METEX14] = "Metex14 DMM",
+	[SRTEST_SERIAL_SIM_KORAD] = "Korad PSU",
+	[SRTEST_SERIAL_SIM_MANSON] = "Manson PSU",
+	[SRTEST_SERIAL_SIM_MAYNUO] = "Maynuo load",
+};
+
+/* Seven segment patterns of the digits 0-9, as FS9721 sends them. */
+static const uint8_t fs9721_digits[] = {
+	0x7d, 0x05, 0x5b, 0x1f, 0x27, 0x3e, 0x7e, 0x15, 0x7f, 0x3f,
+};
+
+static const struct {
+	const char *prefix;
+	size_t arg_len;
+} korad_commands[] = {
+	{ "*IDN?", 0 },
+	{ "IOUT1?", 0 },
+	{ "VOUT1?", 0 },
+	{ "ISET1?", 0 },
+	{ "VSET1?", 0 },
+	{ "STATUS?", 0 },
+	{ "ISET1:", 5 },
+	{ "VSET1:", 5 },
+	{ "OUT", 1 },
+	{ "BEEP", 1 },
+	{ "OCP", 1 },
+	{ "OVP", 1 },
+	{ "SAV", 1 },
+	{ "RCL", 1 },
+};
+
+/* Only one simulator exists at a time; the sp_*() functions use it. */
+static struct srtest_serial_sim *sim_current;
+static int last_error;
+static gboolean shim_called;
+
+static void set_raw(int fd)
+{
+	struct termios tio;
+
+	if (tcgetattr(fd, &tio) < 0)
+		return;
+	tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR
+			| ICRNL | IXON);
+	tio.c_oflag &= ~OPOST;
+	tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+	tio.c_cflag &= ~(CSIZE | PARENB);
+	tio.c_cflag |= CS8;
+	tcsetattr(fd, TCSANOW, &tio);
+}
+
+static void wake(struct srtest_serial_sim *sim)
+{
+	if (write(sim->wakeup[1], "w", 1) < 0) {
+		/* The pipe is full, so the thread wakes anyway. */
+	}
+}
+
+static int64_t line_time(const struct srtest_serial_sim_dev *dev, size_t len)
+{
+	if (!dev->baudrate)
+		return 0;
+
+	return (int64_t)len * BITS_PER_BYTE * 1000000 / dev->baudrate;
+}
+
+static void tx_clear(struct srtest_serial_sim_dev *dev)
+{
+	g_queue_foreach(&dev->tx, (GFunc)g_free, NULL);
+	g_queue_clear(&dev->tx);
+}
+
+static void queue_tx(struct srtest_serial_sim_dev *dev, const void *data,
+		size_t len, int64_t seq, int64_t now)
+{
+	struct tx_chunk *chunk;
+
+	chunk = g_malloc(sizeof(struct tx_chunk) + len);
+	memcpy(chunk->data, data, len);
+	chunk->len = len;
+	chunk->offset = 0;
+	chunk->seq = seq;
+	dev->line_free = MAX(dev->line_free, now) + line_time(dev, len);
+	chunk->ready_at = dev->line_free;
+	g_queue_push_tail(&dev->tx, chunk);
+}
+
+static void queue_reply(struct srtest_serial_sim_dev *dev, const char *reply,
+		int64_t now)
+{
+	queue_tx(dev, reply, strlen(reply), -1, now);
+}
+
+/* "x.xxx V DC", showing the measurement number. */
+static void fs9721_frame(uint8_t *buf, uint64_t seq)
+{
+	unsigned int value, seg;
+	int i;
+
+	value = seq % SRTEST_SERIAL_SIM_SEQ_MOD;
+	memset(buf, 0, FRAME_SIZE);
+	/* DC, AUTO, RS232 */
+	buf[0] = (1 << 2) | (1 << 1) | (1 << 0);
+	for (i = 3; i >= 0; i--) {
+		seg = fs9721_digits[value % 10];
+		value /= 10;
+		buf[1 + 2 * i] = (seg >> 4) & 0x07;
+		buf[2 + 2 * i] = seg & 0x0f;
+	}
+	/* Decimal point after the first digit. */
+	buf[3] |= 1 << 3;
+	/* V */
+	buf[12] = 1 << 2;
+	/* Sync nibbles */
+	for (i = 0; i < FRAME_SIZE; i++)
+		buf[i] |= (i + 1) << 4;
+}
+
+static void metex14_frame(uint8_t *buf, uint64_t seq)
+{
+	char frame[FRAME_SIZE + 1];
+	unsigned int value;
+
+	value = seq % SRTEST_SERIAL_SIM_SEQ_MOD;
+	snprintf(frame, sizeof(frame), "DC  %u.%03u   V\r",
+		value / 1000, value % 1000);
+	memcpy(buf, frame, FRAME_SIZE);
+}
+
+static void queue_frame(struct srtest_serial_sim_dev *dev, int64_t now)
+{
+	uint8_t buf[FRAME_SIZE];
+
+	if (dev->num_frames)
+		memcpy(buf, dev->frames + (dev->seq % dev->num_frames) * FRAME_SIZE,
+			FRAME_SIZE);
+	else if (dev->type == SRTEST_SERIAL_SIM_FS9721)
+		fs9721_frame(buf, dev->seq);
+	else
+		metex14_frame(buf, dev->seq);
+
+	queue_tx(dev, buf, FRAME_SIZE, dev->seq++, now);
+}
+
+static double load_current(const struct srtest_serial_sim_dev *dev)
+{
+	if (!dev->output)
+		return 0;
+
+	return MIN(dev->voltage / LOAD_OHMS, dev->current);
+}
+
+static gboolean constant_current(const struct srtest_serial_sim_dev *dev)
+{
+	return dev->output && dev->voltage / LOAD_OHMS > dev->current;
+}
+
+static void korad_command(struct srtest_serial_sim_dev *dev, const char *cmd,
+		const char *arg, int64_t now)
+{
+	char reply[G_ASCII_DTOSTR_BUF_SIZE];
+
+	if (!strcmp(cmd, "*IDN?")) {
+		/* The longest ID the driver knows, so its read completes. */
+		queue_reply(dev, "VELLEMANLABPS3005DV2.0", now);
+	} else if (!strcmp(cmd, "IOUT1?")) {
+		queue_reply(dev, g_ascii_formatd(reply, sizeof(reply), "%05.3f",
+			load_current(dev)), now);
+	} else if (!strcmp(cmd, "VOUT1?")) {
+		queue_reply(dev, g_ascii_formatd(reply, sizeof(reply), "%05.2f",
+			dev->output ? dev->voltage : 0), now);
+	} else if (!strcmp(cmd, "ISET1?")) {
+		queue_reply(dev, g_ascii_formatd(reply, sizeof(reply), "%05.3f",
+			dev->current), now);
+	} else if (!strcmp(cmd, "VSET1?")) {
+		queue_reply(dev, g_ascii_formatd(reply, sizeof(reply), "%05.2f",
+			dev->voltage), now);
+	} else if (!strcmp(cmd, "STATUS?")) {
+		reply[0] = constant_current(dev) ? 0 : (1 << 0);
+		reply[0] |= dev->output ? (1 << 6) : 0;
+		queue_tx(dev, reply, 1, -1, now);
+	} else if (!strcmp(cmd, "ISET1:")) {
+		dev->current = g_ascii_strtod(arg, NULL);
+	} else if (!strcmp(cmd, "VSET1:")) {
+		dev->voltage = g_ascii_strtod(arg, NULL);
+	} else if (!strcmp(cmd, "OUT")) {
+		dev->output = arg[0] == '1';
+	}
+}
+
+/* Korad commands have no terminator; tell them apart by their prefix. */
+static void korad_receive(struct srtest_serial_sim_dev *dev, int64_t now)
+{
+	char arg[8];
+	size_t prefix_len, len;
+	unsigned int i;
+	gboolean incomplete;
+	int match;
+
+	while (dev->rx->len > 0) {
+		match = -1;
+		incomplete = FALSE;
+		for (i = 0; i < G_N_ELEMENTS(korad_commands); i++) {
+			prefix_len = strlen(korad_commands[i].prefix);
+			if (memcmp(dev->rx->data, korad_commands[i].prefix,
+					MIN(dev->rx->len, prefix_len)))
+				continue;
+			if (dev->rx->len < prefix_len + korad_commands[i].arg_len) {
+				incomplete = TRUE;
+				continue;
+			}
+			match = i;
+			break;
+		}
+		if (match < 0) {
+			if (incomplete)
+				return;
+			g_byte_array_remove_index(dev->rx, 0);
+			continue;
+		}
+		prefix_len = strlen(korad_commands[match].prefix);
+		len = korad_commands[match].arg_len;
+		memcpy(arg, dev->rx->data + prefix_len, len);
+		arg[len] = '\0';
+		korad_command(dev, korad_commands[match].prefix, arg, now);
+		g_byte_array_remove_range(dev->rx, 0, prefix_len + len);
+	}
+}
+
+static void manson_command(struct srtest_serial_sim_dev *dev, const char *cmd,
+		int64_t now)
+{
+	char reply[32];
+
+	if (!strcmp(cmd, "GMOD")) {
+		queue_reply(dev, "3102\rOK\r", now);
+	} else if (!strcmp(cmd, "GETD")) {
+		snprintf(reply, sizeof(reply), "%04d%04d%d\rOK\r",
+			(int)(dev->output ? dev->voltage * 100 + 0.5 : 0),
+			(int)(load_current(dev) * 100 + 0.5),
+			constant_current(dev) ? 1 : 0);
+		queue_reply(dev, reply, now);
+	} else if (!strcmp(cmd, "GMAX")) {
+		/* 36.0V, 5.00A */
+		queue_reply(dev, "360500\rOK\r", now);
+	} else if (g_str_has_prefix(cmd, "VOLT")) {
+		dev->voltage = strtol(cmd + 4, NULL, 10) / 10.0;
+		queue_reply(dev, "OK\r", now);
+	} else if (g_str_has_prefix(cmd, "CURR")) {
+		dev->current = strtol(cmd + 4, NULL, 10) / 100.0;
+		queue_reply(dev, "OK\r", now);
+	} else if (g_str_has_prefix(cmd, "SOUT")) {
+		/* SOUT0 switches the output on. */
+		dev->output = cmd[4] == '0';
+		queue_reply(dev, "OK\r", now);
+	}
+}
+
+static void manson_receive(struct srtest_serial_sim_dev *dev, int64_t now)
+{
+	uint8_t *end;
+	char *cmd;
+	size_t len;
+
+	while ((end = memchr(dev->rx->data, '\r', dev->rx->len))) {
+		len = end - dev->rx->data;
+		cmd = g_strndup((const char *)dev->rx->data, len);
+		manson_command(dev, cmd, now);
+		g_free(cmd);
+		g_byte_array_remove_range(dev->rx, 0, len + 1);
+	}
+}
+
+/* Modbus RTU: slave address, PDU, CRC. Garbled frames are skipped. */
+static void maynuo_receive(struct srtest_serial_sim_dev *dev, int64_t now)
+{
+	uint8_t reply[1 + 253 + 2];
+	size_t pdu_len, len;
+	uint16_t crc;
+
+	while (dev->rx->len >= 2) {
+		pdu_len = srtest_modbus_pdu_len(dev->rx->data + 1,
+				dev->rx->len - 1);
+		if (!pdu_len || dev->rx->len < 1 + pdu_len + 2)
+			return;
+		len = 1 + pdu_len + 2;
+		if (srtest_modbus_crc(dev->rx->data, len) != 0) {
+			g_byte_array_remove_index(dev->rx, 0);
+			continue;
+		}
+		if (dev->rx->data[0] == SRTEST_MODBUS_SIM_UNIT && dev->bad_reply) {
+			/* The slave never sees this request. */
+			queue_tx(dev, dev->bad_reply->data, dev->bad_reply->len,
+				-1, now);
+			g_byte_array_free(dev->bad_reply, TRUE);
+			dev->bad_reply = NULL;
+		} else if (dev->rx->data[0] == SRTEST_MODBUS_SIM_UNIT) {
+			reply[0] = SRTEST_MODBUS_SIM_UNIT;
+			pdu_len = srtest_modbus_slave_pdu(dev->slave,
+					dev->rx->data + 1, pdu_len, reply + 1);
+			crc = srtest_modbus_crc(reply, 1 + pdu_len);
+			reply[1 + pdu_len] = crc & 0xFF;
+			reply[2 + pdu_len] = crc >> 8;
+			queue_tx(dev, reply, 3 + pdu_len, -1, now);
+		}
+		g_byte_array_remove_range(dev->rx, 0, len);
+	}
+}
+
+static void receive(struct srtest_serial_sim_dev *dev, int64_t now)
+{
+	uint8_t buf[256];
+	ssize_t len, i;
+
+	while ((len = read(dev->master, buf, sizeof(buf))) > 0) {
+		if (dev->type != SRTEST_SERIAL_SIM_METEX14) {
+			g_byte_array_append(dev->rx, buf, len);
+			continue;
+		}
+		for (i = 0; i < len; i++) {
+			if (buf[i] == 'D')
+				queue_frame(dev, now);
+		}
+	}
+
+	if (dev->type == SRTEST_SERIAL_SIM_KORAD)
+		korad_receive(dev, now);
+	else if (dev->type == SRTEST_SERIAL_SIM_MANSON)
+		manson_receive(dev, now);
+	else if (dev->type == SRTEST_SERIAL_SIM_MAYNUO)
+		maynuo_receive(dev, now);
+}
+
+/*
+ * Write whatever is due. Returns TRUE if the pty is full, and
+ * otherwise updates next_wake with when the next chunk is due.
+ */
+static gboolean transmit(struct srtest_serial_sim_dev *dev, int64_t now,
+		int64_t *next_wake)
+{
+	struct tx_chunk *chunk;
+	ssize_t ret;
+
+	while ((chunk = g_queue_peek_head(&dev->tx))) {
+		if (chunk->ready_at > now) {
+			*next_wake = MIN(*next_wake, chunk->ready_at);
+			return FALSE;
+		}
+		ret = write(dev->master, chunk->data + chunk->offset,
+				chunk->len - chunk->offset);
+		if (ret < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				return TRUE;
+			/* Nobody to receive it. */
+			ret = chunk->len - chunk->offset;
+		}
+		chunk->offset += ret;
+		if (chunk->offset < chunk->len)
+			return TRUE;
+		if (chunk->seq >= 0) {
+			dev->sent_at[chunk->seq % SRTEST_SERIAL_SIM_SEQ_MOD] =
+				g_get_monotonic_time();
+			dev->frames_sent++;
+		}
+		g_free(g_queue_pop_head(&dev->tx));
+	}
+
+	return FALSE;
+}
+
+static gpointer sim_thread(gpointer data)
+{
+	struct srtest_serial_sim *sim;
+	struct srtest_serial_sim_dev *dev, **polled;
+	struct pollfd *fds;
+	int64_t now, next_wake;
+	int nfds, timeout, i;
+	guint j;
+	char c;
+
+	sim = data;
+	fds = NULL;
+	polled = NULL;
+
+	g_mutex_lock(&sim->mutex);
+	while (!sim->stop) {
+		fds = g_renew(struct pollfd, fds, sim->devs->len + 1);
+		polled = g_renew(struct srtest_serial_sim_dev *, polled,
+				sim->devs->len + 1);
+		fds[0].fd = sim->wakeup[0];
+		fds[0].events = POLLIN;
+		nfds = 1;
+		now = g_get_monotonic_time();
+		next_wake = G_MAXINT64;
+		for (j = 0; j < sim->devs->len; j++) {
+			dev = g_ptr_array_index(sim->devs, j);
+			if (!dev->open)
+				continue;
+			if (dev->type == SRTEST_SERIAL_SIM_FS9721) {
+				while (g_queue_get_length(&dev->tx) < FRAMES_AHEAD)
+					queue_frame(dev, now);
+			}
+			fds[nfds].fd = dev->master;
+			fds[nfds].events = POLLIN;
+			if (transmit(dev, now, &next_wake))
+				fds[nfds].events |= POLLOUT;
+			polled[nfds++] = dev;
+		}
+		g_mutex_unlock(&sim->mutex);
+
+		if (next_wake == G_MAXINT64)
+			timeout = -1;
+		else
+			timeout = (next_wake - now + 999) / 1000;
+		poll(fds, nfds, timeout);
+
+		g_mutex_lock(&sim->mutex);
+		while (read(sim->wakeup[0], &c, 1) == 1);
+		now = g_get_monotonic_time();
+		for (i = 1; i < nfds; i++) {
+			if ((fds[i].revents & POLLIN) && polled[i]->open)
+				receive(polled[i], now);
+		}
+	}
+	g_mutex_unlock(&sim->mutex);
+
+	g_free(fds);
+	g_free(polled);
+
+	return NULL;
+}
+
+static enum sp_return sp_fail(void)
+{
+	last_error = errno;
+
+	return SP_ERR_FAIL;
+}
+
+/* Waits for the fd to become ready; 0 if the deadline passes first. */
+static int wait_fd(int fd, short events, int64_t deadline)
+{
+	struct pollfd pfd;
+	int64_t left;
+	int ret;
+
+	pfd.fd = fd;
+	pfd.events = events;
+	do {
+		left = -1;
+		if (deadline) {
+			left = deadline - g_get_monotonic_time();
+			if (left <= 0)
+				return 0;
+			left = (left + 999) / 1000;
+		}
+		ret = poll(&pfd, 1, left);
+	} while (ret < 0 && errno == EINTR);
+
+	return ret;
+}
+
+static struct sp_port *port_new(struct srtest_serial_sim_dev *dev)
+{
+	struct sp_port *port;
+
+	port = g_malloc0(sizeof(struct sp_port));
+	port->name = g_strdup(dev->path);
+	port->dev = dev;
+	port->fd = -1;
+	port->config.baudrate = 9600;
+	port->config.bits = 8;
+	port->config.parity = SP_PARITY_NONE;
+	port->config.stopbits = 1;
+
+	return port;
+}
+
+/*
+ * The libserialport API, as far as libsigrok uses it, for the simulated
+ * ports only. These definitions take precedence over those in the
+ * libserialport shared library, and have to be exported from the test
+ * binary, which is built with -fvisibility=hidden.
+ */
+#pragma GCC visibility push(default)
+
+enum sp_return sp_get_port_by_name(const char *portname,
+		struct sp_port **port_ptr)
+{
+	struct srtest_serial_sim_dev *dev;
+	guint i;
+
+	if (!port_ptr)
+		return SP_ERR_ARG;
+	*port_ptr = NULL;
+	if (!portname || !sim_current)
+		return SP_ERR_ARG;
+
+	for (i = 0; i < sim_current->devs->len; i++) {
+		dev = g_ptr_array_index(sim_current->devs, i);
+		if (!strcmp(dev->path, portname)) {
+			*port_ptr = port_new(dev);
+			return SP_OK;
+		}
+	}
+
+	return SP_ERR_ARG;
+}
+
+void sp_free_port(struct sp_port *port)
+{
+	if (!port)
+		return;
+	g_free(port->name);
+	g_free(port);
+}
+
+enum sp_return sp_list_ports(struct sp_port ***list_ptr)
+{
+	struct sp_port **list;
+	guint i, num;
+
+	shim_called = TRUE;
+
+	if (!list_ptr)
+		return SP_ERR_ARG;
+
+	num = sim_current ? sim_current->devs->len : 0;
+	list = g_malloc0((num + 1) * sizeof(struct sp_port *));
+	for (i = 0; i < num; i++)
+		list[i] = port_new(g_ptr_array_index(sim_current->devs, i));
+	*list_ptr = list;
+
+	return SP_OK;
+}
+
+void sp_free_port_list(struct sp_port **ports)
+{
+	int i;
+
+	if (!ports)
+		return;
+	for (i = 0; ports[i]; i++)
+		sp_free_port(ports[i]);
+	g_free(ports);
+}
+
+enum sp_return sp_open(struct sp_port *port, enum sp_mode flags)
+{
+	struct srtest_serial_sim_dev *dev;
+	struct srtest_serial_sim *sim;
+	int fd;
+
+	(void)flags;
+
+	if (!port || port->fd >= 0)
+		return SP_ERR_ARG;
+	dev = port->dev;
+	sim = dev->sim;
+
+	g_mutex_lock(&sim->mutex);
+	/* Whatever either end left behind is gone, as on a real port. */
+	tcflush(dev->master, TCIOFLUSH);
+	tx_clear(dev);
+	g_byte_array_set_size(dev->rx, 0);
+	if ((fd = open(port->name, O_RDWR | O_NOCTTY | O_NONBLOCK)) < 0) {
+		g_mutex_unlock(&sim->mutex);
+		return sp_fail();
+	}
+	set_raw(fd);
+	port->fd = fd;
+	dev->open = TRUE;
+	dev->line_free = g_get_monotonic_time();
+	g_mutex_unlock(&sim->mutex);
+	wake(sim);
+
+	return SP_OK;
+}
+
+enum sp_return sp_close(struct sp_port *port)
+{
+	struct srtest_serial_sim_dev *dev;
+	struct srtest_serial_sim *sim;
+
+	if (!port || port->fd < 0)
+		return SP_ERR_ARG;
+	dev = port->dev;
+	sim = dev->sim;
+
+	g_mutex_lock(&sim->mutex);
+	tcflush(port->fd, TCIOFLUSH);
+	close(port->fd);
+	port->fd = -1;
+	dev->open = FALSE;
+	tx_clear(dev);
+	g_mutex_unlock(&sim->mutex);
+	wake(sim);
+
+	return SP_OK;
+}
+
+char *sp_get_port_name(const struct sp_port *port)
+{
+	return port ? port->name : NULL;
+}
+
+char *sp_get_port_description(const struct sp_port *port)
+{
+	return port ? (char *)type_names[port->dev->type] : NULL;
+}
+
+enum sp_transport sp_get_port_transport(const struct sp_port *port)
+{
+	(void)port;
+
+	return SP_TRANSPORT_NATIVE;
+}
+
+enum sp_return sp_get_port_usb_vid_pid(const struct sp_port *port,
+		int *usb_vid, int *usb_pid)
+{
+	(void)port;
+	(void)usb_vid;
+	(void)usb_pid;
+
+	return SP_ERR_ARG;
+}
+
+enum sp_return sp_new_config(struct sp_port_config **config_ptr)
+{
+	struct sp_port_config *config;
+
+	if (!config_ptr)
+		return SP_ERR_ARG;
+
+	config = g_malloc(sizeof(struct sp_port_config));
+	config->baudrate = config->bits = config->stopbits = -1;
+	config->parity = SP_PARITY_INVALID;
+	config->rts = SP_RTS_INVALID;
+	config->cts = SP_CTS_INVALID;
+	config->dtr = SP_DTR_INVALID;
+	config->dsr = SP_DSR_INVALID;
+	config->xon_xoff = SP_XONXOFF_INVALID;
+	*config_ptr = config;
+
+	return SP_OK;
+}
+
+void sp_free_config(struct sp_port_config *config)
+{
+	g_free(config);
+}
+
+enum sp_return sp_get_config(struct sp_port *port,
+		struct sp_port_config *config)
+{
+	if (!port || port->fd < 0 || !config)
+		return SP_ERR_ARG;
+
+	*config = port->config;
+
+	return SP_OK;
+}
+
+enum sp_return sp_set_config(struct sp_port *port,
+		const struct sp_port_config *config)
+{
+	if (!port || port->fd < 0 || !config)
+		return SP_ERR_ARG;
+
+	/* Negative values leave a setting as it is. */
+	if (config->baudrate >= 0)
+		port->config.baudrate = config->baudrate;
+	if (config->bits >= 0)
+		port->config.bits = config->bits;
+	if (config->parity >= 0)
+		port->config.parity = config->parity;
+	if (config->stopbits >= 0)
+		port->config.stopbits = config->stopbits;
+	if (config->rts >= 0)
+		port->config.rts = config->rts;
+	if (config->cts >= 0)
+		port->config.cts = config->cts;
+	if (config->dtr >= 0)
+		port->config.dtr = config->dtr;
+	if (config->dsr >= 0)
+		port->config.dsr = config->dsr;
+	if (config->xon_xoff >= 0)
+		port->config.xon_xoff = config->xon_xoff;
+
+	return SP_OK;
+}
+
+enum sp_return sp_set_config_baudrate(struct sp_port_config *config,
+		int baudrate)
+{
+	if (!config)
+		return SP_ERR_ARG;
+	config->baudrate = baudrate;
+
+	return SP_OK;
+}
+
+enum sp_return sp_get_config_baudrate(const struct sp_port_config *config,
+		int *baudrate_ptr)
+{
+	if (!config || !baudrate_ptr)
+		return SP_ERR_ARG;
+	*baudrate_ptr = config->baudrate;
+
+	return SP_OK;
+}
+
+enum sp_return sp_set_config_bits(struct sp_port_config *config, int bits)
+{
+	if (!config)
+		return SP_ERR_ARG;
+	config->bits = bits;
+
+	return SP_OK;
+}
+
+enum sp_return sp_get_config_bits(const struct sp_port_config *config,
+		int *bits_ptr)
+{
+	if (!config || !bits_ptr)
+		return SP_ERR_ARG;
+	*bits_ptr = config->bits;
+
+	return SP_OK;
+}
+
+enum sp_return sp_set_config_parity(struct sp_port_config *config,
+		enum sp_parity parity)
+{
+	if (!config)
+		return SP_ERR_ARG;
+	config->parity = parity;
+
+	return SP_OK;
+}
+
+enum sp_return sp_set_config_stopbits(struct sp_port_config *config,
+		int stopbits)
+{
+	if (!config)
+		return SP_ERR_ARG;
+	config->stopbits = stopbits;
+
+	return SP_OK;
+}
+
+enum sp_return sp_get_config_stopbits(const struct sp_port_config *config,
+		int *stopbits_ptr)
+{
+	if (!config || !stopbits_ptr)
+		return SP_ERR_ARG;
+	*stopbits_ptr = config->stopbits;
+
+	return SP_OK;
+}
+
+enum sp_return sp_set_config_rts(struct sp_port_config *config,
+		enum sp_rts rts)
+{
+	if (!config)
+		return SP_ERR_ARG;
+	config->rts = rts;
+
+	return SP_OK;
+}
+
+enum sp_return sp_set_config_cts(struct sp_port_config *config,
+		enum sp_cts cts)
+{
+	if (!config)
+		return SP_ERR_ARG;
+	config->cts = cts;
+
+	return SP_OK;
+}
+
+enum sp_return sp_set_config_dtr(struct sp_port_config *config,
+		enum sp_dtr dtr)
+{
+	if (!config)
+		return SP_ERR_ARG;
+	config->dtr = dtr;
+
+	return SP_OK;
+}
+
+enum sp_return sp_set_config_dsr(struct sp_port_config *config,
+		enum sp_dsr dsr)
+{
+	if (!config)
+		return SP_ERR_ARG;
+	config->dsr = dsr;
+
+	return SP_OK;
+}
+
+enum sp_return sp_set_config_xon_xoff(struct sp_port_config *config,
+		enum sp_xonxoff xon_xoff)
+{
+	if (!config)
+		return SP_ERR_ARG;
+	config->xon_xoff = xon_xoff;
+
+	return SP_OK;
+}
+
+enum sp_return sp_blocking_read(struct sp_port *port, void *buf,
+		size_t count, unsigned int timeout_ms)
+{
+	int64_t deadline;
+	size_t done;
+	ssize_t ret;
+
+	if (!port || port->fd < 0 || !buf)
+		return SP_ERR_ARG;
+
+	deadline = timeout_ms ? g_get_monotonic_time() + timeout_ms * 1000 : 0;
+	done = 0;
+	while (done < count) {
+		ret = read(port->fd, (uint8_t *)buf + done, count - done);
+		if (ret > 0) {
+			done += ret;
+			continue;
+		}
+		if (ret < 0 && errno != EAGAIN && errno != EINTR)
+			return sp_fail();
+		if (wait_fd(port->fd, POLLIN, deadline) == 0)
+			break;
+	}
+
+	return done;
+}
+
+enum sp_return sp_nonblocking_read(struct sp_port *port, void *buf,
+		size_t count)
+{
+	ssize_t ret;
+
+	if (!port || port->fd < 0 || !buf)
+		return SP_ERR_ARG;
+
+	if ((ret = read(port->fd, buf, count)) < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 0;
+		return sp_fail();
+	}
+
+	return ret;
+}
+
+enum sp_return sp_blocking_write(struct sp_port *port, const void *buf,
+		size_t count, unsigned int timeout_ms)
+{
+	int64_t deadline;
+	size_t done;
+	ssize_t ret;
+
+	if (!port || port->fd < 0 || !buf)
+		return SP_ERR_ARG;
+
+	deadline = timeout_ms ? g_get_monotonic_time() + timeout_ms * 1000 : 0;
+	done = 0;
+	while (done < count) {
+		ret = write(port->fd, (const uint8_t *)buf + done, count - done);
+		if (ret > 0) {
+			done += ret;
+			continue;
+		}
+		if (ret < 0 && errno != EAGAIN && errno != EINTR)
+			return sp_fail();
+		if (wait_fd(port->fd, POLLOUT, deadline) == 0)
+			break;
+	}
+
+	return done;
+}
+
+enum sp_return sp_nonblocking_write(struct sp_port *port, const void *buf,
+		size_t count)
+{
+	ssize_t ret;
+
+	if (!port || port->fd < 0 || !buf)
+		return SP_ERR_ARG;
+
+	if ((ret = write(port->fd, buf, count)) < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 0;
+		return sp_fail();
+	}
+
+	return ret;
+}
+
+enum sp_return sp_input_waiting(struct sp_port *port)
+{
+	int num;
+
+	if (!port || port->fd < 0)
+		return SP_ERR_ARG;
+
+	if (ioctl(port->fd, FIONREAD, &num) < 0)
+		return sp_fail();
+
+	return num;
+}
+
+enum sp_return sp_flush(struct sp_port *port, enum sp_buffer buffers)
+{
+	int queue;
+
+	if (!port || port->fd < 0)
+		return SP_ERR_ARG;
+
+	if (buffers == SP_BUF_BOTH)
+		queue = TCIOFLUSH;
+	else if (buffers == SP_BUF_INPUT)
+		queue = TCIFLUSH;
+	else
+		queue = TCOFLUSH;
+
+	return tcflush(port->fd, queue) < 0 ? sp_fail() : SP_OK;
+}
+
+enum sp_return sp_drain(struct sp_port *port)
+{
+	if (!port || port->fd < 0)
+		return SP_ERR_ARG;
+
+	return tcdrain(port->fd) < 0 ? sp_fail() : SP_OK;
+}
+
+enum sp_return sp_new_event_set(struct sp_event_set **result_ptr)
+{
+	if (!result_ptr)
+		return SP_ERR_ARG;
+
+	*result_ptr = g_malloc0(sizeof(struct sp_event_set));
+
+	return SP_OK;
+}
+
+enum sp_return sp_add_port_events(struct sp_event_set *event_set,
+		const struct sp_port *port, enum sp_event mask)
+{
+	int *handles;
+
+	if (!event_set || !port || port->fd < 0)
+		return SP_ERR_ARG;
+
+	handles = g_renew(int, event_set->handles, event_set->count + 1);
+	event_set->masks = g_renew(enum sp_event, event_set->masks,
+			event_set->count + 1);
+	handles[event_set->count] = port->fd;
+	event_set->masks[event_set->count] = mask;
+	event_set->handles = handles;
+	event_set->count++;
+
+	return SP_OK;
+}
+
+void sp_free_event_set(struct sp_event_set *event_set)
+{
+	if (!event_set)
+		return;
+	g_free(event_set->handles);
+	g_free(event_set->masks);
+	g_free(event_set);
+}
+
+int sp_last_error_code(void)
+{
+	return last_error;
+}
+
+char *sp_last_error_message(void)
+{
+	return g_strdup(g_strerror(last_error));
+}
+
+void sp_free_error_message(char *message)
+{
+	g_free(message);
+}
+
+#pragma GCC visibility pop
+
+struct srtest_serial_sim *srtest_serial_sim_new(void)
+{
+	struct srtest_serial_sim *sim;
+	int i;
+
+	fail_unless(sim_current == NULL, "Serial simulator already running.");
+
+	sim = g_malloc0(sizeof(struct srtest_serial_sim));
+	g_mutex_init(&sim->mutex);
+	fail_unless(pipe(sim->wakeup) == 0, "pipe() failed.");
+	for (i = 0; i < 2; i++)
+		fcntl(sim->wakeup[i], F_SETFL, O_NONBLOCK);
+	sim->devs = g_ptr_array_new();
+	sim->thread = g_thread_new("serial-sim", sim_thread, sim);
+	sim_current = sim;
+
+	return sim;
+}
+
+struct srtest_serial_sim_dev *srtest_serial_sim_dev_add(
+		struct srtest_serial_sim *sim, enum srtest_serial_sim_type type,
+		unsigned int baudrate)
+{
+	struct srtest_serial_sim_dev *dev;
+	int master;
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	fail_unless(master >= 0, "posix_openpt() failed.");
+	fail_unless(grantpt(master) == 0 && unlockpt(master) == 0,
+		"Failed to unlock pty.");
+	fcntl(master, F_SETFL, O_NONBLOCK);
+	set_raw(master);
+
+	dev = g_malloc0(sizeof(struct srtest_serial_sim_dev));
+	dev->sim = sim;
+	dev->type = type;
+	dev->baudrate = baudrate;
+	dev->master = master;
+	dev->path = g_strdup(ptsname(master));
+	g_queue_init(&dev->tx);
+	dev->rx = g_byte_array_new();
+	dev->voltage = 12.0;
+	dev->current = 1.0;
+	dev->output = TRUE;
+	if (type == SRTEST_SERIAL_SIM_MAYNUO)
+		dev->slave = srtest_modbus_slave_new();
+
+	g_mutex_lock(&sim->mutex);
+	g_ptr_array_add(sim->devs, dev);
+	g_mutex_unlock(&sim->mutex);
+
+	return dev;
+}
+
+void srtest_serial_sim_dev_set_frames(struct srtest_serial_sim_dev *dev,
+		const uint8_t *frames, size_t len)
+{
+	fail_unless(len > 0 && len % FRAME_SIZE == 0,
+		"Recording isn't a whole number of frames.");
+
+	g_mutex_lock(&dev->sim->mutex);
+	g_free(dev->frames);
+	dev->frames = g_memdup(frames, len);
+	dev->num_frames = len / FRAME_SIZE;
+	g_mutex_unlock(&dev->sim->mutex);
+}
+
+void srtest_serial_sim_dev_bad_reply(struct srtest_serial_sim_dev *dev,
+		const uint8_t *reply, size_t len)
+{
+	g_mutex_lock(&dev->sim->mutex);
+	if (dev->bad_reply)
+		g_byte_array_free(dev->bad_reply, TRUE);
+	dev->bad_reply = g_byte_array_new();
+	g_byte_array_append(dev->bad_reply, reply, len);
+	g_mutex_unlock(&dev->sim->mutex);
+}
+
+const char *srtest_serial_sim_dev_path(const struct srtest_serial_sim_dev *dev)
+{
+	return dev->path;
+}
+
+int64_t srtest_serial_sim_dev_sent_at(struct srtest_serial_sim_dev *dev,
+		uint64_t seq)
+{
+	int64_t t;
+
+	g_mutex_lock(&dev->sim->mutex);
+	t = dev->sent_at[seq % SRTEST_SERIAL_SIM_SEQ_MOD];
+	g_mutex_unlock(&dev->sim->mutex);
+
+	return t;
+}
+
+uint64_t srtest_serial_sim_dev_frames_sent(struct srtest_serial_sim_dev *dev)
+{
+	uint64_t n;
+
+	g_mutex_lock(&dev->sim->mutex);
+	n = dev->frames_sent;
+	g_mutex_unlock(&dev->sim->mutex);
+
+	return n;
+}
+
+/* Whether libsigrok's serial code ends up in the sp_*() functions above. */
+gboolean srtest_serial_sim_active(void)
+{
+	GSList *ports;
+
+	shim_called = FALSE;
+	ports = sr_serial_list(NULL);
+	g_slist_free_full(ports, (GDestroyNotify)sr_serial_free);
+
+	return shim_called;
+}
+
+void srtest_serial_sim_free(struct srtest_serial_sim *sim)
+{
+	struct srtest_serial_sim_dev *dev;
+	guint i;
+
+	g_mutex_lock(&sim->mutex);
+	sim->stop = TRUE;
+	g_mutex_unlock(&sim->mutex);
+	wake(sim);
+	g_thread_join(sim->thread);
+
+	for (i = 0; i < sim->devs->len; i++) {
+		dev = g_ptr_array_index(sim->devs, i);
+		close(dev->master);
+		tx_clear(dev);
+		g_byte_array_free(dev->rx, TRUE);
+		if (dev->slave)
+			srtest_modbus_slave_free(dev->slave);
+		g_free(dev->frames);
+		if (dev->bad_reply)
+			g_byte_array_free(dev->bad_reply, TRUE);
+		g_free(dev->path);
+		g_free(dev);
+	}
+	g_ptr_array_free(sim->devs, TRUE);
+	close(sim->wakeup[0]);
+	close(sim->wakeup[1]);
+	g_mutex_clear(&sim->mutex);
+	g_free(sim);
+	sim_current = NULL;
+}
+
+#else
+
+struct srtest_serial_sim *srtest_serial_sim_new(void)
+{
+	fail("The serial simulator isn't available in this build.");
+
+	return NULL;
+}
+
+struct srtest_serial_sim_dev *srtest_serial_sim_dev_add(
+		struct srtest_serial_sim *sim, enum srtest_serial_sim_type type,
+		unsigned int baudrate)
+{
+	(void)sim;
+	(void)type;
+	(void)baudrate;
+
+	return NULL;
+}
+
+void srtest_serial_sim_dev_set_frames(struct srtest_serial_sim_dev *dev,
+		const uint8_t *frames, size_t len)
+{
+	(void)dev;
+	(void)frames;
+	(void)len;
+}
+
+void srtest_serial_sim_dev_bad_reply(struct srtest_serial_sim_dev *dev,
+		const uint8_t *reply, size_t len)
+{
+	(void)dev;
+	(void)reply;
+	(void)len;
+}
+
+const char *srtest_serial_sim_dev_path(const struct srtest_serial_sim_dev *dev)
+{
+	(void)dev;
+
+	return NULL;
+}
+
+int64_t srtest_serial_sim_dev_sent_at(struct srtest_serial_sim_dev *dev,
+		uint64_t seq)
+{
+	(void)dev;
+	(void)seq;
+
+	return 0;
+}
+
+uint64_t srtest_serial_sim_dev_frames_sent(struct srtest_serial_sim_dev *dev)
+{
+	(void)dev;
+
+	return 0;
+}
+
+gboolean srtest_serial_sim_active(void)
+{
+	return FALSE;
+}
+
+void srtest_serial_sim_free(struct srtest_serial_sim *sim)
+{
+	(void)sim;
+}
+
+#endif
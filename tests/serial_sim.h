@@ -0,0 +1,81 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBSIGROK_TESTS_SERIAL_SIM_H
+#define LIBSIGROK_TESTS_SERIAL_SIM_H
+
+#include <stdint.h>
+#include <glib.h>
+
+/*
+ * Simulated serial devices, each on its own pseudo-terminal. A thread
+ * plays the device end of every pty: it sends meter frames, and answers
+ * the commands the driver sends.
+ *
+ * libserialport only opens ports it finds in sysfs, which ptys aren't.
+ * So, as with libusb in usb_replay.c, the test binary carries its own
+ * sp_*() functions, which know exactly the simulated ports. The drivers
+ * still go through src/serial.c as usual.
+ *
+ * Data goes out at the given baudrate, taking ten bits per byte; the
+ * data of a frame or reply shows up once its last byte would have been
+ * transmitted. A baudrate of 0 sends as fast as the pty takes it. A
+ * device only transmits while the driver has its port open.
+ *
+ * Synthesized meter frames show the measurement number, modulo 10000,
+ * in units of 0.001V. srtest_serial_sim_dev_sent_at() tells when the
+ * frame showing a given number was written to the pty.
+ *
+ * srtest_serial_sim_dev_bad_reply() makes a Modbus device answer its next
+ * request with the given bytes, without the slave seeing the request.
+ */
+
+enum srtest_serial_sim_type {
+	/* FS9721 DMM, sending 14 byte frames continuously. */
+	SRTEST_SERIAL_SIM_FS9721,
+	/* Metex 14 byte ASCII DMM, sending a frame for every 'D' received. */
+	SRTEST_SERIAL_SIM_METEX14,
+	/* Korad KAxxxxP compatible PSU, identifying as a Velleman LABPS3005D. */
+	SRTEST_SERIAL_SIM_KORAD,
+	/* Manson HCS-3102 PSU. */
+	SRTEST_SERIAL_SIM_MANSON,
+	/* Maynuo M9812 load, a Modbus RTU slave; see modbus_sim.h. */
+	SRTEST_SERIAL_SIM_MAYNUO,
+};
+
+/* Number of frames for which the time they were sent is kept. */
+#define SRTEST_SERIAL_SIM_SEQ_MOD 10000
+
+struct srtest_serial_sim;
+struct srtest_serial_sim_dev;
+
+struct srtest_serial_sim *srtest_serial_sim_new(void);
+struct srtest_serial_sim_dev *srtest_serial_sim_dev_add(
+		struct srtest_serial_sim *sim, enum srtest_serial_sim_type type,
+		unsigned int baudrate);
+void srtest_serial_sim_dev_set_frames(struct srtest_serial_sim_dev *dev,
+		const uint8_t *frames, size_t len);
+void srtest_serial_sim_dev_bad_reply(struct srtest_serial_sim_dev *dev,
+		const uint8_t *reply, size_t len);
+const char *srtest_serial_sim_dev_path(const struct srtest_serial_sim_dev *dev);
+int64_t srtest_serial_sim_dev_sent_at(struct srtest_serial_sim_dev *dev,
+		uint64_t seq);
+uint64_t srtest_serial_sim_dev_frames_sent(struct srtest_serial_sim_dev *dev);
+gboolean srtest_serial_sim_active(void);
+void srtest_serial_sim_free(struct srtest_serial_sim *sim);
+
+#endif
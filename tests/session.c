@@ -20,6 +20,7 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -186,6 +187,773 @@ START_TEST(test_session_trigger_get_null)
 }
 END_TEST
 
+/* Check whether sr_session_snapshot() requires flight recorder mode. */
+START_TEST(test_session_recorder_set)
+{
+	int ret;
+	struct sr_session *sess;
+
+	sr_session_new(srtest_ctx, &sess);
+	ret = sr_session_snapshot(sess);
+	fail_unless(ret == SR_ERR_NA, "Snapshot without recorder: %d.", ret);
+	ret = sr_session_recorder_max_bytes_set(sess, 4096);
+	fail_unless(ret == SR_ERR_NA, "Budget without recorder: %d.", ret);
+	ret = sr_session_recorder_set(sess, 1000, 100);
+	fail_unless(ret == SR_OK, "sr_session_recorder_set() failed: %d.", ret);
+	ret = sr_session_recorder_max_bytes_set(sess, 4096);
+	fail_unless(ret == SR_OK, "Setting the budget failed: %d.", ret);
+	ret = sr_session_snapshot(sess);
+	fail_unless(ret == SR_OK, "sr_session_snapshot() failed: %d.", ret);
+	ret = sr_session_recorder_set(sess, 0, 0);
+	fail_unless(ret == SR_OK, "Disabling recorder failed: %d.", ret);
+	ret = sr_session_snapshot(sess);
+	fail_unless(ret == SR_ERR_NA, "Snapshot with disabled recorder: %d.", ret);
+	sr_session_destroy(sess);
+}
+END_TEST
+
+/* Check whether sr_session_recorder_set() fails for bogus parameters. */
+START_TEST(test_session_recorder_set_bogus)
+{
+	int ret;
+	struct sr_session *sess;
+
+	ret = sr_session_recorder_set(NULL, 1000, 100);
+	fail_unless(ret != SR_OK, "sr_session_recorder_set(NULL) worked.");
+	ret = sr_session_recorder_max_bytes_set(NULL, 4096);
+	fail_unless(ret != SR_OK, "Setting a budget without session worked.");
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_recorder_set(sess, 1000, 100);
+	ret = sr_session_recorder_max_bytes_set(sess, 0);
+	fail_unless(ret != SR_OK, "Setting a budget of 0 bytes worked.");
+	sr_session_destroy(sess);
+	ret = sr_session_snapshot(NULL);
+	fail_unless(ret != SR_OK, "sr_session_snapshot(NULL) worked.");
+}
+END_TEST
+
+#define RECORDER_PRE 1000
+#define RECORDER_POST 5000
+
+struct recorder_stats {
+	struct sr_session *sess;
+	uint64_t logic_samples;
+	int num_triggers;
+};
+
+static void recorder_datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct recorder_stats *stats;
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+
+	stats = cb_data;
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		sr_session_snapshot(stats->sess);
+		break;
+	case SR_DF_TRIGGER:
+		stats->num_triggers++;
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		stats->logic_samples += logic->length / logic->unitsize;
+		break;
+	}
+}
+
+/*
+ * Check whether the flight recorder only passes on the history plus
+ * the post-trigger window, around a snapshot.
+ */
+START_TEST(test_session_recorder_snapshot)
+{
+	int ret;
+	struct sr_dev_inst *sdi;
+	struct recorder_stats stats;
+
+	sdi = srtest_demo_dev_get(SR_MHZ(1), 100000);
+
+	memset(&stats, 0, sizeof(stats));
+	sr_session_new(srtest_ctx, &stats.sess);
+	ret = sr_session_recorder_set(stats.sess, RECORDER_PRE, RECORDER_POST);
+	fail_unless(ret == SR_OK, "sr_session_recorder_set() failed: %d.", ret);
+	sr_session_dev_add(stats.sess, sdi);
+	sr_session_datafeed_callback_add(stats.sess, recorder_datafeed_in,
+			&stats);
+	ret = sr_session_start(stats.sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(stats.sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	sr_session_destroy(stats.sess);
+
+	fail_unless(stats.num_triggers == 1, "Got %d triggers.",
+			stats.num_triggers);
+	fail_unless(stats.logic_samples >= RECORDER_POST &&
+			stats.logic_samples <= RECORDER_PRE + RECORDER_POST,
+			"Got %" PRIu64 " logic samples.", stats.logic_samples);
+}
+END_TEST
+
+#define RECORDER_ANALOG_PRE 20000
+#define RECORDER_MAX_CHANNELS 16
+
+struct recorder_analog_stats {
+	struct sr_session *sess;
+	uint64_t logic_samples;
+	uint64_t analog_samples[RECORDER_MAX_CHANNELS];
+	/* How far the analog data was behind at any logic packet. */
+	uint64_t max_lag;
+	int num_triggers;
+	int num_planar;
+	/* Sample number the next planar packet should start at. */
+	uint64_t planar_next;
+	gboolean bad_planar;
+};
+
+static void recorder_analog_datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct recorder_analog_stats *stats;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_analog_planar *planar;
+	struct sr_channel *ch;
+	GSList *l;
+	uint32_t i;
+
+	stats = cb_data;
+	switch (packet->type) {
+	case SR_DF_TRIGGER:
+		stats->num_triggers++;
+		break;
+	case SR_DF_LOGIC:
+		for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+			ch = l->data;
+			if (ch->type != SR_CHANNEL_ANALOG
+					|| ch->index >= RECORDER_MAX_CHANNELS)
+				continue;
+			stats->max_lag = MAX(stats->max_lag, stats->logic_samples
+				- stats->analog_samples[ch->index]);
+		}
+		logic = packet->payload;
+		stats->logic_samples += logic->length / logic->unitsize;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		ch = analog->meaning->channels->data;
+		fail_unless(ch->index < RECORDER_MAX_CHANNELS,
+			"Unexpected channel %d.", ch->index);
+		stats->analog_samples[ch->index] += analog->num_samples;
+		break;
+	case SR_DF_ANALOG_PLANAR:
+		planar = packet->payload;
+		if ((stats->num_planar++ > 0
+				&& planar->sample != stats->planar_next)
+				|| !srtest_demo_planar_check(planar))
+			stats->bad_planar = TRUE;
+		stats->planar_next = planar->sample + planar->num_samples;
+		for (i = 0; i < planar->num_planes; i++) {
+			ch = planar->planes[i].channel;
+			fail_unless(ch->index < RECORDER_MAX_CHANNELS,
+				"Unexpected channel %d.", ch->index);
+			stats->analog_samples[ch->index] += planar->num_samples;
+		}
+		break;
+	}
+}
+
+static gpointer recorder_snapshot_thread(gpointer data)
+{
+	g_usleep(200 * 1000);
+	sr_session_snapshot(data);
+
+	return NULL;
+}
+
+/*
+ * Check whether the flight recorder keeps the full history and window
+ * for each analog channel, and sends it in step with the logic data.
+ */
+START_TEST(test_session_recorder_analog)
+{
+	int ret, i;
+	struct sr_dev_inst *sdi;
+	struct recorder_analog_stats stats;
+	struct sr_channel *ch;
+	GThread *thread;
+	GSList *l;
+
+	sdi = srtest_demo_dev_get(SR_MHZ(1), SR_MHZ(1));
+
+	memset(&stats, 0, sizeof(stats));
+	sr_session_new(srtest_ctx, &stats.sess);
+	ret = sr_session_recorder_set(stats.sess, RECORDER_ANALOG_PRE,
+			RECORDER_POST);
+	fail_unless(ret == SR_OK, "sr_session_recorder_set() failed: %d.", ret);
+	sr_session_dev_add(stats.sess, sdi);
+	sr_session_datafeed_callback_add(stats.sess,
+			recorder_analog_datafeed_in, &stats);
+	ret = sr_session_start(stats.sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	/* Let the history fill up before taking the snapshot. */
+	thread = g_thread_new("snapshot", recorder_snapshot_thread, stats.sess);
+	ret = sr_session_run(stats.sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	g_thread_join(thread);
+	sr_session_destroy(stats.sess);
+
+	fail_unless(stats.num_triggers == 1, "Got %d triggers.",
+			stats.num_triggers);
+	fail_unless(stats.logic_samples == RECORDER_ANALOG_PRE + RECORDER_POST,
+			"Got %" PRIu64 " logic samples.", stats.logic_samples);
+	i = 0;
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		ch = l->data;
+		if (ch->type != SR_CHANNEL_ANALOG)
+			continue;
+		fail_unless(stats.analog_samples[ch->index] == stats.logic_samples,
+			"Got %" PRIu64 " samples on %s.",
+			stats.analog_samples[ch->index], ch->name);
+		i++;
+	}
+	fail_unless(i > 0, "No analog channels.");
+	fail_unless(stats.max_lag <= 4096, "Analog data was %" PRIu64
+			" samples behind.", stats.max_lag);
+}
+END_TEST
+
+#define GAP_LIMIT 100000
+#define GAP_INTERVAL 10000
+
+struct gap_stats {
+	uint64_t pos;
+	uint64_t lost;
+	int num_gaps;
+	gboolean bad_start;
+};
+
+static void gap_datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct gap_stats *stats;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_gap *gap;
+
+	(void)sdi;
+
+	stats = cb_data;
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		stats->pos += logic->length / logic->unitsize;
+		break;
+	case SR_DF_GAP:
+		gap = packet->payload;
+		if (gap->start != stats->pos)
+			stats->bad_start = TRUE;
+		stats->pos += gap->length;
+		stats->lost += gap->length;
+		stats->num_gaps++;
+		break;
+	}
+}
+
+/*
+ * Check whether gaps injected by the demo driver show up in the data
+ * feed at the right places, with the samples around them accounted for.
+ */
+START_TEST(test_session_gaps)
+{
+	int ret;
+	struct sr_dev_inst *sdi;
+	struct sr_session *sess;
+	struct gap_stats stats;
+
+	sdi = srtest_demo_dev_get(SR_MHZ(1), GAP_LIMIT);
+
+	ret = sr_config_set(sdi, NULL, SR_CONF_INJECT_GAPS,
+			g_variant_new_uint64(GAP_INTERVAL));
+	fail_unless(ret == SR_OK, "Failed to enable gap injection: %d.", ret);
+
+	memset(&stats, 0, sizeof(stats));
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_dev_add(sess, sdi);
+	sr_session_datafeed_callback_add(sess, gap_datafeed_in, &stats);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	sr_session_destroy(sess);
+
+	/* A gap of a tenth of the interval follows every interval. */
+	fail_unless(!stats.bad_start, "Gap at the wrong position.");
+	fail_unless(stats.pos == GAP_LIMIT, "Got %" PRIu64 " samples.",
+			stats.pos);
+	fail_unless(stats.num_gaps == 9, "Got %d gaps.", stats.num_gaps);
+	fail_unless(stats.lost == 9 * GAP_INTERVAL / 10,
+			"Lost %" PRIu64 " samples.", stats.lost);
+}
+END_TEST
+
+#define RECORDER_GAP_PRE 25000
+
+struct recorder_gap_stats {
+	struct gap_stats gaps;
+	uint64_t logic_samples;
+	gboolean synced;
+	int num_triggers;
+};
+
+static void recorder_gap_datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct recorder_gap_stats *stats;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_gap *gap;
+
+	(void)sdi;
+
+	stats = cb_data;
+	switch (packet->type) {
+	case SR_DF_TRIGGER:
+		stats->num_triggers++;
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		stats->logic_samples += logic->length / logic->unitsize;
+		break;
+	case SR_DF_GAP:
+		/* The history starts mid-stream: sync up at the first gap. */
+		gap = packet->payload;
+		if (!stats->synced) {
+			stats->synced = TRUE;
+			stats->gaps.pos = gap->start;
+		}
+		break;
+	}
+	if (stats->synced)
+		gap_datafeed_in(sdi, packet, &stats->gaps);
+}
+
+/*
+ * Check whether gaps held back by the flight recorder come out in their
+ * place between the samples, rather than ahead of the history.
+ */
+START_TEST(test_session_recorder_gaps)
+{
+	int ret;
+	struct sr_dev_inst *sdi;
+	struct sr_session *sess;
+	struct recorder_gap_stats stats;
+	GThread *thread;
+
+	sdi = srtest_demo_dev_get(SR_MHZ(1), SR_MHZ(1));
+
+	ret = sr_config_set(sdi, NULL, SR_CONF_INJECT_GAPS,
+			g_variant_new_uint64(GAP_INTERVAL));
+	fail_unless(ret == SR_OK, "Failed to enable gap injection: %d.", ret);
+
+	memset(&stats, 0, sizeof(stats));
+	sr_session_new(srtest_ctx, &sess);
+	ret = sr_session_recorder_set(sess, RECORDER_GAP_PRE, RECORDER_POST);
+	fail_unless(ret == SR_OK, "sr_session_recorder_set() failed: %d.", ret);
+	sr_session_dev_add(sess, sdi);
+	sr_session_datafeed_callback_add(sess, recorder_gap_datafeed_in,
+			&stats);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	thread = g_thread_new("snapshot", recorder_snapshot_thread, sess);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	g_thread_join(thread);
+	sr_session_destroy(sess);
+
+	fail_unless(stats.num_triggers == 1, "Got %d triggers.",
+			stats.num_triggers);
+	fail_unless(stats.logic_samples == RECORDER_GAP_PRE + RECORDER_POST,
+			"Got %" PRIu64 " logic samples.", stats.logic_samples);
+	/* The history spans two intervals, the first gap only syncs. */
+	fail_unless(stats.gaps.num_gaps >= 2, "Got %d gaps.",
+			stats.gaps.num_gaps);
+	fail_unless(!stats.gaps.bad_start, "Gap at the wrong position.");
+}
+END_TEST
+
+/*
+ * Check whether the flight recorder keeps the history of planar analog
+ * packets, and sends it on as planar packets, with the samples in place.
+ */
+START_TEST(test_session_recorder_planar)
+{
+	int ret, i;
+	struct sr_dev_inst *sdi;
+	struct recorder_analog_stats stats;
+	struct sr_channel *ch;
+	GThread *thread;
+	GSList *l;
+
+	sdi = srtest_demo_dev_get(SR_MHZ(1), SR_MHZ(1));
+
+	ret = sr_config_set(sdi, NULL, SR_CONF_ANALOG_PLANAR,
+			g_variant_new_boolean(TRUE));
+	fail_unless(ret == SR_OK, "Failed to enable planar packets: %d.", ret);
+
+	memset(&stats, 0, sizeof(stats));
+	sr_session_new(srtest_ctx, &stats.sess);
+	ret = sr_session_recorder_set(stats.sess, RECORDER_ANALOG_PRE,
+			RECORDER_POST);
+	fail_unless(ret == SR_OK, "sr_session_recorder_set() failed: %d.", ret);
+	sr_session_dev_add(stats.sess, sdi);
+	sr_session_datafeed_callback_add(stats.sess,
+			recorder_analog_datafeed_in, &stats);
+	ret = sr_session_start(stats.sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	thread = g_thread_new("snapshot", recorder_snapshot_thread, stats.sess);
+	ret = sr_session_run(stats.sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	g_thread_join(thread);
+	sr_session_destroy(stats.sess);
+
+	fail_unless(stats.num_triggers == 1, "Got %d triggers.",
+			stats.num_triggers);
+	fail_unless(stats.logic_samples == RECORDER_ANALOG_PRE + RECORDER_POST,
+			"Got %" PRIu64 " logic samples.", stats.logic_samples);
+	fail_unless(stats.num_planar > 0, "Got no planar packets.");
+	fail_unless(!stats.bad_planar, "Planar samples out of place.");
+	i = 0;
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		ch = l->data;
+		if (ch->type != SR_CHANNEL_ANALOG)
+			continue;
+		fail_unless(stats.analog_samples[ch->index] == stats.logic_samples,
+			"Got %" PRIu64 " samples on %s.",
+			stats.analog_samples[ch->index], ch->name);
+		i++;
+	}
+	fail_unless(i > 0, "No analog channels.");
+	fail_unless(stats.max_lag <= 4096, "Analog data was %" PRIu64
+			" samples behind.", stats.max_lag);
+}
+END_TEST
+
+#define RECORDER_BUDGET 8192
+
+/*
+ * Check whether the flight recorder keeps its history within the memory
+ * budget, even if that holds fewer samples than asked for.
+ */
+START_TEST(test_session_recorder_max_bytes)
+{
+	int ret;
+	struct sr_dev_inst *sdi;
+	struct recorder_analog_stats stats;
+	GThread *thread;
+
+	sdi = srtest_demo_dev_get(SR_MHZ(1), SR_MHZ(1));
+
+	memset(&stats, 0, sizeof(stats));
+	sr_session_new(srtest_ctx, &stats.sess);
+	ret = sr_session_recorder_set(stats.sess, RECORDER_ANALOG_PRE,
+			RECORDER_POST);
+	fail_unless(ret == SR_OK, "sr_session_recorder_set() failed: %d.", ret);
+	ret = sr_session_recorder_max_bytes_set(stats.sess, RECORDER_BUDGET);
+	fail_unless(ret == SR_OK, "Setting the budget failed: %d.", ret);
+	sr_session_dev_add(stats.sess, sdi);
+	sr_session_datafeed_callback_add(stats.sess,
+			recorder_analog_datafeed_in, &stats);
+	ret = sr_session_start(stats.sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	thread = g_thread_new("snapshot", recorder_snapshot_thread, stats.sess);
+	ret = sr_session_run(stats.sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	g_thread_join(thread);
+	sr_session_destroy(stats.sess);
+
+	/* At least one byte per logic sample, and the budget is shared. */
+	fail_unless(stats.num_triggers == 1, "Got %d triggers.",
+			stats.num_triggers);
+	fail_unless(stats.logic_samples > RECORDER_POST
+			&& stats.logic_samples < RECORDER_POST + RECORDER_BUDGET,
+			"Got %" PRIu64 " logic samples.", stats.logic_samples);
+}
+END_TEST
+
+#define RUNT_LIMIT_MSEC 100
+
+struct runt_stats {
+	const struct sr_channel *ch;
+	int num_triggers;
+	/* Samples of the channel sent before and after the trigger. */
+	uint64_t num_early;
+	uint64_t num_samples;
+	/* The last sample before the trigger, the first one after it. */
+	float last_early;
+	float first;
+};
+
+static void runt_datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct runt_stats *stats;
+	const struct sr_datafeed_analog *analog;
+
+	(void)sdi;
+
+	stats = cb_data;
+	switch (packet->type) {
+	case SR_DF_TRIGGER:
+		stats->num_triggers++;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		if (analog->meaning->channels->data != stats->ch)
+			break;
+		if (!stats->num_triggers) {
+			if (analog->num_samples)
+				stats->last_early = ((const float *)analog->data)
+						[analog->num_samples - 1];
+			stats->num_early += analog->num_samples;
+			break;
+		}
+		if (!stats->num_samples && analog->num_samples)
+			stats->first = ((const float *)analog->data)[0];
+		stats->num_samples += analog->num_samples;
+		break;
+	}
+}
+
+/*
+ * Acquire from the demo device for a while, with a runt trigger on A0,
+ * and check whether it fired. If so, A0 must start with value.
+ */
+static void runt_trigger_run(struct sr_dev_inst *sdi, uint32_t flags,
+		float low, float high, uint64_t min, uint64_t max,
+		gboolean fires, float value)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct sr_trigger_condition condition;
+	struct runt_stats stats;
+	struct sr_channel *ch, *a0;
+	GSList *l;
+
+	a0 = NULL;
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		ch = l->data;
+		if (!strcmp(ch->name, "A0"))
+			a0 = ch;
+	}
+	fail_unless(a0 != NULL, "No A0 channel found.");
+
+	memset(&condition, 0, sizeof(condition));
+	condition.flags = flags;
+	condition.min = min;
+	condition.max = max;
+	condition.low = low;
+	condition.high = high;
+	trigger = sr_trigger_new(NULL);
+	stage = sr_trigger_stage_add(trigger);
+	ret = sr_trigger_condition_match_add(stage, a0, SR_TRIGGER_RUNT,
+			&condition);
+	fail_unless(ret == SR_OK, "Failed to add trigger match: %d.", ret);
+
+	memset(&stats, 0, sizeof(stats));
+	stats.ch = a0;
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_dev_add(sess, sdi);
+	sr_session_trigger_set(sess, trigger);
+	sr_session_datafeed_callback_add(sess, runt_datafeed_in, &stats);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	sr_session_destroy(sess);
+	sr_trigger_free(trigger);
+
+	fail_unless(stats.num_early == 0, "Got %" PRIu64 " samples before "
+			"the trigger.", stats.num_early);
+	if (fires) {
+		fail_unless(stats.num_triggers == 1, "Got %d triggers.",
+				stats.num_triggers);
+		fail_unless(stats.num_samples > 0 && stats.first == value,
+				"A0 starts with %f after the trigger.", stats.first);
+	} else {
+		fail_unless(stats.num_triggers == 0 && stats.num_samples == 0,
+				"Got %d triggers.", stats.num_triggers);
+	}
+}
+
+/*
+ * Check the demo driver's analog soft trigger on runts. A0 is a square
+ * wave of -25 and 25, five samples each; the trigger fires on the sample
+ * which ends a runt.
+ */
+START_TEST(test_session_runt_trigger)
+{
+	int ret;
+	struct sr_dev_inst *sdi;
+
+	sdi = srtest_demo_dev_get(SR_MHZ(1), 0);
+
+	/*
+	 * Samples held back before the trigger don't count towards a
+	 * sample limit, so a time limit ends the runs which never fire.
+	 */
+	ret = sr_config_set(sdi, NULL, SR_CONF_LIMIT_MSEC,
+			g_variant_new_uint64(RUNT_LIMIT_MSEC));
+	fail_unless(ret == SR_OK, "Failed to set time limit: %d.", ret);
+
+	/* Above 0, but not above 50: positive runts, back to -25. */
+	runt_trigger_run(sdi, 0, 0, 50, 0, 0, TRUE, -25);
+	runt_trigger_run(sdi, SR_TRIGGER_POSITIVE, 0, 50, 0, 5, TRUE, -25);
+	runt_trigger_run(sdi, SR_TRIGGER_NEGATIVE, 0, 50, 0, 0, FALSE, 0);
+	/* The runts are five samples wide. */
+	runt_trigger_run(sdi, 0, 0, 50, 6, 0, FALSE, 0);
+	/* Above 20 is a full pulse. */
+	runt_trigger_run(sdi, 0, 0, 20, 0, 0, FALSE, 0);
+	/* Below 0, but not below -50: negative runts, back to 25. */
+	runt_trigger_run(sdi, SR_TRIGGER_NEGATIVE, -50, 0, 0, 0, TRUE, 25);
+}
+END_TEST
+
+#define PRE_TRIGGER_LIMIT 100
+
+/*
+ * Acquire PRE_TRIGGER_LIMIT samples from the demo device with the given
+ * capture ratio, triggering on the first rising edge of A0 at sample 5,
+ * and check how many samples came before the trigger.
+ */
+static void pre_trigger_run(struct sr_dev_inst *sdi, struct sr_channel *a0,
+		uint64_t ratio, uint64_t num_early)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct runt_stats stats;
+
+	ret = sr_config_set(sdi, NULL, SR_CONF_CAPTURE_RATIO,
+			g_variant_new_uint64(ratio));
+	fail_unless(ret == SR_OK, "Failed to set capture ratio: %d.", ret);
+
+	trigger = sr_trigger_new(NULL);
+	stage = sr_trigger_stage_add(trigger);
+	ret = sr_trigger_match_add(stage, a0, SR_TRIGGER_RISING, 0);
+	fail_unless(ret == SR_OK, "Failed to add trigger match: %d.", ret);
+
+	memset(&stats, 0, sizeof(stats));
+	stats.ch = a0;
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_dev_add(sess, sdi);
+	sr_session_trigger_set(sess, trigger);
+	sr_session_datafeed_callback_add(sess, runt_datafeed_in, &stats);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	sr_session_destroy(sess);
+	sr_trigger_free(trigger);
+
+	fail_unless(stats.num_triggers == 1, "Got %d triggers.",
+			stats.num_triggers);
+	fail_unless(stats.num_early == num_early, "Got %" PRIu64 " samples "
+			"before the trigger.", stats.num_early);
+	if (num_early)
+		fail_unless(stats.last_early == -25, "A0 ends with %f before "
+				"the trigger.", stats.last_early);
+	fail_unless(stats.first == 25, "A0 starts with %f after the trigger.",
+			stats.first);
+}
+
+/*
+ * Check whether the demo driver's analog soft trigger keeps the samples
+ * before the trigger which the capture ratio asks for, up to as many as
+ * there were.
+ */
+START_TEST(test_session_pre_trigger)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ch, *a0;
+	GSList *l;
+
+	sdi = srtest_demo_dev_get(SR_MHZ(1), PRE_TRIGGER_LIMIT);
+
+	a0 = NULL;
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		ch = l->data;
+		if (!strcmp(ch->name, "A0"))
+			a0 = ch;
+	}
+	fail_unless(a0 != NULL, "No A0 channel found.");
+
+	pre_trigger_run(sdi, a0, 0, 0);
+	pre_trigger_run(sdi, a0, 3, 3);
+	/* Only five samples came before the edge. */
+	pre_trigger_run(sdi, a0, 50, 5);
+}
+END_TEST
+
+/*
+ * The demo driver's soft trigger only sees analog channels. A trigger
+ * on a logic channel alone must not fail the session, which then runs
+ * untriggered.
+ */
+START_TEST(test_session_logic_trigger)
+{
+	int ret;
+	struct sr_dev_inst *sdi;
+	struct sr_session *sess;
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct runt_stats stats;
+	struct sr_channel *ch, *a0, *d0;
+	GSList *l;
+
+	sdi = srtest_demo_dev_get(0, 0);
+
+	a0 = d0 = NULL;
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		ch = l->data;
+		if (!strcmp(ch->name, "A0"))
+			a0 = ch;
+		else if (!strcmp(ch->name, "D0"))
+			d0 = ch;
+	}
+	fail_unless(a0 != NULL && d0 != NULL, "No A0 or D0 channel found.");
+
+	ret = sr_config_set(sdi, NULL, SR_CONF_LIMIT_MSEC,
+			g_variant_new_uint64(RUNT_LIMIT_MSEC));
+	fail_unless(ret == SR_OK, "Failed to set time limit: %d.", ret);
+
+	trigger = sr_trigger_new(NULL);
+	stage = sr_trigger_stage_add(trigger);
+	ret = sr_trigger_match_add(stage, d0, SR_TRIGGER_ONE, 0);
+	fail_unless(ret == SR_OK, "Failed to add trigger match: %d.", ret);
+
+	memset(&stats, 0, sizeof(stats));
+	stats.ch = a0;
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_dev_add(sess, sdi);
+	sr_session_trigger_set(sess, trigger);
+	sr_session_datafeed_callback_add(sess, runt_datafeed_in, &stats);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	sr_session_destroy(sess);
+	sr_trigger_free(trigger);
+
+	fail_unless(stats.num_triggers == 0, "Got %d triggers.",
+			stats.num_triggers);
+	fail_unless(stats.num_early > 0, "Got no samples.");
+}
+END_TEST
+
 Suite *suite_session(void)
 {
 	Suite *s;
@@ -210,5 +978,28 @@ Suite *suite_session(void)
 	tcase_add_test(tc, test_session_trigger_get_null);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("recorder");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_recorder_set);
+	tcase_add_test(tc, test_session_recorder_set_bogus);
+	tcase_add_test(tc, test_session_recorder_snapshot);
+	tcase_add_test(tc, test_session_recorder_analog);
+	tcase_add_test(tc, test_session_recorder_planar);
+	tcase_add_test(tc, test_session_recorder_max_bytes);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("gap");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_gaps);
+	tcase_add_test(tc, test_session_recorder_gaps);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("soft_trigger");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_runt_trigger);
+	tcase_add_test(tc, test_session_pre_trigger);
+	tcase_add_test(tc, test_session_logic_trigger);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -19,6 +19,9 @@
  */
 
 #include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -155,6 +158,132 @@ START_TEST(test_ghz)
 }
 END_TEST
 
+static void test_float(float value, int digits, const char *expected)
+{
+	char buf[SR_FLOAT_STRING_SIZE];
+	int len;
+
+	len = sr_float_to_string(buf, value, digits);
+	fail_unless(len == (int)strlen(buf), "Wrong length for '%s'.", buf);
+	fail_unless(!strcmp(buf, expected),
+		    "Invalid result for '%s': %s.", expected, buf);
+}
+
+/* Check sr_float_to_string() with a fixed number of digits. */
+START_TEST(test_float_fixed)
+{
+	test_float(0, 6, "0.000000");
+	test_float(-0.0, 6, "-0.000000");
+	test_float(1.5, 0, "2");
+	test_float(2.5, 0, "2");
+	test_float(-2.5, 3, "-2.500");
+	test_float(0.1, 9, "0.100000001");
+	test_float(1e-7, 6, "0.000000");
+	test_float(-1e-7, 6, "-0.000000");
+	test_float(123456792, 1, "123456792.0");
+	test_float(3.4028235e38, 0, "340282346638528859811704183484516925440");
+	test_float(1, 99, "1.000000000000000");
+	test_float(NAN, 6, "nan");
+	test_float(-INFINITY, 6, "-inf");
+}
+END_TEST
+
+/* Check sr_float_to_string() with the shortest representation. */
+START_TEST(test_float_shortest)
+{
+	test_float(0, -1, "0");
+	test_float(1, -1, "1");
+	test_float(0.1, -1, "0.1");
+	test_float(-2.5, -1, "-2.5");
+	test_float(100, -1, "100");
+	test_float(123456792, -1, "123456790");
+	test_float(1e9, -1, "1e+09");
+	test_float(1e-5, -1, "0.00001");
+	test_float(1.5e-6, -1, "1.5e-06");
+	test_float(3.4028235e38, -1, "3.4028235e+38");
+	test_float(1e-45, -1, "1e-45");
+	test_float(INFINITY, -1, "inf");
+}
+END_TEST
+
+/*
+ * Check whether the shortest representation reads back as the exact
+ * same float, for a spread of bit patterns over the whole range.
+ */
+START_TEST(test_float_roundtrip)
+{
+	char buf[SR_FLOAT_STRING_SIZE];
+	union { float f; uint32_t u; } in, out;
+	uint64_t bits;
+
+	for (bits = 0; bits <= UINT32_MAX; bits += 4099) {
+		in.u = bits;
+		if (!isfinite(in.f))
+			continue;
+		sr_float_to_string(buf, in.f, -1);
+		out.f = strtof(buf, NULL);
+		fail_unless(in.u == out.u, "0x%08" PRIx32 " read back as "
+			    "0x%08" PRIx32 " from '%s'.", in.u, out.u, buf);
+	}
+}
+END_TEST
+
+#define BENCH_PERIOD 20000
+#define BENCH_VALUES (100 * 1000 * 1000)
+
+static float bench_value(uint32_t i)
+{
+	return ((int)(i % BENCH_PERIOD) - BENCH_PERIOD / 2) / 1000.0;
+}
+
+/* Format one period of the benchmark's values, checking each. */
+static uint64_t bench_period(void)
+{
+	char buf[SR_FLOAT_STRING_SIZE], expected[SR_FLOAT_STRING_SIZE];
+	uint64_t period_len;
+	uint32_t i;
+
+	period_len = 0;
+	for (i = 0; i < BENCH_PERIOD; i++) {
+		period_len += sr_float_to_string(buf, bench_value(i), 6);
+		g_ascii_formatd(expected, sizeof(expected), "%.6f",
+				bench_value(i));
+		fail_unless(!strcmp(buf, expected),
+			    "Invalid result for '%s': %s.", expected, buf);
+	}
+
+	return period_len;
+}
+
+/* The values the benchmark formats come out as g_ascii_formatd() has them. */
+START_TEST(test_float_fixed_period)
+{
+	bench_period();
+}
+END_TEST
+
+/*
+ * Format 100M values, as an output module would. This takes a while, so
+ * it only runs when LIBSIGROK_TEST_BENCHMARKS is set.
+ */
+START_TEST(test_float_benchmark)
+{
+	char buf[SR_FLOAT_STRING_SIZE];
+	uint64_t period_len, total_len;
+	uint32_t i;
+
+	if (!g_getenv("LIBSIGROK_TEST_BENCHMARKS"))
+		return;
+
+	period_len = bench_period();
+	total_len = 0;
+	for (i = 0; i < BENCH_VALUES; i++)
+		total_len += sr_float_to_string(buf, bench_value(i), 6);
+	fail_unless(total_len == period_len * (BENCH_VALUES / BENCH_PERIOD),
+		    "Formatted %" PRIu64 " bytes.", total_len);
+}
+END_TEST
+
 Suite *suite_strutil(void)
 {
 	Suite *s;
@@ -170,5 +299,19 @@ Suite *suite_strutil(void)
 	tcase_add_test(tc, test_ghz);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("sr_float_to_string");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_float_fixed);
+	tcase_add_test(tc, test_float_shortest);
+	tcase_add_test(tc, test_float_roundtrip);
+	tcase_add_test(tc, test_float_fixed_period);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("sr_float_to_string_benchmark");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 120);
+	tcase_add_test(tc, test_float_benchmark);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
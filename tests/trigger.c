@@ -250,6 +250,150 @@ START_TEST(test_trigger_match_add_bogus)
 }
 END_TEST
 
+/* Check whether protocol matches are checked, and keep their parameters. */
+START_TEST(test_trigger_protocol_match_add)
+{
+	int ret;
+	struct sr_trigger *t;
+	struct sr_trigger_stage *s;
+	struct sr_trigger_match *m;
+	struct sr_trigger_protocol p;
+	struct sr_channel *chl, *cha;
+
+	t = sr_trigger_new("T");
+	s = sr_trigger_stage_add(t);
+	chl = g_malloc0(sizeof(struct sr_channel));
+	chl->index = 0;
+	chl->type = SR_CHANNEL_LOGIC;
+	chl->enabled = TRUE;
+	chl->name = g_strdup("L0");
+	cha = g_malloc0(sizeof(struct sr_channel));
+	cha->index = 1;
+	cha->type = SR_CHANNEL_ANALOG;
+	cha->enabled = TRUE;
+	cha->name = g_strdup("A0");
+	memset(&p, 0, sizeof(p));
+
+	/* Protocol matches need their parameters. */
+	ret = sr_trigger_match_add(s, chl, SR_TRIGGER_UART, 0);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_trigger_protocol_match_add(s, chl, SR_TRIGGER_UART, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+
+	/* No baud rate, too many bits, no clock, or an analog channel. */
+	ret = sr_trigger_protocol_match_add(s, chl, SR_TRIGGER_UART, &p);
+	fail_unless(ret == SR_ERR_ARG);
+	p.baudrate = 9600;
+	p.num_bits = 10;
+	ret = sr_trigger_protocol_match_add(s, chl, SR_TRIGGER_UART, &p);
+	fail_unless(ret == SR_ERR_ARG);
+	p.num_bits = 0;
+	ret = sr_trigger_protocol_match_add(s, chl, SR_TRIGGER_SPI, &p);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_trigger_protocol_match_add(s, cha, SR_TRIGGER_UART, &p);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_trigger_protocol_match_add(s, chl, SR_TRIGGER_EDGE, &p);
+	fail_unless(ret == SR_ERR_ARG);
+	fail_unless(g_slist_length(s->matches) == 0);
+
+	/* The match keeps a copy, with the default word size filled in. */
+	p.value = 0x55;
+	p.mask = 0xff;
+	ret = sr_trigger_protocol_match_add(s, chl, SR_TRIGGER_UART, &p);
+	fail_unless(ret == SR_OK);
+	p.value = 0;
+	fail_unless(g_slist_length(s->matches) == 1);
+	m = s->matches->data;
+	fail_unless(m->match == SR_TRIGGER_UART);
+	fail_unless(m->protocol != NULL && m->protocol != &p);
+	fail_unless(m->protocol->value == 0x55);
+	fail_unless(m->protocol->num_bits == 8);
+
+	p.clock = chl;
+	ret = sr_trigger_protocol_match_add(s, chl, SR_TRIGGER_I2C, &p);
+	fail_unless(ret == SR_OK);
+	fail_unless(g_slist_length(s->matches) == 2);
+
+	sr_trigger_free(t);
+	g_free(chl->name);
+	g_free(chl);
+	g_free(cha->name);
+	g_free(cha);
+}
+END_TEST
+
+START_TEST(test_trigger_condition_match_add)
+{
+	int ret;
+	struct sr_trigger *t;
+	struct sr_trigger_stage *s;
+	struct sr_trigger_match *m;
+	struct sr_trigger_condition c;
+	struct sr_channel *chl, *cha;
+
+	t = sr_trigger_new("T");
+	s = sr_trigger_stage_add(t);
+	chl = g_malloc0(sizeof(struct sr_channel));
+	chl->index = 0;
+	chl->type = SR_CHANNEL_LOGIC;
+	chl->enabled = TRUE;
+	chl->name = g_strdup("L0");
+	cha = g_malloc0(sizeof(struct sr_channel));
+	cha->index = 1;
+	cha->type = SR_CHANNEL_ANALOG;
+	cha->enabled = TRUE;
+	cha->name = g_strdup("A0");
+	memset(&c, 0, sizeof(c));
+
+	/* Condition matches need their parameters. */
+	ret = sr_trigger_match_add(s, chl, SR_TRIGGER_PULSE, 0);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_trigger_condition_match_add(s, chl, SR_TRIGGER_PULSE, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+
+	/* Wrong channel types, no timeout, bounds or thresholds reversed. */
+	ret = sr_trigger_condition_match_add(s, cha, SR_TRIGGER_PULSE, &c);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_trigger_condition_match_add(s, chl, SR_TRIGGER_TIMEOUT, &c);
+	fail_unless(ret == SR_ERR_ARG);
+	c.min = 10;
+	c.max = 5;
+	ret = sr_trigger_condition_match_add(s, chl, SR_TRIGGER_PULSE, &c);
+	fail_unless(ret == SR_ERR_ARG);
+	c.max = 0;
+	ret = sr_trigger_condition_match_add(s, chl, SR_TRIGGER_RUNT, &c);
+	fail_unless(ret == SR_ERR_ARG);
+	c.low = 1.0;
+	c.high = 1.0;
+	ret = sr_trigger_condition_match_add(s, cha, SR_TRIGGER_RUNT, &c);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_trigger_condition_match_add(s, chl, SR_TRIGGER_EDGE, &c);
+	fail_unless(ret == SR_ERR_ARG);
+	fail_unless(g_slist_length(s->matches) == 0);
+
+	/* The match keeps a copy. */
+	ret = sr_trigger_condition_match_add(s, chl, SR_TRIGGER_PULSE, &c);
+	fail_unless(ret == SR_OK);
+	c.min = 0;
+	fail_unless(g_slist_length(s->matches) == 1);
+	m = s->matches->data;
+	fail_unless(m->match == SR_TRIGGER_PULSE);
+	fail_unless(m->condition != NULL && m->condition != &c);
+	fail_unless(m->condition->min == 10);
+
+	c.high = 2.0;
+	ret = sr_trigger_condition_match_add(s, cha, SR_TRIGGER_RUNT, &c);
+	fail_unless(ret == SR_OK);
+	fail_unless(g_slist_length(s->matches) == 2);
+
+	sr_trigger_free(t);
+	g_free(chl->name);
+	g_free(chl);
+	g_free(cha->name);
+	g_free(cha);
+}
+END_TEST
+
 Suite *suite_trigger(void)
 {
 	Suite *s;
@@ -275,6 +419,8 @@ Suite *suite_trigger(void)
 	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
 	tcase_add_test(tc, test_trigger_match_add);
 	tcase_add_test(tc, test_trigger_match_add_bogus);
+	tcase_add_test(tc, test_trigger_protocol_match_add);
+	tcase_add_test(tc, test_trigger_condition_match_add);
 	suite_add_tcase(s, tc);
 
 	return s;
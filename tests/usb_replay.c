@@ -0,0 +1,1396 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <check.h>
+#include "usb_replay.h"
+
+#define CAPTURE_MAGIC "SRUSBCAP"
+#define CAPTURE_VERSION 1
+#define CAPTURE_HEADER_SIZE 12
+#define RECORD_HEADER_SIZE 16
+
+struct srtest_usb_capture {
+	GByteArray *buf;
+};
+
+static void put_u8(GByteArray *buf, uint8_t value)
+{
+	g_byte_array_append(buf, &value, 1);
+}
+
+static void put_le16(GByteArray *buf, uint16_t value)
+{
+	put_u8(buf, value & 0xff);
+	put_u8(buf, value >> 8);
+}
+
+static void put_le32(GByteArray *buf, uint32_t value)
+{
+	put_le16(buf, value & 0xffff);
+	put_le16(buf, value >> 16);
+}
+
+static void put_le64(GByteArray *buf, uint64_t value)
+{
+	put_le32(buf, value & 0xffffffff);
+	put_le32(buf, value >> 32);
+}
+
+static uint16_t get_le16(const uint8_t *p)
+{
+	return p[0] | p[1] << 8;
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+	return get_le16(p) | (uint32_t)get_le16(p + 2) << 16;
+}
+
+static uint64_t get_le64(const uint8_t *p)
+{
+	return get_le32(p) | (uint64_t)get_le32(p + 4) << 32;
+}
+
+static void put_record(struct srtest_usb_capture *cap, uint8_t type,
+		uint8_t endpoint, uint64_t timestamp, const void *data,
+		uint32_t length)
+{
+	put_u8(cap->buf, type);
+	put_u8(cap->buf, endpoint);
+	put_le16(cap->buf, 0);
+	put_le32(cap->buf, length);
+	put_le64(cap->buf, timestamp);
+	g_byte_array_append(cap->buf, data, length);
+}
+
+static void put_device(struct srtest_usb_capture *cap, uint8_t type,
+		uint16_t vid, uint16_t pid, const char *manufacturer,
+		const char *product, const char *serial_num)
+{
+	const char *strings[] = { manufacturer, product, serial_num };
+	GByteArray *body;
+	size_t len;
+	unsigned int i;
+
+	body = g_byte_array_new();
+	put_le16(body, vid);
+	put_le16(body, pid);
+	for (i = 0; i < G_N_ELEMENTS(strings); i++) {
+		len = strings[i] ? MIN(strlen(strings[i]), 255) : 0;
+		put_u8(body, len);
+		g_byte_array_append(body, (const guint8 *)strings[i], len);
+	}
+	put_record(cap, type, 0, 0, body->data, body->len);
+	g_byte_array_free(body, TRUE);
+}
+
+/* Start building a capture in memory. */
+struct srtest_usb_capture *srtest_usb_capture_new(void)
+{
+	struct srtest_usb_capture *cap;
+
+	cap = g_malloc0(sizeof(struct srtest_usb_capture));
+	cap->buf = g_byte_array_new();
+	g_byte_array_append(cap->buf, (const guint8 *)CAPTURE_MAGIC,
+			strlen(CAPTURE_MAGIC));
+	put_le32(cap->buf, CAPTURE_VERSION);
+
+	return cap;
+}
+
+void srtest_usb_capture_device(struct srtest_usb_capture *cap,
+		uint16_t vid, uint16_t pid, const char *manufacturer,
+		const char *product, const char *serial_num)
+{
+	put_device(cap, USB_CAPTURE_DEVICE, vid, pid, manufacturer,
+			product, serial_num);
+}
+
+void srtest_usb_capture_renumerate(struct srtest_usb_capture *cap,
+		uint16_t vid, uint16_t pid, const char *manufacturer,
+		const char *product, const char *serial_num)
+{
+	put_device(cap, USB_CAPTURE_RENUMERATE, vid, pid, manufacturer,
+			product, serial_num);
+}
+
+void srtest_usb_capture_control(struct srtest_usb_capture *cap,
+		uint64_t timestamp, uint8_t request_type, uint8_t request,
+		uint16_t value, uint16_t index, const void *data,
+		uint16_t length)
+{
+	GByteArray *body;
+
+	body = g_byte_array_new();
+	put_u8(body, request_type);
+	put_u8(body, request);
+	put_le16(body, value);
+	put_le16(body, index);
+	put_le16(body, length);
+	g_byte_array_append(body, data, length);
+	put_record(cap, USB_CAPTURE_CONTROL, 0, timestamp, body->data,
+			body->len);
+	g_byte_array_free(body, TRUE);
+}
+
+void srtest_usb_capture_bulk(struct srtest_usb_capture *cap,
+		uint64_t timestamp, uint8_t endpoint, const void *data,
+		uint32_t length)
+{
+	put_record(cap, USB_CAPTURE_BULK, endpoint, timestamp, data, length);
+}
+
+/* Write the capture to a temporary file, and return its path. */
+char *srtest_usb_capture_save(struct srtest_usb_capture *cap)
+{
+	GError *error;
+	char *path;
+	int fd;
+
+	error = NULL;
+	fd = g_file_open_tmp("sigrok-test-XXXXXX.usbcap", &path, &error);
+	fail_unless(fd >= 0, "Failed to create capture file: %s.",
+		    error ? error->message : "");
+	close(fd);
+	fail_unless(g_file_set_contents(path, (const char *)cap->buf->data,
+		    cap->buf->len, NULL), "Failed to write '%s'.", path);
+
+	return path;
+}
+
+void srtest_usb_capture_free(struct srtest_usb_capture *cap)
+{
+	g_byte_array_free(cap->buf, TRUE);
+	g_free(cap);
+}
+
+#if defined(HAVE_LIBUSB_1_0) && !defined(_WIN32)
+
+#include <fcntl.h>
+#include <poll.h>
+#include <libusb.h>
+
+#define FX2_FIRMWARE_REQUEST	0xa0
+#define FX2_CPUCS		0xe600
+
+#define NUM_IN_ENDPOINTS	16
+
+struct replay_record {
+	uint64_t timestamp;
+	const uint8_t *data;
+	uint32_t length;
+	/* Setup packet, for control requests. */
+	uint8_t request_type;
+	uint8_t request;
+	uint16_t value;
+	uint16_t index;
+};
+
+/* The data of one IN endpoint, and how far it has been read. */
+struct replay_stream {
+	GArray *records;
+	uint64_t total;
+	guint pos;
+	uint32_t offset;
+	uint64_t loops;
+};
+
+struct libusb_context {
+	/* Passed to the pollfd notifiers, which we never need to call. */
+	void *pollfd_user_data;
+};
+
+struct libusb_device {
+	uint16_t vid;
+	uint16_t pid;
+	char *strings[3];
+	uint8_t bus;
+	uint8_t address;
+	uint8_t port;
+	gboolean present;
+	/* Only reachable through a firmware upload. */
+	gboolean is_renumerated;
+	/* The FX2 CPU is held in reset, for firmware upload. */
+	gboolean in_reset;
+	uint64_t firmware_size;
+	/* What this device turns into once its firmware runs. */
+	struct libusb_device *renumerated;
+	GArray *control;
+	struct replay_stream streams[NUM_IN_ENDPOINTS];
+	/* Time of the first bulk IN transfer, which timestamps count from. */
+	int64_t start_us;
+};
+
+struct libusb_device_handle {
+	struct libusb_device *dev;
+};
+
+struct replay_hotplug_cb {
+	libusb_context *ctx;
+	libusb_hotplug_event events;
+	libusb_hotplug_callback_fn cb;
+	void *user_data;
+	libusb_hotplug_callback_handle handle;
+};
+
+/* A device coming or going, to be reported by libusb_handle_events*(). */
+struct replay_hotplug_event {
+	struct libusb_device *dev;
+	libusb_hotplug_event event;
+};
+
+/* Kept in front of every struct libusb_transfer we hand out. */
+struct replay_transfer {
+	int64_t due_us;
+	gboolean pending;
+	gboolean cancelled;
+	int status;
+	int actual_length;
+};
+
+static struct {
+	int num_inits;
+	int num_contexts;
+	/* Readable while a transfer is ready for completion. */
+	int wakeup[2];
+	gboolean woken;
+	int flags;
+	gchar *file_data;
+	GPtrArray *devices;
+	uint8_t next_address;
+	uint8_t next_port;
+	GQueue pending;
+	uint64_t firmware_size;
+	GSList *hotplug_cbs;
+	libusb_hotplug_callback_handle next_hotplug_handle;
+	GQueue hotplug_events;
+} replay = {
+	.wakeup = { -1, -1 },
+};
+
+static struct libusb_interface_descriptor replay_altsetting = {
+	.bLength = LIBUSB_DT_INTERFACE_SIZE,
+	.bDescriptorType = LIBUSB_DT_INTERFACE,
+	.bInterfaceClass = LIBUSB_CLASS_VENDOR_SPEC,
+	.bInterfaceSubClass = LIBUSB_CLASS_VENDOR_SPEC,
+	.bInterfaceProtocol = LIBUSB_CLASS_VENDOR_SPEC,
+};
+
+static struct libusb_interface replay_interface = {
+	.altsetting = &replay_altsetting,
+	.num_altsetting = 1,
+};
+
+static struct libusb_config_descriptor replay_config = {
+	.bLength = LIBUSB_DT_CONFIG_SIZE,
+	.bDescriptorType = LIBUSB_DT_CONFIG,
+	.wTotalLength = LIBUSB_DT_CONFIG_SIZE + LIBUSB_DT_INTERFACE_SIZE,
+	.bNumInterfaces = 1,
+	.bConfigurationValue = 1,
+	.interface = &replay_interface,
+};
+
+static struct replay_transfer *transfer_priv(struct libusb_transfer *transfer)
+{
+	return (struct replay_transfer *)transfer - 1;
+}
+
+static gboolean throttled(void)
+{
+	return (replay.flags & SRTEST_USB_REPLAY_THROTTLE) != 0;
+}
+
+static void wait_until(int64_t due_us)
+{
+	int64_t now;
+
+	now = g_get_monotonic_time();
+	if (due_us > now)
+		g_usleep(due_us - now);
+}
+
+static int64_t transfer_due_time(struct libusb_transfer *transfer)
+{
+	struct replay_transfer *rt;
+
+	rt = transfer_priv(transfer);
+
+	return rt->cancelled ? 0 : rt->due_us;
+}
+
+static struct libusb_transfer *next_due(int64_t now)
+{
+	GList *l;
+
+	for (l = replay.pending.head; l; l = l->next) {
+		if (transfer_due_time(l->data) <= now)
+			return l->data;
+	}
+
+	return NULL;
+}
+
+static int64_t next_due_time(void)
+{
+	GList *l;
+	int64_t due;
+
+	due = INT64_MAX;
+	for (l = replay.pending.head; l; l = l->next)
+		due = MIN(due, transfer_due_time(l->data));
+
+	return due;
+}
+
+/* Make the wakeup pipe readable exactly while a transfer is due. */
+static void wakeup_update(void)
+{
+	gboolean due;
+	char c;
+
+	if (replay.wakeup[0] < 0)
+		return;
+
+	due = next_due_time() <= g_get_monotonic_time();
+	if (due && !replay.woken) {
+		c = 0;
+		if (write(replay.wakeup[1], &c, 1) == 1)
+			replay.woken = TRUE;
+	} else if (!due && replay.woken) {
+		if (read(replay.wakeup[0], &c, 1) == 1)
+			replay.woken = FALSE;
+	}
+}
+
+/*
+ * Read up to len bytes from an IN endpoint. Returns the number of bytes
+ * read, and in due_us when the last of them arrived.
+ */
+static int stream_read(struct libusb_device *dev, unsigned char endpoint,
+		unsigned char *buf, int len, int64_t *due_us)
+{
+	struct replay_stream *s;
+	const struct replay_record *rec, *last;
+	uint32_t n;
+	int done;
+
+	s = &dev->streams[endpoint & (NUM_IN_ENDPOINTS - 1)];
+	if (!s->records)
+		return 0;
+	if (!dev->start_us)
+		dev->start_us = g_get_monotonic_time();
+
+	last = &g_array_index(s->records, struct replay_record,
+			s->records->len - 1);
+	done = 0;
+	while (done < len) {
+		if (s->pos == s->records->len) {
+			if (!(replay.flags & SRTEST_USB_REPLAY_LOOP) || !s->total)
+				break;
+			s->pos = 0;
+			s->loops++;
+		}
+		rec = &g_array_index(s->records, struct replay_record, s->pos);
+		n = MIN((uint32_t)(len - done), rec->length - s->offset);
+		memcpy(buf + done, rec->data + s->offset, n);
+		done += n;
+		s->offset += n;
+		*due_us = dev->start_us + rec->timestamp
+				+ s->loops * last->timestamp;
+		if (s->offset == rec->length) {
+			s->pos++;
+			s->offset = 0;
+		}
+	}
+
+	return done;
+}
+
+static void hotplug_notify(struct libusb_device *dev,
+		libusb_hotplug_event event)
+{
+	struct replay_hotplug_event *he;
+
+	he = g_malloc(sizeof(struct replay_hotplug_event));
+	he->dev = dev;
+	he->event = event;
+	g_queue_push_tail(&replay.hotplug_events, he);
+}
+
+static void hotplug_deliver(void)
+{
+	struct replay_hotplug_event *he;
+	struct replay_hotplug_cb *hc;
+	GSList *l, *next;
+
+	while ((he = g_queue_pop_head(&replay.hotplug_events))) {
+		for (l = replay.hotplug_cbs; l; l = next) {
+			next = l->next;
+			hc = l->data;
+			if ((hc->events & he->event) && hc->cb(hc->ctx, he->dev,
+					he->event, hc->user_data)) {
+				replay.hotplug_cbs = g_slist_delete_link(
+						replay.hotplug_cbs, l);
+				g_free(hc);
+			}
+		}
+		g_free(he);
+	}
+}
+
+static void fx2_write(struct libusb_device *dev, uint16_t addr,
+		const unsigned char *data, uint16_t length)
+{
+	if (addr != FX2_CPUCS || length < 1) {
+		dev->firmware_size += length;
+		replay.firmware_size += length;
+		return;
+	}
+
+	if (data[0] & 1) {
+		dev->in_reset = TRUE;
+		return;
+	}
+	if (!dev->in_reset)
+		return;
+	dev->in_reset = FALSE;
+
+	if (dev->firmware_size > 0 && dev->renumerated) {
+		/* The new firmware disconnects, and comes back as another device. */
+		dev->present = FALSE;
+		dev->renumerated->present = TRUE;
+		dev->renumerated->address = replay.next_address++;
+		hotplug_notify(dev, LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT);
+		hotplug_notify(dev->renumerated,
+				LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED);
+	}
+}
+
+static int control_request(struct libusb_device *dev, uint8_t request_type,
+		uint8_t request, uint16_t value, uint16_t index,
+		unsigned char *data, uint16_t length)
+{
+	const struct replay_record *rec;
+	uint16_t n;
+	guint i;
+
+	if (!dev->present)
+		return LIBUSB_ERROR_NO_DEVICE;
+
+	if (!(request_type & LIBUSB_ENDPOINT_IN)) {
+		if ((request_type & (0x03 << 5)) == LIBUSB_REQUEST_TYPE_VENDOR
+				&& request == FX2_FIRMWARE_REQUEST)
+			fx2_write(dev, value, data, length);
+		return length;
+	}
+
+	for (i = 0; i < dev->control->len; i++) {
+		rec = &g_array_index(dev->control, struct replay_record, i);
+		if (rec->request_type != request_type || rec->request != request
+				|| rec->value != value || rec->index != index)
+			continue;
+		n = MIN(length, rec->length);
+		memcpy(data, rec->data, n);
+		return n;
+	}
+
+	return LIBUSB_ERROR_PIPE;
+}
+
+static int sync_transfer(libusb_device_handle *dev_handle,
+		unsigned char endpoint, unsigned char *data, int length,
+		int *transferred, unsigned int timeout)
+{
+	int64_t due_us;
+	int n;
+
+	*transferred = 0;
+	due_us = 0;
+	if (!dev_handle->dev->present)
+		return LIBUSB_ERROR_NO_DEVICE;
+
+	if (!(endpoint & LIBUSB_ENDPOINT_IN)) {
+		*transferred = length;
+		return LIBUSB_SUCCESS;
+	}
+
+	n = stream_read(dev_handle->dev, endpoint, data, length, &due_us);
+	if (n == 0 && length > 0) {
+		if (throttled())
+			g_usleep(timeout * 1000);
+		return LIBUSB_ERROR_TIMEOUT;
+	}
+	if (throttled())
+		wait_until(due_us);
+	*transferred = n;
+
+	return LIBUSB_SUCCESS;
+}
+
+static void complete_transfer(struct libusb_transfer *transfer)
+{
+	struct replay_transfer *rt;
+	uint8_t flags;
+
+	rt = transfer_priv(transfer);
+	g_queue_remove(&replay.pending, transfer);
+	rt->pending = FALSE;
+
+	if (rt->cancelled) {
+		transfer->status = LIBUSB_TRANSFER_CANCELLED;
+		transfer->actual_length = 0;
+	} else {
+		transfer->status = rt->status;
+		transfer->actual_length = rt->actual_length;
+	}
+
+	flags = transfer->flags;
+	transfer->callback(transfer);
+	if (flags & LIBUSB_TRANSFER_FREE_TRANSFER)
+		libusb_free_transfer(transfer);
+}
+
+static struct libusb_device *device_new(const struct replay_record *rec)
+{
+	struct libusb_device *dev;
+	const uint8_t *p, *end;
+	unsigned int i;
+
+	p = rec->data;
+	end = p + rec->length;
+	fail_unless(end - p >= 4, "Truncated device record.");
+
+	dev = g_malloc0(sizeof(struct libusb_device));
+	dev->vid = get_le16(p);
+	dev->pid = get_le16(p + 2);
+	p += 4;
+	for (i = 0; i < G_N_ELEMENTS(dev->strings); i++) {
+		fail_unless(p < end && end - p > *p, "Truncated device record.");
+		if (*p)
+			dev->strings[i] = g_strndup((const char *)p + 1, *p);
+		p += 1 + *p;
+	}
+	dev->bus = 1;
+	dev->control = g_array_new(FALSE, FALSE, sizeof(struct replay_record));
+	g_ptr_array_add(replay.devices, dev);
+
+	return dev;
+}
+
+static void device_free(void *data)
+{
+	struct libusb_device *dev;
+	unsigned int i;
+
+	dev = data;
+	for (i = 0; i < G_N_ELEMENTS(dev->strings); i++)
+		g_free(dev->strings[i]);
+	g_array_free(dev->control, TRUE);
+	for (i = 0; i < NUM_IN_ENDPOINTS; i++) {
+		if (dev->streams[i].records)
+			g_array_free(dev->streams[i].records, TRUE);
+	}
+	g_free(dev);
+}
+
+static void add_stream_record(struct libusb_device *dev, uint8_t endpoint,
+		const struct replay_record *rec)
+{
+	struct replay_stream *s;
+
+	s = &dev->streams[endpoint & (NUM_IN_ENDPOINTS - 1)];
+	if (!s->records)
+		s->records = g_array_new(FALSE, FALSE,
+				sizeof(struct replay_record));
+	g_array_append_vals(s->records, rec, 1);
+	s->total += rec->length;
+}
+
+/* Whether libsigrok's libusb calls end up here. */
+gboolean srtest_usb_replay_active(void)
+{
+	return replay.num_inits > 0;
+}
+
+/* Make the devices in a capture file appear on the (virtual) bus. */
+void srtest_usb_replay_load(const char *path, int flags)
+{
+	struct libusb_device *dev, *cur;
+	struct replay_record rec;
+	const uint8_t *p, *end;
+	gsize len;
+	uint8_t type, endpoint;
+
+	fail_unless(!replay.devices, "A capture is loaded already.");
+	fail_unless(g_file_get_contents(path, &replay.file_data, &len, NULL),
+		    "Failed to read '%s'.", path);
+	p = (const uint8_t *)replay.file_data;
+	end = p + len;
+	fail_unless(len >= CAPTURE_HEADER_SIZE
+		    && !memcmp(p, CAPTURE_MAGIC, strlen(CAPTURE_MAGIC))
+		    && get_le32(p + 8) == CAPTURE_VERSION,
+		    "'%s' is not a USB capture.", path);
+	p += CAPTURE_HEADER_SIZE;
+
+	replay.devices = g_ptr_array_new_with_free_func(device_free);
+	replay.flags = flags;
+	replay.next_address = 2;
+	replay.next_port = 1;
+	replay.firmware_size = 0;
+
+	dev = cur = NULL;
+	while (p < end) {
+		fail_unless(end - p >= RECORD_HEADER_SIZE, "Truncated record.");
+		memset(&rec, 0, sizeof(rec));
+		type = p[0];
+		endpoint = p[1];
+		rec.length = get_le32(p + 4);
+		rec.timestamp = get_le64(p + 8);
+		p += RECORD_HEADER_SIZE;
+		fail_unless((uint64_t)(end - p) >= rec.length,
+			    "Truncated record.");
+		rec.data = p;
+		p += rec.length;
+
+		switch (type) {
+		case USB_CAPTURE_DEVICE:
+			dev = cur = device_new(&rec);
+			dev->address = replay.next_address++;
+			dev->port = replay.next_port++;
+			dev->present = TRUE;
+			break;
+		case USB_CAPTURE_RENUMERATE:
+			fail_unless(dev && !dev->renumerated,
+				    "Misplaced renumeration record.");
+			cur = dev->renumerated = device_new(&rec);
+			cur->port = dev->port;
+			cur->is_renumerated = TRUE;
+			break;
+		case USB_CAPTURE_CONTROL:
+			fail_unless(cur && rec.length >= LIBUSB_CONTROL_SETUP_SIZE,
+				    "Invalid control record.");
+			rec.request_type = rec.data[0];
+			rec.request = rec.data[1];
+			rec.value = get_le16(rec.data + 2);
+			rec.index = get_le16(rec.data + 4);
+			rec.data += LIBUSB_CONTROL_SETUP_SIZE;
+			rec.length -= LIBUSB_CONTROL_SETUP_SIZE;
+			g_array_append_vals(cur->control, &rec, 1);
+			break;
+		case USB_CAPTURE_BULK:
+			fail_unless(cur && (endpoint & LIBUSB_ENDPOINT_IN),
+				    "Invalid bulk record.");
+			add_stream_record(cur, endpoint, &rec);
+			break;
+		default:
+			fail("Unknown record type %d.", type);
+		}
+	}
+}
+
+void srtest_usb_replay_unload(void)
+{
+	g_queue_clear(&replay.pending);
+	while (!g_queue_is_empty(&replay.hotplug_events))
+		g_free(g_queue_pop_head(&replay.hotplug_events));
+	wakeup_update();
+	if (replay.devices)
+		g_ptr_array_free(replay.devices, TRUE);
+	replay.devices = NULL;
+	g_free(replay.file_data);
+	replay.file_data = NULL;
+}
+
+/* The index-th device started in the capture, counting from 0. */
+static struct libusb_device *capture_device(unsigned int index)
+{
+	struct libusb_device *dev;
+	unsigned int n;
+	guint i;
+
+	n = 0;
+	for (i = 0; replay.devices && i < replay.devices->len; i++) {
+		dev = g_ptr_array_index(replay.devices, i);
+		if (!dev->is_renumerated && n++ == index)
+			return dev;
+	}
+	fail("The capture has no device %u.", index);
+
+	return NULL;
+}
+
+/* Pull a device out, whatever it's renumerated to. */
+void srtest_usb_replay_unplug(unsigned int index)
+{
+	struct libusb_device *dev;
+
+	dev = capture_device(index);
+	if (!dev->present && dev->renumerated)
+		dev = dev->renumerated;
+	fail_unless(dev->present, "Device %u isn't plugged in.", index);
+	dev->present = FALSE;
+	hotplug_notify(dev, LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT);
+}
+
+/* Plug a device back in, without its firmware, at a new address. */
+void srtest_usb_replay_plug(unsigned int index)
+{
+	struct libusb_device *dev;
+
+	dev = capture_device(index);
+	fail_unless(!dev->present && !(dev->renumerated
+		    && dev->renumerated->present),
+		    "Device %u is plugged in already.", index);
+	dev->present = TRUE;
+	dev->address = replay.next_address++;
+	dev->in_reset = FALSE;
+	dev->firmware_size = 0;
+	hotplug_notify(dev, LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED);
+}
+
+/* Number of bytes written to FX2 RAM since the capture was loaded. */
+uint64_t srtest_usb_replay_firmware_size(void)
+{
+	return replay.firmware_size;
+}
+
+/*
+ * The libusb API, as far as libsigrok uses it. These definitions take
+ * precedence over those in the libusb shared library. They have to be
+ * exported from the test binary, which is built with -fvisibility=hidden.
+ */
+#pragma GCC visibility push(default)
+
+int LIBUSB_CALL libusb_init(libusb_context **ctx)
+{
+	int i;
+
+	replay.num_inits++;
+	if (replay.num_contexts == 0) {
+		if (pipe(replay.wakeup) < 0)
+			return LIBUSB_ERROR_OTHER;
+		for (i = 0; i < 2; i++)
+			fcntl(replay.wakeup[i], F_SETFL, O_NONBLOCK);
+		replay.woken = FALSE;
+	}
+	replay.num_contexts++;
+
+	if (ctx)
+		*ctx = g_malloc0(sizeof(struct libusb_context));
+
+	return LIBUSB_SUCCESS;
+}
+
+void LIBUSB_CALL libusb_exit(libusb_context *ctx)
+{
+	struct replay_hotplug_cb *hc;
+	GSList *l, *next;
+
+	for (l = replay.hotplug_cbs; l; l = next) {
+		next = l->next;
+		hc = l->data;
+		if (hc->ctx != ctx)
+			continue;
+		replay.hotplug_cbs = g_slist_delete_link(replay.hotplug_cbs, l);
+		g_free(hc);
+	}
+	g_free(ctx);
+
+	if (replay.num_contexts == 0 || --replay.num_contexts > 0)
+		return;
+	close(replay.wakeup[0]);
+	close(replay.wakeup[1]);
+	replay.wakeup[0] = replay.wakeup[1] = -1;
+}
+
+const struct libusb_version * LIBUSB_CALL libusb_get_version(void)
+{
+	static const struct libusb_version version = {
+		1, 0, 0, 0, "-replay", "libsigrok test suite",
+	};
+
+	return &version;
+}
+
+int LIBUSB_CALL libusb_has_capability(uint32_t capability)
+{
+	if (capability == LIBUSB_CAP_HAS_HOTPLUG)
+		return !(replay.flags & SRTEST_USB_REPLAY_NO_HOTPLUG);
+
+	return capability == LIBUSB_CAP_HAS_CAPABILITY;
+}
+
+const char * LIBUSB_CALL libusb_error_name(int errcode)
+{
+#define NAME(x) case x: return #x
+	switch (errcode) {
+	NAME(LIBUSB_ERROR_IO);
+	NAME(LIBUSB_ERROR_INVALID_PARAM);
+	NAME(LIBUSB_ERROR_ACCESS);
+	NAME(LIBUSB_ERROR_NO_DEVICE);
+	NAME(LIBUSB_ERROR_NOT_FOUND);
+	NAME(LIBUSB_ERROR_BUSY);
+	NAME(LIBUSB_ERROR_TIMEOUT);
+	NAME(LIBUSB_ERROR_OVERFLOW);
+	NAME(LIBUSB_ERROR_PIPE);
+	NAME(LIBUSB_ERROR_INTERRUPTED);
+	NAME(LIBUSB_ERROR_NO_MEM);
+	NAME(LIBUSB_ERROR_NOT_SUPPORTED);
+	NAME(LIBUSB_ERROR_OTHER);
+	NAME(LIBUSB_TRANSFER_ERROR);
+	NAME(LIBUSB_TRANSFER_TIMED_OUT);
+	NAME(LIBUSB_TRANSFER_CANCELLED);
+	NAME(LIBUSB_TRANSFER_STALL);
+	NAME(LIBUSB_TRANSFER_NO_DEVICE);
+	NAME(LIBUSB_TRANSFER_OVERFLOW);
+	case 0:
+		return "LIBUSB_SUCCESS / LIBUSB_TRANSFER_COMPLETED";
+	default:
+		return "**UNKNOWN**";
+	}
+#undef NAME
+}
+
+ssize_t LIBUSB_CALL libusb_get_device_list(libusb_context *ctx,
+		libusb_device ***list)
+{
+	GPtrArray *devs;
+	libusb_device *dev;
+	ssize_t count;
+	guint i;
+
+	(void)ctx;
+
+	devs = g_ptr_array_new();
+	for (i = 0; replay.devices && i < replay.devices->len; i++) {
+		dev = g_ptr_array_index(replay.devices, i);
+		if (dev->present)
+			g_ptr_array_add(devs, dev);
+	}
+	count = devs->len;
+	g_ptr_array_add(devs, NULL);
+	*list = (libusb_device **)g_ptr_array_free(devs, FALSE);
+
+	return count;
+}
+
+void LIBUSB_CALL libusb_free_device_list(libusb_device **list,
+		int unref_devices)
+{
+	(void)unref_devices;
+
+	g_free(list);
+}
+
+libusb_device * LIBUSB_CALL libusb_ref_device(libusb_device *dev)
+{
+	return dev;
+}
+
+void LIBUSB_CALL libusb_unref_device(libusb_device *dev)
+{
+	(void)dev;
+}
+
+int LIBUSB_CALL libusb_get_device_descriptor(libusb_device *dev,
+		struct libusb_device_descriptor *desc)
+{
+	memset(desc, 0, sizeof(struct libusb_device_descriptor));
+	desc->bLength = LIBUSB_DT_DEVICE_SIZE;
+	desc->bDescriptorType = LIBUSB_DT_DEVICE;
+	desc->bcdUSB = 0x0200;
+	desc->bMaxPacketSize0 = 64;
+	desc->idVendor = dev->vid;
+	desc->idProduct = dev->pid;
+	desc->iManufacturer = dev->strings[0] ? 1 : 0;
+	desc->iProduct = dev->strings[1] ? 2 : 0;
+	desc->iSerialNumber = dev->strings[2] ? 3 : 0;
+	desc->bNumConfigurations = 1;
+
+	return LIBUSB_SUCCESS;
+}
+
+int LIBUSB_CALL libusb_get_config_descriptor(libusb_device *dev,
+		uint8_t config_index, struct libusb_config_descriptor **config)
+{
+	(void)dev;
+
+	if (config_index > 0)
+		return LIBUSB_ERROR_NOT_FOUND;
+	*config = &replay_config;
+
+	return LIBUSB_SUCCESS;
+}
+
+void LIBUSB_CALL libusb_free_config_descriptor(
+		struct libusb_config_descriptor *config)
+{
+	(void)config;
+}
+
+uint8_t LIBUSB_CALL libusb_get_bus_number(libusb_device *dev)
+{
+	return dev->bus;
+}
+
+uint8_t LIBUSB_CALL libusb_get_device_address(libusb_device *dev)
+{
+	return dev->address;
+}
+
+int LIBUSB_CALL libusb_get_port_numbers(libusb_device *dev,
+		uint8_t *port_numbers, int port_numbers_len)
+{
+	if (port_numbers_len < 1)
+		return LIBUSB_ERROR_OVERFLOW;
+	port_numbers[0] = dev->port;
+
+	return 1;
+}
+
+int LIBUSB_CALL libusb_open(libusb_device *dev,
+		libusb_device_handle **dev_handle)
+{
+	if (!dev->present)
+		return LIBUSB_ERROR_NO_DEVICE;
+
+	*dev_handle = g_malloc0(sizeof(struct libusb_device_handle));
+	(*dev_handle)->dev = dev;
+
+	return LIBUSB_SUCCESS;
+}
+
+void LIBUSB_CALL libusb_close(libusb_device_handle *dev_handle)
+{
+	g_free(dev_handle);
+}
+
+libusb_device * LIBUSB_CALL libusb_get_device(libusb_device_handle *dev_handle)
+{
+	return dev_handle->dev;
+}
+
+int LIBUSB_CALL libusb_get_configuration(libusb_device_handle *dev_handle,
+		int *config)
+{
+	if (!dev_handle->dev->present)
+		return LIBUSB_ERROR_NO_DEVICE;
+	*config = replay_config.bConfigurationValue;
+
+	return LIBUSB_SUCCESS;
+}
+
+int LIBUSB_CALL libusb_set_configuration(libusb_device_handle *dev_handle,
+		int configuration)
+{
+	(void)configuration;
+
+	return dev_handle->dev->present ? LIBUSB_SUCCESS : LIBUSB_ERROR_NO_DEVICE;
+}
+
+int LIBUSB_CALL libusb_claim_interface(libusb_device_handle *dev_handle,
+		int interface_number)
+{
+	(void)interface_number;
+
+	return dev_handle->dev->present ? LIBUSB_SUCCESS : LIBUSB_ERROR_NO_DEVICE;
+}
+
+int LIBUSB_CALL libusb_release_interface(libusb_device_handle *dev_handle,
+		int interface_number)
+{
+	(void)interface_number;
+
+	return dev_handle->dev->present ? LIBUSB_SUCCESS : LIBUSB_ERROR_NO_DEVICE;
+}
+
+int LIBUSB_CALL libusb_reset_device(libusb_device_handle *dev_handle)
+{
+	return dev_handle->dev->present ? LIBUSB_SUCCESS : LIBUSB_ERROR_NO_DEVICE;
+}
+
+int LIBUSB_CALL libusb_kernel_driver_active(libusb_device_handle *dev_handle,
+		int interface_number)
+{
+	(void)interface_number;
+
+	return dev_handle->dev->present ? 0 : LIBUSB_ERROR_NO_DEVICE;
+}
+
+int LIBUSB_CALL libusb_detach_kernel_driver(libusb_device_handle *dev_handle,
+		int interface_number)
+{
+	(void)interface_number;
+
+	return dev_handle->dev->present ? LIBUSB_ERROR_NOT_FOUND
+			: LIBUSB_ERROR_NO_DEVICE;
+}
+
+int LIBUSB_CALL libusb_attach_kernel_driver(libusb_device_handle *dev_handle,
+		int interface_number)
+{
+	(void)interface_number;
+
+	return dev_handle->dev->present ? LIBUSB_ERROR_NOT_FOUND
+			: LIBUSB_ERROR_NO_DEVICE;
+}
+
+int LIBUSB_CALL libusb_get_string_descriptor_ascii(
+		libusb_device_handle *dev_handle, uint8_t desc_index,
+		unsigned char *data, int length)
+{
+	const char *str;
+	int n;
+
+	if (!dev_handle->dev->present)
+		return LIBUSB_ERROR_NO_DEVICE;
+	if (length < 1)
+		return LIBUSB_ERROR_INVALID_PARAM;
+	if (desc_index < 1 || desc_index > 3
+			|| !(str = dev_handle->dev->strings[desc_index - 1]))
+		return LIBUSB_ERROR_PIPE;
+
+	n = MIN((int)strlen(str), length - 1);
+	memcpy(data, str, n);
+	data[n] = '\0';
+
+	return n;
+}
+
+int LIBUSB_CALL libusb_control_transfer(libusb_device_handle *dev_handle,
+		uint8_t request_type, uint8_t bRequest, uint16_t wValue,
+		uint16_t wIndex, unsigned char *data, uint16_t wLength,
+		unsigned int timeout)
+{
+	(void)timeout;
+
+	return control_request(dev_handle->dev, request_type, bRequest,
+			wValue, wIndex, data, wLength);
+}
+
+int LIBUSB_CALL libusb_bulk_transfer(libusb_device_handle *dev_handle,
+		unsigned char endpoint, unsigned char *data, int length,
+		int *actual_length, unsigned int timeout)
+{
+	return sync_transfer(dev_handle, endpoint, data, length,
+			actual_length, timeout);
+}
+
+int LIBUSB_CALL libusb_interrupt_transfer(libusb_device_handle *dev_handle,
+		unsigned char endpoint, unsigned char *data, int length,
+		int *actual_length, unsigned int timeout)
+{
+	return sync_transfer(dev_handle, endpoint, data, length,
+			actual_length, timeout);
+}
+
+struct libusb_transfer * LIBUSB_CALL libusb_alloc_transfer(int iso_packets)
+{
+	struct replay_transfer *rt;
+	struct libusb_transfer *transfer;
+
+	rt = g_malloc0(sizeof(struct replay_transfer)
+			+ sizeof(struct libusb_transfer) + iso_packets
+			* sizeof(struct libusb_iso_packet_descriptor));
+	transfer = (struct libusb_transfer *)(rt + 1);
+	transfer->num_iso_packets = iso_packets;
+
+	return transfer;
+}
+
+void LIBUSB_CALL libusb_free_transfer(struct libusb_transfer *transfer)
+{
+	struct replay_transfer *rt;
+
+	if (!transfer)
+		return;
+
+	rt = transfer_priv(transfer);
+	if (rt->pending)
+		g_queue_remove(&replay.pending, transfer);
+	if (transfer->flags & LIBUSB_TRANSFER_FREE_BUFFER)
+		free(transfer->buffer);
+	g_free(rt);
+}
+
+int LIBUSB_CALL libusb_submit_transfer(struct libusb_transfer *transfer)
+{
+	struct replay_transfer *rt;
+	struct libusb_device *dev;
+	unsigned char *setup;
+	int64_t now, due_us;
+	int ret;
+
+	rt = transfer_priv(transfer);
+	if (rt->pending)
+		return LIBUSB_ERROR_BUSY;
+	dev = transfer->dev_handle->dev;
+	if (!dev->present)
+		return LIBUSB_ERROR_NO_DEVICE;
+
+	now = due_us = g_get_monotonic_time();
+	rt->cancelled = FALSE;
+	rt->due_us = now;
+	rt->status = LIBUSB_TRANSFER_COMPLETED;
+	rt->actual_length = 0;
+
+	switch (transfer->type) {
+	case LIBUSB_TRANSFER_TYPE_CONTROL:
+		setup = transfer->buffer;
+		ret = control_request(dev, setup[0], setup[1],
+				get_le16(setup + 2), get_le16(setup + 4),
+				setup + LIBUSB_CONTROL_SETUP_SIZE,
+				get_le16(setup + 6));
+		if (ret < 0)
+			rt->status = LIBUSB_TRANSFER_STALL;
+		else
+			rt->actual_length = ret;
+		break;
+	case LIBUSB_TRANSFER_TYPE_BULK:
+	case LIBUSB_TRANSFER_TYPE_INTERRUPT:
+		if (!(transfer->endpoint & LIBUSB_ENDPOINT_IN)) {
+			rt->actual_length = transfer->length;
+			break;
+		}
+		rt->actual_length = stream_read(dev, transfer->endpoint,
+				transfer->buffer, transfer->length, &due_us);
+		if (rt->actual_length > 0 || transfer->length == 0) {
+			if (throttled())
+				rt->due_us = due_us;
+		} else if (transfer->timeout) {
+			rt->status = LIBUSB_TRANSFER_TIMED_OUT;
+			if (throttled())
+				rt->due_us = now + transfer->timeout * 1000;
+		} else {
+			/* Nothing is ever going to arrive. */
+			rt->due_us = INT64_MAX;
+		}
+		break;
+	default:
+		return LIBUSB_ERROR_NOT_SUPPORTED;
+	}
+
+	rt->pending = TRUE;
+	g_queue_push_tail(&replay.pending, transfer);
+	wakeup_update();
+
+	return LIBUSB_SUCCESS;
+}
+
+int LIBUSB_CALL libusb_cancel_transfer(struct libusb_transfer *transfer)
+{
+	struct replay_transfer *rt;
+
+	rt = transfer_priv(transfer);
+	if (!rt->pending || rt->cancelled)
+		return LIBUSB_ERROR_NOT_FOUND;
+	rt->cancelled = TRUE;
+	wakeup_update();
+
+	return LIBUSB_SUCCESS;
+}
+
+int LIBUSB_CALL libusb_handle_events_timeout_completed(libusb_context *ctx,
+		struct timeval *tv, int *completed)
+{
+	struct libusb_transfer *transfer;
+	int64_t now;
+	guint n;
+
+	(void)ctx;
+
+	hotplug_deliver();
+
+	now = g_get_monotonic_time();
+	if (!next_due(now) && tv && (tv->tv_sec || tv->tv_usec)) {
+		/* Wait for the next transfer, or the timeout. */
+		wait_until(MIN(next_due_time(), now + tv->tv_usec
+				+ (int64_t)tv->tv_sec * G_USEC_PER_SEC));
+		now = g_get_monotonic_time();
+	}
+
+	/* Transfers resubmitted by the callbacks wait for the next round. */
+	n = g_queue_get_length(&replay.pending);
+	while (n-- > 0 && !(completed && *completed)
+			&& (transfer = next_due(now)))
+		complete_transfer(transfer);
+	wakeup_update();
+
+	return LIBUSB_SUCCESS;
+}
+
+int LIBUSB_CALL libusb_handle_events_timeout(libusb_context *ctx,
+		struct timeval *tv)
+{
+	return libusb_handle_events_timeout_completed(ctx, tv, NULL);
+}
+
+int LIBUSB_CALL libusb_get_next_timeout(libusb_context *ctx,
+		struct timeval *tv)
+{
+	int64_t due, remaining;
+
+	(void)ctx;
+
+	if ((due = next_due_time()) == INT64_MAX)
+		return 0;
+	remaining = MAX(0, due - g_get_monotonic_time());
+	tv->tv_sec = remaining / G_USEC_PER_SEC;
+	tv->tv_usec = remaining % G_USEC_PER_SEC;
+
+	return 1;
+}
+
+const struct libusb_pollfd ** LIBUSB_CALL libusb_get_pollfds(
+		libusb_context *ctx)
+{
+	static struct libusb_pollfd wakeup_pollfd;
+	const struct libusb_pollfd **pollfds;
+
+	(void)ctx;
+
+	if (replay.wakeup[0] < 0)
+		return NULL;
+
+	/* The caller frees this with free(), on older libusb versions. */
+	pollfds = calloc(2, sizeof(struct libusb_pollfd *));
+	wakeup_pollfd.fd = replay.wakeup[0];
+	wakeup_pollfd.events = POLLIN;
+	pollfds[0] = &wakeup_pollfd;
+
+	return pollfds;
+}
+
+int LIBUSB_CALL libusb_hotplug_register_callback(libusb_context *ctx,
+		libusb_hotplug_event events, libusb_hotplug_flag flags,
+		int vendor_id, int product_id, int dev_class,
+		libusb_hotplug_callback_fn cb_fn, void *user_data,
+		libusb_hotplug_callback_handle *handle)
+{
+	struct replay_hotplug_cb *hc;
+	struct libusb_device *dev;
+	guint i;
+
+	/* Devices are only ever matched by everything. */
+	(void)vendor_id;
+	(void)product_id;
+	(void)dev_class;
+
+	if (replay.flags & SRTEST_USB_REPLAY_NO_HOTPLUG)
+		return LIBUSB_ERROR_NOT_SUPPORTED;
+
+	if ((flags & LIBUSB_HOTPLUG_ENUMERATE)
+			&& (events & LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED)) {
+		for (i = 0; replay.devices && i < replay.devices->len; i++) {
+			dev = g_ptr_array_index(replay.devices, i);
+			if (dev->present && cb_fn(ctx, dev,
+					LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED,
+					user_data))
+				return LIBUSB_SUCCESS;
+		}
+	}
+
+	hc = g_malloc(sizeof(struct replay_hotplug_cb));
+	hc->ctx = ctx;
+	hc->events = events;
+	hc->cb = cb_fn;
+	hc->user_data = user_data;
+	hc->handle = ++replay.next_hotplug_handle;
+	replay.hotplug_cbs = g_slist_append(replay.hotplug_cbs, hc);
+	if (handle)
+		*handle = hc->handle;
+
+	return LIBUSB_SUCCESS;
+}
+
+void LIBUSB_CALL libusb_hotplug_deregister_callback(libusb_context *ctx,
+		libusb_hotplug_callback_handle handle)
+{
+	struct replay_hotplug_cb *hc;
+	GSList *l;
+
+	for (l = replay.hotplug_cbs; l; l = l->next) {
+		hc = l->data;
+		if (hc->ctx != ctx || hc->handle != handle)
+			continue;
+		replay.hotplug_cbs = g_slist_delete_link(replay.hotplug_cbs, l);
+		g_free(hc);
+		return;
+	}
+}
+
+#if (LIBUSB_API_VERSION >= 0x01000104)
+void LIBUSB_CALL libusb_free_pollfds(const struct libusb_pollfd **pollfds)
+{
+	free(pollfds);
+}
+#endif
+
+void LIBUSB_CALL libusb_set_pollfd_notifiers(libusb_context *ctx,
+		libusb_pollfd_added_cb added_cb,
+		libusb_pollfd_removed_cb removed_cb, void *user_data)
+{
+	/* The set of FDs never changes. */
+	(void)added_cb;
+	(void)removed_cb;
+
+	if (ctx)
+		ctx->pollfd_user_data = user_data;
+}
+
+#pragma GCC visibility pop
+
+#else
+
+gboolean srtest_usb_replay_active(void)
+{
+	return FALSE;
+}
+
+void srtest_usb_replay_load(const char *path, int flags)
+{
+	(void)path;
+	(void)flags;
+
+	fail("USB replay isn't available in this build.");
+}
+
+void srtest_usb_replay_unload(void)
+{
+}
+
+void srtest_usb_replay_unplug(unsigned int index)
+{
+	(void)index;
+}
+
+void srtest_usb_replay_plug(unsigned int index)
+{
+	(void)index;
+}
+
+uint64_t srtest_usb_replay_firmware_size(void)
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBSIGROK_TESTS_USB_REPLAY_H
+#define LIBSIGROK_TESTS_USB_REPLAY_H
+
+#include <stdint.h>
+#include <glib.h>
+
+/*
+ * The test binary carries its own libusb_*() functions, which take the
+ * place of the real libusb for libsigrok (and anything else in the
+ * process). No real USB device is ever touched. Instead, the devices and
+ * their endpoint traffic come from capture files loaded with
+ * srtest_usb_replay_load().
+ *
+ * A capture file is the 8 byte magic "SRUSBCAP", a u32 version (1) and
+ * a sequence of records, all integers little endian. A record is a u8
+ * type, a u8 endpoint, two reserved bytes, a u32 data length, a u64
+ * timestamp and the data. The timestamp is in microseconds since the
+ * start of the capture, and says when the record's data arrived.
+ *
+ * Records other than USB_CAPTURE_DEVICE belong to the device most
+ * recently started, or to what it became after USB_CAPTURE_RENUMERATE.
+ *
+ * Data read from an IN endpoint is replayed as a byte stream: each
+ * transfer is filled completely, as long as there's data left. With
+ * SRTEST_USB_REPLAY_THROTTLE, a transfer completes no earlier than the
+ * timestamp of its last byte, counted from the device's first bulk IN
+ * transfer; otherwise, as fast as the driver takes the data. With
+ * SRTEST_USB_REPLAY_LOOP, an endpoint's data is repeated endlessly, the
+ * timestamps shifted by that of its last record each time round.
+ *
+ * FX2 firmware uploads (vendor request 0xa0) are accepted. When the
+ * CPU is taken out of reset after an upload, a device which has a
+ * USB_CAPTURE_RENUMERATE record drops off the bus, and comes back with
+ * the new identity on the same port.
+ *
+ * Devices coming and going are reported to the hotplug callbacks from
+ * libusb_handle_events*(), as libusb does. With SRTEST_USB_REPLAY_NO_HOTPLUG,
+ * libusb claims no hotplug support, as on some platforms.
+ */
+
+enum usb_capture_record_type {
+	/*
+	 * Starts a new device. Data: u16 vendor ID, u16 product ID, then
+	 * the manufacturer, product and serial number strings, each a u8
+	 * length followed by the characters. Empty strings aren't reported.
+	 */
+	USB_CAPTURE_DEVICE = 1,
+	/* The device after firmware upload. Same data as USB_CAPTURE_DEVICE. */
+	USB_CAPTURE_RENUMERATE,
+	/*
+	 * A device-to-host control request: the 8 byte setup packet, then
+	 * the data the device returned. Any request not in the capture
+	 * stalls. Host-to-device requests are always accepted.
+	 */
+	USB_CAPTURE_CONTROL,
+	/* Data the device sent on the bulk or interrupt IN endpoint. */
+	USB_CAPTURE_BULK,
+};
+
+enum srtest_usb_replay_flags {
+	SRTEST_USB_REPLAY_THROTTLE = 1 << 0,
+	SRTEST_USB_REPLAY_LOOP = 1 << 1,
+	SRTEST_USB_REPLAY_NO_HOTPLUG = 1 << 2,
+};
+
+struct srtest_usb_capture;
+
+struct srtest_usb_capture *srtest_usb_capture_new(void);
+void srtest_usb_capture_device(struct srtest_usb_capture *cap,
+		uint16_t vid, uint16_t pid, const char *manufacturer,
+		const char *product, const char *serial_num);
+void srtest_usb_capture_renumerate(struct srtest_usb_capture *cap,
+		uint16_t vid, uint16_t pid, const char *manufacturer,
+		const char *product, const char *serial_num);
+void srtest_usb_capture_control(struct srtest_usb_capture *cap,
+		uint64_t timestamp, uint8_t request_type, uint8_t request,
+		uint16_t value, uint16_t index, const void *data,
+		uint16_t length);
+void srtest_usb_capture_bulk(struct srtest_usb_capture *cap,
+		uint64_t timestamp, uint8_t endpoint, const void *data,
+		uint32_t length);
+char *srtest_usb_capture_save(struct srtest_usb_capture *cap);
+void srtest_usb_capture_free(struct srtest_usb_capture *cap);
+
+gboolean srtest_usb_replay_active(void);
+void srtest_usb_replay_load(const char *path, int flags);
+void srtest_usb_replay_unload(void);
+void srtest_usb_replay_unplug(unsigned int index);
+void srtest_usb_replay_plug(unsigned int index);
+uint64_t srtest_usb_replay_firmware_size(void);
+
+#endif